@@ -0,0 +1,11 @@
+#
+# Component Makefile
+#
+
+COMPONENT_ADD_INCLUDEDIRS := include
+
+COMPONENT_SRCDIRS := .
+
+ifdef CONFIG_DNS_CACHE_WRAP_GETADDRINFO
+COMPONENT_ADD_LDFLAGS := -l$(COMPONENT_NAME) -Wl,--wrap=lwip_getaddrinfo -u __wrap_lwip_getaddrinfo
+endif
@@ -0,0 +1,310 @@
+/**
+ * @file dns_cache.c
+ * @brief Host name cache shared by the MQTT and HTTP connections
+ *
+ * Queries go to lwIP's asynchronous resolver on the tcpip thread, so a caller
+ * can stop waiting for a slow answer and use the last address it had instead.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "lwip/dns.h"
+#include "lwip/tcpip.h"
+
+#include "dns_cache.h"
+
+static const char *TAG = "dns_cache";
+
+/* A miss has no address to fall back to, lwIP calls back once its own retries are over */
+#define DNS_CACHE_MISS_WAIT_MS 30000
+/* Bit of entry i in s_answers */
+#define DNS_CACHE_ANSWER_BIT(i) ((EventBits_t) 1 << (i))
+
+typedef struct {
+    char host[CONFIG_DNS_CACHE_HOST_LEN + 1];
+    ip_addr_t addr;             /* Last address that resolved, if isValid */
+    bool isValid;
+    bool isResolving;           /* A query is on its way, the entry must not be reused meanwhile */
+    TickType_t resolvedAt;
+    TickType_t usedAt;
+} dns_cache_entry_t;
+
+static dns_cache_entry_t s_entries[CONFIG_DNS_CACHE_ENTRIES];
+static dns_cache_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+/* Bit i is set once the query of entry i is over, lookups waiting for it block on the bit */
+static EventGroupHandle_t s_answers;
+static StaticEventGroup_t s_answersBuffer;
+
+#ifdef CONFIG_DNS_CACHE_WRAP_GETADDRINFO
+int __real_lwip_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                            struct addrinfo **res);
+#define DNS_CACHE_GETADDRINFO __real_lwip_getaddrinfo
+#else
+#define DNS_CACHE_GETADDRINFO lwip_getaddrinfo
+#endif
+
+static bool dns_cache_is_older(TickType_t since, uint32_t sec)
+{
+    /* Seconds times the tick rate, pdMS_TO_TICKS would overflow for a day */
+    return (TickType_t) (xTaskGetTickCount() - since) >= (TickType_t) (sec * configTICK_RATE_HZ);
+}
+
+/* Entry of host, or the least recently used one that is not resolving. Call with s_lock held */
+static int dns_cache_find(const char *host)
+{
+    TickType_t now = xTaskGetTickCount();
+    int lru = -1;
+    int i;
+
+    if (NULL == s_answers) {
+        s_answers = xEventGroupCreateStatic(&s_answersBuffer);
+    }
+
+    for (i = 0; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+        if ('\0' != s_entries[i].host[0] && 0 == strcasecmp(s_entries[i].host, host)) {
+            return i;
+        }
+        if (!s_entries[i].isResolving &&
+            (lru < 0 || (TickType_t) (now - s_entries[i].usedAt) > (TickType_t) (now - s_entries[lru].usedAt))) {
+            lru = i;
+        }
+    }
+
+    if (lru >= 0) {
+        strcpy(s_entries[lru].host, host);
+        s_entries[lru].isValid = false;
+    }
+    return lru;
+}
+
+/*
+ * Marks entry i as resolving. Its bit is cleared under the same lock, so a
+ * lookup that sees isResolving never wakes up on the answer of an earlier
+ * query. Call with s_lock held
+ */
+static void dns_cache_begin_query(int i)
+{
+    s_entries[i].isResolving = true;
+    xEventGroupClearBits(s_answers, DNS_CACHE_ANSWER_BIT(i));
+    s_stats.queries++;
+}
+
+/* Called by lwIP on the tcpip thread, ipaddr is NULL if the query failed */
+static void dns_cache_found(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    dns_cache_entry_t *entry = &s_entries[(intptr_t) arg];
+
+    portENTER_CRITICAL(&s_lock);
+    if (entry->isResolving) {
+        entry->isResolving = false;
+        if (NULL != ipaddr) {
+            entry->addr = *ipaddr;
+            entry->isValid = true;
+            entry->resolvedAt = xTaskGetTickCount();
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    xEventGroupSetBits(s_answers, DNS_CACHE_ANSWER_BIT((intptr_t) arg));
+
+    if (NULL == ipaddr) {
+        ESP_LOGW(TAG, "Query for %s failed", name);
+    }
+}
+
+/* Runs on the tcpip thread, the only one allowed to call into the resolver */
+static void dns_cache_query(void *arg)
+{
+    char host[CONFIG_DNS_CACHE_HOST_LEN + 1];
+    ip_addr_t addr;
+    err_t err;
+
+    portENTER_CRITICAL(&s_lock);
+    strcpy(host, s_entries[(intptr_t) arg].host);
+    portEXIT_CRITICAL(&s_lock);
+
+    err = dns_gethostbyname(host, &addr, dns_cache_found, arg);
+    if (ERR_OK == err) {
+        dns_cache_found(host, &addr, arg);
+    } else if (ERR_INPROGRESS != err) {
+        dns_cache_found(host, NULL, arg);
+    }
+}
+
+/* Hands the query of entry i to the tcpip thread */
+static void dns_cache_start_query(const char *host, int i)
+{
+    ESP_LOGD(TAG, "Resolving %s", host);
+    if (ERR_OK != tcpip_callback(dns_cache_query, (void *) (intptr_t) i)) {
+        dns_cache_found(host, NULL, (void *) (intptr_t) i);
+    }
+}
+
+esp_err_t dns_cache_resolve(const char *host, ip_addr_t *addr)
+{
+    dns_cache_entry_t *entry;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t waitTicks;
+    TickType_t waited;
+    bool isQuery = false;
+    bool isResolving;
+    bool isFallback = false;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    int i;
+
+    if (NULL == host || NULL == addr || strlen(host) > CONFIG_DNS_CACHE_HOST_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ipaddr_aton(host, addr)) {
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    i = dns_cache_find(host);
+    if (i < 0) {
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGW(TAG, "Every entry is resolving, %s is not cached", host);
+        return ESP_ERR_NO_MEM;
+    }
+    entry = &s_entries[i];
+    entry->usedAt = start;
+    if (entry->isValid && !dns_cache_is_older(entry->resolvedAt, CONFIG_DNS_CACHE_TTL_SEC)) {
+        *addr = entry->addr;
+        s_stats.hits++;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_OK;
+    }
+    if (!entry->isResolving) {
+        dns_cache_begin_query(i);
+        isQuery = true;
+    }
+    waitTicks = pdMS_TO_TICKS(entry->isValid ? CONFIG_DNS_CACHE_STALE_WAIT_MS : DNS_CACHE_MISS_WAIT_MS);
+    portEXIT_CRITICAL(&s_lock);
+
+    if (isQuery) {
+        dns_cache_start_query(host, i);
+    }
+
+    /* Whoever started the query, every lookup of the host waits for the same answer */
+    for (;;) {
+        portENTER_CRITICAL(&s_lock);
+        isResolving = entry->isResolving;
+        portEXIT_CRITICAL(&s_lock);
+        waited = xTaskGetTickCount() - start;
+        if (!isResolving || waited >= waitTicks) {
+            break;
+        }
+        xEventGroupWaitBits(s_answers, DNS_CACHE_ANSWER_BIT(i), pdFALSE, pdTRUE, waitTicks - waited);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    /* The entry may have gone to another host once its query was over */
+    if (entry->isValid && 0 == strcasecmp(entry->host, host)) {
+        if (!dns_cache_is_older(entry->resolvedAt, CONFIG_DNS_CACHE_TTL_SEC)) {
+            *addr = entry->addr;
+            err = ESP_OK;
+        } else if (!dns_cache_is_older(entry->resolvedAt, CONFIG_DNS_CACHE_MAX_STALE_SEC)) {
+            *addr = entry->addr;
+            s_stats.fallbacks++;
+            isFallback = true;
+            err = ESP_OK;
+        }
+    }
+    if (ESP_OK != err) {
+        s_stats.failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (ESP_OK != err) {
+        ESP_LOGE(TAG, "No address for %s", host);
+    } else if (isFallback) {
+        ESP_LOGW(TAG, "DNS for %s is slow or failing, using its last address", host);
+    }
+    return err;
+}
+
+esp_err_t dns_cache_prefetch(const char *host)
+{
+    ip_addr_t addr;
+    bool isQuery = false;
+    int i;
+
+    if (NULL == host || strlen(host) > CONFIG_DNS_CACHE_HOST_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ipaddr_aton(host, &addr)) {
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    i = dns_cache_find(host);
+    if (i >= 0) {
+        s_entries[i].usedAt = xTaskGetTickCount();
+        if (!s_entries[i].isResolving &&
+            (!s_entries[i].isValid || dns_cache_is_older(s_entries[i].resolvedAt, CONFIG_DNS_CACHE_TTL_SEC))) {
+            dns_cache_begin_query(i);
+            isQuery = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (i < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (isQuery) {
+        dns_cache_start_query(host, i);
+    }
+    return ESP_OK;
+}
+
+int dns_cache_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                          struct addrinfo **res)
+{
+    char numeric[IPADDR_STRLEN_MAX];
+    ip_addr_t addr;
+    esp_err_t err;
+
+    if (NULL == nodename) {
+        return DNS_CACHE_GETADDRINFO(nodename, servname, hints, res);
+    }
+
+    err = dns_cache_resolve(nodename, &addr);
+    if (ESP_ERR_NOT_FOUND == err) {
+        /* lwIP has just given up on the name, asking again would only wait as long once more */
+        return EAI_FAIL;
+    }
+    /* A numeric host makes getaddrinfo skip the resolver */
+    if (ESP_OK == err && NULL != ipaddr_ntoa_r(&addr, numeric, sizeof(numeric)) &&
+        0 == DNS_CACHE_GETADDRINFO(numeric, servname, hints, res)) {
+        return 0;
+    }
+
+    return DNS_CACHE_GETADDRINFO(nodename, servname, hints, res);
+}
+
+#ifdef CONFIG_DNS_CACHE_WRAP_GETADDRINFO
+/* Linked in place of lwip_getaddrinfo, see CMakeLists.txt */
+int __wrap_lwip_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                            struct addrinfo **res)
+{
+    return dns_cache_getaddrinfo(nodename, servname, hints, res);
+}
+#endif
+
+void dns_cache_get_stats(dns_cache_stats_t *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return stub_ticks;
+}
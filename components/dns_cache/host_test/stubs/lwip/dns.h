@@ -0,0 +1,12 @@
+#pragma once
+
+#include "lwip/ip_addr.h"
+
+typedef signed char err_t;
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *arg);
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *arg);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} ip_addr_t;
+
+#define IPADDR_STRLEN_MAX 16
+
+int ipaddr_aton(const char *cp, ip_addr_t *addr);
+char *ipaddr_ntoa_r(const ip_addr_t *addr, char *buf, int buflen);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <netdb.h>
+
+int lwip_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                     struct addrinfo **res);
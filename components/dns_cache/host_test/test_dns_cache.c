@@ -0,0 +1,320 @@
+/**
+ * @file test_dns_cache.c
+ * @brief Host test of the DNS cache against stubbed FreeRTOS and lwIP calls
+ *
+ * Time only moves when a test or a wait that times out moves it, and an
+ * answer arrives while a lookup waits for it, if the test says so. That covers
+ * the TTL, the last-known-good fallback and the sharing of a query without a
+ * target or a real resolver.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/* The statics of the cache are reset before each test */
+#include "dns_cache.c"
+
+#define TEST_HOST "broker.example.com"
+#define TEST_MS_PER_SEC 1000
+
+typedef enum {
+    TEST_DNS_PENDING,       /* The answer arrives through the callback, see xEventGroupWaitBits */
+    TEST_DNS_FAILING        /* dns_gethostbyname fails at once */
+} test_dns_mode_t;
+
+typedef enum {
+    TEST_WAIT_ANSWER,       /* The pending answer arrives during the wait */
+    TEST_WAIT_TIMEOUT       /* Nothing arrives, the wait takes all its ticks */
+} test_wait_mode_t;
+
+TickType_t stub_ticks;
+
+static test_dns_mode_t s_dnsMode;
+static test_wait_mode_t s_waitMode;
+static int s_queryCount;
+static int s_waitCount;
+static TickType_t s_lastWaitTicks;
+static dns_found_callback s_pendingFound;
+static void *s_pendingArg;
+static char s_pendingHost[CONFIG_DNS_CACHE_HOST_LEN + 1];
+static ip_addr_t s_answer;
+static int s_failures;
+
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);                 \
+            s_failures++;                                                       \
+            return;                                                             \
+        }                                                                       \
+    } while (0)
+
+int ipaddr_aton(const char *cp, ip_addr_t *addr)
+{
+    struct in_addr in;
+
+    if (1 != inet_pton(AF_INET, cp, &in)) {
+        return 0;
+    }
+    addr->addr = in.s_addr;
+    return 1;
+}
+
+char *ipaddr_ntoa_r(const ip_addr_t *addr, char *buf, int buflen)
+{
+    struct in_addr in;
+
+    in.s_addr = addr->addr;
+    return (char *) inet_ntop(AF_INET, &in, buf, (socklen_t) buflen);
+}
+
+int lwip_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                     struct addrinfo **res)
+{
+    (void) nodename;
+    (void) servname;
+    (void) hints;
+    (void) res;
+    return EAI_FAIL;
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *arg)
+{
+    (void) addr;
+
+    s_queryCount++;
+    if (TEST_DNS_FAILING == s_dnsMode) {
+        return ERR_ARG;
+    }
+    strcpy(s_pendingHost, hostname);
+    s_pendingFound = found;
+    s_pendingArg = arg;
+    return ERR_INPROGRESS;
+}
+
+/* The test runs on the tcpip thread as well */
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx)
+{
+    function(ctx);
+    return ERR_OK;
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer)
+{
+    buffer->bits = 0;
+    return buffer;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+
+    group->bits &= ~bits;
+    return before;
+}
+
+/* Answers the pending query */
+static void test_answer(const char *address)
+{
+    dns_found_callback found = s_pendingFound;
+
+    TEST_CHECK(NULL != found);
+    s_pendingFound = NULL;
+    ipaddr_aton(address, &s_answer);
+    found(s_pendingHost, &s_answer, s_pendingArg);
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticks)
+{
+    (void) clearOnExit;
+    (void) waitForAll;
+
+    s_waitCount++;
+    s_lastWaitTicks = ticks;
+    if (bits == (group->bits & bits)) {
+        /* Returning at once still takes a tick, a lookup that keeps waking up runs out of time instead of hanging */
+        stub_ticks++;
+    } else if (TEST_WAIT_ANSWER == s_waitMode && NULL != s_pendingFound) {
+        test_answer("10.0.0.2");
+    } else {
+        stub_ticks += ticks;
+    }
+    return group->bits;
+}
+
+static void test_reset(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_answers = NULL;
+    stub_ticks = 1;
+    s_dnsMode = TEST_DNS_PENDING;
+    s_waitMode = TEST_WAIT_ANSWER;
+    s_queryCount = 0;
+    s_waitCount = 0;
+    s_lastWaitTicks = 0;
+    s_pendingFound = NULL;
+}
+
+static bool test_is_addr(const ip_addr_t *addr, const char *address)
+{
+    ip_addr_t expected;
+
+    ipaddr_aton(address, &expected);
+    return expected.addr == addr->addr;
+}
+
+/* Resolves TEST_HOST to 10.0.0.1 and rewinds the counters */
+static void test_prime(void)
+{
+    ip_addr_t addr;
+
+    dns_cache_prefetch(TEST_HOST);
+    test_answer("10.0.0.1");
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_queryCount = 0;
+    s_waitCount = 0;
+}
+
+static void test_miss_blocks_until_the_answer(void)
+{
+    ip_addr_t addr;
+    TickType_t start = stub_ticks;
+
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.2"));
+    TEST_CHECK(1 == s_queryCount);
+    /* One wait that the answer ends, no polling */
+    TEST_CHECK(1 == s_waitCount);
+    TEST_CHECK(pdMS_TO_TICKS(DNS_CACHE_MISS_WAIT_MS) == s_lastWaitTicks);
+    TEST_CHECK(start == stub_ticks);
+}
+
+static void test_hit_within_ttl(void)
+{
+    ip_addr_t addr;
+
+    test_prime();
+    stub_ticks += CONFIG_DNS_CACHE_TTL_SEC * TEST_MS_PER_SEC - 1;
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.1"));
+    TEST_CHECK(0 == s_queryCount);
+    TEST_CHECK(0 == s_waitCount);
+    TEST_CHECK(1 == s_stats.hits);
+}
+
+static void test_refresh_after_ttl(void)
+{
+    ip_addr_t addr;
+
+    test_prime();
+    stub_ticks += CONFIG_DNS_CACHE_TTL_SEC * TEST_MS_PER_SEC;
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.2"));
+    TEST_CHECK(1 == s_queryCount);
+    TEST_CHECK(pdMS_TO_TICKS(CONFIG_DNS_CACHE_STALE_WAIT_MS) == s_lastWaitTicks);
+    TEST_CHECK(0 == s_stats.fallbacks);
+}
+
+static void test_slow_dns_falls_back(void)
+{
+    ip_addr_t addr;
+    TickType_t start;
+
+    test_prime();
+    stub_ticks += CONFIG_DNS_CACHE_TTL_SEC * TEST_MS_PER_SEC;
+    start = stub_ticks;
+    s_waitMode = TEST_WAIT_TIMEOUT;
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.1"));
+    TEST_CHECK(1 == s_stats.fallbacks);
+    /* The answer of the first query must not end the wait for the second */
+    TEST_CHECK(1 == s_waitCount);
+    TEST_CHECK(start + pdMS_TO_TICKS(CONFIG_DNS_CACHE_STALE_WAIT_MS) == stub_ticks);
+
+    /* A late answer still refreshes the cache */
+    test_answer("10.0.0.3");
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.3"));
+    TEST_CHECK(1 == s_queryCount);
+    TEST_CHECK(1 == s_stats.hits);
+}
+
+static void test_failed_query_falls_back(void)
+{
+    ip_addr_t addr;
+
+    test_prime();
+    stub_ticks += CONFIG_DNS_CACHE_MAX_STALE_SEC * TEST_MS_PER_SEC - 1;
+    s_dnsMode = TEST_DNS_FAILING;
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.1"));
+    TEST_CHECK(1 == s_stats.fallbacks);
+    TEST_CHECK(0 == s_waitCount);
+}
+
+static void test_too_stale_to_fall_back(void)
+{
+    ip_addr_t addr;
+
+    test_prime();
+    stub_ticks += CONFIG_DNS_CACHE_MAX_STALE_SEC * TEST_MS_PER_SEC;
+    s_dnsMode = TEST_DNS_FAILING;
+    TEST_CHECK(ESP_ERR_NOT_FOUND == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(0 == s_stats.fallbacks);
+    TEST_CHECK(1 == s_stats.failures);
+}
+
+static void test_lookups_share_a_query(void)
+{
+    ip_addr_t addr;
+
+    TEST_CHECK(ESP_OK == dns_cache_prefetch(TEST_HOST));
+    TEST_CHECK(ESP_OK == dns_cache_prefetch(TEST_HOST));
+    TEST_CHECK(1 == s_queryCount);
+    TEST_CHECK(ESP_OK == dns_cache_resolve(TEST_HOST, &addr));
+    TEST_CHECK(test_is_addr(&addr, "10.0.0.2"));
+    TEST_CHECK(1 == s_queryCount);
+    TEST_CHECK(1 == s_stats.queries);
+}
+
+static void test_numeric_host(void)
+{
+    ip_addr_t addr;
+
+    TEST_CHECK(ESP_OK == dns_cache_resolve("192.0.2.7", &addr));
+    TEST_CHECK(test_is_addr(&addr, "192.0.2.7"));
+    TEST_CHECK(0 == s_queryCount);
+}
+
+#define TEST_RUN(test)                                                          \
+    do {                                                                        \
+        int failuresBefore = s_failures;                                        \
+        test_reset();                                                           \
+        test();                                                                 \
+        printf("%s %s\n", failuresBefore == s_failures ? "ok  " : "FAIL", #test); \
+    } while (0)
+
+int main(void)
+{
+    TEST_RUN(test_miss_blocks_until_the_answer);
+    TEST_RUN(test_hit_within_ttl);
+    TEST_RUN(test_refresh_after_ttl);
+    TEST_RUN(test_slow_dns_falls_back);
+    TEST_RUN(test_failed_query_falls_back);
+    TEST_RUN(test_too_stale_to_fall_back);
+    TEST_RUN(test_lookups_share_a_query);
+    TEST_RUN(test_numeric_host);
+
+    printf("%d failure(s)\n", s_failures);
+    return (0 == s_failures) ? 0 : 1;
+}
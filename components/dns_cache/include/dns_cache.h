@@ -0,0 +1,95 @@
+/**
+ * @file dns_cache.h
+ * @brief Host name cache shared by the MQTT and HTTP connections
+ *
+ * Answers are kept for CONFIG_DNS_CACHE_TTL_SEC, so a reconnect within that
+ * time connects without asking DNS again. Once that has passed the next
+ * lookup asks lwIP again. If no answer arrives within
+ * CONFIG_DNS_CACHE_STALE_WAIT_MS, or the query fails, the last address that
+ * resolved is used for up to CONFIG_DNS_CACHE_MAX_STALE_SEC. A late answer
+ * still refreshes the cache.
+ *
+ * getaddrinfo does not report the TTL of a record. lwIP keeps each answer for
+ * its TTL underneath, so a refresh inside the record TTL costs no round trip.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "lwip/ip_addr.h"
+#include "lwip/netdb.h"
+
+/**
+ * @brief Counters of the cache, see dns_cache_get_stats
+ */
+typedef struct {
+    uint32_t hits;          /*!< Lookups answered from the cache without a query */
+    uint32_t queries;       /*!< Queries handed to lwIP */
+    uint32_t fallbacks;     /*!< Lookups answered with a stale address because DNS was slow or failing */
+    uint32_t failures;      /*!< Lookups without an answer and without an address to fall back to */
+} dns_cache_stats_t;
+
+/**
+ * @brief Resolve a host name through the cache
+ *
+ * Waits for DNS only on a miss, or for at most CONFIG_DNS_CACHE_STALE_WAIT_MS
+ * when the cached answer is older than CONFIG_DNS_CACHE_TTL_SEC. A numeric
+ * address is returned as it is.
+ *
+ * @param host Host name
+ * @param[out] addr Address of the host
+ *
+ * @return
+ *     - ESP_OK: addr holds a fresh or a last-known-good address
+ *     - ESP_ERR_INVALID_ARG: host or addr is NULL, or host is too long to cache
+ *     - ESP_ERR_NOT_FOUND: DNS gave no answer and nothing could stand in
+ *     - ESP_ERR_NO_MEM: every entry waits for an answer, host is not cached
+ */
+esp_err_t dns_cache_resolve(const char *host, ip_addr_t *addr);
+
+/**
+ * @brief Start resolving a host name without waiting for the answer
+ *
+ * Sends a query unless the cached answer is fresh or a query is already on
+ * its way. A later dns_cache_resolve of the host then waits only for what is
+ * left of that query, so several names can be looked up at the same time.
+ *
+ * @param host Host name
+ *
+ * @return
+ *     - ESP_OK: the answer is cached, on its way, or host is a numeric address
+ *     - ESP_ERR_INVALID_ARG: host is NULL or too long to cache
+ *     - ESP_ERR_NO_MEM: every entry waits for an answer, host is not cached
+ */
+esp_err_t dns_cache_prefetch(const char *host);
+
+/**
+ * @brief getaddrinfo answered from the cache
+ *
+ * Resolves nodename with dns_cache_resolve and hands the numeric address to
+ * getaddrinfo, so no query goes out. Anything the cache can't answer goes to
+ * getaddrinfo as it is. Free the result with freeaddrinfo.
+ *
+ * With CONFIG_DNS_CACHE_WRAP_GETADDRINFO every lwip_getaddrinfo of the
+ * firmware comes here. That includes esp-tls and so esp_http_client, which
+ * have no hook of their own for the resolver.
+ */
+int dns_cache_getaddrinfo(const char *nodename, const char *servname, const struct addrinfo *hints,
+                          struct addrinfo **res);
+
+/**
+ * @brief Read the counters of the cache
+ *
+ * @param[out] stats Counters since boot
+ */
+void dns_cache_get_stats(dns_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -156,7 +156,27 @@ typedef enum {
 	/** Some limit has been exceeded, e.g. the maximum number of subscriptions has been reached */
 			LIMIT_EXCEEDED_ERROR = -51,
 	/** Invalid input topic type */
-			INVALID_TOPIC_TYPE_ERROR = -52
+			INVALID_TOPIC_TYPE_ERROR = -52,
+	/** Semaphore initialization failed */
+			SEMAPHORE_INIT_ERROR = -53,
+	/** Semaphore was not signalled before the timeout expired */
+			SEMAPHORE_WAIT_TIMEOUT_ERROR = -54,
+	/** Semaphore destroy failed */
+			SEMAPHORE_DESTROY_ERROR = -55,
+	/** Publish queue has no free slot for a message of this priority, retry later */
+			MQTT_PUBLISH_QUEUE_FULL_ERROR = -56,
+	/** Session store has no room for another unacknowledged QoS1 message */
+			MQTT_SESSION_STORE_FULL_ERROR = -57,
+	/** MQTT 5 server has as many unacknowledged QoS1 messages as its receive maximum allows, retry after a PUBACK */
+			MQTT_RECEIVE_MAXIMUM_REACHED_ERROR = -58,
+	/** MQTT 5 server acknowledged the request with a failure reason code, see aws_iot_mqtt_get_last_reason_code() */
+			MQTT_REQUEST_REJECTED_ERROR = -59,
+	/** MQTT 5 server closed the connection with a DISCONNECT, see aws_iot_mqtt_get_last_reason_code() */
+			MQTT_SERVER_DISCONNECT_ERROR = -60,
+	/** Network capture sink could not store a record */
+			NETWORK_CAPTURE_WRITE_ERROR = -61,
+	/** Data given to the replay transport is not a network capture */
+			NETWORK_CAPTURE_FORMAT_ERROR = -62
 } IoT_Error_t;
 
 #ifdef __cplusplus
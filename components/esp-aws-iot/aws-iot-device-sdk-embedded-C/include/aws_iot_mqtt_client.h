@@ -64,6 +64,111 @@ extern "C" {
 /** Greatest packet identifier, per MQTT spec */
 #define MAX_PACKET_ID 65535
 
+#ifndef AWS_IOT_MQTT_RX_RING_BUF_LEN
+/** Size of the receive ring that buffers decrypted bytes ahead of MQTT packet framing */
+#define AWS_IOT_MQTT_RX_RING_BUF_LEN AWS_IOT_MQTT_RX_BUF_LEN
+#endif
+
+#if AWS_IOT_MQTT_RX_RING_BUF_LEN < AWS_IOT_MQTT_RX_BUF_LEN
+#error "AWS_IOT_MQTT_RX_RING_BUF_LEN must be at least AWS_IOT_MQTT_RX_BUF_LEN"
+#endif
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+#ifndef _ENABLE_THREAD_SUPPORT_
+#error "ENABLE_IOT_FULL_DUPLEX requires _ENABLE_THREAD_SUPPORT_"
+#endif
+#ifndef AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH
+/** Number of QoS1 publishes that can wait for their PUBACK at the same time in full-duplex mode */
+#define AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH 8
+#endif
+#endif
+
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+#ifndef AWS_IOT_MQTT_PUBLISH_QUEUE_LEN
+/** Number of messages the outbound publish queue can hold, including those waiting for a PUBACK */
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_LEN 8
+#endif
+#ifndef AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN
+/** Bytes of topic plus payload a queue slot can hold when the message is copied */
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN 256
+#endif
+#ifndef AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED
+/** Queue slots only high priority messages may use, so a bulk backlog can't lock out alarms */
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED 2
+#endif
+#ifndef AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS
+/** Longest time an idle yield sleeps before it looks for messages queued by other tasks, if the network has no wakeUp */
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS 10
+#endif
+#if AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED >= AWS_IOT_MQTT_PUBLISH_QUEUE_LEN
+#error "AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED must be smaller than AWS_IOT_MQTT_PUBLISH_QUEUE_LEN"
+#endif
+#endif
+
+#ifdef ENABLE_IOT_DISPATCH_POOL
+#ifndef AWS_IOT_MQTT_DISPATCH_SLOTS
+/** Received messages that can wait for or be in a dispatch worker at the same time, shared by all subscriptions */
+#define AWS_IOT_MQTT_DISPATCH_SLOTS 8
+#endif
+#ifndef AWS_IOT_MQTT_DISPATCH_SLOT_LEN
+/** Bytes of topic plus payload a dispatch slot can hold, longer messages are dropped */
+#define AWS_IOT_MQTT_DISPATCH_SLOT_LEN 256
+#endif
+#ifndef AWS_IOT_MQTT_DISPATCH_QUEUE_LEN
+/** Messages one dispatched subscription can have waiting, its overflow policy applies beyond that */
+#define AWS_IOT_MQTT_DISPATCH_QUEUE_LEN 4
+#endif
+#ifndef AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS
+/** Longest time the reader waits for room in a DISPATCH_BLOCK queue before dropping the message */
+#define AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS 100
+#endif
+#if AWS_IOT_MQTT_DISPATCH_SLOTS > 255 || AWS_IOT_MQTT_DISPATCH_QUEUE_LEN > 255
+#error "AWS_IOT_MQTT_DISPATCH_SLOTS and AWS_IOT_MQTT_DISPATCH_QUEUE_LEN must not exceed 255"
+#endif
+#endif
+
+#ifdef ENABLE_IOT_WRITE_COALESCING
+#ifndef AWS_IOT_MQTT_COALESCE_BUF_LEN
+/** Bytes of small packets yield collects into one network write, keep a TLS record within one TCP segment */
+#define AWS_IOT_MQTT_COALESCE_BUF_LEN 1400
+#endif
+#endif
+
+#ifdef ENABLE_IOT_MQTT5
+#ifndef AWS_IOT_MQTT5_TOPIC_ALIASES
+/** Topics the client binds to an alias per connection, the server's Topic Alias Maximum may lower it */
+#define AWS_IOT_MQTT5_TOPIC_ALIASES 8
+#endif
+#ifndef AWS_IOT_MQTT5_TOPIC_ALIAS_LEN
+/** Longest topic name that gets an alias, each alias keeps a copy of its topic */
+#define AWS_IOT_MQTT5_TOPIC_ALIAS_LEN 64
+#endif
+#ifndef AWS_IOT_MQTT5_RECEIVE_MAXIMUM
+/** QoS1 messages the server may send before it waits for their PUBACKs, announced in CONNECT */
+#define AWS_IOT_MQTT5_RECEIVE_MAXIMUM 16
+#endif
+#ifndef AWS_IOT_MQTT5_SESSION_EXPIRY_SEC
+/** Session Expiry Interval announced when isCleanSession is false, the default keeps the session like MQTT 3.1.1 does */
+#define AWS_IOT_MQTT5_SESSION_EXPIRY_SEC 0xFFFFFFFF
+#endif
+#if AWS_IOT_MQTT5_TOPIC_ALIASES < 1 || AWS_IOT_MQTT5_TOPIC_ALIASES > 65535
+#error "AWS_IOT_MQTT5_TOPIC_ALIASES must be between 1 and 65535"
+#endif
+#endif
+
+#ifndef DISABLE_IOT_STATS
+#ifndef AWS_IOT_MQTT_STATS_HISTOGRAM_BUCKETS
+/** Buckets of the duration histograms, the last one counts everything from 2^(buckets-2) ms up */
+#define AWS_IOT_MQTT_STATS_HISTOGRAM_BUCKETS 16
+#endif
+#ifndef AWS_IOT_MQTT_STATS_MAX_TRACKED_PUBACKS
+/** QoS1 messages whose PUBACK round trip is timed at the same time, the oldest is dropped when full */
+#define AWS_IOT_MQTT_STATS_MAX_TRACKED_PUBACKS 8
+#endif
+/** Number of MQTT control packet types, packet counters are indexed by type */
+#define AWS_IOT_MQTT_STATS_PACKET_TYPES 16
+#endif
+
 typedef struct _Client AWS_IoT_Client;
 
 /**
@@ -93,14 +198,33 @@ typedef struct {
 	size_t payloadLen;	///< Length of MQTT payload.
 } IoT_Publish_Message_Params;
 
+/**
+ * @brief Publish Template Type
+ *
+ * Topic and flags of a PUBLISH, encoded once by aws_iot_mqtt_publish_template_init() for
+ * topics that are published to over and over. Sending with a template only writes the
+ * remaining length, packet identifier and payload behind the pre-encoded part.
+ */
+typedef struct {
+	const char *pTopicName;	///< Topic name, not copied
+	uint16_t topicNameLen;	///< Length of the topic name
+	QoS qos;		///< Message Quality of Service
+	unsigned char header;	///< Fixed header byte, DUP flag cleared
+	unsigned char topicNameLenBytes[2];	///< Topic name length as encoded on the wire
+	uint32_t fixedRemLen;	///< Remaining length without the payload
+} IoT_Publish_Template;
+
 /**
  * @brief MQTT Version Type
  *
- * Defining an MQTT version type. Only 3.1.1 is supported at this time
+ * Defining an MQTT version type. MQTT 5 is available when the SDK is built with ENABLE_IOT_MQTT5
  *
  */
 typedef enum {
-	MQTT_3_1_1 = 4    ///< MQTT 3.1.1 (protocol message byte = 4)
+	MQTT_3_1_1 = 4,    ///< MQTT 3.1.1 (protocol message byte = 4)
+#ifdef ENABLE_IOT_MQTT5
+	MQTT_5 = 5    ///< MQTT 5 (protocol message byte = 5)
+#endif
 } MQTT_Ver_t;
 
 /**
@@ -180,6 +304,15 @@ typedef struct {
 	bool isSSLHostnameVerify;			///< Client should perform server certificate hostname validation
 	iot_disconnect_handler disconnectHandler;	///< Callback to be invoked upon connection loss
 	void *disconnectHandlerData;			///< Data to pass as argument when disconnect handler is called
+	TLSEndpoint *pEndpoints;			///< Optional. Endpoints raced against each other on every connect, pHostURL and port may then be left empty. Not copied, must stay valid while the client is used
+	uint8_t endpointCount;				///< Number of entries in pEndpoints
+	uint32_t endpointRaceDelay_ms;			///< Head start of each endpoint before the next one is tried as well. In milliseconds
+	size_t rootCALen;				///< Optional. Bytes at pRootCALocation when it is a PEM or DER credential in memory, see aws_iot_mqtt_init. 0 for a file or a NUL terminated PEM string
+	size_t deviceCertLen;				///< Optional. Bytes at pDeviceCertLocation, as rootCALen
+	size_t devicePrivateKeyLen;			///< Optional. Bytes at pDevicePrivateKeyLocation, as rootCALen
+	uint8_t tlsProfile;				///< IoT_TLS_Profile bits, 0 for the mbedTLS defaults
+	IoT_Network_Transport transport;		///< Transport to connect through. Plain TCP needs ENABLE_IOT_PLAIN_TCP, takes no credentials and uses tlsHandshakeTimeout_ms as the connect timeout
+	IoT_TCP_Options tcpOptions;			///< Socket options of the plain TCP transport
 #ifdef _ENABLE_THREAD_SUPPORT_
 	bool isBlockOnThreadLockEnabled;		///< Timeout for Thread blocking calls. Set to 0 to block until lock is obtained. In milliseconds
 #endif
@@ -189,9 +322,76 @@ extern const IoT_Client_Init_Params iotClientInitParamsDefault;
 
 /** Default initializer for client */
 #ifdef _ENABLE_THREAD_SUPPORT_
-#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, false }
+#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, NULL, 0, 250, 0, 0, 0, 0, \
+        IOT_NETWORK_TRANSPORT_TLS, IoT_TCP_Options_initializer, false }
 #else
-#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL }
+#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, NULL, 0, 250, 0, 0, 0, 0, \
+        IOT_NETWORK_TRANSPORT_TLS, IoT_TCP_Options_initializer }
+#endif
+
+/**
+ * @brief MQTT Session Store
+ *
+ * Keeps serialized QoS1 PUBLISH packets from the moment they are sent until their
+ * PUBACK arrives. The client sends whatever is still stored again, with the DUP flag,
+ * after each successful connect. A store backed by flash also covers reboots.
+ *
+ * In full-duplex mode save and remove may run concurrently from different tasks.
+ */
+typedef struct {
+	/** Store a packet, replacing one stored earlier with the same packet id */
+	IoT_Error_t (*save)(void *pContext, uint16_t packetId, const unsigned char *pPacket, size_t packetLen);
+	/** Forget the packet with this packet id, if stored */
+	void (*remove)(void *pContext, uint16_t packetId);
+	/** Copy the index-th stored packet into pBuf, sets *pPacketLen to 0 past the last one */
+	IoT_Error_t (*load)(void *pContext, uint32_t index, uint16_t *pPacketId, unsigned char *pBuf, size_t bufLen,
+						size_t *pPacketLen);
+	void *pContext; ///< Passed to every store function
+} IoT_MQTT_Session_Store;
+
+#ifndef DISABLE_IOT_STATS
+/**
+ * @brief Duration Histogram
+ *
+ * Bucket 0 counts durations of 0 ms, bucket n those from 2^(n-1) up to 2^n - 1 ms.
+ * Resolution is that of the platform timer.
+ */
+typedef struct {
+	uint32_t count; ///< Number of recorded durations
+	uint32_t maxMs; ///< Longest recorded duration
+	uint64_t totalMs; ///< Sum of all recorded durations
+	uint32_t buckets[AWS_IOT_MQTT_STATS_HISTOGRAM_BUCKETS]; ///< Durations per power of two
+} IoT_Client_Stats_Histogram;
+
+/**
+ * @brief MQTT Client Statistics
+ *
+ * Traffic and latency counters of a client, see @ref mqtt_function_get_stats.
+ */
+typedef struct {
+	uint64_t bytesIn; ///< Bytes of MQTT packets received, including dropped ones
+	uint64_t bytesOut; ///< Bytes of MQTT packets sent
+	uint32_t packetsIn[AWS_IOT_MQTT_STATS_PACKET_TYPES]; ///< Packets received, indexed by control packet type
+	uint32_t packetsOut[AWS_IOT_MQTT_STATS_PACKET_TYPES]; ///< Packets handed to the network, indexed by control packet type
+	uint32_t droppedOversized; ///< Received packets dropped because they didn't fit the read buffer
+	uint32_t droppedDispatch; ///< Received messages a dispatched subscription dropped, see IoT_Dispatch_Policy
+	IoT_Client_Stats_Histogram pubackRtt; ///< Time from sending a QoS1 PUBLISH until its PUBACK arrived
+	IoT_Client_Stats_Histogram handshake; ///< Duration of successful network connects, TCP and TLS
+	IoT_Client_Stats_Histogram connack; ///< Time from sending CONNECT until an accepting CONNACK arrived
+	uint32_t yieldCalls; ///< Calls of aws_iot_mqtt_yield that got past the argument checks
+	uint64_t yieldMs; ///< Time spent in aws_iot_mqtt_yield
+	uint64_t yieldSleepMs; ///< Part of yieldMs spent waiting for the network to become readable
+} IoT_Client_Stats;
+
+/**
+ * @brief PUBACK Round Trip Tracker
+ *
+ * Send time of a QoS1 PUBLISH, kept until its PUBACK arrives.
+ */
+typedef struct {
+	uint16_t packetId; ///< Packet identifier of the PUBLISH, 0 when the entry is free
+	Timer sentStopwatch; ///< Started when the PUBLISH was handed to the network
+} PubackRttTracker;
 #endif
 
 /**
@@ -254,8 +454,150 @@ typedef struct _ClientStatus {
 	ClientState clientState; ///< The current state of the client's state machine
 	bool isPingOutstanding; ///< Whether this client is waiting for a ping response
 	bool isAutoReconnectEnabled; ///< Whether auto-reconnect is enabled for this client
+	bool isSessionPresent; ///< Whether the broker resumed a stored session on the last connect
+#ifdef ENABLE_IOT_MQTT5
+	uint8_t lastReasonCode; ///< MQTT 5 reason code of the last CONNACK, acknowledgement or DISCONNECT received
+#endif
 } ClientStatus;
 
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+/**
+ * @brief Publish Queue Priority Type
+ *
+ * High priority messages are always sent before normal ones that are still queued.
+ *
+ */
+typedef enum {
+	PUBLISH_PRIORITY_HIGH = 0, ///< Health, alarm and other messages that must not wait behind a backlog
+	PUBLISH_PRIORITY_NORMAL = 1 ///< Telemetry and bulk backlog replay
+} IoT_Publish_Priority;
+
+/**
+ * @brief Queued Publish Completion Handler Type
+ *
+ * Called from the task running yield once a queued message was handed to the network
+ * (QoS0), acknowledged (QoS1), or failed.
+ *
+ * @param pClient MQTT client the message was queued on
+ * @param pParams The queued message. payload points at the caller's buffer for zero-copy messages
+ * @param result SUCCESS or the reason the message was dropped
+ * @param pData Context passed when the message was queued
+ */
+typedef void (*pApplicationPublishCompleteHandler_t)(AWS_IoT_Client *pClient, IoT_Publish_Message_Params *pParams,
+													  IoT_Error_t result, void *pData);
+
+/**
+ * @brief Publish Queue Parameters Type
+ *
+ * Defines how a message is queued by aws_iot_mqtt_publish_async
+ *
+ */
+typedef struct {
+	IoT_Publish_Priority priority; ///< Send order class of the message
+	bool isZeroCopy; ///< Queue the caller's topic and payload instead of copying them. They must stay valid until the completion handler runs
+	pApplicationPublishCompleteHandler_t pCompleteHandler; ///< Called when the message completes, may be NULL
+	void *pCompleteHandlerData; ///< Context passed to the completion handler
+} IoT_Publish_Queue_Params;
+
+extern const IoT_Publish_Queue_Params iotPublishQueueParamsDefault;
+
+#define IoT_Publish_Queue_Params_initializer { PUBLISH_PRIORITY_NORMAL, false, NULL, NULL }
+
+/** State of a publish queue slot */
+typedef enum {
+	PUBLISH_QUEUE_SLOT_FREE = 0, ///< Unused
+	PUBLISH_QUEUE_SLOT_PENDING, ///< Waiting to be sent
+	PUBLISH_QUEUE_SLOT_INFLIGHT, ///< Sent, QoS1 waiting for PUBACK
+	PUBLISH_QUEUE_SLOT_COMPLETING ///< Completion handler is running
+} PublishQueueSlotState;
+
+/**
+ * @brief Outbound publish queue entry
+ */
+typedef struct _PublishQueueSlot {
+	PublishQueueSlotState state; ///< Where the message is in its life cycle
+	IoT_Publish_Priority priority; ///< Send order class
+	uint32_t sequence; ///< Enqueue order, messages of the same priority are sent oldest first
+	const char *pTopicName; ///< Topic, points into buf unless zero-copy
+	uint16_t topicNameLen; ///< Length of the topic
+	IoT_Publish_Message_Params params; ///< Message, payload points into buf unless zero-copy
+	Timer ackTimer; ///< Time left for the PUBACK of an in-flight QoS1 message
+	pApplicationPublishCompleteHandler_t pCompleteHandler; ///< Completion handler
+	void *pCompleteHandlerData; ///< Context for the completion handler
+	unsigned char buf[AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN]; ///< Copy of topic and payload
+} PublishQueueSlot;
+#endif
+
+#ifdef ENABLE_IOT_DISPATCH_POOL
+/**
+ * @brief Subscription Dispatch Policy Type
+ *
+ * How messages of a subscription reach its handler, see @ref mqtt_function_set_dispatch_policy.
+ *
+ */
+typedef enum {
+	DISPATCH_INLINE = 0, ///< Handler runs inside yield, the default
+	DISPATCH_DROP_OLDEST = 1, ///< Queued for a worker, a full queue drops its oldest message
+	DISPATCH_DROP_NEWEST = 2, ///< Queued for a worker, a full queue drops the message just received
+	DISPATCH_BLOCK = 3 ///< Queued for a worker, the reader waits up to AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS for room
+} IoT_Dispatch_Policy;
+
+/**
+ * @brief Received message waiting for a dispatch worker
+ */
+typedef struct _DispatchSlot {
+	pApplicationHandler_t pApplicationHandler; ///< Handler of the subscription when the message arrived
+	void *pApplicationHandlerData; ///< Context for the handler
+	uint16_t topicNameLen; ///< Length of the topic at the start of buf
+	IoT_Publish_Message_Params params; ///< Message, payload points into buf
+	unsigned char buf[AWS_IOT_MQTT_DISPATCH_SLOT_LEN]; ///< Copy of topic and payload
+} DispatchSlot;
+
+/**
+ * @brief Messages of one subscription waiting for a dispatch worker
+ *
+ * Indexed like the message handlers. A subscription is handled by one worker at a time
+ * so its messages keep their order.
+ */
+typedef struct _DispatchQueue {
+	IoT_Dispatch_Policy policy; ///< How messages of the subscription are delivered
+	bool isBusy; ///< A worker is running the handler for one of its messages
+	uint8_t head; ///< Position of the oldest waiting message in slots
+	uint8_t count; ///< Number of waiting messages
+	uint8_t slots[AWS_IOT_MQTT_DISPATCH_QUEUE_LEN]; ///< Indices into the client's dispatch slots, oldest first from head
+} DispatchQueue;
+#endif
+
+#ifdef ENABLE_IOT_MQTT5
+/**
+ * @brief MQTT 5 Topic Alias
+ *
+ * Topic the client bound to an alias on the current connection. Alias n is kept at
+ * index n - 1 of the client's table.
+ */
+typedef struct _Mqtt5TopicAlias {
+	uint16_t topicNameLen; ///< Length of the topic name
+	char topicName[AWS_IOT_MQTT5_TOPIC_ALIAS_LEN]; ///< Copy of the topic name
+} Mqtt5TopicAlias;
+#endif
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+/**
+ * @brief Publisher waiting for a PUBACK
+ *
+ * In full-duplex mode the task reading from the network hands acknowledgements
+ * over to the publishing tasks through this table.
+ */
+typedef struct _AckWaiter {
+	uint16_t packetId; ///< Packet identifier being waited for, 0 when the slot is free
+	bool isAcked; ///< Set by the reader once the matching PUBACK has arrived
+#ifdef ENABLE_IOT_MQTT5
+	bool isRejected; ///< The PUBACK carried an MQTT 5 failure reason code
+#endif
+	IoT_Semaphore_t ackSem; ///< Signalled when the PUBACK arrives or the connection is torn down
+} AckWaiter;
+#endif
+
 /**
  * @brief MQTT Client Data
  *
@@ -277,9 +619,14 @@ typedef struct _ClientData {
 	 * afterwards */
 	size_t writeBufSize; ///< Size of this client's outgoing data buffer
 	size_t readBufSize; ///< Size of this client's incoming data buffer
-	size_t readBufIndex; ///< Current offset into the incoming data buffer
+	size_t rxRingSize; ///< Size of this client's receive ring
 	unsigned char writeBuf[AWS_IOT_MQTT_TX_BUF_LEN]; ///< Buffer for outgoing data
-	unsigned char readBuf[AWS_IOT_MQTT_RX_BUF_LEN]; ///< Buffer for incoming data
+	unsigned char readBuf[AWS_IOT_MQTT_RX_BUF_LEN]; ///< Buffer holding the packet currently being processed
+
+	size_t rxRingHead; ///< Offset of the oldest unconsumed byte in the receive ring
+	size_t rxRingFill; ///< Number of received bytes not yet framed into a packet
+	size_t rxDiscardLen; ///< Bytes still to be dropped from an oversized incoming packet
+	unsigned char rxRing[AWS_IOT_MQTT_RX_RING_BUF_LEN]; ///< Receive ring filled from the network ahead of packet framing
 
 #ifdef _ENABLE_THREAD_SUPPORT_
 	bool isBlockOnThreadLockEnabled; ///< Whether to use nonblocking or blocking mutex APIs
@@ -287,12 +634,56 @@ typedef struct _ClientData {
 	IoT_Mutex_t tls_read_mutex; ///< Mutex protecting incoming data
 	IoT_Mutex_t tls_write_mutex; ///< Mutex protecting outgoing data
 #endif
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	IoT_Mutex_t ack_waiter_mutex; ///< Mutex protecting the PUBACK waiter table
+	AckWaiter ackWaiters[AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH]; ///< QoS1 publishes waiting for their PUBACK
+#endif
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t publish_queue_mutex; ///< Mutex protecting the publish queue
+#endif
+	uint32_t publishQueueSequence; ///< Sequence number given to the next queued message
+	PublishQueueSlot publishQueue[AWS_IOT_MQTT_PUBLISH_QUEUE_LEN]; ///< Outbound messages waiting for yield
+#endif
+#ifdef ENABLE_IOT_DISPATCH_POOL
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t dispatch_mutex; ///< Mutex protecting the dispatch slots and queues
+	IoT_Semaphore_t dispatchWorkSem; ///< Signalled when a message is queued for the workers
+	IoT_Semaphore_t dispatchSpaceSem; ///< Signalled when a worker frees a dispatch slot
+#endif
+	uint8_t dispatchNextQueue; ///< Queue the next worker looks at first, so busy subscriptions can't starve others
+	uint8_t dispatchFreeCount; ///< Number of entries in dispatchFree
+	uint8_t dispatchFree[AWS_IOT_MQTT_DISPATCH_SLOTS]; ///< Indices of unused dispatch slots
+	DispatchSlot dispatchSlots[AWS_IOT_MQTT_DISPATCH_SLOTS]; ///< Received messages copied for the workers
+	DispatchQueue dispatchQueues[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS]; ///< Waiting messages per subscription
+#endif
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	bool isWriteCorked; ///< Whether small packets are collected instead of written, set while yield runs
+	size_t coalesceLen; ///< Bytes waiting in coalesceBuf
+	unsigned char coalesceBuf[AWS_IOT_MQTT_COALESCE_BUF_LEN]; ///< Small packets waiting for a single network write
+#endif
+#ifdef ENABLE_IOT_MQTT5
+	uint32_t serverReceiveMax; ///< QoS1 publishes the server takes unacknowledged, from the CONNACK
+	uint32_t inflightPublishes; ///< QoS1 publishes sent on this connection and not acknowledged yet
+	uint16_t topicAliasMax; ///< Aliases usable on this connection, the lower of the server's and AWS_IOT_MQTT5_TOPIC_ALIASES
+	uint16_t topicAliasCount; ///< Aliases bound so far on this connection
+	Mqtt5TopicAlias topicAliases[AWS_IOT_MQTT5_TOPIC_ALIASES]; ///< Topics bound to aliases
+#endif
+#ifndef DISABLE_IOT_STATS
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t stats_mutex; ///< Mutex protecting the histograms and PUBACK trackers
+#endif
+	IoT_Client_Stats stats; ///< Traffic and latency counters
+	uint32_t nextPubackTracker; ///< PUBACK tracker to use for the next QoS1 PUBLISH
+	PubackRttTracker pubackTrackers[AWS_IOT_MQTT_STATS_MAX_TRACKED_PUBACKS]; ///< QoS1 messages being timed
+#endif
 
 	IoT_Client_Connect_Params options; ///< Options passed when the client was initialized
 
 	MessageHandlers messageHandlers[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS]; ///< Callbacks for incoming messages
 	iot_disconnect_handler disconnectHandler; ///< Callback when a disconnection is detected
 	void *disconnectHandlerData; ///< Context for disconnect handler
+	const IoT_MQTT_Session_Store *pSessionStore; ///< Store for unacknowledged QoS1 messages, NULL if none
 } ClientData;
 
 /**
@@ -318,9 +709,14 @@ struct _Client {
  * @functionpage{aws_iot_mqtt_get_client_state,mqtt,get_client_state}
  * @functionpage{aws_iot_is_autoreconnect_enabled,mqtt,is_autoreconnect_enabled}
  * @functionpage{aws_iot_mqtt_set_disconnect_handler,mqtt,set_disconnect_handler}
+ * @functionpage{aws_iot_mqtt_set_session_store,mqtt,set_session_store}
+ * @functionpage{aws_iot_mqtt_is_session_present,mqtt,is_session_present}
+ * @functionpage{aws_iot_mqtt_get_last_reason_code,mqtt,get_last_reason_code}
  * @functionpage{aws_iot_mqtt_autoreconnect_set_status,mqtt,autoreconnect_set_status}
  * @functionpage{aws_iot_mqtt_get_network_disconnected_count,mqtt,get_network_disconnected_count}
  * @functionpage{aws_iot_mqtt_reset_network_disconnected_count,mqtt,reset_network_disconnected_count}
+ * @functionpage{aws_iot_mqtt_get_stats,mqtt,get_stats}
+ * @functionpage{aws_iot_mqtt_reset_stats,mqtt,reset_stats}
  */
 
 /**
@@ -436,6 +832,64 @@ IoT_Error_t aws_iot_mqtt_set_disconnect_handler(AWS_IoT_Client *pClient, iot_dis
 												void *pDisconnectHandlerData);
 /* @[declare_mqtt_set_disconnect_handler] */
 
+/**
+ * @brief Set the store for unacknowledged QoS1 messages of an MQTT client context.
+ *
+ * QoS1 messages published with @ref mqtt_function_publish are saved in the store
+ * before they are sent and removed when their PUBACK arrives. After every successful
+ * connect the client sends the messages still in the store again with the DUP flag,
+ * so a dropped connection or a reboot doesn't lose them. They are resent even when
+ * the broker didn't keep the session, in which case it sees them as new messages.
+ *
+ * Use it together with isCleanSession set to false in the connect parameters, so the
+ * broker also keeps the subscriptions and the messages it still has to deliver.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] pSessionStore Session store, NULL to stop storing messages. Must stay
+ * valid while it is set.
+ *
+ * @return Returns NULL_VALUE_ERROR if provided a bad parameter; otherwise, always
+ * returns SUCCESS.
+ *
+ * @warning Do not call this function while a connect or publish is in progress.
+ */
+/* @[declare_mqtt_set_session_store] */
+IoT_Error_t aws_iot_mqtt_set_session_store(AWS_IoT_Client *pClient, const IoT_MQTT_Session_Store *pSessionStore);
+/* @[declare_mqtt_set_session_store] */
+
+/**
+ * @brief Determine if the broker resumed a stored session on the last connect.
+ *
+ * When it did, subscriptions made earlier are still active and the client skips
+ * resubscribing after an automatic reconnect.
+ *
+ * @param[in] pClient MQTT client context
+ *
+ * @return true if the last CONNACK had the session present flag set; false otherwise.
+ */
+/* @[declare_mqtt_is_session_present] */
+bool aws_iot_mqtt_is_session_present(AWS_IoT_Client *pClient);
+/* @[declare_mqtt_is_session_present] */
+
+#ifdef ENABLE_IOT_MQTT5
+/**
+ * @brief Get the reason code the server sent last on an MQTT 5 connection.
+ *
+ * Calls that fail with MQTT_REQUEST_REJECTED_ERROR or MQTT_SERVER_DISCONNECT_ERROR
+ * leave the server's reason here, e.g. 0x87 (Not authorized) for a PUBACK of a
+ * publish the policy doesn't allow.
+ *
+ * @param[in] pClient MQTT client context
+ *
+ * @return Reason code of the last CONNACK, PUBACK, SUBACK, UNSUBACK or DISCONNECT
+ * received, 0 (Success) if none was received on this connection, 0x80 (Unspecified
+ * error) if pClient is NULL.
+ */
+/* @[declare_mqtt_get_last_reason_code] */
+uint8_t aws_iot_mqtt_get_last_reason_code(AWS_IoT_Client *pClient);
+/* @[declare_mqtt_get_last_reason_code] */
+#endif
+
 /**
  * @brief Enable or disable auto-reconnect for an initialized MQTT client context.
  *
@@ -483,6 +937,36 @@ uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient);
 void aws_iot_mqtt_reset_network_disconnected_count(AWS_IoT_Client *pClient);
 /* @[declare_mqtt_reset_network_disconnected_count] */
 
+#ifndef DISABLE_IOT_STATS
+/**
+ * @brief Get the traffic and latency statistics of an MQTT client context.
+ *
+ * Counters are updated by the tasks sending and receiving without extra locking, so
+ * a snapshot taken while they run may be off by the packet in flight. The histograms
+ * are copied consistently. Define DISABLE_IOT_STATS to compile statistics out.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[out] pStats Statistics since the client was initialized or last reset
+ *
+ * @return Returns NULL_VALUE_ERROR if provided a bad parameter; otherwise, always
+ * returns SUCCESS.
+ */
+/* @[declare_mqtt_get_stats] */
+IoT_Error_t aws_iot_mqtt_get_stats(AWS_IoT_Client *pClient, IoT_Client_Stats *pStats);
+/* @[declare_mqtt_get_stats] */
+
+/**
+ * @brief Reset the statistics of an MQTT client context to zero.
+ *
+ * QoS1 messages already waiting for their PUBACK are still timed.
+ *
+ * @param[in] pClient MQTT client context
+ */
+/* @[declare_mqtt_reset_stats] */
+void aws_iot_mqtt_reset_stats(AWS_IoT_Client *pClient);
+/* @[declare_mqtt_reset_stats] */
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -48,6 +48,7 @@ extern "C" {
 #include <string.h>
 
 #include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_trace.h"
 
 /** Types of MQTT messages */
 typedef enum msgTypes {
@@ -105,10 +106,28 @@ void aws_iot_mqtt_internal_write_utf8_string(unsigned char **pptr, const char *s
 
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient );
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer);
+IoT_Error_t aws_iot_mqtt_internal_send_packet_deferred(AWS_IoT_Client *pClient, size_t length, Timer *pTimer);
+#ifdef ENABLE_IOT_WRITE_COALESCING
+IoT_Error_t aws_iot_mqtt_internal_flush_writes(AWS_IoT_Client *pClient);
+#endif
 IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType);
 IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t packetType, Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_serialize_zero(unsigned char *pTxBuf, size_t txBufLen,
 												 MessageTypes packetType, size_t *pSerializedLength);
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBuf, size_t txBufLen, uint8_t dup,
+													 QoS qos, uint8_t retained, uint16_t packetId,
+													 const char *pTopicName, uint16_t topicNameLen,
+													 const unsigned char *pPayload, size_t payloadLen,
+													 uint32_t *pSerializedLen);
+IoT_Error_t aws_iot_mqtt_internal_serialize_client_publish(AWS_IoT_Client *pClient, unsigned char *pTxBuf,
+															size_t txBufLen, const IoT_Publish_Template *pTemplate,
+															uint8_t dup, uint16_t packetId,
+															const unsigned char *pPayload, size_t payloadLen,
+															bool isAliasAllowed, uint32_t *pSerializedLen);
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish_template(unsigned char *pTxBuf, size_t txBufLen,
+															  const IoT_Publish_Template *pTemplate, uint8_t dup,
+															  uint16_t packetId, const unsigned char *pPayload,
+															  size_t payloadLen, uint32_t *pSerializedLen);
 IoT_Error_t aws_iot_mqtt_internal_deserialize_publish(uint8_t *dup, QoS *qos,
 													  uint8_t *retained, uint16_t *pPacketId,
 													  char **pTopicName, uint16_t *topicNameLen,
@@ -126,6 +145,102 @@ IoT_Error_t aws_iot_mqtt_client_unlock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_
 
 #endif
 
+IoT_Error_t aws_iot_mqtt_internal_lock_write_buf(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_unlock_write_buf(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_network_connect(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_network_close(AWS_IoT_Client *pClient);
+
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+
+IoT_Error_t aws_iot_mqtt_internal_init_publish_queue(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_destroy_publish_queue(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_drain_publish_queue(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_publish_queue_ack(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t result);
+void aws_iot_mqtt_internal_publish_queue_disconnected(AWS_IoT_Client *pClient, bool isFreeingClient);
+uint32_t aws_iot_mqtt_internal_publish_queue_wait_ms(AWS_IoT_Client *pClient);
+
+#endif
+
+#ifdef ENABLE_IOT_DISPATCH_POOL
+
+IoT_Error_t aws_iot_mqtt_internal_init_dispatch(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_destroy_dispatch(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_dispatch_message(AWS_IoT_Client *pClient, uint32_t handlerIndex, const char *pTopicName,
+											uint16_t topicNameLen, const IoT_Publish_Message_Params *pParams);
+void aws_iot_mqtt_internal_dispatch_unsubscribed(AWS_IoT_Client *pClient, uint32_t handlerIndex);
+
+#endif
+
+#ifdef ENABLE_IOT_MQTT5
+
+/** Whether the client connects, or is connected, with MQTT 5 */
+#define AWS_IOT_MQTT_IS_MQTT5(pClient) (MQTT_5 == (pClient)->clientData.options.MQTTVersion)
+
+/** Reason codes from here on report a failure, MQTT 5 specification 2.4 */
+#define MQTT5_REASON_FAILURE 0x80
+/** Reason code reported for a received packet that can't be parsed */
+#define MQTT5_REASON_MALFORMED_PACKET 0x81
+
+/* Property identifiers, MQTT 5 specification 2.2.2.2 */
+#define MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL 0x11 /**< Four byte integer */
+#define MQTT5_PROPERTY_SERVER_KEEP_ALIVE 0x13 /**< Two byte integer */
+#define MQTT5_PROPERTY_RECEIVE_MAXIMUM 0x21 /**< Two byte integer */
+#define MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM 0x22 /**< Two byte integer */
+#define MQTT5_PROPERTY_TOPIC_ALIAS 0x23 /**< Two byte integer */
+#define MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE 0x27 /**< Four byte integer */
+
+void aws_iot_mqtt_internal_mqtt5_reset(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_write_uint_32(unsigned char **pptr, uint32_t anInt);
+IoT_Error_t aws_iot_mqtt_internal_mqtt5_read_property(unsigned char **pptr, unsigned char *pEnd,
+													  uint8_t *pPropertyId, uint32_t *pValue);
+IoT_Error_t aws_iot_mqtt_internal_mqtt5_skip_properties(unsigned char **pptr, unsigned char *pEnd);
+uint8_t aws_iot_mqtt_internal_mqtt5_reason_code(unsigned char *pRxBuf);
+uint16_t aws_iot_mqtt_internal_mqtt5_find_topic_alias(AWS_IoT_Client *pClient, const char *pTopicName,
+													  uint16_t topicNameLen);
+uint16_t aws_iot_mqtt_internal_mqtt5_bind_topic_alias(AWS_IoT_Client *pClient, const char *pTopicName,
+													  uint16_t topicNameLen);
+bool aws_iot_mqtt_internal_mqtt5_take_send_quota(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_mqtt5_give_send_quota(AWS_IoT_Client *pClient);
+bool aws_iot_mqtt_internal_mqtt5_has_send_quota(AWS_IoT_Client *pClient);
+
+#else
+
+/* MQTT 3.1.1 has no Receive Maximum, QoS1 messages can always be sent */
+#define aws_iot_mqtt_internal_mqtt5_take_send_quota(pClient) ((void) (pClient), true)
+#define aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient) ((void) (pClient))
+#define aws_iot_mqtt_internal_mqtt5_has_send_quota(pClient) ((void) (pClient), true)
+
+#endif
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+
+IoT_Error_t aws_iot_mqtt_internal_init_ack_waiters(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_destroy_ack_waiters(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_register_ack_waiter(AWS_IoT_Client *pClient, uint16_t packetId,
+													  AckWaiter **ppWaiter);
+IoT_Error_t aws_iot_mqtt_internal_wait_for_ack(AWS_IoT_Client *pClient, AckWaiter *pWaiter, Timer *pTimer);
+void aws_iot_mqtt_internal_release_ack_waiter(AWS_IoT_Client *pClient, AckWaiter *pWaiter);
+void aws_iot_mqtt_internal_wake_ack_waiters(AWS_IoT_Client *pClient);
+
+#endif
+
+#ifndef DISABLE_IOT_STATS
+
+IoT_Error_t aws_iot_mqtt_internal_init_stats(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_destroy_stats(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_stats_sending(AWS_IoT_Client *pClient, size_t length);
+void aws_iot_mqtt_internal_stats_sent(AWS_IoT_Client *pClient, size_t sentLen);
+void aws_iot_mqtt_internal_stats_received(AWS_IoT_Client *pClient, uint8_t packetType, size_t packetLen);
+void aws_iot_mqtt_internal_stats_dropped_oversized(AWS_IoT_Client *pClient, size_t packetLen);
+void aws_iot_mqtt_internal_stats_dropped_dispatch(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_stats_yield(AWS_IoT_Client *pClient, uint32_t yieldMs);
+void aws_iot_mqtt_internal_stats_yield_sleep(AWS_IoT_Client *pClient, uint32_t sleepMs);
+void aws_iot_mqtt_internal_stats_puback(AWS_IoT_Client *pClient, uint16_t packetId);
+void aws_iot_mqtt_internal_stats_record(AWS_IoT_Client *pClient, IoT_Client_Stats_Histogram *pHistogram,
+										uint32_t durationMs);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -66,9 +66,15 @@ extern "C" {
  * - @functionname{mqtt_function_free}
  * - @functionname{mqtt_function_connect}
  * - @functionname{mqtt_function_publish}
+ * - @functionname{mqtt_function_publish_template_init}
+ * - @functionname{mqtt_function_publish_with_template}
+ * - @functionname{mqtt_function_publish_async}
+ * - @functionname{mqtt_function_get_publish_queue_free_count}
  * - @functionname{mqtt_function_subscribe}
  * - @functionname{mqtt_function_resubscribe}
  * - @functionname{mqtt_function_unsubscribe}
+ * - @functionname{mqtt_function_set_dispatch_policy}
+ * - @functionname{mqtt_function_dispatch_run}
  * - @functionname{mqtt_function_disconnect}
  * - @functionname{mqtt_function_yield}
  * - @functionname{mqtt_function_attempt_reconnect}
@@ -88,9 +94,15 @@ extern "C" {
  * @functionpage{aws_iot_mqtt_free,mqtt,free}
  * @functionpage{aws_iot_mqtt_connect,mqtt,connect}
  * @functionpage{aws_iot_mqtt_publish,mqtt,publish}
+ * @functionpage{aws_iot_mqtt_publish_template_init,mqtt,publish_template_init}
+ * @functionpage{aws_iot_mqtt_publish_with_template,mqtt,publish_with_template}
+ * @functionpage{aws_iot_mqtt_publish_async,mqtt,publish_async}
+ * @functionpage{aws_iot_mqtt_get_publish_queue_free_count,mqtt,get_publish_queue_free_count}
  * @functionpage{aws_iot_mqtt_subscribe,mqtt,subscribe}
  * @functionpage{aws_iot_mqtt_resubscribe,mqtt,resubscribe}
  * @functionpage{aws_iot_mqtt_unsubscribe,mqtt,unsubscribe}
+ * @functionpage{aws_iot_mqtt_set_dispatch_policy,mqtt,set_dispatch_policy}
+ * @functionpage{aws_iot_mqtt_dispatch_run,mqtt,dispatch_run}
  * @functionpage{aws_iot_mqtt_disconnect,mqtt,disconnect}
  * @functionpage{aws_iot_mqtt_yield,mqtt,yield}
  * @functionpage{aws_iot_mqtt_attempt_reconnect,mqtt,attempt_reconnect}
@@ -103,6 +115,11 @@ extern "C" {
  * a new MQTT client context. Once the client context is no longer needed,
  * @ref mqtt_function_free should be called.
  *
+ * Credentials can be given in memory with their length, for example DER
+ * embedded in the firmware. DER is parsed without base64 decoding and, where
+ * the TLS library allows it, used in place, so it must stay valid until
+ * @ref mqtt_function_free.
+ *
  * @param[in] pClient MQTT client context to initialize
  * @param[in] pInitParams The MQTT connection parameters
  *
@@ -154,6 +171,11 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, const IoT_Client_Conne
  * passed to the TLS layer. For a QoS 1 message, this function returns after the
  * receipt of the PUBACK for the transmitted message.
  *
+ * With `ENABLE_IOT_FULL_DUPLEX` this function may be called from any task while
+ * another task is in @ref mqtt_function_yield. The yielding task receives the
+ * PUBACK and wakes the publisher; if no task is reading, the publisher reads the
+ * network itself.
+ *
  * @param pClient MQTT client context
  * @param pTopicName Topic name to publish to
  * @param topicNameLen Length of the topic name
@@ -166,6 +188,94 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 								 IoT_Publish_Message_Params *pParams);
 /* @[declare_mqtt_publish] */
 
+/**
+ * @brief Encode the topic and flags of a PUBLISH once.
+ *
+ * The template can then be used with @ref mqtt_function_publish_with_template
+ * by any client, for as long as the topic name stays valid.
+ *
+ * @param[out] pTemplate Template to fill in
+ * @param[in] pTopicName Topic name to publish to
+ * @param[in] topicNameLen Length of the topic name
+ * @param[in] qos Quality of service of the messages, QOS0 or QOS1
+ * @param[in] isRetained Retain flag of the messages
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ *
+ * @attention The `pTopicName` parameter is not copied. It must remain valid for as long as
+ * the template is used.
+ */
+/* @[declare_mqtt_publish_template_init] */
+IoT_Error_t aws_iot_mqtt_publish_template_init(IoT_Publish_Template *pTemplate, const char *pTopicName,
+											   uint16_t topicNameLen, QoS qos, uint8_t isRetained);
+/* @[declare_mqtt_publish_template_init] */
+
+/**
+ * @brief Publish an MQTT message using a publish template.
+ *
+ * Same as @ref mqtt_function_publish, except that the topic and flags come
+ * pre-encoded from the template, so the cost of building the packet no longer
+ * depends on the topic.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] pTemplate Template from @ref mqtt_function_publish_template_init
+ * @param[in] pPayload Message payload
+ * @param[in] payloadLen Length of the payload
+ * @param[out] pPacketId Packet identifier the message was sent with, may be NULL
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ */
+/* @[declare_mqtt_publish_with_template] */
+IoT_Error_t aws_iot_mqtt_publish_with_template(AWS_IoT_Client *pClient, const IoT_Publish_Template *pTemplate,
+											   const void *pPayload, size_t payloadLen, uint16_t *pPacketId);
+/* @[declare_mqtt_publish_with_template] */
+
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+/**
+ * @brief Queue an MQTT message for publishing.
+ *
+ * The message is placed in the client's outbound queue and this function returns
+ * immediately. @ref mqtt_function_yield sends queued messages, high priority first,
+ * packing as many as fit into the TX buffer into a single network write. The
+ * completion handler reports the outcome: for QoS 0 once the message was written,
+ * for QoS 1 once its PUBACK arrived or the command timeout expired.
+ *
+ * Messages stay queued while the client is disconnected. Messages that were sent
+ * but not acknowledged when the connection dropped are sent again with the DUP flag
+ * after reconnecting. @ref mqtt_function_free fails everything still queued with
+ * NETWORK_DISCONNECTED_ERROR.
+ *
+ * @param pClient MQTT client context
+ * @param pTopicName Topic name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Publish message parameters
+ * @param pQueueParams Priority, ownership and completion handler, NULL for defaults
+ *
+ * @return SUCCESS if queued, MQTT_PUBLISH_QUEUE_FULL_ERROR if no slot is free for this
+ * priority, MAX_SIZE_ERROR if topic and payload don't fit a slot or the TX buffer
+ */
+/* @[declare_mqtt_publish_async] */
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   const IoT_Publish_Queue_Params *pQueueParams);
+/* @[declare_mqtt_publish_async] */
+
+/**
+ * @brief Number of messages of a priority that can still be queued.
+ *
+ * Lets a producer throttle itself, e.g. pause backlog replay, before
+ * @ref mqtt_function_publish_async starts returning MQTT_PUBLISH_QUEUE_FULL_ERROR.
+ *
+ * @param pClient MQTT client context
+ * @param priority Priority class to check
+ *
+ * @return Free slots usable by the priority
+ */
+/* @[declare_mqtt_get_publish_queue_free_count] */
+uint32_t aws_iot_mqtt_get_publish_queue_free_count(AWS_IoT_Client *pClient, IoT_Publish_Priority priority);
+/* @[declare_mqtt_get_publish_queue_free_count] */
+#endif
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
@@ -230,6 +340,54 @@ IoT_Error_t aws_iot_mqtt_resubscribe(AWS_IoT_Client *pClient);
 IoT_Error_t aws_iot_mqtt_unsubscribe(AWS_IoT_Client *pClient, const char *pTopicFilter, uint16_t topicFilterLen);
 /* @[declare_mqtt_unsubscribe] */
 
+#ifdef ENABLE_IOT_DISPATCH_POOL
+/**
+ * @brief Choose how the messages of a subscription reach its handler.
+ *
+ * With any policy but DISPATCH_INLINE, @ref mqtt_function_yield no longer runs the
+ * handler. It copies the message into one of the client's dispatch slots, queues it for
+ * the subscription and goes on reading, so a slow handler can't hold up keepalive or
+ * other subscriptions. Tasks calling @ref mqtt_function_dispatch_run run the handlers.
+ * The policy decides what happens when the subscription already has
+ * AWS_IOT_MQTT_DISPATCH_QUEUE_LEN messages waiting or all slots are taken.
+ *
+ * Messages that don't fit a slot and messages a policy drops are counted in the
+ * droppedDispatch statistic. QoS1 messages are acknowledged when received, whatever
+ * becomes of them afterwards.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] pTopicName Topic filter the subscription was made with
+ * @param[in] topicNameLen Length of the topic filter
+ * @param[in] policy Delivery policy
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR, or FAILURE if there is no such subscription
+ */
+/* @[declare_mqtt_set_dispatch_policy] */
+IoT_Error_t aws_iot_mqtt_set_dispatch_policy(AWS_IoT_Client *pClient, const char *pTopicName,
+											 uint16_t topicNameLen, IoT_Dispatch_Policy policy);
+/* @[declare_mqtt_set_dispatch_policy] */
+
+/**
+ * @brief Run the handlers of dispatched messages.
+ *
+ * Meant to be called in a loop by one or more worker tasks of the application, next to
+ * the task calling @ref mqtt_function_yield. Messages of one subscription are handled
+ * in order and by one worker at a time, different subscriptions in parallel. Without
+ * thread support it runs the handlers of the messages already queued and returns.
+ *
+ * Handlers run outside yield, so in builds without ENABLE_IOT_FULL_DUPLEX a publish
+ * from a handler fails with MQTT_CLIENT_NOT_IDLE_ERROR while yield is running.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] timeout_ms How long to keep handling and waiting for messages
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+/* @[declare_mqtt_dispatch_run] */
+IoT_Error_t aws_iot_mqtt_dispatch_run(AWS_IoT_Client *pClient, uint32_t timeout_ms);
+/* @[declare_mqtt_dispatch_run] */
+#endif
+
 /**
  * @brief Disconnect an MQTT session.
  *
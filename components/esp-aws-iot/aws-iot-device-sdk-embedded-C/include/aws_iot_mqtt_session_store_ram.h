@@ -0,0 +1,71 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_session_store_ram.h
+ * @brief MQTT session store keeping unacknowledged messages in RAM
+ *
+ * Messages survive reconnects but not reboots. Stored packets are packed back to
+ * back in a buffer owned by the application.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_MQTT_SESSION_STORE_RAM_H
+#define AWS_IOT_SDK_SRC_IOT_MQTT_SESSION_STORE_RAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client.h"
+
+#ifndef AWS_IOT_MQTT_SESSION_STORE_RAM_LEN
+#define AWS_IOT_MQTT_SESSION_STORE_RAM_LEN 2048 ///< Bytes for stored packets, each also takes 4 bytes of bookkeeping
+#endif
+
+/**
+ * @brief RAM Session Store
+ *
+ * Storage for @ref aws_iot_mqtt_session_store_ram_init. Treat as opaque.
+ */
+typedef struct {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t lock; ///< Protects the buffer, save and remove can run from different tasks
+#endif
+	size_t used; ///< Bytes of buf in use
+	unsigned char buf[AWS_IOT_MQTT_SESSION_STORE_RAM_LEN]; ///< Entries of packet id, packet length and packet
+} IoT_MQTT_Session_Store_Ram;
+
+/**
+ * @brief Set up a session store keeping messages in RAM.
+ *
+ * @param[out] pStore Session store to pass to @ref mqtt_function_set_session_store
+ * @param[in] pRam Storage for the messages, must outlive the store
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or the mutex initialization error
+ */
+IoT_Error_t aws_iot_mqtt_session_store_ram_init(IoT_MQTT_Session_Store *pStore, IoT_MQTT_Session_Store_Ram *pRam);
+
+/**
+ * @brief Release a session store set up by @ref aws_iot_mqtt_session_store_ram_init.
+ *
+ * @param[in] pRam Storage of the store
+ */
+void aws_iot_mqtt_session_store_ram_destroy(IoT_MQTT_Session_Store_Ram *pRam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_MQTT_SESSION_STORE_RAM_H */
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_standby.h
+ * @brief Hot-standby pair of MQTT clients
+ *
+ * Two clients, each with its own client ID or endpoint, stay connected and
+ * subscribed at the same time. Publishes go through the active one. When it
+ * loses its connection, for example on a missed keepalive, the standby takes
+ * over at once and the failed client reconnects through auto-reconnect,
+ * becoming the new standby. With thread support the reconnect can run on a
+ * task of its own, see @ref aws_iot_mqtt_standby_reconnect_run.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_MQTT_STANDBY_H
+#define AWS_IOT_SDK_SRC_IOT_MQTT_STANDBY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client_interface.h"
+
+#ifndef AWS_IOT_MQTT_STANDBY_YIELD_MS
+#define AWS_IOT_MQTT_STANDBY_YIELD_MS 10 ///< Part of each pair yield given to the standby client
+#endif
+
+typedef struct _IoT_MQTT_Standby_Pair IoT_MQTT_Standby_Pair;
+
+/**
+ * @brief Subscription of a standby pair
+ *
+ * Both clients of the pair subscribe with the same entry as handler data.
+ */
+typedef struct {
+	IoT_MQTT_Standby_Pair *pPair; ///< Pair the subscription belongs to
+	const char *pTopicName; ///< Topic filter, not copied
+	uint16_t topicNameLen; ///< Length of the topic filter
+	QoS qos; ///< Quality of service of the subscription
+	pApplicationHandler_t pApplicationHandler; ///< Application function to invoke, NULL if the entry is free
+	void *pApplicationHandlerData; ///< Data passed to the application function
+	uint8_t subscribedMask; ///< Bit per client of the pair that holds the subscription
+} IoT_MQTT_Standby_Subscription;
+
+/**
+ * @brief Hot-standby pair
+ *
+ * Storage for @ref aws_iot_mqtt_standby_init. Treat as opaque.
+ */
+struct _IoT_MQTT_Standby_Pair {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t lock; ///< Serializes failovers, publishes can come from several tasks
+	IoT_Semaphore_t reconnectSem; ///< Posted by the pair yield when the standby needs a reconnect
+	uint8_t reconnectWorkers; ///< Tasks in aws_iot_mqtt_standby_reconnect_run
+	bool isStandbyReconnecting; ///< A reconnect task has the standby, the pair yield leaves it alone
+#endif
+	AWS_IoT_Client *pClients[2]; ///< Both clients of the pair
+	uint8_t activeIndex; ///< Index of the client publishes go through
+	uint32_t failoverCount; ///< Times the standby took over
+	IoT_MQTT_Standby_Subscription subscriptions[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS]; ///< Subscriptions of the pair
+};
+
+/**
+ * @brief Pair two clients for hot-standby.
+ *
+ * Both clients must be initialized with @ref mqtt_function_init and should be
+ * connected by the application, with different client IDs or endpoints. The
+ * pair enables auto-reconnect on both, that is how a failed client comes back
+ * as standby.
+ *
+ * @param[out] pPair Pair to set up
+ * @param[in] pPrimary Client that starts as the active one
+ * @param[in] pStandby Client that starts as the standby
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or the mutex or semaphore initialization error
+ */
+IoT_Error_t aws_iot_mqtt_standby_init(IoT_MQTT_Standby_Pair *pPair, AWS_IoT_Client *pPrimary,
+									  AWS_IoT_Client *pStandby);
+
+/**
+ * @brief Release a pair set up by @ref aws_iot_mqtt_standby_init.
+ *
+ * The clients are left as they are.
+ *
+ * @param[in] pPair Pair to release
+ */
+void aws_iot_mqtt_standby_destroy(IoT_MQTT_Standby_Pair *pPair);
+
+/**
+ * @brief Client publishes currently go through.
+ *
+ * @param[in] pPair Standby pair
+ *
+ * @return Active client, NULL if pPair is NULL
+ */
+AWS_IoT_Client *aws_iot_mqtt_standby_get_active(IoT_MQTT_Standby_Pair *pPair);
+
+/**
+ * @brief Number of times the standby took over.
+ *
+ * @param[in] pPair Standby pair
+ *
+ * @return Failovers since @ref aws_iot_mqtt_standby_init
+ */
+uint32_t aws_iot_mqtt_standby_get_failover_count(IoT_MQTT_Standby_Pair *pPair);
+
+/**
+ * @brief Subscribe on both clients of the pair.
+ *
+ * The active client must accept the subscription. A standby that is not
+ * connected yet subscribes later, in @ref aws_iot_mqtt_standby_yield.
+ * Both connections receive every message, only the one arriving on the
+ * active client reaches the handler.
+ *
+ * @param[in] pPair Standby pair
+ * @param[in] pTopicName Topic for subscription
+ * @param[in] topicNameLen Length of topic
+ * @param[in] qos Quality of service for subscription
+ * @param[in] pApplicationHandler Callback function for incoming messages
+ * @param[in] pApplicationHandlerData Data passed to the callback
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ *
+ * @attention The `pTopicName` parameter is not copied. It must remain valid for as long as
+ * the pair is used.
+ *
+ * @note A message that arrives only on the standby while the active connection is
+ * failing but not yet detected as down is not delivered. Keep the keepalive short.
+ */
+IoT_Error_t aws_iot_mqtt_standby_subscribe(IoT_MQTT_Standby_Pair *pPair, const char *pTopicName,
+										   uint16_t topicNameLen, QoS qos,
+										   pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData);
+
+/**
+ * @brief Publish through the active client.
+ *
+ * If the active client is down, or the publish fails because its connection
+ * is lost, the standby takes over and the message is sent through it.
+ *
+ * @param[in] pPair Standby pair
+ * @param[in] pTopicName Topic name to publish to
+ * @param[in] topicNameLen Length of the topic name
+ * @param[in] pParams Publish message parameters
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ *
+ * @note A QoS1 message sent again through the standby is removed from the session
+ * store of the failed client, which therefore must not share its store with the
+ * other client of the pair.
+ */
+IoT_Error_t aws_iot_mqtt_standby_publish(IoT_MQTT_Standby_Pair *pPair, const char *pTopicName,
+										 uint16_t topicNameLen, IoT_Publish_Message_Params *pParams);
+
+/**
+ * @brief Publish through the active client using a publish template.
+ *
+ * Same as @ref aws_iot_mqtt_standby_publish, with the topic and flags coming
+ * from the template.
+ *
+ * @param[in] pPair Standby pair
+ * @param[in] pTemplate Template from @ref mqtt_function_publish_template_init
+ * @param[in] pPayload Message payload
+ * @param[in] payloadLen Length of the payload
+ * @param[out] pPacketId Packet identifier the message was sent with, may be NULL
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ */
+IoT_Error_t aws_iot_mqtt_standby_publish_with_template(IoT_MQTT_Standby_Pair *pPair,
+													   const IoT_Publish_Template *pTemplate,
+													   const void *pPayload, size_t payloadLen,
+													   uint16_t *pPacketId);
+
+/**
+ * @brief Yield both clients of the pair.
+ *
+ * The active client gets the time less #AWS_IOT_MQTT_STANDBY_YIELD_MS, the
+ * standby the rest, which keeps its keepalive going and lets it reconnect and
+ * subscribe after a failure. If the active client lost its connection and the
+ * standby is up, the standby takes over.
+ *
+ * @param[in] pPair Standby pair
+ * @param[in] timeout_ms Maximum number of milliseconds to spend in both clients
+ *
+ * @return SUCCESS while the active client is connected, otherwise the result of
+ * its yield
+ *
+ * @note A reconnect attempt of the standby, TLS handshake included, runs inside
+ * this call unless a task runs @ref aws_iot_mqtt_standby_reconnect_run.
+ */
+IoT_Error_t aws_iot_mqtt_standby_yield(IoT_MQTT_Standby_Pair *pPair, uint32_t timeout_ms);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+/**
+ * @brief Reconnect the standby client outside the pair yield.
+ *
+ * Meant to be called in a loop by a task of the application, next to the task
+ * calling @ref aws_iot_mqtt_standby_yield. While it runs, the pair yield hands a
+ * standby that lost its connection to this task, which reconnects it with the
+ * auto-reconnect backoff and subscribes it again. The active client's yield
+ * never waits for the TLS handshake of the standby then.
+ *
+ * @param[in] pPair Standby pair
+ * @param[in] timeout_ms How long to keep reconnecting and waiting for work
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_mqtt_standby_reconnect_run(IoT_MQTT_Standby_Pair *pPair, uint32_t timeout_ms);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_MQTT_STANDBY_H */
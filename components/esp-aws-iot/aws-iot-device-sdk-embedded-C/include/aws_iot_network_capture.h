@@ -0,0 +1,198 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_network_capture.h
+ * @brief Capture of the decrypted byte stream of a network and its replay
+ *
+ * A capture sits between the MQTT client and its Network and records every
+ * connect, read, write, read error and disconnect with a millisecond timestamp,
+ * before encryption. The replay transport is a Network that plays a capture
+ * back to an MQTT client, at the recorded pace or as fast as the client reads,
+ * so that field traffic can be run through the parse and dispatch path again
+ * on a desk. tools/capture_decode.py prints a capture as a timeline.
+ *
+ * The capture is little endian: an 8 byte header of magic "IOTC", format
+ * version and three reserved bytes, then records of a type byte, a 32 bit
+ * timestamp in ms since the capture started, a 16 bit length and that many
+ * bytes of data. Connect and read error records carry the IoT_Error_t as a
+ * 32 bit value, reads and writes their bytes, disconnects nothing.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_NETWORK_CAPTURE_H
+#define AWS_IOT_SDK_SRC_IOT_NETWORK_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_config.h"
+#include "aws_iot_error.h"
+#include "network_interface.h"
+#ifdef _ENABLE_THREAD_SUPPORT_
+#include "threads_interface.h"
+#endif
+
+/** Bytes of the capture header */
+#define AWS_IOT_CAPTURE_HEADER_LEN 8
+/** Bytes in front of the data of each record */
+#define AWS_IOT_CAPTURE_RECORD_HEADER_LEN 7
+
+/**
+ * @brief Capture Record Types
+ *
+ * Keep in sync with tools/capture_decode.py.
+ */
+typedef enum {
+	IOT_CAPTURE_CONNECT = 'C', ///< Network connect returned, data is its IoT_Error_t
+	IOT_CAPTURE_READ = 'R', ///< Bytes handed to the client by a read
+	IOT_CAPTURE_WRITE = 'W', ///< Bytes the network accepted from the client
+	IOT_CAPTURE_READ_ERROR = 'E', ///< Read failed other than by timing out, data is its IoT_Error_t
+	IOT_CAPTURE_DISCONNECT = 'D' ///< Client disconnected the network
+} IoT_Capture_Record_Type;
+
+/**
+ * @brief Destination of capture records
+ *
+ * Called with the header of a record and again with its data. Must not call
+ * back into the captured network.
+ *
+ * @param pSinkData Data given to @ref aws_iot_network_capture_start
+ * @param pBuf Bytes to append
+ * @param len Number of bytes
+ *
+ * @return SUCCESS, any error stops the capture from recording further records
+ */
+typedef IoT_Error_t (*iot_capture_sink)(void *pSinkData, const unsigned char *pBuf, size_t len);
+
+/**
+ * @brief Running capture
+ *
+ * Storage for @ref aws_iot_network_capture_start. Treat as opaque.
+ */
+typedef struct IoT_Network_Capture {
+	Network *pNetwork; ///< Network being captured
+	IoT_Error_t (*connect)(Network *, TLSConnectParams *); ///< Connect of the network
+	IoT_Error_t (*read)(Network *, unsigned char *, size_t, Timer *, size_t *); ///< Read of the network
+	IoT_Error_t (*readAvailable)(Network *, unsigned char *, size_t, Timer *, size_t *); ///< Buffered read of the network, may be NULL
+	IoT_Error_t (*write)(Network *, unsigned char *, size_t, Timer *, size_t *); ///< Write of the network
+	IoT_Error_t (*disconnect)(Network *); ///< Disconnect of the network
+	iot_capture_sink sink; ///< Where records go
+	void *pSinkData; ///< Passed to the sink
+	Timer clock; ///< Expired at the capture start, elapsed_ms gives the timestamps
+	IoT_Error_t sinkError; ///< First error of the sink, nothing is recorded after it
+	uint32_t recordCount; ///< Records written so far
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Mutex_t lock; ///< Keeps records of concurrent reads and writes apart
+#endif
+} IoT_Network_Capture;
+
+/**
+ * @brief Replay transport
+ *
+ * Storage for @ref aws_iot_network_replay_init. Treat as opaque.
+ */
+typedef struct {
+	const unsigned char *pCapture; ///< Capture being played back, not copied
+	size_t captureLen; ///< Bytes of the capture
+	size_t position; ///< Offset of the record reads come from next
+	size_t recordOffset; ///< Bytes of that record's data already read
+	size_t streamEnd; ///< Offset behind the last read, read error or connect record
+	bool isRealTime; ///< Hold back each read record until its recorded time
+	bool isConnected; ///< A recorded connect succeeded and the stream after it is playing
+	Timer clock; ///< Expired at the replayed connect
+	uint32_t connectTimeMs; ///< Capture time of the replayed connect
+	size_t bytesRead; ///< Bytes handed to the client
+	size_t bytesWritten; ///< Bytes the client wrote, they are dropped
+} IoT_Network_Replay;
+
+/**
+ * @brief Start capturing a network.
+ *
+ * Records the capture header and wraps the connect, read, buffered read, write
+ * and disconnect functions of the network. For an MQTT client, pass its
+ * networkStack after @ref aws_iot_mqtt_init, which sets those functions.
+ *
+ * @param[out] pCapture Capture to run, must stay valid until stopped
+ * @param[in] pNetwork Network to capture
+ * @param[in] sink Destination of the records, see @ref aws_iot_network_capture_file_sink
+ * @param[in] pSinkData Passed to the sink
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR, the mutex error or the error of the sink
+ */
+IoT_Error_t aws_iot_network_capture_start(IoT_Network_Capture *pCapture, Network *pNetwork,
+										  iot_capture_sink sink, void *pSinkData);
+
+/**
+ * @brief Stop a capture and give the network its own functions back.
+ *
+ * Must not run while the network is in use by another task.
+ *
+ * @param[in] pCapture Running capture
+ *
+ * @return SUCCESS if every record reached the sink, otherwise the first sink error
+ */
+IoT_Error_t aws_iot_network_capture_stop(IoT_Network_Capture *pCapture);
+
+/**
+ * @brief Capture sink appending to a stdio file.
+ *
+ * @param pSinkData FILE * opened for binary writing
+ * @param pBuf Bytes to append
+ * @param len Number of bytes
+ *
+ * @return SUCCESS or NETWORK_CAPTURE_WRITE_ERROR
+ */
+IoT_Error_t aws_iot_network_capture_file_sink(void *pSinkData, const unsigned char *pBuf, size_t len);
+
+/**
+ * @brief Turn a network into a replay of a capture.
+ *
+ * Every connect moves on to the next recorded connect and returns its result.
+ * Reads then return the bytes recorded for that connection, recorded read
+ * errors come back as the same error. Writes are accepted and dropped. For an
+ * MQTT client, call after @ref aws_iot_mqtt_init and repeat the calls the
+ * application made during the capture, so packet identifiers and acks line up.
+ *
+ * @param[out] pNetwork Network to replay on
+ * @param[out] pReplay Replay state, must stay valid while the network is used
+ * @param[in] pCapture Capture, not copied
+ * @param[in] captureLen Bytes of the capture
+ * @param[in] isRealTime true to hold every read back until its recorded time
+ * after the connect, false to hand it over as soon as the client reads
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or NETWORK_CAPTURE_FORMAT_ERROR
+ */
+IoT_Error_t aws_iot_network_replay_init(Network *pNetwork, IoT_Network_Replay *pReplay,
+										const unsigned char *pCapture, size_t captureLen, bool isRealTime);
+
+/**
+ * @brief Whether the replay handed over everything it has.
+ *
+ * @param[in] pReplay Replay state
+ *
+ * @return true once no read record or recorded connect is left
+ */
+bool aws_iot_network_replay_is_done(const IoT_Network_Replay *pReplay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_NETWORK_CAPTURE_H */
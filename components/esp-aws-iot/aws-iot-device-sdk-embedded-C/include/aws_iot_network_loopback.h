@@ -0,0 +1,184 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_network_loopback.h
+ * @brief In-memory duplex transport
+ *
+ * A loopback link joins two Networks, its ends A and B, through two byte rings
+ * in RAM, one per direction. Typically an MQTT client sits on end A and a test
+ * broker, driven through the Network functions of end B, on the other, so the
+ * client can be measured without TLS and sockets in the way.
+ *
+ * Each ring has one writing and one reading end and needs no lock, so the two
+ * ends may run on different tasks. Two tasks writing to, or two reading from,
+ * the same end must serialize themselves, as the MQTT client does.
+ *
+ * A link can delay every write by a fixed latency and drain each direction at a
+ * limited rate. The bytes of a write then become readable at once when the link
+ * has sent the write and the latency has passed.
+ *
+ * With thread support, a wait for data or for room in a ring sleeps on a
+ * semaphore the other end posts, at most until the next delayed write is due
+ * or the timer of the call expires. Without it, waits sleep a millisecond at a
+ * time. Release a link set up with thread support with
+ * @ref aws_iot_network_loopback_free.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_NETWORK_LOOPBACK_H
+#define AWS_IOT_SDK_SRC_IOT_NETWORK_LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_config.h"
+#include "aws_iot_error.h"
+#include "network_interface.h"
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+#include "threads_interface.h"
+#endif
+
+#ifndef AWS_IOT_LOOPBACK_MAX_IN_FLIGHT
+/** Writes a delayed or rate limited direction holds before further writes wait */
+#define AWS_IOT_LOOPBACK_MAX_IN_FLIGHT 64
+#endif
+
+/**
+ * @brief Ends of a loopback link
+ */
+typedef enum {
+	IOT_LOOPBACK_END_A = 0, ///< Writes to rings[0], reads from rings[1]
+	IOT_LOOPBACK_END_B = 1 ///< Writes to rings[1], reads from rings[0]
+} IoT_Loopback_End;
+
+/**
+ * @brief Write on its way through a delayed or rate limited direction
+ */
+typedef struct {
+	size_t end; ///< Ring head behind the last byte of the write
+	uint32_t dueMs; ///< Link time at which its bytes become readable
+} IoT_Loopback_In_Flight;
+
+/**
+ * @brief One direction of a loopback link
+ *
+ * head and the in-flight head are only stored by the writing end, tail, the
+ * in-flight tail and readable only by the reading end.
+ */
+typedef struct {
+	unsigned char *pBuf; ///< Ring storage, not copied
+	size_t size; ///< Bytes of pBuf
+	size_t head; ///< Bytes written so far
+	size_t tail; ///< Bytes read so far
+	size_t readable; ///< Head of the last due write, for delayed or rate limited directions
+	IoT_Loopback_In_Flight inFlight[AWS_IOT_LOOPBACK_MAX_IN_FLIGHT]; ///< Writes not yet due
+	uint32_t inFlightHead; ///< Writes queued in inFlight so far
+	uint32_t inFlightTail; ///< Writes that became readable so far
+	uint64_t sentUs; ///< Link time in us at which the rate limit has sent everything written
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Semaphore_t dataSem; ///< Posted when bytes were added, an end left or the reading end was woken up
+	IoT_Semaphore_t roomSem; ///< Posted when bytes were taken or an end left
+#endif
+} IoT_Loopback_Ring;
+
+struct IoT_Network_Loopback;
+
+/**
+ * @brief State of one end, reached through Network::pTransportData
+ */
+typedef struct {
+	struct IoT_Network_Loopback *pLink; ///< Link the end belongs to
+	IoT_Loopback_Ring *pRx; ///< Ring the end reads from
+	IoT_Loopback_Ring *pTx; ///< Ring the end writes to
+	uint32_t disconnectCount; ///< Disconnects of this end, read by the other one
+	uint32_t peerDisconnectCount; ///< disconnectCount of the other end at the last connect
+	bool isConnected; ///< Connected and not disconnected since
+	bool isWakeUpPending; ///< Set by wakeUp from any task, the next wait for readable bytes returns and clears it
+	size_t bytesRead; ///< Bytes handed to the reader of this end
+	size_t bytesWritten; ///< Bytes the rings accepted from the writer of this end
+} IoT_Loopback_Endpoint;
+
+/**
+ * @brief Loopback link
+ *
+ * Storage for @ref aws_iot_network_loopback_init. Treat as opaque.
+ */
+typedef struct IoT_Network_Loopback {
+	IoT_Loopback_Ring rings[2]; ///< rings[0] carries A to B, rings[1] B to A
+	IoT_Loopback_Endpoint ends[2]; ///< Indexed by IoT_Loopback_End
+	uint32_t latencyMs; ///< Delay of every write, 0 for none
+	uint32_t bytesPerSec; ///< Rate each direction drains at, 0 for unlimited
+	Timer clock; ///< Expired at the link init, elapsed_ms gives the link time
+} IoT_Network_Loopback;
+
+/**
+ * @brief Set up a loopback link.
+ *
+ * The ring sizes play the part of the socket buffers: a write waits while the
+ * bytes the other end has not read yet fill its ring.
+ *
+ * @param[out] pLink Link, must stay valid while its ends are used
+ * @param[in] pBufAToB Storage of the direction from end A to end B
+ * @param[in] pBufBToA Storage of the direction from end B to end A
+ * @param[in] bufLen Bytes of each storage
+ * @param[in] latencyMs Time from a write to its bytes becoming readable, 0 for none
+ * @param[in] bytesPerSec Rate at which each direction passes bytes on, 0 for unlimited
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or SEMAPHORE_INIT_ERROR
+ */
+IoT_Error_t aws_iot_network_loopback_init(IoT_Network_Loopback *pLink, unsigned char *pBufAToB,
+										  unsigned char *pBufBToA, size_t bufLen, uint32_t latencyMs,
+										  uint32_t bytesPerSec);
+
+/**
+ * @brief Turn a network into one end of a loopback link.
+ *
+ * Connect always succeeds and does not wait for the other end. Once an end
+ * disconnects, the other one reads what was written before and then gets
+ * NETWORK_SSL_READ_ERROR, its writes fail at once. Both ends connect again to
+ * start a new connection. For an MQTT client, call after @ref aws_iot_mqtt_init
+ * on its networkStack.
+ *
+ * @param[out] pNetwork Network to use as the end
+ * @param[in] pLink Link set up by @ref aws_iot_network_loopback_init
+ * @param[in] end Which end of the link
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_network_loopback_attach(Network *pNetwork, IoT_Network_Loopback *pLink, IoT_Loopback_End end);
+
+/**
+ * @brief Release a loopback link.
+ *
+ * Destroys the semaphores of a link set up with thread support. Neither end
+ * may be used afterwards, until the link is set up again.
+ *
+ * @param[in] pLink Link set up by @ref aws_iot_network_loopback_init
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_network_loopback_free(IoT_Network_Loopback *pLink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_NETWORK_LOOPBACK_H */
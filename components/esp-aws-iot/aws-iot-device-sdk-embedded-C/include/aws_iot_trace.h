@@ -0,0 +1,142 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_trace.h
+ * @brief Binary event trace kept in RAM
+ *
+ * Unlike the printf based FUNC_ENTRY tracing this is cheap enough to leave on. Each event
+ * is a fixed size record of timestamp, event id, client and one integer, written into a
+ * ring per CPU core without taking locks. The newest AWS_IOT_TRACE_RING_LEN events per
+ * core can be dumped at any time, for example after a latency spike, and turned into a
+ * timeline on the host with tools/trace_decode.py.
+ *
+ * Define DISABLE_IOT_TRACE_RING to compile all trace points out.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_TRACE_H
+#define AWS_IOT_SDK_SRC_IOT_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aws_iot_config.h"
+
+#ifndef AWS_IOT_TRACE_RING_LEN
+#define AWS_IOT_TRACE_RING_LEN 128 ///< Events kept per core, must be a power of two
+#endif
+
+#ifndef AWS_IOT_TRACE_MAX_CORES
+#define AWS_IOT_TRACE_MAX_CORES 2 ///< Number of rings, cores beyond this share them
+#endif
+
+#if 0 != (AWS_IOT_TRACE_RING_LEN & (AWS_IOT_TRACE_RING_LEN - 1))
+#error "AWS_IOT_TRACE_RING_LEN must be a power of two"
+#endif
+
+/** Bytes of the dump header */
+#define AWS_IOT_TRACE_DUMP_HEADER_LEN 16
+/** Bytes of one event in a dump */
+#define AWS_IOT_TRACE_DUMP_RECORD_LEN 20
+/** Buffer size that always holds a complete dump */
+#define AWS_IOT_TRACE_DUMP_MAX_LEN \
+	(AWS_IOT_TRACE_DUMP_HEADER_LEN + AWS_IOT_TRACE_MAX_CORES * AWS_IOT_TRACE_RING_LEN * AWS_IOT_TRACE_DUMP_RECORD_LEN)
+
+/**
+ * @brief Trace Event Identifiers
+ *
+ * Keep in sync with tools/trace_decode.py.
+ */
+typedef enum {
+	IOT_TRACE_CONNECT = 1, ///< MQTT connect started, arg unused
+	IOT_TRACE_NETWORK_CONNECT = 2, ///< Network connect returned, arg is its IoT_Error_t
+	IOT_TRACE_CONNACK = 3, ///< CONNACK received, arg is its return code as IoT_Error_t
+	IOT_TRACE_DISCONNECT = 4, ///< aws_iot_mqtt_disconnect() done, arg is its IoT_Error_t
+	IOT_TRACE_RECONNECT = 5, ///< Reconnect attempt, arg is the backoff interval in ms
+	IOT_TRACE_SEND = 6, ///< Network write done, arg is bytes written or a negative IoT_Error_t
+	IOT_TRACE_RECEIVE = 7, ///< Packet framed from the network, arg is packet type << 24 | packet length
+	IOT_TRACE_DROP = 8, ///< Packet too large for the read buffer dropped, arg is its length
+	IOT_TRACE_PUBLISH = 9, ///< PUBLISH about to be sent, arg is DUP flag << 16 | packet id
+	IOT_TRACE_PUBACK = 10, ///< PUBACK processed, arg is the packet id
+	IOT_TRACE_PINGREQ = 11, ///< Keepalive PINGREQ sent, arg is the IoT_Error_t of the send
+	IOT_TRACE_CONNECTION_LOST = 12, ///< Yield found the connection broken, arg unused
+	IOT_TRACE_APP = 0x8000 ///< First id applications can use for their own events
+} IoT_Trace_Event_Id;
+
+#ifndef DISABLE_IOT_TRACE_RING
+/** Record a trace event, compiled out with DISABLE_IOT_TRACE_RING */
+#define IOT_TRACE_EVENT(eventId, pClient, arg) aws_iot_trace_record((uint16_t) (eventId), (pClient), (int32_t) (arg))
+#else
+#define IOT_TRACE_EVENT(eventId, pClient, arg)
+#endif
+
+#ifndef DISABLE_IOT_TRACE_RING
+
+/**
+ * @brief Record a trace event.
+ *
+ * Safe to call from any task, on any core, at any time. Never blocks.
+ *
+ * @param eventId An IoT_Trace_Event_Id or an application id from IOT_TRACE_APP up
+ * @param pClient Client the event belongs to, NULL if none
+ * @param arg Event specific value
+ */
+void aws_iot_trace_record(uint16_t eventId, const void *pClient, int32_t arg);
+
+/**
+ * @brief Copy the recorded events into a buffer.
+ *
+ * The dump is little endian: a header of magic "IOTT", format version, record length,
+ * number of rings, a reserved byte, the number of records and the timestamp of the dump,
+ * followed by the records of each ring from oldest to newest. Events recorded while the
+ * dump runs may be missing from it, never torn.
+ *
+ * @param pBuf Destination, AWS_IOT_TRACE_DUMP_MAX_LEN bytes hold any dump
+ * @param bufLen Size of pBuf, records that don't fit are left out
+ *
+ * @return Bytes written, 0 if not even the header fits
+ */
+size_t aws_iot_trace_dump(unsigned char *pBuf, size_t bufLen);
+
+/**
+ * @brief Forget all recorded events.
+ *
+ * Must not run while events are being recorded.
+ */
+void aws_iot_trace_reset(void);
+
+/**
+ * @brief Microsecond timestamp for trace events, provided by the platform layer.
+ *
+ * Wraps around after 2^32 us, the decoder accounts for that.
+ */
+uint32_t aws_iot_trace_timestamp_us(void);
+
+/**
+ * @brief Index of the CPU core running the caller, provided by the platform layer.
+ */
+uint32_t aws_iot_trace_core_id(void);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_TRACE_H */
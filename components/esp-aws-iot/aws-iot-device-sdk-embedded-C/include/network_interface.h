@@ -41,6 +41,52 @@ extern "C" {
  */
 typedef struct Network Network;
 
+/**
+ * @brief Endpoint of the MQTT service
+ *
+ * One entry of an endpoint list, see TLSConnectParams::pEndpoints.
+ */
+typedef struct {
+	const char *pDestinationURL;		///< Pointer to string containing the endpoint of the MQTT service.
+	uint16_t DestinationPort;			///< Connection port, 443 uses the AWS IoT ALPN extension.
+	uint32_t lastConnectMs;				///< TCP connect plus TLS handshake time of the last connect through this endpoint, 0 if none yet. Faster endpoints start earlier in a race
+} TLSEndpoint;
+
+/**
+ * @brief TLS connection profiles
+ *
+ * Bits of TLSConnectParams::tlsProfile, profiles can be combined.
+ */
+typedef enum {
+	IOT_TLS_PROFILE_DEFAULT = 0x00,	///< mbedTLS defaults
+	IOT_TLS_PROFILE_LEAN = 0x01,	///< Negotiates the Max Fragment Length extension, so records of at most AWS_IOT_TLS_MAX_FRAGMENT_LEN bytes let mbedTLS built with variable buffer lengths shrink its record buffers after the handshake
+	IOT_TLS_PROFILE_FAST_HANDSHAKE = 0x02	///< Offers only ECDHE-ECDSA and ECDHE-RSA with AES-128-GCM or ChaCha20-Poly1305 and only the X25519 and P-256 curves, so the server cannot pick an RSA key exchange or a large curve. A server certificate on another curve fails the handshake
+} IoT_TLS_Profile;
+
+/**
+ * @brief Transports of the MQTT client
+ */
+typedef enum {
+	IOT_NETWORK_TRANSPORT_TLS = 0,	///< mbedTLS over TCP, see iot_tls_init
+	IOT_NETWORK_TRANSPORT_TCP = 1	///< Plain TCP without encryption or authentication, see iot_tcp_init. Only for a broker on the same host or behind a TLS terminating proxy
+} IoT_Network_Transport;
+
+/**
+ * @brief Socket options of the plain TCP transport
+ */
+typedef struct {
+	bool isNoDelay;				///< Set TCP_NODELAY, so a small packet goes out without waiting for the ACK of the previous one
+	int sendBufLen;				///< SO_SNDBUF in bytes, 0 keeps the system default
+	int recvBufLen;				///< SO_RCVBUF in bytes, 0 keeps the system default
+	bool isKeepAlive;			///< Set SO_KEEPALIVE, so a peer that vanished is noticed between MQTT pings too
+	uint16_t keepAliveIdle_s;		///< Idle time before the first probe, 0 keeps the system default
+	uint16_t keepAliveInterval_s;		///< Time between probes, 0 keeps the system default
+	uint8_t keepAliveCount;			///< Unanswered probes before the connection is dropped, 0 keeps the system default
+} IoT_TCP_Options;
+
+/** Default socket options of the plain TCP transport */
+#define IoT_TCP_Options_initializer { true, 0, 0, false, 0, 0, 0 }
+
 /**
  * @brief TLS Connection Parameters
  *
@@ -48,13 +94,21 @@ typedef struct Network Network;
  * TLS networking layer to create a TLS secured socket.
  */
 typedef struct {
-	const char *pRootCALocation;                ///< Pointer to string containing the filename (including path) of the root CA file.
+	const char *pRootCALocation;               ///< Pointer to string containing the filename (including path) of the root CA file.
 	const char *pDeviceCertLocation;            ///< Pointer to string containing the filename (including path) of the device certificate.
 	const char *pDevicePrivateKeyLocation;    ///< Pointer to string containing the filename (including path) of the device private key file.
 	const char *pDestinationURL;                ///< Pointer to string containing the endpoint of the MQTT service.
 	uint16_t DestinationPort;            ///< Integer defining the connection port of the MQTT service.
 	uint32_t timeout_ms;                ///< Unsigned integer defining the TLS handshake timeout value in milliseconds.
 	bool ServerVerificationFlag;        ///< Boolean.  True = perform server certificate hostname validation.  False = skip validation \b NOT recommended.
+	TLSEndpoint *pEndpoints;            ///< Optional. Endpoints raced on connect, the fastest TCP connect gets the TLS handshake. pDestinationURL and DestinationPort are set to the winner
+	uint8_t endpointCount;              ///< Number of entries in pEndpoints, 0 to connect to pDestinationURL only
+	uint8_t preferredEndpoint;          ///< Entry that won the last race, it starts first on the next connect. The others follow by lastConnectMs
+	uint32_t endpointRaceDelay_ms;      ///< Head start each endpoint gets before the next one is tried as well
+	size_t rootCALen;                   ///< Bytes of a root CA in memory, PEM with its terminating NUL or DER. 0 when pRootCALocation is a path or a NUL terminated PEM string
+	size_t deviceCertLen;               ///< Bytes of a device certificate in memory, as rootCALen
+	size_t devicePrivateKeyLen;         ///< Bytes of a device private key in memory, as rootCALen
+	uint8_t tlsProfile;                 ///< IoT_TLS_Profile bits, 0 for the mbedTLS defaults
 } TLSConnectParams;
 
 /**
@@ -66,6 +120,9 @@ struct Network {
 	IoT_Error_t (*connect)(Network *, TLSConnectParams *);
 
 	IoT_Error_t (*read)(Network *, unsigned char *, size_t, Timer *, size_t *);    ///< Function pointer pointing to the network function to read from the network
+	IoT_Error_t (*readAvailable)(Network *, unsigned char *, size_t, Timer *, size_t *);    ///< Optional. Reads between one and the given number of bytes, returning whatever has already arrived. NULL makes the client fall back to read
+	IoT_Error_t (*waitForReadable)(Network *, Timer *);    ///< Optional. Sleeps until data can be read or the timer expires, so an idle yield doesn't poll. NULL keeps yield polling with reads
+	IoT_Error_t (*wakeUp)(Network *);    ///< Optional. Makes a waitForReadable sleeping on another task return early, or the next one if none sleeps right now. NULL if the sleep can't be cut short, yield then wakes up every AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS to look for queued messages
 	IoT_Error_t (*write)(Network *, unsigned char *, size_t, Timer *, size_t *);    ///< Function pointer pointing to the network function to write to the network
 	IoT_Error_t (*disconnect)(Network *);    ///< Function pointer pointing to the network function to disconnect from the network
 	IoT_Error_t (*isConnected)(Network *);    ///< Function pointer pointing to the network function to check if TLS is connected
@@ -73,6 +130,10 @@ struct Network {
 
 	TLSConnectParams tlsConnectParams;        ///< TLSConnect params structure containing the common connection parameters
 	TLSDataParams tlsDataParams;            ///< TLSData params structure containing the connection data parameters that are specific to the library being used
+
+	struct IoT_Network_Capture *pCapture;    ///< Capture recording this network, see aws_iot_network_capture_start. Only valid while it runs
+	void *pTransportData;                    ///< State of a transport that replaces the TLS one, like the capture replay
+	IoT_TCP_Options tcpOptions;              ///< Socket options of the plain TCP transport, see iot_tcp_init
 };
 
 /**
@@ -111,6 +172,9 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *TLSParams);
 /**
  * @brief Write bytes to the network socket
  *
+ * On NETWORK_SSL_WRITE_TIMEOUT_ERROR the number of bytes written holds what
+ * got through before the timer expired.
+ *
  * @param Network - Pointer to a Network struct defining the network interface.
  * @param unsigned char pointer - buffer to write to socket
  * @param integer - number of bytes to write
@@ -132,6 +196,80 @@ IoT_Error_t iot_tls_write(Network *, unsigned char *, size_t, Timer *, size_t *)
  */
 IoT_Error_t iot_tls_read(Network *, unsigned char *, size_t, Timer *, size_t *);
 
+/**
+ * @brief Read whatever bytes are available from the network socket
+ *
+ * Blocks until at least one byte is available or the timer expires, then returns
+ * every byte the TLS layer can hand over without waiting again, up to the given length.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @param unsigned char pointer - pointer to buffer where read bytes should be copied
+ * @param size_t - maximum number of bytes to read
+ * @param Timer * - operation timer
+ * @param size_t - pointer to store number of bytes read
+ * @return IoT_Error_t - successful read, NETWORK_SSL_NOTHING_TO_READ or TLS error code
+ */
+IoT_Error_t iot_tls_read_available(Network *, unsigned char *, size_t, Timer *, size_t *);
+
+/**
+ * @brief Wait until bytes can be read from the network socket
+ *
+ * Returns at once if the TLS layer already holds decrypted data, otherwise sleeps on the
+ * socket until it becomes readable or the timer expires. Without an open socket it only
+ * waits for the timer.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @param Timer * - latest time to wake up
+ * @return IoT_Error_t - SUCCESS if readable, NETWORK_SSL_NOTHING_TO_READ if the timer expired or TLS error code
+ */
+IoT_Error_t iot_tls_wait_for_readable(Network *, Timer *);
+
+/**
+ * @brief End a wait for readable bytes early
+ *
+ * An iot_tls_wait_for_readable sleeping on another task returns
+ * NETWORK_SSL_NOTHING_TO_READ at once, if none sleeps right now the next one does.
+ * Safe to call from any task while the network is initialized.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @return IoT_Error_t - SUCCESS, or NETWORK_SSL_WRITE_ERROR if the wake-up could not be signalled
+ */
+IoT_Error_t iot_tls_wake_up(Network *);
+
+/**
+ * @brief Socket of the open connection
+ *
+ * For event loops that watch the sockets of many networks at once, like the
+ * epoll reactor of the Linux platform. Only platforms with file descriptors
+ * provide it. The plain TCP transport keeps its socket in the same place.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @return int - the socket, -1 without an open connection
+ */
+int iot_tls_get_fd(Network *pNetwork);
+
+/**
+ * @brief Descriptor that becomes readable on @ref iot_tls_wake_up
+ *
+ * An event loop watching it along with the socket has to read it empty itself
+ * before it waits on it again. Only platforms with file descriptors provide it.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @return int - the descriptor, -1 if the network can't be woken up
+ */
+int iot_tls_get_wake_fd(Network *pNetwork);
+
+/**
+ * @brief Check for received bytes held inside the TLS layer
+ *
+ * Records the TLS layer already took off the socket are not announced by the
+ * socket again, an event loop has to read them before it waits on the socket.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @return bool - true if a read would return bytes without touching the socket
+ */
+bool iot_tls_has_pending_data(Network *pNetwork);
+
 /**
  * @brief Disconnect from network socket
  *
@@ -143,13 +281,53 @@ IoT_Error_t iot_tls_disconnect(Network *pNetwork);
 /**
  * @brief Perform any tear-down or cleanup of TLS layer
  *
- * Called to cleanup any resources required for the TLS layer.
+ * Called to cleanup any resources required for the TLS connection. What is
+ * shared across connections stays until @ref iot_tls_free.
  *
  * @param Network - Pointer to a Network struct defining the network interface
  * @return IoT_Error_t - successful cleanup or TLS error code
  */
 IoT_Error_t iot_tls_destroy(Network *pNetwork);
 
+/**
+ * @brief Forget the TLS session kept for resumption
+ *
+ * The session of the last full handshake survives disconnect and destroy so
+ * that the next connect can resume it. Call this when the credentials change
+ * or the network is no longer used, the next connect does a full handshake.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return IoT_Error_t - successful cleanup or TLS error code
+ */
+IoT_Error_t iot_tls_forget_session(Network *pNetwork);
+
+/**
+ * @brief Release what the TLS layer keeps across connections
+ *
+ * The first connect parses the credentials and builds the TLS configuration,
+ * every later connect and reconnect shares them. This frees them together with
+ * the saved session. Called by aws_iot_mqtt_free once the network is no longer
+ * used, a later connect would parse the credentials again. The network can't be
+woken up with @ref iot_tls_wake_up anymore afterwards.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return IoT_Error_t - successful cleanup or TLS error code
+ */
+IoT_Error_t iot_tls_free(Network *pNetwork);
+
+/**
+ * @brief Report the record buffers of the TLS connection
+ * These input and output buffers are the bulk of the RAM a connection takes.
+ * mbedTLS built with MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH shrinks them to the
+ * record size negotiated by the handshake, see IOT_TLS_PROFILE_LEAN, otherwise
+ * they keep their compile time size. Both are 0 without an open connection.
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @param size_t - pointer to store the bytes of the input buffer
+ * @param size_t - pointer to store the bytes of the output buffer
+ * @return IoT_Error_t - SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t iot_tls_get_record_buffer_len(Network *pNetwork, size_t *pInLen, size_t *pOutLen);
+
 /**
  * @brief Check if TLS layer is still connected
  *
@@ -160,6 +338,43 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork);
  */
 IoT_Error_t iot_tls_is_connected(Network *pNetwork);
 
+/**
+ * @brief Initialize the plain TCP transport
+ *
+ * Sets up the network to connect without TLS, sending and receiving the MQTT
+ * packets as they are. Connects try the endpoint list of tlsConnectParams, if
+ * any, or else the given endpoint. The socket ends up in
+ * TLSDataParams::server_fd, where the rest of the platform layer expects it.
+ * The TLS state stays empty, so iot_tls_free only releases what
+ * @ref iot_tls_wake_up needs.
+ *
+ * Only needed with ENABLE_IOT_PLAIN_TCP, a platform without plain TCP leaves it out.
+ *
+ * @param pNetwork - Pointer to a Network struct defining the network interface.
+ * @param pDestinationURL - The target endpoint to connect to
+ * @param DestinationPort - The port on the target to connect to
+ * @param timeout_ms - Longest time a connect may take
+ * @param pOptions - Socket options, copied. NULL for IoT_TCP_Options_initializer
+ *
+ * @return IoT_Error_t - SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t iot_tcp_init(Network *pNetwork, const char *pDestinationURL, uint16_t DestinationPort,
+						 uint32_t timeout_ms, const IoT_TCP_Options *pOptions);
+
+/**
+ * @brief Order in which a connect tries the endpoint list
+ *
+ * The entry that won the last connect first, then the others by
+ * TLSEndpoint::lastConnectMs, fastest first. Those that never connected come
+ * last, in the order of the list. Shared by the TLS and the plain TCP
+ * transport, so both try the endpoints in the same order.
+ *
+ * @param pParams - Connection parameters holding the endpoint list
+ * @param count - Number of entries of pEndpoints to order
+ * @param pOrder - Receives count entry indexes
+ */
+void iot_tls_order_endpoints(const TLSConnectParams *pParams, uint8_t count, uint8_t *pOrder);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,7 @@ extern "C" {
  */
 #include "threads_platform.h"
 
+#include <stdint.h>
 #include <aws_iot_error.h>
 
 /**
@@ -58,6 +59,17 @@ typedef struct _IoT_Mutex_t IoT_Mutex_t;
  */
 IoT_Error_t aws_iot_thread_mutex_init(IoT_Mutex_t *);
 
+/**
+ * @brief Initialize the provided mutex as recursive
+ *
+ * Call this function to initialize a mutex the thread holding it may lock again.
+ * Each lock needs its own unlock.
+ *
+ * @param IoT_Mutex_t - pointer to the mutex to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_mutex_init_recursive(IoT_Mutex_t *);
+
 /**
  * @brief Lock the provided mutex
  *
@@ -100,6 +112,58 @@ IoT_Error_t aws_iot_thread_mutex_unlock(IoT_Mutex_t *);
  */
 IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *);
 
+/**
+ * @brief Semaphore Type
+ *
+ * Forward declaration of a binary semaphore struct.  The definition of this struct is
+ * platform dependent.  When porting to a new platform add this definition
+ * in "threads_platform.h".
+ *
+ */
+typedef struct _IoT_Semaphore_t IoT_Semaphore_t;
+
+/**
+ * @brief Initialize the provided semaphore
+ *
+ * Call this function to initialize the semaphore in the taken state
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_init(IoT_Semaphore_t *);
+
+/**
+ * @brief Signal the provided semaphore
+ *
+ * Call this function to wake up a thread waiting on the semaphore.
+ * This is not a blocking call.
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be signalled
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_post(IoT_Semaphore_t *);
+
+/**
+ * @brief Wait on the provided semaphore
+ *
+ * Call this function to block until the semaphore is signalled or the timeout expires
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to wait on
+ * @param uint32_t - maximum time to wait in milliseconds
+ * @return IoT_Error_t - SUCCESS if signalled, SEMAPHORE_WAIT_TIMEOUT_ERROR otherwise
+ */
+IoT_Error_t aws_iot_thread_semaphore_wait(IoT_Semaphore_t *, uint32_t);
+
+/**
+ * @brief Destroy the provided semaphore
+ *
+ * Call this function to destroy the semaphore
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be destroyed
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_destroy(IoT_Semaphore_t *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -89,6 +89,26 @@ void countdown_sec(Timer *, uint32_t);
  */
 uint32_t left_ms(Timer *);
 
+/**
+ * @brief Check the time passed since a given timer expired
+ *
+ * Checks the input timer and returns the number of milliseconds since it expired.
+ * A timer set with countdown_ms(timer, 0) measures the time from that call on.
+ *
+ * @param Timer - pointer to the timer to be checked
+ * @return uint32_t - milliseconds since the timer expired, 0 if it hasn't yet
+ */
+uint32_t elapsed_ms(Timer *);
+
+/**
+ * @brief Delay (sleep) for the specified number of milliseconds
+ *
+ * Blocks the calling task and lets others run meanwhile.
+ *
+ * @param milliseconds The number of milliseconds to sleep.
+ */
+void delay(unsigned milliseconds);
+
 /**
  * @brief Initialize a timer
  *
@@ -59,6 +59,17 @@ uint32_t left_ms(Timer *timer) {
 	return result_ms;
 }
 
+uint32_t elapsed_ms(Timer *timer) {
+	struct timeval now, res;
+	uint32_t result_ms = 0;
+	gettimeofday(&now, NULL);
+	timersub(&now, &timer->end_time, &res);
+	if(res.tv_sec >= 0) {
+		result_ms = (uint32_t) (res.tv_sec * 1000 + res.tv_usec / 1000);
+	}
+	return result_ms;
+}
+
 void countdown_sec(Timer *timer, uint32_t timeout) {
 	struct timeval now;
 	struct timeval interval = {timeout, 0};
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file trace_platform.c
+ * @brief Linux timestamp and core id for the trace rings.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aws_iot_trace.h"
+
+#ifndef DISABLE_IOT_TRACE_RING
+
+uint32_t aws_iot_trace_timestamp_us(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) ((uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000);
+}
+
+uint32_t aws_iot_trace_core_id(void) {
+	unsigned int cpu = 0;
+
+	/* sched_getcpu() would need _GNU_SOURCE before the first system header */
+	if(0 != syscall(SYS_getcpu, &cpu, NULL, NULL)) {
+		return 0;
+	}
+	return cpu;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
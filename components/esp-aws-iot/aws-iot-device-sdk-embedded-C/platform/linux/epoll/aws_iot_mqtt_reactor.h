@@ -0,0 +1,187 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_reactor.h
+ * @brief epoll event loop driving many MQTT clients from a few threads
+ *
+ * Instead of one thread blocking in aws_iot_mqtt_yield per client, the sockets of all
+ * registered clients and a timer per client sit in one epoll set. A small pool of worker
+ * threads yields a client only when its socket is readable, a message was queued with
+ * aws_iot_mqtt_publish_async or its next keepalive, PUBACK timeout or reconnect attempt is
+ * due, so idle clients cost no CPU. Reconnect attempts block for the TCP connect and the
+ * TLS handshake, they run on a thread of their own so the workers keep serving the others.
+ *
+ * Works with the TLS and plain TCP transports of the Linux platform, which provide
+ * iot_tls_get_fd. The shadow API keeps global state and can't be used with more than one
+ * client.
+ */
+
+#ifndef AWS_IOT_PLATFORM_LINUX_EPOLL_AWS_IOT_MQTT_REACTOR_H_
+#define AWS_IOT_PLATFORM_LINUX_EPOLL_AWS_IOT_MQTT_REACTOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aws_iot_mqtt_client.h"
+
+#ifndef AWS_IOT_MQTT_REACTOR_MAX_WORKERS
+#define AWS_IOT_MQTT_REACTOR_MAX_WORKERS 16 ///< Largest worker pool aws_iot_mqtt_reactor_start accepts
+#endif
+
+#ifndef AWS_IOT_MQTT_REACTOR_MAX_EVENTS
+#define AWS_IOT_MQTT_REACTOR_MAX_EVENTS 64 ///< Events a worker takes from epoll in one call
+#endif
+
+#ifndef AWS_IOT_MQTT_REACTOR_YIELD_MS
+#define AWS_IOT_MQTT_REACTOR_YIELD_MS 1 ///< Yield timeout per wakeup, only spent while data keeps arriving
+#endif
+
+/**
+ * @brief Reactor error handler
+ *
+ * Called on a worker thread when yielding a client fails with anything other than a
+ * reconnect in progress. Once auto-reconnect gives up, or without it, the reactor stops
+ * driving the client until it is connected again and re-added.
+ *
+ * @param pClient Client that failed
+ * @param rc Error returned by aws_iot_mqtt_yield
+ * @param pData Data registered with the client
+ */
+typedef void (*pReactorErrorHandler)(AWS_IoT_Client *pClient, IoT_Error_t rc, void *pData);
+
+/**
+ * @brief Reactor Client Slot
+ *
+ * Per-client bookkeeping, storage is provided to @ref aws_iot_mqtt_reactor_init. Treat as opaque.
+ */
+typedef struct {
+	pthread_mutex_t lock; ///< Guards the fields below
+	pthread_cond_t idle; ///< Signalled when a worker is done with the client
+	AWS_IoT_Client *pClient; ///< NULL while the slot is free
+	pReactorErrorHandler errorHandler; ///< Optional, told about yield errors
+	void *pErrorHandlerData; ///< Passed to errorHandler
+	int timerFd; ///< Fires when the next keepalive or reconnect attempt is due
+	bool isBusy; ///< A worker is yielding the client
+	bool isRerun; ///< Another event arrived while busy, yield again before sleeping
+	bool isReconnectQueued; ///< Waits for the reconnect thread, busy until it is done. Guarded by the reactor's reconnectLock
+} IoT_MQTT_Reactor_Slot;
+
+/**
+ * @brief MQTT Reactor
+ *
+ * Treat as opaque.
+ */
+typedef struct {
+	int epollFd; ///< Sockets and timers of every client
+	int stopFd; ///< eventfd waking all workers on stop
+	pthread_mutex_t lock; ///< Guards slot allocation
+	IoT_MQTT_Reactor_Slot *pSlots; ///< Client slots
+	uint32_t numSlots; ///< Number of client slots
+	pthread_t workers[AWS_IOT_MQTT_REACTOR_MAX_WORKERS]; ///< Worker threads
+	uint32_t numWorkers; ///< Running worker threads
+	pthread_t reconnector; ///< Reconnect thread, runs while the workers do
+	pthread_mutex_t reconnectLock; ///< Guards the reconnect queue and isStopping
+	pthread_cond_t reconnectWake; ///< Signalled when a slot is queued for reconnecting or on stop
+	bool isStopping; ///< Tells the reconnect thread to finish
+} IoT_MQTT_Reactor;
+
+/**
+ * @brief Set up a reactor.
+ *
+ * Needs two file descriptors per slot, raise RLIMIT_NOFILE for thousands of clients.
+ *
+ * @param pReactor Reactor to set up
+ * @param pSlots Storage for the clients, must outlive the reactor
+ * @param numSlots Most clients that can be registered at once
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or FAILURE if the epoll set or timers can't be created
+ */
+IoT_Error_t aws_iot_mqtt_reactor_init(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlots, uint32_t numSlots);
+
+/**
+ * @brief Start the worker threads and the reconnect thread.
+ *
+ * Clients registered before the start are yielded right away. Subscribe callbacks,
+ * disconnect handlers and error handlers run on the workers or, for a reconnect attempt,
+ * on the reconnect thread. A client is never yielded by two threads at once. Clients that
+ * are published to from other threads need _ENABLE_THREAD_SUPPORT_.
+ *
+ * @param pReactor Reactor
+ * @param numWorkers Worker threads, one per core is usually plenty
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR, LIMIT_EXCEEDED_ERROR or FAILURE if a thread can't be created
+ */
+IoT_Error_t aws_iot_mqtt_reactor_start(IoT_MQTT_Reactor *pReactor, uint32_t numWorkers);
+
+/**
+ * @brief Have the reactor drive a client.
+ *
+ * The client should be connected. From now on it must not be yielded by the application.
+ *
+ * @param pReactor Reactor
+ * @param pClient Client to drive
+ * @param errorHandler Optional, told about yield errors
+ * @param pErrorHandlerData Passed to errorHandler
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR, LIMIT_EXCEEDED_ERROR if every slot is taken or FAILURE
+ */
+IoT_Error_t aws_iot_mqtt_reactor_add_client(IoT_MQTT_Reactor *pReactor, AWS_IoT_Client *pClient,
+											pReactorErrorHandler errorHandler, void *pErrorHandlerData);
+
+/**
+ * @brief Stop driving a client.
+ *
+ * Waits for a worker that is yielding the client, or for its reconnect attempt. Must not
+ * be called from that client's callbacks. Afterwards the application may yield, disconnect or free the client.
+ *
+ * @param pReactor Reactor
+ * @param pClient Client to remove
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or FAILURE if the client isn't registered
+ */
+IoT_Error_t aws_iot_mqtt_reactor_remove_client(IoT_MQTT_Reactor *pReactor, AWS_IoT_Client *pClient);
+
+/**
+ * @brief Stop the worker threads and the reconnect thread.
+ *
+ * Returns once every worker has finished and a running reconnect attempt is over. Clients stay registered and are driven again
+ * after the next start. Must not be called from a worker.
+ *
+ * @param pReactor Reactor
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or FAILURE
+ */
+IoT_Error_t aws_iot_mqtt_reactor_stop(IoT_MQTT_Reactor *pReactor);
+
+/**
+ * @brief Release a stopped reactor.
+ *
+ * @param pReactor Reactor
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_mqtt_reactor_destroy(IoT_MQTT_Reactor *pReactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_PLATFORM_LINUX_EPOLL_AWS_IOT_MQTT_REACTOR_H_ */
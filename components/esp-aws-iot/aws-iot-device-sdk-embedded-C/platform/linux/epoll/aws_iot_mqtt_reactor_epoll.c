@@ -0,0 +1,588 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_reactor_epoll.c
+ * @brief epoll event loop driving many MQTT clients from a few threads
+ *
+ * Every client has three entries in the epoll set, its socket, the descriptor
+ * iot_tls_wake_up makes readable when another thread queues a message, and a timerfd armed
+ * for its next keepalive, PUBACK timeout or reconnect deadline. All are EPOLLONESHOT, so an
+ * event goes to a single worker and stays disarmed until that worker has yielded the client
+ * and re-armed them. Should another entry fire meanwhile, its worker only flags the client
+ * for another pass.
+ *
+ * A client due for a reconnect attempt is handed to the reconnect thread instead, still
+ * busy, so no worker blocks in the TCP connect and TLS handshake. The reconnect thread
+ * yields it, re-arms it and lets the workers have it back.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "aws_iot_log.h"
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_mqtt_reactor.h"
+
+/**
+ * @brief Time until the client has timed work to do
+ *
+ * @return Milliseconds until the next keepalive, PUBACK timeout or reconnect deadline,
+ * UINT32_MAX if none
+ */
+static uint32_t _aws_iot_mqtt_reactor_due_ms(AWS_IoT_Client *pClient) {
+	ClientState state = aws_iot_mqtt_get_client_state(pClient);
+	uint32_t dueMs = UINT32_MAX;
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	uint32_t queueDueMs;
+#endif
+
+	if(CLIENT_STATE_PENDING_RECONNECT == state || CLIENT_STATE_CONNECTED_RESUBSCRIBE_IN_PROGRESS == state) {
+		return left_ms(&(pClient->reconnectDelayTimer));
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		/* Disconnected for good, nothing to do until the application reconnects */
+		return UINT32_MAX;
+	}
+
+	if(0 != pClient->clientData.keepAliveInterval) {
+		dueMs = pClient->clientStatus.isPingOutstanding ? left_ms(&(pClient->pingRespTimer))
+														: left_ms(&(pClient->pingReqTimer));
+	}
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	/* Messages queued by other threads come in through the wake-up descriptor, this only
+	 * polls for them if the network has none */
+	queueDueMs = aws_iot_mqtt_internal_publish_queue_wait_ms(pClient);
+	if(queueDueMs < dueMs) {
+		dueMs = queueDueMs;
+	}
+#endif
+
+	return dueMs;
+}
+
+/**
+ * @brief Watch a descriptor of a client for one event
+ */
+static void _aws_iot_mqtt_reactor_watch(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlot, int fd) {
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = pSlot;
+	/* A reconnect opens a new socket, closing the old one dropped it from the set */
+	if(0 != epoll_ctl(pReactor->epollFd, EPOLL_CTL_MOD, fd, &event)) {
+		if(ENOENT != errno || 0 != epoll_ctl(pReactor->epollFd, EPOLL_CTL_ADD, fd, &event)) {
+			IOT_ERROR("Reactor failed to watch descriptor %d, errno %d", fd, errno);
+		}
+	}
+}
+
+/**
+ * @brief Re-arm the socket, wake-up descriptor and timer of a client after it was yielded
+ *
+ * Called by the thread holding the client, so its socket can't change underneath.
+ */
+static void _aws_iot_mqtt_reactor_arm(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlot,
+									  AWS_IoT_Client *pClient) {
+	struct epoll_event event;
+	struct itimerspec due;
+	uint32_t dueMs;
+	int fd;
+
+	if(aws_iot_mqtt_is_client_connected(pClient)) {
+		fd = iot_tls_get_fd(&(pClient->networkStack));
+		if(0 <= fd) {
+			_aws_iot_mqtt_reactor_watch(pReactor, pSlot, fd);
+		}
+		fd = iot_tls_get_wake_fd(&(pClient->networkStack));
+		if(0 <= fd) {
+			_aws_iot_mqtt_reactor_watch(pReactor, pSlot, fd);
+		}
+	}
+
+	memset(&due, 0, sizeof(due));
+	dueMs = _aws_iot_mqtt_reactor_due_ms(pClient);
+	if(UINT32_MAX != dueMs) {
+		/* An all-zero it_value disarms the timer, fire as soon as possible instead */
+		due.it_value.tv_sec = dueMs / 1000;
+		due.it_value.tv_nsec = (0 == dueMs) ? 1 : (long) (dueMs % 1000) * 1000000;
+	}
+	(void)timerfd_settime(pSlot->timerFd, 0, &due, NULL);
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = pSlot;
+	(void)epoll_ctl(pReactor->epollFd, EPOLL_CTL_MOD, pSlot->timerFd, &event);
+}
+
+/**
+ * @brief Whether the client holds received data no socket event will announce
+ *
+ * Records already decrypted by mbedTLS, or new packets framed into the receive ring by the
+ * last pass, are only picked up by yielding again.
+ */
+static bool _aws_iot_mqtt_reactor_has_buffered_data(AWS_IoT_Client *pClient, size_t ringFillBefore) {
+	if(iot_tls_has_pending_data(&(pClient->networkStack))) {
+		return true;
+	}
+
+	/* A partial packet that didn't grow has to wait for the socket */
+	return 0 < pClient->clientData.rxRingFill && ringFillBefore != pClient->clientData.rxRingFill;
+}
+
+/**
+ * @brief Have a slot yielded as soon as a worker is free
+ */
+static void _aws_iot_mqtt_reactor_kick(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlot) {
+	struct itimerspec due;
+	struct epoll_event event;
+
+	memset(&due, 0, sizeof(due));
+	due.it_value.tv_nsec = 1;
+	(void)timerfd_settime(pSlot->timerFd, 0, &due, NULL);
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = pSlot;
+	(void)epoll_ctl(pReactor->epollFd, EPOLL_CTL_MOD, pSlot->timerFd, &event);
+}
+
+/**
+ * @brief Whether the client is due for a reconnect attempt
+ */
+static bool _aws_iot_mqtt_reactor_is_reconnect_due(AWS_IoT_Client *pClient) {
+	return CLIENT_STATE_PENDING_RECONNECT == aws_iot_mqtt_get_client_state(pClient)
+		   && has_timer_expired(&(pClient->reconnectDelayTimer));
+}
+
+/**
+ * @brief Yield a busy client once and re-arm it
+ *
+ * @return Whether the client holds data it has to be yielded again for
+ */
+static bool _aws_iot_mqtt_reactor_yield(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlot,
+										AWS_IoT_Client *pClient) {
+	size_t ringFill;
+	bool isRerun;
+	IoT_Error_t rc;
+
+	ringFill = pClient->clientData.rxRingFill;
+	rc = aws_iot_mqtt_yield(pClient, AWS_IOT_MQTT_REACTOR_YIELD_MS);
+	if(SUCCESS != rc && NETWORK_ATTEMPTING_RECONNECT != rc && NETWORK_RECONNECTED != rc
+	   && NULL != pSlot->errorHandler) {
+		pSlot->errorHandler(pClient, rc, pSlot->pErrorHandlerData);
+	}
+
+	isRerun = _aws_iot_mqtt_reactor_has_buffered_data(pClient, ringFill);
+	_aws_iot_mqtt_reactor_arm(pReactor, pSlot, pClient);
+
+	return isRerun;
+}
+
+static void _aws_iot_mqtt_reactor_service(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlot) {
+	AWS_IoT_Client *pClient;
+	unsigned char drain[64];
+	uint64_t expirations;
+	bool isRerun;
+	int wakeFd;
+
+	pthread_mutex_lock(&(pSlot->lock));
+	if(NULL == pSlot->pClient) {
+		/* Event for a client removed after epoll handed it out */
+		pthread_mutex_unlock(&(pSlot->lock));
+		return;
+	}
+	if(pSlot->isBusy) {
+		pSlot->isRerun = true;
+		pthread_mutex_unlock(&(pSlot->lock));
+		return;
+	}
+	pSlot->isBusy = true;
+	pClient = pSlot->pClient;
+	pthread_mutex_unlock(&(pSlot->lock));
+
+	do {
+		(void)read(pSlot->timerFd, &expirations, sizeof(expirations));
+		/* The yield below sends whatever woke the client up, yield itself may never sleep to read it */
+		wakeFd = iot_tls_get_wake_fd(&(pClient->networkStack));
+		if(0 <= wakeFd) {
+			while(0 < read(wakeFd, drain, sizeof(drain))) {
+			}
+		}
+
+		if(_aws_iot_mqtt_reactor_is_reconnect_due(pClient)) {
+			/* Stays busy and disarmed until the reconnect thread is done with it */
+			pthread_mutex_lock(&(pReactor->reconnectLock));
+			pSlot->isReconnectQueued = true;
+			pthread_cond_signal(&(pReactor->reconnectWake));
+			pthread_mutex_unlock(&(pReactor->reconnectLock));
+			return;
+		}
+
+		isRerun = _aws_iot_mqtt_reactor_yield(pReactor, pSlot, pClient);
+
+		pthread_mutex_lock(&(pSlot->lock));
+		isRerun = isRerun || pSlot->isRerun;
+		pSlot->isRerun = false;
+		if(!isRerun) {
+			pSlot->isBusy = false;
+			pthread_cond_broadcast(&(pSlot->idle));
+		}
+		pthread_mutex_unlock(&(pSlot->lock));
+	} while(isRerun);
+}
+
+static void *_aws_iot_mqtt_reactor_reconnector(void *pArg) {
+	IoT_MQTT_Reactor *pReactor = (IoT_MQTT_Reactor *) pArg;
+	IoT_MQTT_Reactor_Slot *pSlot;
+	bool isRerun;
+	uint32_t itr;
+
+	pthread_mutex_lock(&(pReactor->reconnectLock));
+	while(!pReactor->isStopping) {
+		pSlot = NULL;
+		for(itr = 0; itr < pReactor->numSlots && NULL == pSlot; itr++) {
+			if(pReactor->pSlots[itr].isReconnectQueued) {
+				pSlot = &(pReactor->pSlots[itr]);
+			}
+		}
+		if(NULL == pSlot) {
+			pthread_cond_wait(&(pReactor->reconnectWake), &(pReactor->reconnectLock));
+			continue;
+		}
+		pSlot->isReconnectQueued = false;
+		pthread_mutex_unlock(&(pReactor->reconnectLock));
+
+		/* The slot is busy, nobody else touches the client */
+		isRerun = _aws_iot_mqtt_reactor_yield(pReactor, pSlot, pSlot->pClient);
+
+		pthread_mutex_lock(&(pSlot->lock));
+		if(isRerun || pSlot->isRerun) {
+			/* Leave the next pass to a worker */
+			pSlot->isRerun = false;
+			_aws_iot_mqtt_reactor_kick(pReactor, pSlot);
+		}
+		pSlot->isBusy = false;
+		pthread_cond_broadcast(&(pSlot->idle));
+		pthread_mutex_unlock(&(pSlot->lock));
+
+		pthread_mutex_lock(&(pReactor->reconnectLock));
+	}
+	pthread_mutex_unlock(&(pReactor->reconnectLock));
+
+	return NULL;
+}
+
+static void *_aws_iot_mqtt_reactor_worker(void *pArg) {
+	IoT_MQTT_Reactor *pReactor = (IoT_MQTT_Reactor *) pArg;
+	struct epoll_event events[AWS_IOT_MQTT_REACTOR_MAX_EVENTS];
+	int count, itr;
+
+	for(;;) {
+		count = epoll_wait(pReactor->epollFd, events, AWS_IOT_MQTT_REACTOR_MAX_EVENTS, -1);
+		if(0 > count) {
+			if(EINTR == errno) {
+				continue;
+			}
+			IOT_ERROR("Reactor epoll_wait failed, errno %d", errno);
+			return NULL;
+		}
+
+		for(itr = 0; itr < count; itr++) {
+			if(NULL == events[itr].data.ptr) {
+				/* Stop request, level triggered so every worker sees it */
+				return NULL;
+			}
+			_aws_iot_mqtt_reactor_service(pReactor, (IoT_MQTT_Reactor_Slot *) events[itr].data.ptr);
+		}
+	}
+}
+
+static void _aws_iot_mqtt_reactor_release(IoT_MQTT_Reactor *pReactor, uint32_t numSlots) {
+	uint32_t itr;
+
+	for(itr = 0; itr < numSlots; itr++) {
+		close(pReactor->pSlots[itr].timerFd);
+		pthread_cond_destroy(&(pReactor->pSlots[itr].idle));
+		pthread_mutex_destroy(&(pReactor->pSlots[itr].lock));
+	}
+	if(0 <= pReactor->stopFd) {
+		close(pReactor->stopFd);
+	}
+	close(pReactor->epollFd);
+	pthread_cond_destroy(&(pReactor->reconnectWake));
+	pthread_mutex_destroy(&(pReactor->reconnectLock));
+	pthread_mutex_destroy(&(pReactor->lock));
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_init(IoT_MQTT_Reactor *pReactor, IoT_MQTT_Reactor_Slot *pSlots, uint32_t numSlots) {
+	IoT_MQTT_Reactor_Slot *pSlot;
+	struct epoll_event event;
+	uint32_t itr;
+
+	FUNC_ENTRY;
+
+	if(NULL == pReactor || NULL == pSlots || 0 == numSlots) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memset(pReactor, 0, sizeof(IoT_MQTT_Reactor));
+	pReactor->pSlots = pSlots;
+	pReactor->stopFd = -1;
+	pReactor->isStopping = true;
+
+	pReactor->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(0 > pReactor->epollFd) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+	pthread_mutex_init(&(pReactor->lock), NULL);
+	pthread_mutex_init(&(pReactor->reconnectLock), NULL);
+	pthread_cond_init(&(pReactor->reconnectWake), NULL);
+
+	pReactor->stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if(0 > pReactor->stopFd || 0 != epoll_ctl(pReactor->epollFd, EPOLL_CTL_ADD, pReactor->stopFd, &event)) {
+		_aws_iot_mqtt_reactor_release(pReactor, 0);
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	for(itr = 0; itr < numSlots; itr++) {
+		pSlot = &(pSlots[itr]);
+		memset(pSlot, 0, sizeof(IoT_MQTT_Reactor_Slot));
+		pthread_mutex_init(&(pSlot->lock), NULL);
+		pthread_cond_init(&(pSlot->idle), NULL);
+
+		/* Timers stay in the set, disarmed, while the slot is free */
+		pSlot->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLONESHOT;
+		event.data.ptr = pSlot;
+		if(0 > pSlot->timerFd || 0 != epoll_ctl(pReactor->epollFd, EPOLL_CTL_ADD, pSlot->timerFd, &event)) {
+			_aws_iot_mqtt_reactor_release(pReactor, itr + 1);
+			FUNC_EXIT_RC(FAILURE);
+		}
+	}
+	pReactor->numSlots = numSlots;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_start(IoT_MQTT_Reactor *pReactor, uint32_t numWorkers) {
+	uint64_t value;
+	uint32_t itr;
+
+	FUNC_ENTRY;
+
+	if(NULL == pReactor || 0 == numWorkers) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(AWS_IOT_MQTT_REACTOR_MAX_WORKERS < numWorkers || 0 != pReactor->numWorkers) {
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	/* Clear a stop request left by the previous run */
+	(void)read(pReactor->stopFd, &value, sizeof(value));
+
+	/* Events taken by workers that stopped before handling them are lost, start over */
+	pthread_mutex_lock(&(pReactor->lock));
+	for(itr = 0; itr < pReactor->numSlots; itr++) {
+		if(NULL != pReactor->pSlots[itr].pClient) {
+			_aws_iot_mqtt_reactor_kick(pReactor, &(pReactor->pSlots[itr]));
+		}
+	}
+	pthread_mutex_unlock(&(pReactor->lock));
+
+	pReactor->isStopping = false;
+	if(0 != pthread_create(&(pReactor->reconnector), NULL, _aws_iot_mqtt_reactor_reconnector, pReactor)) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	for(itr = 0; itr < numWorkers; itr++) {
+		if(0 != pthread_create(&(pReactor->workers[itr]), NULL, _aws_iot_mqtt_reactor_worker, pReactor)) {
+			pReactor->numWorkers = itr;
+			(void)aws_iot_mqtt_reactor_stop(pReactor);
+			FUNC_EXIT_RC(FAILURE);
+		}
+	}
+	pReactor->numWorkers = numWorkers;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_add_client(IoT_MQTT_Reactor *pReactor, AWS_IoT_Client *pClient,
+											pReactorErrorHandler errorHandler, void *pErrorHandlerData) {
+	IoT_MQTT_Reactor_Slot *pSlot = NULL;
+	uint32_t itr;
+
+	FUNC_ENTRY;
+
+	if(NULL == pReactor || NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pthread_mutex_lock(&(pReactor->lock));
+	for(itr = 0; itr < pReactor->numSlots; itr++) {
+		if(pClient == pReactor->pSlots[itr].pClient) {
+			pthread_mutex_unlock(&(pReactor->lock));
+			FUNC_EXIT_RC(FAILURE);
+		}
+		if(NULL == pSlot && NULL == pReactor->pSlots[itr].pClient) {
+			pSlot = &(pReactor->pSlots[itr]);
+		}
+	}
+
+	if(NULL == pSlot) {
+		pthread_mutex_unlock(&(pReactor->lock));
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	/* A worker may still be passing through after the previous client was removed */
+	pthread_mutex_lock(&(pSlot->lock));
+	while(pSlot->isBusy) {
+		pthread_cond_wait(&(pSlot->idle), &(pSlot->lock));
+	}
+	pSlot->errorHandler = errorHandler;
+	pSlot->pErrorHandlerData = pErrorHandlerData;
+	pSlot->isRerun = false;
+	pSlot->pClient = pClient;
+	pthread_mutex_unlock(&(pSlot->lock));
+	pthread_mutex_unlock(&(pReactor->lock));
+
+	/* The first pass registers the socket and arms the timer */
+	_aws_iot_mqtt_reactor_kick(pReactor, pSlot);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_remove_client(IoT_MQTT_Reactor *pReactor, AWS_IoT_Client *pClient) {
+	IoT_MQTT_Reactor_Slot *pSlot = NULL;
+	struct itimerspec disarm;
+	uint32_t itr;
+	int fd;
+
+	FUNC_ENTRY;
+
+	if(NULL == pReactor || NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pthread_mutex_lock(&(pReactor->lock));
+	for(itr = 0; itr < pReactor->numSlots && NULL == pSlot; itr++) {
+		if(pClient == pReactor->pSlots[itr].pClient) {
+			pSlot = &(pReactor->pSlots[itr]);
+		}
+	}
+
+	if(NULL == pSlot) {
+		pthread_mutex_unlock(&(pReactor->lock));
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	pthread_mutex_lock(&(pSlot->lock));
+	while(pSlot->isBusy) {
+		pthread_cond_wait(&(pSlot->idle), &(pSlot->lock));
+	}
+	pSlot->pClient = NULL;
+
+	fd = iot_tls_get_fd(&(pClient->networkStack));
+	if(0 <= fd) {
+		(void)epoll_ctl(pReactor->epollFd, EPOLL_CTL_DEL, fd, NULL);
+	}
+	fd = iot_tls_get_wake_fd(&(pClient->networkStack));
+	if(0 <= fd) {
+		(void)epoll_ctl(pReactor->epollFd, EPOLL_CTL_DEL, fd, NULL);
+	}
+	memset(&disarm, 0, sizeof(disarm));
+	(void)timerfd_settime(pSlot->timerFd, 0, &disarm, NULL);
+	pthread_mutex_unlock(&(pSlot->lock));
+	pthread_mutex_unlock(&(pReactor->lock));
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_stop(IoT_MQTT_Reactor *pReactor) {
+	IoT_MQTT_Reactor_Slot *pSlot;
+	uint64_t value = 1;
+	uint32_t itr;
+
+	FUNC_ENTRY;
+
+	if(NULL == pReactor) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(sizeof(value) != write(pReactor->stopFd, &value, sizeof(value))) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	for(itr = 0; itr < pReactor->numWorkers; itr++) {
+		pthread_join(pReactor->workers[itr], NULL);
+	}
+	pReactor->numWorkers = 0;
+
+	pthread_mutex_lock(&(pReactor->reconnectLock));
+	if(!pReactor->isStopping) {
+		pReactor->isStopping = true;
+		pthread_cond_signal(&(pReactor->reconnectWake));
+		pthread_mutex_unlock(&(pReactor->reconnectLock));
+		pthread_join(pReactor->reconnector, NULL);
+	} else {
+		pthread_mutex_unlock(&(pReactor->reconnectLock));
+	}
+
+	/* Reconnects still queued are left to the next start */
+	for(itr = 0; itr < pReactor->numSlots; itr++) {
+		pSlot = &(pReactor->pSlots[itr]);
+		if(pSlot->isReconnectQueued) {
+			pSlot->isReconnectQueued = false;
+			pthread_mutex_lock(&(pSlot->lock));
+			pSlot->isBusy = false;
+			pthread_cond_broadcast(&(pSlot->idle));
+			pthread_mutex_unlock(&(pSlot->lock));
+		}
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reactor_destroy(IoT_MQTT_Reactor *pReactor) {
+	FUNC_ENTRY;
+
+	if(NULL == pReactor) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	_aws_iot_mqtt_reactor_release(pReactor, pReactor->numSlots);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,7 +18,18 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/select.h>
+#include <sys/socket.h>
 #include "aws_iot_config.h"
 
 #include <timer_platform.h>
@@ -29,10 +40,76 @@ extern "C" {
 #include "network_interface.h"
 #include "network_platform.h"
 
+#include "mbedtls/asn1.h"
+#include "mbedtls/version.h"
+#include "mbedtls/ssl_internal.h"
+
 
 /* This is the value used for ssl read timeout */
 #define IOT_SSL_READ_TIMEOUT 10
 
+/* Longest wait for room in the socket to send the close notify */
+#define IOT_SSL_CLOSE_NOTIFY_TIMEOUT 100
+
+/* Most endpoints of a list raced at the same time, one socket each */
+#define IOT_TLS_MAX_RACED_ENDPOINTS 4
+
+#ifndef AWS_IOT_TLS_MAX_FRAGMENT_LEN
+/* Longest record the lean profile asks the server for */
+#define AWS_IOT_TLS_MAX_FRAGMENT_LEN 2048
+#endif
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+#if AWS_IOT_TLS_MAX_FRAGMENT_LEN == 512
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_512
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 1024
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 2048
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 4096
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#else
+#error "AWS_IOT_TLS_MAX_FRAGMENT_LEN must be 512, 1024, 2048 or 4096"
+#endif
+#endif
+
+/* Referenced by the shared config, so it must outlive every connect */
+static const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
+
+#if (defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) || defined(MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED)) \
+	&& ((defined(MBEDTLS_GCM_C) && defined(MBEDTLS_AES_C)) || defined(MBEDTLS_CHACHAPOLY_C)) \
+	&& (defined(MBEDTLS_ECP_DP_CURVE25519_ENABLED) || defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED))
+#define IOT_TLS_FAST_HANDSHAKE_SUPPORTED
+
+/* Suites of the fast handshake profile, AES-128-GCM first for the builds with AES hardware.
+ * mbedtls leaves the ones it was built without out of the client hello. */
+static const int fastHandshakeCiphersuites[] = {
+	MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+	MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+#ifdef MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256
+	MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+	MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+#endif
+	0
+};
+
+/* Curves of the fast handshake profile, a curve missing from the build must not be listed */
+static const mbedtls_ecp_group_id fastHandshakeCurves[] = {
+#if defined(MBEDTLS_ECP_DP_CURVE25519_ENABLED)
+	MBEDTLS_ECP_DP_CURVE25519,
+#endif
+#if defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED)
+	MBEDTLS_ECP_DP_SECP256R1,
+#endif
+	MBEDTLS_ECP_DP_NONE
+};
+#endif
+
+#if !defined(DISABLE_IOT_TLS_SESSION_RESUMPTION) && !defined(AWS_IOT_TLS_SESSION_LIFETIME_SEC)
+/* Longest time after the full handshake a session is offered again */
+#define AWS_IOT_TLS_SESSION_LIFETIME_SEC 3600
+#endif
+
 /* This defines the value of the debug buffer that gets allocated.
  * The value can be altered based on memory constraints
  */
@@ -74,55 +151,573 @@ void _iot_tls_set_connect_params(Network *pNetwork, char *pRootCALocation, char
 	pNetwork->tlsConnectParams.ServerVerificationFlag = ServerVerificationFlag;
 }
 
+/*
+ * Open the pipe that wakes up iot_tls_wait_for_readable. Without it the network
+ * is left without wakeUp, and the client falls back to polling.
+ */
+static void _iot_tls_open_wake_pipe(Network *pNetwork) {
+	int *wakeFd = pNetwork->tlsDataParams.wakeFd;
+
+	pNetwork->wakeUp = NULL;
+	if(0 != pipe(wakeFd)) {
+		IOT_WARN("Unable to open the wake-up pipe, errno %d\n", errno);
+		wakeFd[0] = -1;
+		wakeFd[1] = -1;
+		return;
+	}
+	/* A full pipe already wakes the next wait, the write may be dropped */
+	(void) fcntl(wakeFd[0], F_SETFL, fcntl(wakeFd[0], F_GETFL) | O_NONBLOCK);
+	(void) fcntl(wakeFd[1], F_SETFL, fcntl(wakeFd[1], F_GETFL) | O_NONBLOCK);
+	pNetwork->wakeUp = iot_tls_wake_up;
+}
+
 IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
 						 char *pDevicePrivateKeyLocation, char *pDestinationURL,
 						 uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
 	_iot_tls_set_connect_params(pNetwork, pRootCALocation, pDeviceCertLocation, pDevicePrivateKeyLocation,
 								pDestinationURL, destinationPort, timeout_ms, ServerVerificationFlag);
+	pNetwork->tlsConnectParams.pEndpoints = NULL;
+	pNetwork->tlsConnectParams.endpointCount = 0;
+	pNetwork->tlsConnectParams.preferredEndpoint = 0;
+	pNetwork->tlsConnectParams.endpointRaceDelay_ms = 0;
+	pNetwork->tlsConnectParams.rootCALen = 0;
+	pNetwork->tlsConnectParams.deviceCertLen = 0;
+	pNetwork->tlsConnectParams.devicePrivateKeyLen = 0;
+	pNetwork->tlsConnectParams.tlsProfile = IOT_TLS_PROFILE_DEFAULT;
 
 	pNetwork->connect = iot_tls_connect;
 	pNetwork->read = iot_tls_read;
+	pNetwork->readAvailable = iot_tls_read_available;
+	pNetwork->waitForReadable = iot_tls_wait_for_readable;
 	pNetwork->write = iot_tls_write;
 	pNetwork->disconnect = iot_tls_disconnect;
 	pNetwork->isConnected = iot_tls_is_connected;
 	pNetwork->destroy = iot_tls_destroy;
 
 	pNetwork->tlsDataParams.flags = 0;
+	pNetwork->tlsDataParams.isConfigLoaded = false;
+	mbedtls_ssl_init(&(pNetwork->tlsDataParams.ssl));
+	mbedtls_ssl_session_init(&(pNetwork->tlsDataParams.savedSession));
+	pNetwork->tlsDataParams.isSessionSaved = false;
+	pNetwork->tlsDataParams.isSessionResumed = false;
+	pNetwork->tlsDataParams.pSessionHost = NULL;
+	pNetwork->tlsDataParams.sessionPort = 0;
+	init_timer(&(pNetwork->tlsDataParams.sessionExpiry));
+	_iot_tls_open_wake_pipe(pNetwork);
 
 	return SUCCESS;
 }
 
-IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
-	/* Use this to add implementation which can check for physical layer disconnect */
-	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+static void _iot_tls_forget_session(TLSDataParams *tlsDataParams) {
+	if(tlsDataParams->isSessionSaved) {
+		mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+		tlsDataParams->isSessionSaved = false;
+	}
 }
 
-IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
-	int ret = 0;
-	const char *pers = "aws_iot_tls_wrapper";
-	TLSDataParams *tlsDataParams = NULL;
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+/*
+ * Offer the saved session to the handshake about to start, unless it expired
+ * or was negotiated with another endpoint.
+ */
+static void _iot_tls_offer_session(Network *pNetwork) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	int ret;
+
+	tlsDataParams->isSessionResumed = false;
+	if(!tlsDataParams->isSessionSaved) {
+		return;
+	}
+
+	if(has_timer_expired(&(tlsDataParams->sessionExpiry))
+	   || tlsDataParams->sessionPort != pNetwork->tlsConnectParams.DestinationPort
+	   || 0 != strcmp(tlsDataParams->pSessionHost, pNetwork->tlsConnectParams.pDestinationURL)) {
+		IOT_DEBUG("  . Saved TLS session expired or belongs to another endpoint, doing a full handshake\n");
+		_iot_tls_forget_session(tlsDataParams);
+		return;
+	}
+
+	if((ret = mbedtls_ssl_set_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) != 0) {
+		IOT_WARN("mbedtls_ssl_set_session returned -0x%x, doing a full handshake\n", -ret);
+		_iot_tls_forget_session(tlsDataParams);
+	}
+}
+
+/*
+ * Keep the session of a successful handshake for the next connect.
+ *
+ * A resumed session keeps the expiry of the full handshake it came from, so
+ * one master secret is not used for longer than the configured lifetime.
+ */
+static void _iot_tls_save_session(Network *pNetwork) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	uint32_t lifetime_sec = AWS_IOT_TLS_SESSION_LIFETIME_SEC;
+	int ret;
+
+	/* Resumption carries the master secret over, a full handshake derives a new one */
+	tlsDataParams->isSessionResumed = tlsDataParams->isSessionSaved
+		&& 0 == memcmp(tlsDataParams->ssl.session->master, tlsDataParams->savedSession.master,
+					   sizeof(tlsDataParams->savedSession.master));
+
+	_iot_tls_forget_session(tlsDataParams);
+	if((ret = mbedtls_ssl_get_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) != 0) {
+		IOT_WARN("mbedtls_ssl_get_session returned -0x%x, next connect does a full handshake\n", -ret);
+		mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+		return;
+	}
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+	if(NULL != tlsDataParams->savedSession.ticket && 0 < tlsDataParams->savedSession.ticket_lifetime
+	   && tlsDataParams->savedSession.ticket_lifetime < lifetime_sec) {
+		lifetime_sec = tlsDataParams->savedSession.ticket_lifetime;
+	}
+	if(0 == tlsDataParams->savedSession.id_len && NULL == tlsDataParams->savedSession.ticket) {
+#else
+	if(0 == tlsDataParams->savedSession.id_len) {
+#endif
+		/* Server gave neither a session ID nor a ticket */
+		mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+		return;
+	}
+
+	if(!tlsDataParams->isSessionResumed || lifetime_sec * 1000 < left_ms(&(tlsDataParams->sessionExpiry))) {
+		countdown_sec(&(tlsDataParams->sessionExpiry), lifetime_sec);
+	}
+	tlsDataParams->pSessionHost = pNetwork->tlsConnectParams.pDestinationURL;
+	tlsDataParams->sessionPort = pNetwork->tlsConnectParams.DestinationPort;
+	tlsDataParams->isSessionSaved = true;
+}
+#endif
+
+/*
+ * Lookup of one endpoint on a thread of its own, so that the lookups of a
+ * race overlap. A race can be over before its lookups are, so the race and
+ * the thread each hold a reference and the last one frees the job.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct addrinfo *pAddrList;
+	int result;
+	bool isDone;
+	uint8_t refs;
+	char port[6];
+	char host[];
+} TLSResolveJob;
+
+static int _iot_tls_getaddrinfo(const char *pHost, const char *pPort, struct addrinfo **ppAddrList) {
+	struct addrinfo hints;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	*ppAddrList = NULL;
+	if(getaddrinfo(pHost, pPort, &hints, ppAddrList) != 0 || NULL == *ppAddrList) {
+		*ppAddrList = NULL;
+		return MBEDTLS_ERR_NET_UNKNOWN_HOST;
+	}
+
+	return 0;
+}
+
+static void _iot_tls_resolve_release(TLSResolveJob *pJob) {
+	bool isLast;
+
+	pthread_mutex_lock(&(pJob->lock));
+	pJob->refs--;
+	isLast = (0 == pJob->refs);
+	pthread_mutex_unlock(&(pJob->lock));
+
+	if(isLast) {
+		if(NULL != pJob->pAddrList) {
+			freeaddrinfo(pJob->pAddrList);
+		}
+		pthread_cond_destroy(&(pJob->cond));
+		pthread_mutex_destroy(&(pJob->lock));
+		free(pJob);
+	}
+}
+
+static void *_iot_tls_resolve_runner(void *pArg) {
+	TLSResolveJob *pJob = (TLSResolveJob *) pArg;
+	struct addrinfo *pAddrList;
+	int result = _iot_tls_getaddrinfo(pJob->host, pJob->port, &pAddrList);
+
+	pthread_mutex_lock(&(pJob->lock));
+	pJob->pAddrList = pAddrList;
+	pJob->result = result;
+	pJob->isDone = true;
+	pthread_cond_broadcast(&(pJob->cond));
+	pthread_mutex_unlock(&(pJob->lock));
+
+	_iot_tls_resolve_release(pJob);
+	return NULL;
+}
+
+/*
+ * Start the lookup of an endpoint on a detached thread.
+ *
+ * Returns NULL without memory or a thread for it, the endpoint is then
+ * looked up when it starts.
+ */
+static TLSResolveJob *_iot_tls_resolve_start(const TLSEndpoint *pEndpoint) {
+	TLSResolveJob *pJob;
+	pthread_attr_t attr;
+	pthread_t thread;
+	size_t hostLen;
+	int ret;
+
+	if(NULL == pEndpoint->pDestinationURL) {
+		return NULL;
+	}
+
+	hostLen = strlen(pEndpoint->pDestinationURL);
+	pJob = (TLSResolveJob *) malloc(sizeof(TLSResolveJob) + hostLen + 1);
+	if(NULL == pJob) {
+		return NULL;
+	}
+	memset(pJob, 0, sizeof(TLSResolveJob));
+	memcpy(pJob->host, pEndpoint->pDestinationURL, hostLen + 1);
+	snprintf(pJob->port, sizeof(pJob->port), "%d", pEndpoint->DestinationPort);
+	pthread_mutex_init(&(pJob->lock), NULL);
+	pthread_cond_init(&(pJob->cond), NULL);
+	pJob->refs = 2;
+
+	ret = pthread_attr_init(&attr);
+	if(0 == ret) {
+		(void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		ret = pthread_create(&thread, &attr, _iot_tls_resolve_runner, pJob);
+		(void)pthread_attr_destroy(&attr);
+	}
+	if(0 != ret) {
+		pJob->refs = 1;
+		_iot_tls_resolve_release(pJob);
+		return NULL;
+	}
+
+	return pJob;
+}
+
+/*
+ * Wait for the lookup of a job until the timer expires.
+ *
+ * Returns true once the lookup is done, its result and addresses are then
+ * owned by the job.
+ */
+static bool _iot_tls_resolve_wait(TLSResolveJob *pJob, Timer *pTimer, int *pResult,
+								  struct addrinfo **ppAddrList) {
+	struct timespec deadline;
+	uint32_t waitMs;
+	bool isDone;
+
+	pthread_mutex_lock(&(pJob->lock));
+	while(!pJob->isDone && !has_timer_expired(pTimer)) {
+		waitMs = left_ms(pTimer);
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += waitMs / 1000;
+		deadline.tv_nsec += (long) (waitMs % 1000) * 1000000L;
+		if(deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		(void)pthread_cond_timedwait(&(pJob->cond), &(pJob->lock), &deadline);
+	}
+	isDone = pJob->isDone;
+	*pResult = pJob->result;
+	*ppAddrList = pJob->pAddrList;
+	pthread_mutex_unlock(&(pJob->lock));
+
+	return isDone;
+}
+
+/*
+ * Start a non-blocking TCP connect to one endpoint of the list.
+ *
+ * Takes the addresses from pJob, waiting for its lookup until pTimer
+ * expires, or looks the endpoint up itself if pJob is NULL.
+ *
+ * Returns the socket, or -1 with *pRet set to the mbedtls error.
+ */
+static int _iot_tls_start_endpoint(const TLSEndpoint *pEndpoint, TLSResolveJob *pJob, Timer *pTimer, int *pRet) {
+	struct addrinfo *pAddrList = NULL;
+	struct addrinfo *pAddr;
 	char portBuffer[6];
-	char vrfy_buf[512];
-	const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
+	int fd = -1;
+	int result = MBEDTLS_ERR_NET_UNKNOWN_HOST;
 
-#ifdef ENABLE_IOT_DEBUG
-	unsigned char buf[MBEDTLS_DEBUG_BUFFER_SIZE];
+	snprintf(portBuffer, sizeof(portBuffer), "%d", pEndpoint->DestinationPort);
+	if(NULL == pJob) {
+		result = _iot_tls_getaddrinfo(pEndpoint->pDestinationURL, portBuffer, &pAddrList);
+	} else if(!_iot_tls_resolve_wait(pJob, pTimer, &result, &pAddrList)) {
+		result = MBEDTLS_ERR_NET_UNKNOWN_HOST;
+	}
+	if(0 != result) {
+		IOT_WARN("Endpoint %s unknown\n", pEndpoint->pDestinationURL);
+		*pRet = result;
+		return -1;
+	}
+
+	*pRet = MBEDTLS_ERR_NET_SOCKET_FAILED;
+	for(pAddr = pAddrList; NULL != pAddr; pAddr = pAddr->ai_next) {
+		fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+		if(fd < 0) {
+			continue;
+		}
+		if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == 0 &&
+		   (connect(fd, pAddr->ai_addr, pAddr->ai_addrlen) == 0 || EINPROGRESS == errno)) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+		*pRet = MBEDTLS_ERR_NET_CONNECT_FAILED;
+	}
+	if(NULL == pJob) {
+		freeaddrinfo(pAddrList);
+	}
+
+	IOT_DEBUG("Connecting to %s/%s...\n", pEndpoint->pDestinationURL, portBuffer);
+	return fd;
+}
+
+/* Rank of an endpoint in the race order, the time of its last connect or last of all if none */
+static uint32_t _iot_tls_endpoint_rank(const TLSEndpoint *pEndpoint) {
+	return (0 == pEndpoint->lastConnectMs) ? UINT32_MAX : pEndpoint->lastConnectMs;
+}
+
+void iot_tls_order_endpoints(const TLSConnectParams *pParams, uint8_t count, uint8_t *pOrder) {
+	uint8_t i, j;
+	uint8_t ordered = 1;
+
+	pOrder[0] = pParams->preferredEndpoint;
+	for(i = 0; i < count; i++) {
+		if(i == pParams->preferredEndpoint) {
+			continue;
+		}
+		for(j = ordered; 1 < j && _iot_tls_endpoint_rank(&(pParams->pEndpoints[pOrder[j - 1]]))
+				> _iot_tls_endpoint_rank(&(pParams->pEndpoints[i])); j--) {
+			pOrder[j] = pOrder[j - 1];
+		}
+		pOrder[j] = i;
+		ordered++;
+	}
+}
+
+/*
+ * Race the TCP connects of the endpoint list, the first one to complete wins.
+ *
+ * Endpoints start in the order of iot_tls_order_endpoints, each one
+ * endpointRaceDelay_ms after the one before, or at once when an earlier one
+ * fails. All lookups start with the race, so a later endpoint only waits for
+ * what is left of its lookup once its head start is over.
+ * Only the winner gets a TLS handshake, two handshakes in parallel would need
+ * a second mbedtls context and double the peak heap. On success the winner is
+ * made the preferred endpoint and copied to pDestinationURL/DestinationPort
+ * so that SNI and ALPN apply to it.
+ */
+static int _iot_tls_race_endpoints(TLSConnectParams *pParams, mbedtls_net_context *pServerFd) {
+	int fds[IOT_TLS_MAX_RACED_ENDPOINTS];
+	TLSResolveJob *jobs[IOT_TLS_MAX_RACED_ENDPOINTS];
+	uint8_t order[IOT_TLS_MAX_RACED_ENDPOINTS];
+	uint8_t count = MIN(pParams->endpointCount, IOT_TLS_MAX_RACED_ENDPOINTS);
+	uint8_t started = 0;
+	uint8_t i;
+	int winner = -1;
+	int ret = MBEDTLS_ERR_NET_CONNECT_FAILED;
+	int maxFd, soError;
+	socklen_t soErrorLen;
+	uint32_t waitMs;
+	fd_set writeFds;
+	struct timeval tv;
+	Timer raceTimer, nextTimer;
+
+	if(pParams->preferredEndpoint >= count) {
+		pParams->preferredEndpoint = 0;
+	}
+
+	init_timer(&raceTimer);
+	countdown_ms(&raceTimer, pParams->timeout_ms);
+	init_timer(&nextTimer);
+
+	iot_tls_order_endpoints(pParams, count, order);
+	for(i = 0; i < count; i++) {
+		/* A race of one has nothing to overlap its lookup with */
+		jobs[i] = (1 < count) ? _iot_tls_resolve_start(&(pParams->pEndpoints[order[i]])) : NULL;
+	}
+
+	while(winner < 0 && !has_timer_expired(&raceTimer)) {
+		if(started < count && has_timer_expired(&nextTimer)) {
+			fds[started] = _iot_tls_start_endpoint(&(pParams->pEndpoints[order[started]]), jobs[started],
+												   &raceTimer, &ret);
+			started++;
+			if(fds[started - 1] >= 0) {
+				countdown_ms(&nextTimer, pParams->endpointRaceDelay_ms);
+			} else {
+				init_timer(&nextTimer);
+			}
+			continue;
+		}
+
+		FD_ZERO(&writeFds);
+		maxFd = -1;
+		for(i = 0; i < started; i++) {
+			if(fds[i] >= 0) {
+				FD_SET(fds[i], &writeFds);
+				maxFd = MAX(maxFd, fds[i]);
+			}
+		}
+		if(maxFd < 0) {
+			if(started == count) {
+				break;
+			}
+			continue;
+		}
+
+		waitMs = left_ms(&raceTimer);
+		if(started < count) {
+			waitMs = MIN(waitMs, left_ms(&nextTimer));
+		}
+		tv.tv_sec = waitMs / 1000;
+		tv.tv_usec = (waitMs % 1000) * 1000;
+		if(select(maxFd + 1, NULL, &writeFds, NULL, &tv) < 0) {
+			if(EINTR == errno) {
+				continue;
+			}
+			break;
+		}
+
+		for(i = 0; i < started && winner < 0; i++) {
+			if(fds[i] < 0 || !FD_ISSET(fds[i], &writeFds)) {
+				continue;
+			}
+			soError = 0;
+			soErrorLen = sizeof(soError);
+			if(getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &soError, &soErrorLen) == 0 && 0 == soError) {
+				winner = i;
+			} else {
+				close(fds[i]);
+				fds[i] = -1;
+				ret = MBEDTLS_ERR_NET_CONNECT_FAILED;
+				/* Don't keep the next endpoint waiting for a head start on a failed one */
+				init_timer(&nextTimer);
+			}
+		}
+	}
+
+	for(i = 0; i < count; i++) {
+		if(i < started && fds[i] >= 0 && i != winner) {
+			close(fds[i]);
+		}
+		if(NULL != jobs[i]) {
+			_iot_tls_resolve_release(jobs[i]);
+		}
+	}
+	if(winner < 0) {
+		return ret;
+	}
+
+	pServerFd->fd = fds[winner];
+	pParams->preferredEndpoint = order[winner];
+	pParams->pDestinationURL = pParams->pEndpoints[pParams->preferredEndpoint].pDestinationURL;
+	pParams->DestinationPort = pParams->pEndpoints[pParams->preferredEndpoint].DestinationPort;
+	IOT_DEBUG("Endpoint %s won the connect race\n", pParams->pDestinationURL);
+
+	return 0;
+}
+
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+/*
+ * Sleep in poll until the socket is ready for what mbedtls asked for with
+ * want (MBEDTLS_ERR_SSL_WANT_READ or _WRITE), or the timer expires.
+ *
+ * Returns 0 once ready, MBEDTLS_ERR_SSL_TIMEOUT or MBEDTLS_ERR_NET_POLL_FAILED.
+ */
+static int _iot_tls_wait(TLSDataParams *tlsDataParams, int want, Timer *timer) {
+	int ret = mbedtls_net_poll(&(tlsDataParams->server_fd),
+							   (MBEDTLS_ERR_SSL_WANT_WRITE == want) ? MBEDTLS_NET_POLL_WRITE : MBEDTLS_NET_POLL_READ,
+							   left_ms(timer));
+	if(ret > 0) {
+		return 0;
+	}
+	return (0 == ret) ? MBEDTLS_ERR_SSL_TIMEOUT : ret;
+}
 #endif
 
-	if(NULL == pNetwork) {
-		return NULL_VALUE_ERROR;
+/*
+ * Parse a certificate from a file or, with len set, from PEM or DER in memory.
+ *
+ * DER may hold several certificates back to back. It needs no base64 decoding
+ * and, where mbedTLS allows it, is referenced in place instead of copied to
+ * the heap, so it has to outlive the config.
+ */
+static int _iot_tls_parse_crt(mbedtls_x509_crt *pCrt, const char *pLocation, size_t len) {
+	const unsigned char *pDer = (const unsigned char *) pLocation;
+	unsigned char *p;
+	size_t crtLen;
+	int ret;
+
+	if(0 == len) {
+		return mbedtls_x509_crt_parse_file(pCrt, pLocation);
 	}
 
-	if(NULL != params) {
-		_iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
-									params->pDevicePrivateKeyLocation, params->pDestinationURL,
-									params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+	if((MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE) != pDer[0]) {
+		/* PEM, len includes the terminating NUL */
+		return mbedtls_x509_crt_parse(pCrt, pDer, len);
 	}
 
-	tlsDataParams = &(pNetwork->tlsDataParams);
+	while(0 < len) {
+		p = (unsigned char *) pDer;
+		if((ret = mbedtls_asn1_get_tag(&p, pDer + len, &crtLen,
+									   MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE)) != 0) {
+			return ret;
+		}
+		crtLen += (size_t) (p - pDer);
+#if MBEDTLS_VERSION_NUMBER >= 0x02110000
+		ret = mbedtls_x509_crt_parse_der_nocopy(pCrt, pDer, crtLen);
+#else
+		ret = mbedtls_x509_crt_parse_der(pCrt, pDer, crtLen);
+#endif
+		if(0 != ret) {
+			return ret;
+		}
+		pDer += crtLen;
+		len -= crtLen;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse a private key from a file or, with len set, from PEM or DER in memory.
+ */
+static int _iot_tls_parse_key(mbedtls_pk_context *pKey, const char *pLocation, size_t len) {
+	if(0 == len) {
+		return mbedtls_pk_parse_keyfile(pKey, pLocation, "");
+	}
+
+	return mbedtls_pk_parse_key(pKey, (const unsigned char *) pLocation, len, (const unsigned char *) "", 0);
+}
+
+static void _iot_tls_free_config(TLSDataParams *tlsDataParams) {
+	mbedtls_x509_crt_free(&(tlsDataParams->clicert));
+	mbedtls_x509_crt_free(&(tlsDataParams->cacert));
+	mbedtls_pk_free(&(tlsDataParams->pkey));
+	mbedtls_ssl_config_free(&(tlsDataParams->conf));
+	mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
+	mbedtls_entropy_free(&(tlsDataParams->entropy));
+	tlsDataParams->isConfigLoaded = false;
+}
+
+/*
+ * Seed the random number generator, parse the credentials and build the TLS
+ * config. Done by the first connect only, later connects and reconnects
+ * reference the result and set up nothing but a fresh ssl context.
+ */
+static IoT_Error_t _iot_tls_load_config(Network *pNetwork) {
+	int ret = 0;
+	const char *pers = "aws_iot_tls_wrapper";
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
-	mbedtls_net_init(&(tlsDataParams->server_fd));
-	mbedtls_ssl_init(&(tlsDataParams->ssl));
 	mbedtls_ssl_config_init(&(tlsDataParams->conf));
 	mbedtls_ctr_drbg_init(&(tlsDataParams->ctr_drbg));
 	mbedtls_x509_crt_init(&(tlsDataParams->cacert));
@@ -134,35 +729,152 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	if((ret = mbedtls_ctr_drbg_seed(&(tlsDataParams->ctr_drbg), mbedtls_entropy_func, &(tlsDataParams->entropy),
 									(const unsigned char *) pers, strlen(pers))) != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ctr_drbg_seed returned -0x%x\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
 	}
 
 	IOT_DEBUG("  . Loading the CA root certificate ...");
-	ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->cacert), pNetwork->tlsConnectParams.pRootCALocation);
+	ret = _iot_tls_parse_crt(&(tlsDataParams->cacert), pNetwork->tlsConnectParams.pRootCALocation,
+							 pNetwork->tlsConnectParams.rootCALen);
 	if(ret < 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_x509_crt_parse returned -0x%x while parsing root cert\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_X509_ROOT_CRT_PARSE_ERROR;
 	}
 	IOT_DEBUG(" ok (%d skipped)\n", ret);
 
 	IOT_DEBUG("  . Loading the client cert. and key...");
-	ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->clicert), pNetwork->tlsConnectParams.pDeviceCertLocation);
+	ret = _iot_tls_parse_crt(&(tlsDataParams->clicert), pNetwork->tlsConnectParams.pDeviceCertLocation,
+							 pNetwork->tlsConnectParams.deviceCertLen);
 	if(ret != 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_x509_crt_parse returned -0x%x while parsing device cert\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_X509_DEVICE_CRT_PARSE_ERROR;
 	}
 
-	ret = mbedtls_pk_parse_keyfile(&(tlsDataParams->pkey), pNetwork->tlsConnectParams.pDevicePrivateKeyLocation, "");
+	ret = _iot_tls_parse_key(&(tlsDataParams->pkey), pNetwork->tlsConnectParams.pDevicePrivateKeyLocation,
+							 pNetwork->tlsConnectParams.devicePrivateKeyLen);
 	if(ret != 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_pk_parse_key returned -0x%x while parsing private key\n\n", -ret);
 		IOT_DEBUG(" path : %s ", pNetwork->tlsConnectParams.pDevicePrivateKeyLocation);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_PK_PRIVATE_KEY_PARSE_ERROR;
 	}
 	IOT_DEBUG(" ok\n");
-	snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
-	IOT_DEBUG("  . Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
-	if((ret = mbedtls_net_connect(&(tlsDataParams->server_fd), pNetwork->tlsConnectParams.pDestinationURL,
-								  portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
+
+	if((ret = mbedtls_ssl_config_defaults(&(tlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+										  MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+		IOT_ERROR(" failed\n  ! mbedtls_ssl_config_defaults returned -0x%x\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
+		return SSL_CONNECTION_ERROR;
+	}
+
+	mbedtls_ssl_conf_verify(&(tlsDataParams->conf), _iot_tls_verify_cert, NULL);
+	mbedtls_ssl_conf_rng(&(tlsDataParams->conf), mbedtls_ctr_drbg_random, &(tlsDataParams->ctr_drbg));
+
+	mbedtls_ssl_conf_ca_chain(&(tlsDataParams->conf), &(tlsDataParams->cacert), NULL);
+	if((ret = mbedtls_ssl_conf_own_cert(&(tlsDataParams->conf), &(tlsDataParams->clicert), &(tlsDataParams->pkey))) !=
+	   0) {
+		IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n\n", ret);
+		_iot_tls_free_config(tlsDataParams);
+		return SSL_CONNECTION_ERROR;
+	}
+
+#if !defined(DISABLE_IOT_TLS_SESSION_RESUMPTION) && defined(MBEDTLS_SSL_SESSION_TICKETS)
+	mbedtls_ssl_conf_session_tickets(&(tlsDataParams->conf), MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+	tlsDataParams->isConfigLoaded = true;
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
+	/* Use this to add implementation which can check for physical layer disconnect */
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
+	int ret = 0;
+	TLSDataParams *tlsDataParams = NULL;
+	char portBuffer[6];
+	char vrfy_buf[512];
+	size_t inLen, outLen;
+	Timer connectStopwatch;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+	TLSEndpoint endpoint;
+	TLSConnectParams singleEndpoint;
+	Timer handshakeTimer;
+#endif
+
+#ifdef ENABLE_IOT_DEBUG
+	unsigned char buf[MBEDTLS_DEBUG_BUFFER_SIZE];
+#endif
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	tlsDataParams = &(pNetwork->tlsDataParams);
+
+	if(NULL != params) {
+		if(tlsDataParams->isConfigLoaded
+		   && (params->pRootCALocation != pNetwork->tlsConnectParams.pRootCALocation
+			   || params->pDeviceCertLocation != pNetwork->tlsConnectParams.pDeviceCertLocation
+			   || params->pDevicePrivateKeyLocation != pNetwork->tlsConnectParams.pDevicePrivateKeyLocation
+			   || params->rootCALen != pNetwork->tlsConnectParams.rootCALen
+			   || params->deviceCertLen != pNetwork->tlsConnectParams.deviceCertLen
+			   || params->devicePrivateKeyLen != pNetwork->tlsConnectParams.devicePrivateKeyLen)) {
+			/* New credentials, parse them again and do not resume a session made with the old ones */
+			_iot_tls_free_config(tlsDataParams);
+			_iot_tls_forget_session(tlsDataParams);
+		}
+		if(params->tlsProfile != pNetwork->tlsConnectParams.tlsProfile) {
+			/* The saved session may use a suite the new profile does not offer */
+			_iot_tls_forget_session(tlsDataParams);
+		}
+		_iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
+									params->pDevicePrivateKeyLocation, params->pDestinationURL,
+									params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+		pNetwork->tlsConnectParams.rootCALen = params->rootCALen;
+		pNetwork->tlsConnectParams.deviceCertLen = params->deviceCertLen;
+		pNetwork->tlsConnectParams.devicePrivateKeyLen = params->devicePrivateKeyLen;
+		pNetwork->tlsConnectParams.tlsProfile = params->tlsProfile;
+	}
+
+	if(!tlsDataParams->isConfigLoaded) {
+		ret = _iot_tls_load_config(pNetwork);
+		if(SUCCESS != ret) {
+			return (IoT_Error_t) ret;
+		}
+	}
+
+	mbedtls_net_init(&(tlsDataParams->server_fd));
+	mbedtls_ssl_init(&(tlsDataParams->ssl));
+
+	init_timer(&connectStopwatch);
+	countdown_ms(&connectStopwatch, 0);
+	if(0 < pNetwork->tlsConnectParams.endpointCount) {
+		ret = _iot_tls_race_endpoints(&(pNetwork->tlsConnectParams), &(tlsDataParams->server_fd));
+	} else {
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+		/* A race of one, so the TCP connect waits in select for no longer than timeout_ms */
+		endpoint.pDestinationURL = pNetwork->tlsConnectParams.pDestinationURL;
+		endpoint.DestinationPort = pNetwork->tlsConnectParams.DestinationPort;
+		endpoint.lastConnectMs = 0;
+		singleEndpoint = pNetwork->tlsConnectParams;
+		singleEndpoint.pEndpoints = &endpoint;
+		singleEndpoint.endpointCount = 1;
+		singleEndpoint.preferredEndpoint = 0;
+		ret = _iot_tls_race_endpoints(&singleEndpoint, &(tlsDataParams->server_fd));
+#else
+		snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
+		IOT_DEBUG("  . Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
+		ret = mbedtls_net_connect(&(tlsDataParams->server_fd), pNetwork->tlsConnectParams.pDestinationURL,
+								  portBuffer, MBEDTLS_NET_PROTO_TCP);
+#endif
+	}
+	if(ret != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_net_connect returned -0x%x\n\n", -ret);
 		switch(ret) {
 			case MBEDTLS_ERR_NET_SOCKET_FAILED:
@@ -175,35 +887,56 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 		};
 	}
 
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+	ret = mbedtls_net_set_nonblock(&(tlsDataParams->server_fd));
+#else
 	ret = mbedtls_net_set_block(&(tlsDataParams->server_fd));
+#endif
 	if(ret != 0) {
 		IOT_ERROR(" failed\n  ! net_set_(non)block() returned -0x%x\n\n", -ret);
 		return SSL_CONNECTION_ERROR;
 	} IOT_DEBUG(" ok\n");
 
+	/* The config is shared by every connect, set what depends on this one */
 	IOT_DEBUG("  . Setting up the SSL/TLS structure...");
-	if((ret = mbedtls_ssl_config_defaults(&(tlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-										  MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
-		IOT_ERROR(" failed\n  ! mbedtls_ssl_config_defaults returned -0x%x\n\n", -ret);
-		return SSL_CONNECTION_ERROR;
-	}
-
-	mbedtls_ssl_conf_verify(&(tlsDataParams->conf), _iot_tls_verify_cert, NULL);
 	if(pNetwork->tlsConnectParams.ServerVerificationFlag == true) {
 		mbedtls_ssl_conf_authmode(&(tlsDataParams->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
 	} else {
 		mbedtls_ssl_conf_authmode(&(tlsDataParams->conf), MBEDTLS_SSL_VERIFY_OPTIONAL);
 	}
-	mbedtls_ssl_conf_rng(&(tlsDataParams->conf), mbedtls_ctr_drbg_random, &(tlsDataParams->ctr_drbg));
 
-	mbedtls_ssl_conf_ca_chain(&(tlsDataParams->conf), &(tlsDataParams->cacert), NULL);
-	if((ret = mbedtls_ssl_conf_own_cert(&(tlsDataParams->conf), &(tlsDataParams->clicert), &(tlsDataParams->pkey))) !=
-	   0) {
-		IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n\n", ret);
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
+	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+#endif
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+	/* The lean profile asks for short records, a server may ignore it and keep sending full ones */
+	if((ret = mbedtls_ssl_conf_max_frag_len(&(tlsDataParams->conf),
+											(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_LEAN) ?
+											IOT_TLS_MFL_CODE : MBEDTLS_SSL_MAX_FRAG_LEN_NONE)) != 0) {
+		IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_max_frag_len returned -0x%x\n\n", -ret);
 		return SSL_CONNECTION_ERROR;
 	}
+#else
+	if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_LEAN) {
+		IOT_WARN("Lean TLS profile needs MBEDTLS_SSL_MAX_FRAGMENT_LENGTH, using full records\n");
+	}
+#endif
 
-	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+#ifdef IOT_TLS_FAST_HANDSHAKE_SUPPORTED
+	/* Suites and curves of the last connect stay in the shared config, put the defaults back without the profile */
+	if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_FAST_HANDSHAKE) {
+		mbedtls_ssl_conf_ciphersuites(&(tlsDataParams->conf), fastHandshakeCiphersuites);
+		mbedtls_ssl_conf_curves(&(tlsDataParams->conf), fastHandshakeCurves);
+	} else {
+		mbedtls_ssl_conf_ciphersuites(&(tlsDataParams->conf), mbedtls_ssl_list_ciphersuites());
+		mbedtls_ssl_conf_curves(&(tlsDataParams->conf), mbedtls_ecp_grp_id_list());
+	}
+#else
+	if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_FAST_HANDSHAKE) {
+		IOT_WARN("Fast handshake TLS profile needs ECDHE with AES-GCM or ChaCha20-Poly1305 and X25519 or P-256, using the defaults\n");
+	}
+#endif
 
 	/* Use the AWS IoT ALPN extension for MQTT if port 443 is requested. */
 	if(443 == pNetwork->tlsConnectParams.DestinationPort) {
@@ -211,6 +944,9 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 			IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_alpn_protocols returned -0x%x\n\n", -ret);
 			return SSL_CONNECTION_ERROR;
 		}
+	} else {
+		/* Left over from a connect to another endpoint of the list */
+		tlsDataParams->conf.alpn_list = NULL;
 	}
 
 	/* Assign the resulting configuration to the SSL context. */
@@ -222,14 +958,33 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 		IOT_ERROR(" failed\n  ! mbedtls_ssl_set_hostname returned %d\n\n", ret);
 		return SSL_CONNECTION_ERROR;
 	}
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+	_iot_tls_offer_session(pNetwork);
+#endif
 	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+	/* mbedtls never waits itself, every WANT_READ and WANT_WRITE is waited out in poll against a timer */
+	mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, mbedtls_net_recv,
+						NULL);
+	init_timer(&handshakeTimer);
+	countdown_ms(&handshakeTimer, pNetwork->tlsConnectParams.timeout_ms);
+#else
 	mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, NULL,
 						mbedtls_net_recv_timeout);
+#endif
 	IOT_DEBUG(" ok\n");
 
 	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
 	IOT_DEBUG("  . Performing the SSL/TLS handshake...");
 	while((ret = mbedtls_ssl_handshake(&(tlsDataParams->ssl))) != 0) {
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+		if(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+			ret = _iot_tls_wait(tlsDataParams, ret, &handshakeTimer);
+			if(0 == ret) {
+				continue;
+			}
+		}
+#endif
 		if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
 			IOT_ERROR(" failed\n  ! mbedtls_ssl_handshake returned -0x%x\n", -ret);
 			if(ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
@@ -240,7 +995,14 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 							  "    Alternatively, you may want to use "
 							  "auth_mode=optional for testing purposes.\n");
 			}
-			return SSL_CONNECTION_ERROR;
+			/* The server may have refused the offered session, do not offer it again */
+			_iot_tls_forget_session(tlsDataParams);
+			if(0 < pNetwork->tlsConnectParams.endpointCount) {
+				/* Accepts TCP but not TLS, lead with the next endpoint on the next attempt */
+				pNetwork->tlsConnectParams.preferredEndpoint =
+					(pNetwork->tlsConnectParams.preferredEndpoint + 1) % pNetwork->tlsConnectParams.endpointCount;
+			}
+			return (MBEDTLS_ERR_SSL_TIMEOUT == ret) ? NETWORK_SSL_CONNECT_TIMEOUT_ERROR : SSL_CONNECTION_ERROR;
 		}
 	}
 
@@ -251,6 +1013,8 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	} else {
 		IOT_DEBUG("    [ Record expansion is unknown (compression) ]\n");
 	}
+	iot_tls_get_record_buffer_len(pNetwork, &inLen, &outLen);
+	IOT_DEBUG("    [ Record buffers are %u bytes in, %u bytes out ]\n", (unsigned) inLen, (unsigned) outLen);
 
 	IOT_DEBUG("  . Verifying peer X.509 certificate...");
 
@@ -277,44 +1041,60 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	}
 #endif
 
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
 	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), IOT_SSL_READ_TIMEOUT);
+#endif
 
-#ifdef IOT_SSL_SOCKET_NON_BLOCKING
-	mbedtls_net_set_nonblock(&(tlsDataParams->server_fd));
+	if(SUCCESS == ret && 0 < pNetwork->tlsConnectParams.endpointCount) {
+		pNetwork->tlsConnectParams.pEndpoints[pNetwork->tlsConnectParams.preferredEndpoint].lastConnectMs =
+			elapsed_ms(&connectStopwatch);
+	}
+
+	if(SUCCESS != ret) {
+		_iot_tls_forget_session(tlsDataParams);
+	}
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+	else {
+		_iot_tls_save_session(pNetwork);
+		IOT_DEBUG("  . Connected in %u ms with a %s handshake\n",
+				  (unsigned) elapsed_ms(&connectStopwatch),
+				  tlsDataParams->isSessionResumed ? "resumed" : "full");
+	}
 #endif
 
 	return (IoT_Error_t) ret;
 }
 
 IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
-	size_t written_so_far;
+	size_t written_so_far = 0;
 	bool isErrorFlag = false;
-	int frags;
 	int ret = 0;
 	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
-	for(written_so_far = 0, frags = 0;
-		written_so_far < len && !has_timer_expired(timer); written_so_far += ret, frags++) {
-		while(!has_timer_expired(timer) &&
-			  (ret = mbedtls_ssl_write(&(tlsDataParams->ssl), pMsg + written_so_far, len - written_so_far)) <= 0) {
-			if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
-				IOT_ERROR(" failed\n  ! mbedtls_ssl_write returned -0x%x\n\n", -ret);
-				/* All other negative return values indicate connection needs to be reset.
-		 		* Will be caught in ping request so ignored here */
-				isErrorFlag = true;
-				break;
-			}
+	/* Only bytes mbedtls took count as written, a WANT_WRITE at the deadline leaves them at what got through */
+	while(!isErrorFlag && written_so_far < len && !has_timer_expired(timer)) {
+		ret = mbedtls_ssl_write(&(tlsDataParams->ssl), pMsg + written_so_far, len - written_so_far);
+		if(ret > 0) {
+			written_so_far += ret;
+		} else if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+			IOT_ERROR(" failed\n  ! mbedtls_ssl_write returned -0x%x\n\n", -ret);
+			/* All other negative return values indicate connection needs to be reset.
+	 		* Will be caught in ping request so ignored here */
+			isErrorFlag = true;
 		}
-		if(isErrorFlag) {
-			break;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+		else if(MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(tlsDataParams, ret, timer)) {
+			IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+			isErrorFlag = true;
 		}
+#endif
 	}
 
 	*written_len = written_so_far;
 
 	if(isErrorFlag) {
 		return NETWORK_SSL_WRITE_ERROR;
-	} else if(has_timer_expired(timer) && written_so_far != len) {
+	} else if(written_so_far != len) {
 		return NETWORK_SSL_WRITE_TIMEOUT_ERROR;
 	}
 
@@ -327,7 +1107,7 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 	int ret;
 
 	while (len > 0) {
-		// This read will timeout after IOT_SSL_READ_TIMEOUT if there's no data to be read
+		// Blocking, this read will timeout after IOT_SSL_READ_TIMEOUT if there's no data to be read
 		ret = mbedtls_ssl_read(ssl, pMsg, len);
 		if (ret > 0) {
 			rxLen += ret;
@@ -336,6 +1116,12 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 		} else if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT)) {
 			return NETWORK_SSL_READ_ERROR;
 		}
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+		else if (MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(&(pNetwork->tlsDataParams), ret, timer)) {
+			IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+			return NETWORK_SSL_READ_ERROR;
+		}
+#endif
 
 		// Evaluate timeout after the read to make sure read is done at least once
 		if (has_timer_expired(timer)) {
@@ -355,11 +1141,122 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 	}
 }
 
+IoT_Error_t iot_tls_read_available(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	mbedtls_ssl_context *ssl = &(tlsDataParams->ssl);
+	size_t rxLen = 0;
+	int ret;
+
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+	// Only wait before the first read, and for no longer than the timer has left
+	if (mbedtls_ssl_get_bytes_avail(ssl) == 0 &&
+		MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(tlsDataParams, MBEDTLS_ERR_SSL_WANT_READ, timer)) {
+		IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+		*read_len = 0;
+		return NETWORK_SSL_READ_ERROR;
+	}
+#else
+	IOT_UNUSED(timer);
+#endif
+
+	do {
+		// Blocking, only the first read may block, for at most IOT_SSL_READ_TIMEOUT
+		ret = mbedtls_ssl_read(ssl, pMsg + rxLen, len - rxLen);
+		if (ret > 0) {
+			rxLen += ret;
+		} else if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT)) {
+			*read_len = rxLen;
+			return NETWORK_SSL_READ_ERROR;
+		} else {
+			break;
+		}
+		// Keep going while decrypted data or further records are already waiting
+	} while (rxLen < len && (mbedtls_ssl_get_bytes_avail(ssl) > 0 ||
+			 mbedtls_net_poll(&(tlsDataParams->server_fd), MBEDTLS_NET_POLL_READ, 0) > 0));
+
+	*read_len = rxLen;
+	return (rxLen > 0) ? SUCCESS : NETWORK_SSL_NOTHING_TO_READ;
+}
+
+IoT_Error_t iot_tls_wait_for_readable(Network *pNetwork, Timer *timer) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	struct pollfd pfd[2];
+	unsigned char drain[16];
+	int ret;
+
+	// Decrypted data never shows up on the socket again
+	if (mbedtls_ssl_get_bytes_avail(&(tlsDataParams->ssl)) > 0) {
+		return SUCCESS;
+	}
+
+	// A negative fd is ignored by poll, which then just sleeps for the timeout
+	pfd[0].fd = tlsDataParams->server_fd.fd;
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+	pfd[1].fd = tlsDataParams->wakeFd[0];
+	pfd[1].events = POLLIN;
+	pfd[1].revents = 0;
+
+	ret = poll(pfd, 2, (int) left_ms(timer));
+	if (ret > 0 && 0 != (pfd[1].revents & POLLIN)) {
+		// Every wake-up so far is answered by this one
+		while (read(pfd[1].fd, drain, sizeof(drain)) > 0) {
+		}
+	}
+	if (ret > 0 && 0 != pfd[0].revents) {
+		return SUCCESS;
+	} else if (ret >= 0 || errno == EINTR) {
+		return NETWORK_SSL_NOTHING_TO_READ;
+	}
+
+	IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+	return NETWORK_SSL_READ_ERROR;
+}
+
+IoT_Error_t iot_tls_wake_up(Network *pNetwork) {
+	const unsigned char wake = 0;
+
+	if (0 > pNetwork->tlsDataParams.wakeFd[1]) {
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+	// EAGAIN means the pipe is full of wake-ups nobody read yet, one more adds nothing
+	if (0 > write(pNetwork->tlsDataParams.wakeFd[1], &wake, 1) && EAGAIN != errno) {
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+int iot_tls_get_fd(Network *pNetwork) {
+	return pNetwork->tlsDataParams.server_fd.fd;
+}
+
+int iot_tls_get_wake_fd(Network *pNetwork) {
+	return pNetwork->tlsDataParams.wakeFd[0];
+}
+
+bool iot_tls_has_pending_data(Network *pNetwork) {
+	// Zero for the plain TCP transport too, its TLS state stays empty
+	return mbedtls_ssl_get_bytes_avail(&(pNetwork->tlsDataParams.ssl)) > 0;
+}
+
 IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
 	mbedtls_ssl_context *ssl = &(pNetwork->tlsDataParams.ssl);
 	int ret = 0;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+	Timer timer;
+
+	init_timer(&timer);
+	countdown_ms(&timer, IOT_SSL_CLOSE_NOTIFY_TIMEOUT);
+#endif
 	do {
 		ret = mbedtls_ssl_close_notify(ssl);
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+		/* A full send buffer must not hold up the disconnect for longer than IOT_SSL_CLOSE_NOTIFY_TIMEOUT */
+		if(ret == MBEDTLS_ERR_SSL_WANT_WRITE && 0 != _iot_tls_wait(&(pNetwork->tlsDataParams), ret, &timer)) {
+			break;
+		}
+#endif
 	} while(ret == MBEDTLS_ERR_SSL_WANT_WRITE);
 
 	/* All other negative return values indicate connection needs to be reset.
@@ -372,14 +1269,59 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork) {
 	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
 	mbedtls_net_free(&(tlsDataParams->server_fd));
-
-	mbedtls_x509_crt_free(&(tlsDataParams->clicert));
-	mbedtls_x509_crt_free(&(tlsDataParams->cacert));
-	mbedtls_pk_free(&(tlsDataParams->pkey));
 	mbedtls_ssl_free(&(tlsDataParams->ssl));
-	mbedtls_ssl_config_free(&(tlsDataParams->conf));
-	mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
-	mbedtls_entropy_free(&(tlsDataParams->entropy));
+
+	/* The credentials, the config and the saved session outlive the connection, the next connect reuses them */
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_free(Network *pNetwork) {
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	if(pNetwork->tlsDataParams.isConfigLoaded) {
+		_iot_tls_free_config(&(pNetwork->tlsDataParams));
+	}
+	_iot_tls_forget_session(&(pNetwork->tlsDataParams));
+	if(0 <= pNetwork->tlsDataParams.wakeFd[0]) {
+		close(pNetwork->tlsDataParams.wakeFd[0]);
+		close(pNetwork->tlsDataParams.wakeFd[1]);
+		pNetwork->tlsDataParams.wakeFd[0] = -1;
+		pNetwork->tlsDataParams.wakeFd[1] = -1;
+	}
+	pNetwork->wakeUp = NULL;
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_get_record_buffer_len(Network *pNetwork, size_t *pInLen, size_t *pOutLen) {
+	mbedtls_ssl_context *ssl;
+
+	if(NULL == pNetwork || NULL == pInLen || NULL == pOutLen) {
+		return NULL_VALUE_ERROR;
+	}
+
+	/* Freed and zeroed by destroy */
+	ssl = &(pNetwork->tlsDataParams.ssl);
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+	*pInLen = (NULL != ssl->in_buf) ? ssl->in_buf_len : 0;
+	*pOutLen = (NULL != ssl->out_buf) ? ssl->out_buf_len : 0;
+#else
+	*pInLen = (NULL != ssl->in_buf) ? MBEDTLS_SSL_IN_BUFFER_LEN : 0;
+	*pOutLen = (NULL != ssl->out_buf) ? MBEDTLS_SSL_OUT_BUFFER_LEN : 0;
+#endif
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_forget_session(Network *pNetwork) {
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	_iot_tls_forget_session(&(pNetwork->tlsDataParams));
 
 	return SUCCESS;
 }
@@ -0,0 +1,428 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * Plain TCP transport, selected with IOT_NETWORK_TRANSPORT_TCP. The socket is
+ * kept in tlsDataParams.server_fd like the one of the TLS transport, so the
+ * epoll reactor drives clients of either transport.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "aws_iot_config.h"
+
+#include <timer_platform.h>
+
+#include "aws_iot_error.h"
+#include "aws_iot_log.h"
+#include "network_interface.h"
+#include "network_platform.h"
+
+/*
+ * Sleep in poll until the socket is ready for events or the timer expires.
+ *
+ * Returns > 0 once ready, 0 on timeout or a signal, < 0 if poll failed.
+ */
+static int _iot_tcp_wait(int fd, short events, Timer *timer) {
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+
+	ret = poll(&pfd, 1, (int) left_ms(timer));
+	if(ret < 0 && EINTR == errno) {
+		return 0;
+	}
+	return ret;
+}
+
+static bool _iot_tcp_would_block(void) {
+	return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+}
+
+static void _iot_tcp_set_option(int fd, int level, int name, int value, const char *pName) {
+	IOT_UNUSED(pName);
+	if(setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+		IOT_WARN("  ! setsockopt %s returned errno %d\n", pName, errno);
+	}
+}
+
+/*
+ * Apply the socket options before connecting, so the buffer sizes count for
+ * the window scale the SYN announces.
+ */
+static void _iot_tcp_set_options(int fd, const IoT_TCP_Options *pOptions) {
+	if(pOptions->isNoDelay) {
+		_iot_tcp_set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+	}
+	if(0 < pOptions->sendBufLen) {
+		_iot_tcp_set_option(fd, SOL_SOCKET, SO_SNDBUF, pOptions->sendBufLen, "SO_SNDBUF");
+	}
+	if(0 < pOptions->recvBufLen) {
+		_iot_tcp_set_option(fd, SOL_SOCKET, SO_RCVBUF, pOptions->recvBufLen, "SO_RCVBUF");
+	}
+	if(!pOptions->isKeepAlive) {
+		return;
+	}
+	_iot_tcp_set_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+	if(0 < pOptions->keepAliveIdle_s) {
+		_iot_tcp_set_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, pOptions->keepAliveIdle_s, "TCP_KEEPIDLE");
+	}
+#endif
+#ifdef TCP_KEEPINTVL
+	if(0 < pOptions->keepAliveInterval_s) {
+		_iot_tcp_set_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, pOptions->keepAliveInterval_s, "TCP_KEEPINTVL");
+	}
+#endif
+#ifdef TCP_KEEPCNT
+	if(0 < pOptions->keepAliveCount) {
+		_iot_tcp_set_option(fd, IPPROTO_TCP, TCP_KEEPCNT, pOptions->keepAliveCount, "TCP_KEEPCNT");
+	}
+#endif
+}
+
+/*
+ * Connect a non-blocking socket to one endpoint, trying its addresses in turn
+ * until one accepts or the timer expires.
+ */
+static IoT_Error_t _iot_tcp_connect_endpoint(Network *pNetwork, const char *pHost, uint16_t port, Timer *timer) {
+	struct addrinfo hints;
+	struct addrinfo *pAddrList = NULL;
+	struct addrinfo *pAddr;
+	char portBuffer[6];
+	int fd, soError;
+	socklen_t soErrorLen;
+	IoT_Error_t rc = NETWORK_ERR_NET_SOCKET_FAILED;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	snprintf(portBuffer, sizeof(portBuffer), "%d", port);
+	if(getaddrinfo(pHost, portBuffer, &hints, &pAddrList) != 0 || NULL == pAddrList) {
+		IOT_WARN("Endpoint %s unknown\n", pHost);
+		return NETWORK_ERR_NET_UNKNOWN_HOST;
+	}
+
+	IOT_DEBUG("  . Connecting to %s/%s...\n", pHost, portBuffer);
+	for(pAddr = pAddrList; NULL != pAddr && !has_timer_expired(timer); pAddr = pAddr->ai_next) {
+		fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+		if(fd < 0) {
+			continue;
+		}
+		rc = NETWORK_ERR_NET_CONNECT_FAILED;
+		if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+			close(fd);
+			continue;
+		}
+		_iot_tcp_set_options(fd, &(pNetwork->tcpOptions));
+
+		if(connect(fd, pAddr->ai_addr, pAddr->ai_addrlen) != 0) {
+			soError = errno;
+			if(EINPROGRESS == soError && _iot_tcp_wait(fd, POLLOUT, timer) > 0) {
+				soErrorLen = sizeof(soError);
+				if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &soError, &soErrorLen) != 0) {
+					soError = errno;
+				}
+			}
+			if(0 != soError) {
+				close(fd);
+				continue;
+			}
+		}
+
+		pNetwork->tlsDataParams.server_fd.fd = fd;
+		rc = SUCCESS;
+		break;
+	}
+	freeaddrinfo(pAddrList);
+
+	return rc;
+}
+
+static IoT_Error_t iot_tcp_connect(Network *pNetwork, TLSConnectParams *params) {
+	TLSConnectParams *pParams;
+	TLSEndpoint *pEndpoint;
+	Timer connectTimer, endpointTimer, connectStopwatch;
+	uint8_t order[UINT8_MAX];
+	uint8_t i;
+	IoT_Error_t rc = NETWORK_ERR_NET_CONNECT_FAILED;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pParams = &(pNetwork->tlsConnectParams);
+	if(NULL != params) {
+		pParams->pDestinationURL = params->pDestinationURL;
+		pParams->DestinationPort = params->DestinationPort;
+		pParams->timeout_ms = params->timeout_ms;
+	}
+
+	/* A connect without a disconnect before it must not leak the old socket */
+	if(0 <= pNetwork->tlsDataParams.server_fd.fd) {
+		close(pNetwork->tlsDataParams.server_fd.fd);
+	}
+	pNetwork->tlsDataParams.server_fd.fd = -1;
+	init_timer(&connectTimer);
+	countdown_ms(&connectTimer, pParams->timeout_ms);
+	init_timer(&connectStopwatch);
+	countdown_ms(&connectStopwatch, 0);
+
+	if(0 == pParams->endpointCount) {
+		rc = _iot_tcp_connect_endpoint(pNetwork, pParams->pDestinationURL, pParams->DestinationPort, &connectTimer);
+	} else {
+		if(pParams->preferredEndpoint >= pParams->endpointCount) {
+			pParams->preferredEndpoint = 0;
+		}
+		/* One after the other in the order of a TLS race, each but the last gets endpointRaceDelay_ms */
+		iot_tls_order_endpoints(pParams, pParams->endpointCount, order);
+		for(i = 0; i < pParams->endpointCount && SUCCESS != rc && !has_timer_expired(&connectTimer); i++) {
+			pEndpoint = &(pParams->pEndpoints[order[i]]);
+			init_timer(&endpointTimer);
+			if(i + 1 < pParams->endpointCount && 0 < pParams->endpointRaceDelay_ms &&
+			   pParams->endpointRaceDelay_ms < left_ms(&connectTimer)) {
+				countdown_ms(&endpointTimer, pParams->endpointRaceDelay_ms);
+			} else {
+				countdown_ms(&endpointTimer, left_ms(&connectTimer));
+			}
+			rc = _iot_tcp_connect_endpoint(pNetwork, pEndpoint->pDestinationURL, pEndpoint->DestinationPort,
+										   &endpointTimer);
+			if(SUCCESS == rc) {
+				pParams->preferredEndpoint = order[i];
+				pParams->pDestinationURL = pEndpoint->pDestinationURL;
+				pParams->DestinationPort = pEndpoint->DestinationPort;
+				pEndpoint->lastConnectMs = elapsed_ms(&connectStopwatch);
+			}
+		}
+	}
+
+	if(SUCCESS != rc) {
+		IOT_ERROR(" failed\n  ! TCP connect returned %d\n\n", rc);
+		return rc;
+	}
+
+	IOT_DEBUG("  . Connected in %u ms\n", (unsigned) elapsed_ms(&connectStopwatch));
+	return SUCCESS;
+}
+
+static IoT_Error_t iot_tcp_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								 size_t *written_len) {
+	int fd = pNetwork->tlsDataParams.server_fd.fd;
+	size_t written_so_far = 0;
+	ssize_t ret;
+
+	while(written_so_far < len) {
+		ret = send(fd, pMsg + written_so_far, len - written_so_far, MSG_NOSIGNAL);
+		if(ret > 0) {
+			written_so_far += (size_t) ret;
+			continue;
+		}
+		if(ret < 0 && _iot_tcp_would_block()) {
+			if(has_timer_expired(timer)) {
+				break;
+			}
+			if(_iot_tcp_wait(fd, POLLOUT, timer) >= 0) {
+				continue;
+			}
+		}
+		IOT_ERROR(" failed\n  ! send returned errno %d\n\n", errno);
+		*written_len = written_so_far;
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+
+	*written_len = written_so_far;
+	return (written_so_far == len) ? SUCCESS : NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t iot_tcp_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+	int fd = pNetwork->tlsDataParams.server_fd.fd;
+	size_t rxLen = 0;
+	ssize_t ret;
+
+	while(rxLen < len) {
+		ret = recv(fd, pMsg + rxLen, len - rxLen, 0);
+		if(ret > 0) {
+			rxLen += (size_t) ret;
+			continue;
+		}
+		if(0 == ret || !_iot_tcp_would_block()) {
+			*read_len = rxLen;
+			return NETWORK_SSL_READ_ERROR;
+		}
+		// Evaluate timeout after the read to make sure read is done at least once
+		if(has_timer_expired(timer)) {
+			break;
+		}
+		if(_iot_tcp_wait(fd, POLLIN, timer) < 0) {
+			IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+			*read_len = rxLen;
+			return NETWORK_SSL_READ_ERROR;
+		}
+	}
+
+	*read_len = rxLen;
+	if(rxLen == len) {
+		return SUCCESS;
+	}
+	return (0 == rxLen) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t iot_tcp_read_available(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+										  size_t *read_len) {
+	int fd = pNetwork->tlsDataParams.server_fd.fd;
+	ssize_t ret;
+
+	*read_len = 0;
+	if(_iot_tcp_wait(fd, POLLIN, timer) < 0) {
+		IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	// Without TLS records in the way one recv takes all that has arrived
+	ret = recv(fd, pMsg, len, 0);
+	if(ret > 0) {
+		*read_len = (size_t) ret;
+		return SUCCESS;
+	}
+	if(0 == ret || !_iot_tcp_would_block()) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+	return NETWORK_SSL_NOTHING_TO_READ;
+}
+
+static IoT_Error_t iot_tcp_wait_for_readable(Network *pNetwork, Timer *timer) {
+	struct pollfd pfd[2];
+	unsigned char drain[16];
+	int ret;
+
+	// A negative fd is ignored by poll, which then just sleeps for the timeout
+	pfd[0].fd = pNetwork->tlsDataParams.server_fd.fd;
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+	// The pipe of iot_tls_wake_up, opened by iot_tcp_init
+	pfd[1].fd = pNetwork->tlsDataParams.wakeFd[0];
+	pfd[1].events = POLLIN;
+	pfd[1].revents = 0;
+
+	ret = poll(pfd, 2, (int) left_ms(timer));
+	if(ret > 0 && 0 != (pfd[1].revents & POLLIN)) {
+		while(read(pfd[1].fd, drain, sizeof(drain)) > 0) {
+		}
+	}
+	if(ret > 0 && 0 != pfd[0].revents) {
+		return SUCCESS;
+	} else if(ret >= 0 || EINTR == errno) {
+		return NETWORK_SSL_NOTHING_TO_READ;
+	}
+
+	IOT_ERROR(" failed\n  ! poll returned errno %d\n\n", errno);
+	return NETWORK_SSL_READ_ERROR;
+}
+
+static IoT_Error_t iot_tcp_disconnect(Network *pNetwork) {
+	/* Send the FIN, destroy closes the socket */
+	if(0 <= pNetwork->tlsDataParams.server_fd.fd) {
+		(void) shutdown(pNetwork->tlsDataParams.server_fd.fd, SHUT_WR);
+	}
+
+	return SUCCESS;
+}
+
+static IoT_Error_t iot_tcp_is_connected(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static IoT_Error_t iot_tcp_destroy(Network *pNetwork) {
+	if(0 <= pNetwork->tlsDataParams.server_fd.fd) {
+		close(pNetwork->tlsDataParams.server_fd.fd);
+		pNetwork->tlsDataParams.server_fd.fd = -1;
+	}
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tcp_init(Network *pNetwork, const char *pDestinationURL, uint16_t DestinationPort,
+						 uint32_t timeout_ms, const IoT_TCP_Options *pOptions) {
+	const IoT_TCP_Options defaultOptions = IoT_TCP_Options_initializer;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pNetwork->tlsConnectParams.pRootCALocation = NULL;
+	pNetwork->tlsConnectParams.pDeviceCertLocation = NULL;
+	pNetwork->tlsConnectParams.pDevicePrivateKeyLocation = NULL;
+	pNetwork->tlsConnectParams.pDestinationURL = pDestinationURL;
+	pNetwork->tlsConnectParams.DestinationPort = DestinationPort;
+	pNetwork->tlsConnectParams.timeout_ms = timeout_ms;
+	pNetwork->tlsConnectParams.ServerVerificationFlag = false;
+	pNetwork->tlsConnectParams.pEndpoints = NULL;
+	pNetwork->tlsConnectParams.endpointCount = 0;
+	pNetwork->tlsConnectParams.preferredEndpoint = 0;
+	pNetwork->tlsConnectParams.endpointRaceDelay_ms = 0;
+	pNetwork->tlsConnectParams.rootCALen = 0;
+	pNetwork->tlsConnectParams.deviceCertLen = 0;
+	pNetwork->tlsConnectParams.devicePrivateKeyLen = 0;
+	pNetwork->tlsConnectParams.tlsProfile = IOT_TLS_PROFILE_DEFAULT;
+	pNetwork->tcpOptions = (NULL != pOptions) ? *pOptions : defaultOptions;
+
+	pNetwork->connect = iot_tcp_connect;
+	pNetwork->read = iot_tcp_read;
+	pNetwork->readAvailable = iot_tcp_read_available;
+	pNetwork->waitForReadable = iot_tcp_wait_for_readable;
+	pNetwork->write = iot_tcp_write;
+	pNetwork->disconnect = iot_tcp_disconnect;
+	pNetwork->isConnected = iot_tcp_is_connected;
+	pNetwork->destroy = iot_tcp_destroy;
+
+	/* Nothing of the TLS state is set up, iot_tls_free only finds the wake-up pipe to release */
+	memset(&(pNetwork->tlsDataParams), 0, sizeof(TLSDataParams));
+	pNetwork->tlsDataParams.server_fd.fd = -1;
+	pNetwork->wakeUp = NULL;
+	if(0 == pipe(pNetwork->tlsDataParams.wakeFd)) {
+		(void) fcntl(pNetwork->tlsDataParams.wakeFd[0], F_SETFL, fcntl(pNetwork->tlsDataParams.wakeFd[0], F_GETFL) | O_NONBLOCK);
+		(void) fcntl(pNetwork->tlsDataParams.wakeFd[1], F_SETFL, fcntl(pNetwork->tlsDataParams.wakeFd[1], F_GETFL) | O_NONBLOCK);
+		pNetwork->wakeUp = iot_tls_wake_up;
+	} else {
+		IOT_WARN("Unable to open the wake-up pipe, errno %d\n", errno);
+		pNetwork->tlsDataParams.wakeFd[0] = -1;
+		pNetwork->tlsDataParams.wakeFd[1] = -1;
+	}
+
+	return SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
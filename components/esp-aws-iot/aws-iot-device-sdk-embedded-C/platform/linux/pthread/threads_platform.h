@@ -23,6 +23,7 @@ extern "C" {
 #endif
 
 #include <pthread.h>
+#include <semaphore.h>
 
 /**
  * @brief Mutex Type
@@ -34,6 +35,16 @@ struct _IoT_Mutex_t {
 	pthread_mutex_t lock;
 };
 
+/**
+ * @brief Semaphore Type
+ *
+ * definition of the Semaphore struct. Platform specific
+ *
+ */
+struct _IoT_Semaphore_t {
+	sem_t sem;
+};
+
 #ifdef __cplusplus
 }
 #endif
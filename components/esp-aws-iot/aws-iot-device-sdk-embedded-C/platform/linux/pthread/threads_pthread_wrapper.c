@@ -16,6 +16,9 @@
 #include "threads_platform.h"
 #ifdef _ENABLE_THREAD_SUPPORT_
 
+#include <errno.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +39,31 @@ IoT_Error_t aws_iot_thread_mutex_init(IoT_Mutex_t *pMutex) {
 	return SUCCESS;
 }
 
+/**
+ * @brief Initialize the provided mutex as recursive
+ *
+ * Call this function to initialize a mutex the thread holding it may lock again
+ *
+ * @param IoT_Mutex_t - pointer to the mutex to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_mutex_init_recursive(IoT_Mutex_t *pMutex) {
+	pthread_mutexattr_t attr;
+	int rc;
+
+	if(0 != pthread_mutexattr_init(&attr)) {
+		return MUTEX_INIT_ERROR;
+	}
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	rc = pthread_mutex_init(&(pMutex->lock), &attr);
+	pthread_mutexattr_destroy(&attr);
+	if(0 != rc) {
+		return MUTEX_INIT_ERROR;
+	}
+
+	return SUCCESS;
+}
+
 /**
  * @brief Lock the provided mutex
  *
@@ -104,6 +132,86 @@ IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *pMutex) {
 	return SUCCESS;
 }
 
+/**
+ * @brief Initialize the provided semaphore
+ *
+ * Call this function to initialize the semaphore in the taken state
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_init(IoT_Semaphore_t *pSem) {
+	if(0 != sem_init(&(pSem->sem), 0, 0)) {
+		return SEMAPHORE_INIT_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Signal the provided semaphore
+ *
+ * Call this function to wake up a thread waiting on the semaphore
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be signalled
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_post(IoT_Semaphore_t *pSem) {
+	if(0 != sem_post(&(pSem->sem))) {
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Wait on the provided semaphore
+ *
+ * Call this function to block until the semaphore is signalled or the timeout expires
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to wait on
+ * @param timeout_ms - maximum time to wait in milliseconds
+ * @return IoT_Error_t - SUCCESS if signalled, SEMAPHORE_WAIT_TIMEOUT_ERROR otherwise
+ */
+IoT_Error_t aws_iot_thread_semaphore_wait(IoT_Semaphore_t *pSem, uint32_t timeout_ms) {
+	struct timespec deadline;
+	int rc;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	do {
+		rc = sem_timedwait(&(pSem->sem), &deadline);
+	} while(0 != rc && EINTR == errno);
+
+	if(0 != rc) {
+		return SEMAPHORE_WAIT_TIMEOUT_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Destroy the provided semaphore
+ *
+ * Call this function to destroy the semaphore
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be destroyed
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_destroy(IoT_Semaphore_t *pSem) {
+	if(0 != sem_destroy(&(pSem->sem))) {
+		return SEMAPHORE_DESTROY_ERROR;
+	}
+
+	return SUCCESS;
+}
+
 #ifdef __cplusplus
 }
 #endif
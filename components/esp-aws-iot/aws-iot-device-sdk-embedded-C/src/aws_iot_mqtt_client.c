@@ -226,6 +226,20 @@ IoT_Error_t aws_iot_mqtt_free(AWS_IoT_Client *pClient)
 			(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
 		}
 	#endif
+	#ifdef ENABLE_IOT_FULL_DUPLEX
+		aws_iot_mqtt_internal_destroy_ack_waiters(pClient);
+	#endif
+	#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		aws_iot_mqtt_internal_publish_queue_disconnected(pClient, true);
+		aws_iot_mqtt_internal_destroy_publish_queue(pClient);
+	#endif
+	#ifndef DISABLE_IOT_STATS
+		aws_iot_mqtt_internal_destroy_stats(pClient);
+	#endif
+	#ifdef ENABLE_IOT_DISPATCH_POOL
+		aws_iot_mqtt_internal_destroy_dispatch(pClient);
+	#endif
+		(void)iot_tls_free(&(pClient->networkStack));
 	}
 
     FUNC_EXIT_RC(rc);
@@ -235,12 +249,41 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 	uint32_t i;
 	IoT_Error_t rc;
 	IoT_Client_Connect_Params default_options = IoT_Client_Connect_Params_initializer;
+	const char *pHostURL;
+	uint16_t port;
 
 	FUNC_ENTRY;
 
-	if(NULL == pClient || NULL == pInitParams || NULL == pInitParams->pHostURL || 0 == pInitParams->port ||
-	   NULL == pInitParams->pRootCALocation || NULL == pInitParams->pDevicePrivateKeyLocation ||
-	   NULL == pInitParams->pDeviceCertLocation) {
+	if(NULL == pClient || NULL == pInitParams) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(IOT_NETWORK_TRANSPORT_TCP == pInitParams->transport) {
+#ifndef ENABLE_IOT_PLAIN_TCP
+		IOT_ERROR("Plain TCP transport requires ENABLE_IOT_PLAIN_TCP");
+		FUNC_EXIT_RC(TCP_SETUP_ERROR);
+#endif
+	} else if(NULL == pInitParams->pRootCALocation || NULL == pInitParams->pDevicePrivateKeyLocation ||
+			  NULL == pInitParams->pDeviceCertLocation) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* With an endpoint list, the first entry stands in until a race picks the winner */
+	pHostURL = pInitParams->pHostURL;
+	port = pInitParams->port;
+	if(0 < pInitParams->endpointCount) {
+		if(NULL == pInitParams->pEndpoints) {
+			FUNC_EXIT_RC(NULL_VALUE_ERROR);
+		}
+		for(i = 0; i < pInitParams->endpointCount; i++) {
+			if(NULL == pInitParams->pEndpoints[i].pDestinationURL || 0 == pInitParams->pEndpoints[i].DestinationPort) {
+				FUNC_EXIT_RC(NULL_VALUE_ERROR);
+			}
+		}
+		pHostURL = pInitParams->pEndpoints[0].pDestinationURL;
+		port = pInitParams->pEndpoints[0].DestinationPort;
+	}
+	if(NULL == pHostURL || 0 == port) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
@@ -255,9 +298,18 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 	pClient->clientData.commandTimeoutMs = pInitParams->mqttCommandTimeout_ms;
 	pClient->clientData.writeBufSize = AWS_IOT_MQTT_TX_BUF_LEN;
 	pClient->clientData.readBufSize = AWS_IOT_MQTT_RX_BUF_LEN;
+	pClient->clientData.rxRingSize = AWS_IOT_MQTT_RX_RING_BUF_LEN;
+	pClient->clientData.rxRingHead = 0;
+	pClient->clientData.rxRingFill = 0;
+	pClient->clientData.rxDiscardLen = 0;
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	pClient->clientData.isWriteCorked = false;
+	pClient->clientData.coalesceLen = 0;
+#endif
 	pClient->clientData.counterNetworkDisconnected = 0;
 	pClient->clientData.disconnectHandler = pInitParams->disconnectHandler;
 	pClient->clientData.disconnectHandlerData = pInitParams->disconnectHandlerData;
+	pClient->clientData.pSessionStore = NULL;
 	pClient->clientData.nextPacketId = 1;
 
 	/* Initialize default connection options */
@@ -272,25 +324,104 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* A subscribe callback may publish and wait for its PUBACK on the reading task */
+	rc = aws_iot_thread_mutex_init_recursive(&(pClient->clientData.tls_read_mutex));
+#else
 	rc = aws_iot_thread_mutex_init(&(pClient->clientData.tls_read_mutex));
+#endif
 	if(SUCCESS != rc) {
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		FUNC_EXIT_RC(rc);
 	}
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* Held from serialization on, send_packet takes it again */
+	rc = aws_iot_thread_mutex_init_recursive(&(pClient->clientData.tls_write_mutex));
+#else
 	rc = aws_iot_thread_mutex_init(&(pClient->clientData.tls_write_mutex));
+#endif
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	rc = aws_iot_mqtt_internal_init_ack_waiters(pClient);
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	rc = aws_iot_mqtt_internal_init_publish_queue(pClient);
+	if(SUCCESS != rc) {
+		#ifdef ENABLE_IOT_FULL_DUPLEX
+		aws_iot_mqtt_internal_destroy_ack_waiters(pClient);
+		#endif
+		#ifdef _ENABLE_THREAD_SUPPORT_
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		#endif
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+#ifndef DISABLE_IOT_STATS
+	rc = aws_iot_mqtt_internal_init_stats(pClient);
 	if(SUCCESS != rc) {
+		#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		aws_iot_mqtt_internal_destroy_publish_queue(pClient);
+		#endif
+		#ifdef ENABLE_IOT_FULL_DUPLEX
+		aws_iot_mqtt_internal_destroy_ack_waiters(pClient);
+		#endif
+		#ifdef _ENABLE_THREAD_SUPPORT_
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		#endif
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	rc = aws_iot_mqtt_internal_init_dispatch(pClient);
+	if(SUCCESS != rc) {
+		#ifndef DISABLE_IOT_STATS
+		aws_iot_mqtt_internal_destroy_stats(pClient);
+		#endif
+		#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		aws_iot_mqtt_internal_destroy_publish_queue(pClient);
+		#endif
+		#ifdef ENABLE_IOT_FULL_DUPLEX
+		aws_iot_mqtt_internal_destroy_ack_waiters(pClient);
+		#endif
+		#ifdef _ENABLE_THREAD_SUPPORT_
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		#endif
 		FUNC_EXIT_RC(rc);
 	}
 #endif
 
 	pClient->clientStatus.isPingOutstanding = 0;
 	pClient->clientStatus.isAutoReconnectEnabled = pInitParams->enableAutoReconnect;
+	pClient->clientStatus.isSessionPresent = false;
 
-	rc = iot_tls_init(&(pClient->networkStack), pInitParams->pRootCALocation, pInitParams->pDeviceCertLocation,
-					  pInitParams->pDevicePrivateKeyLocation, pInitParams->pHostURL, pInitParams->port,
-					  pInitParams->tlsHandshakeTimeout_ms, pInitParams->isSSLHostnameVerify);
+#ifdef ENABLE_IOT_PLAIN_TCP
+	if(IOT_NETWORK_TRANSPORT_TCP == pInitParams->transport) {
+		rc = iot_tcp_init(&(pClient->networkStack), pHostURL, port, pInitParams->tlsHandshakeTimeout_ms,
+						  &(pInitParams->tcpOptions));
+	} else
+#endif
+	{
+		rc = iot_tls_init(&(pClient->networkStack), pInitParams->pRootCALocation, pInitParams->pDeviceCertLocation,
+						  pInitParams->pDevicePrivateKeyLocation, pHostURL, port,
+						  pInitParams->tlsHandshakeTimeout_ms, pInitParams->isSSLHostnameVerify);
+	}
 
 	if(SUCCESS != rc) {
 		#ifdef _ENABLE_THREAD_SUPPORT_
@@ -298,10 +429,31 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
 		#endif
+		#ifdef ENABLE_IOT_FULL_DUPLEX
+		aws_iot_mqtt_internal_destroy_ack_waiters(pClient);
+		#endif
+		#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		aws_iot_mqtt_internal_destroy_publish_queue(pClient);
+		#endif
+		#ifndef DISABLE_IOT_STATS
+		aws_iot_mqtt_internal_destroy_stats(pClient);
+		#endif
+		#ifdef ENABLE_IOT_DISPATCH_POOL
+		aws_iot_mqtt_internal_destroy_dispatch(pClient);
+		#endif
 		pClient->clientStatus.clientState = CLIENT_STATE_INVALID;
 		FUNC_EXIT_RC(rc);
 	}
 
+	pClient->networkStack.tlsConnectParams.pEndpoints = pInitParams->pEndpoints;
+	pClient->networkStack.tlsConnectParams.endpointCount = pInitParams->endpointCount;
+	pClient->networkStack.tlsConnectParams.preferredEndpoint = 0;
+	pClient->networkStack.tlsConnectParams.endpointRaceDelay_ms = pInitParams->endpointRaceDelay_ms;
+	pClient->networkStack.tlsConnectParams.rootCALen = pInitParams->rootCALen;
+	pClient->networkStack.tlsConnectParams.deviceCertLen = pInitParams->deviceCertLen;
+	pClient->networkStack.tlsConnectParams.devicePrivateKeyLen = pInitParams->devicePrivateKeyLen;
+	pClient->networkStack.tlsConnectParams.tlsProfile = pInitParams->tlsProfile;
+
 	init_timer(&(pClient->pingReqTimer));
 	init_timer(&(pClient->pingRespTimer));
 	init_timer(&(pClient->reconnectDelayTimer));
@@ -312,8 +464,19 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 }
 
 uint16_t aws_iot_mqtt_get_next_packet_id(AWS_IoT_Client *pClient) {
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	uint16_t packetId;
+
+	/* Publishers run concurrently in full-duplex mode */
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+	packetId = pClient->clientData.nextPacketId = (uint16_t) ((MAX_PACKET_ID == pClient->clientData.nextPacketId) ? 1 : (
+			pClient->clientData.nextPacketId + 1));
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+	return packetId;
+#else
 	return pClient->clientData.nextPacketId = (uint16_t) ((MAX_PACKET_ID == pClient->clientData.nextPacketId) ? 1 : (
 			pClient->clientData.nextPacketId + 1));
+#endif
 }
 
 bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient) {
@@ -384,6 +547,25 @@ IoT_Error_t aws_iot_mqtt_set_disconnect_handler(AWS_IoT_Client *pClient, iot_dis
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+IoT_Error_t aws_iot_mqtt_set_session_store(AWS_IoT_Client *pClient, const IoT_MQTT_Session_Store *pSessionStore) {
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(NULL != pSessionStore && (NULL == pSessionStore->save || NULL == pSessionStore->remove
+								 || NULL == pSessionStore->load)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pClient->clientData.pSessionStore = pSessionStore;
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+bool aws_iot_mqtt_is_session_present(AWS_IoT_Client *pClient) {
+	return pClient->clientStatus.isSessionPresent;
+}
+
 uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient) {
 	return pClient->clientData.counterNetworkDisconnected;
 }
@@ -296,6 +296,77 @@ IoT_Error_t aws_iot_mqtt_internal_init_header(MQTTHeader *pHeader, MessageTypes
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/**
+ * @brief Write bytes to the network
+ *
+ * Called with the write side of the connection locked.
+ *
+ * @param pClient MQTT client
+ * @param pBuf Bytes to write
+ * @param length Number of bytes to write
+ * @param pTimer Amount of time allowed to write them
+ *
+ * @return IoT_Error_t of the write
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_write(AWS_IoT_Client *pClient, unsigned char *pBuf, size_t length,
+												Timer *pTimer) {
+	size_t sentLen = 0, sent = 0;
+	IoT_Error_t rc = FAILURE;
+
+	while(sent < length && !has_timer_expired(pTimer)) {
+		rc = pClient->networkStack.write(&(pClient->networkStack),
+						 &pBuf[sent],
+						 (length - sent),
+						 pTimer,
+						 &sentLen);
+		if(SUCCESS != rc) {
+			/* there was an error writing the data */
+			break;
+		}
+		sent += sentLen;
+	}
+
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_sent(pClient, sent);
+#endif
+	IOT_TRACE_EVENT(IOT_TRACE_SEND, pClient, (SUCCESS == rc) ? (int32_t) sent : (int32_t) rc);
+
+	if(sent == length) {
+		return SUCCESS;
+	}
+
+	return rc;
+}
+
+#ifdef ENABLE_IOT_WRITE_COALESCING
+/**
+ * @brief Write the packets collected in the coalescing buffer
+ *
+ * Called with the write side of the connection locked. The buffer is emptied even if
+ * the write fails, the connection is unusable then.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of the write
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_write_coalesced(AWS_IoT_Client *pClient) {
+	Timer timer;
+	IoT_Error_t rc;
+
+	if(0 == pClient->clientData.coalesceLen) {
+		return SUCCESS;
+	}
+
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+	rc = _aws_iot_mqtt_internal_write(pClient, pClient->clientData.coalesceBuf, pClient->clientData.coalesceLen,
+									  &timer);
+	pClient->clientData.coalesceLen = 0;
+
+	return rc;
+}
+#endif
+
 /**
  * @brief Send an MQTT packet on the network
  *
@@ -306,9 +377,10 @@ IoT_Error_t aws_iot_mqtt_internal_init_header(MQTTHeader *pHeader, MessageTypes
  * @return IoT_Error_t of send status
  */
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer) {
-
-	size_t sentLen, sent;
 	IoT_Error_t rc = FAILURE;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t unlockRc;
+#endif
 
 	FUNC_ENTRY;
 
@@ -327,167 +399,354 @@ IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t le
 	}
 #endif
 
-	sentLen = 0;
-	sent = 0;
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_sending(pClient, length);
+#endif
 
-	while(sent < length && !has_timer_expired(pTimer)) {
-		rc = pClient->networkStack.write(&(pClient->networkStack),
-						 &pClient->clientData.writeBuf[sent],
-						 (length - sent),
-						 pTimer,
-						 &sentLen);
-		if(SUCCESS != rc) {
-			/* there was an error writing the data */
-			break;
-		}
-		sent += sentLen;
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	/* Packets collected earlier must not be overtaken */
+	rc = _aws_iot_mqtt_internal_write_coalesced(pClient);
+	if(SUCCESS == rc) {
+		rc = _aws_iot_mqtt_internal_write(pClient, pClient->clientData.writeBuf, length, pTimer);
 	}
+#else
+	rc = _aws_iot_mqtt_internal_write(pClient, pClient->clientData.writeBuf, length, pTimer);
+#endif
 
 #ifdef _ENABLE_THREAD_SUPPORT_
-	rc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	unlockRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if(SUCCESS != unlockRc) {
+		FUNC_EXIT_RC(unlockRc);
+	}
+#endif
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Send an MQTT packet that nobody waits on
+ *
+ * While yield runs with ENABLE_IOT_WRITE_COALESCING the packet is only copied behind
+ * the small packets collected before it, and @ref aws_iot_mqtt_internal_flush_writes
+ * writes them all at once: one TLS record instead of one per packet. Otherwise, or if
+ * the packet is too large to collect, it is sent right away.
+ *
+ * @param pClient MQTT client which holds packet
+ * @param length Length of packet to send
+ * @param pTimer Amount of time allowed to send packet
+ *
+ * @return IoT_Error_t of send status
+ */
+IoT_Error_t aws_iot_mqtt_internal_send_packet_deferred(AWS_IoT_Client *pClient, size_t length, Timer *pTimer) {
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	IoT_Error_t rc = SUCCESS;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t unlockRc;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTimer) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(!pClient->clientData.isWriteCorked || length > AWS_IOT_MQTT_COALESCE_BUF_LEN) {
+		rc = aws_iot_mqtt_internal_send_packet(pClient, length, pTimer);
+		FUNC_EXIT_RC(rc);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
 #endif
 
-	if(sent == length) {
-		/* record the fact that we have successfully sent the packet */
-		//countdown_sec(&c->pingTimer, c->clientData.keepAliveInterval);
-		FUNC_EXIT_RC(SUCCESS);
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_sending(pClient, length);
+#endif
+
+	if(pClient->clientData.coalesceLen + length > AWS_IOT_MQTT_COALESCE_BUF_LEN) {
+		rc = _aws_iot_mqtt_internal_write_coalesced(pClient);
+	}
+	if(SUCCESS == rc) {
+		memcpy(&(pClient->clientData.coalesceBuf[pClient->clientData.coalesceLen]), pClient->clientData.writeBuf,
+			   length);
+		pClient->clientData.coalesceLen += length;
 	}
 
+#ifdef _ENABLE_THREAD_SUPPORT_
+	unlockRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if(SUCCESS != unlockRc) {
+		FUNC_EXIT_RC(unlockRc);
+	}
+#endif
+
 	FUNC_EXIT_RC(rc);
+#else
+	return aws_iot_mqtt_internal_send_packet(pClient, length, pTimer);
+#endif
 }
 
-static IoT_Error_t _aws_iot_mqtt_internal_readWrapper( AWS_IoT_Client *pClient, size_t offset, size_t size, Timer *pTimer, size_t * read_len ) {
-    IoT_Error_t rc;
-    int byteToRead;
-    size_t byteRead = 0;
+#ifdef ENABLE_IOT_WRITE_COALESCING
+/**
+ * @brief Write the packets collected by @ref aws_iot_mqtt_internal_send_packet_deferred
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of the write, SUCCESS if nothing was collected
+ */
+IoT_Error_t aws_iot_mqtt_internal_flush_writes(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t unlockRc;
+#endif
 
-    byteToRead = ( offset + size ) - pClient->clientData.readBufIndex;
+	FUNC_ENTRY;
 
-    if ( byteToRead > 0 )
-    {
-        rc = pClient->networkStack.read( &( pClient->networkStack ),
-            pClient->clientData.readBuf + pClient->clientData.readBufIndex,
-            (size_t)byteToRead,
-            pTimer,
-            &byteRead );
-        pClient->clientData.readBufIndex += byteRead;
+	if(0 == pClient->clientData.coalesceLen) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
 
-        /* refresh byte to read */
-        byteToRead = ( offset + size ) - ((int)pClient->clientData.readBufIndex);
-        *read_len = size - (size_t)byteToRead;
-    }
-    else
-    {
-        *read_len = size;
-        rc = SUCCESS;
-    }
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+#endif
 
+	rc = _aws_iot_mqtt_internal_write_coalesced(pClient);
 
+#ifdef _ENABLE_THREAD_SUPPORT_
+	unlockRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if(SUCCESS != unlockRc) {
+		FUNC_EXIT_RC(unlockRc);
+	}
+#endif
 
-    return rc;
+	FUNC_EXIT_RC(rc);
 }
-static IoT_Error_t _aws_iot_mqtt_internal_decode_packet_remaining_len(AWS_IoT_Client *pClient, size_t * offset,
-																	  size_t *rem_len, Timer *pTimer) {
-	size_t multiplier, len;
+#endif
+
+/**
+ * @brief Copy bytes out of the receive ring without consuming them
+ *
+ * @param pClientData Client data holding the ring
+ * @param offset Offset from the oldest unconsumed byte
+ * @param pDest Destination buffer
+ * @param len Number of bytes to copy, must not exceed the ring fill level minus offset
+ */
+static void _aws_iot_mqtt_internal_rx_ring_peek(ClientData *pClientData, size_t offset, unsigned char *pDest,
+												size_t len) {
+	size_t pos, firstChunk;
+
+	pos = (pClientData->rxRingHead + offset) % pClientData->rxRingSize;
+	firstChunk = pClientData->rxRingSize - pos;
+	if(firstChunk > len) {
+		firstChunk = len;
+	}
+
+	memcpy(pDest, &(pClientData->rxRing[pos]), firstChunk);
+	memcpy(pDest + firstChunk, pClientData->rxRing, len - firstChunk);
+}
+
+/**
+ * @brief Drop bytes from the front of the receive ring
+ *
+ * @param pClientData Client data holding the ring
+ * @param len Number of bytes to drop, must not exceed the ring fill level
+ */
+static void _aws_iot_mqtt_internal_rx_ring_consume(ClientData *pClientData, size_t len) {
+	pClientData->rxRingFill -= len;
+	if(0 == pClientData->rxRingFill) {
+		/* Rewind an empty ring so the next network read lands in one contiguous chunk */
+		pClientData->rxRingHead = 0;
+	} else {
+		pClientData->rxRingHead = (pClientData->rxRingHead + len) % pClientData->rxRingSize;
+	}
+}
+
+/**
+ * @brief Pull data from the network into the receive ring
+ *
+ * Reads until the ring holds at least minLen bytes. When the network layer provides
+ * readAvailable every call takes all data already decrypted by TLS, so a burst of small
+ * packets is usually fetched in a single read. Otherwise only the missing bytes are requested.
+ *
+ * @param pClient MQTT client
+ * @param minLen Number of bytes the ring must hold on success, must not exceed the ring size
+ * @param pTimer Amount of time allowed for the read
+ *
+ * @return SUCCESS, MQTT_NOTHING_TO_READ if no more data arrived or the network read error
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_rx_ring_fill(AWS_IoT_Client *pClient, size_t minLen, Timer *pTimer) {
+	ClientData *pClientData = &(pClient->clientData);
+	size_t tail, space, readLen;
 	IoT_Error_t rc;
-    size_t read_len;
 
-	FUNC_ENTRY;
+	while(pClientData->rxRingFill < minLen) {
+		tail = (pClientData->rxRingHead + pClientData->rxRingFill) % pClientData->rxRingSize;
+		space = pClientData->rxRingSize - tail;
+		if(space > pClientData->rxRingSize - pClientData->rxRingFill) {
+			space = pClientData->rxRingSize - pClientData->rxRingFill;
+		}
+
+		readLen = 0;
+		if(NULL != pClient->networkStack.readAvailable) {
+			rc = pClient->networkStack.readAvailable(&(pClient->networkStack), &(pClientData->rxRing[tail]), space,
+													 pTimer, &readLen);
+		} else {
+			if(space > minLen - pClientData->rxRingFill) {
+				space = minLen - pClientData->rxRingFill;
+			}
+			rc = pClient->networkStack.read(&(pClient->networkStack), &(pClientData->rxRing[tail]), space,
+											pTimer, &readLen);
+		}
+
+		/* Keep whatever arrived even on error, a partial packet is completed by the next call */
+		pClientData->rxRingFill += readLen;
+
+		if(NETWORK_SSL_NOTHING_TO_READ == rc || (SUCCESS == rc && 0 == readLen)) {
+			return MQTT_NOTHING_TO_READ;
+		} else if(SUCCESS != rc) {
+			return rc;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Decode the fixed header of the packet at the front of the receive ring
+ *
+ * @param pClientData Client data holding the ring
+ * @param pHeaderLen Output parameter for the length of the fixed header
+ * @param pRemLen Output parameter for the decoded remaining length
+ *
+ * @return SUCCESS, MQTT_NOTHING_TO_READ if the header is not complete yet
+ * or MQTT_DECODE_REMAINING_LENGTH_ERROR
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_rx_ring_decode_header(ClientData *pClientData, size_t *pHeaderLen,
+																size_t *pRemLen) {
+	size_t multiplier, len;
+	unsigned char encodedByte;
 
 	multiplier = 1;
 	len = 0;
-	*rem_len = 0;
+	*pRemLen = 0;
 
 	do {
 		if(++len > MAX_NO_OF_REMAINING_LENGTH_BYTES) {
 			/* bad data */
-			FUNC_EXIT_RC(MQTT_DECODE_REMAINING_LENGTH_ERROR);
+			return MQTT_DECODE_REMAINING_LENGTH_ERROR;
+		}
+		if(len >= pClientData->rxRingFill) {
+			return MQTT_NOTHING_TO_READ;
 		}
-        rc = _aws_iot_mqtt_internal_readWrapper( pClient, len, 1, pTimer, &read_len );
+		_aws_iot_mqtt_internal_rx_ring_peek(pClientData, len, &encodedByte, 1);
+		*pRemLen += ((encodedByte & 127) * multiplier);
+		multiplier *= 128;
+	} while((encodedByte & 128) != 0);
 
-		if(SUCCESS != rc) {
-			FUNC_EXIT_RC(rc);
+	*pHeaderLen = len + 1;
+	return SUCCESS;
+}
+
+/**
+ * @brief Drop the remainder of an oversized packet
+ *
+ * @param pClient MQTT client
+ * @param pTimer Amount of time allowed for reading the rest of the packet
+ *
+ * @return MQTT_RX_BUFFER_TOO_SHORT_ERROR once the packet is gone, otherwise the read status
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_rx_ring_discard(AWS_IoT_Client *pClient, Timer *pTimer) {
+	ClientData *pClientData = &(pClient->clientData);
+	size_t dropLen;
+	IoT_Error_t rc;
+
+	while(pClientData->rxDiscardLen > 0) {
+		if(0 == pClientData->rxRingFill) {
+			dropLen = pClientData->rxDiscardLen;
+			if(dropLen > pClientData->rxRingSize) {
+				dropLen = pClientData->rxRingSize;
+			}
+			rc = _aws_iot_mqtt_internal_rx_ring_fill(pClient, dropLen, pTimer);
+			if(SUCCESS != rc && 0 == pClientData->rxRingFill) {
+				return rc;
+			}
 		}
 
-		*rem_len += (( pClient->clientData.readBuf[len] & 127) * multiplier);
-		multiplier *= 128;
-	} while(( pClient->clientData.readBuf[len] & 128) != 0);
-    *offset = len + 1;
-	FUNC_EXIT_RC(rc);
+		dropLen = pClientData->rxRingFill;
+		if(dropLen > pClientData->rxDiscardLen) {
+			dropLen = pClientData->rxDiscardLen;
+		}
+		_aws_iot_mqtt_internal_rx_ring_consume(pClientData, dropLen);
+		pClientData->rxDiscardLen -= dropLen;
+	}
+
+	return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
 }
 
 static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType) {
-	size_t rem_len, total_bytes_read, bytes_to_be_read, read_len;
+	ClientData *pClientData = &(pClient->clientData);
+	size_t headerLen, remLen, packetLen;
 	IoT_Error_t rc;
-    size_t offset = 0;
 	MQTTHeader header = {0};
-	Timer packetTimer;
-	init_timer(&packetTimer);
-	countdown_ms(&packetTimer, pClient->clientData.packetTimeoutMs);
-
-	rem_len = 0;
-	total_bytes_read = 0;
-	bytes_to_be_read = 0;
-	read_len = 0;
-
-    rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, 1, pTimer, &read_len );
-	/* 1. read the header byte.  This has the packet type in it */
-	if(NETWORK_SSL_NOTHING_TO_READ == rc) {
-		return MQTT_NOTHING_TO_READ;
-	} else if(SUCCESS != rc) {
-		return rc;
+
+	headerLen = 0;
+	remLen = 0;
+
+	/* 0. finish dropping an oversized packet whose tail had not arrived yet */
+	if(pClientData->rxDiscardLen > 0) {
+		return _aws_iot_mqtt_internal_rx_ring_discard(pClient, pTimer);
+	}
+
+	/* 1. frame the fixed header, only going to the network when the ring runs dry */
+	rc = _aws_iot_mqtt_internal_rx_ring_decode_header(pClientData, &headerLen, &remLen);
+	while(MQTT_NOTHING_TO_READ == rc) {
+		rc = _aws_iot_mqtt_internal_rx_ring_fill(pClient, pClientData->rxRingFill + 1, pTimer);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		rc = _aws_iot_mqtt_internal_rx_ring_decode_header(pClientData, &headerLen, &remLen);
 	}
 
-	/* 2. read the remaining length.  This is variable in itself */
-	rc = _aws_iot_mqtt_internal_decode_packet_remaining_len(pClient, &offset, &rem_len, pTimer);
 	if(SUCCESS != rc) {
+		/* The stream can no longer be framed, drop what is buffered */
+		aws_iot_mqtt_internal_flushBuffers(pClient);
 		return rc;
 	}
 
-	/* if the buffer is too short then the message will be dropped silently */
-	if((rem_len + offset) >= pClient->clientData.readBufSize) {
-		bytes_to_be_read = pClient->clientData.readBufSize;
-		do {
-			rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
-											pTimer, &read_len);
-			if(SUCCESS == rc) {
-				total_bytes_read += read_len;
-				if((rem_len - total_bytes_read) >= pClient->clientData.readBufSize) {
-					bytes_to_be_read = pClient->clientData.readBufSize;
-				} else {
-					bytes_to_be_read = rem_len - total_bytes_read;
-				}
-			}
-		} while(total_bytes_read < rem_len && SUCCESS == rc);
-
-        /* Check buffer was correctly emptied, otherwise, return error message. */
-        if ( total_bytes_read == rem_len )
-        {
-            aws_iot_mqtt_internal_flushBuffers( pClient );
-            return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
-        }
-        else
-        {
-            return rc;
-        }
-	}
-
-	/* 3. read the rest of the buffer using a callback to supply the rest of the data */
-	if(rem_len > 0) {
-        rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, rem_len, pTimer, &read_len );
-		if(SUCCESS != rc || read_len != rem_len) {
-			return FAILURE;
-		}
+	packetLen = headerLen + remLen;
+
+	/* 2. if the buffer is too short then the message will be dropped silently */
+	if(packetLen >= pClientData->readBufSize) {
+#ifndef DISABLE_IOT_STATS
+		aws_iot_mqtt_internal_stats_dropped_oversized(pClient, packetLen);
+#endif
+		IOT_TRACE_EVENT(IOT_TRACE_DROP, pClient, packetLen);
+		pClientData->rxDiscardLen = packetLen;
+		return _aws_iot_mqtt_internal_rx_ring_discard(pClient, pTimer);
 	}
 
-    /* Pack has been received, we can flush the buffers for next call. */
-    aws_iot_mqtt_internal_flushBuffers( pClient );
-	header.byte = pClient->clientData.readBuf[0];
+	/* 3. make sure the whole packet is buffered, then hand it to the deserializers */
+	rc = _aws_iot_mqtt_internal_rx_ring_fill(pClient, packetLen, pTimer);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	_aws_iot_mqtt_internal_rx_ring_peek(pClientData, 0, pClientData->readBuf, packetLen);
+	_aws_iot_mqtt_internal_rx_ring_consume(pClientData, packetLen);
+
+	header.byte = pClientData->readBuf[0];
 	*pPacketType = MQTT_HEADER_FIELD_TYPE(header.byte);
 
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_received(pClient, *pPacketType, packetLen);
+#endif
+	IOT_TRACE_EVENT(IOT_TRACE_RECEIVE, pClient, ((uint32_t) *pPacketType << 24) | (packetLen & 0xFFFFFF));
+
 	FUNC_EXIT_RC(rc);
 }
 
@@ -558,6 +817,13 @@ static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClien
 			   || _aws_iot_mqtt_internal_is_topic_matched((char *) pClient->clientData.messageHandlers[itr].topicName,
 														  pTopicName, topicNameLen)) {
 				if(NULL != pClient->clientData.messageHandlers[itr].pApplicationHandler) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+					if(DISPATCH_INLINE != pClient->clientData.dispatchQueues[itr].policy) {
+						/* A worker runs the handler, reading goes on */
+						aws_iot_mqtt_internal_dispatch_message(pClient, itr, pTopicName, topicNameLen, pMessageParams);
+						continue;
+					}
+#endif
 					pClient->clientData.messageHandlers[itr].pApplicationHandler(pClient, pTopicName, topicNameLen,
 																				 pMessageParams,
 																				 pClient->clientData.messageHandlers[itr].pApplicationHandlerData);
@@ -577,6 +843,9 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 	IoT_Error_t rc;
 	IoT_Publish_Message_Params msg;
 	Timer sendTimer;
+#ifdef ENABLE_IOT_MQTT5
+	unsigned char *pPayloadStart, *pPayloadEnd;
+#endif
 
 	FUNC_ENTRY;
 
@@ -594,6 +863,22 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 		FUNC_EXIT_RC(rc);
 	}
 
+#ifdef ENABLE_IOT_MQTT5
+	/* The payload starts after the properties. The client announces no Topic Alias
+	 * Maximum, so the server doesn't send aliases and none of them matter here */
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		pPayloadStart = (unsigned char *) msg.payload;
+		pPayloadEnd = pPayloadStart + msg.payloadLen;
+
+		rc = aws_iot_mqtt_internal_mqtt5_skip_properties(&pPayloadStart, pPayloadEnd);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+		msg.payload = pPayloadStart;
+		msg.payloadLen = (size_t) (pPayloadEnd - pPayloadStart);
+	}
+#endif
+
 	/* Send acknowledgement of QoS 1 message. */
 	if(QOS1 == msg.qos) {
 		/* Initialize timer for sending PUBACK. */
@@ -602,11 +887,12 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 
 		/* Generate and send a PUBACK. Warn if the PUBACK isn't sent; the server
 		will send the PUBLISH again in that case. */
+		(void)aws_iot_mqtt_internal_lock_write_buf(pClient);
 		rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf,
 			pClient->clientData.writeBufSize, PUBACK, 0, msg.id, &len);
 
 		if(SUCCESS == rc) {
-			rc = aws_iot_mqtt_internal_send_packet(pClient, len, &sendTimer);
+			rc = aws_iot_mqtt_internal_send_packet_deferred(pClient, len, &sendTimer);
 
 			if(SUCCESS != rc) {
 				IOT_WARN("Failed to send PUBACK");
@@ -614,6 +900,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 		} else {
 			IOT_WARN("Failed to generate PUBACK");
 		}
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 	}
 
 	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg);
@@ -624,9 +911,138 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/**
+ * @brief Hand a received PUBACK over to the publish it acknowledges
+ *
+ * Drops the message from the session store and wakes the full-duplex publisher
+ * waiting for it or completes the queued message. On MQTT 5 the PUBACK also frees
+ * a unit of the send quota and may carry a failure reason code. Must be called
+ * while the PUBACK is still in the read buffer.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of PUBACK deserialization
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_handle_puback(AWS_IoT_Client *pClient) {
+	unsigned char type, dup;
+	uint16_t packetId;
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	uint32_t itr;
+#endif
+	IoT_Error_t ackRc = SUCCESS;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_mqtt_internal_deserialize_ack(&type, &dup, &packetId, pClient->clientData.readBuf,
+											   pClient->clientData.readBufSize);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		pClient->clientStatus.lastReasonCode = aws_iot_mqtt_internal_mqtt5_reason_code(pClient->clientData.readBuf);
+		if(MQTT5_REASON_FAILURE <= pClient->clientStatus.lastReasonCode) {
+			ackRc = MQTT_REQUEST_REJECTED_ERROR;
+		}
+		aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+	}
+#endif
+
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_puback(pClient, packetId);
+#endif
+	IOT_TRACE_EVENT(IOT_TRACE_PUBACK, pClient, packetId);
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		if(packetId == pClient->clientData.ackWaiters[itr].packetId) {
+			pClient->clientData.ackWaiters[itr].isAcked = true;
+#ifdef ENABLE_IOT_MQTT5
+			pClient->clientData.ackWaiters[itr].isRejected = (SUCCESS != ackRc);
+#endif
+			(void)aws_iot_thread_semaphore_post(&(pClient->clientData.ackWaiters[itr].ackSem));
+			break;
+		}
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+#endif
+
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	aws_iot_mqtt_internal_publish_queue_ack(pClient, packetId, ackRc);
+#else
+	IOT_UNUSED(ackRc);
+#endif
+
+	if(NULL != pClient->clientData.pSessionStore) {
+		pClient->clientData.pSessionStore->remove(pClient->clientData.pSessionStore->pContext, packetId);
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Process a packet that was just read into the read buffer
+ *
+ * @param pClient MQTT client
+ * @param packetType Type of the packet in the read buffer
+ *
+ * @return IoT_Error_t of packet processing
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_dispatch_packet(AWS_IoT_Client *pClient, uint8_t packetType) {
+	IoT_Error_t rc = SUCCESS;
+
+	switch(packetType) {
+		case PUBACK:
+			/* Queued and full-duplex publishers don't read the network themselves */
+			rc = _aws_iot_mqtt_internal_handle_puback(pClient);
+#ifdef ENABLE_IOT_FULL_DUPLEX
+			break;
+#endif
+		case CONNACK:
+		case SUBACK:
+		case UNSUBACK:
+			/* SDK is blocking, these responses will be forwarded to calling function to process */
+			break;
+		case PUBLISH: {
+			rc = _aws_iot_mqtt_internal_handle_publish(pClient);
+			break;
+		}
+		case PUBREC:
+		case PUBCOMP:
+			/* QoS2 not supported at this time */
+			break;
+		case PINGRESP: {
+			/* There is no outstanding ping request anymore. */
+			pClient->clientStatus.isPingOutstanding = false;
+			break;
+		}
+#ifdef ENABLE_IOT_MQTT5
+		case DISCONNECT:
+			/* An MQTT 5 server says why it closes the connection */
+			pClient->clientStatus.lastReasonCode = aws_iot_mqtt_internal_mqtt5_reason_code(pClient->clientData.readBuf);
+			rc = MQTT_SERVER_DISCONNECT_ERROR;
+			break;
+#endif
+		default: {
+			/* Either unknown packet type or Failure occurred
+             * Should not happen */
+			rc = MQTT_RX_MESSAGE_PACKET_TYPE_INVALID_ERROR;
+			break;
+		}
+	}
+
+	return rc;
+}
+
 /**
  * @brief Read an MQTT packet from the network
  *
+ * In full-duplex mode the read mutex is held until the packet has been processed,
+ * so another task can't overwrite the read buffer while it is still in use.
+ *
  * @param pClient MQTT client
  * @param pTimer Amount of time allowed to read packet
  * @param pPacketType Output parameter for packet read from network
@@ -654,6 +1070,12 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 	/* read the socket, see what work is due */
 	rc = _aws_iot_mqtt_internal_read_packet(pClient, pTimer, pPacketType);
 
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	if(SUCCESS == rc) {
+		rc = _aws_iot_mqtt_internal_dispatch_packet(pClient, *pPacketType);
+	}
+#endif
+
 #ifdef _ENABLE_THREAD_SUPPORT_
 	threadRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_read_mutex));
 	if(SUCCESS != threadRc && (MQTT_NOTHING_TO_READ == rc || SUCCESS == rc)) {
@@ -668,33 +1090,9 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 		return rc;
 	}
 
-	switch(*pPacketType) {
-		case CONNACK:
-		case PUBACK:
-		case SUBACK:
-		case UNSUBACK:
-			/* SDK is blocking, these responses will be forwarded to calling function to process */
-			break;
-		case PUBLISH: {
-			rc = _aws_iot_mqtt_internal_handle_publish(pClient);
-			break;
-		}
-		case PUBREC:
-		case PUBCOMP:
-			/* QoS2 not supported at this time */
-			break;
-		case PINGRESP: {
-			/* There is no outstanding ping request anymore. */
-			pClient->clientStatus.isPingOutstanding = false;
-			break;
-		}
-		default: {
-			/* Either unknown packet type or Failure occurred
-             * Should not happen */
-			rc = MQTT_RX_MESSAGE_PACKET_TYPE_INVALID_ERROR;
-			break;
-		}
-	}
+#ifndef ENABLE_IOT_FULL_DUPLEX
+	rc = _aws_iot_mqtt_internal_dispatch_packet(pClient, *pPacketType);
+#endif
 
 	return rc;
 }
@@ -702,12 +1100,16 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 /**
  * @brief Flush incoming data from the MQTT client
  *
+ * Drops everything held in the receive ring, including a partially received packet.
+ *
  * @param pClient Client with data to flush
  *
  * @return Always returns SUCCESS
  */
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient ) {
-    pClient->clientData.readBufIndex = 0;
+    pClient->clientData.rxRingHead = 0;
+    pClient->clientData.rxRingFill = 0;
+    pClient->clientData.rxDiscardLen = 0;
     return SUCCESS;
 }
 
@@ -746,6 +1148,310 @@ IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t
 	FUNC_EXIT_RC(rc);
 }
 
+/**
+ * @brief Take exclusive use of the write buffer
+ *
+ * In full-duplex mode several tasks may send at the same time, so the write buffer
+ * has to be held from serialization until the packet is on the network.
+ * Blocks regardless of isBlockOnThreadLockEnabled, a writer only ever waits for
+ * another send to finish. Does nothing otherwise.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex operation
+ */
+IoT_Error_t aws_iot_mqtt_internal_lock_write_buf(AWS_IoT_Client *pClient) {
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	return aws_iot_thread_mutex_lock(&(pClient->clientData.tls_write_mutex));
+#else
+	IOT_UNUSED(pClient);
+	return SUCCESS;
+#endif
+}
+
+/**
+ * @brief Release the write buffer taken with aws_iot_mqtt_internal_lock_write_buf
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex operation
+ */
+IoT_Error_t aws_iot_mqtt_internal_unlock_write_buf(AWS_IoT_Client *pClient) {
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	return aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_write_mutex));
+#else
+	IOT_UNUSED(pClient);
+	return SUCCESS;
+#endif
+}
+
+/**
+ * @brief Open the network connection of the client
+ *
+ * In full-duplex mode other tasks may be reading or writing the old connection at
+ * the same time, so both network mutexes are held while it is replaced. They are
+ * taken in the order read, write like everywhere else.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of the network connect
+ */
+IoT_Error_t aws_iot_mqtt_internal_network_connect(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_read_mutex));
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_write_mutex));
+#endif
+
+	rc = pClient->networkStack.connect(&(pClient->networkStack), NULL);
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_write_mutex));
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+#endif
+
+	return rc;
+}
+
+/**
+ * @brief Disconnect and destroy the network connection of the client
+ *
+ * Holds both network mutexes in full-duplex mode, see
+ * @ref aws_iot_mqtt_internal_network_connect.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of the network destroy
+ */
+IoT_Error_t aws_iot_mqtt_internal_network_close(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_read_mutex));
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_write_mutex));
+#endif
+
+	pClient->networkStack.disconnect(&(pClient->networkStack));
+	rc = pClient->networkStack.destroy(&(pClient->networkStack));
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_write_mutex));
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+#endif
+
+	return rc;
+}
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+
+/** How long a publisher sleeps between checks while another task owns the network read */
+#define ACK_WAIT_SLICE_MS 50
+
+/**
+ * @brief Set up the PUBACK waiter table
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex/semaphore initialization
+ */
+IoT_Error_t aws_iot_mqtt_internal_init_ack_waiters(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_thread_mutex_init(&(pClient->clientData.ack_waiter_mutex));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		pClient->clientData.ackWaiters[itr].packetId = 0;
+		pClient->clientData.ackWaiters[itr].isAcked = false;
+		rc = aws_iot_thread_semaphore_init(&(pClient->clientData.ackWaiters[itr].ackSem));
+		if(SUCCESS != rc) {
+			while(itr > 0) {
+				--itr;
+				(void)aws_iot_thread_semaphore_destroy(&(pClient->clientData.ackWaiters[itr].ackSem));
+			}
+			(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.ack_waiter_mutex));
+			FUNC_EXIT_RC(rc);
+		}
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Tear down the PUBACK waiter table
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_destroy_ack_waiters(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		(void)aws_iot_thread_semaphore_destroy(&(pClient->clientData.ackWaiters[itr].ackSem));
+	}
+	(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.ack_waiter_mutex));
+}
+
+/**
+ * @brief Reserve a slot to wait for the PUBACK of a QoS1 publish
+ *
+ * Must be called before the PUBLISH is sent, so an ack arriving immediately isn't missed.
+ *
+ * @param pClient MQTT client
+ * @param packetId Packet identifier of the publish
+ * @param ppWaiter Output parameter for the reserved slot
+ *
+ * @return SUCCESS or LIMIT_EXCEEDED_ERROR if AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH publishes are already waiting
+ */
+IoT_Error_t aws_iot_mqtt_internal_register_ack_waiter(AWS_IoT_Client *pClient, uint16_t packetId,
+													  AckWaiter **ppWaiter) {
+	uint32_t itr;
+	AckWaiter *pWaiter = NULL;
+
+	FUNC_ENTRY;
+
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		if(0 == pClient->clientData.ackWaiters[itr].packetId) {
+			pWaiter = &(pClient->clientData.ackWaiters[itr]);
+			pWaiter->packetId = packetId;
+			pWaiter->isAcked = false;
+#ifdef ENABLE_IOT_MQTT5
+			pWaiter->isRejected = false;
+#endif
+			break;
+		}
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+
+	if(NULL == pWaiter) {
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	/* Drop a wakeup left over from the previous user of the slot */
+	while(SUCCESS == aws_iot_thread_semaphore_wait(&(pWaiter->ackSem), 0)) {
+	}
+
+	*ppWaiter = pWaiter;
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Wait until the PUBACK for a registered publish arrives
+ *
+ * Normally a dedicated task calling aws_iot_mqtt_yield reads the network and signals
+ * the waiter. If no operation owns the network (client idle, or the publish was made
+ * from a subscribe callback of the reading task) the publisher reads it itself.
+ *
+ * @param pClient MQTT client
+ * @param pWaiter Slot returned by aws_iot_mqtt_internal_register_ack_waiter
+ * @param pTimer Amount of time allowed to wait
+ *
+ * @return SUCCESS, MQTT_REQUEST_TIMEOUT_ERROR or NETWORK_DISCONNECTED_ERROR, or
+ * MQTT_REQUEST_REJECTED_ERROR if an MQTT 5 server refused the message
+ */
+IoT_Error_t aws_iot_mqtt_internal_wait_for_ack(AWS_IoT_Client *pClient, AckWaiter *pWaiter, Timer *pTimer) {
+	bool isAcked, isReader;
+	uint8_t packetType;
+	uint32_t waitMs;
+	ClientState clientState;
+	Timer readTimer;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	for(;;) {
+		(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+		isAcked = pWaiter->isAcked;
+		(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+
+		if(isAcked) {
+#ifdef ENABLE_IOT_MQTT5
+			if(pWaiter->isRejected) {
+				FUNC_EXIT_RC(MQTT_REQUEST_REJECTED_ERROR);
+			}
+#endif
+			FUNC_EXIT_RC(SUCCESS);
+		}
+		if(has_timer_expired(pTimer)) {
+			FUNC_EXIT_RC(MQTT_REQUEST_TIMEOUT_ERROR);
+		}
+		if(!aws_iot_mqtt_is_client_connected(pClient)) {
+			FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+		}
+
+		waitMs = left_ms(pTimer);
+		if(ACK_WAIT_SLICE_MS < waitMs) {
+			waitMs = ACK_WAIT_SLICE_MS;
+		}
+
+		/* The read mutex is recursive, so this also succeeds when called from a
+		 * callback running on the reading task itself */
+		isReader = false;
+		if(SUCCESS == aws_iot_thread_mutex_trylock(&(pClient->clientData.tls_read_mutex))) {
+			clientState = aws_iot_mqtt_get_client_state(pClient);
+			if((CLIENT_STATE_CONNECTED_IDLE == clientState || CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN == clientState)
+			   && SUCCESS == aws_iot_mqtt_set_client_state(pClient, clientState,
+														   CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS)) {
+				isReader = true;
+				init_timer(&readTimer);
+				countdown_ms(&readTimer, waitMs);
+				rc = aws_iot_mqtt_internal_cycle_read(pClient, &readTimer, &packetType);
+				(void)aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, clientState);
+				if(SUCCESS != rc && MQTT_NOTHING_TO_READ != rc) {
+					(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+					FUNC_EXIT_RC(rc);
+				}
+			}
+			(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+		}
+
+		if(!isReader) {
+			(void)aws_iot_thread_semaphore_wait(&(pWaiter->ackSem), waitMs);
+		}
+	}
+}
+
+/**
+ * @brief Give back a slot reserved with aws_iot_mqtt_internal_register_ack_waiter
+ *
+ * @param pClient MQTT client
+ * @param pWaiter Slot to free
+ */
+void aws_iot_mqtt_internal_release_ack_waiter(AWS_IoT_Client *pClient, AckWaiter *pWaiter) {
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+	pWaiter->packetId = 0;
+	pWaiter->isAcked = false;
+#ifdef ENABLE_IOT_MQTT5
+	pWaiter->isRejected = false;
+#endif
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+}
+
+/**
+ * @brief Wake every waiting publisher, e.g. because the connection was lost
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_wake_ack_waiters(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.ack_waiter_mutex));
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		if(0 != pClient->clientData.ackWaiters[itr].packetId) {
+			(void)aws_iot_thread_semaphore_post(&(pClient->clientData.ackWaiters[itr].ackSem));
+		}
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.ack_waiter_mutex));
+}
+
+#endif
+
 /**
   * Serializes a 0-length packet into the supplied buffer, ready for writing to a socket
   * @param pTxBuf the buffer into which the packet will be serialized
@@ -78,13 +78,13 @@ typedef union {
 #if defined(REVERSED)
 	struct
 	{
-		unsigned int sessionpresent : 1;	/**< session present flag */
 		unsigned int : 7;					/**< unused */
+		unsigned int sessionpresent : 1;	/**< session present flag */
 	} bits; /**< connect flags byte (reverse order) */
 #else
 	struct {
-		unsigned int : 7; /**< unused */
 		unsigned int sessionpresent : 1; /**< session present flag */
+		unsigned int : 7; /**< unused */
 	} bits; /**< connect flags byte (normal order) */
 #endif
 } MQTT_Connack_Header_Flags;
@@ -99,6 +99,25 @@ typedef enum {
 	CONNACK_NOT_AUTHORIZED_ERROR = 5 /**< Not authorized */
 } MQTT_Connack_Return_Codes;
 
+#ifdef ENABLE_IOT_MQTT5
+/**
+  * Length of the properties of an MQTT 5 CONNECT, without the property length field.
+  * The client announces its Receive Maximum and Maximum Packet Size, and keeps a
+  * persistent session with a Session Expiry Interval.
+  * @param pConnectParams the options to be used to build the connect packet
+  * @return length of the properties in bytes
+  */
+static uint32_t _aws_iot_mqtt5_get_connect_properties_length(IoT_Client_Connect_Params *pConnectParams) {
+	uint32_t len = 3 + 5; /* Receive Maximum, Maximum Packet Size */
+
+	if(!pConnectParams->isCleanSession) {
+		len += 5; /* Session Expiry Interval */
+	}
+
+	return len;
+}
+#endif
+
 /**
   * Determines the length of the MQTT connect packet that would be produced using the supplied connect options.
   * @param options the options to be used to build the connect packet
@@ -123,6 +142,16 @@ static uint32_t _aws_iot_get_connect_packet_length(IoT_Client_Connect_Params *pC
 		len = len + pConnectParams->will.topicNameLen + 2 + pConnectParams->will.msgLen + 2;
 	}
 
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == pConnectParams->MQTTVersion) {
+		/* Properties and their one byte length, plus an empty will property length */
+		len = len + 1 + _aws_iot_mqtt5_get_connect_properties_length(pConnectParams);
+		if(pConnectParams->isWillMsgPresent) {
+			len = len + 1;
+		}
+	}
+#endif
+
 	if(NULL != pConnectParams->pUsername) {
 		len = len + pConnectParams->usernameLen + 2;
 	}
@@ -139,12 +168,13 @@ static uint32_t _aws_iot_get_connect_packet_length(IoT_Client_Connect_Params *pC
   * @param buf the buffer into which the packet will be serialized
   * @param len the length in bytes of the supplied buffer
   * @param options the options to be used to build the connect packet
+  * @param maxPacketSize the largest packet the client can receive, announced on MQTT 5
   * @param serialized length
   * @return IoT_Error_t indicating function execution status
   */
 static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t txBufLen,
 												   IoT_Client_Connect_Params *pConnectParams,
-												   size_t *pSerializedLen) {
+												   uint32_t maxPacketSize, size_t *pSerializedLen) {
 	unsigned char *ptr;
 	uint32_t len;
 	IoT_Error_t rc;
@@ -162,6 +192,9 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	/* Check needed here before we start writing to the Tx buffer */
 	switch(pConnectParams->MQTTVersion) {
 		case MQTT_3_1_1:
+#ifdef ENABLE_IOT_MQTT5
+		case MQTT_5:
+#endif
 			break;
 		default:
 			return MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR;
@@ -212,6 +245,22 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	aws_iot_mqtt_internal_write_char(&ptr, flags.all);
 	aws_iot_mqtt_internal_write_uint_16(&ptr, pConnectParams->keepAliveIntervalInSec);
 
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == pConnectParams->MQTTVersion) {
+		aws_iot_mqtt_internal_write_char(&ptr, (unsigned char) _aws_iot_mqtt5_get_connect_properties_length(pConnectParams));
+		aws_iot_mqtt_internal_write_char(&ptr, MQTT5_PROPERTY_RECEIVE_MAXIMUM);
+		aws_iot_mqtt_internal_write_uint_16(&ptr, AWS_IOT_MQTT5_RECEIVE_MAXIMUM);
+		aws_iot_mqtt_internal_write_char(&ptr, MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE);
+		aws_iot_mqtt_internal_write_uint_32(&ptr, maxPacketSize);
+		if(!pConnectParams->isCleanSession) {
+			aws_iot_mqtt_internal_write_char(&ptr, MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL);
+			aws_iot_mqtt_internal_write_uint_32(&ptr, AWS_IOT_MQTT5_SESSION_EXPIRY_SEC);
+		}
+	}
+#else
+	IOT_UNUSED(maxPacketSize);
+#endif
+
 	/* If the code have passed the check for incorrect values above, no client id was passed as argument */
 	if(NULL == pConnectParams->pClientID) {
 		aws_iot_mqtt_internal_write_uint_16(&ptr, 0);
@@ -220,6 +269,11 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	}
 
 	if(pConnectParams->isWillMsgPresent) {
+#ifdef ENABLE_IOT_MQTT5
+		if(MQTT_5 == pConnectParams->MQTTVersion) {
+			aws_iot_mqtt_internal_write_char(&ptr, 0); /* no will properties */
+		}
+#endif
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pConnectParams->will.pTopicName,
 												pConnectParams->will.topicNameLen);
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pConnectParams->will.pMessage, pConnectParams->will.msgLen);
@@ -321,6 +375,122 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_connack(unsigned char *pSessionPres
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+#ifdef ENABLE_IOT_MQTT5
+/**
+  * Deserializes an MQTT 5 CONNACK from the client's read buffer. Applies the Receive
+  * Maximum, Topic Alias Maximum and Server Keep Alive properties to the client.
+  * @param pClient the client the CONNACK was received on
+  * @param pSessionPresent the session present flag returned
+  * @param pConnackRc returned connack return code, mapped from the reason code
+  * @return IoT_Error_t indicating function execution status
+  */
+static IoT_Error_t _aws_iot_mqtt5_deserialize_connack(AWS_IoT_Client *pClient, unsigned char *pSessionPresent,
+													  IoT_Error_t *pConnackRc) {
+	unsigned char *curdata, *enddata, *propdata;
+	uint32_t decodedLen = 0;
+	uint32_t readBytesLen = 0;
+	uint32_t value;
+	uint8_t reasonCode, propertyId;
+	IoT_Error_t rc;
+	MQTT_Connack_Header_Flags flags = {0};
+	MQTTHeader header = {0};
+
+	FUNC_ENTRY;
+
+	curdata = pClient->clientData.readBuf;
+	header.byte = aws_iot_mqtt_internal_read_char(&curdata);
+	if(CONNACK != MQTT_HEADER_FIELD_TYPE(header.byte)) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	rc = aws_iot_mqtt_internal_decode_remaining_length_from_buffer(curdata, &decodedLen, &readBytesLen);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Flags and reason code, the properties may be left out when there are none */
+	curdata += readBytesLen;
+	enddata = curdata + decodedLen;
+	if(2 > decodedLen || (size_t) (enddata - pClient->clientData.readBuf) > pClient->clientData.readBufSize) {
+		FUNC_EXIT_RC(MQTT_DECODE_REMAINING_LENGTH_ERROR);
+	}
+
+	flags.all = aws_iot_mqtt_internal_read_char(&curdata);
+	*pSessionPresent = flags.bits.sessionpresent;
+	reasonCode = aws_iot_mqtt_internal_read_char(&curdata);
+	pClient->clientStatus.lastReasonCode = reasonCode;
+
+	switch(reasonCode) {
+		case 0x00: /* Success */
+			*pConnackRc = MQTT_CONNACK_CONNECTION_ACCEPTED;
+			break;
+		case 0x01: /* MQTT 3.1.1 servers answer a version they don't support this way */
+		case 0x84: /* Unsupported Protocol Version */
+			*pConnackRc = MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR;
+			break;
+		case 0x85: /* Client Identifier not valid */
+			*pConnackRc = MQTT_CONNACK_IDENTIFIER_REJECTED_ERROR;
+			break;
+		case 0x86: /* Bad User Name or Password */
+			*pConnackRc = MQTT_CONNACK_BAD_USERDATA_ERROR;
+			break;
+		case 0x87: /* Not authorized */
+		case 0x8A: /* Banned */
+			*pConnackRc = MQTT_CONNACK_NOT_AUTHORIZED_ERROR;
+			break;
+		case 0x88: /* Server unavailable */
+		case 0x89: /* Server busy */
+		case 0x9C: /* Use another server */
+		case 0x9D: /* Server moved */
+		case 0x9F: /* Connection rate exceeded */
+			*pConnackRc = MQTT_CONNACK_SERVER_UNAVAILABLE_ERROR;
+			break;
+		default:
+			*pConnackRc = MQTT_CONNACK_UNKNOWN_ERROR;
+			break;
+	}
+
+	if(curdata == enddata) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	rc = aws_iot_mqtt_internal_decode_remaining_length_from_buffer(curdata, &decodedLen, &readBytesLen);
+	if(SUCCESS != rc || (uint32_t) (enddata - curdata) < readBytesLen + decodedLen) {
+		FUNC_EXIT_RC(MQTT_DECODE_REMAINING_LENGTH_ERROR);
+	}
+	propdata = curdata + readBytesLen;
+	enddata = propdata + decodedLen;
+
+	while(propdata < enddata) {
+		rc = aws_iot_mqtt_internal_mqtt5_read_property(&propdata, enddata, &propertyId, &value);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+
+		switch(propertyId) {
+			case MQTT5_PROPERTY_RECEIVE_MAXIMUM:
+				if(0 == value) {
+					FUNC_EXIT_RC(FAILURE);
+				}
+				pClient->clientData.serverReceiveMax = value;
+				break;
+			case MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM:
+				pClient->clientData.topicAliasMax = (uint16_t) ((value < AWS_IOT_MQTT5_TOPIC_ALIASES) ?
+																value : AWS_IOT_MQTT5_TOPIC_ALIASES);
+				break;
+			case MQTT5_PROPERTY_SERVER_KEEP_ALIVE:
+				/* The server's keep alive replaces the one the client asked for */
+				pClient->clientData.keepAliveInterval = (uint16_t) value;
+				break;
+			default:
+				break;
+		}
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+#endif
+
 /**
  * @brief Check if client state is valid for a connect request
  *
@@ -362,6 +532,118 @@ static bool _aws_iot_mqtt_is_client_state_valid_for_connect(ClientState clientSt
 	return isValid;
 }
 
+/**
+ * @brief Count the messages of the session store
+ *
+ * The store has no count of its own, each message is loaded into the write buffer.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pCount Number of stored messages
+ *
+ * @return SUCCESS or the error of locking the write buffer or of the store
+ */
+static IoT_Error_t _aws_iot_mqtt_count_session(AWS_IoT_Client *pClient, uint32_t *pCount) {
+	const IoT_MQTT_Session_Store *pStore = pClient->clientData.pSessionStore;
+	uint16_t packetId;
+	size_t len;
+	IoT_Error_t rc;
+
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	for(*pCount = 0; ; ++(*pCount)) {
+		len = 0;
+		rc = pStore->load(pStore->pContext, *pCount, &packetId, pClient->clientData.writeBuf,
+						  pClient->clientData.writeBufSize - 1, &len);
+		if(SUCCESS != rc || 0 == len) {
+			break;
+		}
+	}
+
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+	return rc;
+}
+
+/**
+ * @brief Send the unacknowledged QoS1 messages of the session store again
+ *
+ * Called right after the CONNACK, before anything else is sent on the connection.
+ * Messages go out in the order the store returns them, with the DUP flag set. On an
+ * MQTT 5 connection no more are sent than the server's Receive Maximum allows, the
+ * rest wait for PUBACKs of the first ones.
+ *
+ * A PUBACK removes a message that was already resent, and the store closes the gap,
+ * so the ones still to send move up by as many as were removed during the wait.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTimer Timer for the network writes
+ *
+ * @return An IoT Error Type defining successful/failed retransmission
+ */
+static IoT_Error_t _aws_iot_mqtt_resend_session(AWS_IoT_Client *pClient, Timer *pTimer) {
+	const IoT_MQTT_Session_Store *pStore = pClient->clientData.pSessionStore;
+	uint32_t index;
+	uint32_t storedBefore, storedAfter;
+	uint16_t packetId;
+	size_t len;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	for(index = 0; ; ++index) {
+		while(!aws_iot_mqtt_internal_mqtt5_take_send_quota(pClient)) {
+			rc = _aws_iot_mqtt_count_session(pClient, &storedBefore);
+			if(SUCCESS == rc) {
+				rc = aws_iot_mqtt_internal_wait_for_read(pClient, PUBACK, pTimer);
+			}
+			if(SUCCESS == rc) {
+				rc = _aws_iot_mqtt_count_session(pClient, &storedAfter);
+			}
+			if(SUCCESS != rc) {
+				FUNC_EXIT_RC(rc);
+			}
+			/* Only resent messages are acknowledged, those are all before index */
+			if(storedBefore > storedAfter) {
+				index -= (storedBefore - storedAfter < index) ? storedBefore - storedAfter : index;
+			}
+		}
+
+		rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+		if(SUCCESS != rc) {
+			break;
+		}
+
+		len = 0;
+		rc = pStore->load(pStore->pContext, index, &packetId, pClient->clientData.writeBuf,
+						  pClient->clientData.writeBufSize - 1, &len);
+		if(SUCCESS != rc || 0 == len) {
+			(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+			break;
+		}
+
+		/* Keep new packet ids clear of the stored ones, they may come from before a reboot.
+		 * Ids wrap around, one less than half the id space ahead counts as newer */
+		if(0 < (int16_t) (packetId - pClient->clientData.nextPacketId)) {
+			pClient->clientData.nextPacketId = packetId;
+		}
+
+		pClient->clientData.writeBuf[0] |= 0x08;
+		IOT_TRACE_EVENT(IOT_TRACE_PUBLISH, pClient, 0x10000 | packetId);
+		rc = aws_iot_mqtt_internal_send_packet(pClient, len, pTimer);
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+		if(SUCCESS != rc) {
+			break;
+		}
+	}
+
+	/* The quota taken for the message that wasn't sent */
+	aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+
+	FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief MQTT Connection Function
  *
@@ -376,6 +658,9 @@ static bool _aws_iot_mqtt_is_client_state_valid_for_connect(ClientState clientSt
  */
 static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, const IoT_Client_Connect_Params *pConnectParams) {
 	Timer connect_timer;
+#ifndef DISABLE_IOT_STATS
+	Timer stopwatch;
+#endif
 	IoT_Error_t connack_rc = FAILURE;
 	char sessionPresent = 0;
 	size_t len = 0;
@@ -390,24 +675,55 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, const
 		}
 	}
 
-	rc = pClient->networkStack.connect(&(pClient->networkStack), NULL);
+#ifndef DISABLE_IOT_STATS
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+#endif
+	IOT_TRACE_EVENT(IOT_TRACE_CONNECT, pClient, 0);
+	rc = aws_iot_mqtt_internal_network_connect(pClient);
+	IOT_TRACE_EVENT(IOT_TRACE_NETWORK_CONNECT, pClient, rc);
 	if(SUCCESS != rc) {
 		/* TLS Connect failed, return error */
 		FUNC_EXIT_RC(rc);
 	}
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_record(pClient, &(pClient->clientData.stats.handshake),
+									   elapsed_ms(&stopwatch));
+#endif
+
+	/* Bytes left over from a previous connection must not be framed on this one */
+	aws_iot_mqtt_internal_flushBuffers(pClient);
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	/* Nor may packets collected for the previous one be sent on it */
+	pClient->clientData.coalesceLen = 0;
+#endif
 
 	init_timer(&connect_timer);
 	countdown_ms(&connect_timer, pClient->clientData.commandTimeoutMs);
 
 	pClient->clientData.keepAliveInterval = pClient->clientData.options.keepAliveIntervalInSec;
+#ifdef ENABLE_IOT_MQTT5
+	aws_iot_mqtt_internal_mqtt5_reset(pClient);
+#endif
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
 	rc = _aws_iot_mqtt_serialize_connect(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
-										 &(pClient->clientData.options), &len);
+										 &(pClient->clientData.options),
+										 (uint32_t) (pClient->clientData.readBufSize - 1), &len);
 	if(SUCCESS != rc || 0 >= len) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* send the connect packet */
+#ifndef DISABLE_IOT_STATS
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+#endif
 	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &connect_timer);
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -419,15 +735,34 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, const
 	}
 
 	/* Received CONNACK, check the return code */
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		rc = _aws_iot_mqtt5_deserialize_connack(pClient, (unsigned char *) &sessionPresent, &connack_rc);
+	} else
+#endif
 	rc = _aws_iot_mqtt_deserialize_connack((unsigned char *) &sessionPresent, &connack_rc, pClient->clientData.readBuf,
 										   pClient->clientData.readBufSize);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+	IOT_TRACE_EVENT(IOT_TRACE_CONNACK, pClient, connack_rc);
 
 	if(MQTT_CONNACK_CONNECTION_ACCEPTED != connack_rc) {
 		FUNC_EXIT_RC(connack_rc);
 	}
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_record(pClient, &(pClient->clientData.stats.connack),
+									   elapsed_ms(&stopwatch));
+#endif
+
+	pClient->clientStatus.isSessionPresent = (0 != sessionPresent);
+
+	if(NULL != pClient->clientData.pSessionStore) {
+		rc = _aws_iot_mqtt_resend_session(pClient, &connect_timer);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+	}
 
 	/* Ensure that a ping request is sent after keepAliveInterval. */
 	pClient->clientStatus.isPingOutstanding = false;
@@ -456,7 +791,7 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, const IoT_Client_Conne
 	if(NULL == pClient) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
-    aws_iot_mqtt_internal_flushBuffers( pClient );
+
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 
 	if(false == _aws_iot_mqtt_is_client_state_valid_for_connect(clientState)) {
@@ -470,8 +805,7 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, const IoT_Client_Conne
     
 	if(SUCCESS != rc) {
 		
-		pClient->networkStack.disconnect(&(pClient->networkStack));
-		disconRc = pClient->networkStack.destroy(&(pClient->networkStack));
+		disconRc = aws_iot_mqtt_internal_network_close(pClient);
 		if (SUCCESS != disconRc) {
 			
 			FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
@@ -504,10 +838,15 @@ static IoT_Error_t _aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 
 	FUNC_ENTRY;
 
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
 	rc = aws_iot_mqtt_internal_serialize_zero(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
 											  DISCONNECT,
 											  &serialized_len);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
@@ -518,10 +857,10 @@ static IoT_Error_t _aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 	if(serialized_len > 0) {
 		(void)aws_iot_mqtt_internal_send_packet(pClient, serialized_len, &timer);
 	}
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 
 	/* Clean network stack */
-	pClient->networkStack.disconnect(&(pClient->networkStack));
-	rc = pClient->networkStack.destroy(&(pClient->networkStack));
+	rc = aws_iot_mqtt_internal_network_close(pClient);
 	if(SUCCESS != rc) {
 		/* TLS Destroy failed, return error */
 		FUNC_EXIT_RC(FAILURE);
@@ -551,6 +890,15 @@ IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(rc);
 	}
 
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* Let publishers waiting for a PUBACK see the client is going away */
+	aws_iot_mqtt_internal_wake_ack_waiters(pClient);
+#endif
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	/* Unacknowledged messages are sent again on the next connection */
+	aws_iot_mqtt_internal_publish_queue_disconnected(pClient, false);
+#endif
+
 	rc = _aws_iot_mqtt_internal_disconnect(pClient);
 
 	if(SUCCESS != rc) {
@@ -559,6 +907,7 @@ IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
 		/* If called from Keepalive, this gets set to CLIENT_STATE_DISCONNECTED_ERROR */
 		pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_MANUALLY;
 	}
+	IOT_TRACE_EVENT(IOT_TRACE_DISCONNECT, pClient, rc);
 
 	FUNC_EXIT_RC(rc);
 }
@@ -591,6 +940,11 @@ IoT_Error_t aws_iot_mqtt_attempt_reconnect(AWS_IoT_Client *pClient) {
 		}
 	}
 
+	/* A resumed session still has the subscriptions */
+	if(pClient->clientStatus.isSessionPresent) {
+		FUNC_EXIT_RC(NETWORK_RECONNECTED);
+	}
+
 	rc = aws_iot_mqtt_resubscribe(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(NETWORK_ATTEMPTING_RECONNECT);
@@ -0,0 +1,381 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_dispatch.c
+ * @brief MQTT client dispatch of received messages to worker tasks
+ *
+ * The task reading the network copies messages of dispatched subscriptions into a
+ * statically allocated pool of slots and queues them per subscription. Worker tasks
+ * take the oldest message of a subscription no other worker is busy with, so each
+ * subscription sees its messages in order while different subscriptions run in
+ * parallel. The reader only ever waits for a worker under DISPATCH_BLOCK, and then
+ * for at most AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client_common_internal.h"
+
+#ifdef ENABLE_IOT_DISPATCH_POOL
+
+static void _aws_iot_mqtt_dispatch_lock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.dispatch_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+static void _aws_iot_mqtt_dispatch_unlock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.dispatch_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Count a received message that won't reach its handler
+ *
+ * Only called by the task reading the network.
+ *
+ * @param pClient MQTT client
+ */
+static void _aws_iot_mqtt_dispatch_dropped(AWS_IoT_Client *pClient) {
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_dropped_dispatch(pClient);
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Take the oldest waiting message off a queue
+ *
+ * Must be called with the dispatch mutex held and the queue not empty.
+ *
+ * @param pQueue Queue of a subscription
+ *
+ * @return Index of the message's slot
+ */
+static uint8_t _aws_iot_mqtt_dispatch_pop(DispatchQueue *pQueue) {
+	uint8_t slotIndex = pQueue->slots[pQueue->head];
+
+	pQueue->head = (uint8_t) ((pQueue->head + 1) % AWS_IOT_MQTT_DISPATCH_QUEUE_LEN);
+	pQueue->count--;
+
+	return slotIndex;
+}
+
+/**
+ * @brief Find a subscription with a message a worker may handle now
+ *
+ * Must be called with the dispatch mutex held. Starts at the queue after the one served
+ * last, so one busy subscription can't starve the others.
+ *
+ * @param pClient MQTT client
+ *
+ * @return Index of the queue, -1 if there is none
+ */
+static int32_t _aws_iot_mqtt_dispatch_next(AWS_IoT_Client *pClient) {
+	uint32_t itr, queueIndex;
+	DispatchQueue *pQueue;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
+		queueIndex = (pClient->clientData.dispatchNextQueue + itr) % AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS;
+		pQueue = &(pClient->clientData.dispatchQueues[queueIndex]);
+		if(0 < pQueue->count && !pQueue->isBusy) {
+			return (int32_t) queueIndex;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Set up the dispatch pool of a client
+ *
+ * All subscriptions start out with DISPATCH_INLINE.
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex and semaphore initialization
+ */
+IoT_Error_t aws_iot_mqtt_internal_init_dispatch(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_DISPATCH_SLOTS; ++itr) {
+		pClient->clientData.dispatchFree[itr] = (uint8_t) itr;
+	}
+	pClient->clientData.dispatchFreeCount = AWS_IOT_MQTT_DISPATCH_SLOTS;
+	pClient->clientData.dispatchNextQueue = 0;
+	memset(pClient->clientData.dispatchQueues, 0, sizeof(pClient->clientData.dispatchQueues));
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_thread_mutex_init(&(pClient->clientData.dispatch_mutex));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+	rc = aws_iot_thread_semaphore_init(&(pClient->clientData.dispatchWorkSem));
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.dispatch_mutex));
+		FUNC_EXIT_RC(rc);
+	}
+	rc = aws_iot_thread_semaphore_init(&(pClient->clientData.dispatchSpaceSem));
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_semaphore_destroy(&(pClient->clientData.dispatchWorkSem));
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.dispatch_mutex));
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Release the resources of the dispatch pool
+ *
+ * No worker may be running @ref aws_iot_mqtt_dispatch_run any more.
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_destroy_dispatch(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_semaphore_destroy(&(pClient->clientData.dispatchSpaceSem));
+	(void)aws_iot_thread_semaphore_destroy(&(pClient->clientData.dispatchWorkSem));
+	(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.dispatch_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Queue a received message for the workers
+ *
+ * Called by the task reading the network, while the message is still in the read buffer.
+ * Applies the subscription's overflow policy when its queue is full or no slot is free.
+ *
+ * @param pClient MQTT client
+ * @param handlerIndex Message handler of the subscription the message matched
+ * @param pTopicName Topic the message was published to
+ * @param topicNameLen Length of the topic
+ * @param pParams The message
+ */
+void aws_iot_mqtt_internal_dispatch_message(AWS_IoT_Client *pClient, uint32_t handlerIndex, const char *pTopicName,
+											uint16_t topicNameLen, const IoT_Publish_Message_Params *pParams) {
+	DispatchQueue *pQueue = &(pClient->clientData.dispatchQueues[handlerIndex]);
+	DispatchSlot *pSlot;
+	uint8_t slotIndex;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	Timer blockTimer;
+	bool isBlocking = false;
+#endif
+
+	if((size_t) topicNameLen + pParams->payloadLen > AWS_IOT_MQTT_DISPATCH_SLOT_LEN) {
+		IOT_WARN("Message of %u bytes doesn't fit a dispatch slot, dropped", (unsigned int) pParams->payloadLen);
+		_aws_iot_mqtt_dispatch_dropped(pClient);
+		return;
+	}
+
+	_aws_iot_mqtt_dispatch_lock(pClient);
+	for(;;) {
+		if(AWS_IOT_MQTT_DISPATCH_QUEUE_LEN > pQueue->count && 0 < pClient->clientData.dispatchFreeCount) {
+			pClient->clientData.dispatchFreeCount--;
+			slotIndex = pClient->clientData.dispatchFree[pClient->clientData.dispatchFreeCount];
+			break;
+		}
+
+		if(DISPATCH_DROP_OLDEST == pQueue->policy && 0 < pQueue->count) {
+			/* The oldest waiting message gives up its slot */
+			slotIndex = _aws_iot_mqtt_dispatch_pop(pQueue);
+			_aws_iot_mqtt_dispatch_dropped(pClient);
+			break;
+		}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+		if(DISPATCH_BLOCK == pQueue->policy) {
+			if(!isBlocking) {
+				init_timer(&blockTimer);
+				countdown_ms(&blockTimer, AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS);
+				isBlocking = true;
+			}
+			if(!has_timer_expired(&blockTimer)) {
+				_aws_iot_mqtt_dispatch_unlock(pClient);
+				(void)aws_iot_thread_semaphore_wait(&(pClient->clientData.dispatchSpaceSem), left_ms(&blockTimer));
+				_aws_iot_mqtt_dispatch_lock(pClient);
+				continue;
+			}
+		}
+#endif
+
+		/* DISPATCH_DROP_NEWEST, or nothing left to make room with */
+		_aws_iot_mqtt_dispatch_unlock(pClient);
+		_aws_iot_mqtt_dispatch_dropped(pClient);
+		return;
+	}
+
+	pSlot = &(pClient->clientData.dispatchSlots[slotIndex]);
+	pSlot->pApplicationHandler = pClient->clientData.messageHandlers[handlerIndex].pApplicationHandler;
+	pSlot->pApplicationHandlerData = pClient->clientData.messageHandlers[handlerIndex].pApplicationHandlerData;
+	pSlot->topicNameLen = topicNameLen;
+	memcpy(pSlot->buf, pTopicName, topicNameLen);
+	memcpy(&(pSlot->buf[topicNameLen]), pParams->payload, pParams->payloadLen);
+	pSlot->params = *pParams;
+	pSlot->params.payload = &(pSlot->buf[topicNameLen]);
+
+	pQueue->slots[(pQueue->head + pQueue->count) % AWS_IOT_MQTT_DISPATCH_QUEUE_LEN] = slotIndex;
+	pQueue->count++;
+	_aws_iot_mqtt_dispatch_unlock(pClient);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_semaphore_post(&(pClient->clientData.dispatchWorkSem));
+#endif
+}
+
+/**
+ * @brief Forget the waiting messages of a removed subscription
+ *
+ * The handler index may be reused by the next subscription, which starts out with
+ * DISPATCH_INLINE. A handler a worker is running right now completes normally.
+ *
+ * @param pClient MQTT client
+ * @param handlerIndex Message handler that was removed
+ */
+void aws_iot_mqtt_internal_dispatch_unsubscribed(AWS_IoT_Client *pClient, uint32_t handlerIndex) {
+	DispatchQueue *pQueue = &(pClient->clientData.dispatchQueues[handlerIndex]);
+
+	_aws_iot_mqtt_dispatch_lock(pClient);
+	while(0 < pQueue->count) {
+		pClient->clientData.dispatchFree[pClient->clientData.dispatchFreeCount] = _aws_iot_mqtt_dispatch_pop(pQueue);
+		pClient->clientData.dispatchFreeCount++;
+	}
+	pQueue->policy = DISPATCH_INLINE;
+	_aws_iot_mqtt_dispatch_unlock(pClient);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_semaphore_post(&(pClient->clientData.dispatchSpaceSem));
+#endif
+}
+
+IoT_Error_t aws_iot_mqtt_set_dispatch_policy(AWS_IoT_Client *pClient, const char *pTopicName,
+											 uint16_t topicNameLen, IoT_Dispatch_Policy policy) {
+	uint32_t itr;
+	IoT_Error_t rc = FAILURE;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	_aws_iot_mqtt_dispatch_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
+		if(NULL != pClient->clientData.messageHandlers[itr].topicName
+		   && topicNameLen == pClient->clientData.messageHandlers[itr].topicNameLen
+		   && 0 == strncmp(pTopicName, pClient->clientData.messageHandlers[itr].topicName, topicNameLen)) {
+			pClient->clientData.dispatchQueues[itr].policy = policy;
+			rc = SUCCESS;
+		}
+	}
+	_aws_iot_mqtt_dispatch_unlock(pClient);
+
+	FUNC_EXIT_RC(rc);
+}
+
+IoT_Error_t aws_iot_mqtt_dispatch_run(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
+	Timer timer;
+	int32_t queueIndex;
+	uint8_t slotIndex;
+	DispatchQueue *pQueue;
+	DispatchSlot *pSlot;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	bool isMoreWork;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeout_ms);
+
+	do {
+		_aws_iot_mqtt_dispatch_lock(pClient);
+		queueIndex = _aws_iot_mqtt_dispatch_next(pClient);
+		if(0 > queueIndex) {
+			_aws_iot_mqtt_dispatch_unlock(pClient);
+#ifdef _ENABLE_THREAD_SUPPORT_
+			(void)aws_iot_thread_semaphore_wait(&(pClient->clientData.dispatchWorkSem), left_ms(&timer));
+			continue;
+#else
+			break;
+#endif
+		}
+
+		pQueue = &(pClient->clientData.dispatchQueues[queueIndex]);
+		slotIndex = _aws_iot_mqtt_dispatch_pop(pQueue);
+		pQueue->isBusy = true;
+		pClient->clientData.dispatchNextQueue = (uint8_t) ((queueIndex + 1) % AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS);
+#ifdef _ENABLE_THREAD_SUPPORT_
+		isMoreWork = (0 <= _aws_iot_mqtt_dispatch_next(pClient));
+#endif
+		_aws_iot_mqtt_dispatch_unlock(pClient);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+		if(isMoreWork) {
+			/* Another subscription has messages, wake the next worker for it */
+			(void)aws_iot_thread_semaphore_post(&(pClient->clientData.dispatchWorkSem));
+		}
+#endif
+
+		pSlot = &(pClient->clientData.dispatchSlots[slotIndex]);
+		pSlot->pApplicationHandler(pClient, (char *) pSlot->buf, pSlot->topicNameLen, &(pSlot->params),
+								   pSlot->pApplicationHandlerData);
+
+		_aws_iot_mqtt_dispatch_lock(pClient);
+		pClient->clientData.dispatchFree[pClient->clientData.dispatchFreeCount] = slotIndex;
+		pClient->clientData.dispatchFreeCount++;
+		pQueue->isBusy = false;
+#ifdef _ENABLE_THREAD_SUPPORT_
+		isMoreWork = (0 <= _aws_iot_mqtt_dispatch_next(pClient));
+#endif
+		_aws_iot_mqtt_dispatch_unlock(pClient);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+		(void)aws_iot_thread_semaphore_post(&(pClient->clientData.dispatchSpaceSem));
+		if(isMoreWork) {
+			/* Messages queued for this subscription while its handler ran were posted to
+			 * workers that found it busy, one of them has to look again */
+			(void)aws_iot_thread_semaphore_post(&(pClient->clientData.dispatchWorkSem));
+		}
+#endif
+	} while(!has_timer_expired(&timer));
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,368 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_mqtt5.c
+ * @brief MQTT 5 properties, topic aliases and flow control
+ *
+ * MQTT 5 packets keep the 3.1.1 layout and add a block of properties. The client only
+ * interprets the few properties it acts on and skips the others. Topic aliases are
+ * bound to the first topics published on a connection and never rebound, so a
+ * PUBLISH either carries its topic or an alias the server has already seen on the
+ * same connection.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client_common_internal.h"
+
+#ifdef ENABLE_IOT_MQTT5
+
+/** Receive maximum assumed when the CONNACK doesn't announce one */
+#define MQTT5_DEFAULT_RECEIVE_MAXIMUM 65535
+
+/**
+ * @brief Forget what was negotiated on the previous connection
+ *
+ * Called before each CONNECT. Topic aliases and the send quota only live as long as
+ * the network connection.
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_mqtt5_reset(AWS_IoT_Client *pClient) {
+	pClient->clientData.serverReceiveMax = MQTT5_DEFAULT_RECEIVE_MAXIMUM;
+	__atomic_store_n(&(pClient->clientData.inflightPublishes), 0, __ATOMIC_RELAXED);
+	pClient->clientData.topicAliasMax = 0;
+	pClient->clientData.topicAliasCount = 0;
+	pClient->clientStatus.lastReasonCode = 0;
+}
+
+/**
+ * Writes a four byte integer as 4 bytes to an output buffer.
+ * @param pptr pointer to the output buffer - incremented by the number of bytes used & returned
+ * @param anInt the integer to write
+ */
+void aws_iot_mqtt_internal_write_uint_32(unsigned char **pptr, uint32_t anInt) {
+	**pptr = (unsigned char) (anInt >> 24);
+	(*pptr)++;
+	**pptr = (unsigned char) ((anInt >> 16) & 0xFF);
+	(*pptr)++;
+	**pptr = (unsigned char) ((anInt >> 8) & 0xFF);
+	(*pptr)++;
+	**pptr = (unsigned char) (anInt & 0xFF);
+	(*pptr)++;
+}
+
+/**
+ * @brief Read one property
+ *
+ * @param pptr Start of the property, advanced past it
+ * @param pEnd End of the property block
+ * @param pPropertyId Returns the property identifier
+ * @param pValue Returns the value of integer properties, 0 for the others
+ *
+ * @return SUCCESS, or FAILURE for an unknown or truncated property
+ */
+IoT_Error_t aws_iot_mqtt_internal_mqtt5_read_property(unsigned char **pptr, unsigned char *pEnd,
+													  uint8_t *pPropertyId, uint32_t *pValue) {
+	unsigned char *ptr = *pptr;
+	uint32_t len, readBytesLen, strings, itr;
+	IoT_Error_t rc;
+
+	if(ptr >= pEnd) {
+		return FAILURE;
+	}
+
+	*pPropertyId = aws_iot_mqtt_internal_read_char(&ptr);
+	*pValue = 0;
+
+	switch(*pPropertyId) {
+		case 0x01: /* Payload Format Indicator */
+		case 0x17: /* Request Problem Information */
+		case 0x19: /* Request Response Information */
+		case 0x24: /* Maximum QoS */
+		case 0x25: /* Retain Available */
+		case 0x28: /* Wildcard Subscription Available */
+		case 0x29: /* Subscription Identifier Available */
+		case 0x2A: /* Shared Subscription Available */
+			if(pEnd - ptr < 1) {
+				return FAILURE;
+			}
+			*pValue = aws_iot_mqtt_internal_read_char(&ptr);
+			break;
+		case MQTT5_PROPERTY_SERVER_KEEP_ALIVE:
+		case MQTT5_PROPERTY_RECEIVE_MAXIMUM:
+		case MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM:
+		case MQTT5_PROPERTY_TOPIC_ALIAS:
+			if(pEnd - ptr < 2) {
+				return FAILURE;
+			}
+			*pValue = aws_iot_mqtt_internal_read_uint16_t(&ptr);
+			break;
+		case 0x02: /* Message Expiry Interval */
+		case MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL:
+		case 0x18: /* Will Delay Interval */
+		case MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE:
+			if(pEnd - ptr < 4) {
+				return FAILURE;
+			}
+			*pValue = ((uint32_t) aws_iot_mqtt_internal_read_uint16_t(&ptr)) << 16;
+			*pValue |= aws_iot_mqtt_internal_read_uint16_t(&ptr);
+			break;
+		case 0x0B: /* Subscription Identifier */
+			if(pEnd - ptr < 1) {
+				return FAILURE;
+			}
+			rc = aws_iot_mqtt_internal_decode_remaining_length_from_buffer(ptr, pValue, &readBytesLen);
+			if(SUCCESS != rc || (uint32_t) (pEnd - ptr) < readBytesLen) {
+				return FAILURE;
+			}
+			ptr += readBytesLen;
+			break;
+		case 0x03: /* Content Type */
+		case 0x08: /* Response Topic */
+		case 0x09: /* Correlation Data */
+		case 0x12: /* Assigned Client Identifier */
+		case 0x15: /* Authentication Method */
+		case 0x16: /* Authentication Data */
+		case 0x1A: /* Response Information */
+		case 0x1C: /* Server Reference */
+		case 0x1F: /* Reason String */
+		case 0x26: /* User Property, a pair of strings */
+			strings = (0x26 == *pPropertyId) ? 2 : 1;
+			for(itr = 0; itr < strings; ++itr) {
+				if(pEnd - ptr < 2) {
+					return FAILURE;
+				}
+				len = aws_iot_mqtt_internal_read_uint16_t(&ptr);
+				if((uint32_t) (pEnd - ptr) < len) {
+					return FAILURE;
+				}
+				ptr += len;
+			}
+			break;
+		default:
+			return FAILURE;
+	}
+
+	*pptr = ptr;
+	return SUCCESS;
+}
+
+/**
+ * @brief Step over a property block
+ *
+ * @param pptr Start of the property length, advanced past the properties
+ * @param pEnd End of the packet
+ *
+ * @return SUCCESS, or FAILURE if the block runs past the end of the packet
+ */
+IoT_Error_t aws_iot_mqtt_internal_mqtt5_skip_properties(unsigned char **pptr, unsigned char *pEnd) {
+	uint32_t propertiesLen, readBytesLen;
+	IoT_Error_t rc;
+
+	if(*pptr >= pEnd) {
+		return FAILURE;
+	}
+
+	rc = aws_iot_mqtt_internal_decode_remaining_length_from_buffer(*pptr, &propertiesLen, &readBytesLen);
+	if(SUCCESS != rc || (uint32_t) (pEnd - *pptr) < readBytesLen + propertiesLen) {
+		return FAILURE;
+	}
+
+	*pptr += readBytesLen + propertiesLen;
+	return SUCCESS;
+}
+
+/**
+ * @brief Reason code of a received acknowledgement or DISCONNECT
+ *
+ * A PUBACK or DISCONNECT without a reason code means Success. SUBACK and UNSUBACK
+ * carry one reason code per topic, the first one is returned.
+ *
+ * @param pRxBuf The packet
+ *
+ * @return The reason code, MQTT5_REASON_MALFORMED_PACKET if the packet is cut short
+ */
+uint8_t aws_iot_mqtt_internal_mqtt5_reason_code(unsigned char *pRxBuf) {
+	unsigned char *curData = pRxBuf;
+	unsigned char *endData;
+	uint32_t decodedLen = 0;
+	uint32_t readBytesLen = 0;
+	uint8_t packetType;
+
+	packetType = MQTT_HEADER_FIELD_TYPE(aws_iot_mqtt_internal_read_char(&curData));
+	if(SUCCESS != aws_iot_mqtt_internal_decode_remaining_length_from_buffer(curData, &decodedLen, &readBytesLen)) {
+		return MQTT5_REASON_MALFORMED_PACKET;
+	}
+	curData += readBytesLen;
+	endData = curData + decodedLen;
+
+	if(DISCONNECT == packetType) {
+		return (curData < endData) ? *curData : 0;
+	}
+
+	/* Everything else starts with the packet identifier */
+	if(endData - curData < 2) {
+		return MQTT5_REASON_MALFORMED_PACKET;
+	}
+	curData += 2;
+
+	if(PUBACK == packetType) {
+		return (curData < endData) ? *curData : 0;
+	}
+
+	if(SUCCESS != aws_iot_mqtt_internal_mqtt5_skip_properties(&curData, endData) || curData >= endData) {
+		return MQTT5_REASON_MALFORMED_PACKET;
+	}
+
+	return *curData;
+}
+
+/**
+ * @brief Alias the server already knows for a topic
+ *
+ * Must be called with the write buffer locked.
+ *
+ * @param pClient MQTT client
+ * @param pTopicName Topic name
+ * @param topicNameLen Length of the topic name
+ *
+ * @return The alias, 0 if the topic has none on this connection
+ */
+uint16_t aws_iot_mqtt_internal_mqtt5_find_topic_alias(AWS_IoT_Client *pClient, const char *pTopicName,
+													  uint16_t topicNameLen) {
+	uint16_t itr;
+	const Mqtt5TopicAlias *pAlias;
+
+	for(itr = 0; itr < pClient->clientData.topicAliasCount; ++itr) {
+		pAlias = &(pClient->clientData.topicAliases[itr]);
+		if(topicNameLen == pAlias->topicNameLen && 0 == memcmp(pTopicName, pAlias->topicName, topicNameLen)) {
+			return (uint16_t) (itr + 1);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Bind a topic to the next free alias
+ *
+ * The PUBLISH serialized next must carry both the topic and the alias. Must be called
+ * with the write buffer locked.
+ *
+ * @param pClient MQTT client
+ * @param pTopicName Topic name
+ * @param topicNameLen Length of the topic name
+ *
+ * @return The new alias, 0 if the aliases of this connection are used up or the topic is too long
+ */
+uint16_t aws_iot_mqtt_internal_mqtt5_bind_topic_alias(AWS_IoT_Client *pClient, const char *pTopicName,
+													  uint16_t topicNameLen) {
+	Mqtt5TopicAlias *pAlias;
+
+	if(pClient->clientData.topicAliasCount >= pClient->clientData.topicAliasMax
+	   || topicNameLen > AWS_IOT_MQTT5_TOPIC_ALIAS_LEN) {
+		return 0;
+	}
+
+	pAlias = &(pClient->clientData.topicAliases[pClient->clientData.topicAliasCount]);
+	memcpy(pAlias->topicName, pTopicName, topicNameLen);
+	pAlias->topicNameLen = topicNameLen;
+
+	return ++(pClient->clientData.topicAliasCount);
+}
+
+/**
+ * @brief Count a QoS1 publish against the server's receive maximum
+ *
+ * Publishers and the reader update the count without a common lock. Does nothing
+ * on an MQTT 3.1.1 connection.
+ *
+ * @param pClient MQTT client
+ *
+ * @return false if the server has as many unacknowledged publishes as it accepts
+ */
+bool aws_iot_mqtt_internal_mqtt5_take_send_quota(AWS_IoT_Client *pClient) {
+	uint32_t inflight;
+
+	if(!AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		return true;
+	}
+
+	inflight = __atomic_load_n(&(pClient->clientData.inflightPublishes), __ATOMIC_RELAXED);
+	do {
+		if(inflight >= pClient->clientData.serverReceiveMax) {
+			return false;
+		}
+	} while(!__atomic_compare_exchange_n(&(pClient->clientData.inflightPublishes), &inflight, inflight + 1, true,
+										 __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return true;
+}
+
+/**
+ * @brief Release the quota of an acknowledged or unsent QoS1 publish
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_mqtt5_give_send_quota(AWS_IoT_Client *pClient) {
+	uint32_t inflight;
+
+	if(!AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		return;
+	}
+
+	/* A late PUBACK of a publish from before the last reset must not wrap the count */
+	inflight = __atomic_load_n(&(pClient->clientData.inflightPublishes), __ATOMIC_RELAXED);
+	do {
+		if(0 == inflight) {
+			return;
+		}
+	} while(!__atomic_compare_exchange_n(&(pClient->clientData.inflightPublishes), &inflight, inflight - 1, true,
+										 __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Check whether a QoS1 publish could be sent now
+ *
+ * @param pClient MQTT client
+ *
+ * @return true unless the server's receive maximum is reached
+ */
+bool aws_iot_mqtt_internal_mqtt5_has_send_quota(AWS_IoT_Client *pClient) {
+	if(!AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		return true;
+	}
+
+	return __atomic_load_n(&(pClient->clientData.inflightPublishes), __ATOMIC_RELAXED)
+		   < pClient->clientData.serverReceiveMax;
+}
+
+uint8_t aws_iot_mqtt_get_last_reason_code(AWS_IoT_Client *pClient) {
+	if(NULL == pClient) {
+		return MQTT5_REASON_FAILURE;
+	}
+
+	return pClient->clientStatus.lastReasonCode;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -69,61 +69,168 @@ static IoT_Error_t _aws_iot_mqtt_read_string_with_len(char **stringVar, uint16_t
 }
 
 /**
-  * Serializes the supplied publish data into the supplied buffer, ready for sending
+  * Encodes the parts of a publish that don't change from message to message
+  * @param pTemplate the template to fill in
+  * @param pTopicName char * - the MQTT topic in the publish
+  * @param topicNameLen uint16_t - the length of the Topic Name
+  * @param qos QoS - the MQTT QoS value
+  * @param retained uint8_t - the MQTT retained flag
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+static IoT_Error_t _aws_iot_mqtt_encode_publish_template(IoT_Publish_Template *pTemplate, const char *pTopicName,
+														 uint16_t topicNameLen, QoS qos, uint8_t retained) {
+	unsigned char *ptr;
+	IoT_Error_t rc;
+	MQTTHeader header = {0};
+
+	rc = aws_iot_mqtt_internal_init_header(&header, PUBLISH, qos, 0, retained);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	pTemplate->pTopicName = pTopicName;
+	pTemplate->topicNameLen = topicNameLen;
+	pTemplate->qos = qos;
+	pTemplate->header = header.byte;
+	ptr = pTemplate->topicNameLenBytes;
+	aws_iot_mqtt_internal_write_uint_16(&ptr, topicNameLen);
+
+	pTemplate->fixedRemLen = (uint32_t) topicNameLen + 2;
+	if(qos > 0) {
+		pTemplate->fixedRemLen += 2; /* packetId */
+	}
+
+	return SUCCESS;
+}
+
+/**
+  * Serializes a publish built from a template into the supplied buffer, ready for sending
   * @param pTxBuf the buffer into which the packet will be serialized
   * @param txBufLen the length in bytes of the supplied buffer
+  * @param pTemplate the encoded topic and flags
   * @param dup uint8_t - the MQTT dup flag
-  * @param qos QoS - the MQTT QoS value
-  * @param retained uint8_t - the MQTT retained flag
   * @param packetId uint16_t - the MQTT packet identifier
-  * @param pTopicName char * - the MQTT topic in the publish
-  * @param topicNameLen uint16_t - the length of the Topic Name
   * @param pPayload byte buffer - the MQTT publish payload
   * @param payloadLen size_t - the length of the MQTT payload
   * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
   *
   * @return An IoT Error Type defining successful/failed call
   */
-static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBuf, size_t txBufLen, uint8_t dup,
-															QoS qos, uint8_t retained, uint16_t packetId,
-															const char *pTopicName, uint16_t topicNameLen,
-															const unsigned char *pPayload, size_t payloadLen,
-															uint32_t *pSerializedLen) {
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish_template(unsigned char *pTxBuf, size_t txBufLen,
+															  const IoT_Publish_Template *pTemplate, uint8_t dup,
+															  uint16_t packetId, const unsigned char *pPayload,
+															  size_t payloadLen, uint32_t *pSerializedLen) {
 	unsigned char *ptr;
 	uint32_t rem_len;
-	IoT_Error_t rc;
-	MQTTHeader header = {0};
 
 	FUNC_ENTRY;
-	if(NULL == pTxBuf || NULL == pPayload || NULL == pSerializedLen) {
+	if(NULL == pTxBuf || NULL == pTemplate || NULL == pPayload || NULL == pSerializedLen) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
 	ptr = pTxBuf;
-	rem_len = 0;
+	rem_len = pTemplate->fixedRemLen + (uint32_t) payloadLen;
+	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) > txBufLen) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
 
-	rem_len += (uint32_t) (topicNameLen + payloadLen + 2);
-	if(qos > 0) {
-		rem_len += 2; /* packetId */
+	aws_iot_mqtt_internal_write_char(&ptr, (unsigned char) (pTemplate->header | (dup << 3))); /* write header */
+
+	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */;
+
+	*ptr++ = pTemplate->topicNameLenBytes[0];
+	*ptr++ = pTemplate->topicNameLenBytes[1];
+	memcpy(ptr, pTemplate->pTopicName, pTemplate->topicNameLen);
+	ptr += pTemplate->topicNameLen;
+
+	if(pTemplate->qos > 0) {
+		aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+	}
+
+	memcpy(ptr, pPayload, payloadLen);
+	ptr += payloadLen;
+
+	*pSerializedLen = (uint32_t) (ptr - pTxBuf);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#ifdef ENABLE_IOT_MQTT5
+/**
+  * Serializes an MQTT 5 publish built from a template. A topic with an alias on this
+  * connection is sent as an empty topic name and the alias, the first publish to a new
+  * topic binds it to a free alias.
+  * @param pClient the client the publish is sent on, with the write buffer locked
+  * @param pTxBuf the buffer into which the packet will be serialized
+  * @param txBufLen the length in bytes of the supplied buffer
+  * @param pTemplate the encoded topic and flags
+  * @param dup uint8_t - the MQTT dup flag
+  * @param packetId uint16_t - the MQTT packet identifier
+  * @param pPayload byte buffer - the MQTT publish payload
+  * @param payloadLen size_t - the length of the MQTT payload
+  * @param isAliasAllowed false to always write the topic, for a packet that may be sent
+  * again on a connection that doesn't know the alias
+  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+static IoT_Error_t _aws_iot_mqtt5_serialize_publish_template(AWS_IoT_Client *pClient, unsigned char *pTxBuf,
+															 size_t txBufLen, const IoT_Publish_Template *pTemplate,
+															 uint8_t dup, uint16_t packetId,
+															 const unsigned char *pPayload, size_t payloadLen,
+															 bool isAliasAllowed, uint32_t *pSerializedLen) {
+	unsigned char *ptr;
+	uint32_t rem_len;
+	uint16_t alias = 0;
+	uint16_t topicNameLen = pTemplate->topicNameLen;
+
+	FUNC_ENTRY;
+	if(NULL == pTxBuf || NULL == pPayload || NULL == pSerializedLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
+
+	/* Property length, plus the Topic Alias property unless it turns out there's none */
+	rem_len = pTemplate->fixedRemLen + 1 + 3 + (uint32_t) payloadLen;
+
+	if(isAliasAllowed) {
+		alias = aws_iot_mqtt_internal_mqtt5_find_topic_alias(pClient, pTemplate->pTopicName, topicNameLen);
+	}
+	if(0 != alias) {
+		topicNameLen = 0;
+		rem_len -= pTemplate->topicNameLen;
+	}
+
 	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) > txBufLen) {
 		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
 	}
 
-	rc = aws_iot_mqtt_internal_init_header(&header, PUBLISH, qos, dup, retained);
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
+	if(0 == alias && isAliasAllowed) {
+		alias = aws_iot_mqtt_internal_mqtt5_bind_topic_alias(pClient, pTemplate->pTopicName, topicNameLen);
 	}
-	aws_iot_mqtt_internal_write_char(&ptr, header.byte); /* write header */
+	if(0 == alias) {
+		rem_len -= 3;
+	}
+
+	ptr = pTxBuf;
+	aws_iot_mqtt_internal_write_char(&ptr, (unsigned char) (pTemplate->header | (dup << 3))); /* write header */
 
 	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */;
 
-	aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicName, topicNameLen);
+	aws_iot_mqtt_internal_write_utf8_string(&ptr, pTemplate->pTopicName, topicNameLen);
 
-	if(qos > 0) {
+	if(pTemplate->qos > 0) {
 		aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
 	}
 
+	if(0 != alias) {
+		aws_iot_mqtt_internal_write_char(&ptr, 3);
+		aws_iot_mqtt_internal_write_char(&ptr, MQTT5_PROPERTY_TOPIC_ALIAS);
+		aws_iot_mqtt_internal_write_uint_16(&ptr, alias);
+	} else {
+		aws_iot_mqtt_internal_write_char(&ptr, 0);
+	}
+
 	memcpy(ptr, pPayload, payloadLen);
 	ptr += payloadLen;
 
@@ -131,6 +238,77 @@ static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBu
 
 	FUNC_EXIT_RC(SUCCESS);
 }
+#endif
+
+/**
+  * Serializes a publish built from a template in the protocol version of the client
+  * @param pClient the client the publish is sent on, with the write buffer locked
+  * @param pTxBuf the buffer into which the packet will be serialized
+  * @param txBufLen the length in bytes of the supplied buffer
+  * @param pTemplate the encoded topic and flags
+  * @param dup uint8_t - the MQTT dup flag
+  * @param packetId uint16_t - the MQTT packet identifier
+  * @param pPayload byte buffer - the MQTT publish payload
+  * @param payloadLen size_t - the length of the MQTT payload
+  * @param isAliasAllowed false to always write the topic on an MQTT 5 connection
+  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+IoT_Error_t aws_iot_mqtt_internal_serialize_client_publish(AWS_IoT_Client *pClient, unsigned char *pTxBuf,
+															size_t txBufLen, const IoT_Publish_Template *pTemplate,
+															uint8_t dup, uint16_t packetId,
+															const unsigned char *pPayload, size_t payloadLen,
+															bool isAliasAllowed, uint32_t *pSerializedLen) {
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		return _aws_iot_mqtt5_serialize_publish_template(pClient, pTxBuf, txBufLen, pTemplate, dup, packetId,
+														 pPayload, payloadLen, isAliasAllowed, pSerializedLen);
+	}
+#else
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(isAliasAllowed);
+#endif
+
+	return aws_iot_mqtt_internal_serialize_publish_template(pTxBuf, txBufLen, pTemplate, dup, packetId, pPayload,
+														   payloadLen, pSerializedLen);
+}
+
+/**
+  * Serializes the supplied publish data into the supplied buffer, ready for sending
+  * @param pTxBuf the buffer into which the packet will be serialized
+  * @param txBufLen the length in bytes of the supplied buffer
+  * @param dup uint8_t - the MQTT dup flag
+  * @param qos QoS - the MQTT QoS value
+  * @param retained uint8_t - the MQTT retained flag
+  * @param packetId uint16_t - the MQTT packet identifier
+  * @param pTopicName char * - the MQTT topic in the publish
+  * @param topicNameLen uint16_t - the length of the Topic Name
+  * @param pPayload byte buffer - the MQTT publish payload
+  * @param payloadLen size_t - the length of the MQTT payload
+  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBuf, size_t txBufLen, uint8_t dup,
+													 QoS qos, uint8_t retained, uint16_t packetId,
+													 const char *pTopicName, uint16_t topicNameLen,
+													 const unsigned char *pPayload, size_t payloadLen,
+													 uint32_t *pSerializedLen) {
+	IoT_Publish_Template publishTemplate;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	rc = _aws_iot_mqtt_encode_publish_template(&publishTemplate, pTopicName, topicNameLen, qos, retained);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	rc = aws_iot_mqtt_internal_serialize_publish_template(pTxBuf, txBufLen, &publishTemplate, dup, packetId,
+														  pPayload, payloadLen, pSerializedLen);
+	FUNC_EXIT_RC(rc);
+}
 
 /**
   * Serializes the ack packet into the supplied buffer.
@@ -188,18 +366,25 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
  * Not meant to be called directly as it doesn't do validations or client state changes
  *
  * @param pClient Reference to the IoT Client
- * @param pTopicName Topic Name to publish to
- * @param topicNameLen Length of the topic name
- * @param pParams Pointer to Publish Message parameters
+ * @param pTemplate Encoded topic name and flags
+ * @param pPayload Message payload
+ * @param payloadLen Length of the payload
+ * @param pPacketId Returns the packet identifier of a QoS1 message
  *
  * @return An IoT Error Type defining successful/failed publish
  */
-static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const char *pTopicName,
-												  uint16_t topicNameLen, IoT_Publish_Message_Params *pParams) {
+static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const IoT_Publish_Template *pTemplate,
+												  const void *pPayload, size_t payloadLen, uint16_t *pPacketId) {
 	Timer timer;
 	uint32_t len = 0;
+	uint16_t id = 0;
+	bool isStored;
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	AckWaiter *pWaiter = NULL;
+#else
 	uint16_t packet_id;
 	unsigned char dup, type;
+#endif
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
@@ -207,26 +392,104 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 	init_timer(&timer);
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-	if(QOS1 == pParams->qos) {
-		pParams->id = aws_iot_mqtt_get_next_packet_id(pClient);
+	/* An MQTT 5 server takes no more unacknowledged QoS1 messages than its Receive Maximum */
+	if(QOS1 == pTemplate->qos && !aws_iot_mqtt_internal_mqtt5_take_send_quota(pClient)) {
+		FUNC_EXIT_RC(MQTT_RECEIVE_MAXIMUM_REACHED_ERROR);
 	}
 
-	rc = _aws_iot_mqtt_internal_serialize_publish(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-												  pParams->qos, pParams->isRetained, pParams->id, pTopicName,
-												  topicNameLen, (unsigned char *) pParams->payload,
-												  pParams->payloadLen, &len);
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
 	if(SUCCESS != rc) {
+		if(QOS1 == pTemplate->qos) {
+			aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+		}
 		FUNC_EXIT_RC(rc);
 	}
 
-	/* send the publish packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* The connection may have been lost or replaced while waiting for the write buffer */
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+		if(QOS1 == pTemplate->qos) {
+			aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+		}
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+#endif
+
+	if(QOS1 == pTemplate->qos) {
+		id = aws_iot_mqtt_get_next_packet_id(pClient);
+		*pPacketId = id;
+#ifdef ENABLE_IOT_FULL_DUPLEX
+		/* Register before sending, the reader may see the PUBACK before send returns */
+		rc = aws_iot_mqtt_internal_register_ack_waiter(pClient, id, &pWaiter);
+		if(SUCCESS != rc) {
+			(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+			aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+			FUNC_EXIT_RC(rc);
+		}
+#endif
+	}
+
+	/* The session store may send the message again on another connection, it keeps the topic */
+	isStored = (QOS1 == pTemplate->qos && NULL != pClient->clientData.pSessionStore);
+	rc = aws_iot_mqtt_internal_serialize_client_publish(pClient, pClient->clientData.writeBuf,
+														 pClient->clientData.writeBufSize, pTemplate, 0, id,
+														 (const unsigned char *) pPayload, payloadLen, !isStored,
+														 &len);
+	if(SUCCESS == rc && isStored) {
+		/* Stored before sending so the PUBACK always finds it */
+		rc = pClient->clientData.pSessionStore->save(pClient->clientData.pSessionStore->pContext, id,
+													 pClient->clientData.writeBuf, len);
+#ifdef ENABLE_IOT_MQTT5
+		/* This connection can still take the alias */
+		if(SUCCESS == rc && AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+			rc = aws_iot_mqtt_internal_serialize_client_publish(pClient, pClient->clientData.writeBuf,
+																 pClient->clientData.writeBufSize, pTemplate, 0, id,
+																 (const unsigned char *) pPayload, payloadLen, true,
+																 &len);
+		}
+#endif
+	}
+	if(SUCCESS == rc) {
+		/* send the publish packet */
+		IOT_TRACE_EVENT(IOT_TRACE_PUBLISH, pClient, id);
+#ifndef ENABLE_IOT_FULL_DUPLEX
+		/* Nobody waits on a QoS0 message, from a subscribe callback it can go with the PUBACKs */
+		if(QOS0 == pTemplate->qos) {
+			rc = aws_iot_mqtt_internal_send_packet_deferred(pClient, len, &timer);
+		} else {
+			rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+		}
+#else
+		rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+#endif
+	}
+
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+
+	/* Nothing reached the server, so no PUBACK will give the quota back */
+	if(SUCCESS != rc && QOS1 == pTemplate->qos) {
+		aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+	}
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	if(NULL != pWaiter) {
+		/* Wait for ack if QoS1 */
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_internal_wait_for_ack(pClient, pWaiter, &timer);
+		}
+		aws_iot_mqtt_internal_release_ack_waiter(pClient, pWaiter);
+	}
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+#else
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* Wait for ack if QoS1 */
-	if(QOS1 == pParams->qos) {
+	if(QOS1 == pTemplate->qos) {
 		rc = aws_iot_mqtt_internal_wait_for_read(pClient, PUBACK, &timer);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
@@ -237,26 +500,50 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
+
+#ifdef ENABLE_IOT_MQTT5
+		if(AWS_IOT_MQTT_IS_MQTT5(pClient)
+		   && MQTT5_REASON_FAILURE <= aws_iot_mqtt_internal_mqtt5_reason_code(pClient->clientData.readBuf)) {
+			FUNC_EXIT_RC(MQTT_REQUEST_REJECTED_ERROR);
+		}
+#endif
 	}
+#endif
 
 	FUNC_EXIT_RC(SUCCESS);
 }
 
-IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
-								 IoT_Publish_Message_Params *pParams) {
-	IoT_Error_t rc, pubRc;
+/**
+ * @brief Publish an MQTT message once the client is free to send it
+ *
+ * Checks the client state and runs @ref _aws_iot_mqtt_internal_publish.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTemplate Encoded topic name and flags
+ * @param pPayload Message payload
+ * @param payloadLen Length of the payload
+ * @param pPacketId Returns the packet identifier of a QoS1 message
+ *
+ * @return An IoT Error Type defining successful/failed publish
+ */
+static IoT_Error_t _aws_iot_mqtt_publish_checked(AWS_IoT_Client *pClient, const IoT_Publish_Template *pTemplate,
+												 const void *pPayload, size_t payloadLen, uint16_t *pPacketId) {
+	IoT_Error_t pubRc;
+#ifndef ENABLE_IOT_FULL_DUPLEX
+	IoT_Error_t rc;
 	ClientState clientState;
+#endif
 
 	FUNC_ENTRY;
 
-	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams) {
-		FUNC_EXIT_RC(NULL_VALUE_ERROR);
-	}
-
 	if(!aws_iot_mqtt_is_client_connected(pClient)) {
 		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 	}
 
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* Publishers only contend for the write buffer, whatever else the client is doing */
+	pubRc = _aws_iot_mqtt_internal_publish(pClient, pTemplate, pPayload, payloadLen, pPacketId);
+#else
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
 		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
@@ -267,16 +554,71 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 		FUNC_EXIT_RC(rc);
 	}
 
-	pubRc = _aws_iot_mqtt_internal_publish(pClient, pTopicName, topicNameLen, pParams);
+	pubRc = _aws_iot_mqtt_internal_publish(pClient, pTemplate, pPayload, payloadLen, pPacketId);
 
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, clientState);
 	if(SUCCESS == pubRc && SUCCESS != rc) {
 		pubRc = rc;
 	}
+#endif
 
 	FUNC_EXIT_RC(pubRc);
 }
 
+IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+								 IoT_Publish_Message_Params *pParams) {
+	IoT_Publish_Template publishTemplate;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = _aws_iot_mqtt_encode_publish_template(&publishTemplate, pTopicName, topicNameLen, pParams->qos,
+											   pParams->isRetained);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	rc = _aws_iot_mqtt_publish_checked(pClient, &publishTemplate, pParams->payload, pParams->payloadLen,
+									   &(pParams->id));
+	FUNC_EXIT_RC(rc);
+}
+
+IoT_Error_t aws_iot_mqtt_publish_template_init(IoT_Publish_Template *pTemplate, const char *pTopicName,
+											   uint16_t topicNameLen, QoS qos, uint8_t isRetained) {
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pTemplate || NULL == pTopicName || 0 == topicNameLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = _aws_iot_mqtt_encode_publish_template(pTemplate, pTopicName, topicNameLen, qos, isRetained);
+	FUNC_EXIT_RC(rc);
+}
+
+IoT_Error_t aws_iot_mqtt_publish_with_template(AWS_IoT_Client *pClient, const IoT_Publish_Template *pTemplate,
+											   const void *pPayload, size_t payloadLen, uint16_t *pPacketId) {
+	uint16_t packetId = 0;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTemplate || NULL == pPayload) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = _aws_iot_mqtt_publish_checked(pClient, pTemplate, pPayload, payloadLen, &packetId);
+	if(NULL != pPacketId) {
+		*pPacketId = packetId;
+	}
+	FUNC_EXIT_RC(rc);
+}
+
 /**
   * Deserializes the supplied (wire) buffer into publish data
   * @param dup returned uint8_t - the MQTT dup flag
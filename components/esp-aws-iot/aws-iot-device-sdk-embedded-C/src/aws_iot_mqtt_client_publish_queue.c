@@ -0,0 +1,507 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_publish_queue.c
+ * @brief MQTT client asynchronous publish queue
+ *
+ * Messages are queued by any task and sent by the task running yield. Slots are
+ * statically allocated in the client, high priority messages are sent first and
+ * as many queued messages as fit in the TX buffer go out in one network write.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client_common_internal.h"
+
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+
+const IoT_Publish_Queue_Params iotPublishQueueParamsDefault = IoT_Publish_Queue_Params_initializer;
+
+static void _aws_iot_mqtt_publish_queue_lock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.publish_queue_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+static void _aws_iot_mqtt_publish_queue_unlock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.publish_queue_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Run the completion handler of a slot and free it
+ *
+ * The slot must be in the COMPLETING state so nobody reuses its buffer while the
+ * handler looks at the payload. Called without the queue mutex held.
+ *
+ * @param pClient MQTT client
+ * @param pSlot Slot to complete
+ * @param result Outcome reported to the application
+ */
+static void _aws_iot_mqtt_publish_queue_complete(AWS_IoT_Client *pClient, PublishQueueSlot *pSlot,
+												 IoT_Error_t result) {
+	if(NULL != pSlot->pCompleteHandler) {
+		pSlot->pCompleteHandler(pClient, &(pSlot->params), result, pSlot->pCompleteHandlerData);
+	}
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+	pSlot->state = PUBLISH_QUEUE_SLOT_FREE;
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+}
+
+/**
+ * @brief Find the next message to send
+ *
+ * Must be called with the queue mutex held.
+ *
+ * @param pClient MQTT client
+ * @param pInBatch Slots already placed in the current batch
+ * @param pSkip Slots that can't be sent in this drain
+ *
+ * @return Oldest pending slot of the highest priority, NULL if none
+ */
+static PublishQueueSlot *_aws_iot_mqtt_publish_queue_next(AWS_IoT_Client *pClient, const bool *pInBatch,
+														  const bool *pSkip) {
+	uint32_t itr;
+	PublishQueueSlot *pSlot;
+	PublishQueueSlot *pBest = NULL;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		pSlot = &(pClient->clientData.publishQueue[itr]);
+		if(PUBLISH_QUEUE_SLOT_PENDING != pSlot->state || pInBatch[itr] || pSkip[itr]) {
+			continue;
+		}
+		/* Sequence numbers wrap, compare their distance rather than their value */
+		if(NULL == pBest || pSlot->priority < pBest->priority
+		   || (pSlot->priority == pBest->priority && (int32_t) (pSlot->sequence - pBest->sequence) < 0)) {
+			pBest = pSlot;
+		}
+	}
+
+	return pBest;
+}
+
+/**
+ * @brief Complete every slot in a given state
+ *
+ * @param pClient MQTT client
+ * @param state Slots in this state are completed
+ * @param isExpiredOnly Only complete slots whose PUBACK timer has expired
+ * @param result Outcome reported to the application
+ */
+static void _aws_iot_mqtt_publish_queue_complete_all(AWS_IoT_Client *pClient, PublishQueueSlotState state,
+													 bool isExpiredOnly, IoT_Error_t result) {
+	uint32_t itr;
+	PublishQueueSlot *pSlot;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		pSlot = &(pClient->clientData.publishQueue[itr]);
+
+		_aws_iot_mqtt_publish_queue_lock(pClient);
+		if(state != pSlot->state || (isExpiredOnly && !has_timer_expired(&(pSlot->ackTimer)))) {
+			_aws_iot_mqtt_publish_queue_unlock(pClient);
+			continue;
+		}
+		pSlot->state = PUBLISH_QUEUE_SLOT_COMPLETING;
+		_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+		_aws_iot_mqtt_publish_queue_complete(pClient, pSlot, result);
+	}
+}
+
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   const IoT_Publish_Queue_Params *pQueueParams) {
+	uint32_t itr, freeCount, remLen;
+	PublishQueueSlot *pSlot = NULL;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams || NULL == pParams->payload) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(NULL == pQueueParams) {
+		pQueueParams = &iotPublishQueueParamsDefault;
+	}
+
+	/* Reject now what could never be sent, rather than failing it from yield */
+	remLen = (uint32_t) (topicNameLen + pParams->payloadLen + 2);
+	if(QOS1 == pParams->qos) {
+		remLen += 2;
+	}
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		remLen += 1 + 3; /* properties with a Topic Alias */
+	}
+#endif
+	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(remLen) >= pClient->clientData.writeBufSize) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+	if(!pQueueParams->isZeroCopy && topicNameLen + pParams->payloadLen > AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+
+	freeCount = 0;
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		if(PUBLISH_QUEUE_SLOT_FREE == pClient->clientData.publishQueue[itr].state) {
+			if(NULL == pSlot) {
+				pSlot = &(pClient->clientData.publishQueue[itr]);
+			}
+			freeCount++;
+		}
+	}
+
+	if(NULL == pSlot
+	   || (PUBLISH_PRIORITY_HIGH != pQueueParams->priority && AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED >= freeCount)) {
+		_aws_iot_mqtt_publish_queue_unlock(pClient);
+		FUNC_EXIT_RC(MQTT_PUBLISH_QUEUE_FULL_ERROR);
+	}
+
+	pSlot->params = *pParams;
+	pSlot->params.isDup = 0;
+	pSlot->params.id = 0;
+	pSlot->topicNameLen = topicNameLen;
+	if(pQueueParams->isZeroCopy) {
+		pSlot->pTopicName = pTopicName;
+	} else {
+		memcpy(pSlot->buf, pTopicName, topicNameLen);
+		memcpy(&(pSlot->buf[topicNameLen]), pParams->payload, pParams->payloadLen);
+		pSlot->pTopicName = (const char *) pSlot->buf;
+		pSlot->params.payload = &(pSlot->buf[topicNameLen]);
+	}
+	pSlot->priority = pQueueParams->priority;
+	pSlot->pCompleteHandler = pQueueParams->pCompleteHandler;
+	pSlot->pCompleteHandlerData = pQueueParams->pCompleteHandlerData;
+	pSlot->sequence = pClient->clientData.publishQueueSequence++;
+	pSlot->state = PUBLISH_QUEUE_SLOT_PENDING;
+
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	/* Yield may sleep on another task without a deadline, have it send the message now */
+	if(NULL != pClient->networkStack.wakeUp) {
+		(void)pClient->networkStack.wakeUp(&(pClient->networkStack));
+	}
+#endif
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+uint32_t aws_iot_mqtt_get_publish_queue_free_count(AWS_IoT_Client *pClient, IoT_Publish_Priority priority) {
+	uint32_t itr, freeCount = 0;
+
+	if(NULL == pClient) {
+		return 0;
+	}
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		if(PUBLISH_QUEUE_SLOT_FREE == pClient->clientData.publishQueue[itr].state) {
+			freeCount++;
+		}
+	}
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+	if(PUBLISH_PRIORITY_HIGH != priority) {
+		freeCount = (freeCount > AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED) ?
+					freeCount - AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED : 0;
+	}
+
+	return freeCount;
+}
+
+/**
+ * @brief Set up the publish queue of a client
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex initialization
+ */
+IoT_Error_t aws_iot_mqtt_internal_init_publish_queue(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		pClient->clientData.publishQueue[itr].state = PUBLISH_QUEUE_SLOT_FREE;
+	}
+	pClient->clientData.publishQueueSequence = 0;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_thread_mutex_init(&(pClient->clientData.publish_queue_mutex));
+#endif
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Release the resources of the publish queue
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_destroy_publish_queue(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.publish_queue_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Send queued messages
+ *
+ * Called from yield on a connected client. Fails QoS1 messages whose PUBACK is
+ * overdue, then writes pending messages in priority order, packing as many as fit
+ * into the TX buffer per network write. On MQTT 5 QoS1 messages beyond the
+ * server's Receive Maximum stay queued until PUBACKs free the quota.
+ *
+ * @param pClient MQTT client
+ *
+ * @return SUCCESS or the error of the failed network write. Messages of a failed
+ * write stay queued and are sent again.
+ */
+IoT_Error_t aws_iot_mqtt_internal_drain_publish_queue(AWS_IoT_Client *pClient) {
+	bool inBatch[AWS_IOT_MQTT_PUBLISH_QUEUE_LEN];
+	bool isSkipped[AWS_IOT_MQTT_PUBLISH_QUEUE_LEN];
+	uint32_t itr, len, batchLen, batchCount;
+	PublishQueueSlot *pSlot;
+	IoT_Publish_Template publishTemplate;
+	Timer sendTimer;
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	_aws_iot_mqtt_publish_queue_complete_all(pClient, PUBLISH_QUEUE_SLOT_INFLIGHT, true, MQTT_REQUEST_TIMEOUT_ERROR);
+
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		isSkipped[itr] = false;
+	}
+
+	do {
+		batchLen = 0;
+		batchCount = 0;
+		for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+			inBatch[itr] = false;
+		}
+
+		rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+
+		_aws_iot_mqtt_publish_queue_lock(pClient);
+		while(NULL != (pSlot = _aws_iot_mqtt_publish_queue_next(pClient, inBatch, isSkipped))) {
+			if(QOS1 == pSlot->params.qos && !aws_iot_mqtt_internal_mqtt5_take_send_quota(pClient)) {
+				/* QoS0 messages behind it can still go */
+				isSkipped[pSlot - pClient->clientData.publishQueue] = true;
+				continue;
+			}
+			if(QOS1 == pSlot->params.qos && 0 == pSlot->params.id) {
+				pSlot->params.id = aws_iot_mqtt_get_next_packet_id(pClient);
+			}
+
+			/* send_packet needs the whole write to be shorter than the buffer */
+			rc = aws_iot_mqtt_publish_template_init(&publishTemplate, pSlot->pTopicName, pSlot->topicNameLen,
+													pSlot->params.qos, pSlot->params.isRetained);
+			if(SUCCESS == rc) {
+				rc = aws_iot_mqtt_internal_serialize_client_publish(pClient, &(pClient->clientData.writeBuf[batchLen]),
+																	 pClient->clientData.writeBufSize - batchLen - 1,
+																	 &publishTemplate, pSlot->params.isDup,
+																	 pSlot->params.id,
+																	 (unsigned char *) pSlot->params.payload,
+																	 pSlot->params.payloadLen, true, &len);
+			}
+			if(SUCCESS != rc) {
+				if(QOS1 == pSlot->params.qos) {
+					aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+				}
+				/* Batch is full, the rest goes in the next write */
+				rc = SUCCESS;
+				break;
+			}
+
+			IOT_TRACE_EVENT(IOT_TRACE_PUBLISH, pClient,
+							((uint32_t) pSlot->params.isDup << 16) | ((QOS0 == pSlot->params.qos) ? 0 : pSlot->params.id));
+			inBatch[pSlot - pClient->clientData.publishQueue] = true;
+			batchLen += len;
+			batchCount++;
+		}
+		_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+		if(0 < batchCount) {
+			init_timer(&sendTimer);
+			countdown_ms(&sendTimer, pClient->clientData.commandTimeoutMs);
+			rc = aws_iot_mqtt_internal_send_packet_deferred(pClient, batchLen, &sendTimer);
+		}
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+
+		_aws_iot_mqtt_publish_queue_lock(pClient);
+		for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+			pSlot = &(pClient->clientData.publishQueue[itr]);
+			if(!inBatch[itr]) {
+				continue;
+			}
+			if(SUCCESS != rc) {
+				/* Part of the batch may have reached the broker */
+				if(QOS1 == pSlot->params.qos) {
+					pSlot->params.isDup = 1;
+					aws_iot_mqtt_internal_mqtt5_give_send_quota(pClient);
+				} else {
+					pSlot->params.isDup = 0;
+				}
+				inBatch[itr] = false;
+			} else if(QOS1 == pSlot->params.qos) {
+				pSlot->state = PUBLISH_QUEUE_SLOT_INFLIGHT;
+				init_timer(&(pSlot->ackTimer));
+				countdown_ms(&(pSlot->ackTimer), pClient->clientData.commandTimeoutMs);
+				inBatch[itr] = false;
+			} else {
+				pSlot->state = PUBLISH_QUEUE_SLOT_COMPLETING;
+			}
+		}
+		_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+		/* QoS0 messages are done once written */
+		for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+			if(inBatch[itr]) {
+				_aws_iot_mqtt_publish_queue_complete(pClient, &(pClient->clientData.publishQueue[itr]), SUCCESS);
+			}
+		}
+	} while(SUCCESS == rc && 0 < batchCount);
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Complete the queued QoS1 message a PUBACK belongs to
+ *
+ * @param pClient MQTT client
+ * @param packetId Packet identifier from the PUBACK
+ * @param result SUCCESS, or MQTT_REQUEST_REJECTED_ERROR for an MQTT 5 failure reason code
+ */
+void aws_iot_mqtt_internal_publish_queue_ack(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t result) {
+	uint32_t itr;
+	PublishQueueSlot *pSlot = NULL;
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		if(PUBLISH_QUEUE_SLOT_INFLIGHT == pClient->clientData.publishQueue[itr].state
+		   && packetId == pClient->clientData.publishQueue[itr].params.id) {
+			pSlot = &(pClient->clientData.publishQueue[itr]);
+			pSlot->state = PUBLISH_QUEUE_SLOT_COMPLETING;
+			break;
+		}
+	}
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+	if(NULL != pSlot) {
+		_aws_iot_mqtt_publish_queue_complete(pClient, pSlot, result);
+	}
+}
+
+/**
+ * @brief Longest time yield may sleep without holding up the queue
+ *
+ * A message queued by another task while yield sleeps wakes it up through the
+ * wakeUp of the network. A network that has none can't be woken, then even an idle
+ * queue caps the sleep at AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS. Without thread
+ * support messages are only queued by the task that yields, between its sleeps.
+ *
+ * @param pClient MQTT client
+ *
+ * @return 0 if messages are waiting to be sent, otherwise the time until the next
+ * PUBACK timeout, UINT32_MAX if none is due. A QoS1 message held back by the MQTT 5
+ * Receive Maximum waits for a PUBACK like an idle queue does.
+ */
+uint32_t aws_iot_mqtt_internal_publish_queue_wait_ms(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+	uint32_t waitMs = UINT32_MAX;
+	uint32_t ackLeftMs;
+	PublishQueueSlot *pSlot;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if(NULL == pClient->networkStack.wakeUp) {
+		waitMs = AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS;
+	}
+#endif
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		pSlot = &(pClient->clientData.publishQueue[itr]);
+		if(PUBLISH_QUEUE_SLOT_PENDING == pSlot->state
+		   && (QOS0 == pSlot->params.qos || aws_iot_mqtt_internal_mqtt5_has_send_quota(pClient))) {
+			waitMs = 0;
+			break;
+		} else if(PUBLISH_QUEUE_SLOT_INFLIGHT == pSlot->state) {
+			ackLeftMs = left_ms(&(pSlot->ackTimer));
+			if(ackLeftMs < waitMs) {
+				waitMs = ackLeftMs;
+			}
+		}
+	}
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+
+	return waitMs;
+}
+
+/**
+ * @brief Update the queue after the connection was closed
+ *
+ * Unacknowledged messages are sent again, with DUP set, once the client has
+ * reconnected. When the client is being freed every queued message fails.
+ *
+ * @param pClient MQTT client
+ * @param isFreeingClient Whether the client will never reconnect
+ */
+void aws_iot_mqtt_internal_publish_queue_disconnected(AWS_IoT_Client *pClient, bool isFreeingClient) {
+	uint32_t itr;
+	PublishQueueSlot *pSlot;
+
+	if(isFreeingClient) {
+		_aws_iot_mqtt_publish_queue_complete_all(pClient, PUBLISH_QUEUE_SLOT_INFLIGHT, false,
+												 NETWORK_DISCONNECTED_ERROR);
+		_aws_iot_mqtt_publish_queue_complete_all(pClient, PUBLISH_QUEUE_SLOT_PENDING, false,
+												 NETWORK_DISCONNECTED_ERROR);
+		return;
+	}
+
+	_aws_iot_mqtt_publish_queue_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN; ++itr) {
+		pSlot = &(pClient->clientData.publishQueue[itr]);
+		if(PUBLISH_QUEUE_SLOT_INFLIGHT == pSlot->state) {
+			pSlot->params.isDup = 1;
+			pSlot->state = PUBLISH_QUEUE_SLOT_PENDING;
+		}
+	}
+	_aws_iot_mqtt_publish_queue_unlock(pClient);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
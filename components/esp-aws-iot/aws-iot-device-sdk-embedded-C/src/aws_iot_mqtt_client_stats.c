@@ -0,0 +1,311 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_stats.c
+ * @brief MQTT client traffic and latency statistics
+ *
+ * Every counter changes under the stats mutex, so a snapshot never holds a 64 bit
+ * counter half updated on a 32 bit CPU. Durations are measured with a platform
+ * Timer, started with countdown_ms(timer, 0) and read with elapsed_ms.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_mqtt_client_common_internal.h"
+
+#ifndef DISABLE_IOT_STATS
+
+static void _aws_iot_mqtt_stats_lock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.stats_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+static void _aws_iot_mqtt_stats_unlock(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.stats_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Start timing a QoS1 PUBLISH
+ *
+ * Called with the stats mutex held.
+ *
+ * @param pClient MQTT client
+ * @param pPacket Serialized PUBLISH packet
+ * @param headerLen Length of its fixed header
+ * @param packetLen Length of the whole packet
+ */
+static void _aws_iot_mqtt_stats_track_publish(AWS_IoT_Client *pClient, const unsigned char *pPacket,
+											  size_t headerLen, size_t packetLen) {
+	PubackRttTracker *pTracker;
+	size_t topicLen;
+	uint16_t packetId;
+
+	/* Topic name length, topic name, then the packet id */
+	if(headerLen + 2 > packetLen) {
+		return;
+	}
+	topicLen = (size_t) ((pPacket[headerLen] << 8) | pPacket[headerLen + 1]);
+	if(headerLen + 2 + topicLen + 2 > packetLen) {
+		return;
+	}
+	packetId = (uint16_t) ((pPacket[headerLen + 2 + topicLen] << 8) | pPacket[headerLen + 2 + topicLen + 1]);
+
+	pTracker = &(pClient->clientData.pubackTrackers[pClient->clientData.nextPubackTracker]);
+	pClient->clientData.nextPubackTracker = (pClient->clientData.nextPubackTracker + 1)
+											% AWS_IOT_MQTT_STATS_MAX_TRACKED_PUBACKS;
+	pTracker->packetId = packetId;
+	init_timer(&(pTracker->sentStopwatch));
+	countdown_ms(&(pTracker->sentStopwatch), 0);
+}
+
+/**
+ * @brief Set up statistics of a client
+ *
+ * @param pClient MQTT client
+ *
+ * @return IoT_Error_t of mutex initialization
+ */
+IoT_Error_t aws_iot_mqtt_internal_init_stats(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	memset(&(pClient->clientData.stats), 0, sizeof(IoT_Client_Stats));
+	memset(pClient->clientData.pubackTrackers, 0, sizeof(pClient->clientData.pubackTrackers));
+	pClient->clientData.nextPubackTracker = 0;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_thread_mutex_init(&(pClient->clientData.stats_mutex));
+#endif
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Release the resources of the client statistics
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_destroy_stats(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.stats_mutex));
+#else
+	IOT_UNUSED(pClient);
+#endif
+}
+
+/**
+ * @brief Count packets about to be written to the network
+ *
+ * Called with the TX buffer locked. QoS1 PUBLISH packets start being timed here,
+ * before any byte is written, so a fast PUBACK can't arrive first.
+ *
+ * @param pClient MQTT client
+ * @param length Bytes of the TX buffer to be sent, one or more packets
+ */
+void aws_iot_mqtt_internal_stats_sending(AWS_IoT_Client *pClient, size_t length) {
+	unsigned char *pPacket;
+	uint32_t remLen, lenBytes;
+	size_t offset = 0;
+	uint8_t packetType;
+
+	_aws_iot_mqtt_stats_lock(pClient);
+	while(offset + 2 <= length) {
+		pPacket = &(pClient->clientData.writeBuf[offset]);
+		if(SUCCESS != aws_iot_mqtt_internal_decode_remaining_length_from_buffer(&(pPacket[1]), &remLen, &lenBytes)) {
+			break;
+		}
+
+		packetType = (uint8_t) MQTT_HEADER_FIELD_TYPE(pPacket[0]);
+		pClient->clientData.stats.packetsOut[packetType]++;
+
+		if(PUBLISH == packetType && QOS0 != MQTT_HEADER_FIELD_QOS(pPacket[0])) {
+			_aws_iot_mqtt_stats_track_publish(pClient, pPacket, 1 + lenBytes, 1 + lenBytes + remLen);
+		}
+
+		offset += 1 + lenBytes + remLen;
+	}
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count bytes written to the network
+ *
+ * @param pClient MQTT client
+ * @param sentLen Bytes the network took
+ */
+void aws_iot_mqtt_internal_stats_sent(AWS_IoT_Client *pClient, size_t sentLen) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.bytesOut += sentLen;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count a packet taken off the network
+ *
+ * Called with the read side locked.
+ *
+ * @param pClient MQTT client
+ * @param packetType Control packet type
+ * @param packetLen Bytes of the whole packet
+ */
+void aws_iot_mqtt_internal_stats_received(AWS_IoT_Client *pClient, uint8_t packetType, size_t packetLen) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.bytesIn += packetLen;
+	pClient->clientData.stats.packetsIn[packetType & 0x0F]++;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count a received packet dropped for not fitting the read buffer
+ *
+ * @param pClient MQTT client
+ * @param packetLen Bytes of the whole packet
+ */
+void aws_iot_mqtt_internal_stats_dropped_oversized(AWS_IoT_Client *pClient, size_t packetLen) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.bytesIn += packetLen;
+	pClient->clientData.stats.droppedOversized++;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count a received message a dispatched subscription dropped
+ *
+ * @param pClient MQTT client
+ */
+void aws_iot_mqtt_internal_stats_dropped_dispatch(AWS_IoT_Client *pClient) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.droppedDispatch++;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count a yield call
+ *
+ * @param pClient MQTT client
+ * @param yieldMs Time spent in the call
+ */
+void aws_iot_mqtt_internal_stats_yield(AWS_IoT_Client *pClient, uint32_t yieldMs) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.yieldCalls++;
+	pClient->clientData.stats.yieldMs += yieldMs;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Count time yield spent waiting for the network to become readable
+ *
+ * @param pClient MQTT client
+ * @param sleepMs Time spent waiting
+ */
+void aws_iot_mqtt_internal_stats_yield_sleep(AWS_IoT_Client *pClient, uint32_t sleepMs) {
+	_aws_iot_mqtt_stats_lock(pClient);
+	pClient->clientData.stats.yieldSleepMs += sleepMs;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Record the round trip of the QoS1 PUBLISH a PUBACK belongs to
+ *
+ * @param pClient MQTT client
+ * @param packetId Packet identifier from the PUBACK
+ */
+void aws_iot_mqtt_internal_stats_puback(AWS_IoT_Client *pClient, uint16_t packetId) {
+	PubackRttTracker *pTracker;
+	uint32_t itr, rttMs;
+
+	if(0 == packetId) {
+		return;
+	}
+
+	_aws_iot_mqtt_stats_lock(pClient);
+	for(itr = 0; itr < AWS_IOT_MQTT_STATS_MAX_TRACKED_PUBACKS; ++itr) {
+		pTracker = &(pClient->clientData.pubackTrackers[itr]);
+		if(packetId == pTracker->packetId) {
+			rttMs = elapsed_ms(&(pTracker->sentStopwatch));
+			pTracker->packetId = 0;
+			_aws_iot_mqtt_stats_unlock(pClient);
+			aws_iot_mqtt_internal_stats_record(pClient, &(pClient->clientData.stats.pubackRtt), rttMs);
+			return;
+		}
+	}
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+/**
+ * @brief Add a duration to one of the client's histograms
+ *
+ * @param pClient MQTT client
+ * @param pHistogram Histogram in the client's statistics
+ * @param durationMs Duration to add
+ */
+void aws_iot_mqtt_internal_stats_record(AWS_IoT_Client *pClient, IoT_Client_Stats_Histogram *pHistogram,
+										uint32_t durationMs) {
+	uint32_t bucket = 0;
+
+	while(bucket < AWS_IOT_MQTT_STATS_HISTOGRAM_BUCKETS - 1 && 0 != (durationMs >> bucket)) {
+		bucket++;
+	}
+
+	_aws_iot_mqtt_stats_lock(pClient);
+	pHistogram->count++;
+	pHistogram->totalMs += durationMs;
+	if(durationMs > pHistogram->maxMs) {
+		pHistogram->maxMs = durationMs;
+	}
+	pHistogram->buckets[bucket]++;
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+IoT_Error_t aws_iot_mqtt_get_stats(AWS_IoT_Client *pClient, IoT_Client_Stats *pStats) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pStats) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	_aws_iot_mqtt_stats_lock(pClient);
+	memcpy(pStats, &(pClient->clientData.stats), sizeof(IoT_Client_Stats));
+	_aws_iot_mqtt_stats_unlock(pClient);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+void aws_iot_mqtt_reset_stats(AWS_IoT_Client *pClient) {
+	if(NULL == pClient) {
+		return;
+	}
+
+	_aws_iot_mqtt_stats_lock(pClient);
+	memset(&(pClient->clientData.stats), 0, sizeof(IoT_Client_Stats));
+	_aws_iot_mqtt_stats_unlock(pClient);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -45,6 +45,7 @@ extern "C" {
   * Serializes the supplied subscribe data into the supplied buffer, ready for sending
   * @param pTxBuf the buffer into which the packet will be serialized
   * @param txBufLen the length in bytes of the supplied buffer
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param dup unsigned char - the MQTT dup flag
   * @param packetId uint16_t - the MQTT packet identifier
   * @param topicCount - number of members in the topicFilters and reqQos arrays
@@ -55,7 +56,7 @@ extern "C" {
   *
   * @return An IoT Error Type defining successful/failed operation
   */
-static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size_t txBufLen,
+static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size_t txBufLen, MQTT_Ver_t version,
 													 unsigned char dup, uint16_t packetId, uint32_t topicCount,
 													 const char **pTopicNameList, uint16_t *pTopicNameLenList,
 													 QoS *pRequestedQoSs, uint32_t *pSerializedLen) {
@@ -71,6 +72,13 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 
 	ptr = pTxBuf;
 	rem_len = 2; /* packetId */
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == version) {
+		rem_len += 1; /* no properties */
+	}
+#else
+	IOT_UNUSED(version);
+#endif
 
 	for(itr = 0; itr < topicCount; ++itr) {
 		rem_len += (uint32_t) (pTopicNameLenList[itr] + 2 + 1); /* topic + length + req_qos */
@@ -91,6 +99,11 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len);
 
 	aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == version) {
+		aws_iot_mqtt_internal_write_char(&ptr, 0);
+	}
+#endif
 
 	for(itr = 0; itr < topicCount; ++itr) {
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicNameList[itr], pTopicNameLenList[itr]);
@@ -104,6 +117,7 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 
 /**
   * Deserializes the supplied (wire) buffer into suback data
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param pPacketId returned integer - the MQTT packet identifier
   * @param maxExpectedQoSCount - the maximum number of members allowed in the grantedQoSs array
   * @param pGrantedQoSCount returned uint32_t - number of members in the grantedQoSs array
@@ -113,7 +127,8 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
   *
   * @return An IoT Error Type defining successful/failed operation
   */
-static IoT_Error_t _aws_iot_mqtt_deserialize_suback(uint16_t *pPacketId, uint32_t maxExpectedQoSCount,
+static IoT_Error_t _aws_iot_mqtt_deserialize_suback(MQTT_Ver_t version, uint16_t *pPacketId,
+													uint32_t maxExpectedQoSCount,
 													uint32_t *pGrantedQoSCount, QoS *pGrantedQoSs,
 													unsigned char *pRxBuf, size_t rxBufLen) {
 	unsigned char *curData, *endData;
@@ -158,6 +173,15 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_suback(uint16_t *pPacketId, uint32_
 
 	*pPacketId = aws_iot_mqtt_internal_read_uint16_t(&curData);
 
+#ifdef ENABLE_IOT_MQTT5
+	/* The reason codes that follow the properties double as granted QoS */
+	if(MQTT_5 == version && SUCCESS != aws_iot_mqtt_internal_mqtt5_skip_properties(&curData, endData)) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+#else
+	IOT_UNUSED(version);
+#endif
+
 	*pGrantedQoSCount = 0;
 	while(curData < endData) {
 		if(*pGrantedQoSCount > maxExpectedQoSCount) {
@@ -223,19 +247,26 @@ static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, con
 	txPacketId = aws_iot_mqtt_get_next_packet_id(pClient);
 	rxPacketId = 0;
 
-	rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-										   txPacketId, 1, &pTopicName, &topicNameLen, &qos, &serializedLen);
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+	rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+										   pClient->clientData.options.MQTTVersion, 0, txPacketId, 1, &pTopicName, &topicNameLen, &qos, &serializedLen);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	indexOfFreeMessageHandler = _aws_iot_mqtt_get_free_message_handler_index(pClient);
 	if(AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS <= indexOfFreeMessageHandler) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR);
 	}
 
 	/* send the subscribe packet */
 	rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, &timer);
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -247,12 +278,21 @@ static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, con
 	}
 
 	/* Granted QoS can be 0, 1 or 2 */
-	rc = _aws_iot_mqtt_deserialize_suback(&rxPacketId, 1, &count, grantedQoS, pClient->clientData.readBuf,
-										  pClient->clientData.readBufSize);
+	rc = _aws_iot_mqtt_deserialize_suback(pClient->clientData.options.MQTTVersion, &rxPacketId, 1, &count,
+										  grantedQoS, pClient->clientData.readBuf, pClient->clientData.readBufSize);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
 
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		pClient->clientStatus.lastReasonCode = (uint8_t) grantedQoS[0];
+		if(MQTT5_REASON_FAILURE <= (uint8_t) grantedQoS[0]) {
+			FUNC_EXIT_RC(MQTT_REQUEST_REJECTED_ERROR);
+		}
+	}
+#endif
+
 	/* TODO : Figure out how to test this before activating this check */
 	//if(txPacketId != rxPacketId) {
 	/* Different SUBACK received than expected. Return error
@@ -350,17 +390,24 @@ static IoT_Error_t _aws_iot_mqtt_internal_resubscribe(AWS_IoT_Client *pClient) {
 		init_timer(&timer);
 		countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-		rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
+		rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+		rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+											   pClient->clientData.options.MQTTVersion, 0,
 											   aws_iot_mqtt_get_next_packet_id(pClient), 1,
 											   &(pClient->clientData.messageHandlers[itr].topicName),
 											   &(pClient->clientData.messageHandlers[itr].topicNameLen),
 											   &(pClient->clientData.messageHandlers[itr].qos), &len);
 		if(SUCCESS != rc) {
+			(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 			FUNC_EXIT_RC(rc);
 		}
 
 		/* send the subscribe packet */
 		rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
@@ -372,7 +419,8 @@ static IoT_Error_t _aws_iot_mqtt_internal_resubscribe(AWS_IoT_Client *pClient) {
 		}
 
 		/* Granted QoS can be 0, 1 or 2 */
-		rc = _aws_iot_mqtt_deserialize_suback(&packetId, 1, &count, grantedQoS, pClient->clientData.readBuf,
+		rc = _aws_iot_mqtt_deserialize_suback(pClient->clientData.options.MQTTVersion, &packetId, 1, &count,
+											  grantedQoS, pClient->clientData.readBuf,
 											  pClient->clientData.readBufSize);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
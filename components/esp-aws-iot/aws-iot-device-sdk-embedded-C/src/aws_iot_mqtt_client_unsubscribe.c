@@ -45,6 +45,7 @@ extern "C" {
   * Serializes the supplied unsubscribe data into the supplied buffer, ready for sending
   * @param pTxBuf the raw buffer data, of the correct length determined by the remaining length field
   * @param txBufLen the length in bytes of the data in the supplied buffer
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param dup integer - the MQTT dup flag
   * @param packetId integer - the MQTT packet identifier
   * @param count - number of members in the topicFilters array
@@ -54,7 +55,7 @@ extern "C" {
   * @return IoT_Error_t indicating function execution status
   */
 static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, size_t txBufLen,
-													   uint8_t dup, uint16_t packetId,
+													   MQTT_Ver_t version, uint8_t dup, uint16_t packetId,
 													   uint32_t count, const char **pTopicNameList,
 													   uint16_t *pTopicNameLenList, uint32_t *pSerializedLen) {
 	unsigned char *ptr = pTxBuf;
@@ -65,6 +66,14 @@ static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, si
 
 	FUNC_ENTRY;
 
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == version) {
+		rem_len += 1; /* no properties */
+	}
+#else
+	IOT_UNUSED(version);
+#endif
+
 	for(i = 0; i < count; ++i) {
 		rem_len += (uint32_t) (pTopicNameLenList[i] + 2); /* topic + length */
 	}
@@ -82,6 +91,11 @@ static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, si
 	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */
 
 	aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+#ifdef ENABLE_IOT_MQTT5
+	if(MQTT_5 == version) {
+		aws_iot_mqtt_internal_write_char(&ptr, 0);
+	}
+#endif
 
 	for(i = 0; i < count; ++i) {
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicNameList[i], pTopicNameLenList[i]);
@@ -160,15 +174,22 @@ static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, c
 	init_timer(&timer);
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-	rc = _aws_iot_mqtt_serialize_unsubscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+	rc = _aws_iot_mqtt_serialize_unsubscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+											 pClient->clientData.options.MQTTVersion, 0,
 											 aws_iot_mqtt_get_next_packet_id(pClient), 1, &pTopicFilter,
 											 &topicFilterLen, &serializedLen);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* send the unsubscribe packet */
 	rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, &timer);
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -183,11 +204,23 @@ static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, c
 		FUNC_EXIT_RC(rc);
 	}
 
+#ifdef ENABLE_IOT_MQTT5
+	if(AWS_IOT_MQTT_IS_MQTT5(pClient)) {
+		pClient->clientStatus.lastReasonCode = aws_iot_mqtt_internal_mqtt5_reason_code(pClient->clientData.readBuf);
+		if(MQTT5_REASON_FAILURE <= pClient->clientStatus.lastReasonCode) {
+			FUNC_EXIT_RC(MQTT_REQUEST_REJECTED_ERROR);
+		}
+	}
+#endif
+
 	/* Remove from message handler array */
 	for(i = 0; i < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++i) {
 		if(pClient->clientData.messageHandlers[i].topicName != NULL &&
 		   (strcmp(pClient->clientData.messageHandlers[i].topicName, pTopicFilter) == 0)) {
 			pClient->clientData.messageHandlers[i].topicName = NULL;
+#ifdef ENABLE_IOT_DISPATCH_POOL
+			aws_iot_mqtt_internal_dispatch_unsubscribed(pClient, i);
+#endif
 			/* We don't want to break here, in case the same topic is registered
              * with 2 callbacks. Unlikely scenario */
 		}
@@ -46,8 +46,7 @@ extern "C" {
   */
 static void _aws_iot_mqtt_force_client_disconnect(AWS_IoT_Client *pClient) {
 	pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_ERROR;
-	pClient->networkStack.disconnect(&(pClient->networkStack));
-	pClient->networkStack.destroy(&(pClient->networkStack));
+	(void)aws_iot_mqtt_internal_network_close(pClient);
 }
 
 static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
@@ -55,6 +54,7 @@ static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
 
 	FUNC_ENTRY;
 
+	IOT_TRACE_EVENT(IOT_TRACE_CONNECTION_LOST, pClient, 0);
 	rc = aws_iot_mqtt_disconnect(pClient);
 	if(rc != SUCCESS) {
 		// If the aws_iot_mqtt_internal_send_packet prevents us from sending a disconnect packet then we have to clean the stack
@@ -63,6 +63,14 @@ static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
 
 	pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_ERROR;
 
+#ifdef ENABLE_IOT_FULL_DUPLEX
+	/* Publishers waiting for a PUBACK won't get it on this connection */
+	aws_iot_mqtt_internal_wake_ack_waiters(pClient);
+#endif
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+	aws_iot_mqtt_internal_publish_queue_disconnected(pClient, false);
+#endif
+
 	if(NULL != pClient->clientData.disconnectHandler) {
 		pClient->clientData.disconnectHandler(pClient, pClient->clientData.disconnectHandlerData);
 	}
@@ -92,6 +100,7 @@ static IoT_Error_t _aws_iot_mqtt_handle_reconnect(AWS_IoT_Client *pClient) {
 	}
 
 	if(NETWORK_PHYSICAL_LAYER_CONNECTED == rc) {
+		IOT_TRACE_EVENT(IOT_TRACE_RECONNECT, pClient, pClient->clientData.currentReconnectWaitInterval);
 		rc = aws_iot_mqtt_attempt_reconnect(pClient);
 		if(NETWORK_RECONNECTED == rc) {
 			rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_IDLE,
@@ -154,14 +163,21 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 	serialized_len = 0;
+	rc = aws_iot_mqtt_internal_lock_write_buf(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
 	rc = aws_iot_mqtt_internal_serialize_zero(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
 											  PINGREQ, &serialized_len);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* send the ping packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, serialized_len, &timer);
+	rc = aws_iot_mqtt_internal_send_packet_deferred(pClient, serialized_len, &timer);
+	(void)aws_iot_mqtt_internal_unlock_write_buf(pClient);
+	IOT_TRACE_EVENT(IOT_TRACE_PINGREQ, pClient, rc);
 	if(SUCCESS != rc) {
 		//If sending a PING fails we can no longer determine if we are connected.  In this case we decide we are disconnected and begin reconnection attempts
 		rc = _aws_iot_mqtt_handle_disconnect(pClient);
@@ -197,6 +213,88 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
  *         iot_is_mqtt_connected can be called to confirm.
  */
 
+/**
+ * @brief Sleep until the network has data or the client has timed work to do
+ *
+ * Returns at once while the receive ring still holds data. Otherwise writes the packets
+ * yield collected so far and, if the network layer provides waitForReadable, sleeps until
+ * bytes arrive or the nearest of the yield deadline, the given deadline and, when
+ * connected, the keepalive deadline and the publish queue's next send.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pYieldTimer Timer of the running yield
+ * @param maxWaitMs Further limit on the sleep
+ *
+ * @return SUCCESS if there may be data to read, MQTT_NOTHING_TO_READ if the sleep ran
+ * into a deadline or the network error
+ */
+static IoT_Error_t _aws_iot_mqtt_wait_for_network(AWS_IoT_Client *pClient, Timer *pYieldTimer, uint32_t maxWaitMs) {
+	uint32_t waitMs, dueMs;
+	IoT_Error_t rc;
+	Timer waitTimer;
+#ifndef DISABLE_IOT_STATS
+	Timer stopwatch;
+#endif
+
+	if(0 < pClient->clientData.rxRingFill) {
+		return SUCCESS;
+	}
+
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	/* Nothing buffered to answer anymore, send what was collected before blocking */
+	rc = aws_iot_mqtt_internal_flush_writes(pClient);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+#endif
+
+	if(NULL == pClient->networkStack.waitForReadable) {
+		return SUCCESS;
+	}
+
+	waitMs = left_ms(pYieldTimer);
+	if(maxWaitMs < waitMs) {
+		waitMs = maxWaitMs;
+	}
+
+	if(aws_iot_mqtt_is_client_connected(pClient)) {
+		if(0 != pClient->clientData.keepAliveInterval) {
+			dueMs = pClient->clientStatus.isPingOutstanding ? left_ms(&(pClient->pingRespTimer))
+															: left_ms(&(pClient->pingReqTimer));
+			if(dueMs < waitMs) {
+				waitMs = dueMs;
+			}
+		}
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		dueMs = aws_iot_mqtt_internal_publish_queue_wait_ms(pClient);
+		if(dueMs < waitMs) {
+			waitMs = dueMs;
+		}
+#endif
+	}
+
+	/* Something is due already, let the caller get on with it */
+	if(0 == waitMs) {
+		return SUCCESS;
+	}
+
+	init_timer(&waitTimer);
+	countdown_ms(&waitTimer, waitMs);
+#ifndef DISABLE_IOT_STATS
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+#endif
+	rc = pClient->networkStack.waitForReadable(&(pClient->networkStack), &waitTimer);
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_yield_sleep(pClient, elapsed_ms(&stopwatch));
+#endif
+	if(NETWORK_SSL_NOTHING_TO_READ == rc) {
+		return MQTT_NOTHING_TO_READ;
+	}
+
+	return rc;
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 	IoT_Error_t yieldRc = SUCCESS;
 	int itr = 0;
@@ -224,19 +322,65 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 				break;
 			}
 			yieldRc = _aws_iot_mqtt_handle_reconnect(pClient);
+			if(CLIENT_STATE_PENDING_RECONNECT == aws_iot_mqtt_get_client_state(pClient)) {
+				/* Nothing can arrive while disconnected, sleep until the next attempt is due */
+				(void)_aws_iot_mqtt_wait_for_network(pClient, &timer, left_ms(&(pClient->reconnectDelayTimer)));
+			}
 			/* Network reconnect attempted, check if yield timer expired before
 			 * doing anything else */
 			continue;
 		}
 
-		yieldRc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packet_type);
+#ifdef ENABLE_IOT_PUBLISH_QUEUE
+		/* Send what other tasks queued before waiting on the network */
+		yieldRc = aws_iot_mqtt_internal_drain_publish_queue(pClient);
+		if(SUCCESS == yieldRc) {
+			yieldRc = _aws_iot_mqtt_wait_for_network(pClient, &timer, UINT32_MAX);
+		}
+#else
+		yieldRc = _aws_iot_mqtt_wait_for_network(pClient, &timer, UINT32_MAX);
+#endif
+#ifdef ENABLE_IOT_FULL_DUPLEX
+		/* Another task may have disconnected, or even reconnected, the client meanwhile.
+		 * Checked under the read mutex, which closing the network takes too, so yield
+		 * never reads from or tears down a connection it did not start on */
+		(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_read_mutex));
+		if(CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS != aws_iot_mqtt_get_client_state(pClient)) {
+			(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+			yieldRc = NETWORK_MANUALLY_DISCONNECTED;
+			break;
+		}
+#endif
+		if(SUCCESS == yieldRc) {
+			yieldRc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packet_type);
+		} else if(MQTT_NOTHING_TO_READ == yieldRc) {
+			/* Woken by a deadline, keepalive below takes care of it */
+			yieldRc = SUCCESS;
+		}
+#ifdef ENABLE_IOT_FULL_DUPLEX
+		(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_read_mutex));
+#endif
 		if(SUCCESS == yieldRc) {
 			yieldRc = _aws_iot_mqtt_keep_alive(pClient);
+#ifdef ENABLE_IOT_WRITE_COALESCING
+			if(SUCCESS == yieldRc && has_timer_expired(&timer)) {
+				/* Last pass, nothing collected may be left behind */
+				if(SUCCESS != aws_iot_mqtt_internal_flush_writes(pClient)) {
+					yieldRc = _aws_iot_mqtt_handle_disconnect(pClient);
+				}
+			}
+#endif
 		} else {
 			// SSL read and write errors are terminal, connection must be closed and retried
 			if(NETWORK_SSL_READ_ERROR == yieldRc || NETWORK_SSL_WRITE_ERROR == yieldRc || NETWORK_SSL_WRITE_TIMEOUT_ERROR == yieldRc) {
 				yieldRc = _aws_iot_mqtt_handle_disconnect(pClient);
 			}
+#ifdef ENABLE_IOT_MQTT5
+			/* So is a DISCONNECT from the server, the reason code stays readable */
+			if(MQTT_SERVER_DISCONNECT_ERROR == yieldRc) {
+				yieldRc = _aws_iot_mqtt_handle_disconnect(pClient);
+			}
+#endif
 		}
 
 		if(NETWORK_DISCONNECTED_ERROR == yieldRc) {
@@ -267,12 +411,25 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 		}
 	} while(!has_timer_expired(&timer));
 
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	/* The loop can also end on an error or right after a reconnect, nothing collected
+	 * may be left behind either way. A failed write shows up as a read error next yield */
+	if(aws_iot_mqtt_is_client_connected(pClient)) {
+		(void)aws_iot_mqtt_internal_flush_writes(pClient);
+	} else {
+		pClient->clientData.coalesceLen = 0;
+	}
+#endif
+
 	FUNC_EXIT_RC(yieldRc);
 }
 
 IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 	IoT_Error_t rc, yieldRc;
 	ClientState clientState;
+#ifndef DISABLE_IOT_STATS
+	Timer stopwatch;
+#endif
 
 	if(NULL == pClient || 0 == timeout_ms) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
@@ -306,7 +463,20 @@ IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 		}
 	}
 
+#ifndef DISABLE_IOT_STATS
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+#endif
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	pClient->clientData.isWriteCorked = true;
+#endif
 	yieldRc = _aws_iot_mqtt_internal_yield(pClient, timeout_ms);
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	pClient->clientData.isWriteCorked = false;
+#endif
+#ifndef DISABLE_IOT_STATS
+	aws_iot_mqtt_internal_stats_yield(pClient, elapsed_ms(&stopwatch));
+#endif
 
 	if(NETWORK_DISCONNECTED_ERROR != yieldRc && NETWORK_ATTEMPTING_RECONNECT != yieldRc) {
 		rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS,
@@ -0,0 +1,195 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_session_store_ram.c
+ * @brief MQTT session store keeping unacknowledged messages in RAM
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "aws_iot_mqtt_session_store_ram.h"
+
+/* Each entry is the packet id and the packet length, both big endian, then the packet */
+#define SESSION_STORE_RAM_ENTRY_HEADER_LEN 4
+
+static void _aws_iot_mqtt_session_store_ram_lock(IoT_MQTT_Session_Store_Ram *pRam) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pRam->lock));
+#else
+	IOT_UNUSED(pRam);
+#endif
+}
+
+static void _aws_iot_mqtt_session_store_ram_unlock(IoT_MQTT_Session_Store_Ram *pRam) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pRam->lock));
+#else
+	IOT_UNUSED(pRam);
+#endif
+}
+
+static uint16_t _aws_iot_mqtt_session_store_ram_read_u16(const unsigned char *pBuf) {
+	return (uint16_t) ((pBuf[0] << 8) | pBuf[1]);
+}
+
+/**
+ * @brief Find the entry of a packet id
+ *
+ * Must be called with the store locked.
+ *
+ * @return Offset of the entry in the buffer, pRam->used if not stored
+ */
+static size_t _aws_iot_mqtt_session_store_ram_find(IoT_MQTT_Session_Store_Ram *pRam, uint16_t packetId) {
+	size_t offset = 0;
+
+	while(offset < pRam->used) {
+		if(packetId == _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset]))) {
+			break;
+		}
+		offset += SESSION_STORE_RAM_ENTRY_HEADER_LEN + _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset + 2]));
+	}
+
+	return offset;
+}
+
+/**
+ * @brief Drop an entry and close the gap it leaves
+ *
+ * Must be called with the store locked.
+ */
+static void _aws_iot_mqtt_session_store_ram_erase(IoT_MQTT_Session_Store_Ram *pRam, size_t offset) {
+	size_t entryLen;
+
+	if(offset >= pRam->used) {
+		return;
+	}
+
+	entryLen = SESSION_STORE_RAM_ENTRY_HEADER_LEN + _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset + 2]));
+	memmove(&(pRam->buf[offset]), &(pRam->buf[offset + entryLen]), pRam->used - offset - entryLen);
+	pRam->used -= entryLen;
+}
+
+static IoT_Error_t _aws_iot_mqtt_session_store_ram_save(void *pContext, uint16_t packetId,
+														const unsigned char *pPacket, size_t packetLen) {
+	IoT_MQTT_Session_Store_Ram *pRam = (IoT_MQTT_Session_Store_Ram *) pContext;
+	unsigned char *pEntry;
+
+	if(0xFFFF < packetLen) {
+		return MQTT_SESSION_STORE_FULL_ERROR;
+	}
+
+	_aws_iot_mqtt_session_store_ram_lock(pRam);
+
+	_aws_iot_mqtt_session_store_ram_erase(pRam, _aws_iot_mqtt_session_store_ram_find(pRam, packetId));
+
+	if(SESSION_STORE_RAM_ENTRY_HEADER_LEN + packetLen > AWS_IOT_MQTT_SESSION_STORE_RAM_LEN - pRam->used) {
+		_aws_iot_mqtt_session_store_ram_unlock(pRam);
+		return MQTT_SESSION_STORE_FULL_ERROR;
+	}
+
+	pEntry = &(pRam->buf[pRam->used]);
+	pEntry[0] = (unsigned char) (packetId >> 8);
+	pEntry[1] = (unsigned char) (packetId & 0xFF);
+	pEntry[2] = (unsigned char) (packetLen >> 8);
+	pEntry[3] = (unsigned char) (packetLen & 0xFF);
+	memcpy(&(pEntry[SESSION_STORE_RAM_ENTRY_HEADER_LEN]), pPacket, packetLen);
+	pRam->used += SESSION_STORE_RAM_ENTRY_HEADER_LEN + packetLen;
+
+	_aws_iot_mqtt_session_store_ram_unlock(pRam);
+
+	return SUCCESS;
+}
+
+static void _aws_iot_mqtt_session_store_ram_remove(void *pContext, uint16_t packetId) {
+	IoT_MQTT_Session_Store_Ram *pRam = (IoT_MQTT_Session_Store_Ram *) pContext;
+
+	_aws_iot_mqtt_session_store_ram_lock(pRam);
+	_aws_iot_mqtt_session_store_ram_erase(pRam, _aws_iot_mqtt_session_store_ram_find(pRam, packetId));
+	_aws_iot_mqtt_session_store_ram_unlock(pRam);
+}
+
+static IoT_Error_t _aws_iot_mqtt_session_store_ram_load(void *pContext, uint32_t index, uint16_t *pPacketId,
+														unsigned char *pBuf, size_t bufLen, size_t *pPacketLen) {
+	IoT_MQTT_Session_Store_Ram *pRam = (IoT_MQTT_Session_Store_Ram *) pContext;
+	size_t offset = 0;
+	size_t packetLen;
+	IoT_Error_t rc = SUCCESS;
+
+	*pPacketLen = 0;
+
+	_aws_iot_mqtt_session_store_ram_lock(pRam);
+
+	while(offset < pRam->used && 0 < index) {
+		offset += SESSION_STORE_RAM_ENTRY_HEADER_LEN + _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset + 2]));
+		index--;
+	}
+
+	if(offset < pRam->used) {
+		packetLen = _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset + 2]));
+		if(packetLen > bufLen) {
+			rc = MQTT_TX_BUFFER_TOO_SHORT_ERROR;
+		} else {
+			*pPacketId = _aws_iot_mqtt_session_store_ram_read_u16(&(pRam->buf[offset]));
+			memcpy(pBuf, &(pRam->buf[offset + SESSION_STORE_RAM_ENTRY_HEADER_LEN]), packetLen);
+			*pPacketLen = packetLen;
+		}
+	}
+
+	_aws_iot_mqtt_session_store_ram_unlock(pRam);
+
+	return rc;
+}
+
+IoT_Error_t aws_iot_mqtt_session_store_ram_init(IoT_MQTT_Session_Store *pStore, IoT_MQTT_Session_Store_Ram *pRam) {
+	IoT_Error_t rc = SUCCESS;
+
+	if(NULL == pStore || NULL == pRam) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pRam->used = 0;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_thread_mutex_init(&(pRam->lock));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+#endif
+
+	pStore->save = _aws_iot_mqtt_session_store_ram_save;
+	pStore->remove = _aws_iot_mqtt_session_store_ram_remove;
+	pStore->load = _aws_iot_mqtt_session_store_ram_load;
+	pStore->pContext = pRam;
+
+	return rc;
+}
+
+void aws_iot_mqtt_session_store_ram_destroy(IoT_MQTT_Session_Store_Ram *pRam) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if(NULL != pRam) {
+		(void)aws_iot_thread_mutex_destroy(&(pRam->lock));
+	}
+#else
+	IOT_UNUSED(pRam);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,452 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_standby.c
+ * @brief Hot-standby pair of MQTT clients
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "aws_iot_mqtt_standby.h"
+#include "aws_iot_log.h"
+
+static void _aws_iot_mqtt_standby_lock(IoT_MQTT_Standby_Pair *pPair) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pPair->lock));
+#else
+	IOT_UNUSED(pPair);
+#endif
+}
+
+static void _aws_iot_mqtt_standby_unlock(IoT_MQTT_Standby_Pair *pPair) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pPair->lock));
+#else
+	IOT_UNUSED(pPair);
+#endif
+}
+
+/* Errors that mean the connection of the client is gone, not the request */
+static bool _aws_iot_mqtt_standby_is_link_error(IoT_Error_t rc) {
+	switch(rc) {
+		case NETWORK_DISCONNECTED_ERROR:
+		case NETWORK_ATTEMPTING_RECONNECT:
+		case NETWORK_RECONNECT_TIMED_OUT_ERROR:
+		case NETWORK_MANUALLY_DISCONNECTED:
+		case NETWORK_SSL_WRITE_ERROR:
+		case NETWORK_SSL_WRITE_TIMEOUT_ERROR:
+		case NETWORK_SSL_READ_ERROR:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief Hand over to the standby after pFailed lost its connection
+ *
+ * Nothing changes if the standby isn't connected either, or if another task
+ * already failed over.
+ *
+ * @return true if the active client is no longer pFailed
+ */
+static bool _aws_iot_mqtt_standby_failover(IoT_MQTT_Standby_Pair *pPair, AWS_IoT_Client *pFailed) {
+	bool isSwitched;
+	uint8_t standbyIndex;
+
+	_aws_iot_mqtt_standby_lock(pPair);
+	standbyIndex = (uint8_t) (pPair->activeIndex ^ 1);
+	isSwitched = (pPair->pClients[pPair->activeIndex] != pFailed);
+	if(!isSwitched && aws_iot_mqtt_is_client_connected(pPair->pClients[standbyIndex])) {
+		IOT_WARN("Active client lost its connection, failing over to the standby");
+		pPair->activeIndex = standbyIndex;
+		pPair->failoverCount++;
+		isSwitched = true;
+	}
+	_aws_iot_mqtt_standby_unlock(pPair);
+
+	return isSwitched;
+}
+
+/* Active client, after failing over if it is down */
+static AWS_IoT_Client *_aws_iot_mqtt_standby_select(IoT_MQTT_Standby_Pair *pPair) {
+	AWS_IoT_Client *pClient = pPair->pClients[pPair->activeIndex];
+
+	if(!aws_iot_mqtt_is_client_connected(pClient) && _aws_iot_mqtt_standby_failover(pPair, pClient)) {
+		pClient = pPair->pClients[pPair->activeIndex];
+	}
+
+	return pClient;
+}
+
+/* Both connections get every message, only the active one passes it on */
+static void _aws_iot_mqtt_standby_deliver(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+										  IoT_Publish_Message_Params *pParams, void *pData) {
+	IoT_MQTT_Standby_Subscription *pSubscription = (IoT_MQTT_Standby_Subscription *) pData;
+	IoT_MQTT_Standby_Pair *pPair = pSubscription->pPair;
+
+	if(pClient != pPair->pClients[pPair->activeIndex] || NULL == pSubscription->pApplicationHandler) {
+		return;
+	}
+
+	pSubscription->pApplicationHandler(pClient, pTopicName, topicNameLen, pParams,
+									   pSubscription->pApplicationHandlerData);
+}
+
+static IoT_Error_t _aws_iot_mqtt_standby_subscribe_client(IoT_MQTT_Standby_Pair *pPair,
+														  IoT_MQTT_Standby_Subscription *pSubscription,
+														  uint8_t clientIndex) {
+	IoT_Error_t rc;
+
+	rc = aws_iot_mqtt_subscribe(pPair->pClients[clientIndex], pSubscription->pTopicName,
+								pSubscription->topicNameLen, pSubscription->qos,
+								_aws_iot_mqtt_standby_deliver, pSubscription);
+	if(SUCCESS == rc) {
+		pSubscription->subscribedMask |= (uint8_t) (1 << clientIndex);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Forget a QoS1 message the failed client stored but couldn't deliver
+ *
+ * It is sent again through the new active client, the failed one must not resend
+ * it from its session store after reconnecting.
+ */
+static void _aws_iot_mqtt_standby_forget(AWS_IoT_Client *pFailed, QoS qos, uint16_t packetId) {
+	const IoT_MQTT_Session_Store *pStore = pFailed->clientData.pSessionStore;
+
+	if(QOS1 == qos && 0 != packetId && NULL != pStore) {
+		pStore->remove(pStore->pContext, packetId);
+	}
+}
+
+/* Subscribe a standby that came up after the subscriptions were made */
+static void _aws_iot_mqtt_standby_complete_subscriptions(IoT_MQTT_Standby_Pair *pPair, uint8_t clientIndex) {
+	uint32_t itr;
+	IoT_MQTT_Standby_Subscription *pSubscription;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
+		pSubscription = &(pPair->subscriptions[itr]);
+		if(NULL == pSubscription->pApplicationHandler || (pSubscription->subscribedMask & (1 << clientIndex))) {
+			continue;
+		}
+		if(!aws_iot_mqtt_is_client_connected(pPair->pClients[clientIndex])) {
+			break;
+		}
+		if(SUCCESS != _aws_iot_mqtt_standby_subscribe_client(pPair, pSubscription, clientIndex)) {
+			/* Try again on the next yield */
+			break;
+		}
+	}
+}
+
+/* Yield the standby client, which reconnects it when it is down */
+static void _aws_iot_mqtt_standby_yield_standby(AWS_IoT_Client *pStandby, uint32_t timeout_ms) {
+	if(NETWORK_RECONNECT_TIMED_OUT_ERROR == aws_iot_mqtt_yield(pStandby, timeout_ms)) {
+		/* The standby is never given up on, keep retrying at the longest interval */
+		pStandby->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL;
+		countdown_ms(&(pStandby->reconnectDelayTimer), AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL);
+	}
+}
+
+IoT_Error_t aws_iot_mqtt_standby_init(IoT_MQTT_Standby_Pair *pPair, AWS_IoT_Client *pPrimary,
+									  AWS_IoT_Client *pStandby) {
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair || NULL == pPrimary || NULL == pStandby || pPrimary == pStandby) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memset(pPair->subscriptions, 0, sizeof(pPair->subscriptions));
+	pPair->pClients[0] = pPrimary;
+	pPair->pClients[1] = pStandby;
+	pPair->activeIndex = 0;
+	pPair->failoverCount = 0;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	pPair->reconnectWorkers = 0;
+	pPair->isStandbyReconnecting = false;
+	rc = aws_iot_thread_mutex_init(&(pPair->lock));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+	rc = aws_iot_thread_semaphore_init(&(pPair->reconnectSem));
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_destroy(&(pPair->lock));
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+
+	/* A failed client comes back as the standby through auto-reconnect */
+	(void)aws_iot_mqtt_autoreconnect_set_status(pPrimary, true);
+	(void)aws_iot_mqtt_autoreconnect_set_status(pStandby, true);
+
+	FUNC_EXIT_RC(rc);
+}
+
+void aws_iot_mqtt_standby_destroy(IoT_MQTT_Standby_Pair *pPair) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if(NULL != pPair) {
+		(void)aws_iot_thread_semaphore_destroy(&(pPair->reconnectSem));
+		(void)aws_iot_thread_mutex_destroy(&(pPair->lock));
+	}
+#else
+	IOT_UNUSED(pPair);
+#endif
+}
+
+AWS_IoT_Client *aws_iot_mqtt_standby_get_active(IoT_MQTT_Standby_Pair *pPair) {
+	if(NULL == pPair) {
+		return NULL;
+	}
+
+	return pPair->pClients[pPair->activeIndex];
+}
+
+uint32_t aws_iot_mqtt_standby_get_failover_count(IoT_MQTT_Standby_Pair *pPair) {
+	if(NULL == pPair) {
+		return 0;
+	}
+
+	return pPair->failoverCount;
+}
+
+IoT_Error_t aws_iot_mqtt_standby_subscribe(IoT_MQTT_Standby_Pair *pPair, const char *pTopicName,
+										   uint16_t topicNameLen, QoS qos,
+										   pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData) {
+	IoT_Error_t rc;
+	uint32_t itr;
+	uint8_t activeIndex;
+	IoT_MQTT_Standby_Subscription *pSubscription = NULL;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair || NULL == pTopicName || 0 == topicNameLen || NULL == pApplicationHandler) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
+		if(NULL == pPair->subscriptions[itr].pApplicationHandler) {
+			pSubscription = &(pPair->subscriptions[itr]);
+			break;
+		}
+	}
+	if(NULL == pSubscription) {
+		FUNC_EXIT_RC(MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR);
+	}
+
+	pSubscription->pPair = pPair;
+	pSubscription->pTopicName = pTopicName;
+	pSubscription->topicNameLen = topicNameLen;
+	pSubscription->qos = qos;
+	pSubscription->pApplicationHandlerData = pApplicationHandlerData;
+	pSubscription->subscribedMask = 0;
+
+	(void)_aws_iot_mqtt_standby_select(pPair);
+	activeIndex = pPair->activeIndex;
+	rc = _aws_iot_mqtt_standby_subscribe_client(pPair, pSubscription, activeIndex);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Taken from here on, the standby catches up in yield if it can't subscribe now */
+	pSubscription->pApplicationHandler = pApplicationHandler;
+	if(aws_iot_mqtt_is_client_connected(pPair->pClients[activeIndex ^ 1])) {
+		(void)_aws_iot_mqtt_standby_subscribe_client(pPair, pSubscription, (uint8_t) (activeIndex ^ 1));
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_standby_publish(IoT_MQTT_Standby_Pair *pPair, const char *pTopicName,
+										 uint16_t topicNameLen, IoT_Publish_Message_Params *pParams) {
+	IoT_Error_t rc;
+	AWS_IoT_Client *pClient;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair || NULL == pParams) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pClient = _aws_iot_mqtt_standby_select(pPair);
+	/* Set by the publish once the message has an id, a stale one must not be forgotten below */
+	pParams->id = 0;
+	rc = aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, pParams);
+	if(_aws_iot_mqtt_standby_is_link_error(rc) && _aws_iot_mqtt_standby_failover(pPair, pClient)) {
+		_aws_iot_mqtt_standby_forget(pClient, pParams->qos, pParams->id);
+		rc = aws_iot_mqtt_publish(pPair->pClients[pPair->activeIndex], pTopicName, topicNameLen, pParams);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+IoT_Error_t aws_iot_mqtt_standby_publish_with_template(IoT_MQTT_Standby_Pair *pPair,
+													   const IoT_Publish_Template *pTemplate,
+													   const void *pPayload, size_t payloadLen,
+													   uint16_t *pPacketId) {
+	IoT_Error_t rc;
+	AWS_IoT_Client *pClient;
+	uint16_t packetId = 0;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair || NULL == pTemplate) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pClient = _aws_iot_mqtt_standby_select(pPair);
+	rc = aws_iot_mqtt_publish_with_template(pClient, pTemplate, pPayload, payloadLen, &packetId);
+	if(_aws_iot_mqtt_standby_is_link_error(rc) && _aws_iot_mqtt_standby_failover(pPair, pClient)) {
+		_aws_iot_mqtt_standby_forget(pClient, pTemplate->qos, packetId);
+		packetId = 0;
+		rc = aws_iot_mqtt_publish_with_template(pPair->pClients[pPair->activeIndex], pTemplate, pPayload,
+												payloadLen, &packetId);
+	}
+	if(NULL != pPacketId) {
+		*pPacketId = packetId;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+IoT_Error_t aws_iot_mqtt_standby_yield(IoT_MQTT_Standby_Pair *pPair, uint32_t timeout_ms) {
+	IoT_Error_t rc;
+	AWS_IoT_Client *pActive;
+	AWS_IoT_Client *pStandby;
+	uint32_t standby_ms;
+	bool isInBackground;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair || 0 == timeout_ms) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	standby_ms = AWS_IOT_MQTT_STANDBY_YIELD_MS;
+	if(timeout_ms < 2 * standby_ms) {
+		standby_ms = (timeout_ms + 1) / 2;
+	}
+
+	pActive = _aws_iot_mqtt_standby_select(pPair);
+	rc = SUCCESS;
+	if(timeout_ms > standby_ms) {
+		rc = aws_iot_mqtt_yield(pActive, timeout_ms - standby_ms);
+		if(!aws_iot_mqtt_is_client_connected(pActive)) {
+			(void)_aws_iot_mqtt_standby_failover(pPair, pActive);
+		}
+	}
+
+	_aws_iot_mqtt_standby_lock(pPair);
+	pActive = pPair->pClients[pPair->activeIndex];
+	pStandby = pPair->pClients[pPair->activeIndex ^ 1];
+	isInBackground = false;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if(pPair->isStandbyReconnecting) {
+		isInBackground = true;
+	} else if(0 < pPair->reconnectWorkers && !aws_iot_mqtt_is_client_connected(pStandby)) {
+		/* Handshakes of the standby don't hold up the active client */
+		(void)aws_iot_thread_semaphore_post(&(pPair->reconnectSem));
+		isInBackground = true;
+	}
+#endif
+	_aws_iot_mqtt_standby_unlock(pPair);
+
+	if(!isInBackground) {
+		if(aws_iot_mqtt_is_client_connected(pStandby)) {
+			_aws_iot_mqtt_standby_complete_subscriptions(pPair, (uint8_t) (pPair->activeIndex ^ 1));
+		}
+		_aws_iot_mqtt_standby_yield_standby(pStandby, standby_ms);
+	}
+
+	if(aws_iot_mqtt_is_client_connected(pActive)) {
+		rc = SUCCESS;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+IoT_Error_t aws_iot_mqtt_standby_reconnect_run(IoT_MQTT_Standby_Pair *pPair, uint32_t timeout_ms) {
+	Timer timer;
+	AWS_IoT_Client *pStandby;
+	uint8_t standbyIndex;
+	uint32_t slice_ms;
+
+	FUNC_ENTRY;
+
+	if(NULL == pPair) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeout_ms);
+
+	_aws_iot_mqtt_standby_lock(pPair);
+	pPair->reconnectWorkers++;
+	_aws_iot_mqtt_standby_unlock(pPair);
+
+	while(!has_timer_expired(&timer)) {
+		_aws_iot_mqtt_standby_lock(pPair);
+		standbyIndex = (uint8_t) (pPair->activeIndex ^ 1);
+		pStandby = pPair->pClients[standbyIndex];
+		if(pPair->isStandbyReconnecting || aws_iot_mqtt_is_client_connected(pStandby)) {
+			pStandby = NULL;
+		} else {
+			pPair->isStandbyReconnecting = true;
+		}
+		_aws_iot_mqtt_standby_unlock(pPair);
+
+		if(NULL == pStandby) {
+			(void)aws_iot_thread_semaphore_wait(&(pPair->reconnectSem), left_ms(&timer));
+			continue;
+		}
+
+		/* Sleep until the next attempt is due, then make it */
+		while(!aws_iot_mqtt_is_client_connected(pStandby) && !has_timer_expired(&timer)) {
+			slice_ms = left_ms(&(pStandby->reconnectDelayTimer)) + AWS_IOT_MQTT_STANDBY_YIELD_MS;
+			if(slice_ms > left_ms(&timer)) {
+				slice_ms = left_ms(&timer);
+			}
+			_aws_iot_mqtt_standby_yield_standby(pStandby, (0 < slice_ms) ? slice_ms : 1);
+		}
+		if(aws_iot_mqtt_is_client_connected(pStandby)) {
+			_aws_iot_mqtt_standby_complete_subscriptions(pPair, standbyIndex);
+		}
+
+		_aws_iot_mqtt_standby_lock(pPair);
+		pPair->isStandbyReconnecting = false;
+		_aws_iot_mqtt_standby_unlock(pPair);
+	}
+
+	_aws_iot_mqtt_standby_lock(pPair);
+	pPair->reconnectWorkers--;
+	_aws_iot_mqtt_standby_unlock(pPair);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,562 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_network_capture.c
+ * @brief Capture of the decrypted byte stream of a network and its replay
+ *
+ * The capture swaps its own functions into the Network and finds itself again
+ * through Network::pCapture. The replay treats the read records of a connection
+ * as one byte stream, so the client may read it in other pieces than it was
+ * recorded in.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "aws_iot_network_capture.h"
+#include "aws_iot_log.h"
+
+#define CAPTURE_FORMAT_VERSION 1
+#define CAPTURE_MAX_RECORD_DATA 0xFFFFU
+
+static const unsigned char captureMagic[4] = { 'I', 'O', 'T', 'C' };
+
+static void _aws_iot_capture_put_u32(unsigned char *pBuf, uint32_t value) {
+	pBuf[0] = (unsigned char) (value & 0xFF);
+	pBuf[1] = (unsigned char) ((value >> 8) & 0xFF);
+	pBuf[2] = (unsigned char) ((value >> 16) & 0xFF);
+	pBuf[3] = (unsigned char) (value >> 24);
+}
+
+static uint32_t _aws_iot_capture_get_u32(const unsigned char *pBuf) {
+	return (uint32_t) pBuf[0] | ((uint32_t) pBuf[1] << 8) | ((uint32_t) pBuf[2] << 16) | ((uint32_t) pBuf[3] << 24);
+}
+
+static void _aws_iot_capture_lock(IoT_Network_Capture *pCapture) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_lock(&(pCapture->lock));
+#else
+	IOT_UNUSED(pCapture);
+#endif
+}
+
+static void _aws_iot_capture_unlock(IoT_Network_Capture *pCapture) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_unlock(&(pCapture->lock));
+#else
+	IOT_UNUSED(pCapture);
+#endif
+}
+
+/**
+ * @brief Hand a record to the sink
+ *
+ * Data longer than a record can hold is split over several records of the same type.
+ */
+static void _aws_iot_capture_record(IoT_Network_Capture *pCapture, IoT_Capture_Record_Type type,
+									const unsigned char *pData, size_t len) {
+	unsigned char header[AWS_IOT_CAPTURE_RECORD_HEADER_LEN];
+	size_t chunkLen;
+
+	_aws_iot_capture_lock(pCapture);
+	do {
+		if(SUCCESS != pCapture->sinkError) {
+			break;
+		}
+		chunkLen = len > CAPTURE_MAX_RECORD_DATA ? CAPTURE_MAX_RECORD_DATA : len;
+		header[0] = (unsigned char) type;
+		_aws_iot_capture_put_u32(&header[1], elapsed_ms(&(pCapture->clock)));
+		header[5] = (unsigned char) (chunkLen & 0xFF);
+		header[6] = (unsigned char) (chunkLen >> 8);
+		pCapture->sinkError = pCapture->sink(pCapture->pSinkData, header, sizeof(header));
+		if(SUCCESS == pCapture->sinkError && 0 < chunkLen) {
+			pCapture->sinkError = pCapture->sink(pCapture->pSinkData, pData, chunkLen);
+		}
+		if(SUCCESS != pCapture->sinkError) {
+			IOT_WARN("Network capture sink failed with %d, capture stopped recording", pCapture->sinkError);
+			break;
+		}
+		pCapture->recordCount++;
+		pData += chunkLen;
+		len -= chunkLen;
+	} while(0 < len);
+	_aws_iot_capture_unlock(pCapture);
+}
+
+static void _aws_iot_capture_record_rc(IoT_Network_Capture *pCapture, IoT_Capture_Record_Type type, IoT_Error_t rc) {
+	unsigned char data[4];
+
+	_aws_iot_capture_put_u32(data, (uint32_t) (int32_t) rc);
+	_aws_iot_capture_record(pCapture, type, data, sizeof(data));
+}
+
+/**
+ * @brief Record a read result
+ *
+ * Timeouts are not recorded, the replay recreates them from the timestamps.
+ */
+static void _aws_iot_capture_record_read(IoT_Network_Capture *pCapture, IoT_Error_t rc,
+										 const unsigned char *pMsg, const size_t *pReadLen) {
+	if(SUCCESS == rc) {
+		_aws_iot_capture_record(pCapture, IOT_CAPTURE_READ, pMsg, *pReadLen);
+	} else if(NETWORK_SSL_NOTHING_TO_READ != rc && NETWORK_SSL_READ_TIMEOUT_ERROR != rc) {
+		_aws_iot_capture_record_rc(pCapture, IOT_CAPTURE_READ_ERROR, rc);
+	}
+}
+
+static IoT_Error_t _aws_iot_capture_connect(Network *pNetwork, TLSConnectParams *pParams) {
+	IoT_Network_Capture *pCapture = pNetwork->pCapture;
+	IoT_Error_t rc = pCapture->connect(pNetwork, pParams);
+
+	_aws_iot_capture_record_rc(pCapture, IOT_CAPTURE_CONNECT, rc);
+	return rc;
+}
+
+static IoT_Error_t _aws_iot_capture_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										 size_t *pReadLen) {
+	IoT_Network_Capture *pCapture = pNetwork->pCapture;
+	IoT_Error_t rc = pCapture->read(pNetwork, pMsg, len, pTimer, pReadLen);
+
+	_aws_iot_capture_record_read(pCapture, rc, pMsg, pReadLen);
+	return rc;
+}
+
+static IoT_Error_t _aws_iot_capture_read_available(Network *pNetwork, unsigned char *pMsg, size_t len,
+												   Timer *pTimer, size_t *pReadLen) {
+	IoT_Network_Capture *pCapture = pNetwork->pCapture;
+	IoT_Error_t rc = pCapture->readAvailable(pNetwork, pMsg, len, pTimer, pReadLen);
+
+	_aws_iot_capture_record_read(pCapture, rc, pMsg, pReadLen);
+	return rc;
+}
+
+static IoT_Error_t _aws_iot_capture_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										  size_t *pWrittenLen) {
+	IoT_Network_Capture *pCapture = pNetwork->pCapture;
+	IoT_Error_t rc;
+
+	/* A failed write may not set it */
+	*pWrittenLen = 0;
+	rc = pCapture->write(pNetwork, pMsg, len, pTimer, pWrittenLen);
+
+	/* A failed write may still have sent part of the message */
+	if(0 < *pWrittenLen) {
+		_aws_iot_capture_record(pCapture, IOT_CAPTURE_WRITE, pMsg, *pWrittenLen);
+	}
+	return rc;
+}
+
+static IoT_Error_t _aws_iot_capture_disconnect(Network *pNetwork) {
+	IoT_Network_Capture *pCapture = pNetwork->pCapture;
+
+	_aws_iot_capture_record(pCapture, IOT_CAPTURE_DISCONNECT, NULL, 0);
+	return pCapture->disconnect(pNetwork);
+}
+
+IoT_Error_t aws_iot_network_capture_start(IoT_Network_Capture *pCapture, Network *pNetwork,
+										  iot_capture_sink sink, void *pSinkData) {
+	unsigned char header[AWS_IOT_CAPTURE_HEADER_LEN] = { 0 };
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pCapture || NULL == pNetwork || NULL == sink) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memcpy(header, captureMagic, sizeof(captureMagic));
+	header[4] = CAPTURE_FORMAT_VERSION;
+	rc = sink(pSinkData, header, sizeof(header));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	rc = aws_iot_thread_mutex_init(&(pCapture->lock));
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+#endif
+
+	pCapture->pNetwork = pNetwork;
+	pCapture->connect = pNetwork->connect;
+	pCapture->read = pNetwork->read;
+	pCapture->readAvailable = pNetwork->readAvailable;
+	pCapture->write = pNetwork->write;
+	pCapture->disconnect = pNetwork->disconnect;
+	pCapture->sink = sink;
+	pCapture->pSinkData = pSinkData;
+	pCapture->sinkError = SUCCESS;
+	pCapture->recordCount = 0;
+	init_timer(&(pCapture->clock));
+	countdown_ms(&(pCapture->clock), 0);
+
+	pNetwork->pCapture = pCapture;
+	pNetwork->connect = _aws_iot_capture_connect;
+	pNetwork->read = _aws_iot_capture_read;
+	if(NULL != pCapture->readAvailable) {
+		pNetwork->readAvailable = _aws_iot_capture_read_available;
+	}
+	pNetwork->write = _aws_iot_capture_write;
+	pNetwork->disconnect = _aws_iot_capture_disconnect;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_network_capture_stop(IoT_Network_Capture *pCapture) {
+	Network *pNetwork;
+
+	FUNC_ENTRY;
+
+	if(NULL == pCapture || NULL == pCapture->pNetwork) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pNetwork = pCapture->pNetwork;
+	pNetwork->connect = pCapture->connect;
+	pNetwork->read = pCapture->read;
+	pNetwork->readAvailable = pCapture->readAvailable;
+	pNetwork->write = pCapture->write;
+	pNetwork->disconnect = pCapture->disconnect;
+	pNetwork->pCapture = NULL;
+	pCapture->pNetwork = NULL;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_mutex_destroy(&(pCapture->lock));
+#endif
+
+	FUNC_EXIT_RC(pCapture->sinkError);
+}
+
+IoT_Error_t aws_iot_network_capture_file_sink(void *pSinkData, const unsigned char *pBuf, size_t len) {
+	if(NULL == pSinkData || len != fwrite(pBuf, 1, len, (FILE *) pSinkData)) {
+		return NETWORK_CAPTURE_WRITE_ERROR;
+	}
+	return SUCCESS;
+}
+
+/**
+ * @brief Read the record header at an offset of the capture
+ *
+ * @return false if no complete record starts there
+ */
+static bool _aws_iot_replay_parse(const IoT_Network_Replay *pReplay, size_t position, uint8_t *pType,
+								  uint32_t *pTimeMs, uint16_t *pLen) {
+	const unsigned char *pRecord = &(pReplay->pCapture[position]);
+
+	if(position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN > pReplay->captureLen) {
+		return false;
+	}
+	*pType = pRecord[0];
+	*pTimeMs = _aws_iot_capture_get_u32(&pRecord[1]);
+	*pLen = (uint16_t) (pRecord[5] | (pRecord[6] << 8));
+
+	return position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN + *pLen <= pReplay->captureLen;
+}
+
+static void _aws_iot_replay_next_record(IoT_Network_Replay *pReplay, uint16_t recordLen) {
+	pReplay->position += AWS_IOT_CAPTURE_RECORD_HEADER_LEN + recordLen;
+	pReplay->recordOffset = 0;
+}
+
+/**
+ * @brief What the client can read right now
+ *
+ * Skips the records reads don't see. Leaves the position on a read error record,
+ * so that waiting for it doesn't consume it.
+ *
+ * @param pReplay Replay state
+ * @param ppData Set to the unread bytes of the current read record
+ * @param pLen Set to their number
+ * @param pWaitMs Set to the time until the next read record is due, 0 if nothing more comes
+ *
+ * @return SUCCESS with data, the recorded error of a due read error record, or
+ * NETWORK_SSL_NOTHING_TO_READ
+ */
+static IoT_Error_t _aws_iot_replay_peek(IoT_Network_Replay *pReplay, const unsigned char **ppData, size_t *pLen,
+										uint32_t *pWaitMs) {
+	uint8_t type;
+	uint32_t timeMs, elapsedMs, dueMs;
+	uint16_t recordLen;
+	const unsigned char *pRecordData;
+
+	*pWaitMs = 0;
+	while(pReplay->isConnected && _aws_iot_replay_parse(pReplay, pReplay->position, &type, &timeMs, &recordLen)) {
+		pRecordData = &(pReplay->pCapture[pReplay->position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN]);
+
+		if(IOT_CAPTURE_CONNECT == type) {
+			/* The recorded connection ended, the rest belongs to the next connect */
+			break;
+		}
+		if((IOT_CAPTURE_READ != type && IOT_CAPTURE_READ_ERROR != type) ||
+		   (IOT_CAPTURE_READ == type && pReplay->recordOffset >= recordLen) ||
+		   (IOT_CAPTURE_READ_ERROR == type && 4 > recordLen)) {
+			_aws_iot_replay_next_record(pReplay, recordLen);
+			continue;
+		}
+
+		if(pReplay->isRealTime) {
+			elapsedMs = elapsed_ms(&(pReplay->clock));
+			dueMs = timeMs - pReplay->connectTimeMs;
+			if(elapsedMs < dueMs) {
+				*pWaitMs = dueMs - elapsedMs;
+				return NETWORK_SSL_NOTHING_TO_READ;
+			}
+		}
+
+		if(IOT_CAPTURE_READ_ERROR == type) {
+			return (IoT_Error_t) (int32_t) _aws_iot_capture_get_u32(pRecordData);
+		}
+		*ppData = &pRecordData[pReplay->recordOffset];
+		*pLen = recordLen - pReplay->recordOffset;
+		return SUCCESS;
+	}
+
+	return NETWORK_SSL_NOTHING_TO_READ;
+}
+
+/**
+ * @brief Move past bytes handed to the client, or past a read error that was returned
+ */
+static void _aws_iot_replay_consume(IoT_Network_Replay *pReplay, size_t len) {
+	uint8_t type;
+	uint32_t timeMs;
+	uint16_t recordLen;
+
+	if(!_aws_iot_replay_parse(pReplay, pReplay->position, &type, &timeMs, &recordLen)) {
+		return;
+	}
+	pReplay->recordOffset += len;
+	pReplay->bytesRead += len;
+	if(IOT_CAPTURE_READ != type || pReplay->recordOffset >= recordLen) {
+		_aws_iot_replay_next_record(pReplay, recordLen);
+	}
+}
+
+/**
+ * @brief Sleep until the next read record is due or the timer expires
+ */
+static void _aws_iot_replay_wait(uint32_t waitMs, Timer *pTimer) {
+	uint32_t leftMs = left_ms(pTimer);
+
+	if(0 == waitMs || leftMs < waitMs) {
+		waitMs = leftMs;
+	}
+	/* At least 1 ms, the timer may be less than that from expiring */
+	delay(0 < waitMs ? waitMs : 1);
+}
+
+static IoT_Error_t _aws_iot_replay_connect(Network *pNetwork, TLSConnectParams *pParams) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+	uint8_t type;
+	uint32_t timeMs;
+	uint16_t recordLen;
+	IoT_Error_t rc;
+
+	IOT_UNUSED(pParams);
+
+	while(_aws_iot_replay_parse(pReplay, pReplay->position, &type, &timeMs, &recordLen)) {
+		if(IOT_CAPTURE_CONNECT == type && 4 <= recordLen) {
+			rc = (IoT_Error_t) (int32_t) _aws_iot_capture_get_u32(
+					&(pReplay->pCapture[pReplay->position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN]));
+			_aws_iot_replay_next_record(pReplay, recordLen);
+			pReplay->connectTimeMs = timeMs;
+			init_timer(&(pReplay->clock));
+			countdown_ms(&(pReplay->clock), 0);
+			pReplay->isConnected = (SUCCESS == rc);
+			return rc;
+		}
+		_aws_iot_replay_next_record(pReplay, recordLen);
+	}
+
+	pReplay->isConnected = false;
+	return NETWORK_ERR_NET_CONNECT_FAILED;
+}
+
+static IoT_Error_t _aws_iot_replay_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										size_t *pReadLen) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+	const unsigned char *pData = NULL;
+	size_t available = 0;
+	size_t total = 0;
+	uint32_t waitMs;
+	IoT_Error_t rc;
+
+	while(total < len) {
+		rc = _aws_iot_replay_peek(pReplay, &pData, &available, &waitMs);
+		if(SUCCESS == rc) {
+			available = available < len - total ? available : len - total;
+			memcpy(&pMsg[total], pData, available);
+			_aws_iot_replay_consume(pReplay, available);
+			total += available;
+			continue;
+		}
+		if(NETWORK_SSL_NOTHING_TO_READ != rc) {
+			_aws_iot_replay_consume(pReplay, 0);
+			return rc;
+		}
+		if(has_timer_expired(pTimer)) {
+			break;
+		}
+		_aws_iot_replay_wait(waitMs, pTimer);
+	}
+
+	if(total == len) {
+		*pReadLen = total;
+		return SUCCESS;
+	}
+	return 0 == total ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _aws_iot_replay_read_available(Network *pNetwork, unsigned char *pMsg, size_t len,
+												  Timer *pTimer, size_t *pReadLen) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+	const unsigned char *pData = NULL;
+	size_t available = 0;
+	size_t total = 0;
+	uint32_t waitMs;
+	IoT_Error_t rc;
+
+	while(total < len) {
+		rc = _aws_iot_replay_peek(pReplay, &pData, &available, &waitMs);
+		if(SUCCESS == rc) {
+			available = available < len - total ? available : len - total;
+			memcpy(&pMsg[total], pData, available);
+			_aws_iot_replay_consume(pReplay, available);
+			total += available;
+			continue;
+		}
+		if(0 < total) {
+			/* Hand over what arrived, an error comes with the next read */
+			break;
+		}
+		if(NETWORK_SSL_NOTHING_TO_READ != rc) {
+			_aws_iot_replay_consume(pReplay, 0);
+			return rc;
+		}
+		if(has_timer_expired(pTimer)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		_aws_iot_replay_wait(waitMs, pTimer);
+	}
+
+	*pReadLen = total;
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_replay_wait_for_readable(Network *pNetwork, Timer *pTimer) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+	const unsigned char *pData = NULL;
+	size_t available = 0;
+	uint32_t waitMs;
+
+	while(NETWORK_SSL_NOTHING_TO_READ == _aws_iot_replay_peek(pReplay, &pData, &available, &waitMs)) {
+		if(has_timer_expired(pTimer)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		_aws_iot_replay_wait(waitMs, pTimer);
+	}
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_replay_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										 size_t *pWrittenLen) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+
+	IOT_UNUSED(pMsg);
+	IOT_UNUSED(pTimer);
+
+	pReplay->bytesWritten += len;
+	*pWrittenLen = len;
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_replay_disconnect(Network *pNetwork) {
+	IoT_Network_Replay *pReplay = (IoT_Network_Replay *) pNetwork->pTransportData;
+
+	pReplay->isConnected = false;
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_replay_is_connected(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static IoT_Error_t _aws_iot_replay_destroy(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_network_replay_init(Network *pNetwork, IoT_Network_Replay *pReplay,
+										const unsigned char *pCapture, size_t captureLen, bool isRealTime) {
+	uint8_t type;
+	uint32_t timeMs;
+	uint16_t recordLen;
+
+	FUNC_ENTRY;
+
+	if(NULL == pNetwork || NULL == pReplay || NULL == pCapture) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+	if(AWS_IOT_CAPTURE_HEADER_LEN > captureLen || 0 != memcmp(pCapture, captureMagic, sizeof(captureMagic)) ||
+	   CAPTURE_FORMAT_VERSION != pCapture[4]) {
+		FUNC_EXIT_RC(NETWORK_CAPTURE_FORMAT_ERROR);
+	}
+
+	memset(pReplay, 0, sizeof(IoT_Network_Replay));
+	pReplay->pCapture = pCapture;
+	pReplay->captureLen = captureLen;
+	pReplay->position = AWS_IOT_CAPTURE_HEADER_LEN;
+	pReplay->isRealTime = isRealTime;
+	pReplay->isConnected = false;
+
+	/* Remember where the last record a client can consume ends, for aws_iot_network_replay_is_done */
+	pReplay->streamEnd = pReplay->position;
+	while(_aws_iot_replay_parse(pReplay, pReplay->position, &type, &timeMs, &recordLen)) {
+		pReplay->position += AWS_IOT_CAPTURE_RECORD_HEADER_LEN + recordLen;
+		if(IOT_CAPTURE_READ == type || IOT_CAPTURE_READ_ERROR == type || IOT_CAPTURE_CONNECT == type) {
+			pReplay->streamEnd = pReplay->position;
+		}
+	}
+	pReplay->position = AWS_IOT_CAPTURE_HEADER_LEN;
+
+	pNetwork->connect = _aws_iot_replay_connect;
+	pNetwork->read = _aws_iot_replay_read;
+	pNetwork->readAvailable = _aws_iot_replay_read_available;
+	pNetwork->waitForReadable = _aws_iot_replay_wait_for_readable;
+	pNetwork->wakeUp = NULL; /* Replayed time can't be cut short */
+	pNetwork->write = _aws_iot_replay_write;
+	pNetwork->disconnect = _aws_iot_replay_disconnect;
+	pNetwork->isConnected = _aws_iot_replay_is_connected;
+	pNetwork->destroy = _aws_iot_replay_destroy;
+	pNetwork->pTransportData = pReplay;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+bool aws_iot_network_replay_is_done(const IoT_Network_Replay *pReplay) {
+	return NULL == pReplay || pReplay->position >= pReplay->streamEnd;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,459 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_network_loopback.c
+ * @brief In-memory duplex transport
+ *
+ * head and tail count bytes since the link was set up and only grow, their
+ * difference is what the ring holds. The writer publishes its bytes by storing
+ * head with release, the reader frees their room by storing tail with release,
+ * each loads the other's counter with acquire.
+ *
+ * A delayed or rate limited direction also queues the head and due time of
+ * every write in inFlight. The reader only moves readable, its limit, past a
+ * write once it is due, so head itself stays the writer's business.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "aws_iot_network_loopback.h"
+#include "aws_iot_log.h"
+
+static uint32_t _aws_iot_loopback_now_ms(IoT_Network_Loopback *pLink) {
+	return elapsed_ms(&(pLink->clock));
+}
+
+static bool _aws_iot_loopback_is_shaped(const IoT_Network_Loopback *pLink) {
+	return 0 < pLink->latencyMs || 0 < pLink->bytesPerSec;
+}
+
+static void _aws_iot_loopback_post_data(IoT_Loopback_Ring *pRing) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_semaphore_post(&(pRing->dataSem));
+#else
+	IOT_UNUSED(pRing);
+#endif
+}
+
+static void _aws_iot_loopback_post_room(IoT_Loopback_Ring *pRing) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	(void)aws_iot_thread_semaphore_post(&(pRing->roomSem));
+#else
+	IOT_UNUSED(pRing);
+#endif
+}
+
+static bool _aws_iot_loopback_peer_left(IoT_Loopback_Endpoint *pEnd) {
+	IoT_Network_Loopback *pLink = pEnd->pLink;
+	IoT_Loopback_Endpoint *pPeer = &(pLink->ends[pEnd == &(pLink->ends[0]) ? 1 : 0]);
+
+	return pEnd->peerDisconnectCount != __atomic_load_n(&(pPeer->disconnectCount), __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Bytes the reader of a ring may take now
+ *
+ * Moves readable past every write that is due by now.
+ */
+static size_t _aws_iot_loopback_readable(IoT_Network_Loopback *pLink, IoT_Loopback_Ring *pRing) {
+	IoT_Loopback_In_Flight *pWrite;
+	uint32_t inFlightHead, inFlightTail, nowMs;
+
+	if(!_aws_iot_loopback_is_shaped(pLink)) {
+		return __atomic_load_n(&(pRing->head), __ATOMIC_ACQUIRE) - pRing->tail;
+	}
+
+	nowMs = _aws_iot_loopback_now_ms(pLink);
+	inFlightHead = __atomic_load_n(&(pRing->inFlightHead), __ATOMIC_ACQUIRE);
+	inFlightTail = pRing->inFlightTail;
+	while(pRing->inFlightTail != inFlightHead) {
+		pWrite = &(pRing->inFlight[pRing->inFlightTail % AWS_IOT_LOOPBACK_MAX_IN_FLIGHT]);
+		if((int32_t) (nowMs - pWrite->dueMs) < 0) {
+			break;
+		}
+		pRing->readable = pWrite->end;
+		__atomic_store_n(&(pRing->inFlightTail), pRing->inFlightTail + 1, __ATOMIC_RELEASE);
+	}
+	if(inFlightTail != pRing->inFlightTail) {
+		/* A writer may wait for room in the in-flight queue */
+		_aws_iot_loopback_post_room(pRing);
+	}
+
+	return pRing->readable - pRing->tail;
+}
+
+static size_t _aws_iot_loopback_take(IoT_Loopback_Ring *pRing, unsigned char *pMsg, size_t len) {
+	size_t offset = pRing->tail % pRing->size;
+	size_t firstLen = pRing->size - offset < len ? pRing->size - offset : len;
+
+	memcpy(pMsg, &(pRing->pBuf[offset]), firstLen);
+	memcpy(&pMsg[firstLen], pRing->pBuf, len - firstLen);
+	__atomic_store_n(&(pRing->tail), pRing->tail + len, __ATOMIC_RELEASE);
+	_aws_iot_loopback_post_room(pRing);
+
+	return len;
+}
+
+/**
+ * @brief Copy what fits of a write into a ring
+ *
+ * @return Bytes accepted, 0 while the ring or, if shaped, the in-flight queue is full
+ */
+static size_t _aws_iot_loopback_put(IoT_Network_Loopback *pLink, IoT_Loopback_Ring *pRing,
+									const unsigned char *pMsg, size_t len) {
+	IoT_Loopback_In_Flight *pWrite;
+	size_t room = pRing->size - (pRing->head - __atomic_load_n(&(pRing->tail), __ATOMIC_ACQUIRE));
+	size_t offset = pRing->head % pRing->size;
+	size_t firstLen;
+	uint64_t nowUs;
+	bool isShaped = _aws_iot_loopback_is_shaped(pLink);
+
+	if(isShaped && AWS_IOT_LOOPBACK_MAX_IN_FLIGHT
+				   <= pRing->inFlightHead - __atomic_load_n(&(pRing->inFlightTail), __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+
+	len = room < len ? room : len;
+	if(0 == len) {
+		return 0;
+	}
+	firstLen = pRing->size - offset < len ? pRing->size - offset : len;
+	memcpy(&(pRing->pBuf[offset]), pMsg, firstLen);
+	memcpy(pRing->pBuf, &pMsg[firstLen], len - firstLen);
+	__atomic_store_n(&(pRing->head), pRing->head + len, __ATOMIC_RELEASE);
+
+	if(isShaped) {
+		/* The link sends one write after the other at its rate, each then takes the latency to arrive */
+		nowUs = (uint64_t) _aws_iot_loopback_now_ms(pLink) * 1000;
+		if(pRing->sentUs < nowUs) {
+			pRing->sentUs = nowUs;
+		}
+		if(0 < pLink->bytesPerSec) {
+			pRing->sentUs += (uint64_t) len * 1000000 / pLink->bytesPerSec;
+		}
+		pWrite = &(pRing->inFlight[pRing->inFlightHead % AWS_IOT_LOOPBACK_MAX_IN_FLIGHT]);
+		pWrite->end = pRing->head;
+		pWrite->dueMs = (uint32_t) ((pRing->sentUs + 999) / 1000) + pLink->latencyMs;
+		__atomic_store_n(&(pRing->inFlightHead), pRing->inFlightHead + 1, __ATOMIC_RELEASE);
+	}
+	_aws_iot_loopback_post_data(pRing);
+
+	return len;
+}
+
+/**
+ * @brief Sleep until the other end posts, the next write in flight is due or the timer expires
+ *
+ * May return early, the caller checks again what it waits for.
+ *
+ * @param isReader Waits for data in pRing, otherwise for room
+ */
+static void _aws_iot_loopback_sleep(IoT_Network_Loopback *pLink, IoT_Loopback_Ring *pRing, bool isReader,
+									Timer *pTimer) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Loopback_In_Flight *pWrite;
+	uint32_t waitMs = left_ms(pTimer);
+	int32_t dueInMs;
+
+	if(isReader && _aws_iot_loopback_is_shaped(pLink)
+	   && pRing->inFlightTail != __atomic_load_n(&(pRing->inFlightHead), __ATOMIC_ACQUIRE)) {
+		pWrite = &(pRing->inFlight[pRing->inFlightTail % AWS_IOT_LOOPBACK_MAX_IN_FLIGHT]);
+		dueInMs = (int32_t) (pWrite->dueMs - _aws_iot_loopback_now_ms(pLink));
+		if(dueInMs < (int32_t) waitMs) {
+			waitMs = 0 < dueInMs ? (uint32_t) dueInMs : 0;
+		}
+	}
+	if(0 < waitMs) {
+		(void)aws_iot_thread_semaphore_wait(isReader ? &(pRing->dataSem) : &(pRing->roomSem), waitMs);
+	}
+#else
+	/* Nothing to sleep on, the other end may run on a task of its own all the same */
+	IOT_UNUSED(pLink);
+	IOT_UNUSED(pRing);
+	IOT_UNUSED(isReader);
+	IOT_UNUSED(pTimer);
+	delay(1);
+#endif
+}
+
+static IoT_Error_t _aws_iot_loopback_connect(Network *pNetwork, TLSConnectParams *pParams) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+	IoT_Network_Loopback *pLink = pEnd->pLink;
+	IoT_Loopback_Endpoint *pPeer = &(pLink->ends[pEnd == &(pLink->ends[0]) ? 1 : 0]);
+
+	IOT_UNUSED(pParams);
+
+	pEnd->peerDisconnectCount = __atomic_load_n(&(pPeer->disconnectCount), __ATOMIC_ACQUIRE);
+	pEnd->isConnected = true;
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_loopback_read_available(Network *pNetwork, unsigned char *pMsg, size_t len,
+													Timer *pTimer, size_t *pReadLen) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+	size_t available;
+	bool peerLeft;
+
+	if(!pEnd->isConnected) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	for(;;) {
+		/* Seen before the ring is checked, so that what the peer wrote before leaving is read first */
+		peerLeft = _aws_iot_loopback_peer_left(pEnd);
+		available = _aws_iot_loopback_readable(pEnd->pLink, pEnd->pRx);
+		if(0 < available) {
+			break;
+		}
+		if(peerLeft && pEnd->pRx->tail == __atomic_load_n(&(pEnd->pRx->head), __ATOMIC_ACQUIRE)) {
+			return NETWORK_SSL_READ_ERROR;
+		}
+		if(has_timer_expired(pTimer)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		_aws_iot_loopback_sleep(pEnd->pLink, pEnd->pRx, true, pTimer);
+	}
+
+	*pReadLen = _aws_iot_loopback_take(pEnd->pRx, pMsg, available < len ? available : len);
+	pEnd->bytesRead += *pReadLen;
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_loopback_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										  size_t *pReadLen) {
+	size_t total = 0;
+	size_t chunkLen = 0;
+	IoT_Error_t rc;
+
+	while(total < len) {
+		rc = _aws_iot_loopback_read_available(pNetwork, &pMsg[total], len - total, pTimer, &chunkLen);
+		if(NETWORK_SSL_NOTHING_TO_READ == rc) {
+			break;
+		}
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		total += chunkLen;
+	}
+
+	if(total == len) {
+		*pReadLen = total;
+		return SUCCESS;
+	}
+	return 0 == total ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _aws_iot_loopback_wait_for_readable(Network *pNetwork, Timer *pTimer) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+
+	while(0 == _aws_iot_loopback_readable(pEnd->pLink, pEnd->pRx)) {
+		if(!pEnd->isConnected || _aws_iot_loopback_peer_left(pEnd)) {
+			/* The read that follows reports it */
+			break;
+		}
+		if(__atomic_exchange_n(&(pEnd->isWakeUpPending), false, __ATOMIC_ACQ_REL) || has_timer_expired(pTimer)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		_aws_iot_loopback_sleep(pEnd->pLink, pEnd->pRx, true, pTimer);
+	}
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_loopback_wake_up(Network *pNetwork) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+
+	__atomic_store_n(&(pEnd->isWakeUpPending), true, __ATOMIC_RELEASE);
+	_aws_iot_loopback_post_data(pEnd->pRx);
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_loopback_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+										   size_t *pWrittenLen) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+	size_t total = 0;
+	size_t chunkLen;
+
+	*pWrittenLen = 0;
+	if(!pEnd->isConnected || _aws_iot_loopback_peer_left(pEnd)) {
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+
+	while(total < len) {
+		chunkLen = _aws_iot_loopback_put(pEnd->pLink, pEnd->pTx, &pMsg[total], len - total);
+		total += chunkLen;
+		if(0 < chunkLen) {
+			continue;
+		}
+		if(_aws_iot_loopback_peer_left(pEnd)) {
+			break;
+		}
+		if(has_timer_expired(pTimer)) {
+			break;
+		}
+		_aws_iot_loopback_sleep(pEnd->pLink, pEnd->pTx, false, pTimer);
+	}
+
+	pEnd->bytesWritten += total;
+	*pWrittenLen = total;
+	if(total == len) {
+		return SUCCESS;
+	}
+	return _aws_iot_loopback_peer_left(pEnd) ? NETWORK_SSL_WRITE_ERROR : NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _aws_iot_loopback_disconnect(Network *pNetwork) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+	IoT_Loopback_Ring *pRx = pEnd->pRx;
+	uint32_t inFlightHead;
+	size_t head;
+
+	if(!pEnd->isConnected) {
+		return SUCCESS;
+	}
+	pEnd->isConnected = false;
+
+	/* Drop what was not read, the writer may go on adding to the ring meanwhile. Every queued
+	 * write loaded here ends at or before the head loaded after it. */
+	inFlightHead = __atomic_load_n(&(pRx->inFlightHead), __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&(pRx->head), __ATOMIC_ACQUIRE);
+	pRx->readable = head;
+	__atomic_store_n(&(pRx->inFlightTail), inFlightHead, __ATOMIC_RELEASE);
+	__atomic_store_n(&(pRx->tail), head, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&(pEnd->disconnectCount), 1, __ATOMIC_RELEASE);
+	/* Every wait on the link checks again, the peer's ones see it left */
+	_aws_iot_loopback_post_data(pEnd->pTx);
+	_aws_iot_loopback_post_room(pEnd->pRx);
+	_aws_iot_loopback_post_data(pRx);
+	_aws_iot_loopback_post_room(pEnd->pTx);
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_loopback_is_connected(Network *pNetwork) {
+	IoT_Loopback_Endpoint *pEnd = (IoT_Loopback_Endpoint *) pNetwork->pTransportData;
+
+	if(!pEnd->isConnected || _aws_iot_loopback_peer_left(pEnd)) {
+		return NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+	}
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static IoT_Error_t _aws_iot_loopback_destroy(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_network_loopback_init(IoT_Network_Loopback *pLink, unsigned char *pBufAToB,
+										  unsigned char *pBufBToA, size_t bufLen, uint32_t latencyMs,
+										  uint32_t bytesPerSec) {
+	int endItr;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	int ringItr;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pLink || NULL == pBufAToB || NULL == pBufBToA || 0 == bufLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memset(pLink, 0, sizeof(IoT_Network_Loopback));
+	pLink->rings[0].pBuf = pBufAToB;
+	pLink->rings[1].pBuf = pBufBToA;
+	pLink->rings[0].size = bufLen;
+	pLink->rings[1].size = bufLen;
+	for(endItr = 0; endItr < 2; endItr++) {
+		pLink->ends[endItr].pLink = pLink;
+		pLink->ends[endItr].pTx = &(pLink->rings[endItr]);
+		pLink->ends[endItr].pRx = &(pLink->rings[1 - endItr]);
+	}
+	pLink->latencyMs = latencyMs;
+	pLink->bytesPerSec = bytesPerSec;
+	init_timer(&(pLink->clock));
+	countdown_ms(&(pLink->clock), 0);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	for(ringItr = 0; ringItr < 2; ringItr++) {
+		if(SUCCESS != aws_iot_thread_semaphore_init(&(pLink->rings[ringItr].dataSem))) {
+			break;
+		}
+		if(SUCCESS != aws_iot_thread_semaphore_init(&(pLink->rings[ringItr].roomSem))) {
+			(void)aws_iot_thread_semaphore_destroy(&(pLink->rings[ringItr].dataSem));
+			break;
+		}
+	}
+	if(2 > ringItr) {
+		while(0 < ringItr--) {
+			(void)aws_iot_thread_semaphore_destroy(&(pLink->rings[ringItr].dataSem));
+			(void)aws_iot_thread_semaphore_destroy(&(pLink->rings[ringItr].roomSem));
+		}
+		FUNC_EXIT_RC(SEMAPHORE_INIT_ERROR);
+	}
+#endif
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_network_loopback_attach(Network *pNetwork, IoT_Network_Loopback *pLink, IoT_Loopback_End end) {
+	FUNC_ENTRY;
+
+	if(NULL == pNetwork || NULL == pLink || (IOT_LOOPBACK_END_A != end && IOT_LOOPBACK_END_B != end)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pNetwork->connect = _aws_iot_loopback_connect;
+	pNetwork->read = _aws_iot_loopback_read;
+	pNetwork->readAvailable = _aws_iot_loopback_read_available;
+	pNetwork->waitForReadable = _aws_iot_loopback_wait_for_readable;
+	pNetwork->wakeUp = _aws_iot_loopback_wake_up;
+	pNetwork->write = _aws_iot_loopback_write;
+	pNetwork->disconnect = _aws_iot_loopback_disconnect;
+	pNetwork->isConnected = _aws_iot_loopback_is_connected;
+	pNetwork->destroy = _aws_iot_loopback_destroy;
+	pNetwork->pTransportData = &(pLink->ends[end]);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_network_loopback_free(IoT_Network_Loopback *pLink) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	int ringItr;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pLink) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	for(ringItr = 0; ringItr < 2; ringItr++) {
+		(void)aws_iot_thread_semaphore_destroy(&(pLink->rings[ringItr].dataSem));
+		(void)aws_iot_thread_semaphore_destroy(&(pLink->rings[ringItr].roomSem));
+	}
+#endif
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#ifdef __cplusplus
+}
+#endif
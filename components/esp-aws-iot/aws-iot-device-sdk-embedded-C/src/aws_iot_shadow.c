@@ -164,7 +164,8 @@ IoT_Error_t aws_iot_shadow_yield(AWS_IoT_Client *pClient, uint32_t timeout) {
 	}
 
 	HandleExpiredResponseCallbacks();
-	return aws_iot_mqtt_yield(pClient, timeout);
+	/* Yield sleeps while the network is idle, come back in time to report the next timeout */
+	return aws_iot_mqtt_yield(pClient, limitToNextResponseTimeout(timeout));
 }
 
 IoT_Error_t aws_iot_shadow_disconnect(AWS_IoT_Client *pClient) {
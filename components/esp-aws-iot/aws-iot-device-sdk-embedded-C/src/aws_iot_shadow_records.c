@@ -86,6 +86,29 @@ bool shadowDiscardOldDeltaFlag = true;
 static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName,
 							  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData);
 
+/**
+ * @brief Shorten a wait so it ends when the next pending response times out
+ *
+ * @param timeout_ms Wait the caller intends
+ *
+ * @return timeout_ms, or less if a response times out earlier, but never 0 unless timeout_ms was
+ */
+uint32_t limitToNextResponseTimeout(uint32_t timeout_ms) {
+	uint8_t i;
+	uint32_t left;
+
+	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
+		if(!AckWaitList[i].isFree) {
+			left = left_ms(&(AckWaitList[i].timer));
+			if(left < timeout_ms) {
+				timeout_ms = (0 < left) ? left : 1;
+			}
+		}
+	}
+
+	return timeout_ms;
+}
+
 static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 								  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData);
 
@@ -0,0 +1,153 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_trace.c
+ * @brief Binary event trace rings
+ *
+ * Tasks on the same core can preempt each other, so a writer reserves its slot with an
+ * atomic increment of the ring head rather than relying on being alone on the core.
+ * Each slot carries the sequence number it was reserved with, published last; a reader
+ * only keeps a slot whose sequence is the expected one before and after copying it.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "aws_iot_trace.h"
+
+#ifndef DISABLE_IOT_TRACE_RING
+
+#define TRACE_DUMP_VERSION 1
+#define TRACE_RING_MASK (AWS_IOT_TRACE_RING_LEN - 1)
+
+/** One recorded event. Sequence 0 marks a slot being written or never used. */
+typedef struct {
+	uint32_t sequence;
+	uint32_t timestampUs;
+	uint32_t client;
+	int32_t arg;
+	uint16_t eventId;
+	uint8_t core;
+} TraceRecord;
+
+typedef struct {
+	uint32_t head;
+	TraceRecord records[AWS_IOT_TRACE_RING_LEN];
+} TraceRing;
+
+static TraceRing traceRings[AWS_IOT_TRACE_MAX_CORES];
+
+static void _aws_iot_trace_put_u16(unsigned char *pBuf, uint16_t value) {
+	pBuf[0] = (unsigned char) (value & 0xFF);
+	pBuf[1] = (unsigned char) (value >> 8);
+}
+
+static void _aws_iot_trace_put_u32(unsigned char *pBuf, uint32_t value) {
+	pBuf[0] = (unsigned char) (value & 0xFF);
+	pBuf[1] = (unsigned char) ((value >> 8) & 0xFF);
+	pBuf[2] = (unsigned char) ((value >> 16) & 0xFF);
+	pBuf[3] = (unsigned char) (value >> 24);
+}
+
+void aws_iot_trace_record(uint16_t eventId, const void *pClient, int32_t arg) {
+	uint32_t core = aws_iot_trace_core_id();
+	TraceRing *pRing;
+	TraceRecord *pRecord;
+	uint32_t sequence;
+
+	pRing = &traceRings[core % AWS_IOT_TRACE_MAX_CORES];
+	/* Sequences start at 1 so that 0 can mean "not readable" */
+	sequence = __atomic_add_fetch(&(pRing->head), 1, __ATOMIC_RELAXED);
+	if(0 == sequence) {
+		sequence = __atomic_add_fetch(&(pRing->head), 1, __ATOMIC_RELAXED);
+	}
+	pRecord = &(pRing->records[(sequence - 1) & TRACE_RING_MASK]);
+
+	__atomic_store_n(&(pRecord->sequence), 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	pRecord->timestampUs = aws_iot_trace_timestamp_us();
+	pRecord->client = (uint32_t) (uintptr_t) pClient;
+	pRecord->arg = arg;
+	pRecord->eventId = eventId;
+	pRecord->core = (uint8_t) core;
+	__atomic_store_n(&(pRecord->sequence), sequence, __ATOMIC_RELEASE);
+}
+
+size_t aws_iot_trace_dump(unsigned char *pBuf, size_t bufLen) {
+	TraceRecord record;
+	uint32_t ringItr, sequence, head, first, recordCount = 0;
+	size_t offset = AWS_IOT_TRACE_DUMP_HEADER_LEN;
+
+	if(NULL == pBuf || bufLen < AWS_IOT_TRACE_DUMP_HEADER_LEN) {
+		return 0;
+	}
+
+	for(ringItr = 0; ringItr < AWS_IOT_TRACE_MAX_CORES; ringItr++) {
+		head = __atomic_load_n(&(traceRings[ringItr].head), __ATOMIC_ACQUIRE);
+		first = (head > AWS_IOT_TRACE_RING_LEN) ? head - AWS_IOT_TRACE_RING_LEN + 1 : 1;
+
+		for(sequence = first; sequence != head + 1; sequence++) {
+			TraceRecord *pRecord = &(traceRings[ringItr].records[(sequence - 1) & TRACE_RING_MASK]);
+
+			if(offset + AWS_IOT_TRACE_DUMP_RECORD_LEN > bufLen) {
+				break;
+			}
+
+			if(sequence != __atomic_load_n(&(pRecord->sequence), __ATOMIC_ACQUIRE)) {
+				/* Still being written, or already overwritten by a newer event */
+				continue;
+			}
+			record = *pRecord;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if(sequence != __atomic_load_n(&(pRecord->sequence), __ATOMIC_RELAXED)) {
+				continue;
+			}
+
+			_aws_iot_trace_put_u32(&pBuf[offset], sequence);
+			_aws_iot_trace_put_u32(&pBuf[offset + 4], record.timestampUs);
+			_aws_iot_trace_put_u32(&pBuf[offset + 8], record.client);
+			_aws_iot_trace_put_u32(&pBuf[offset + 12], (uint32_t) record.arg);
+			_aws_iot_trace_put_u16(&pBuf[offset + 16], record.eventId);
+			pBuf[offset + 18] = record.core;
+			pBuf[offset + 19] = (unsigned char) ringItr;
+			offset += AWS_IOT_TRACE_DUMP_RECORD_LEN;
+			recordCount++;
+		}
+	}
+
+	memcpy(pBuf, "IOTT", 4);
+	pBuf[4] = TRACE_DUMP_VERSION;
+	pBuf[5] = AWS_IOT_TRACE_DUMP_RECORD_LEN;
+	pBuf[6] = AWS_IOT_TRACE_MAX_CORES;
+	pBuf[7] = 0;
+	_aws_iot_trace_put_u32(&pBuf[8], recordCount);
+	_aws_iot_trace_put_u32(&pBuf[12], aws_iot_trace_timestamp_us());
+
+	return offset;
+}
+
+void aws_iot_trace_reset(void) {
+	memset(traceRings, 0, sizeof(traceRings));
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
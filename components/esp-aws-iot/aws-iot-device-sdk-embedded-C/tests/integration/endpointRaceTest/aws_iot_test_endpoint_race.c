@@ -0,0 +1,299 @@
+/*
+ * aws_iot_test_endpoint_race.c
+ *
+ * Races endpoint lists of the mbedTLS network layer against listening
+ * sockets on the loopback interface, each endpoint on a port of its own:
+ * - one that refuses the connection
+ * - one that never completes the TCP connect, its accept queue is full
+ * - two that accept and close at once, so the TLS handshake fails fast
+ *
+ * The handshake never succeeds, the test checks which endpoint won the TCP
+ * race and how long that took. Needs nothing but loopback, the credentials
+ * are the mbedTLS test certificates (MBEDTLS_CERTS_C).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "aws_iot_log.h"
+#include "network_interface.h"
+
+#include "aws_iot_integ_tests_config.h"
+#include "aws_iot_config.h"
+
+/* Head start of each endpoint, far above a TCP connect on loopback */
+#define RACE_TEST_DELAY_MS 200
+#define RACE_TEST_TIMEOUT_MS 5000
+
+typedef enum {
+	RACE_TEST_OPEN_A,
+	RACE_TEST_OPEN_B,
+	RACE_TEST_STALLED,
+	RACE_TEST_REFUSED,
+	RACE_TEST_PORT_COUNT
+} RaceTestPort;
+
+typedef struct {
+	int listenFds[RACE_TEST_PORT_COUNT];
+	uint16_t ports[RACE_TEST_PORT_COUNT];
+	/* Fills the accept queue of the stalled port */
+	int stallFd;
+	int wakeFds[2];
+} RaceTestServer;
+
+static RaceTestServer server;
+
+/* Listens on an ephemeral loopback port, a backlog of 0 stalls every connect once one is queued */
+static int aws_iot_race_tests_listen(int backlog, uint16_t *pPort) {
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(0 > fd || 0 != bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || 0 != listen(fd, backlog)
+	   || 0 != getsockname(fd, (struct sockaddr *) &addr, &addrLen)) {
+		IOT_ERROR("Listening on loopback failed\n");
+		if(0 <= fd) {
+			close(fd);
+		}
+		return -1;
+	}
+
+	*pPort = ntohs(addr.sin_port);
+	return fd;
+}
+
+/* Accepts on the open ports and closes at once, until a byte arrives on the wake pipe */
+static void *aws_iot_race_tests_server_runner(void *ptr) {
+	struct pollfd fds[3];
+	int fd;
+	int i;
+
+	(void)ptr;
+	fds[0].fd = server.listenFds[RACE_TEST_OPEN_A];
+	fds[1].fd = server.listenFds[RACE_TEST_OPEN_B];
+	fds[2].fd = server.wakeFds[0];
+	for(i = 0; i < 3; i++) {
+		fds[i].events = POLLIN;
+	}
+
+	for(;;) {
+		if(0 > poll(fds, 3, -1)) {
+			continue;
+		}
+		if(0 != fds[2].revents) {
+			break;
+		}
+		for(i = 0; i < 2; i++) {
+			if(0 != (fds[i].revents & POLLIN)) {
+				fd = accept(fds[i].fd, NULL, NULL);
+				if(0 <= fd) {
+					close(fd);
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static int aws_iot_race_tests_server_init(void) {
+	struct sockaddr_in addr;
+	int i;
+
+	server.stallFd = -1;
+	server.wakeFds[0] = -1;
+	server.wakeFds[1] = -1;
+	server.listenFds[RACE_TEST_OPEN_A] = aws_iot_race_tests_listen(16, &server.ports[RACE_TEST_OPEN_A]);
+	server.listenFds[RACE_TEST_OPEN_B] = aws_iot_race_tests_listen(16, &server.ports[RACE_TEST_OPEN_B]);
+	server.listenFds[RACE_TEST_STALLED] = aws_iot_race_tests_listen(0, &server.ports[RACE_TEST_STALLED]);
+	/* Nobody listens on a port that was just given up */
+	server.listenFds[RACE_TEST_REFUSED] = aws_iot_race_tests_listen(16, &server.ports[RACE_TEST_REFUSED]);
+	if(0 <= server.listenFds[RACE_TEST_REFUSED]) {
+		close(server.listenFds[RACE_TEST_REFUSED]);
+	}
+	server.listenFds[RACE_TEST_REFUSED] = -1;
+
+	for(i = 0; i < RACE_TEST_REFUSED; i++) {
+		if(0 > server.listenFds[i]) {
+			return -1;
+		}
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(server.ports[RACE_TEST_STALLED]);
+	server.stallFd = socket(AF_INET, SOCK_STREAM, 0);
+	if(0 > server.stallFd || 0 != connect(server.stallFd, (struct sockaddr *) &addr, sizeof(addr))) {
+		IOT_ERROR("Filling the accept queue failed\n");
+		return -1;
+	}
+
+	return pipe(server.wakeFds);
+}
+
+static void aws_iot_race_tests_server_free(void) {
+	int i;
+
+	for(i = 0; i < RACE_TEST_PORT_COUNT; i++) {
+		if(0 <= server.listenFds[i]) {
+			close(server.listenFds[i]);
+		}
+	}
+	if(0 <= server.stallFd) {
+		close(server.stallFd);
+	}
+	for(i = 0; i < 2; i++) {
+		if(0 <= server.wakeFds[i]) {
+			close(server.wakeFds[i]);
+		}
+	}
+}
+
+static double aws_iot_race_tests_elapsed_ms(struct timespec *pStart, struct timespec *pEnd) {
+	return (double) (pEnd->tv_sec - pStart->tv_sec) * 1000.0 + (double) (pEnd->tv_nsec - pStart->tv_nsec) / 1000000.0;
+}
+
+/*
+ * Connects through the endpoint list and checks that expectedWinner won the
+ * TCP race within [minMs, maxMs).
+ */
+static int aws_iot_race_tests_run(const char *pName, Network *pNetwork, TLSEndpoint *pEndpoints, uint8_t count,
+								  uint8_t expectedWinner, double minMs, double maxMs) {
+	struct timespec start, end;
+	uint8_t winner;
+	double wallMs;
+
+	pNetwork->tlsConnectParams.pEndpoints = pEndpoints;
+	pNetwork->tlsConnectParams.endpointCount = count;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	/* Every server closes instead of answering the ClientHello, only the TCP race can succeed */
+	(void)iot_tls_connect(pNetwork, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	iot_tls_destroy(pNetwork);
+
+	winner = pNetwork->tlsConnectParams.preferredEndpoint;
+	wallMs = aws_iot_race_tests_elapsed_ms(&start, &end);
+	printf("%-36s winner %u port %5u in %7.2f ms\n", pName, winner, pNetwork->tlsConnectParams.DestinationPort,
+		   wallMs);
+
+	if(expectedWinner != winner || pEndpoints[winner].DestinationPort != pNetwork->tlsConnectParams.DestinationPort
+	   || wallMs < minMs || wallMs >= maxMs) {
+		IOT_ERROR("%s: expected endpoint %u within %.0f to %.0f ms\n", pName, expectedWinner, minMs, maxMs);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int aws_iot_race_tests_run_all(void) {
+	Network network;
+	TLSEndpoint refusedFirst[2];
+	TLSEndpoint stalledFirst[3];
+	int rc = 0;
+
+	iot_tls_init(&network, mbedtls_test_cas_pem, mbedtls_test_cli_crt_ec, mbedtls_test_cli_key_ec,
+				 "localhost", server.ports[RACE_TEST_OPEN_A], RACE_TEST_TIMEOUT_MS, true);
+	network.tlsConnectParams.rootCALen = mbedtls_test_cas_pem_len;
+	network.tlsConnectParams.deviceCertLen = mbedtls_test_cli_crt_ec_len;
+	network.tlsConnectParams.devicePrivateKeyLen = mbedtls_test_cli_key_ec_len;
+	network.tlsConnectParams.endpointRaceDelay_ms = RACE_TEST_DELAY_MS;
+
+	/* A refused endpoint hands on to the next one without its head start */
+	refusedFirst[0].pDestinationURL = "127.0.0.1";
+	refusedFirst[0].DestinationPort = server.ports[RACE_TEST_REFUSED];
+	refusedFirst[0].lastConnectMs = 0;
+	refusedFirst[1].pDestinationURL = "localhost";
+	refusedFirst[1].DestinationPort = server.ports[RACE_TEST_OPEN_A];
+	refusedFirst[1].lastConnectMs = 0;
+	network.tlsConnectParams.preferredEndpoint = 0;
+	if(0 != aws_iot_race_tests_run("Refused endpoint first", &network, refusedFirst, 2, 1, 0,
+								   RACE_TEST_DELAY_MS / 2)) {
+		rc = -1;
+	}
+
+	/* A stalled endpoint keeps its head start, then the next one overtakes it */
+	stalledFirst[0].pDestinationURL = "127.0.0.1";
+	stalledFirst[0].DestinationPort = server.ports[RACE_TEST_STALLED];
+	stalledFirst[0].lastConnectMs = 0;
+	stalledFirst[1].pDestinationURL = "localhost";
+	stalledFirst[1].DestinationPort = server.ports[RACE_TEST_OPEN_A];
+	stalledFirst[1].lastConnectMs = 0;
+	stalledFirst[2].pDestinationURL = "localhost";
+	stalledFirst[2].DestinationPort = server.ports[RACE_TEST_OPEN_B];
+	stalledFirst[2].lastConnectMs = 0;
+	network.tlsConnectParams.preferredEndpoint = 0;
+	if(0 != aws_iot_race_tests_run("Stalled endpoint first", &network, stalledFirst, 3, 1, RACE_TEST_DELAY_MS,
+								   RACE_TEST_DELAY_MS * 2)) {
+		rc = -1;
+	}
+
+	/* The winner starts first on the next connect and needs no head start */
+	if(0 != aws_iot_race_tests_run("Last winner first", &network, stalledFirst, 3, 1, 0, RACE_TEST_DELAY_MS / 2)) {
+		rc = -1;
+	}
+
+	/* Behind a stalled preferred endpoint, the one that connected faster last time goes next */
+	stalledFirst[1].lastConnectMs = 200;
+	stalledFirst[2].lastConnectMs = 50;
+	network.tlsConnectParams.preferredEndpoint = 0;
+	if(0 != aws_iot_race_tests_run("Faster last connect next", &network, stalledFirst, 3, 2, RACE_TEST_DELAY_MS,
+								   RACE_TEST_DELAY_MS * 2)) {
+		rc = -1;
+	}
+
+	/* One that never connected goes after those that did */
+	stalledFirst[1].lastConnectMs = 0;
+	network.tlsConnectParams.preferredEndpoint = 0;
+	if(0 != aws_iot_race_tests_run("Unmeasured endpoint last", &network, stalledFirst, 3, 2, RACE_TEST_DELAY_MS,
+								   RACE_TEST_DELAY_MS * 2)) {
+		rc = -1;
+	}
+
+	iot_tls_free(&network);
+
+	return rc;
+}
+
+int main() {
+	pthread_t serverThread;
+	int rc;
+
+	printf("\n\n");
+	printf("******************************************************************\n");
+	printf("* Starting Endpoint Race Test                                    *\n");
+	printf("******************************************************************\n");
+
+	rc = aws_iot_race_tests_server_init();
+	if(0 == rc) {
+		pthread_create(&serverThread, NULL, aws_iot_race_tests_server_runner, NULL);
+		rc = aws_iot_race_tests_run_all();
+		(void)write(server.wakeFds[1], "x", 1);
+		pthread_join(serverThread, NULL);
+	}
+	aws_iot_race_tests_server_free();
+
+	if(0 != rc) {
+		printf("\n*******************************************************************\n");
+		printf("* Endpoint Race Test FAILED!                                       \n");
+		printf("*******************************************************************\n");
+		return 1;
+	}
+
+	printf("\n******************************************************************\n");
+	printf("* Endpoint Race Test SUCCESS!!                                   *\n");
+	printf("******************************************************************\n");
+
+	return 0;
+}
@@ -33,6 +33,39 @@
 /* Interval that each thread sleeps for */
 #define THREAD_SLEEP_INTERVAL_USEC 500000
 
+/* Number of publishing threads in the multi-threading benchmark */
+#define BENCHMARK_PUB_THREAD_COUNT 8
+
+/* Number of QoS1 messages each benchmark thread publishes, back to back */
+#define BENCHMARK_PUBLISH_COUNT 200
+
+/* Full, and again resumed, TLS handshakes measured per server key and TLS profile in the handshake benchmark */
+#define HANDSHAKE_BENCHMARK_ROUNDS 20
+
+/* Loopback port of the local mbedTLS server of the handshake benchmark */
+#define HANDSHAKE_BENCHMARK_PORT 18884
+
+/* Clients driven by the reactor in the epoll reactor test */
+#define REACTOR_TEST_CLIENT_COUNT 4
+
+/* Reactor worker threads in the epoll reactor test, as many clients are dropped at once */
+#define REACTOR_TEST_WORKER_COUNT 2
+
+/* Number of QoS1 messages each client publishes per round of the epoll reactor test */
+#define REACTOR_TEST_PUBLISH_COUNT 20
+
+/* Loopback port of the local MQTT broker of the epoll reactor test */
+#define REACTOR_TEST_PORT 18885
+
+/* QoS1 messages published over each transport in the transport overhead benchmark */
+#define TRANSPORT_BENCHMARK_PUBLISH_COUNT 200
+
+/* Payload bytes of each message of the transport overhead benchmark */
+#define TRANSPORT_BENCHMARK_PAYLOAD_LEN 64
+
+/* Loopback port of the local MQTT broker of the transport overhead benchmark */
+#define TRANSPORT_BENCHMARK_PORT 18886
+
 /* Test topic to publish on */
 #define INTEGRATION_TEST_TOPIC "Tests/Integration/EmbeddedC"
 
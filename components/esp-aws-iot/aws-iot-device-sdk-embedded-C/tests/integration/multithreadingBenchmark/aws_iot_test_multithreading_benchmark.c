@@ -0,0 +1,301 @@
+/*
+ * aws_iot_test_multithreading_benchmark.c
+ *
+ * Stress benchmark for concurrent QoS1 publishes. One thread owns the network
+ * read side by calling yield in a loop, BENCHMARK_PUB_THREAD_COUNT threads
+ * publish back to back. Reports publish latency and aggregate throughput and
+ * checks every message came back on the subscription.
+ *
+ * Built with ENABLE_IOT_FULL_DUPLEX by the Makefile. Building it without the
+ * flag gives the numbers of the one-operation-at-a-time client for comparison.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_log.h"
+
+#include "aws_iot_integ_tests_config.h"
+#include "aws_iot_config.h"
+
+#define BUFFER_SIZE 100
+
+static volatile bool terminate_yield_thread;
+
+static unsigned int rxCountArray[BENCHMARK_PUB_THREAD_COUNT][BENCHMARK_PUBLISH_COUNT];
+static unsigned long latencyUsec[BENCHMARK_PUB_THREAD_COUNT][BENCHMARK_PUBLISH_COUNT];
+static unsigned int failedPublishCount[BENCHMARK_PUB_THREAD_COUNT];
+static unsigned int notIdleRetryCount[BENCHMARK_PUB_THREAD_COUNT];
+static unsigned int rxUnexpectedNumberCounter;
+
+typedef struct ThreadData {
+	int threadId;
+	AWS_IoT_Client *client;
+} ThreadData;
+
+static unsigned long aws_iot_mqtt_tests_elapsed_usec(struct timeval *pStart, struct timeval *pEnd) {
+	struct timeval diff;
+
+	timersub(pEnd, pStart, &diff);
+	return (unsigned long) diff.tv_sec * 1000000UL + (unsigned long) diff.tv_usec;
+}
+
+static int aws_iot_mqtt_tests_compare_ulong(const void *a, const void *b) {
+	unsigned long x = *(const unsigned long *) a;
+	unsigned long y = *(const unsigned long *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void aws_iot_mqtt_tests_benchmark_aggregator(AWS_IoT_Client *pClient, char *topicName,
+													uint16_t topicNameLen, IoT_Publish_Message_Params *params,
+													void *pData) {
+	char tempBuf[BUFFER_SIZE];
+	unsigned int tempRow = 0, tempCol = 0;
+
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	if(BUFFER_SIZE < params->payloadLen) {
+		rxUnexpectedNumberCounter++;
+		return;
+	}
+
+	snprintf(tempBuf, params->payloadLen, "%s", (char *) params->payload);
+	if(2 != sscanf(tempBuf, "Bench %u %u", &tempRow, &tempCol)) {
+		rxUnexpectedNumberCounter++;
+		return;
+	}
+
+	if(tempRow < BENCHMARK_PUB_THREAD_COUNT && tempCol < BENCHMARK_PUBLISH_COUNT) {
+		rxCountArray[tempRow][tempCol]++;
+	} else {
+		IOT_ERROR(" \nUnexpected Thread : %u, Message : %u ", tempRow, tempCol);
+		rxUnexpectedNumberCounter++;
+	}
+}
+
+static void aws_iot_mqtt_tests_disconnect_callback_handler(AWS_IoT_Client *pClient, void *param) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(param);
+}
+
+static void *aws_iot_mqtt_tests_yield_thread_runner(void *ptr) {
+	IoT_Error_t rc = SUCCESS;
+	AWS_IoT_Client *pClient = (AWS_IoT_Client *) ptr;
+
+	while(false == terminate_yield_thread) {
+		rc = aws_iot_mqtt_yield(pClient, 100);
+		if(SUCCESS != rc && MQTT_CLIENT_NOT_IDLE_ERROR != rc) {
+			IOT_ERROR("\nYield Returned : %d ", rc);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void *aws_iot_mqtt_tests_publish_thread_runner(void *ptr) {
+	int itr = 0;
+	char cPayload[BUFFER_SIZE];
+	IoT_Publish_Message_Params params;
+	IoT_Error_t rc = SUCCESS;
+	ThreadData *threadData = (ThreadData *) ptr;
+	AWS_IoT_Client *pClient = threadData->client;
+	int threadId = threadData->threadId;
+	struct timeval start, end;
+
+	for(itr = 0; itr < BENCHMARK_PUBLISH_COUNT; itr++) {
+		snprintf(cPayload, BUFFER_SIZE, "Bench %d %d", threadId, itr);
+		params.payload = (void *) cPayload;
+		params.payloadLen = strlen(cPayload) + 1;
+		params.qos = QOS1;
+		params.isRetained = 0;
+
+		/* Latency includes time spent waiting for the client to become idle,
+		 * which is what a caller experiences without full-duplex support */
+		gettimeofday(&start, NULL);
+		do {
+			rc = aws_iot_mqtt_publish(pClient, INTEGRATION_TEST_TOPIC, strlen(INTEGRATION_TEST_TOPIC), &params);
+			if(MQTT_CLIENT_NOT_IDLE_ERROR == rc || MUTEX_LOCK_ERROR == rc) {
+				notIdleRetryCount[threadId]++;
+				usleep(1000);
+			}
+		} while(MQTT_CLIENT_NOT_IDLE_ERROR == rc || MUTEX_LOCK_ERROR == rc);
+		gettimeofday(&end, NULL);
+
+		latencyUsec[threadId][itr] = aws_iot_mqtt_tests_elapsed_usec(&start, &end);
+		if(SUCCESS != rc) {
+			IOT_WARN("\nPublish failed Thread : %d, Msg : %d --> %d\n", threadId, itr, rc);
+			failedPublishCount[threadId]++;
+		}
+	}
+
+	return NULL;
+}
+
+int aws_iot_mqtt_tests_multi_threading_benchmark() {
+	pthread_t publish_thread[BENCHMARK_PUB_THREAD_COUNT], yield_thread;
+	char certDirectory[15] = "../../certs";
+	char clientCRT[PATH_MAX + 1];
+	char clientKey[PATH_MAX + 1];
+	char CurrentWD[PATH_MAX + 1];
+	char root_CA[PATH_MAX + 1];
+
+	char clientId[50];
+	IoT_Client_Init_Params initParams = IoT_Client_Init_Params_initializer;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	ThreadData threadData[BENCHMARK_PUB_THREAD_COUNT];
+	AWS_IoT_Client client;
+	IoT_Error_t rc = SUCCESS;
+	struct timeval start, end;
+	static unsigned long sortedLatency[BENCHMARK_PUB_THREAD_COUNT * BENCHMARK_PUBLISH_COUNT];
+	unsigned long long latencySum = 0;
+	unsigned long wallUsec;
+	unsigned int failedCount = 0, retryCount = 0;
+	int i, j, total, rxMsgCount = 0, waitSec = 0;
+	float percentOfRxMsg;
+
+	memset(rxCountArray, 0, sizeof(rxCountArray));
+	memset(failedPublishCount, 0, sizeof(failedPublishCount));
+	memset(notIdleRetryCount, 0, sizeof(notIdleRetryCount));
+	rxUnexpectedNumberCounter = 0;
+	terminate_yield_thread = false;
+
+	getcwd(CurrentWD, sizeof(CurrentWD));
+	snprintf(root_CA, PATH_MAX + 1, "%s/%s/%s", CurrentWD, certDirectory, AWS_IOT_ROOT_CA_FILENAME);
+	snprintf(clientCRT, PATH_MAX + 1, "%s/%s/%s", CurrentWD, certDirectory, AWS_IOT_CERTIFICATE_FILENAME);
+	snprintf(clientKey, PATH_MAX + 1, "%s/%s/%s", CurrentWD, certDirectory, AWS_IOT_PRIVATE_KEY_FILENAME);
+	srand((unsigned int) time(NULL));
+	snprintf(clientId, 50, "%s_%d", INTEGRATION_TEST_CLIENT_ID, rand() % 10000);
+
+	initParams.pHostURL = AWS_IOT_MQTT_HOST;
+	initParams.port = AWS_IOT_MQTT_PORT;
+	initParams.pRootCALocation = root_CA;
+	initParams.pDeviceCertLocation = clientCRT;
+	initParams.pDevicePrivateKeyLocation = clientKey;
+	initParams.mqttCommandTimeout_ms = 10000;
+	initParams.tlsHandshakeTimeout_ms = 10000;
+	initParams.disconnectHandler = aws_iot_mqtt_tests_disconnect_callback_handler;
+	initParams.enableAutoReconnect = false;
+	initParams.isBlockOnThreadLockEnabled = true;
+	rc = aws_iot_mqtt_init(&client, &initParams);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Initializing %d\n", rc);
+		return -1;
+	}
+
+	connectParams.keepAliveIntervalInSec = 10;
+	connectParams.isCleanSession = true;
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = (char *) &clientId;
+	connectParams.clientIDLen = strlen(clientId);
+	connectParams.isWillMsgPresent = false;
+
+	rc = aws_iot_mqtt_connect(&client, &connectParams);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Connecting %d\n", rc);
+		return -1;
+	}
+
+	rc = aws_iot_mqtt_subscribe(&client, INTEGRATION_TEST_TOPIC, strlen(INTEGRATION_TEST_TOPIC), QOS1,
+								aws_iot_mqtt_tests_benchmark_aggregator, NULL);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Subscribing %d\n", rc);
+		return -1;
+	}
+
+	printf("\nRunning Benchmark! %d threads x %d QoS1 messages\n", BENCHMARK_PUB_THREAD_COUNT,
+		   BENCHMARK_PUBLISH_COUNT);
+
+	pthread_create(&yield_thread, NULL, aws_iot_mqtt_tests_yield_thread_runner, &client);
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < BENCHMARK_PUB_THREAD_COUNT; i++) {
+		threadData[i].client = &client;
+		threadData[i].threadId = i;
+		pthread_create(&publish_thread[i], NULL, aws_iot_mqtt_tests_publish_thread_runner, &threadData[i]);
+	}
+	for(i = 0; i < BENCHMARK_PUB_THREAD_COUNT; i++) {
+		pthread_join(publish_thread[i], NULL);
+	}
+	gettimeofday(&end, NULL);
+	wallUsec = aws_iot_mqtt_tests_elapsed_usec(&start, &end);
+
+	total = BENCHMARK_PUB_THREAD_COUNT * BENCHMARK_PUBLISH_COUNT;
+
+	/* Give the broker a moment to deliver the last messages back to us */
+	do {
+		rxMsgCount = 0;
+		for(i = 0; i < BENCHMARK_PUB_THREAD_COUNT; i++) {
+			for(j = 0; j < BENCHMARK_PUBLISH_COUNT; j++) {
+				if(rxCountArray[i][j] > 0) {
+					rxMsgCount++;
+				}
+			}
+		}
+		if(rxMsgCount < total) {
+			sleep(1);
+		}
+	} while(rxMsgCount < total && ++waitSec < 5);
+
+	terminate_yield_thread = true;
+	pthread_join(yield_thread, NULL);
+
+	for(i = 0; i < BENCHMARK_PUB_THREAD_COUNT; i++) {
+		failedCount += failedPublishCount[i];
+		retryCount += notIdleRetryCount[i];
+		for(j = 0; j < BENCHMARK_PUBLISH_COUNT; j++) {
+			sortedLatency[i * BENCHMARK_PUBLISH_COUNT + j] = latencyUsec[i][j];
+			latencySum += latencyUsec[i][j];
+		}
+	}
+	qsort(sortedLatency, total, sizeof(sortedLatency[0]), aws_iot_mqtt_tests_compare_ulong);
+
+	printf("\n\nResult : \n");
+	printf("Publish latency (ms): min %.2f avg %.2f p50 %.2f p99 %.2f max %.2f\n",
+		   sortedLatency[0] / 1000.0, (double) latencySum / total / 1000.0,
+		   sortedLatency[total / 2] / 1000.0, sortedLatency[(total * 99) / 100] / 1000.0,
+		   sortedLatency[total - 1] / 1000.0);
+	printf("Throughput: %.1f acknowledged publishes/s over %.2f s\n",
+		   (total - failedCount) * 1000000.0 / wallUsec, wallUsec / 1000000.0);
+	printf("Client busy retries: %u, failed publishes: %u\n", retryCount, failedCount);
+
+	percentOfRxMsg = (float) rxMsgCount * 100 / total;
+	printf("Published Messages: %d , Received Messages: %d (%f %%)\n", total, rxMsgCount, percentOfRxMsg);
+
+	aws_iot_mqtt_disconnect(&client);
+
+	if(RX_RECEIVE_PERCENTAGE > percentOfRxMsg || 0 != failedCount || 0 != rxUnexpectedNumberCounter) {
+		return -2;
+	}
+
+	return 0;
+}
+
+int main() {
+	printf("\n\n");
+	printf("******************************************************************\n");
+	printf("* Starting MQTT Version 3.1.1 Multithreading Benchmark           *\n");
+	printf("******************************************************************\n");
+	int rc = aws_iot_mqtt_tests_multi_threading_benchmark();
+	if(0 != rc) {
+		printf("\n*******************************************************************\n");
+		printf("*MQTT Version 3.1.1 Multithreading Benchmark FAILED! RC : %d \n", rc);
+		printf("*******************************************************************\n");
+		return 1;
+	}
+
+	printf("******************************************************************\n");
+	printf("* MQTT Version 3.1.1 Multithreading Benchmark SUCCESS!!          *\n");
+	printf("******************************************************************\n");
+
+	return 0;
+}
@@ -0,0 +1,697 @@
+/*
+ * aws_iot_test_reactor.c
+ *
+ * Drives REACTOR_TEST_CLIENT_COUNT clients with the epoll reactor against a
+ * minimal MQTT 3.1.1 broker on the loopback interface, over the plain TCP
+ * transport. Every client subscribes to a topic of its own and the others
+ * publish to it with aws_iot_mqtt_publish_async, so each message has to wake
+ * the reactor.
+ *
+ * The broker then drops as many clients as the reactor has workers and holds
+ * back the CONNACK of their reconnects. The remaining clients must keep
+ * exchanging messages meanwhile, which they only can if the reconnects don't
+ * run on the workers.
+ *
+ * Needs nothing but loopback, built with ENABLE_IOT_PLAIN_TCP and
+ * ENABLE_IOT_PUBLISH_QUEUE by the Makefile.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_reactor.h"
+#include "aws_iot_log.h"
+
+#include "aws_iot_integ_tests_config.h"
+#include "aws_iot_config.h"
+
+#define REACTOR_TEST_HOST "127.0.0.1"
+#define REACTOR_TEST_TOPIC_FORMAT INTEGRATION_TEST_TOPIC "/Reactor/%d"
+#define REACTOR_TEST_TOPIC_LEN 64
+#define REACTOR_TEST_PAYLOAD_LEN 32
+#define REACTOR_TEST_PACKET_LEN 256
+/* Limit for each step of the test to complete, short of the keepalive that would yield the clients anyway */
+#define REACTOR_TEST_TIMEOUT_MS 5000
+#define REACTOR_TEST_KEEPALIVE_SEC 10
+
+/* Reconnects held up at the same time, enough to block every worker if they ran there */
+#define REACTOR_TEST_DROP_COUNT REACTOR_TEST_WORKER_COUNT
+
+#if REACTOR_TEST_CLIENT_COUNT < REACTOR_TEST_DROP_COUNT + 2
+#error "The reactor test needs two clients more than workers"
+#endif
+
+typedef struct {
+	int fd;
+	int clientIdx;
+	bool isConnackHeld;
+	char topic[REACTOR_TEST_TOPIC_LEN];
+	unsigned char buf[REACTOR_TEST_PACKET_LEN];
+	size_t fill;
+} ReactorTestConnection;
+
+typedef struct {
+	int listenFd;
+	ReactorTestConnection conns[REACTOR_TEST_CLIENT_COUNT * 2];
+	/* Shared with the test, guarded by lock */
+	pthread_mutex_t lock;
+	bool isStopping;
+	bool isDropRequested;
+	bool isHoldingConnacks;
+	int heldConnacks;
+	int connectCount[REACTOR_TEST_CLIENT_COUNT];
+	bool isSubscribed[REACTOR_TEST_CLIENT_COUNT];
+} ReactorTestBroker;
+
+static ReactorTestBroker broker;
+static pthread_mutex_t countLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int rxCount[REACTOR_TEST_CLIENT_COUNT];
+static unsigned int ackCount;
+static unsigned int failedCount;
+
+static bool aws_iot_reactor_tests_send(int fd, const unsigned char *pBuf, size_t len) {
+	ssize_t ret;
+
+	while(0 < len) {
+		ret = send(fd, pBuf, len, MSG_NOSIGNAL);
+		if(0 >= ret) {
+			return false;
+		}
+		pBuf += ret;
+		len -= (size_t) ret;
+	}
+	return true;
+}
+
+static void aws_iot_reactor_tests_close(ReactorTestConnection *pConn) {
+	pthread_mutex_lock(&broker.lock);
+	if(0 <= pConn->clientIdx) {
+		broker.isSubscribed[pConn->clientIdx] = false;
+	}
+	pthread_mutex_unlock(&broker.lock);
+	close(pConn->fd);
+	memset(pConn, 0, sizeof(ReactorTestConnection));
+	pConn->fd = -1;
+	pConn->clientIdx = -1;
+}
+
+/* Hands a PUBLISH on to the connection subscribed to its topic, at QoS 0 */
+static void aws_iot_reactor_tests_forward(const char *pTopic, size_t topicLen, const unsigned char *pPayload,
+										  size_t payloadLen) {
+	unsigned char packet[REACTOR_TEST_PACKET_LEN];
+	size_t len = 0, remaining = 2 + topicLen + payloadLen;
+	int i;
+
+	packet[len++] = 0x30;
+	do {
+		packet[len++] = (unsigned char) ((remaining % 128) | (remaining >= 128 ? 0x80 : 0));
+		remaining /= 128;
+	} while(0 < remaining);
+	packet[len++] = (unsigned char) (topicLen >> 8);
+	packet[len++] = (unsigned char) topicLen;
+	memcpy(&packet[len], pTopic, topicLen);
+	len += topicLen;
+	memcpy(&packet[len], pPayload, payloadLen);
+	len += payloadLen;
+
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+		if(0 <= broker.conns[i].fd && topicLen == strlen(broker.conns[i].topic) &&
+		   0 == strncmp(broker.conns[i].topic, pTopic, topicLen)) {
+			(void)aws_iot_reactor_tests_send(broker.conns[i].fd, packet, len);
+		}
+	}
+}
+
+/* Handles one complete packet, false to drop the connection */
+static bool aws_iot_reactor_tests_handle(ReactorTestConnection *pConn, unsigned char type,
+										 const unsigned char *pBody, size_t bodyLen) {
+	const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	const unsigned char pingresp[] = { 0xD0, 0x00 };
+	unsigned char ack[5];
+	size_t topicLen, offset, end;
+	int idx;
+
+	switch(type >> 4) {
+		case 1: /* CONNECT, the client ID ends in its index */
+			if(12 > bodyLen) {
+				return false;
+			}
+			end = 12 + (((size_t) pBody[10] << 8) | pBody[11]);
+			if(end > bodyLen) {
+				return false;
+			}
+			for(offset = end; 12 < offset && '0' <= pBody[offset - 1] && '9' >= pBody[offset - 1]; offset--) {
+			}
+			for(idx = 0; offset < end; offset++) {
+				idx = idx * 10 + (pBody[offset] - '0');
+			}
+			if(REACTOR_TEST_CLIENT_COUNT <= idx) {
+				return false;
+			}
+			pConn->clientIdx = idx;
+			pthread_mutex_lock(&broker.lock);
+			broker.connectCount[idx]++;
+			if(broker.isHoldingConnacks && 1 < broker.connectCount[idx]) {
+				pConn->isConnackHeld = true;
+				broker.heldConnacks++;
+			}
+			pthread_mutex_unlock(&broker.lock);
+			return pConn->isConnackHeld || aws_iot_reactor_tests_send(pConn->fd, connack, sizeof(connack));
+		case 3: /* PUBLISH */
+			topicLen = ((size_t) pBody[0] << 8) | pBody[1];
+			offset = 2 + topicLen + ((0 != (type & 0x06)) ? 2 : 0);
+			if(offset > bodyLen) {
+				return false;
+			}
+			if(0 != (type & 0x06)) {
+				ack[0] = 0x40;
+				ack[1] = 0x02;
+				ack[2] = pBody[2 + topicLen];
+				ack[3] = pBody[3 + topicLen];
+				if(!aws_iot_reactor_tests_send(pConn->fd, ack, 4)) {
+					return false;
+				}
+			}
+			aws_iot_reactor_tests_forward((const char *) &pBody[2], topicLen, &pBody[offset], bodyLen - offset);
+			return true;
+		case 8: /* SUBSCRIBE, one topic filter */
+			topicLen = ((size_t) pBody[2] << 8) | pBody[3];
+			if(5 + topicLen > bodyLen || REACTOR_TEST_TOPIC_LEN <= topicLen) {
+				return false;
+			}
+			memcpy(pConn->topic, &pBody[4], topicLen);
+			pConn->topic[topicLen] = '\0';
+			ack[0] = 0x90;
+			ack[1] = 0x03;
+			ack[2] = pBody[0];
+			ack[3] = pBody[1];
+			ack[4] = pBody[4 + topicLen] & 0x03;
+			pthread_mutex_lock(&broker.lock);
+			if(0 <= pConn->clientIdx) {
+				broker.isSubscribed[pConn->clientIdx] = true;
+			}
+			pthread_mutex_unlock(&broker.lock);
+			return aws_iot_reactor_tests_send(pConn->fd, ack, 5);
+		case 12: /* PINGREQ */
+			return aws_iot_reactor_tests_send(pConn->fd, pingresp, sizeof(pingresp));
+		case 14: /* DISCONNECT */
+			return false;
+		default: /* PUBACK and anything else the test doesn't use */
+			return true;
+	}
+}
+
+/* Consumes the complete packets in the buffer of a connection */
+static bool aws_iot_reactor_tests_parse(ReactorTestConnection *pConn) {
+	size_t remaining, multiplier, header, used = 0;
+
+	for(;;) {
+		remaining = 0;
+		multiplier = 1;
+		header = 1;
+		do {
+			if(used + header >= pConn->fill) {
+				goto incomplete;
+			}
+			remaining += (pConn->buf[used + header] & 0x7F) * multiplier;
+			multiplier *= 128;
+		} while(0 != (pConn->buf[used + header++] & 0x80));
+
+		if(REACTOR_TEST_PACKET_LEN < header + remaining) {
+			return false;
+		}
+		if(used + header + remaining > pConn->fill) {
+			goto incomplete;
+		}
+		if(!aws_iot_reactor_tests_handle(pConn, pConn->buf[used], &pConn->buf[used + header], remaining)) {
+			return false;
+		}
+		used += header + remaining;
+	}
+
+incomplete:
+	memmove(pConn->buf, &pConn->buf[used], pConn->fill - used);
+	pConn->fill -= used;
+	return true;
+}
+
+/* Serves every connection from one thread, polling so held CONNACKs and drops take effect */
+static void *aws_iot_reactor_tests_broker_runner(void *ptr) {
+	const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	struct pollfd fds[REACTOR_TEST_CLIENT_COUNT * 2 + 1];
+	ReactorTestConnection *pConn;
+	bool isDropping, isReleasing;
+	ssize_t ret;
+	int i, fd;
+
+	IOT_UNUSED(ptr);
+
+	for(;;) {
+		pthread_mutex_lock(&broker.lock);
+		if(broker.isStopping) {
+			pthread_mutex_unlock(&broker.lock);
+			break;
+		}
+		isDropping = broker.isDropRequested;
+		broker.isDropRequested = false;
+		isReleasing = !broker.isHoldingConnacks && 0 < broker.heldConnacks;
+		broker.heldConnacks = isReleasing ? 0 : broker.heldConnacks;
+		pthread_mutex_unlock(&broker.lock);
+
+		for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+			pConn = &broker.conns[i];
+			if(0 > pConn->fd) {
+				continue;
+			}
+			if(isDropping && REACTOR_TEST_DROP_COUNT > pConn->clientIdx && 0 <= pConn->clientIdx) {
+				aws_iot_reactor_tests_close(pConn);
+			} else if(isReleasing && pConn->isConnackHeld) {
+				pConn->isConnackHeld = false;
+				(void)aws_iot_reactor_tests_send(pConn->fd, connack, sizeof(connack));
+			}
+		}
+
+		fds[0].fd = broker.listenFd;
+		fds[0].events = POLLIN;
+		for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+			fds[i + 1].fd = broker.conns[i].fd;
+			fds[i + 1].events = POLLIN;
+		}
+		if(0 >= poll(fds, REACTOR_TEST_CLIENT_COUNT * 2 + 1, 10)) {
+			continue;
+		}
+
+		if(0 != (fds[0].revents & POLLIN)) {
+			fd = accept(broker.listenFd, NULL, NULL);
+			for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2 && 0 <= fd; i++) {
+				if(0 > broker.conns[i].fd) {
+					broker.conns[i].fd = fd;
+					fd = -1;
+				}
+			}
+			if(0 <= fd) {
+				close(fd);
+			}
+		}
+
+		for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+			pConn = &broker.conns[i];
+			if(0 > fds[i + 1].fd || 0 == fds[i + 1].revents || pConn->fd != fds[i + 1].fd) {
+				continue;
+			}
+			ret = recv(pConn->fd, &pConn->buf[pConn->fill], REACTOR_TEST_PACKET_LEN - pConn->fill, 0);
+			if(0 >= ret) {
+				aws_iot_reactor_tests_close(pConn);
+				continue;
+			}
+			pConn->fill += (size_t) ret;
+			if(!aws_iot_reactor_tests_parse(pConn)) {
+				aws_iot_reactor_tests_close(pConn);
+			}
+		}
+	}
+
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+		if(0 <= broker.conns[i].fd) {
+			aws_iot_reactor_tests_close(&broker.conns[i]);
+		}
+	}
+	close(broker.listenFd);
+
+	return NULL;
+}
+
+static int aws_iot_reactor_tests_broker_start(pthread_t *pThread) {
+	struct sockaddr_in addr;
+	int i, one = 1;
+
+	memset(&broker, 0, sizeof(broker));
+	pthread_mutex_init(&broker.lock, NULL);
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT * 2; i++) {
+		broker.conns[i].fd = -1;
+		broker.conns[i].clientIdx = -1;
+	}
+
+	broker.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if(0 > broker.listenFd) {
+		return -1;
+	}
+	(void)setsockopt(broker.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(REACTOR_TEST_PORT);
+	addr.sin_addr.s_addr = inet_addr(REACTOR_TEST_HOST);
+	if(0 != bind(broker.listenFd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	   0 != listen(broker.listenFd, REACTOR_TEST_CLIENT_COUNT)) {
+		IOT_ERROR("Broker can't listen on port %d, errno %d\n", REACTOR_TEST_PORT, errno);
+		close(broker.listenFd);
+		return -1;
+	}
+
+	return 0 == pthread_create(pThread, NULL, aws_iot_reactor_tests_broker_runner, NULL) ? 0 : -1;
+}
+
+static void aws_iot_reactor_tests_message_handler(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
+												  IoT_Publish_Message_Params *params, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(params);
+
+	pthread_mutex_lock(&countLock);
+	rxCount[(int) (intptr_t) pData]++;
+	pthread_mutex_unlock(&countLock);
+}
+
+static void aws_iot_reactor_tests_complete_handler(AWS_IoT_Client *pClient, IoT_Publish_Message_Params *pParams,
+												   IoT_Error_t result, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pParams);
+	IOT_UNUSED(pData);
+
+	pthread_mutex_lock(&countLock);
+	if(SUCCESS == result) {
+		ackCount++;
+	} else {
+		failedCount++;
+	}
+	pthread_mutex_unlock(&countLock);
+}
+
+static void aws_iot_reactor_tests_error_handler(AWS_IoT_Client *pClient, IoT_Error_t rc, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pData);
+
+	IOT_WARN("Reactor yield returned %d\n", rc);
+}
+
+static double aws_iot_reactor_tests_elapsed_ms(struct timespec *pStart) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) (now.tv_sec - pStart->tv_sec) * 1000.0 + (double) (now.tv_nsec - pStart->tv_nsec) / 1000000.0;
+}
+
+/* Polls a condition every 10 ms, false if it didn't hold within REACTOR_TEST_TIMEOUT_MS */
+static bool aws_iot_reactor_tests_wait(bool (*pCondition)(AWS_IoT_Client *), AWS_IoT_Client *pClients) {
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while(!pCondition(pClients)) {
+		if(REACTOR_TEST_TIMEOUT_MS < aws_iot_reactor_tests_elapsed_ms(&start)) {
+			return false;
+		}
+		usleep(10000);
+	}
+	return true;
+}
+
+static unsigned int roundRxTarget[REACTOR_TEST_CLIENT_COUNT];
+static unsigned int roundAckTarget;
+
+static bool aws_iot_reactor_tests_is_round_done(AWS_IoT_Client *pClients) {
+	bool isDone;
+	int i;
+
+	IOT_UNUSED(pClients);
+
+	pthread_mutex_lock(&countLock);
+	isDone = ackCount >= roundAckTarget;
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+		isDone = isDone && rxCount[i] >= roundRxTarget[i];
+	}
+	pthread_mutex_unlock(&countLock);
+
+	return isDone;
+}
+
+static bool aws_iot_reactor_tests_are_dropped_down(AWS_IoT_Client *pClients) {
+	int i;
+
+	for(i = 0; i < REACTOR_TEST_DROP_COUNT; i++) {
+		if(aws_iot_mqtt_is_client_connected(&pClients[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool aws_iot_reactor_tests_is_reconnect_held(AWS_IoT_Client *pClients) {
+	bool isHeld;
+
+	IOT_UNUSED(pClients);
+
+	pthread_mutex_lock(&broker.lock);
+	isHeld = 0 < broker.heldConnacks;
+	pthread_mutex_unlock(&broker.lock);
+
+	return isHeld;
+}
+
+static bool aws_iot_reactor_tests_are_all_subscribed(AWS_IoT_Client *pClients) {
+	bool isDone = true;
+	int i;
+
+	pthread_mutex_lock(&broker.lock);
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+		isDone = isDone && broker.isSubscribed[i] && aws_iot_mqtt_is_client_connected(&pClients[i]);
+	}
+	pthread_mutex_unlock(&broker.lock);
+
+	return isDone;
+}
+
+/* Clients first to REACTOR_TEST_CLIENT_COUNT - 1 each publish REACTOR_TEST_PUBLISH_COUNT messages to the next one */
+static int aws_iot_reactor_tests_publish_round(AWS_IoT_Client *pClients, int first, const char *pName) {
+	IoT_Publish_Queue_Params queueParams = IoT_Publish_Queue_Params_initializer;
+	IoT_Publish_Message_Params params;
+	char topic[REACTOR_TEST_TOPIC_LEN];
+	char payload[REACTOR_TEST_PAYLOAD_LEN];
+	struct timespec start;
+	int i, j, target;
+	IoT_Error_t rc;
+
+	queueParams.pCompleteHandler = aws_iot_reactor_tests_complete_handler;
+
+	pthread_mutex_lock(&countLock);
+	for(i = first; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+		roundRxTarget[i] = rxCount[i] + REACTOR_TEST_PUBLISH_COUNT;
+	}
+	roundAckTarget = ackCount + (REACTOR_TEST_CLIENT_COUNT - first) * REACTOR_TEST_PUBLISH_COUNT;
+	pthread_mutex_unlock(&countLock);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(j = 0; j < REACTOR_TEST_PUBLISH_COUNT; j++) {
+		for(i = first; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+			target = first + (i - first + 1) % (REACTOR_TEST_CLIENT_COUNT - first);
+			snprintf(topic, REACTOR_TEST_TOPIC_LEN, REACTOR_TEST_TOPIC_FORMAT, target);
+			snprintf(payload, REACTOR_TEST_PAYLOAD_LEN, "Reactor %d %d", i, j);
+			params.payload = (void *) payload;
+			params.payloadLen = strlen(payload);
+			params.qos = QOS1;
+			params.isRetained = 0;
+
+			/* The queue is shorter than a round, wait for the reactor to drain it */
+			do {
+				rc = aws_iot_mqtt_publish_async(&pClients[i], topic, (uint16_t) strlen(topic), &params, &queueParams);
+				if(MQTT_PUBLISH_QUEUE_FULL_ERROR == rc) {
+					if(REACTOR_TEST_TIMEOUT_MS < aws_iot_reactor_tests_elapsed_ms(&start)) {
+						IOT_ERROR("%s : queue of client %d not drained\n", pName, i);
+						return -1;
+					}
+					usleep(1000);
+				}
+			} while(MQTT_PUBLISH_QUEUE_FULL_ERROR == rc);
+			if(SUCCESS != rc) {
+				IOT_ERROR("Queueing on client %d failed : %d\n", i, rc);
+				return -1;
+			}
+		}
+	}
+
+	if(!aws_iot_reactor_tests_wait(aws_iot_reactor_tests_is_round_done, pClients)) {
+		IOT_ERROR("%s : round not complete, %u of %u acknowledged\n", pName, ackCount, roundAckTarget);
+		return -1;
+	}
+
+	printf("%s : %d messages delivered in %.1f ms\n", pName, (REACTOR_TEST_CLIENT_COUNT - first) * REACTOR_TEST_PUBLISH_COUNT,
+		   aws_iot_reactor_tests_elapsed_ms(&start));
+	return 0;
+}
+
+static int aws_iot_reactor_tests_connect(AWS_IoT_Client *pClient, int idx) {
+	IoT_Client_Init_Params initParams = IoT_Client_Init_Params_initializer;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	static char clientIds[REACTOR_TEST_CLIENT_COUNT][50];
+	static char topics[REACTOR_TEST_CLIENT_COUNT][REACTOR_TEST_TOPIC_LEN];
+	IoT_Error_t rc;
+
+	snprintf(clientIds[idx], 50, "%s_%d", INTEGRATION_TEST_CLIENT_ID, idx);
+	snprintf(topics[idx], REACTOR_TEST_TOPIC_LEN, REACTOR_TEST_TOPIC_FORMAT, idx);
+
+	initParams.pHostURL = REACTOR_TEST_HOST;
+	initParams.port = REACTOR_TEST_PORT;
+	initParams.transport = IOT_NETWORK_TRANSPORT_TCP;
+	/* A reconnect blocked on the held CONNACK must outlast the round meant to run meanwhile */
+	initParams.mqttCommandTimeout_ms = 2 * REACTOR_TEST_TIMEOUT_MS;
+	initParams.tlsHandshakeTimeout_ms = REACTOR_TEST_TIMEOUT_MS;
+	initParams.enableAutoReconnect = true;
+	initParams.isBlockOnThreadLockEnabled = true;
+	rc = aws_iot_mqtt_init(pClient, &initParams);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Initializing client %d : %d\n", idx, rc);
+		return -1;
+	}
+
+	connectParams.keepAliveIntervalInSec = REACTOR_TEST_KEEPALIVE_SEC;
+	connectParams.isCleanSession = true;
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = clientIds[idx];
+	connectParams.clientIDLen = (uint16_t) strlen(clientIds[idx]);
+	rc = aws_iot_mqtt_connect(pClient, &connectParams);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Connecting client %d : %d\n", idx, rc);
+		return -1;
+	}
+
+	rc = aws_iot_mqtt_subscribe(pClient, topics[idx], (uint16_t) strlen(topics[idx]), QOS1,
+								aws_iot_reactor_tests_message_handler, (void *) (intptr_t) idx);
+	if(SUCCESS != rc) {
+		IOT_ERROR("ERROR Subscribing client %d : %d\n", idx, rc);
+		return -1;
+	}
+
+	return 0;
+}
+
+int aws_iot_reactor_tests_run() {
+	static AWS_IoT_Client clients[REACTOR_TEST_CLIENT_COUNT];
+	IoT_MQTT_Reactor_Slot slots[REACTOR_TEST_CLIENT_COUNT];
+	IoT_MQTT_Reactor reactor;
+	pthread_t brokerThread;
+	bool isReactorReady = false;
+	int i, rc = 0;
+
+	if(0 != aws_iot_reactor_tests_broker_start(&brokerThread)) {
+		return -1;
+	}
+
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT && 0 == rc; i++) {
+		rc = aws_iot_reactor_tests_connect(&clients[i], i);
+	}
+
+	if(0 == rc && SUCCESS != aws_iot_mqtt_reactor_init(&reactor, slots, REACTOR_TEST_CLIENT_COUNT)) {
+		IOT_ERROR("ERROR Initializing the reactor\n");
+		rc = -1;
+	}
+	isReactorReady = (0 == rc);
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT && 0 == rc; i++) {
+		if(SUCCESS != aws_iot_mqtt_reactor_add_client(&reactor, &clients[i], aws_iot_reactor_tests_error_handler, NULL)) {
+			rc = -1;
+		}
+	}
+	if(0 == rc && SUCCESS != aws_iot_mqtt_reactor_start(&reactor, REACTOR_TEST_WORKER_COUNT)) {
+		IOT_ERROR("ERROR Starting the reactor\n");
+		rc = -1;
+	}
+
+	if(0 == rc) {
+		printf("\n%d clients on %d workers, %d messages per client and round\n", REACTOR_TEST_CLIENT_COUNT,
+			   REACTOR_TEST_WORKER_COUNT, REACTOR_TEST_PUBLISH_COUNT);
+		/* Let the first pass over every client finish, from now on only queued messages wake them */
+		usleep(THREAD_SLEEP_INTERVAL_USEC);
+		rc = aws_iot_reactor_tests_publish_round(clients, 0, "All clients connected");
+	}
+
+	if(0 == rc) {
+		pthread_mutex_lock(&broker.lock);
+		broker.isHoldingConnacks = true;
+		broker.isDropRequested = true;
+		pthread_mutex_unlock(&broker.lock);
+		if(!aws_iot_reactor_tests_wait(aws_iot_reactor_tests_are_dropped_down, clients) ||
+		   !aws_iot_reactor_tests_wait(aws_iot_reactor_tests_is_reconnect_held, clients)) {
+			IOT_ERROR("Dropped clients didn't try to reconnect\n");
+			rc = -1;
+		}
+		/* Every dropped client is due for its reconnect by now */
+		usleep(2 * AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL * 1000);
+	}
+
+	if(0 == rc) {
+		rc = aws_iot_reactor_tests_publish_round(clients, REACTOR_TEST_DROP_COUNT, "Others reconnecting");
+		if(0 == rc && !aws_iot_reactor_tests_are_dropped_down(clients)) {
+			IOT_ERROR("Reconnect finished before the CONNACK was sent\n");
+			rc = -1;
+		}
+	}
+
+	if(0 == rc) {
+		pthread_mutex_lock(&broker.lock);
+		broker.isHoldingConnacks = false;
+		pthread_mutex_unlock(&broker.lock);
+		if(!aws_iot_reactor_tests_wait(aws_iot_reactor_tests_are_all_subscribed, clients)) {
+			IOT_ERROR("Dropped clients didn't reconnect\n");
+			rc = -1;
+		}
+	}
+
+	if(0 == rc) {
+		rc = aws_iot_reactor_tests_publish_round(clients, 0, "All clients reconnected");
+	}
+
+	pthread_mutex_lock(&broker.lock);
+	broker.isHoldingConnacks = false;
+	pthread_mutex_unlock(&broker.lock);
+	if(isReactorReady) {
+		(void)aws_iot_mqtt_reactor_stop(&reactor);
+		for(i = 0; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+			(void)aws_iot_mqtt_reactor_remove_client(&reactor, &clients[i]);
+		}
+		(void)aws_iot_mqtt_reactor_destroy(&reactor);
+	}
+	for(i = 0; i < REACTOR_TEST_CLIENT_COUNT; i++) {
+		(void)aws_iot_mqtt_disconnect(&clients[i]);
+		(void)aws_iot_mqtt_free(&clients[i]);
+	}
+
+	pthread_mutex_lock(&broker.lock);
+	broker.isStopping = true;
+	pthread_mutex_unlock(&broker.lock);
+	pthread_join(brokerThread, NULL);
+
+	if(0 == rc && 0 != failedCount) {
+		IOT_ERROR("%u queued messages failed\n", failedCount);
+		rc = -1;
+	}
+
+	return rc;
+}
+
+int main() {
+	printf("\n\n");
+	printf("******************************************************************\n");
+	printf("* Starting MQTT Version 3.1.1 Epoll Reactor Test                 *\n");
+	printf("******************************************************************\n");
+	int rc = aws_iot_reactor_tests_run();
+	if(0 != rc) {
+		printf("\n*******************************************************************\n");
+		printf("*MQTT Version 3.1.1 Epoll Reactor Test FAILED! RC : %d \n", rc);
+		printf("*******************************************************************\n");
+		return 1;
+	}
+
+	printf("******************************************************************\n");
+	printf("* MQTT Version 3.1.1 Epoll Reactor Test SUCCESS!!                *\n");
+	printf("******************************************************************\n");
+
+	return 0;
+}
@@ -0,0 +1,388 @@
+/*
+ * aws_iot_test_tls_handshake_benchmark.c
+ *
+ * Compares the TLS profiles of the network layer against a local mbedTLS
+ * server, one with an RSA and one with an EC certificate, on full handshakes
+ * and on handshakes resuming the session of the previous connect. Reports
+ * per profile and handshake the CPU time the client thread spent in
+ * iot_tls_connect, the wall time and the bytes sent in each direction, as
+ * counted by the server.
+ *
+ * Needs nothing but loopback, the credentials are the mbedTLS test
+ * certificates (MBEDTLS_CERTS_C).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "aws_iot_log.h"
+#include "network_interface.h"
+#include "mbedtls/ssl_cache.h"
+#include "mbedtls/ssl_ticket.h"
+
+#include "aws_iot_integ_tests_config.h"
+#include "aws_iot_config.h"
+
+#define HANDSHAKE_BENCHMARK_HOST "localhost"
+
+/* Full handshakes, then resumed ones where the network layer keeps sessions */
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+#define HANDSHAKE_BENCHMARK_KINDS 2
+#else
+#define HANDSHAKE_BENCHMARK_KINDS 1
+#endif
+
+typedef struct {
+	const char *pName;
+	uint8_t tlsProfile;
+} BenchmarkProfile;
+
+typedef struct {
+	const char *pName;
+	const char *pCrt;
+	const size_t *pCrtLen;
+	const char *pKey;
+	const size_t *pKeyLen;
+} BenchmarkServerKey;
+
+typedef struct {
+	mbedtls_net_context listenFd;
+	mbedtls_entropy_context entropy;
+	mbedtls_ctr_drbg_context ctr_drbg;
+	mbedtls_ssl_config conf;
+	mbedtls_x509_crt cacert;
+	mbedtls_x509_crt srvcert;
+	mbedtls_pk_context pkey;
+#if defined(MBEDTLS_SSL_CACHE_C)
+	mbedtls_ssl_cache_context cache;
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+	mbedtls_ssl_ticket_context ticket;
+#endif
+	int rounds;
+	/* Written by the server thread, read by the client once handshakeDone is set */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool handshakeDone;
+	int handshakeRet;
+	size_t bytesIn;
+	size_t bytesOut;
+} BenchmarkServer;
+
+typedef struct {
+	mbedtls_net_context *pFd;
+	size_t bytesIn;
+	size_t bytesOut;
+} CountingBio;
+
+static const BenchmarkProfile profiles[] = {
+	{ "default", IOT_TLS_PROFILE_DEFAULT },
+	{ "fast handshake", IOT_TLS_PROFILE_FAST_HANDSHAKE },
+};
+
+static const BenchmarkServerKey serverKeys[] = {
+#if defined(MBEDTLS_RSA_C)
+	{ "RSA", mbedtls_test_srv_crt_rsa, &mbedtls_test_srv_crt_rsa_len,
+	  mbedtls_test_srv_key_rsa, &mbedtls_test_srv_key_rsa_len },
+#endif
+#if defined(MBEDTLS_ECDSA_C)
+	{ "EC", mbedtls_test_srv_crt_ec, &mbedtls_test_srv_crt_ec_len,
+	  mbedtls_test_srv_key_ec, &mbedtls_test_srv_key_ec_len },
+#endif
+};
+
+static int aws_iot_tls_tests_counting_send(void *ctx, const unsigned char *buf, size_t len) {
+	CountingBio *pBio = (CountingBio *) ctx;
+	int ret = mbedtls_net_send(pBio->pFd, buf, len);
+
+	if(0 < ret) {
+		pBio->bytesOut += (size_t) ret;
+	}
+	return ret;
+}
+
+static int aws_iot_tls_tests_counting_recv(void *ctx, unsigned char *buf, size_t len) {
+	CountingBio *pBio = (CountingBio *) ctx;
+	int ret = mbedtls_net_recv(pBio->pFd, buf, len);
+
+	if(0 < ret) {
+		pBio->bytesIn += (size_t) ret;
+	}
+	return ret;
+}
+
+static double aws_iot_tls_tests_elapsed_ms(struct timespec *pStart, struct timespec *pEnd) {
+	return (double) (pEnd->tv_sec - pStart->tv_sec) * 1000.0 + (double) (pEnd->tv_nsec - pStart->tv_nsec) / 1000000.0;
+}
+
+/* Accepts one connection per round, handshakes and waits for the close notify of the client */
+static void *aws_iot_tls_tests_server_runner(void *ptr) {
+	BenchmarkServer *pServer = (BenchmarkServer *) ptr;
+	mbedtls_net_context clientFd;
+	mbedtls_ssl_context ssl;
+	CountingBio bio;
+	unsigned char buf[64];
+	int i, ret;
+
+	for(i = 0; i < pServer->rounds; i++) {
+		mbedtls_net_init(&clientFd);
+		mbedtls_ssl_init(&ssl);
+		bio.pFd = &clientFd;
+		bio.bytesIn = 0;
+		bio.bytesOut = 0;
+
+		ret = mbedtls_net_accept(&(pServer->listenFd), &clientFd, NULL, 0, NULL);
+		if(0 == ret) {
+			ret = mbedtls_ssl_setup(&ssl, &(pServer->conf));
+		}
+		if(0 == ret) {
+			mbedtls_ssl_set_bio(&ssl, &bio, aws_iot_tls_tests_counting_send, aws_iot_tls_tests_counting_recv, NULL);
+			while((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+				if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+					break;
+				}
+			}
+		}
+
+		pthread_mutex_lock(&(pServer->lock));
+		pServer->handshakeRet = ret;
+		pServer->bytesIn = bio.bytesIn;
+		pServer->bytesOut = bio.bytesOut;
+		pServer->handshakeDone = true;
+		pthread_cond_signal(&(pServer->cond));
+		pthread_mutex_unlock(&(pServer->lock));
+
+		if(0 == ret) {
+			do {
+				ret = mbedtls_ssl_read(&ssl, buf, sizeof(buf));
+			} while(0 < ret || MBEDTLS_ERR_SSL_WANT_READ == ret);
+		}
+
+		mbedtls_ssl_free(&ssl);
+		mbedtls_net_free(&clientFd);
+	}
+
+	return NULL;
+}
+
+static int aws_iot_tls_tests_server_init(BenchmarkServer *pServer, const BenchmarkServerKey *pKey, int rounds) {
+	char portBuffer[6];
+	int ret;
+
+	mbedtls_net_init(&(pServer->listenFd));
+	mbedtls_entropy_init(&(pServer->entropy));
+	mbedtls_ctr_drbg_init(&(pServer->ctr_drbg));
+	mbedtls_ssl_config_init(&(pServer->conf));
+	mbedtls_x509_crt_init(&(pServer->cacert));
+	mbedtls_x509_crt_init(&(pServer->srvcert));
+	mbedtls_pk_init(&(pServer->pkey));
+#if defined(MBEDTLS_SSL_CACHE_C)
+	mbedtls_ssl_cache_init(&(pServer->cache));
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+	mbedtls_ssl_ticket_init(&(pServer->ticket));
+#endif
+	pthread_mutex_init(&(pServer->lock), NULL);
+	pthread_cond_init(&(pServer->cond), NULL);
+	pServer->rounds = rounds;
+	pServer->handshakeDone = false;
+
+	if((ret = mbedtls_ctr_drbg_seed(&(pServer->ctr_drbg), mbedtls_entropy_func, &(pServer->entropy),
+									(const unsigned char *) "handshake_bench", 15)) != 0
+	   || (ret = mbedtls_x509_crt_parse(&(pServer->cacert), (const unsigned char *) mbedtls_test_cas_pem,
+										mbedtls_test_cas_pem_len)) != 0
+	   || (ret = mbedtls_x509_crt_parse(&(pServer->srvcert), (const unsigned char *) pKey->pCrt,
+										*(pKey->pCrtLen))) != 0
+	   || (ret = mbedtls_pk_parse_key(&(pServer->pkey), (const unsigned char *) pKey->pKey, *(pKey->pKeyLen),
+									  NULL, 0)) != 0
+	   || (ret = mbedtls_ssl_config_defaults(&(pServer->conf), MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+											 MBEDTLS_SSL_PRESET_DEFAULT)) != 0
+	   || (ret = mbedtls_ssl_conf_own_cert(&(pServer->conf), &(pServer->srvcert), &(pServer->pkey))) != 0) {
+		IOT_ERROR("Server setup failed -0x%x\n", -ret);
+		return ret;
+	}
+
+	/* Like AWS IoT, the client authenticates with its certificate, and the server keeps sessions
+	 * by ID and by ticket. Whether a round is full or resumed is up to the client. */
+	mbedtls_ssl_conf_rng(&(pServer->conf), mbedtls_ctr_drbg_random, &(pServer->ctr_drbg));
+	mbedtls_ssl_conf_ca_chain(&(pServer->conf), &(pServer->cacert), NULL);
+	mbedtls_ssl_conf_authmode(&(pServer->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
+#if defined(MBEDTLS_SSL_CACHE_C)
+	mbedtls_ssl_conf_session_cache(&(pServer->conf), &(pServer->cache), mbedtls_ssl_cache_get,
+								   mbedtls_ssl_cache_set);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+	if((ret = mbedtls_ssl_ticket_setup(&(pServer->ticket), mbedtls_ctr_drbg_random, &(pServer->ctr_drbg),
+									   MBEDTLS_CIPHER_AES_256_GCM, 3600)) != 0) {
+		IOT_ERROR("Session ticket setup failed -0x%x\n", -ret);
+		return ret;
+	}
+	mbedtls_ssl_conf_session_tickets_cb(&(pServer->conf), mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse,
+										&(pServer->ticket));
+#endif
+
+	snprintf(portBuffer, sizeof(portBuffer), "%d", HANDSHAKE_BENCHMARK_PORT);
+	if((ret = mbedtls_net_bind(&(pServer->listenFd), "127.0.0.1", portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
+		IOT_ERROR("Binding port %s failed -0x%x\n", portBuffer, -ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void aws_iot_tls_tests_server_free(BenchmarkServer *pServer) {
+	mbedtls_net_free(&(pServer->listenFd));
+#if defined(MBEDTLS_SSL_TICKET_C)
+	mbedtls_ssl_ticket_free(&(pServer->ticket));
+#endif
+#if defined(MBEDTLS_SSL_CACHE_C)
+	mbedtls_ssl_cache_free(&(pServer->cache));
+#endif
+	mbedtls_pk_free(&(pServer->pkey));
+	mbedtls_x509_crt_free(&(pServer->srvcert));
+	mbedtls_x509_crt_free(&(pServer->cacert));
+	mbedtls_ssl_config_free(&(pServer->conf));
+	mbedtls_ctr_drbg_free(&(pServer->ctr_drbg));
+	mbedtls_entropy_free(&(pServer->entropy));
+	pthread_cond_destroy(&(pServer->cond));
+	pthread_mutex_destroy(&(pServer->lock));
+}
+
+/*
+ * Measures HANDSHAKE_BENCHMARK_ROUNDS connects of one profile. With resume
+ * set, every connect offers the session of the one before it, otherwise the
+ * client forgets it and does a full handshake.
+ */
+static int aws_iot_tls_tests_benchmark_profile(const BenchmarkServerKey *pKey, const BenchmarkProfile *pProfile,
+											   bool resume) {
+	BenchmarkServer server;
+	pthread_t serverThread;
+	Network network;
+	struct timespec cpuStart, cpuEnd, wallStart, wallEnd, serverDeadline;
+	double cpuMs, wallMs, cpuSum = 0, wallSum = 0, cpuMin = 0;
+	size_t bytesIn = 0, bytesOut = 0;
+	const char *pSuite = "none";
+	IoT_Error_t rc = SUCCESS;
+	int i, ret;
+
+	if(0 != aws_iot_tls_tests_server_init(&server, pKey, HANDSHAKE_BENCHMARK_ROUNDS + 1)) {
+		aws_iot_tls_tests_server_free(&server);
+		return -1;
+	}
+	pthread_create(&serverThread, NULL, aws_iot_tls_tests_server_runner, &server);
+
+	iot_tls_init(&network, mbedtls_test_cas_pem, mbedtls_test_cli_crt_ec, mbedtls_test_cli_key_ec,
+				 HANDSHAKE_BENCHMARK_HOST, HANDSHAKE_BENCHMARK_PORT, 5000, true);
+	network.tlsConnectParams.rootCALen = mbedtls_test_cas_pem_len;
+	network.tlsConnectParams.deviceCertLen = mbedtls_test_cli_crt_ec_len;
+	network.tlsConnectParams.devicePrivateKeyLen = mbedtls_test_cli_key_ec_len;
+	network.tlsConnectParams.tlsProfile = pProfile->tlsProfile;
+
+	/* One full connect outside the measurement parses the credentials, which every later connect
+	 * shares, and leaves a session to resume */
+	for(i = -1; i < HANDSHAKE_BENCHMARK_ROUNDS - 1 && SUCCESS == rc; i++) {
+		if(0 > i || !resume) {
+			iot_tls_forget_session(&network);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &wallStart);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+		rc = iot_tls_connect(&network, NULL);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+		clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+
+		/* A client that failed before its TCP connect leaves the server in accept */
+		clock_gettime(CLOCK_REALTIME, &serverDeadline);
+		serverDeadline.tv_sec += 1;
+		ret = 0;
+		pthread_mutex_lock(&(server.lock));
+		while(!server.handshakeDone && 0 == ret) {
+			ret = pthread_cond_timedwait(&(server.cond), &(server.lock), &serverDeadline);
+		}
+		if(server.handshakeDone) {
+			ret = server.handshakeRet;
+		}
+		server.handshakeDone = false;
+		pthread_mutex_unlock(&(server.lock));
+
+		if(SUCCESS != rc || 0 != ret) {
+			IOT_ERROR("Handshake failed, client %d server -0x%x\n", rc, -ret);
+			rc = SSL_CONNECTION_ERROR;
+			break;
+		}
+		if(0 <= i && resume != network.tlsDataParams.isSessionResumed) {
+			IOT_ERROR("Expected a %s handshake\n", resume ? "resumed" : "full");
+			rc = SSL_CONNECTION_ERROR;
+		}
+
+		pSuite = mbedtls_ssl_get_ciphersuite(&(network.tlsDataParams.ssl));
+		iot_tls_disconnect(&network);
+		iot_tls_destroy(&network);
+
+		if(0 > i) {
+			continue;
+		}
+		cpuMs = aws_iot_tls_tests_elapsed_ms(&cpuStart, &cpuEnd);
+		wallMs = aws_iot_tls_tests_elapsed_ms(&wallStart, &wallEnd);
+		cpuSum += cpuMs;
+		wallSum += wallMs;
+		if(0 == i || cpuMs < cpuMin) {
+			cpuMin = cpuMs;
+		}
+		bytesIn = server.bytesIn;
+		bytesOut = server.bytesOut;
+	}
+
+	if(SUCCESS == rc) {
+		printf("%-4s %-15s %-7s CPU (ms): avg %7.2f min %7.2f  wall (ms): avg %7.2f  bytes: client %5zu server %5zu  %s\n",
+			   pKey->pName, pProfile->pName, resume ? "resumed" : "full", cpuSum / HANDSHAKE_BENCHMARK_ROUNDS, cpuMin,
+			   wallSum / HANDSHAKE_BENCHMARK_ROUNDS, bytesIn, bytesOut, pSuite);
+	} else {
+		/* Rounds are left, the server waits in accept or read */
+		pthread_cancel(serverThread);
+	}
+
+	iot_tls_free(&network);
+	pthread_join(serverThread, NULL);
+	aws_iot_tls_tests_server_free(&server);
+
+	return (SUCCESS == rc) ? 0 : -1;
+}
+
+int main() {
+	size_t i, j;
+	int k;
+	int rc = 0;
+
+	printf("\n\n");
+	printf("******************************************************************\n");
+	printf("* Starting TLS Handshake Benchmark                               *\n");
+	printf("******************************************************************\n");
+	printf("\n%d full and %d resumed handshakes per server key and profile, client CPU time of iot_tls_connect\n\n",
+		   HANDSHAKE_BENCHMARK_ROUNDS, HANDSHAKE_BENCHMARK_ROUNDS);
+
+	for(i = 0; i < sizeof(serverKeys) / sizeof(serverKeys[0]); i++) {
+		for(j = 0; j < sizeof(profiles) / sizeof(profiles[0]); j++) {
+			for(k = 0; k < HANDSHAKE_BENCHMARK_KINDS; k++) {
+				if(0 != aws_iot_tls_tests_benchmark_profile(&serverKeys[i], &profiles[j], 0 != k)) {
+					rc = -1;
+				}
+			}
+		}
+	}
+
+	if(0 != rc) {
+		printf("\n*******************************************************************\n");
+		printf("* TLS Handshake Benchmark FAILED!                                  \n");
+		printf("*******************************************************************\n");
+		return 1;
+	}
+
+	printf("\n******************************************************************\n");
+	printf("* TLS Handshake Benchmark SUCCESS!!                              *\n");
+	printf("******************************************************************\n");
+
+	return 0;
+}
@@ -0,0 +1,403 @@
+/*
+ * aws_iot_test_transport_benchmark.c
+ *
+ * Runs the same MQTT session once over the plain TCP transport and once over
+ * TLS against a minimal MQTT 3.1.1 broker on the loopback interface: a
+ * connect, TRANSPORT_BENCHMARK_PUBLISH_COUNT QoS1 publishes one after the
+ * other and a disconnect. Reports per transport the time of the connect, the
+ * publish round trip, the CPU time the client thread spent publishing and the
+ * bytes each side sent per publish, as counted by the broker, then the
+ * overhead TLS adds to each.
+ *
+ * Needs nothing but loopback, built with ENABLE_IOT_PLAIN_TCP by the
+ * Makefile. The TLS credentials are the mbedTLS test certificates
+ * (MBEDTLS_CERTS_C).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_log.h"
+
+#include "aws_iot_integ_tests_config.h"
+#include "aws_iot_config.h"
+
+#define TRANSPORT_BENCHMARK_HOST "localhost"
+#define TRANSPORT_BENCHMARK_TOPIC INTEGRATION_TEST_TOPIC "/Transport"
+#define TRANSPORT_BENCHMARK_PACKET_LEN 256
+#define TRANSPORT_BENCHMARK_TIMEOUT_MS 5000
+
+#if TRANSPORT_BENCHMARK_PAYLOAD_LEN + 64 > TRANSPORT_BENCHMARK_PACKET_LEN
+#error "TRANSPORT_BENCHMARK_PAYLOAD_LEN must leave room for the PUBLISH header in the broker's packet buffer"
+#endif
+
+typedef struct {
+	mbedtls_net_context *pFd;
+	size_t bytesIn;
+	size_t bytesOut;
+} CountingBio;
+
+typedef struct {
+	bool isTls;
+	mbedtls_net_context listenFd;
+	mbedtls_entropy_context entropy;
+	mbedtls_ctr_drbg_context ctr_drbg;
+	mbedtls_ssl_config conf;
+	mbedtls_x509_crt cacert;
+	mbedtls_x509_crt srvcert;
+	mbedtls_pk_context pkey;
+	/* Written by the broker thread, read once it was joined */
+	int ret;
+	int publishCount;
+	size_t connectBytesIn;
+	size_t connectBytesOut;
+	size_t publishBytesIn;
+	size_t publishBytesOut;
+} BenchmarkBroker;
+
+typedef struct {
+	const char *pName;
+	double connectMs;
+	double publishAvgMs;
+	double publishMaxMs;
+	double publishCpuMs;
+	double bytesIn;
+	double bytesOut;
+} BenchmarkResult;
+
+static int aws_iot_transport_tests_counting_send(void *ctx, const unsigned char *buf, size_t len) {
+	CountingBio *pBio = (CountingBio *) ctx;
+	int ret = mbedtls_net_send(pBio->pFd, buf, len);
+
+	if(0 < ret) {
+		pBio->bytesOut += (size_t) ret;
+	}
+	return ret;
+}
+
+static int aws_iot_transport_tests_counting_recv(void *ctx, unsigned char *buf, size_t len) {
+	CountingBio *pBio = (CountingBio *) ctx;
+	int ret = mbedtls_net_recv(pBio->pFd, buf, len);
+
+	if(0 < ret) {
+		pBio->bytesIn += (size_t) ret;
+	}
+	return ret;
+}
+
+static double aws_iot_transport_tests_elapsed_ms(struct timespec *pStart, struct timespec *pEnd) {
+	return (double) (pEnd->tv_sec - pStart->tv_sec) * 1000.0 + (double) (pEnd->tv_nsec - pStart->tv_nsec) / 1000000.0;
+}
+
+/* Reads or writes exactly len bytes of the MQTT stream, through TLS or straight from the socket */
+static int aws_iot_transport_tests_broker_io(BenchmarkBroker *pBroker, mbedtls_ssl_context *pSsl, CountingBio *pBio,
+											 unsigned char *pBuf, size_t len, bool isWrite) {
+	int ret;
+
+	while(0 < len) {
+		if(pBroker->isTls) {
+			ret = isWrite ? mbedtls_ssl_write(pSsl, pBuf, len) : mbedtls_ssl_read(pSsl, pBuf, len);
+			if(MBEDTLS_ERR_SSL_WANT_READ == ret || MBEDTLS_ERR_SSL_WANT_WRITE == ret) {
+				continue;
+			}
+		} else {
+			ret = isWrite ? aws_iot_transport_tests_counting_send(pBio, pBuf, len)
+						  : aws_iot_transport_tests_counting_recv(pBio, pBuf, len);
+		}
+		if(0 >= ret) {
+			return -1;
+		}
+		pBuf += ret;
+		len -= (size_t) ret;
+	}
+	return 0;
+}
+
+/* Serves one MQTT connection until the client disconnects, acknowledging every QoS1 PUBLISH */
+static void *aws_iot_transport_tests_broker_runner(void *ptr) {
+	static const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	static const unsigned char pingresp[] = { 0xD0, 0x00 };
+	BenchmarkBroker *pBroker = (BenchmarkBroker *) ptr;
+	mbedtls_net_context clientFd;
+	mbedtls_ssl_context ssl;
+	CountingBio bio;
+	unsigned char buf[TRANSPORT_BENCHMARK_PACKET_LEN];
+	unsigned char ack[4];
+	size_t remaining, multiplier, topicLen;
+	int ret, i;
+
+	mbedtls_net_init(&clientFd);
+	mbedtls_ssl_init(&ssl);
+	bio.pFd = &clientFd;
+	bio.bytesIn = 0;
+	bio.bytesOut = 0;
+
+	ret = mbedtls_net_accept(&(pBroker->listenFd), &clientFd, NULL, 0, NULL);
+	if(0 == ret && pBroker->isTls) {
+		ret = mbedtls_ssl_setup(&ssl, &(pBroker->conf));
+		if(0 == ret) {
+			mbedtls_ssl_set_bio(&ssl, &bio, aws_iot_transport_tests_counting_send,
+								aws_iot_transport_tests_counting_recv, NULL);
+			while((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+				if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+					break;
+				}
+			}
+		}
+	}
+
+	while(0 == ret) {
+		/* Fixed header, then the remaining length one byte at a time */
+		ret = aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, buf, 1, false);
+		remaining = 0;
+		multiplier = 1;
+		for(i = 1; 0 == ret && 5 > i; i++) {
+			ret = aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, &buf[i], 1, false);
+			remaining += (buf[i] & 0x7F) * multiplier;
+			multiplier *= 128;
+			if(0 == (buf[i] & 0x80)) {
+				break;
+			}
+		}
+		if(0 != ret || sizeof(buf) - 1 < remaining
+		   || 0 != aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, buf + 1, remaining, false)) {
+			ret = -1;
+			break;
+		}
+
+		switch(buf[0] >> 4) {
+			case 1: /* CONNECT */
+				ret = aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, (unsigned char *) connack,
+														sizeof(connack), true);
+				pBroker->connectBytesIn = bio.bytesIn;
+				pBroker->connectBytesOut = bio.bytesOut;
+				break;
+			case 3: /* PUBLISH, at QoS1 the packet id follows the topic */
+				topicLen = ((size_t) buf[1] << 8) | buf[2];
+				if(0 != (buf[0] & 0x06)) {
+					if(4 + topicLen > remaining) {
+						ret = -1;
+						break;
+					}
+					ack[0] = 0x40;
+					ack[1] = 0x02;
+					ack[2] = buf[3 + topicLen];
+					ack[3] = buf[4 + topicLen];
+					ret = aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, ack, sizeof(ack), true);
+				}
+				pBroker->publishCount++;
+				pBroker->publishBytesIn = bio.bytesIn - pBroker->connectBytesIn;
+				pBroker->publishBytesOut = bio.bytesOut - pBroker->connectBytesOut;
+				break;
+			case 12: /* PINGREQ */
+				ret = aws_iot_transport_tests_broker_io(pBroker, &ssl, &bio, (unsigned char *) pingresp,
+														sizeof(pingresp), true);
+				break;
+			case 14: /* DISCONNECT */
+				ret = 1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	pBroker->ret = (1 == ret) ? 0 : ret;
+	mbedtls_ssl_free(&ssl);
+	mbedtls_net_free(&clientFd);
+
+	return NULL;
+}
+
+static int aws_iot_transport_tests_broker_init(BenchmarkBroker *pBroker, bool isTls) {
+	char portBuffer[6];
+	int ret;
+
+	memset(pBroker, 0, sizeof(BenchmarkBroker));
+	pBroker->isTls = isTls;
+	pBroker->ret = -1;
+	mbedtls_net_init(&(pBroker->listenFd));
+	mbedtls_entropy_init(&(pBroker->entropy));
+	mbedtls_ctr_drbg_init(&(pBroker->ctr_drbg));
+	mbedtls_ssl_config_init(&(pBroker->conf));
+	mbedtls_x509_crt_init(&(pBroker->cacert));
+	mbedtls_x509_crt_init(&(pBroker->srvcert));
+	mbedtls_pk_init(&(pBroker->pkey));
+
+	/* Like AWS IoT, the client authenticates with its certificate */
+	if(isTls && ((ret = mbedtls_ctr_drbg_seed(&(pBroker->ctr_drbg), mbedtls_entropy_func, &(pBroker->entropy),
+											  (const unsigned char *) "transport_bench", 15)) != 0
+				 || (ret = mbedtls_x509_crt_parse(&(pBroker->cacert), (const unsigned char *) mbedtls_test_cas_pem,
+												  mbedtls_test_cas_pem_len)) != 0
+				 || (ret = mbedtls_x509_crt_parse(&(pBroker->srvcert), (const unsigned char *) mbedtls_test_srv_crt_ec,
+												  mbedtls_test_srv_crt_ec_len)) != 0
+				 || (ret = mbedtls_pk_parse_key(&(pBroker->pkey), (const unsigned char *) mbedtls_test_srv_key_ec,
+												mbedtls_test_srv_key_ec_len, NULL, 0)) != 0
+				 || (ret = mbedtls_ssl_config_defaults(&(pBroker->conf), MBEDTLS_SSL_IS_SERVER,
+													   MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT)) != 0
+				 || (ret = mbedtls_ssl_conf_own_cert(&(pBroker->conf), &(pBroker->srvcert), &(pBroker->pkey))) != 0)) {
+		IOT_ERROR("Broker TLS setup failed -0x%x\n", -ret);
+		return ret;
+	}
+	if(isTls) {
+		mbedtls_ssl_conf_rng(&(pBroker->conf), mbedtls_ctr_drbg_random, &(pBroker->ctr_drbg));
+		mbedtls_ssl_conf_ca_chain(&(pBroker->conf), &(pBroker->cacert), NULL);
+		mbedtls_ssl_conf_authmode(&(pBroker->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
+	}
+
+	snprintf(portBuffer, sizeof(portBuffer), "%d", TRANSPORT_BENCHMARK_PORT);
+	if((ret = mbedtls_net_bind(&(pBroker->listenFd), "127.0.0.1", portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
+		IOT_ERROR("Binding port %s failed -0x%x\n", portBuffer, -ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void aws_iot_transport_tests_broker_free(BenchmarkBroker *pBroker) {
+	mbedtls_net_free(&(pBroker->listenFd));
+	mbedtls_pk_free(&(pBroker->pkey));
+	mbedtls_x509_crt_free(&(pBroker->srvcert));
+	mbedtls_x509_crt_free(&(pBroker->cacert));
+	mbedtls_ssl_config_free(&(pBroker->conf));
+	mbedtls_ctr_drbg_free(&(pBroker->ctr_drbg));
+	mbedtls_entropy_free(&(pBroker->entropy));
+}
+
+/* Connects, publishes and disconnects over one transport while its broker counts the bytes */
+static int aws_iot_transport_tests_run(IoT_Network_Transport transport, BenchmarkResult *pResult) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Publish_Message_Params params;
+	AWS_IoT_Client client;
+	BenchmarkBroker broker;
+	pthread_t brokerThread;
+	struct timespec start, end, cpuStart, cpuEnd;
+	char payload[TRANSPORT_BENCHMARK_PAYLOAD_LEN];
+	double publishMs, publishSumMs = 0;
+	bool isTls = (IOT_NETWORK_TRANSPORT_TLS == transport);
+	IoT_Error_t rc = SUCCESS;
+	int i;
+
+	memset(pResult, 0, sizeof(BenchmarkResult));
+	pResult->pName = isTls ? "TLS" : "TCP";
+
+	if(0 != aws_iot_transport_tests_broker_init(&broker, isTls)
+	   || 0 != pthread_create(&brokerThread, NULL, aws_iot_transport_tests_broker_runner, &broker)) {
+		aws_iot_transport_tests_broker_free(&broker);
+		return -1;
+	}
+
+	initParams.pHostURL = TRANSPORT_BENCHMARK_HOST;
+	initParams.port = TRANSPORT_BENCHMARK_PORT;
+	initParams.transport = transport;
+	initParams.pRootCALocation = mbedtls_test_cas_pem;
+	initParams.rootCALen = mbedtls_test_cas_pem_len;
+	initParams.pDeviceCertLocation = mbedtls_test_cli_crt_ec;
+	initParams.deviceCertLen = mbedtls_test_cli_crt_ec_len;
+	initParams.pDevicePrivateKeyLocation = mbedtls_test_cli_key_ec;
+	initParams.devicePrivateKeyLen = mbedtls_test_cli_key_ec_len;
+	initParams.isSSLHostnameVerify = true;
+	initParams.mqttCommandTimeout_ms = TRANSPORT_BENCHMARK_TIMEOUT_MS;
+	initParams.tlsHandshakeTimeout_ms = TRANSPORT_BENCHMARK_TIMEOUT_MS;
+	initParams.enableAutoReconnect = false;
+	rc = aws_iot_mqtt_init(&client, &initParams);
+
+	connectParams.keepAliveIntervalInSec = 60;
+	connectParams.isCleanSession = true;
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = INTEGRATION_TEST_CLIENT_ID;
+	connectParams.clientIDLen = (uint16_t) strlen(INTEGRATION_TEST_CLIENT_ID);
+	if(SUCCESS == rc) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		rc = aws_iot_mqtt_connect(&client, &connectParams);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		pResult->connectMs = aws_iot_transport_tests_elapsed_ms(&start, &end);
+	}
+
+	memset(payload, 'x', sizeof(payload));
+	params.qos = QOS1;
+	params.isRetained = 0;
+	params.payload = (void *) payload;
+	params.payloadLen = sizeof(payload);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+	for(i = 0; i < TRANSPORT_BENCHMARK_PUBLISH_COUNT && SUCCESS == rc; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		/* Returns once the PUBACK is in */
+		rc = aws_iot_mqtt_publish(&client, TRANSPORT_BENCHMARK_TOPIC, (uint16_t) strlen(TRANSPORT_BENCHMARK_TOPIC),
+								  &params);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		publishMs = aws_iot_transport_tests_elapsed_ms(&start, &end);
+		publishSumMs += publishMs;
+		if(publishMs > pResult->publishMaxMs) {
+			pResult->publishMaxMs = publishMs;
+		}
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+
+	if(SUCCESS != rc) {
+		IOT_ERROR("%s: MQTT session failed : %d\n", pResult->pName, rc);
+	}
+	(void)aws_iot_mqtt_disconnect(&client);
+	(void)aws_iot_mqtt_free(&client);
+
+	if(SUCCESS != rc) {
+		/* The broker may still wait in accept or read */
+		pthread_cancel(brokerThread);
+	}
+	pthread_join(brokerThread, NULL);
+	aws_iot_transport_tests_broker_free(&broker);
+
+	if(SUCCESS != rc || 0 != broker.ret || TRANSPORT_BENCHMARK_PUBLISH_COUNT != broker.publishCount) {
+		IOT_ERROR("%s: broker returned %d after %d publishes\n", pResult->pName, broker.ret, broker.publishCount);
+		return -1;
+	}
+
+	pResult->publishAvgMs = publishSumMs / TRANSPORT_BENCHMARK_PUBLISH_COUNT;
+	pResult->publishCpuMs = aws_iot_transport_tests_elapsed_ms(&cpuStart, &cpuEnd) / TRANSPORT_BENCHMARK_PUBLISH_COUNT;
+	pResult->bytesIn = (double) broker.publishBytesIn / TRANSPORT_BENCHMARK_PUBLISH_COUNT;
+	pResult->bytesOut = (double) broker.publishBytesOut / TRANSPORT_BENCHMARK_PUBLISH_COUNT;
+	printf("%-4s connect (ms): %7.2f  publish (ms): avg %6.3f max %6.3f  CPU (ms) per publish: %6.3f  "
+		   "bytes per publish: client %6.1f broker %6.1f\n", pResult->pName, pResult->connectMs,
+		   pResult->publishAvgMs, pResult->publishMaxMs, pResult->publishCpuMs, pResult->bytesIn, pResult->bytesOut);
+
+	return 0;
+}
+
+int main() {
+	BenchmarkResult tcp, tls;
+	int rc;
+
+	printf("\n\n");
+	printf("******************************************************************\n");
+	printf("* Starting Transport Overhead Benchmark                          *\n");
+	printf("******************************************************************\n");
+	printf("\n%d QoS1 publishes of %d bytes per transport, one after the other\n\n",
+		   TRANSPORT_BENCHMARK_PUBLISH_COUNT, TRANSPORT_BENCHMARK_PAYLOAD_LEN);
+
+	rc = aws_iot_transport_tests_run(IOT_NETWORK_TRANSPORT_TCP, &tcp);
+	if(0 == rc) {
+		rc = aws_iot_transport_tests_run(IOT_NETWORK_TRANSPORT_TLS, &tls);
+	}
+	if(0 == rc) {
+		printf("\nTLS over TCP: connect x%.1f, publish x%.1f, CPU per publish x%.1f, "
+			   "bytes per publish +%.1f client +%.1f broker\n", tls.connectMs / tcp.connectMs,
+			   tls.publishAvgMs / tcp.publishAvgMs, tls.publishCpuMs / tcp.publishCpuMs, tls.bytesIn - tcp.bytesIn,
+			   tls.bytesOut - tcp.bytesOut);
+	}
+
+	if(0 != rc) {
+		printf("\n*******************************************************************\n");
+		printf("* Transport Overhead Benchmark FAILED!                             \n");
+		printf("*******************************************************************\n");
+		return 1;
+	}
+
+	printf("\n******************************************************************\n");
+	printf("* Transport Overhead Benchmark SUCCESS!!                         *\n");
+	printf("******************************************************************\n");
+
+	return 0;
+}
@@ -70,4 +70,20 @@
 #define AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL 1000 ///< Minimum time before the First reconnect attempt is made as part of the exponential back-off algorithm
 #define AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL 128000 ///< Maximum time interval after which exponential back-off will stop attempting to reconnect.
 
+// Asynchronous publish queue, sizes are the defaults from aws_iot_mqtt_client.h
+#define ENABLE_IOT_PUBLISH_QUEUE
+
+// Received messages handed to worker tasks, sizes are the defaults from aws_iot_mqtt_client.h
+#define ENABLE_IOT_DISPATCH_POOL
+
+// Small packets sent during yield leave in one network write
+#define ENABLE_IOT_WRITE_COALESCING
+
+// MQTT 5 is available, each test picks the protocol version it connects with
+#define ENABLE_IOT_MQTT5
+
+// Binary event trace, a single ring so the order of events doesn't depend on the CPU a test runs on
+#define AWS_IOT_TRACE_RING_LEN 32
+#define AWS_IOT_TRACE_MAX_CORES 1
+
 #endif /* IOT_TESTS_UNIT_CONFIG_H_ */
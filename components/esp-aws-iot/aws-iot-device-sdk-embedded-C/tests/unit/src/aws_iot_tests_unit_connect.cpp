@@ -84,3 +84,11 @@ TEST_GROUP_C_WRAPPER(ConnectTests, cleanSessionInitSubscribers)
 TEST_GROUP_C_WRAPPER(ConnectTests, PowerCycleWithCleanSessionFalse)
 /* B:29 - Reconnect attempt succeeds, but resubscribes fail */
 TEST_GROUP_C_WRAPPER(ConnectTests, ReconnectAndResubscribe)
+/* B:30 - Init with an endpoint list instead of a host */
+TEST_GROUP_C_WRAPPER(ConnectTests, EndpointListWithoutHost)
+/* B:31 - Init with an incomplete endpoint list */
+TEST_GROUP_C_WRAPPER(ConnectTests, EndpointListIncomplete)
+/* B:32 - Init hands credential lengths to the network */
+TEST_GROUP_C_WRAPPER(ConnectTests, CredentialLengths)
+/* B:33 - Init with the plain TCP transport where it is not built in */
+TEST_GROUP_C_WRAPPER(ConnectTests, PlainTcpNotBuiltIn)
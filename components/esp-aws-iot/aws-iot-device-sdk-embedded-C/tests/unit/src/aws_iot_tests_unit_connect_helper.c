@@ -790,3 +790,109 @@ TEST_C(ConnectTests, ReconnectAndResubscribe) {
 
 	IOT_DEBUG("-->Success - B:29 - Reconnect attempt succeeds, but resubscribes fail \n");
 }
+
+/* B:30 - Init with an endpoint list instead of a host */
+TEST_C(ConnectTests, EndpointListWithoutHost) {
+	IoT_Error_t rc = SUCCESS;
+	TLSEndpoint endpoints[2] = { { AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, 0 }, { "backup.example.com", 443, 0 } };
+
+	IOT_DEBUG("-->Running Connect Tests - B:30 - Init with an endpoint list instead of a host \n");
+
+	InitMQTTParamsSetup(&initParams, NULL, 0, false, NULL);
+	initParams.pEndpoints = endpoints;
+	initParams.endpointCount = 2;
+	initParams.endpointRaceDelay_ms = 100;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The list reaches the network stack, the first entry stands in as destination */
+	CHECK_C(endpoints == iotClient.networkStack.tlsConnectParams.pEndpoints);
+	CHECK_EQUAL_C_INT(2, iotClient.networkStack.tlsConnectParams.endpointCount);
+	CHECK_EQUAL_C_INT(0, iotClient.networkStack.tlsConnectParams.preferredEndpoint);
+	CHECK_EQUAL_C_INT(100, iotClient.networkStack.tlsConnectParams.endpointRaceDelay_ms);
+	CHECK_EQUAL_C_STRING(AWS_IOT_MQTT_HOST, iotClient.networkStack.tlsConnectParams.pDestinationURL);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PORT, iotClient.networkStack.tlsConnectParams.DestinationPort);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - B:30 - Init with an endpoint list instead of a host \n");
+}
+
+/* B:31 - Init with an incomplete endpoint list */
+TEST_C(ConnectTests, EndpointListIncomplete) {
+	IoT_Error_t rc = SUCCESS;
+	TLSEndpoint endpoints[2] = { { AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, 0 }, { NULL, 443, 0 } };
+
+	IOT_DEBUG("-->Running Connect Tests - B:31 - Init with an incomplete endpoint list \n");
+
+	InitMQTTParamsSetup(&initParams, NULL, 0, false, NULL);
+	initParams.endpointCount = 2;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	initParams.pEndpoints = endpoints;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	initParams.endpointCount = 1;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - B:31 - Init with an incomplete endpoint list \n");
+}
+
+/* B:32 - Init hands credential lengths to the network */
+TEST_C(ConnectTests, CredentialLengths) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Connect Tests - B:32 - Init hands credential lengths to the network \n");
+
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Without lengths the locations stay paths or NUL terminated PEM */
+	CHECK_EQUAL_C_INT(0, (int) iotClient.networkStack.tlsConnectParams.rootCALen);
+	CHECK_EQUAL_C_INT(0, (int) iotClient.networkStack.tlsConnectParams.deviceCertLen);
+	CHECK_EQUAL_C_INT(0, (int) iotClient.networkStack.tlsConnectParams.devicePrivateKeyLen);
+
+	initParams.rootCALen = 850;
+	initParams.deviceCertLen = 860;
+	initParams.devicePrivateKeyLen = 1190;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(850, (int) iotClient.networkStack.tlsConnectParams.rootCALen);
+	CHECK_EQUAL_C_INT(860, (int) iotClient.networkStack.tlsConnectParams.deviceCertLen);
+	CHECK_EQUAL_C_INT(1190, (int) iotClient.networkStack.tlsConnectParams.devicePrivateKeyLen);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - B:32 - Init hands credential lengths to the network \n");
+}
+
+/* B:33 - Init with the plain TCP transport where it is not built in */
+TEST_C(ConnectTests, PlainTcpNotBuiltIn) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Connect Tests - B:33 - Init with the plain TCP transport where it is not built in \n");
+
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.transport = IOT_NETWORK_TRANSPORT_TCP;
+	initParams.pRootCALocation = NULL;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(TCP_SETUP_ERROR, rc);
+
+	/* TLS still asks for the credentials */
+	initParams.transport = IOT_NETWORK_TRANSPORT_TLS;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - B:33 - Init with the plain TCP transport where it is not built in \n");
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_dispatch.cpp
+ * @brief IoT Client Unit Testing - Dispatch Pool Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(DispatchTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(DispatchTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(DispatchTests)
+};
+
+/* J:1 - Dispatch APIs with Null parameters */
+TEST_GROUP_C_WRAPPER(DispatchTests, DispatchNullParams)
+/* J:2 - Set dispatch policy of a topic without subscription */
+TEST_GROUP_C_WRAPPER(DispatchTests, SetPolicyUnknownTopic)
+/* J:3 - Dispatched message handled by the worker, not by yield */
+TEST_GROUP_C_WRAPPER(DispatchTests, MessageHandledByWorker)
+/* J:4 - Full queue with drop oldest policy */
+TEST_GROUP_C_WRAPPER(DispatchTests, FullQueueDropOldest)
+/* J:5 - Full queue with drop newest policy */
+TEST_GROUP_C_WRAPPER(DispatchTests, FullQueueDropNewest)
+/* J:6 - Full queue with block policy drops after waiting */
+TEST_GROUP_C_WRAPPER(DispatchTests, FullQueueBlock)
+/* J:7 - Message larger than a dispatch slot dropped */
+TEST_GROUP_C_WRAPPER(DispatchTests, OversizedMessageDropped)
+/* J:8 - Unsubscribe discards waiting messages */
+TEST_GROUP_C_WRAPPER(DispatchTests, UnsubscribeDiscardsWaiting)
+/* J:9 - Message queued while its subscription is busy handled by another worker */
+TEST_GROUP_C_WRAPPER(DispatchTests, QueuedWhileBusyHandledByOtherWorker)
@@ -0,0 +1,386 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_dispatch_helper.c
+ * @brief IoT Client Unit Testing - Dispatch Pool Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _ENABLE_THREAD_SUPPORT_
+#include <pthread.h>
+#endif
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#ifdef ENABLE_IOT_DISPATCH_POOL
+
+#define DISPATCH_TEST_MAX_MESSAGES 8
+/* Long enough for the reader to wait out two blocking drops with thread support */
+#define DISPATCH_TEST_FULL_QUEUE_YIELD_MS (2 * AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS + 100)
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client iotClient;
+
+static char subTopic[10] = "sdk/Test";
+static uint16_t subTopicLen = 8;
+
+static volatile uint32_t handledCount;
+static char handledPayloads[DISPATCH_TEST_MAX_MESSAGES][16];
+static char handledTopic[16];
+/* How long the handler takes for the first message */
+static uint32_t firstHandlerDelayMs;
+
+static void iot_tests_unit_dispatch_handler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+											IoT_Publish_Message_Params *pParams, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pData);
+
+	if(0 == handledCount && 0 < firstHandlerDelayMs) {
+		delay(firstHandlerDelayMs);
+	}
+	if(DISPATCH_TEST_MAX_MESSAGES > handledCount && sizeof(handledPayloads[0]) > pParams->payloadLen) {
+		memcpy(handledPayloads[handledCount], pParams->payload, pParams->payloadLen);
+	}
+	if(sizeof(handledTopic) > topicNameLen) {
+		memcpy(handledTopic, pTopicName, topicNameLen);
+		handledTopic[topicNameLen] = '\0';
+	}
+	handledCount++;
+}
+
+/* Place messages "msg0", "msg1", ... on the subscribed topic, all returned by one network read */
+static void setTLSRxBufferForMessages(uint32_t count) {
+	static unsigned char packets[TLSMaxBufferSize];
+	IoT_Publish_Message_Params params;
+	char payload[16];
+	size_t packetsLen = 0;
+	uint32_t itr;
+
+	params.qos = QOS0;
+	for(itr = 0; itr < count; itr++) {
+		snprintf(payload, sizeof(payload), "msg%u", (unsigned int) itr);
+		setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, params, payload);
+		memcpy(&packets[packetsLen], RxBuffer.pBuffer, RxBuffer.len);
+		packetsLen += RxBuffer.len;
+	}
+
+	memcpy(RxBuffer.pBuffer, packets, packetsLen);
+	RxBuffer.len = packetsLen;
+	RxIndex = 0;
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+}
+
+static uint32_t getDroppedDispatch(void) {
+#ifndef DISABLE_IOT_STATS
+	IoT_Client_Stats stats;
+
+	(void)aws_iot_mqtt_get_stats(&iotClient, &stats);
+	return stats.droppedDispatch;
+#else
+	return 0;
+#endif
+}
+
+/* Queue six messages on a subscription with the given policy, hand them to the worker */
+static void runFullQueue(IoT_Dispatch_Policy policy) {
+	IoT_Error_t rc;
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, policy);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMessages(AWS_IOT_MQTT_DISPATCH_QUEUE_LEN + 2);
+	rc = aws_iot_mqtt_yield(&iotClient, DISPATCH_TEST_FULL_QUEUE_YIELD_MS);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, handledCount);
+
+	rc = aws_iot_mqtt_dispatch_run(&iotClient, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_DISPATCH_QUEUE_LEN, handledCount);
+#ifndef DISABLE_IOT_STATS
+	CHECK_EQUAL_C_INT(2, getDroppedDispatch());
+#endif
+}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+static void *dispatchWorkerTask(void *pArg) {
+	(void)aws_iot_mqtt_dispatch_run(&iotClient, *(uint32_t *) pArg);
+	return NULL;
+}
+#endif
+
+#endif
+
+TEST_GROUP_C_SETUP(DispatchTests) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_dispatch_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	handledCount = 0;
+	firstHandlerDelayMs = 0;
+	memset(handledPayloads, 0, sizeof(handledPayloads));
+	memset(handledTopic, 0, sizeof(handledTopic));
+	ResetTLSBuffer();
+#endif
+}
+
+TEST_GROUP_C_TEARDOWN(DispatchTests) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+#endif
+}
+
+/* J:1 - Dispatch APIs with Null parameters */
+TEST_C(DispatchTests, DispatchNullParams) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:1 - Dispatch APIs with Null parameters \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(NULL, subTopic, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, NULL, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_dispatch_run(NULL, 10);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - J:1 - Dispatch APIs with Null parameters \n");
+#endif
+}
+
+/* J:2 - Set dispatch policy of a topic without subscription */
+TEST_C(DispatchTests, SetPolicyUnknownTopic) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:2 - Set dispatch policy of a topic without subscription \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, "sdk/Other", 9, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(FAILURE, rc);
+	/* A prefix of the subscribed filter is a different topic */
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen - 1, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(FAILURE, rc);
+
+	IOT_DEBUG("-->Success - J:2 - Set dispatch policy of a topic without subscription \n");
+#endif
+}
+
+/* J:3 - Dispatched message handled by the worker, not by yield */
+TEST_C(DispatchTests, MessageHandledByWorker) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:3 - Dispatched message handled by the worker, not by yield \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMessages(2);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, handledCount);
+
+	rc = aws_iot_mqtt_dispatch_run(&iotClient, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(2, handledCount);
+	CHECK_EQUAL_C_STRING("msg0", handledPayloads[0]);
+	CHECK_EQUAL_C_STRING("msg1", handledPayloads[1]);
+	CHECK_EQUAL_C_STRING(subTopic, handledTopic);
+	CHECK_EQUAL_C_INT(0, getDroppedDispatch());
+
+	/* Back to inline, the handler runs inside yield again */
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, DISPATCH_INLINE);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferForMessages(1);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(3, handledCount);
+
+	IOT_DEBUG("-->Success - J:3 - Dispatched message handled by the worker, not by yield \n");
+#endif
+}
+
+/* J:4 - Full queue with drop oldest policy */
+TEST_C(DispatchTests, FullQueueDropOldest) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IOT_DEBUG("-->Running Dispatch Tests - J:4 - Full queue with drop oldest policy \n");
+
+	runFullQueue(DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_STRING("msg2", handledPayloads[0]);
+	CHECK_EQUAL_C_STRING("msg5", handledPayloads[AWS_IOT_MQTT_DISPATCH_QUEUE_LEN - 1]);
+
+	IOT_DEBUG("-->Success - J:4 - Full queue with drop oldest policy \n");
+#endif
+}
+
+/* J:5 - Full queue with drop newest policy */
+TEST_C(DispatchTests, FullQueueDropNewest) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IOT_DEBUG("-->Running Dispatch Tests - J:5 - Full queue with drop newest policy \n");
+
+	runFullQueue(DISPATCH_DROP_NEWEST);
+	CHECK_EQUAL_C_STRING("msg0", handledPayloads[0]);
+	CHECK_EQUAL_C_STRING("msg3", handledPayloads[AWS_IOT_MQTT_DISPATCH_QUEUE_LEN - 1]);
+
+	IOT_DEBUG("-->Success - J:5 - Full queue with drop newest policy \n");
+#endif
+}
+
+/* J:6 - Full queue with block policy drops after waiting */
+TEST_C(DispatchTests, FullQueueBlock) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IOT_DEBUG("-->Running Dispatch Tests - J:6 - Full queue with block policy drops after waiting \n");
+
+	/* Nobody frees a slot while yield waits, so the newest messages go after the wait */
+	runFullQueue(DISPATCH_BLOCK);
+	CHECK_EQUAL_C_STRING("msg0", handledPayloads[0]);
+	CHECK_EQUAL_C_STRING("msg3", handledPayloads[AWS_IOT_MQTT_DISPATCH_QUEUE_LEN - 1]);
+
+	IOT_DEBUG("-->Success - J:6 - Full queue with block policy drops after waiting \n");
+#endif
+}
+
+/* J:7 - Message larger than a dispatch slot dropped */
+TEST_C(DispatchTests, OversizedMessageDropped) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	static char payload[AWS_IOT_MQTT_DISPATCH_SLOT_LEN];
+	IoT_Publish_Message_Params params;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:7 - Message larger than a dispatch slot dropped \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Topic plus payload with its terminating zero is one byte too many */
+	memset(payload, 'x', sizeof(payload) - subTopicLen);
+	payload[sizeof(payload) - subTopicLen] = '\0';
+	params.qos = QOS0;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, params, payload);
+	/* The helper counts a one byte remaining length, this packet needs two */
+	RxBuffer.len++;
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_dispatch_run(&iotClient, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, handledCount);
+#ifndef DISABLE_IOT_STATS
+	CHECK_EQUAL_C_INT(1, getDroppedDispatch());
+#endif
+
+	IOT_DEBUG("-->Success - J:7 - Message larger than a dispatch slot dropped \n");
+#endif
+}
+
+/* J:8 - Unsubscribe discards waiting messages */
+TEST_C(DispatchTests, UnsubscribeDiscardsWaiting) {
+#ifdef ENABLE_IOT_DISPATCH_POOL
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:8 - Unsubscribe discards waiting messages \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMessages(2);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForUnsuback();
+	rc = aws_iot_mqtt_unsubscribe(&iotClient, subTopic, subTopicLen);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_dispatch_run(&iotClient, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, handledCount);
+
+	/* All slots are free again and a new subscription starts out inline */
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_DISPATCH_SLOTS, iotClient.clientData.dispatchFreeCount);
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_dispatch_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferForMessages(1);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, handledCount);
+
+	IOT_DEBUG("-->Success - J:8 - Unsubscribe discards waiting messages \n");
+#endif
+}
+
+/* J:9 - Message queued while its subscription is busy handled by another worker */
+TEST_C(DispatchTests, QueuedWhileBusyHandledByOtherWorker) {
+#if defined(ENABLE_IOT_DISPATCH_POOL) && defined(_ENABLE_THREAD_SUPPORT_)
+	IoT_Error_t rc;
+	pthread_t workers[2];
+	uint32_t shortRunMs = 10, longRunMs = 1000;
+
+	IOT_DEBUG("-->Running Dispatch Tests - J:9 - Message queued while its subscription is busy handled by another worker \n");
+
+	rc = aws_iot_mqtt_set_dispatch_policy(&iotClient, subTopic, subTopicLen, DISPATCH_DROP_OLDEST);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMessages(1);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The first worker takes msg0 and runs out of time in the handler, the second one
+	 * finds the subscription busy and goes back to sleep */
+	firstHandlerDelayMs = 100;
+	CHECK_EQUAL_C_INT(0, pthread_create(&workers[0], NULL, dispatchWorkerTask, &shortRunMs));
+	delay(20);
+	CHECK_EQUAL_C_INT(0, pthread_create(&workers[1], NULL, dispatchWorkerTask, &longRunMs));
+	delay(20);
+
+	setTLSRxBufferForMessages(1);
+	rc = aws_iot_mqtt_yield(&iotClient, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The second worker must be woken up for msg1 once msg0 is done */
+	(void)pthread_join(workers[0], NULL);
+	delay(100);
+	CHECK_EQUAL_C_INT(2, handledCount);
+
+	(void)pthread_join(workers[1], NULL);
+
+	IOT_DEBUG("-->Success - J:9 - Message queued while its subscription is busy handled by another worker \n");
+#endif
+}
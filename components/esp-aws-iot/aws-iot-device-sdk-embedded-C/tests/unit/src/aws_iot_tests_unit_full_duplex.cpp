@@ -0,0 +1,40 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_full_duplex.cpp
+ * @brief IoT Client Unit Testing - Full-Duplex Tests
+ *
+ * Only built into the runner of make run-unit-tests-full-duplex.
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+
+TEST_GROUP_C(FullDuplexTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(FullDuplexTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(FullDuplexTests)
+};
+
+/* F:1 - Publishes from two tasks while a third one yields */
+TEST_GROUP_C_WRAPPER(FullDuplexTests, PublishDuringYield)
+/* F:2 - Publishes racing a disconnect and reconnect from another task */
+TEST_GROUP_C_WRAPPER(FullDuplexTests, PublishRacingReconnect)
+/* F:3 - Queued publish wakes up a yield sleeping on another task */
+TEST_GROUP_C_WRAPPER(FullDuplexTests, PublishAsyncWakesYield)
+
+#endif
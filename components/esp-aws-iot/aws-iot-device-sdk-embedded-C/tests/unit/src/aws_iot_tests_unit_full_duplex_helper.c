@@ -0,0 +1,418 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_full_duplex_helper.c
+ * @brief IoT Client Unit Testing - Full-Duplex Tests Helper
+ *
+ * The client sits on end A of a loopback link, a broker task on end B answers
+ * every QoS1 PUBLISH with its PUBACK. Yield and the publishers run on tasks of
+ * their own. Those tasks only count, all checks are made on the test task once
+ * they are joined.
+ */
+
+#ifdef ENABLE_IOT_FULL_DUPLEX
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_network_loopback.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_log.h"
+
+#define FULL_DUPLEX_TEST_RING_LEN 1024
+#define FULL_DUPLEX_TEST_PUBLISHES 20
+#define FULL_DUPLEX_TEST_RECONNECTS 3
+#define FULL_DUPLEX_TEST_YIELD_MS 20
+#define FULL_DUPLEX_TEST_RUN_MS 30
+#define FULL_DUPLEX_TEST_WAIT_MS 2000
+#define FULL_DUPLEX_TEST_LONG_YIELD_MS 1500
+#define FULL_DUPLEX_TEST_WAKE_MS 500
+
+typedef struct {
+	uint32_t publishLimit; ///< Publishes to make, runs until told to stop if 0
+	uint32_t publishes; ///< Publishes made
+	uint32_t acked; ///< Publishes that got their PUBACK
+	uint32_t lost; ///< Publishes lost to a disconnect
+	uint32_t unexpected; ///< Publishes that failed otherwise
+	IoT_Error_t unexpectedRc; ///< Return code of the last of those
+} PublisherStats;
+
+static IoT_Network_Loopback loopbackLink;
+static Network brokerEnd;
+static unsigned char ringAToB[FULL_DUPLEX_TEST_RING_LEN];
+static unsigned char ringBToA[FULL_DUPLEX_TEST_RING_LEN];
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static AWS_IoT_Client iotClient;
+
+static bool isStopping;
+static bool isPublishStopping;
+static uint32_t brokerPublishes;
+static uint32_t brokerBadPackets;
+static uint32_t brokerConnections;
+
+static IoT_Error_t brokerRead(unsigned char *pBuf, size_t len, uint32_t timeoutMs) {
+	Timer timer;
+	size_t readLen = 0;
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeoutMs);
+	return brokerEnd.read(&brokerEnd, pBuf, len, &timer, &readLen);
+}
+
+static void brokerWrite(const unsigned char *pBytes, size_t len) {
+	Timer timer;
+	size_t writtenLen = 0;
+
+	init_timer(&timer);
+	countdown_ms(&timer, FULL_DUPLEX_TEST_WAIT_MS);
+	(void)brokerEnd.write(&brokerEnd, (unsigned char *) pBytes, len, &timer, &writtenLen);
+}
+
+/**
+ * Reads whole packets from end B. A packet that does not parse means two writes
+ * of the client got mixed up or one was cut short by a disconnect, a packet after
+ * DISCONNECT that the client wrote to a connection it was closing.
+ */
+static void *brokerTask(void *pArg) {
+	static const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	static const unsigned char pingresp[] = { 0xD0, 0x00 };
+	unsigned char puback[] = { 0x40, 0x02, 0x00, 0x00 };
+	unsigned char buf[FULL_DUPLEX_TEST_RING_LEN];
+	unsigned char header;
+	size_t remLen, topicLen;
+	uint32_t shift;
+	bool isClosing = false;
+	IoT_Error_t rc;
+
+	IOT_UNUSED(pArg);
+
+	while(!__atomic_load_n(&isStopping, __ATOMIC_ACQUIRE)) {
+		rc = brokerRead(&header, 1, 10);
+		if(NETWORK_SSL_NOTHING_TO_READ == rc) {
+			continue;
+		}
+		if(NETWORK_SSL_READ_ERROR == rc) {
+			/* The client closed the connection, accept its next one */
+			brokerEnd.disconnect(&brokerEnd);
+			brokerEnd.connect(&brokerEnd, NULL);
+			brokerWrite(connack, sizeof(connack));
+			isClosing = false;
+			__atomic_add_fetch(&brokerConnections, 1, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		remLen = 0;
+		shift = 0;
+		do {
+			rc = brokerRead(buf, 1, FULL_DUPLEX_TEST_WAIT_MS);
+			remLen |= (size_t) (buf[0] & 0x7F) << shift;
+			shift += 7;
+		} while(SUCCESS == rc && 0 != (buf[0] & 0x80) && shift < 28);
+		if(SUCCESS != rc || sizeof(buf) < remLen || (0 < remLen && SUCCESS != brokerRead(buf, remLen, FULL_DUPLEX_TEST_WAIT_MS))) {
+			__atomic_add_fetch(&brokerBadPackets, 1, __ATOMIC_RELEASE);
+			continue;
+		}
+		if(isClosing) {
+			/* Nothing may follow a DISCONNECT on its connection */
+			__atomic_add_fetch(&brokerBadPackets, 1, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		switch(header & 0xF0) {
+			case 0x10:
+				/* CONNECT, its CONNACK was written ahead */
+				break;
+			case 0x30:
+				topicLen = ((size_t) buf[0] << 8) | buf[1];
+				if(0x02 != (header & 0x06) || remLen < 2 + topicLen + 2) {
+					__atomic_add_fetch(&brokerBadPackets, 1, __ATOMIC_RELEASE);
+					break;
+				}
+				puback[2] = buf[2 + topicLen];
+				puback[3] = buf[2 + topicLen + 1];
+				__atomic_add_fetch(&brokerPublishes, 1, __ATOMIC_RELEASE);
+				brokerWrite(puback, sizeof(puback));
+				break;
+			case 0xC0:
+				brokerWrite(pingresp, sizeof(pingresp));
+				break;
+			case 0xE0:
+				/* DISCONNECT, the client goes away right after */
+				isClosing = true;
+				break;
+			default:
+				__atomic_add_fetch(&brokerBadPackets, 1, __ATOMIC_RELEASE);
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+static void *yieldTask(void *pArg) {
+	IOT_UNUSED(pArg);
+
+	while(!__atomic_load_n(&isStopping, __ATOMIC_ACQUIRE)) {
+		if(SUCCESS != aws_iot_mqtt_yield(&iotClient, FULL_DUPLEX_TEST_YIELD_MS)) {
+			/* Disconnected, or a publisher reads for itself right now */
+			usleep(1000);
+		}
+	}
+
+	return NULL;
+}
+
+static void *publishTask(void *pArg) {
+	PublisherStats *pStats = (PublisherStats *) pArg;
+	IoT_Publish_Message_Params params;
+	IoT_Error_t rc;
+
+	params.qos = QOS1;
+	params.isRetained = 0;
+	params.payload = (void *) "duplex";
+	params.payloadLen = 6;
+
+	while(0 == pStats->publishLimit ? !__atomic_load_n(&isPublishStopping, __ATOMIC_ACQUIRE)
+									: pStats->publishes < pStats->publishLimit) {
+		rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &params);
+		pStats->publishes++;
+		if(SUCCESS == rc) {
+			pStats->acked++;
+		} else if(NETWORK_DISCONNECTED_ERROR == rc || MQTT_REQUEST_TIMEOUT_ERROR == rc) {
+			pStats->lost++;
+			usleep(1000);
+		} else {
+			pStats->unexpected++;
+			pStats->unexpectedRc = rc;
+		}
+	}
+
+	return NULL;
+}
+
+static void *longYieldTask(void *pArg) {
+	IoT_Error_t *pRc = (IoT_Error_t *) pArg;
+
+	*pRc = aws_iot_mqtt_yield(&iotClient, FULL_DUPLEX_TEST_LONG_YIELD_MS);
+	return NULL;
+}
+
+static void publishAsyncCompleteHandler(AWS_IoT_Client *pClient, IoT_Publish_Message_Params *pParams,
+										IoT_Error_t result, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pParams);
+
+	__atomic_store_n((IoT_Error_t *) pData, result, __ATOMIC_RELEASE);
+}
+
+static void waitForBrokerConnections(uint32_t count) {
+	uint32_t waitedMs;
+
+	for(waitedMs = 0; waitedMs < FULL_DUPLEX_TEST_WAIT_MS; waitedMs++) {
+		if(count <= __atomic_load_n(&brokerConnections, __ATOMIC_ACQUIRE)) {
+			return;
+		}
+		usleep(1000);
+	}
+}
+
+static void stopTasks(pthread_t *pTasks, int taskCount) {
+	int itr;
+
+	__atomic_store_n(&isStopping, true, __ATOMIC_RELEASE);
+	for(itr = 0; itr < taskCount; itr++) {
+		(void)pthread_join(pTasks[itr], NULL);
+	}
+}
+
+TEST_GROUP_C_SETUP(FullDuplexTests) {
+	static const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	IoT_Error_t rc;
+
+	isStopping = false;
+	isPublishStopping = false;
+	brokerPublishes = 0;
+	brokerBadPackets = 0;
+	brokerConnections = 0;
+
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.isBlockOnThreadLockEnabled = true;
+	initParams.mqttCommandTimeout_ms = 1000;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+
+	rc = aws_iot_network_loopback_init(&loopbackLink, ringAToB, ringBToA, FULL_DUPLEX_TEST_RING_LEN, 0, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&(iotClient.networkStack), &loopbackLink, IOT_LOOPBACK_END_A);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&brokerEnd, &loopbackLink, IOT_LOOPBACK_END_B);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, brokerEnd.connect(&brokerEnd, NULL));
+
+	brokerWrite(connack, sizeof(connack));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+}
+
+TEST_GROUP_C_TEARDOWN(FullDuplexTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+	(void)aws_iot_mqtt_free(&iotClient);
+	(void)aws_iot_network_loopback_free(&loopbackLink);
+}
+
+/* F:1 - Publishes from two tasks while a third one yields */
+TEST_C(FullDuplexTests, PublishDuringYield) {
+	PublisherStats stats[2];
+	pthread_t tasks[4];
+	int itr;
+
+	IOT_DEBUG("-->Running Full-Duplex Tests - F:1 - Publishes from two tasks while a third one yields \n");
+
+	memset(stats, 0, sizeof(stats));
+	stats[0].publishLimit = FULL_DUPLEX_TEST_PUBLISHES;
+	stats[1].publishLimit = FULL_DUPLEX_TEST_PUBLISHES;
+
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[0], NULL, brokerTask, NULL));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[1], NULL, yieldTask, NULL));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[2], NULL, publishTask, &stats[0]));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[3], NULL, publishTask, &stats[1]));
+
+	(void)pthread_join(tasks[2], NULL);
+	(void)pthread_join(tasks[3], NULL);
+	stopTasks(tasks, 2);
+
+	for(itr = 0; itr < 2; itr++) {
+		CHECK_EQUAL_C_INT(0, stats[itr].unexpected);
+		CHECK_EQUAL_C_INT(FULL_DUPLEX_TEST_PUBLISHES, stats[itr].acked);
+	}
+	CHECK_EQUAL_C_INT(2 * FULL_DUPLEX_TEST_PUBLISHES, brokerPublishes);
+	CHECK_EQUAL_C_INT(0, brokerBadPackets);
+	CHECK_EQUAL_C_INT(true, aws_iot_mqtt_is_client_connected(&iotClient));
+
+	IOT_DEBUG("-->Success - F:1 - Publishes from two tasks while a third one yields \n");
+}
+
+/* F:2 - Publishes racing a disconnect and reconnect from another task */
+TEST_C(FullDuplexTests, PublishRacingReconnect) {
+	IoT_Publish_Message_Params params;
+	IoT_Error_t connectRc[FULL_DUPLEX_TEST_RECONNECTS];
+	IoT_Error_t rc;
+	PublisherStats stats;
+	pthread_t tasks[3];
+	uint32_t round;
+
+	IOT_DEBUG("-->Running Full-Duplex Tests - F:2 - Publishes racing a disconnect and reconnect from another task \n");
+
+	memset(&stats, 0, sizeof(stats));
+
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[0], NULL, brokerTask, NULL));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[1], NULL, yieldTask, NULL));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[2], NULL, publishTask, &stats));
+
+	for(round = 0; round < FULL_DUPLEX_TEST_RECONNECTS; round++) {
+		usleep(FULL_DUPLEX_TEST_RUN_MS * 1000);
+		do {
+			/* Yield may change the state between the check and the change */
+			rc = aws_iot_mqtt_disconnect(&iotClient);
+		} while(MQTT_UNEXPECTED_CLIENT_STATE_ERROR == rc);
+		waitForBrokerConnections(round + 1);
+		connectRc[round] = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	}
+	usleep(FULL_DUPLEX_TEST_RUN_MS * 1000);
+
+	__atomic_store_n(&isPublishStopping, true, __ATOMIC_RELEASE);
+	(void)pthread_join(tasks[2], NULL);
+
+	/* The client still works once the race is over */
+	params.qos = QOS1;
+	params.isRetained = 0;
+	params.payload = (void *) "after";
+	params.payloadLen = 5;
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &params);
+	stopTasks(tasks, 2);
+
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	for(round = 0; round < FULL_DUPLEX_TEST_RECONNECTS; round++) {
+		CHECK_EQUAL_C_INT(SUCCESS, connectRc[round]);
+	}
+	CHECK_EQUAL_C_INT(FULL_DUPLEX_TEST_RECONNECTS, brokerConnections);
+	/* No publish was written to a connection going away or coming up */
+	CHECK_EQUAL_C_INT(0, stats.unexpected);
+	CHECK_EQUAL_C_INT(0, brokerBadPackets);
+	CHECK_C(0 < stats.acked);
+	CHECK_C(stats.acked + 1 <= brokerPublishes);
+
+	IOT_DEBUG("-->Success - F:2 - Publishes racing a disconnect and reconnect from another task \n");
+}
+
+/* F:3 - Queued publish wakes up a yield sleeping on another task */
+TEST_C(FullDuplexTests, PublishAsyncWakesYield) {
+	IoT_Publish_Message_Params params;
+	IoT_Publish_Queue_Params queueParams = iotPublishQueueParamsDefault;
+	IoT_Error_t completeRc = FAILURE;
+	IoT_Error_t yieldRc = FAILURE;
+	IoT_Error_t rc;
+	pthread_t tasks[2];
+	uint32_t waitedMs;
+
+	IOT_DEBUG("-->Running Full-Duplex Tests - F:3 - Queued publish wakes up a yield sleeping on another task \n");
+
+	params.qos = QOS1;
+	params.isRetained = 0;
+	params.payload = (void *) "wake";
+	params.payloadLen = 4;
+	queueParams.pCompleteHandler = publishAsyncCompleteHandler;
+	queueParams.pCompleteHandlerData = &completeRc;
+
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[0], NULL, brokerTask, NULL));
+	CHECK_EQUAL_C_INT(0, pthread_create(&tasks[1], NULL, longYieldTask, &yieldRc));
+	/* Nothing is due for seconds, yield is asleep by now */
+	usleep(50 * 1000);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, "sdk/Test", 8, &params, &queueParams);
+	for(waitedMs = 0; waitedMs < FULL_DUPLEX_TEST_WAKE_MS; waitedMs++) {
+		if(SUCCESS == __atomic_load_n(&completeRc, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		usleep(1000);
+	}
+
+	(void)pthread_join(tasks[1], NULL);
+	stopTasks(tasks, 1);
+
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, yieldRc);
+	/* Sent and acknowledged long before the yield would have woken up on its own */
+	CHECK_C(FULL_DUPLEX_TEST_WAKE_MS > waitedMs);
+	CHECK_EQUAL_C_INT(SUCCESS, completeRc);
+	CHECK_EQUAL_C_INT(1, brokerPublishes);
+	CHECK_EQUAL_C_INT(0, brokerBadPackets);
+
+	IOT_DEBUG("-->Success - F:3 - Queued publish wakes up a yield sleeping on another task \n");
+}
+
+#endif
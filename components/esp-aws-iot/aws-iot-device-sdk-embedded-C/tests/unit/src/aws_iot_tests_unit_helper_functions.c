@@ -58,6 +58,14 @@ void InitMQTTParamsSetup(IoT_Client_Init_Params *params, char *pHost, uint16_t p
 	params->pDeviceCertLocation = AWS_IOT_ROOT_CA_FILENAME;
 	params->pDevicePrivateKeyLocation = AWS_IOT_CERTIFICATE_FILENAME;
 	params->pRootCALocation = AWS_IOT_PRIVATE_KEY_FILENAME;
+	params->pEndpoints = NULL;
+	params->endpointCount = 0;
+	params->endpointRaceDelay_ms = 0;
+	params->rootCALen = 0;
+	params->deviceCertLen = 0;
+	params->devicePrivateKeyLen = 0;
+	params->tlsProfile = 0;
+	params->transport = IOT_NETWORK_TRANSPORT_TLS;
 }
 
 void ConnectMQTTParamsSetup(IoT_Client_Connect_Params *params, char *pClientID, uint16_t clientIDLen) {
@@ -265,6 +273,7 @@ void ResetTLSBuffer(void) {
 	}
 
 	RxIndex = 0;
+	RxRecordLen = 0;
 	RxBuffer.expiry_time.tv_sec = 0;
 	RxBuffer.expiry_time.tv_usec = 0;
 	TxBuffer.len = 0;
@@ -321,7 +330,7 @@ void setTLSRxBufferWithMsgOnSubscribedTopic(char *topicName, size_t topicNameLen
 		RxBuffer.pBuffer[payloadStartLoc + i] = (unsigned char) pMsg[i];
 	}
 
-	RxBuffer.len = VariableLen + PayloadLen + 2; // 2 for fixed header
+	RxBuffer.len = cursor + VariableLen + PayloadLen; // cursor is past the fixed header
 	RxIndex = 0;
 	//printBuffer(RxBuffer.pBuffer, RxBuffer.len);
 }
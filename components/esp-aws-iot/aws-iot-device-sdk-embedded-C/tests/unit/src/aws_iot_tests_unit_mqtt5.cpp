@@ -0,0 +1,56 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_mqtt5.cpp
+ * @brief IoT Client Unit Testing - MQTT 5 Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(Mqtt5Tests) {
+	TEST_GROUP_C_SETUP_WRAPPER(Mqtt5Tests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(Mqtt5Tests)
+};
+
+/* K:1 - CONNECT carries protocol level 5 and the client's properties */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ConnectPacketProperties)
+/* K:2 - Persistent session announces a Session Expiry Interval */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ConnectPersistentSessionExpiry)
+/* K:3 - CONNACK properties applied to the client */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ConnackPropertiesApplied)
+/* K:4 - CONNACK failure reason code */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ConnackNotAuthorized)
+/* K:5 - Second publish to a topic only sends its alias */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, PublishUsesTopicAlias)
+/* K:6 - No alias when the server doesn't allow any */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, PublishWithoutTopicAliases)
+/* K:7 - QoS1 publish beyond the Receive Maximum waits for a PUBACK */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ReceiveMaximumLimitsPublishes)
+/* K:8 - PUBACK failure reason code */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, PubackReasonCodeRejects)
+/* K:9 - Incoming publish with properties */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, IncomingPublishWithProperties)
+/* K:10 - SUBACK failure reason code */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, SubackReasonCodeRejects)
+/* K:11 - UNSUBACK failure reason code */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, UnsubackReasonCodeRejects)
+/* K:12 - DISCONNECT from the server during yield */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ServerDisconnect)
+/* K:13 - QoS1 publishes use aliases, the session store keeps and resends the topic */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, TopicAliasWithSessionStore)
+/* K:14 - Every stored message is resent when the Receive Maximum lets one through at a time */
+TEST_GROUP_C_WRAPPER(Mqtt5Tests, ResendSessionWithinReceiveMaximum)
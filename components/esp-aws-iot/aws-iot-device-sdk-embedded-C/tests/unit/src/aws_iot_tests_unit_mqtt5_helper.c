@@ -0,0 +1,636 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_mqtt5_helper.c
+ * @brief IoT Client Unit Testing - MQTT 5 Tests Helper
+ *
+ * The mock TLS layer plays the MQTT 5 server, the packets it returns are built
+ * byte by byte below.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_session_store_ram.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#ifdef ENABLE_IOT_MQTT5
+
+/* Short enough for the tests that wait out a missing PUBACK */
+#define MQTT5_TEST_COMMAND_TIMEOUT_MS 500
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static AWS_IoT_Client iotClient;
+
+static char subTopic[10] = "sdk/Test";
+static uint16_t subTopicLen = 8;
+
+static uint32_t handledCount;
+static char handledPayload[16];
+
+static void iot_tests_unit_mqtt5_handler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+										 IoT_Publish_Message_Params *pParams, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pTopicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	if(sizeof(handledPayload) > pParams->payloadLen) {
+		memcpy(handledPayload, pParams->payload, pParams->payloadLen);
+		handledPayload[pParams->payloadLen] = '\0';
+	}
+	handledCount++;
+}
+
+static void setTLSRxBufferForPacket(const unsigned char *pPacket, size_t len) {
+	memcpy(RxBuffer.pBuffer, pPacket, len);
+	RxBuffer.len = len;
+	RxBuffer.NoMsgFlag = false;
+	RxIndex = 0;
+}
+
+static void setTLSRxBufferForMqtt5Puback(uint16_t packetId, uint8_t reasonCode) {
+	unsigned char puback[] = {0x40, 0x03, 0x00, 0x00, 0x00};
+
+	puback[2] = (unsigned char) (packetId >> 8);
+	puback[3] = (unsigned char) (packetId & 0xFF);
+	puback[4] = reasonCode;
+	setTLSRxBufferForPacket(puback, sizeof(puback));
+}
+
+static void setTLSRxBufferForMqtt5Suback(uint8_t reasonCode) {
+	unsigned char suback[] = {0x90, 0x04, 0x00, 0x01, 0x00, 0x00};
+
+	suback[5] = reasonCode;
+	setTLSRxBufferForPacket(suback, sizeof(suback));
+}
+
+/* CONNACK announcing a Receive Maximum and a Topic Alias Maximum */
+static IoT_Error_t connectMqtt5(uint16_t receiveMax, uint16_t topicAliasMax) {
+	unsigned char connack[] = {0x20, 0x09, 0x00, 0x00, 0x06, 0x21, 0x00, 0x00, 0x22, 0x00, 0x00};
+
+	connack[6] = (unsigned char) (receiveMax >> 8);
+	connack[7] = (unsigned char) (receiveMax & 0xFF);
+	connack[9] = (unsigned char) (topicAliasMax >> 8);
+	connack[10] = (unsigned char) (topicAliasMax & 0xFF);
+	setTLSRxBufferForPacket(connack, sizeof(connack));
+
+	return aws_iot_mqtt_connect(&iotClient, &connectParams);
+}
+
+/* Packet ids of the QoS1 publishes the broker stand-in received, in order */
+static uint16_t brokerPublishIds[8];
+static uint32_t brokerPublishCount;
+static bool isBrokerDupSeen;
+
+/*
+ * Network write of a broker stand-in. Hands the packet to the mock TLS layer and
+ * acknowledges each QoS1 publish it receives, only those, with a PUBACK queued
+ * behind whatever is still unread.
+ */
+static IoT_Error_t brokerWrite(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer, size_t *pWrittenLen) {
+	unsigned char puback[] = {0x40, 0x03, 0x00, 0x00, 0x00};
+	uint16_t topicLen;
+	IoT_Error_t rc;
+
+	rc = iot_tls_write(pNetwork, pMsg, len, pTimer, pWrittenLen);
+	if(SUCCESS != rc || 0x32 != (pMsg[0] & 0xF7)) {
+		return rc;
+	}
+
+	/* Short test packets, the remaining length takes one byte */
+	topicLen = (uint16_t) ((pMsg[2] << 8) | pMsg[3]);
+	puback[2] = pMsg[4 + topicLen];
+	puback[3] = pMsg[5 + topicLen];
+	if(brokerPublishCount < sizeof(brokerPublishIds) / sizeof(brokerPublishIds[0])) {
+		brokerPublishIds[brokerPublishCount] = (uint16_t) ((puback[2] << 8) | puback[3]);
+	}
+	brokerPublishCount++;
+	isBrokerDupSeen = isBrokerDupSeen || (0 != (pMsg[0] & 0x08));
+
+	if(RxIndex >= RxBuffer.len) {
+		RxBuffer.len = 0;
+		RxIndex = 0;
+	}
+	memcpy(&(RxBuffer.pBuffer[RxBuffer.len]), puback, sizeof(puback));
+	RxBuffer.len += sizeof(puback);
+	RxBuffer.NoMsgFlag = false;
+
+	return rc;
+}
+
+/* Stores a QoS1 publish of "hi" to subTopic as the client would have sent it */
+static IoT_Error_t storePublish(IoT_MQTT_Session_Store *pStore, uint16_t packetId) {
+	unsigned char packet[32];
+	size_t len = 0;
+
+	packet[len++] = 0x32;
+	packet[len++] = (unsigned char) (2 + subTopicLen + 2 + 1 + 2);
+	packet[len++] = 0x00;
+	packet[len++] = (unsigned char) subTopicLen;
+	memcpy(&packet[len], subTopic, subTopicLen);
+	len += subTopicLen;
+	packet[len++] = (unsigned char) (packetId >> 8);
+	packet[len++] = (unsigned char) (packetId & 0xFF);
+	packet[len++] = 0x00;
+	packet[len++] = 'h';
+	packet[len++] = 'i';
+
+	return pStore->save(pStore->pContext, packetId, packet, len);
+}
+
+static IoT_Error_t publishHi(QoS qos) {
+	IoT_Publish_Message_Params params;
+
+	params.qos = qos;
+	params.isRetained = 0;
+	params.payload = (void *) "hi";
+	params.payloadLen = 2;
+
+	return aws_iot_mqtt_publish(&iotClient, subTopic, subTopicLen, &params);
+}
+
+#endif
+
+TEST_GROUP_C_SETUP(Mqtt5Tests) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = MQTT5_TEST_COMMAND_TIMEOUT_MS;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	connectParams.MQTTVersion = MQTT_5;
+
+	handledCount = 0;
+	memset(handledPayload, 0, sizeof(handledPayload));
+#endif
+}
+
+TEST_GROUP_C_TEARDOWN(Mqtt5Tests) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+#endif
+}
+
+/* K:1 - CONNECT carries protocol level 5 and the client's properties */
+TEST_C(Mqtt5Tests, ConnectPacketProperties) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:1 - CONNECT carries protocol level 5 and the client's properties \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(0x10, TxBuffer.pBuffer[0]);
+	CHECK_EQUAL_C_INT(5, TxBuffer.pBuffer[8]);
+	/* Property length, no Session Expiry Interval on a clean session */
+	CHECK_EQUAL_C_INT(8, TxBuffer.pBuffer[12]);
+	CHECK_EQUAL_C_INT(0x21, TxBuffer.pBuffer[13]);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT5_RECEIVE_MAXIMUM, (TxBuffer.pBuffer[14] << 8) | TxBuffer.pBuffer[15]);
+	CHECK_EQUAL_C_INT(0x27, TxBuffer.pBuffer[16]);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_RX_BUF_LEN - 1,
+					  (TxBuffer.pBuffer[17] << 24) | (TxBuffer.pBuffer[18] << 16) | (TxBuffer.pBuffer[19] << 8)
+					  | TxBuffer.pBuffer[20]);
+	/* Client identifier follows the properties */
+	CHECK_EQUAL_C_INT(strlen(AWS_IOT_MQTT_CLIENT_ID), (TxBuffer.pBuffer[21] << 8) | TxBuffer.pBuffer[22]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[23], AWS_IOT_MQTT_CLIENT_ID, strlen(AWS_IOT_MQTT_CLIENT_ID)));
+	CHECK_EQUAL_C_INT(2 + TxBuffer.pBuffer[1], TxBuffer.len);
+
+	IOT_DEBUG("-->Success - K:1 - CONNECT carries protocol level 5 and the client's properties \n");
+#endif
+}
+
+/* K:2 - Persistent session announces a Session Expiry Interval */
+TEST_C(Mqtt5Tests, ConnectPersistentSessionExpiry) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:2 - Persistent session announces a Session Expiry Interval \n");
+
+	connectParams.isCleanSession = false;
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(0, TxBuffer.pBuffer[9] & 0x02);
+	CHECK_EQUAL_C_INT(13, TxBuffer.pBuffer[12]);
+	CHECK_EQUAL_C_INT(0x11, TxBuffer.pBuffer[21]);
+	CHECK_EQUAL_C_INT(0xFF, TxBuffer.pBuffer[22]);
+	CHECK_EQUAL_C_INT(0xFF, TxBuffer.pBuffer[25]);
+
+	IOT_DEBUG("-->Success - K:2 - Persistent session announces a Session Expiry Interval \n");
+#endif
+}
+
+/* K:3 - CONNACK properties applied to the client */
+TEST_C(Mqtt5Tests, ConnackPropertiesApplied) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Receive Maximum 3, Topic Alias Maximum 100, Server Keep Alive 30, a Reason String */
+	unsigned char connack[] = {0x20, 0x10, 0x01, 0x00, 0x0D, 0x21, 0x00, 0x03, 0x22, 0x00, 0x64, 0x13, 0x00, 0x1E,
+							   0x1F, 0x00, 0x01, 'k'};
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:3 - CONNACK properties applied to the client \n");
+
+	connectParams.isCleanSession = false;
+	setTLSRxBufferForPacket(connack, sizeof(connack));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(true, aws_iot_mqtt_is_session_present(&iotClient));
+	CHECK_EQUAL_C_INT(3, iotClient.clientData.serverReceiveMax);
+	/* Capped at the aliases the client has room for */
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT5_TOPIC_ALIASES, iotClient.clientData.topicAliasMax);
+	CHECK_EQUAL_C_INT(30, iotClient.clientData.keepAliveInterval);
+	CHECK_EQUAL_C_INT(0, aws_iot_mqtt_get_last_reason_code(&iotClient));
+
+	IOT_DEBUG("-->Success - K:3 - CONNACK properties applied to the client \n");
+#endif
+}
+
+/* K:4 - CONNACK failure reason code */
+TEST_C(Mqtt5Tests, ConnackNotAuthorized) {
+#ifdef ENABLE_IOT_MQTT5
+	unsigned char connack[] = {0x20, 0x03, 0x00, 0x87, 0x00};
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:4 - CONNACK failure reason code \n");
+
+	setTLSRxBufferForPacket(connack, sizeof(connack));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(MQTT_CONNACK_NOT_AUTHORIZED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0x87, aws_iot_mqtt_get_last_reason_code(&iotClient));
+	CHECK_EQUAL_C_INT(false, aws_iot_mqtt_is_client_connected(&iotClient));
+
+	IOT_DEBUG("-->Success - K:4 - CONNACK failure reason code \n");
+#endif
+}
+
+/* K:5 - Second publish to a topic only sends its alias */
+TEST_C(Mqtt5Tests, PublishUsesTopicAlias) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:5 - Second publish to a topic only sends its alias \n");
+
+	rc = connectMqtt5(10, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* First publish binds the topic to alias 1 */
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(18, TxBuffer.len);
+	CHECK_EQUAL_C_INT(16, TxBuffer.pBuffer[1]);
+	CHECK_EQUAL_C_INT(subTopicLen, (TxBuffer.pBuffer[2] << 8) | TxBuffer.pBuffer[3]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[4], subTopic, subTopicLen));
+	CHECK_EQUAL_C_INT(3, TxBuffer.pBuffer[12]);
+	CHECK_EQUAL_C_INT(0x23, TxBuffer.pBuffer[13]);
+	CHECK_EQUAL_C_INT(1, (TxBuffer.pBuffer[14] << 8) | TxBuffer.pBuffer[15]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[16], "hi", 2));
+
+	/* Second publish leaves the topic out */
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(10, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0, (TxBuffer.pBuffer[2] << 8) | TxBuffer.pBuffer[3]);
+	CHECK_EQUAL_C_INT(3, TxBuffer.pBuffer[4]);
+	CHECK_EQUAL_C_INT(0x23, TxBuffer.pBuffer[5]);
+	CHECK_EQUAL_C_INT(1, (TxBuffer.pBuffer[6] << 8) | TxBuffer.pBuffer[7]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[8], "hi", 2));
+
+	/* Aliases belong to the connection */
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = connectMqtt5(10, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(18, TxBuffer.len);
+
+	IOT_DEBUG("-->Success - K:5 - Second publish to a topic only sends its alias \n");
+#endif
+}
+
+/* K:6 - No alias when the server doesn't allow any */
+TEST_C(Mqtt5Tests, PublishWithoutTopicAliases) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:6 - No alias when the server doesn't allow any \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(15, TxBuffer.len);
+	CHECK_EQUAL_C_INT(subTopicLen, (TxBuffer.pBuffer[2] << 8) | TxBuffer.pBuffer[3]);
+	CHECK_EQUAL_C_INT(0, TxBuffer.pBuffer[12]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[13], "hi", 2));
+
+	IOT_DEBUG("-->Success - K:6 - No alias when the server doesn't allow any \n");
+#endif
+}
+
+/* K:7 - QoS1 publish beyond the Receive Maximum waits for a PUBACK */
+TEST_C(Mqtt5Tests, ReceiveMaximumLimitsPublishes) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:7 - QoS1 publish beyond the Receive Maximum waits for a PUBACK \n");
+
+	rc = connectMqtt5(1, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The PUBACK doesn't come in time, the message stays unacknowledged */
+	ResetTLSBuffer();
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+
+	/* Nothing is sent while the server has all the messages it takes */
+	TxBuffer.len = 0;
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(MQTT_RECEIVE_MAXIMUM_REACHED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, TxBuffer.len);
+
+	/* QoS0 messages aren't counted */
+	rc = publishHi(QOS0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Puback(iotClient.clientData.nextPacketId, 0x00);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Puback((uint16_t) (iotClient.clientData.nextPacketId + 1), 0x00);
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - K:7 - QoS1 publish beyond the Receive Maximum waits for a PUBACK \n");
+#endif
+}
+
+/* K:8 - PUBACK failure reason code */
+TEST_C(Mqtt5Tests, PubackReasonCodeRejects) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:8 - PUBACK failure reason code \n");
+
+	rc = connectMqtt5(1, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Puback((uint16_t) (iotClient.clientData.nextPacketId + 1), 0x87);
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_REJECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0x87, aws_iot_mqtt_get_last_reason_code(&iotClient));
+
+	/* A refused message is acknowledged all the same */
+	setTLSRxBufferForMqtt5Puback((uint16_t) (iotClient.clientData.nextPacketId + 1), 0x10);
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0x10, aws_iot_mqtt_get_last_reason_code(&iotClient));
+
+	IOT_DEBUG("-->Success - K:8 - PUBACK failure reason code \n");
+#endif
+}
+
+/* K:9 - Incoming publish with properties */
+TEST_C(Mqtt5Tests, IncomingPublishWithProperties) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Payload Format Indicator and a User Property ahead of the payload */
+	unsigned char publish[] = {0x30, 0x1B, 0x00, 0x08, 's', 'd', 'k', '/', 'T', 'e', 's', 't', 0x09, 0x01, 0x01,
+							   0x26, 0x00, 0x01, 'a', 0x00, 0x01, 'b', 'h', 'e', 'l', 'l', 'o'};
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:9 - Incoming publish with properties \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Suback(0x00);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_mqtt5_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	/* Empty property block ahead of the topic filter */
+	CHECK_EQUAL_C_INT(0, TxBuffer.pBuffer[4]);
+
+	setTLSRxBufferForPacket(publish, sizeof(publish));
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, handledCount);
+	CHECK_EQUAL_C_STRING("hello", handledPayload);
+
+	IOT_DEBUG("-->Success - K:9 - Incoming publish with properties \n");
+#endif
+}
+
+/* K:10 - SUBACK failure reason code */
+TEST_C(Mqtt5Tests, SubackReasonCodeRejects) {
+#ifdef ENABLE_IOT_MQTT5
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:10 - SUBACK failure reason code \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Suback(0x87);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_mqtt5_handler, NULL);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_REJECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0x87, aws_iot_mqtt_get_last_reason_code(&iotClient));
+
+	/* The refused subscription isn't registered */
+	rc = aws_iot_mqtt_unsubscribe(&iotClient, subTopic, subTopicLen);
+	CHECK_EQUAL_C_INT(FAILURE, rc);
+
+	IOT_DEBUG("-->Success - K:10 - SUBACK failure reason code \n");
+#endif
+}
+
+/* K:11 - UNSUBACK failure reason code */
+TEST_C(Mqtt5Tests, UnsubackReasonCodeRejects) {
+#ifdef ENABLE_IOT_MQTT5
+	unsigned char unsuback[] = {0xB0, 0x04, 0x00, 0x01, 0x00, 0x87};
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:11 - UNSUBACK failure reason code \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForMqtt5Suback(0x00);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_mqtt5_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForPacket(unsuback, sizeof(unsuback));
+	rc = aws_iot_mqtt_unsubscribe(&iotClient, subTopic, subTopicLen);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_REJECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0x87, aws_iot_mqtt_get_last_reason_code(&iotClient));
+
+	IOT_DEBUG("-->Success - K:11 - UNSUBACK failure reason code \n");
+#endif
+}
+
+/* K:12 - DISCONNECT from the server during yield */
+TEST_C(Mqtt5Tests, ServerDisconnect) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Session taken over */
+	unsigned char disconnect[] = {0xE0, 0x02, 0x8E, 0x00};
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:12 - DISCONNECT from the server during yield \n");
+
+	rc = connectMqtt5(10, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForPacket(disconnect, sizeof(disconnect));
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0x8E, aws_iot_mqtt_get_last_reason_code(&iotClient));
+	CHECK_EQUAL_C_INT(false, aws_iot_mqtt_is_client_connected(&iotClient));
+
+	IOT_DEBUG("-->Success - K:12 - DISCONNECT from the server during yield \n");
+#endif
+}
+
+/* K:13 - QoS1 publishes use aliases, the session store keeps and resends the topic */
+TEST_C(Mqtt5Tests, TopicAliasWithSessionStore) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Session present, Receive Maximum 10, Topic Alias Maximum 4 */
+	unsigned char connack[] = {0x20, 0x09, 0x01, 0x00, 0x06, 0x21, 0x00, 0x0A, 0x22, 0x00, 0x04};
+	IoT_MQTT_Session_Store sessionStore;
+	IoT_MQTT_Session_Store_Ram sessionStoreRam;
+	unsigned char buf[32];
+	uint16_t packetId = 0;
+	size_t len = 0;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:13 - QoS1 publishes use aliases, the session store keeps and resends the topic \n");
+
+	rc = aws_iot_mqtt_session_store_ram_init(&sessionStore, &sessionStoreRam);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_set_session_store(&iotClient, &sessionStore);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = connectMqtt5(10, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* First publish binds the topic to alias 1 */
+	setTLSRxBufferForMqtt5Puback((uint16_t) (iotClient.clientData.nextPacketId + 1), 0);
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(20, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0x23, TxBuffer.pBuffer[15]);
+
+	/* Second one goes out with the alias only, but is stored with the topic */
+	ResetTLSBuffer();
+	rc = publishHi(QOS1);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+	CHECK_EQUAL_C_INT(12, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0, (TxBuffer.pBuffer[2] << 8) | TxBuffer.pBuffer[3]);
+	CHECK_EQUAL_C_INT(1, (TxBuffer.pBuffer[8] << 8) | TxBuffer.pBuffer[9]);
+
+	rc = sessionStore.load(sessionStore.pContext, 0, &packetId, buf, sizeof(buf), &len);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(17, len);
+	CHECK_EQUAL_C_INT(subTopicLen, (buf[2] << 8) | buf[3]);
+	CHECK_EQUAL_C_INT(0, memcmp(&buf[4], subTopic, subTopicLen));
+	CHECK_EQUAL_C_INT(0, buf[14]);
+
+	/* The new connection doesn't know alias 1, the resent message names the topic */
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ResetTLSBuffer();
+	setTLSRxBufferForPacket(connack, sizeof(connack));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0x3A, TxBuffer.pBuffer[0]);
+	CHECK_EQUAL_C_INT(17, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[4], subTopic, subTopicLen));
+
+	rc = aws_iot_mqtt_set_session_store(&iotClient, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	aws_iot_mqtt_session_store_ram_destroy(&sessionStoreRam);
+
+	IOT_DEBUG("-->Success - K:13 - QoS1 publishes use aliases, the session store keeps and resends the topic \n");
+#endif
+}
+
+/* K:14 - Every stored message is resent when the Receive Maximum lets one through at a time */
+TEST_C(Mqtt5Tests, ResendSessionWithinReceiveMaximum) {
+#ifdef ENABLE_IOT_MQTT5
+	/* Session present, Receive Maximum 1 */
+	unsigned char connack[] = {0x20, 0x09, 0x01, 0x00, 0x06, 0x21, 0x00, 0x01, 0x22, 0x00, 0x00};
+	IoT_MQTT_Session_Store sessionStore;
+	IoT_MQTT_Session_Store_Ram sessionStoreRam;
+	unsigned char buf[32];
+	uint16_t packetId = 0;
+	size_t len = 0;
+	uint16_t i;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running MQTT 5 Tests - K:14 - Every stored message is resent when the Receive Maximum lets one through at a time \n");
+
+	rc = aws_iot_mqtt_session_store_ram_init(&sessionStore, &sessionStoreRam);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	for(i = 1; i <= 3; i++) {
+		rc = storePublish(&sessionStore, i);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+	rc = aws_iot_mqtt_set_session_store(&iotClient, &sessionStore);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Each PUBACK removes a message the resend has passed, the ones behind it move up */
+	brokerPublishCount = 0;
+	isBrokerDupSeen = false;
+	iotClient.networkStack.write = brokerWrite;
+	setTLSRxBufferForPacket(connack, sizeof(connack));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(3, brokerPublishCount);
+	CHECK_EQUAL_C_INT(1, brokerPublishIds[0]);
+	CHECK_EQUAL_C_INT(2, brokerPublishIds[1]);
+	CHECK_EQUAL_C_INT(3, brokerPublishIds[2]);
+	CHECK_C(isBrokerDupSeen);
+
+	/* Acknowledged one by one, nothing is left */
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = sessionStore.load(sessionStore.pContext, 0, &packetId, buf, sizeof(buf), &len);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, len);
+
+	rc = aws_iot_mqtt_set_session_store(&iotClient, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	aws_iot_mqtt_session_store_ram_destroy(&sessionStoreRam);
+
+	IOT_DEBUG("-->Success - K:14 - Every stored message is resent when the Receive Maximum lets one through at a time \n");
+#endif
+}
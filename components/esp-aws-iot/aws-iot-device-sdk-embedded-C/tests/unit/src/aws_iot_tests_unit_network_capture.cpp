@@ -0,0 +1,44 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_network_capture.cpp
+ * @brief IoT Client Unit Testing - Network Capture and Replay Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(NetworkCaptureTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(NetworkCaptureTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(NetworkCaptureTests)
+};
+
+/* M:1 - Capture records connect, write and read */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, CaptureConnect)
+/* M:2 - Stopping a capture restores the network */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, StopRestoresNetwork)
+/* M:3 - A failing sink stops the recording */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, SinkFailure)
+/* M:4 - Captured session replayed into a new client */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, ReplaySession)
+/* M:5 - Replay returns recorded connect results and read errors */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, ReplayRecordedErrors)
+/* M:6 - Real time replay holds reads back until their recorded time */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, ReplayRealTime)
+/* M:7 - Replay rejects data that is not a capture */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, ReplayInvalidCapture)
+/* M:8 - A failed write that sent nothing records nothing */
+TEST_GROUP_C_WRAPPER(NetworkCaptureTests, FailedWriteNotRecorded)
@@ -0,0 +1,443 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_network_capture_helper.c
+ * @brief IoT Client Unit Testing - Network Capture and Replay Tests Helper
+ *
+ * Captures go into a RAM sink. Replays run on a client whose mock TLS buffers
+ * stay empty, so every byte it reads comes from the capture.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_network_capture.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#define CAPTURE_TEST_BUF_LEN 1024
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client iotClient;
+static AWS_IoT_Client replayClient;
+static IoT_Network_Capture capture;
+static IoT_Network_Replay replay;
+
+static unsigned char captureBuf[CAPTURE_TEST_BUF_LEN];
+static size_t captureLen;
+static bool failSink;
+
+static char subTopic[10] = "sdk/Test";
+static uint16_t subTopicLen = 8;
+static char expectedPayload[] = "captured";
+
+static uint32_t handledCount;
+static char handledPayload[32];
+
+static IoT_Error_t iot_tests_unit_capture_sink(void *pSinkData, const unsigned char *pBuf, size_t len) {
+	IOT_UNUSED(pSinkData);
+
+	if(failSink || captureLen + len > sizeof(captureBuf)) {
+		return NETWORK_CAPTURE_WRITE_ERROR;
+	}
+	memcpy(&captureBuf[captureLen], pBuf, len);
+	captureLen += len;
+	return SUCCESS;
+}
+
+static void iot_tests_unit_capture_handler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+										   IoT_Publish_Message_Params *pParams, void *pData) {
+	size_t len = pParams->payloadLen < sizeof(handledPayload) - 1 ? pParams->payloadLen : sizeof(handledPayload) - 1;
+
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pTopicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	memcpy(handledPayload, pParams->payload, len);
+	handledPayload[len] = '\0';
+	handledCount++;
+}
+
+/* Append a record to the capture buffer the way the capture writes it */
+static void appendRecord(IoT_Capture_Record_Type type, uint32_t timeMs, const unsigned char *pData, uint16_t len) {
+	unsigned char *pRecord = &captureBuf[captureLen];
+
+	pRecord[0] = (unsigned char) type;
+	pRecord[1] = (unsigned char) (timeMs & 0xFF);
+	pRecord[2] = (unsigned char) ((timeMs >> 8) & 0xFF);
+	pRecord[3] = (unsigned char) ((timeMs >> 16) & 0xFF);
+	pRecord[4] = (unsigned char) (timeMs >> 24);
+	pRecord[5] = (unsigned char) (len & 0xFF);
+	pRecord[6] = (unsigned char) (len >> 8);
+	if(0 < len) {
+		memcpy(&pRecord[AWS_IOT_CAPTURE_RECORD_HEADER_LEN], pData, len);
+	}
+	captureLen += AWS_IOT_CAPTURE_RECORD_HEADER_LEN + len;
+}
+
+static void appendRcRecord(IoT_Capture_Record_Type type, uint32_t timeMs, IoT_Error_t rc) {
+	uint32_t value = (uint32_t) (int32_t) rc;
+	unsigned char data[4];
+
+	data[0] = (unsigned char) (value & 0xFF);
+	data[1] = (unsigned char) ((value >> 8) & 0xFF);
+	data[2] = (unsigned char) ((value >> 16) & 0xFF);
+	data[3] = (unsigned char) (value >> 24);
+	appendRecord(type, timeMs, data, sizeof(data));
+}
+
+static void appendCaptureHeader(void) {
+	static const unsigned char header[AWS_IOT_CAPTURE_HEADER_LEN] = { 'I', 'O', 'T', 'C', 1, 0, 0, 0 };
+
+	memcpy(captureBuf, header, sizeof(header));
+	captureLen = sizeof(header);
+}
+
+/* Sum of the data of all records of a type */
+static size_t recordedBytes(IoT_Capture_Record_Type type, unsigned char *pCopy, size_t copyLen) {
+	size_t position = AWS_IOT_CAPTURE_HEADER_LEN;
+	size_t total = 0;
+	uint16_t len;
+
+	while(position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN <= captureLen) {
+		len = (uint16_t) (captureBuf[position + 5] | (captureBuf[position + 6] << 8));
+		if(type == captureBuf[position]) {
+			if(NULL != pCopy && total + len <= copyLen) {
+				memcpy(&pCopy[total], &captureBuf[position + AWS_IOT_CAPTURE_RECORD_HEADER_LEN], len);
+			}
+			total += len;
+		}
+		position += AWS_IOT_CAPTURE_RECORD_HEADER_LEN + len;
+	}
+
+	return total;
+}
+
+TEST_GROUP_C_SETUP(NetworkCaptureTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_init(&replayClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+
+	testPubMsgParams.qos = QOS0;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = (void *) expectedPayload;
+	testPubMsgParams.payloadLen = strlen(expectedPayload);
+
+	memset(captureBuf, 0, sizeof(captureBuf));
+	captureLen = 0;
+	failSink = false;
+	handledCount = 0;
+	handledPayload[0] = '\0';
+}
+
+TEST_GROUP_C_TEARDOWN(NetworkCaptureTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+	rc = aws_iot_mqtt_disconnect(&replayClient);
+	IOT_UNUSED(rc);
+	if(NULL != capture.pNetwork) {
+		(void)aws_iot_network_capture_stop(&capture);
+	}
+}
+
+/* M:1 - Capture records connect, write and read */
+TEST_C(NetworkCaptureTests, CaptureConnect) {
+	IoT_Error_t rc;
+	unsigned char readBytes[8];
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:1 - Capture records connect, write and read \n");
+
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(AWS_IOT_CAPTURE_HEADER_LEN, captureLen);
+	CHECK_C(0 == memcmp(captureBuf, "IOTC", 4));
+
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Connect result first, then the CONNECT packet as written and the CONNACK as read */
+	CHECK_EQUAL_C_INT(IOT_CAPTURE_CONNECT, captureBuf[AWS_IOT_CAPTURE_HEADER_LEN]);
+	CHECK_EQUAL_C_INT(4, recordedBytes(IOT_CAPTURE_CONNECT, NULL, 0));
+	CHECK_EQUAL_C_INT(TxBuffer.len, recordedBytes(IOT_CAPTURE_WRITE, NULL, 0));
+	CHECK_EQUAL_C_INT(4, recordedBytes(IOT_CAPTURE_READ, readBytes, sizeof(readBytes)));
+	CHECK_EQUAL_C_INT(0x20, readBytes[0]);
+	CHECK_EQUAL_C_INT(0x02, readBytes[1]);
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, recordedBytes(IOT_CAPTURE_DISCONNECT, NULL, 0));
+	CHECK_EQUAL_C_INT(IOT_CAPTURE_DISCONNECT, captureBuf[captureLen - AWS_IOT_CAPTURE_RECORD_HEADER_LEN]);
+
+	IOT_DEBUG("-->Success - M:1 - Capture records connect, write and read \n");
+}
+
+/* M:2 - Stopping a capture restores the network */
+TEST_C(NetworkCaptureTests, StopRestoresNetwork) {
+	IoT_Error_t rc;
+	size_t stoppedLen;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:2 - Stopping a capture restores the network \n");
+
+	rc = aws_iot_network_capture_start(NULL, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), NULL, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&capture == iotClient.networkStack.pCapture);
+	CHECK_C(iot_tls_read != iotClient.networkStack.read);
+
+	rc = aws_iot_network_capture_stop(&capture);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(NULL == iotClient.networkStack.pCapture);
+	CHECK_C(iot_tls_connect == iotClient.networkStack.connect);
+	CHECK_C(iot_tls_read == iotClient.networkStack.read);
+	CHECK_C(iot_tls_write == iotClient.networkStack.write);
+	CHECK_C(iot_tls_disconnect == iotClient.networkStack.disconnect);
+
+	/* Nothing is recorded once stopped */
+	stoppedLen = captureLen;
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(stoppedLen, captureLen);
+
+	IOT_DEBUG("-->Success - M:2 - Stopping a capture restores the network \n");
+}
+
+/* M:3 - A failing sink stops the recording */
+TEST_C(NetworkCaptureTests, SinkFailure) {
+	IoT_Error_t rc;
+	size_t failedLen;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:3 - A failing sink stops the recording \n");
+
+	failSink = true;
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(NETWORK_CAPTURE_WRITE_ERROR, rc);
+	CHECK_C(iot_tls_read == iotClient.networkStack.read);
+
+	failSink = false;
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	failSink = true;
+	failedLen = captureLen;
+
+	/* The client is not affected by the sink */
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(failedLen, captureLen);
+	CHECK_EQUAL_C_INT(0, capture.recordCount);
+
+	failSink = false;
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(failedLen, captureLen);
+
+	rc = aws_iot_network_capture_stop(&capture);
+	CHECK_EQUAL_C_INT(NETWORK_CAPTURE_WRITE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - M:3 - A failing sink stops the recording \n");
+}
+
+/* M:4 - Captured session replayed into a new client */
+TEST_C(NetworkCaptureTests, ReplaySession) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:4 - Captured session replayed into a new client \n");
+
+	/* Record connect, subscribe and one message through the mock */
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0, iot_tests_unit_capture_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, testPubMsgParams, expectedPayload);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, handledCount);
+	rc = aws_iot_network_capture_stop(&capture);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Same calls on a client fed by the capture only */
+	ResetTLSBuffer();
+	handledCount = 0;
+	handledPayload[0] = '\0';
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, captureBuf, captureLen, false);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(!aws_iot_network_replay_is_done(&replay));
+
+	rc = aws_iot_mqtt_connect(&replayClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_subscribe(&replayClient, subTopic, subTopicLen, QOS0, iot_tests_unit_capture_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_yield(&replayClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, handledCount);
+	CHECK_C(0 == strncmp(expectedPayload, handledPayload, strlen(expectedPayload)));
+	CHECK_C(aws_iot_network_replay_is_done(&replay));
+
+	/* Writes went nowhere, the mock saw none of them */
+	CHECK_EQUAL_C_INT(recordedBytes(IOT_CAPTURE_WRITE, NULL, 0), replay.bytesWritten);
+	CHECK_EQUAL_C_INT(recordedBytes(IOT_CAPTURE_READ, NULL, 0), replay.bytesRead);
+	CHECK_EQUAL_C_INT(0, TxBuffer.len);
+
+	IOT_DEBUG("-->Success - M:4 - Captured session replayed into a new client \n");
+}
+
+/* M:5 - Replay returns recorded connect results and read errors */
+TEST_C(NetworkCaptureTests, ReplayRecordedErrors) {
+	static const unsigned char connack[4] = { 0x20, 0x02, 0x00, 0x00 };
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:5 - Replay returns recorded connect results and read errors \n");
+
+	appendCaptureHeader();
+	appendRcRecord(IOT_CAPTURE_CONNECT, 0, NETWORK_ERR_NET_CONNECT_FAILED);
+	appendRcRecord(IOT_CAPTURE_CONNECT, 10, SUCCESS);
+	appendRecord(IOT_CAPTURE_READ, 10, connack, sizeof(connack));
+	appendRcRecord(IOT_CAPTURE_READ_ERROR, 20, NETWORK_SSL_READ_ERROR);
+
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, captureBuf, captureLen, false);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_connect(&replayClient, &connectParams);
+	CHECK_EQUAL_C_INT(NETWORK_ERR_NET_CONNECT_FAILED, rc);
+	rc = aws_iot_mqtt_connect(&replayClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(!aws_iot_network_replay_is_done(&replay));
+
+	rc = aws_iot_mqtt_yield(&replayClient, 100);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_C(aws_iot_network_replay_is_done(&replay));
+
+	/* No recorded connect is left */
+	rc = aws_iot_mqtt_connect(&replayClient, &connectParams);
+	CHECK_EQUAL_C_INT(NETWORK_ERR_NET_CONNECT_FAILED, rc);
+
+	IOT_DEBUG("-->Success - M:5 - Replay returns recorded connect results and read errors \n");
+}
+
+/* M:6 - Real time replay holds reads back until their recorded time */
+TEST_C(NetworkCaptureTests, ReplayRealTime) {
+	static const unsigned char connack[4] = { 0x20, 0x02, 0x00, 0x00 };
+	static const unsigned char publish[14] = { 0x30, 0x0C, 0x00, 0x08, 's', 'd', 'k', '/', 'T', 'e', 's', 't', 'h', 'i' };
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:6 - Real time replay holds reads back until their recorded time \n");
+
+	appendCaptureHeader();
+	appendRcRecord(IOT_CAPTURE_CONNECT, 1000, SUCCESS);
+	appendRecord(IOT_CAPTURE_READ, 1000, connack, sizeof(connack));
+	appendRecord(IOT_CAPTURE_READ, 1300, publish, sizeof(publish));
+
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, captureBuf, captureLen, true);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_connect(&replayClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(sizeof(connack), replay.bytesRead);
+
+	/* Due 300 ms after the connect */
+	rc = aws_iot_mqtt_yield(&replayClient, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(sizeof(connack), replay.bytesRead);
+	CHECK_C(!aws_iot_network_replay_is_done(&replay));
+
+	rc = aws_iot_mqtt_yield(&replayClient, 500);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(sizeof(connack) + sizeof(publish), replay.bytesRead);
+	CHECK_C(aws_iot_network_replay_is_done(&replay));
+
+	IOT_DEBUG("-->Success - M:6 - Real time replay holds reads back until their recorded time \n");
+}
+
+/* M:7 - Replay rejects data that is not a capture */
+TEST_C(NetworkCaptureTests, ReplayInvalidCapture) {
+	static const unsigned char notCapture[8] = { 'I', 'O', 'T', 'T', 1, 0, 0, 0 };
+	static const unsigned char futureCapture[8] = { 'I', 'O', 'T', 'C', 2, 0, 0, 0 };
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:7 - Replay rejects data that is not a capture \n");
+
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), NULL, notCapture, sizeof(notCapture), false);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, notCapture, sizeof(notCapture), false);
+	CHECK_EQUAL_C_INT(NETWORK_CAPTURE_FORMAT_ERROR, rc);
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, futureCapture, sizeof(futureCapture), false);
+	CHECK_EQUAL_C_INT(NETWORK_CAPTURE_FORMAT_ERROR, rc);
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, futureCapture, 4, false);
+	CHECK_EQUAL_C_INT(NETWORK_CAPTURE_FORMAT_ERROR, rc);
+	CHECK_C(iot_tls_read == replayClient.networkStack.read);
+
+	/* A capture cut off inside a record replays up to the cut */
+	appendCaptureHeader();
+	appendRcRecord(IOT_CAPTURE_CONNECT, 0, SUCCESS);
+	captureLen -= 2;
+	rc = aws_iot_network_replay_init(&(replayClient.networkStack), &replay, captureBuf, captureLen, false);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(aws_iot_network_replay_is_done(&replay));
+
+	IOT_DEBUG("-->Success - M:7 - Replay rejects data that is not a capture \n");
+}
+
+/* M:8 - A failed write that sent nothing records nothing */
+TEST_C(NetworkCaptureTests, FailedWriteNotRecorded) {
+	IoT_Error_t rc;
+	unsigned char packet[2] = { 0xC0, 0x00 };
+	size_t writtenLen = sizeof(captureBuf);
+	size_t recordedLen;
+	Timer timer;
+
+	IOT_DEBUG("-->Running Network Capture Tests - M:8 - A failed write that sent nothing records nothing \n");
+
+	rc = aws_iot_network_capture_start(&capture, &(iotClient.networkStack), iot_tests_unit_capture_sink, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	recordedLen = recordedBytes(IOT_CAPTURE_WRITE, NULL, 0);
+
+	/* The mocked error returns without setting the written length */
+	TxBuffer.mockedError = NETWORK_SSL_WRITE_ERROR;
+	init_timer(&timer);
+	countdown_ms(&timer, 100);
+	rc = iotClient.networkStack.write(&(iotClient.networkStack), packet, sizeof(packet), &timer, &writtenLen);
+	CHECK_EQUAL_C_INT(NETWORK_SSL_WRITE_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, writtenLen);
+	CHECK_EQUAL_C_INT(recordedLen, recordedBytes(IOT_CAPTURE_WRITE, NULL, 0));
+
+	IOT_DEBUG("-->Success - M:8 - A failed write that sent nothing records nothing \n");
+}
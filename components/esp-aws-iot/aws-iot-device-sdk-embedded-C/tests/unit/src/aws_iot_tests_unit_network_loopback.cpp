@@ -0,0 +1,46 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_network_loopback.cpp
+ * @brief IoT Client Unit Testing - Loopback Transport Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(NetworkLoopbackTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(NetworkLoopbackTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(NetworkLoopbackTests)
+};
+
+/* N:1 - Bytes pass both ways and wrap around the rings */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, PassesBytesBothWays)
+/* N:2 - A full ring takes part of a write and times out */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, FullRingTimesOut)
+/* N:3 - Reads time out and buffered reads return what arrived */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, ReadTimeouts)
+/* N:4 - Latency holds writes back */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, LatencyHoldsBytesBack)
+/* N:5 - Rate limit spreads writes out */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, RateLimit)
+/* N:6 - Disconnect is seen by the other end after it read everything */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, DisconnectSeenByPeer)
+/* N:7 - MQTT client connects and publishes over the loopback */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, MqttClientOverLoopback)
+/* N:8 - Invalid parameters */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, InvalidParams)
+/* N:9 - Waits for data and for room sleep instead of spinning */
+TEST_GROUP_C_WRAPPER(NetworkLoopbackTests, WaitsSleep)
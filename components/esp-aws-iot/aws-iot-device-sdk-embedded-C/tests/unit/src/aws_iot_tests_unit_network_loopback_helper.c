@@ -0,0 +1,366 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_network_loopback_helper.c
+ * @brief IoT Client Unit Testing - Loopback Transport Tests Helper
+ *
+ * Both ends run on the test task. The rings are kept small so that writes
+ * wrap around them and fill them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_network_loopback.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#define LOOPBACK_TEST_RING_LEN 16
+#define LOOPBACK_TEST_MQTT_RING_LEN 256
+
+static IoT_Network_Loopback loopbackLink;
+static Network endA;
+static Network endB;
+static unsigned char ringAToB[LOOPBACK_TEST_MQTT_RING_LEN];
+static unsigned char ringBToA[LOOPBACK_TEST_MQTT_RING_LEN];
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static AWS_IoT_Client iotClient;
+
+static void setUpLink(size_t ringLen, uint32_t latencyMs, uint32_t bytesPerSec) {
+	IoT_Error_t rc;
+
+	rc = aws_iot_network_loopback_init(&loopbackLink, ringAToB, ringBToA, ringLen, latencyMs, bytesPerSec);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&endA, &loopbackLink, IOT_LOOPBACK_END_A);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&endB, &loopbackLink, IOT_LOOPBACK_END_B);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, endA.connect(&endA, NULL));
+	CHECK_EQUAL_C_INT(SUCCESS, endB.connect(&endB, NULL));
+}
+
+static IoT_Error_t writeBytes(Network *pEnd, const char *pBytes, size_t len, uint32_t timeoutMs, size_t *pWrittenLen) {
+	Timer timer;
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeoutMs);
+	return pEnd->write(pEnd, (unsigned char *) pBytes, len, &timer, pWrittenLen);
+}
+
+static IoT_Error_t readBytes(Network *pEnd, unsigned char *pBuf, size_t len, uint32_t timeoutMs, size_t *pReadLen) {
+	Timer timer;
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeoutMs);
+	return pEnd->read(pEnd, pBuf, len, &timer, pReadLen);
+}
+
+static uint32_t elapsedMs(Timer *pStopwatch) {
+	return elapsed_ms(pStopwatch);
+}
+
+static double threadCpuMs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return (double) now.tv_sec * 1000.0 + (double) now.tv_nsec / 1000000.0;
+}
+
+TEST_GROUP_C_SETUP(NetworkLoopbackTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	memset(&loopbackLink, 0, sizeof(loopbackLink));
+	memset(&endA, 0, sizeof(endA));
+	memset(&endB, 0, sizeof(endB));
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+}
+
+TEST_GROUP_C_TEARDOWN(NetworkLoopbackTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+	(void)aws_iot_network_loopback_free(&loopbackLink);
+}
+
+/* N:1 - Bytes pass both ways and wrap around the rings */
+TEST_C(NetworkLoopbackTests, PassesBytesBothWays) {
+	unsigned char buf[LOOPBACK_TEST_RING_LEN];
+	size_t len = 0;
+	int itr;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:1 - Bytes pass both ways and wrap around the rings \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 0, 0);
+	CHECK_EQUAL_C_INT(NETWORK_PHYSICAL_LAYER_CONNECTED, endA.isConnected(&endA));
+
+	/* Three rounds of 10 bytes in a 16 byte ring, the second and third wrap */
+	for(itr = 0; itr < 3; itr++) {
+		CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "0123456789", 10, 10, &len));
+		CHECK_EQUAL_C_INT(10, len);
+		CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 10, 10, &len));
+		CHECK_EQUAL_C_INT(10, len);
+		CHECK_C(0 == memcmp(buf, "0123456789", 10));
+
+		CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endB, "abcdefghij", 10, 10, &len));
+		CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endA, buf, 10, 10, &len));
+		CHECK_C(0 == memcmp(buf, "abcdefghij", 10));
+	}
+
+	CHECK_EQUAL_C_INT(30, loopbackLink.ends[IOT_LOOPBACK_END_A].bytesWritten);
+	CHECK_EQUAL_C_INT(30, loopbackLink.ends[IOT_LOOPBACK_END_A].bytesRead);
+
+	IOT_DEBUG("-->Success - N:1 - Bytes pass both ways and wrap around the rings \n");
+}
+
+/* N:2 - A full ring takes part of a write and times out */
+TEST_C(NetworkLoopbackTests, FullRingTimesOut) {
+	unsigned char buf[20];
+	size_t len = 0;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:2 - A full ring takes part of a write and times out \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 0, 0);
+
+	CHECK_EQUAL_C_INT(NETWORK_SSL_WRITE_TIMEOUT_ERROR, writeBytes(&endA, "ABCDEFGHIJKLMNOPQRST", 20, 10, &len));
+	CHECK_EQUAL_C_INT(LOOPBACK_TEST_RING_LEN, len);
+
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, LOOPBACK_TEST_RING_LEN, 10, &len));
+	CHECK_C(0 == memcmp(buf, "ABCDEFGHIJKLMNOP", LOOPBACK_TEST_RING_LEN));
+
+	/* Room again for the rest */
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "QRST", 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 4, 10, &len));
+	CHECK_C(0 == memcmp(buf, "QRST", 4));
+
+	IOT_DEBUG("-->Success - N:2 - A full ring takes part of a write and times out \n");
+}
+
+/* N:3 - Reads time out and buffered reads return what arrived */
+TEST_C(NetworkLoopbackTests, ReadTimeouts) {
+	unsigned char buf[8];
+	size_t len = 0;
+	Timer timer;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:3 - Reads time out and buffered reads return what arrived \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 0, 0);
+
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, readBytes(&endB, buf, 4, 10, &len));
+	init_timer(&timer);
+	countdown_ms(&timer, 10);
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, endB.waitForReadable(&endB, &timer));
+
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "xyz", 3, 10, &len));
+	init_timer(&timer);
+	countdown_ms(&timer, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, endB.waitForReadable(&endB, &timer));
+	CHECK_EQUAL_C_INT(SUCCESS, endB.readAvailable(&endB, buf, sizeof(buf), &timer, &len));
+	CHECK_EQUAL_C_INT(3, len);
+	CHECK_C(0 == memcmp(buf, "xyz", 3));
+
+	/* A read that only gets part of what it asked for times out */
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "xyz", 3, 10, &len));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_READ_TIMEOUT_ERROR, readBytes(&endB, buf, 5, 10, &len));
+
+	IOT_DEBUG("-->Success - N:3 - Reads time out and buffered reads return what arrived \n");
+}
+
+/* N:4 - Latency holds writes back */
+TEST_C(NetworkLoopbackTests, LatencyHoldsBytesBack) {
+	unsigned char buf[4];
+	size_t len = 0;
+	Timer stopwatch;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:4 - Latency holds writes back \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 50, 0);
+
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "late", 4, 10, &len));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, readBytes(&endB, buf, 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 4, 500, &len));
+	CHECK_C(0 == memcmp(buf, "late", 4));
+	CHECK_C(45 <= elapsedMs(&stopwatch));
+
+	IOT_DEBUG("-->Success - N:4 - Latency holds writes back \n");
+}
+
+/* N:5 - Rate limit spreads writes out */
+TEST_C(NetworkLoopbackTests, RateLimit) {
+	static const char payload[100] = "rate limited";
+	unsigned char buf[200];
+	size_t len = 0;
+	Timer stopwatch;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:5 - Rate limit spreads writes out \n");
+
+	/* 100 bytes take 20 ms at 5000 bytes/s */
+	setUpLink(LOOPBACK_TEST_MQTT_RING_LEN, 0, 5000);
+
+	init_timer(&stopwatch);
+	countdown_ms(&stopwatch, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, payload, sizeof(payload), 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, payload, sizeof(payload), 10, &len));
+
+	/* The first write arrives before the second */
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 100, 500, &len));
+	CHECK_C(15 <= elapsedMs(&stopwatch));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, readBytes(&endB, buf, 100, 5, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, &buf[100], 100, 500, &len));
+	CHECK_C(35 <= elapsedMs(&stopwatch));
+	CHECK_C(0 == memcmp(buf, &buf[100], 100));
+
+	IOT_DEBUG("-->Success - N:5 - Rate limit spreads writes out \n");
+}
+
+/* N:6 - Disconnect is seen by the other end after it read everything */
+TEST_C(NetworkLoopbackTests, DisconnectSeenByPeer) {
+	unsigned char buf[4];
+	size_t len = 0;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:6 - Disconnect is seen by the other end after it read everything \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 0, 0);
+
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "last", 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endB, "lost", 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, endA.disconnect(&endA));
+	CHECK_EQUAL_C_INT(NETWORK_PHYSICAL_LAYER_DISCONNECTED, endA.isConnected(&endA));
+	CHECK_EQUAL_C_INT(NETWORK_PHYSICAL_LAYER_DISCONNECTED, endB.isConnected(&endB));
+
+	/* What A wrote before is still read, then the read fails. Writes fail at once */
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 4, 10, &len));
+	CHECK_C(0 == memcmp(buf, "last", 4));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_READ_ERROR, readBytes(&endB, buf, 4, 10, &len));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_WRITE_ERROR, writeBytes(&endB, "gone", 4, 10, &len));
+	CHECK_EQUAL_C_INT(0, len);
+	CHECK_EQUAL_C_INT(NETWORK_SSL_READ_ERROR, readBytes(&endA, buf, 4, 10, &len));
+
+	/* A new connection, without what B wrote to the old one */
+	CHECK_EQUAL_C_INT(SUCCESS, endB.disconnect(&endB));
+	CHECK_EQUAL_C_INT(SUCCESS, endA.connect(&endA, NULL));
+	CHECK_EQUAL_C_INT(SUCCESS, endB.connect(&endB, NULL));
+	CHECK_EQUAL_C_INT(NETWORK_PHYSICAL_LAYER_CONNECTED, endA.isConnected(&endA));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, readBytes(&endA, buf, 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endB, "back", 4, 10, &len));
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endA, buf, 4, 10, &len));
+	CHECK_C(0 == memcmp(buf, "back", 4));
+
+	IOT_DEBUG("-->Success - N:6 - Disconnect is seen by the other end after it read everything \n");
+}
+
+/* N:7 - MQTT client connects and publishes over the loopback */
+TEST_C(NetworkLoopbackTests, MqttClientOverLoopback) {
+	static const char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+	IoT_Publish_Message_Params pubParams;
+	unsigned char buf[LOOPBACK_TEST_MQTT_RING_LEN];
+	size_t len = 0;
+	Timer timer;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:7 - MQTT client connects and publishes over the loopback \n");
+
+	rc = aws_iot_network_loopback_init(&loopbackLink, ringAToB, ringBToA, LOOPBACK_TEST_MQTT_RING_LEN, 0, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&(iotClient.networkStack), &loopbackLink, IOT_LOOPBACK_END_A);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_network_loopback_attach(&endB, &loopbackLink, IOT_LOOPBACK_END_B);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, endB.connect(&endB, NULL));
+
+	/* The broker answers ahead of time, the ring holds the CONNACK until the client reads it */
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endB, connack, sizeof(connack), 10, &len));
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	init_timer(&timer);
+	countdown_ms(&timer, 10);
+	CHECK_EQUAL_C_INT(SUCCESS, endB.readAvailable(&endB, buf, sizeof(buf), &timer, &len));
+	CHECK_EQUAL_C_INT(0x10, buf[0]);
+	CHECK_EQUAL_C_INT(2 + buf[1], len);
+	/* Nothing came from the mock TLS layer */
+	CHECK_EQUAL_C_INT(0, TxBuffer.len);
+
+	pubParams.qos = QOS0;
+	pubParams.isRetained = 0;
+	pubParams.payload = (void *) "loop";
+	pubParams.payloadLen = 4;
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &pubParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 2 + 2 + 8 + 4, 10, &len));
+	CHECK_EQUAL_C_INT(0x30, buf[0]);
+	CHECK_C(0 == memcmp(&buf[4], "sdk/Test", 8));
+	CHECK_C(0 == memcmp(&buf[12], "loop", 4));
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(SUCCESS, readBytes(&endB, buf, 2, 10, &len));
+	CHECK_EQUAL_C_INT(0xE0, buf[0]);
+	CHECK_EQUAL_C_INT(NETWORK_SSL_READ_ERROR, readBytes(&endB, buf, 1, 10, &len));
+
+	IOT_DEBUG("-->Success - N:7 - MQTT client connects and publishes over the loopback \n");
+}
+
+/* N:8 - Invalid parameters */
+TEST_C(NetworkLoopbackTests, InvalidParams) {
+	IOT_DEBUG("-->Running Network Loopback Tests - N:8 - Invalid parameters \n");
+
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_init(NULL, ringAToB, ringBToA, 16, 0, 0));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_init(&loopbackLink, NULL, ringBToA, 16, 0, 0));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_init(&loopbackLink, ringAToB, ringBToA, 0, 0, 0));
+	CHECK_EQUAL_C_INT(SUCCESS, aws_iot_network_loopback_init(&loopbackLink, ringAToB, ringBToA, 16, 0, 0));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_attach(NULL, &loopbackLink, IOT_LOOPBACK_END_A));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_attach(&endA, NULL, IOT_LOOPBACK_END_A));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_attach(&endA, &loopbackLink, (IoT_Loopback_End) 2));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, aws_iot_network_loopback_free(NULL));
+
+	IOT_DEBUG("-->Success - N:8 - Invalid parameters \n");
+}
+
+/* N:9 - Waits for data and for room sleep instead of spinning */
+TEST_C(NetworkLoopbackTests, WaitsSleep) {
+	unsigned char buf[8];
+	size_t len = 0;
+	Timer timer;
+	double cpuStartMs;
+
+	IOT_DEBUG("-->Running Network Loopback Tests - N:9 - Waits for data and for room sleep instead of spinning \n");
+
+	setUpLink(LOOPBACK_TEST_RING_LEN, 0, 0);
+
+	cpuStartMs = threadCpuMs();
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, readBytes(&endB, buf, 4, 100, &len));
+	init_timer(&timer);
+	countdown_ms(&timer, 100);
+	CHECK_EQUAL_C_INT(NETWORK_SSL_NOTHING_TO_READ, endB.waitForReadable(&endB, &timer));
+	CHECK_EQUAL_C_INT(SUCCESS, writeBytes(&endA, "0123456789abcdef", LOOPBACK_TEST_RING_LEN, 10, &len));
+	CHECK_EQUAL_C_INT(NETWORK_SSL_WRITE_TIMEOUT_ERROR, writeBytes(&endA, "x", 1, 100, &len));
+	/* 300 ms of waiting, a spinning wait burns all of it */
+	CHECK_C(threadCpuMs() - cpuStartMs < 50);
+
+	IOT_DEBUG("-->Success - N:9 - Waits for data and for room sleep instead of spinning \n");
+}
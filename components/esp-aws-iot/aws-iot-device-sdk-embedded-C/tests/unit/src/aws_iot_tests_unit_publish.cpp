@@ -46,3 +46,9 @@ TEST_GROUP_C_WRAPPER(PublishTests, publishQoS1Success10msDelayedPuback)
 TEST_GROUP_C_WRAPPER(PublishTests, publishQoS0NoPubackSuccess)
 /* E:10 - Publish with QoS1 send success, Puback received */
 TEST_GROUP_C_WRAPPER(PublishTests, publishQoS1Success)
+/* E:11 - Publish template with Null/empty parameters */
+TEST_GROUP_C_WRAPPER(PublishTests, publishTemplateNullParams)
+/* E:12 - QoS1 publish with template matches regular publish */
+TEST_GROUP_C_WRAPPER(PublishTests, publishTemplateQoS1MatchesPublish)
+/* E:13 - QoS0 retained publish with template */
+TEST_GROUP_C_WRAPPER(PublishTests, publishTemplateQoS0Retained)
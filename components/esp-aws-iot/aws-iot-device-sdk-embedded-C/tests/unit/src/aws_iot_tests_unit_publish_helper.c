@@ -24,6 +24,7 @@
 
 #include "aws_iot_mqtt_client_interface.h"
 #include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
 #include "aws_iot_log.h"
 
 static IoT_Client_Init_Params initParams;
@@ -203,3 +204,87 @@ TEST_C(PublishTests, publishQoS1Success) {
 
 	IOT_DEBUG("-->Success - E:10 - Publish with QoS1 send success, Puback received \n");
 }
+
+/* E:11 - Publish template with Null/empty parameters */
+TEST_C(PublishTests, publishTemplateNullParams) {
+	IoT_Publish_Template pubTemplate;
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Tests - E:11 - Publish template with Null/empty parameters \n");
+
+	rc = aws_iot_mqtt_publish_template_init(NULL, subTopic, subTopicLen, QOS1, 0);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_template_init(&pubTemplate, NULL, subTopicLen, QOS1, 0);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_template_init(&pubTemplate, subTopic, 0, QOS1, 0);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_publish_template_init(&pubTemplate, subTopic, subTopicLen, QOS1, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_with_template(NULL, &pubTemplate, cPayload, strlen(cPayload), NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_with_template(&iotClient, NULL, cPayload, strlen(cPayload), NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_with_template(&iotClient, &pubTemplate, NULL, 0, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - E:11 - Publish template with Null/empty parameters \n");
+}
+
+/* E:12 - QoS1 publish with template matches regular publish */
+TEST_C(PublishTests, publishTemplateQoS1MatchesPublish) {
+	IoT_Publish_Template pubTemplate;
+	unsigned char expectedPacket[TLSMaxBufferSize];
+	size_t expectedLen, idOffset;
+	uint16_t packetId = 0;
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Tests - E:12 - QoS1 publish with template matches regular publish \n");
+
+	setTLSRxBufferForPuback();
+	rc = aws_iot_mqtt_publish(&iotClient, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	expectedLen = TxBuffer.len;
+	memcpy(expectedPacket, TxBuffer.pBuffer, expectedLen);
+
+	rc = aws_iot_mqtt_publish_template_init(&pubTemplate, subTopic, subTopicLen, QOS1, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	setTLSRxBufferForPuback();
+	rc = aws_iot_mqtt_publish_with_template(&iotClient, &pubTemplate, cPayload, strlen(cPayload), &packetId);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(testPubMsgParams.id + 1, packetId);
+
+	/* Identical apart from the packet id behind the topic */
+	idOffset = 2 + 2 + subTopicLen;
+	CHECK_EQUAL_C_INT(expectedLen, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0, memcmp(expectedPacket, TxBuffer.pBuffer, idOffset));
+	CHECK_EQUAL_C_INT(packetId, (TxBuffer.pBuffer[idOffset] << 8) | TxBuffer.pBuffer[idOffset + 1]);
+	CHECK_EQUAL_C_INT(0, memcmp(&expectedPacket[idOffset + 2], &TxBuffer.pBuffer[idOffset + 2],
+								expectedLen - idOffset - 2));
+
+	IOT_DEBUG("-->Success - E:12 - QoS1 publish with template matches regular publish \n");
+}
+
+/* E:13 - QoS0 retained publish with template */
+TEST_C(PublishTests, publishTemplateQoS0Retained) {
+	IoT_Publish_Template pubTemplate;
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Tests - E:13 - QoS0 retained publish with template \n");
+
+	rc = aws_iot_mqtt_publish_template_init(&pubTemplate, subTopic, subTopicLen, QOS0, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_publish_with_template(&iotClient, &pubTemplate, "retained", 8, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(2 + 2 + subTopicLen + 8, TxBuffer.len);
+	CHECK_EQUAL_C_INT(0x31, TxBuffer.pBuffer[0]);
+	CHECK_EQUAL_C_INT(2 + subTopicLen + 8, TxBuffer.pBuffer[1]);
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[4], subTopic, subTopicLen));
+	CHECK_EQUAL_C_INT(0, memcmp(&TxBuffer.pBuffer[4 + subTopicLen], "retained", 8));
+
+	IOT_DEBUG("-->Success - E:13 - QoS0 retained publish with template \n");
+}
@@ -0,0 +1,48 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_queue.cpp
+ * @brief IoT Client Unit Testing - Publish Queue API Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(PublishQueueTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(PublishQueueTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(PublishQueueTests)
+};
+
+/* E:1 - Queue publish with Null/empty parameters */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncNullParams)
+/* E:2 - Queue publish too large for a slot */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncTooLargeForSlot)
+/* E:3 - Queue full, reserved slots only taken by high priority */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncQueueFull)
+/* E:4 - Queued QoS0 publish completes when written by yield */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncQoS0CompletesOnYield)
+/* E:5 - High priority sent first, queued messages batched in one write */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncHighPriorityFirstInBatch)
+/* E:6 - Queued QoS1 publish completes on its PUBACK */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncQoS1CompletesOnPuback)
+/* E:7 - Queued QoS1 publish fails when the PUBACK doesn't arrive */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncQoS1PubackTimeout)
+/* E:8 - Unacknowledged publish resent with DUP after reconnect */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncResentAfterReconnect)
+/* E:9 - Freeing the client fails queued publishes */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncFailedOnFree)
+/* E:10 - Idle queue lets yield sleep through */
+TEST_GROUP_C_WRAPPER(PublishQueueTests, PublishAsyncIdleQueueNoDeadline)
@@ -0,0 +1,379 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_queue_helper.c
+ * @brief IoT Client Unit Testing - Publish Queue API Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#define PQ_TEST_TOPIC "sdk/Test"
+#define PQ_TEST_TOPIC_LEN 8
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static IoT_Publish_Queue_Params testQueueParams;
+
+static AWS_IoT_Client iotClient;
+
+static uint32_t completeCount;
+static IoT_Error_t lastCompleteResult;
+static void *pLastCompleteData;
+
+static void publishCompleteHandler(AWS_IoT_Client *pClient, IoT_Publish_Message_Params *pParams,
+								   IoT_Error_t result, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(pParams);
+
+	completeCount++;
+	lastCompleteResult = result;
+	pLastCompleteData = pData;
+}
+
+static void setTLSRxBufferForPubackWithId(uint16_t packetId) {
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.len = 4;
+	RxIndex = 0;
+
+	RxBuffer.pBuffer[0] = (unsigned char) (0x40);
+	RxBuffer.pBuffer[1] = (unsigned char) (0x02);
+	RxBuffer.pBuffer[2] = (unsigned char) (packetId >> 8);
+	RxBuffer.pBuffer[3] = (unsigned char) (packetId & 0xFF);
+	RxBuffer.NoMsgFlag = false;
+}
+
+/* Packet id of a single QoS1 publish with a one byte remaining length in the TX buffer */
+static uint16_t getLastTLSTxPublishId(void) {
+	size_t idStart = 4 + PQ_TEST_TOPIC_LEN;
+
+	return (uint16_t) ((TxBuffer.pBuffer[idStart] << 8) | TxBuffer.pBuffer[idStart + 1]);
+}
+
+static void setPublishParams(QoS qos, const char *pPayload) {
+	testPubMsgParams.qos = qos;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = (void *) pPayload;
+	testPubMsgParams.payloadLen = strlen(pPayload);
+}
+
+TEST_GROUP_C_SETUP(PublishQueueTests) {
+	IoT_Error_t rc = SUCCESS;
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 500;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	testQueueParams = iotPublishQueueParamsDefault;
+	testQueueParams.pCompleteHandler = publishCompleteHandler;
+	testQueueParams.pCompleteHandlerData = &iotClient;
+	setPublishParams(QOS0, "hello from SDK");
+
+	completeCount = 0;
+	lastCompleteResult = FAILURE;
+	pLastCompleteData = NULL;
+
+	ResetTLSBuffer();
+}
+
+TEST_GROUP_C_TEARDOWN(PublishQueueTests) { }
+
+/* E:1 - Queue publish with Null/empty parameters */
+TEST_C(PublishQueueTests, PublishAsyncNullParams) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:1 - Queue publish with Null/empty parameters \n");
+
+	rc = aws_iot_mqtt_publish_async(NULL, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, NULL, PQ_TEST_TOPIC_LEN, &testPubMsgParams, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, 0, &testPubMsgParams, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, NULL, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PUBLISH_QUEUE_LEN,
+					  aws_iot_mqtt_get_publish_queue_free_count(&iotClient, PUBLISH_PRIORITY_HIGH));
+
+	IOT_DEBUG("-->Success - E:1 - Queue publish with Null/empty parameters \n");
+}
+
+/* E:2 - Queue publish too large for a slot */
+TEST_C(PublishQueueTests, PublishAsyncTooLargeForSlot) {
+	IoT_Error_t rc = SUCCESS;
+	char largePayload[AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN + 1];
+	char tooLargePayload[AWS_IOT_MQTT_TX_BUF_LEN + 1];
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:2 - Queue publish too large for a slot \n");
+
+	memset(largePayload, 'a', sizeof(largePayload) - 1);
+	largePayload[sizeof(largePayload) - 1] = '\0';
+	setPublishParams(QOS0, largePayload);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(MAX_SIZE_ERROR, rc);
+
+	/* Not copied, only needs to fit the TX buffer */
+	testQueueParams.isZeroCopy = true;
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	memset(tooLargePayload, 'a', sizeof(tooLargePayload) - 1);
+	tooLargePayload[sizeof(tooLargePayload) - 1] = '\0';
+	setPublishParams(QOS0, tooLargePayload);
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(MAX_SIZE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - E:2 - Queue publish too large for a slot \n");
+}
+
+/* E:3 - Queue full, reserved slots only taken by high priority */
+TEST_C(PublishQueueTests, PublishAsyncQueueFull) {
+	IoT_Error_t rc = SUCCESS;
+	uint32_t itr;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:3 - Queue full, reserved slots only taken by high priority \n");
+
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_LEN - AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED; ++itr) {
+		rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams,
+										&testQueueParams);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+
+	CHECK_EQUAL_C_INT(0, aws_iot_mqtt_get_publish_queue_free_count(&iotClient, PUBLISH_PRIORITY_NORMAL));
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED,
+					  aws_iot_mqtt_get_publish_queue_free_count(&iotClient, PUBLISH_PRIORITY_HIGH));
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(MQTT_PUBLISH_QUEUE_FULL_ERROR, rc);
+
+	testQueueParams.priority = PUBLISH_PRIORITY_HIGH;
+	for(itr = 0; itr < AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED; ++itr) {
+		rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams,
+										&testQueueParams);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(MQTT_PUBLISH_QUEUE_FULL_ERROR, rc);
+
+	IOT_DEBUG("-->Success - E:3 - Queue full, reserved slots only taken by high priority \n");
+}
+
+/* E:4 - Queued QoS0 publish completes when written by yield */
+TEST_C(PublishQueueTests, PublishAsyncQoS0CompletesOnYield) {
+	IoT_Error_t rc = SUCCESS;
+	char payload[] = "queued QoS0";
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:4 - Queued QoS0 publish completes when written by yield \n");
+
+	setPublishParams(QOS0, payload);
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Copied into the slot, the caller's buffer can be reused right away */
+	payload[0] = 'X';
+	CHECK_EQUAL_C_INT(0, completeCount);
+
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, completeCount);
+	CHECK_EQUAL_C_INT(SUCCESS, lastCompleteResult);
+	CHECK_C(&iotClient == pLastCompleteData);
+	CHECK_EQUAL_C_STRING("queued QoS0", LastPublishMessagePayload);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PUBLISH_QUEUE_LEN,
+					  aws_iot_mqtt_get_publish_queue_free_count(&iotClient, PUBLISH_PRIORITY_HIGH));
+
+	IOT_DEBUG("-->Success - E:4 - Queued QoS0 publish completes when written by yield \n");
+}
+
+/* E:5 - High priority sent first, queued messages batched in one write */
+TEST_C(PublishQueueTests, PublishAsyncHighPriorityFirstInBatch) {
+	IoT_Error_t rc = SUCCESS;
+	size_t expectedLen;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:5 - High priority sent first, queued messages batched in one write \n");
+
+	setPublishParams(QOS0, "bulk");
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setPublishParams(QOS0, "alarm");
+	testQueueParams.priority = PUBLISH_PRIORITY_HIGH;
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Fixed header, topic length and topic of both packets plus their payloads */
+	expectedLen = 2 * (4 + PQ_TEST_TOPIC_LEN) + strlen("bulk") + strlen("alarm");
+	CHECK_EQUAL_C_INT(2, completeCount);
+	CHECK_EQUAL_C_INT(expectedLen, TxBuffer.len);
+	CHECK_EQUAL_C_STRING("alarm", LastPublishMessagePayload);
+
+	IOT_DEBUG("-->Success - E:5 - High priority sent first, queued messages batched in one write \n");
+}
+
+/* E:6 - Queued QoS1 publish completes on its PUBACK */
+TEST_C(PublishQueueTests, PublishAsyncQoS1CompletesOnPuback) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:6 - Queued QoS1 publish completes on its PUBACK \n");
+
+	setPublishParams(QOS1, "queued QoS1");
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, completeCount);
+	CHECK_EQUAL_C_STRING("queued QoS1", LastPublishMessagePayload);
+
+	/* PUBACK for another packet id doesn't complete it */
+	setTLSRxBufferForPubackWithId((uint16_t) (getLastTLSTxPublishId() + 1));
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, completeCount);
+
+	setTLSRxBufferForPubackWithId(getLastTLSTxPublishId());
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, completeCount);
+	CHECK_EQUAL_C_INT(SUCCESS, lastCompleteResult);
+
+	IOT_DEBUG("-->Success - E:6 - Queued QoS1 publish completes on its PUBACK \n");
+}
+
+/* E:7 - Queued QoS1 publish fails when the PUBACK doesn't arrive */
+TEST_C(PublishQueueTests, PublishAsyncQoS1PubackTimeout) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:7 - Queued QoS1 publish fails when the PUBACK doesn't arrive \n");
+
+	setPublishParams(QOS1, "queued QoS1");
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_yield(&iotClient, initParams.mqttCommandTimeout_ms + 200);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, completeCount);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, lastCompleteResult);
+
+	IOT_DEBUG("-->Success - E:7 - Queued QoS1 publish fails when the PUBACK doesn't arrive \n");
+}
+
+/* E:8 - Unacknowledged publish resent with DUP after reconnect */
+TEST_C(PublishQueueTests, PublishAsyncResentAfterReconnect) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:8 - Unacknowledged publish resent with DUP after reconnect \n");
+
+	setPublishParams(QOS1, "queued QoS1");
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0x32, TxBuffer.pBuffer[0]);
+
+	setTLSRxBufferForError(NETWORK_SSL_READ_ERROR);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, completeCount);
+
+	ResetTLSBuffer();
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	/* QoS1 publish with the DUP flag */
+	CHECK_EQUAL_C_INT(0x3A, TxBuffer.pBuffer[0]);
+	CHECK_EQUAL_C_STRING("queued QoS1", LastPublishMessagePayload);
+
+	setTLSRxBufferForPubackWithId(getLastTLSTxPublishId());
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, completeCount);
+	CHECK_EQUAL_C_INT(SUCCESS, lastCompleteResult);
+
+	IOT_DEBUG("-->Success - E:8 - Unacknowledged publish resent with DUP after reconnect \n");
+}
+
+/* E:9 - Freeing the client fails queued publishes */
+TEST_C(PublishQueueTests, PublishAsyncFailedOnFree) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:9 - Freeing the client fails queued publishes \n");
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_free(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(2, completeCount);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, lastCompleteResult);
+
+	IOT_DEBUG("-->Success - E:9 - Freeing the client fails queued publishes \n");
+}
+
+/* E:10 - Idle queue lets yield sleep through */
+TEST_C(PublishQueueTests, PublishAsyncIdleQueueNoDeadline) {
+	IoT_Error_t rc = SUCCESS;
+
+	IOT_DEBUG("-->Running Publish Queue Tests - E:10 - Idle queue lets yield sleep through \n");
+
+	CHECK_C(UINT32_MAX == aws_iot_mqtt_internal_publish_queue_wait_ms(&iotClient));
+
+	iotClient.networkStack.waitForReadable = iot_tls_wait_for_readable;
+	waitForReadableCallCount = 0;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	/* One sleep for the whole yield, not one per poll interval */
+	CHECK_EQUAL_C_INT(1, waitForReadableCallCount);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, PQ_TEST_TOPIC, PQ_TEST_TOPIC_LEN, &testPubMsgParams, &testQueueParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, aws_iot_mqtt_internal_publish_queue_wait_ms(&iotClient));
+
+	IOT_DEBUG("-->Success - E:10 - Idle queue lets yield sleep through \n");
+}
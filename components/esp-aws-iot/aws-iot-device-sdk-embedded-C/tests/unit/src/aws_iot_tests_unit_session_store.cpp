@@ -0,0 +1,42 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_session_store.cpp
+ * @brief IoT Client Unit Testing - Persistent Session Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(SessionStoreTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(SessionStoreTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(SessionStoreTests)
+};
+
+/* E:1 - Set session store with Null/incomplete parameters */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, SetSessionStoreNullParams)
+/* E:2 - RAM store saves, replaces, loads and removes packets */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, RamStoreSaveLoadRemove)
+/* E:3 - RAM store full */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, RamStoreFull)
+/* E:4 - QoS1 publish removed from the store on its PUBACK */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, PublishQoS1RemovedOnPuback)
+/* E:5 - Unacknowledged QoS1 publish resent with DUP after reconnect */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, PublishQoS1ResentOnConnect)
+/* E:6 - Reconnect to a present session skips resubscribe */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, ReconnectSessionPresentSkipsResubscribe)
+/* E:7 - Packet ids after a resent session skip the stored ones across the wraparound */
+TEST_GROUP_C_WRAPPER(SessionStoreTests, ResendPacketIdWraparound)
@@ -0,0 +1,289 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_session_store_helper.c
+ * @brief IoT Client Unit Testing - Persistent Session Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_session_store_ram.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static IoT_MQTT_Session_Store sessionStore;
+static IoT_MQTT_Session_Store_Ram sessionStoreRam;
+
+static AWS_IoT_Client iotClient;
+
+static void setTLSRxBufferForPubackWithId(uint16_t packetId) {
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.len = 4;
+	RxIndex = 0;
+
+	RxBuffer.pBuffer[0] = (unsigned char) (0x40);
+	RxBuffer.pBuffer[1] = (unsigned char) (0x02);
+	RxBuffer.pBuffer[2] = (unsigned char) (packetId >> 8);
+	RxBuffer.pBuffer[3] = (unsigned char) (packetId & 0xFF);
+	RxBuffer.NoMsgFlag = false;
+}
+
+static void iot_subscribe_callback_handler(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
+										   IoT_Publish_Message_Params *params, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(params);
+	IOT_UNUSED(pData);
+}
+
+static size_t getStoredPacket(uint32_t index, uint16_t *pPacketId, unsigned char *pBuf, size_t bufLen) {
+	size_t len = 0;
+	IoT_Error_t rc;
+
+	rc = sessionStore.load(sessionStore.pContext, index, pPacketId, pBuf, bufLen, &len);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	return len;
+}
+
+TEST_GROUP_C_SETUP(SessionStoreTests) {
+	IoT_Error_t rc = SUCCESS;
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 200;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_session_store_ram_init(&sessionStore, &sessionStoreRam);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_set_session_store(&iotClient, &sessionStore);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup_Detailed(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID),
+									QOS1, false, false, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(!aws_iot_mqtt_is_session_present(&iotClient));
+
+	testPubMsgParams.qos = QOS1;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = "session message";
+	testPubMsgParams.payloadLen = strlen("session message");
+
+	ResetTLSBuffer();
+}
+
+TEST_GROUP_C_TEARDOWN(SessionStoreTests) {
+	aws_iot_mqtt_session_store_ram_destroy(&sessionStoreRam);
+}
+
+/* E:1 - Set session store with Null/incomplete parameters */
+TEST_C(SessionStoreTests, SetSessionStoreNullParams) {
+	IoT_MQTT_Session_Store incompleteStore;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:1 - Set session store with Null/incomplete parameters \n");
+
+	rc = aws_iot_mqtt_set_session_store(NULL, &sessionStore);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	incompleteStore = sessionStore;
+	incompleteStore.load = NULL;
+	rc = aws_iot_mqtt_set_session_store(&iotClient, &incompleteStore);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_set_session_store(&iotClient, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - E:1 - Set session store with Null/incomplete parameters \n");
+}
+
+/* E:2 - RAM store saves, replaces, loads and removes packets */
+TEST_C(SessionStoreTests, RamStoreSaveLoadRemove) {
+	unsigned char buf[16];
+	uint16_t packetId = 0;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:2 - RAM store saves, replaces, loads and removes packets \n");
+
+	rc = sessionStore.save(sessionStore.pContext, 7, (const unsigned char *) "first", 5);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = sessionStore.save(sessionStore.pContext, 8, (const unsigned char *) "second", 6);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	/* Same packet id replaces the stored packet */
+	rc = sessionStore.save(sessionStore.pContext, 7, (const unsigned char *) "third", 5);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(6, getStoredPacket(0, &packetId, buf, sizeof(buf)));
+	CHECK_EQUAL_C_INT(8, packetId);
+	CHECK_C(0 == memcmp("second", buf, 6));
+	CHECK_EQUAL_C_INT(5, getStoredPacket(1, &packetId, buf, sizeof(buf)));
+	CHECK_EQUAL_C_INT(7, packetId);
+	CHECK_C(0 == memcmp("third", buf, 5));
+	CHECK_EQUAL_C_INT(0, getStoredPacket(2, &packetId, buf, sizeof(buf)));
+
+	sessionStore.remove(sessionStore.pContext, 8);
+	CHECK_EQUAL_C_INT(5, getStoredPacket(0, &packetId, buf, sizeof(buf)));
+	CHECK_EQUAL_C_INT(7, packetId);
+	sessionStore.remove(sessionStore.pContext, 7);
+	CHECK_EQUAL_C_INT(0, getStoredPacket(0, &packetId, buf, sizeof(buf)));
+
+	IOT_DEBUG("-->Success - E:2 - RAM store saves, replaces, loads and removes packets \n");
+}
+
+/* E:3 - RAM store full */
+TEST_C(SessionStoreTests, RamStoreFull) {
+	static unsigned char packet[AWS_IOT_MQTT_SESSION_STORE_RAM_LEN];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:3 - RAM store full \n");
+
+	rc = sessionStore.save(sessionStore.pContext, 1, packet, AWS_IOT_MQTT_SESSION_STORE_RAM_LEN - 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = sessionStore.save(sessionStore.pContext, 2, packet, 1);
+	CHECK_EQUAL_C_INT(MQTT_SESSION_STORE_FULL_ERROR, rc);
+
+	sessionStore.remove(sessionStore.pContext, 1);
+	rc = sessionStore.save(sessionStore.pContext, 2, packet, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	IOT_DEBUG("-->Success - E:3 - RAM store full \n");
+}
+
+/* E:4 - QoS1 publish removed from the store on its PUBACK */
+TEST_C(SessionStoreTests, PublishQoS1RemovedOnPuback) {
+	unsigned char buf[AWS_IOT_MQTT_TX_BUF_LEN];
+	uint16_t packetId;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:4 - QoS1 publish removed from the store on its PUBACK \n");
+
+	setTLSRxBufferForPubackWithId((uint16_t) (iotClient.clientData.nextPacketId + 1));
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(0, getStoredPacket(0, &packetId, buf, sizeof(buf)));
+
+	IOT_DEBUG("-->Success - E:4 - QoS1 publish removed from the store on its PUBACK \n");
+}
+
+/* E:5 - Unacknowledged QoS1 publish resent with DUP after reconnect */
+TEST_C(SessionStoreTests, PublishQoS1ResentOnConnect) {
+	unsigned char buf[AWS_IOT_MQTT_TX_BUF_LEN];
+	uint16_t packetId = 0;
+	size_t len;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:5 - Unacknowledged QoS1 publish resent with DUP after reconnect \n");
+
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+
+	/* Stored exactly as it was sent */
+	len = getStoredPacket(0, &packetId, buf, sizeof(buf));
+	CHECK_EQUAL_C_INT(TxBuffer.len, len);
+	CHECK_EQUAL_C_INT(testPubMsgParams.id, packetId);
+	CHECK_C(0 == memcmp(TxBuffer.pBuffer, buf, len));
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	setTLSRxBufferForConnack(&connectParams, 1, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(aws_iot_mqtt_is_session_present(&iotClient));
+
+	/* QoS1 publish with the DUP flag is the last write of the connect */
+	CHECK_EQUAL_C_INT(0x3A, TxBuffer.pBuffer[0]);
+	CHECK_EQUAL_C_STRING("session message", LastPublishMessagePayload);
+
+	setTLSRxBufferForPubackWithId(packetId);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, getStoredPacket(0, &packetId, buf, sizeof(buf)));
+
+	IOT_DEBUG("-->Success - E:5 - Unacknowledged QoS1 publish resent with DUP after reconnect \n");
+}
+
+/* E:6 - Reconnect to a present session skips resubscribe */
+TEST_C(SessionStoreTests, ReconnectSessionPresentSkipsResubscribe) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:6 - Reconnect to a present session skips resubscribe \n");
+
+	setTLSRxBufferForSuback("sdk/Test", 8, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, "sdk/Test", 8, QOS1, iot_subscribe_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	setTLSRxBufferForConnack(&connectParams, 1, 0);
+	rc = aws_iot_mqtt_attempt_reconnect(&iotClient);
+	CHECK_EQUAL_C_INT(NETWORK_RECONNECTED, rc);
+	CHECK_EQUAL_C_INT(CLIENT_STATE_CONNECTED_IDLE, aws_iot_mqtt_get_client_state(&iotClient));
+
+	/* CONNECT was the last packet sent, no SUBSCRIBE followed */
+	CHECK_EQUAL_C_INT(0x10, TxBuffer.pBuffer[0]);
+
+	IOT_DEBUG("-->Success - E:6 - Reconnect to a present session skips resubscribe \n");
+}
+
+/* E:7 - Packet ids after a resent session skip the stored ones across the wraparound */
+TEST_C(SessionStoreTests, ResendPacketIdWraparound) {
+	unsigned char buf[AWS_IOT_MQTT_TX_BUF_LEN];
+	uint16_t packetId = 0;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Session Store Tests - E:7 - Packet ids after a resent session skip the stored ones across the wraparound \n");
+
+	/* Two unacknowledged messages on either side of the wraparound */
+	iotClient.clientData.nextPacketId = (uint16_t) (MAX_PACKET_ID - 1);
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+	getStoredPacket(0, &packetId, buf, sizeof(buf));
+	CHECK_EQUAL_C_INT(MAX_PACKET_ID, packetId);
+	getStoredPacket(1, &packetId, buf, sizeof(buf));
+	CHECK_EQUAL_C_INT(1, packetId);
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ResetTLSBuffer();
+	setTLSRxBufferForConnack(&connectParams, 1, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* 1 is newer than MAX_PACKET_ID, the next message must not take it again */
+	setTLSRxBufferForPubackWithId(2);
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(2, testPubMsgParams.id);
+
+	IOT_DEBUG("-->Success - E:7 - Packet ids after a resent session skip the stored ones across the wraparound \n");
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_standby.cpp
+ * @brief IoT Client Unit Testing - Hot-Standby Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(StandbyTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(StandbyTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(StandbyTests)
+};
+
+/* L:1 - Init with invalid parameters */
+TEST_GROUP_C_WRAPPER(StandbyTests, InitInvalidParams)
+/* L:2 - Standby that can't subscribe at once catches up in yield */
+TEST_GROUP_C_WRAPPER(StandbyTests, SubscribeCompletesOnStandby)
+/* L:3 - Only messages arriving on the active client are delivered */
+TEST_GROUP_C_WRAPPER(StandbyTests, MessageDeliveredFromActiveOnly)
+/* L:4 - Publish goes through the standby when the active client is down */
+TEST_GROUP_C_WRAPPER(StandbyTests, PublishFailsOverWhenActiveDown)
+/* L:5 - No failover to a standby that is down too */
+TEST_GROUP_C_WRAPPER(StandbyTests, NoFailoverToDisconnectedStandby)
+/* L:6 - Missed PINGRESP on the active client fails over in yield */
+TEST_GROUP_C_WRAPPER(StandbyTests, YieldFailsOverOnMissedPingresp)
+/* L:7 - Failed client reconnects in the background as the new standby */
+TEST_GROUP_C_WRAPPER(StandbyTests, FailedClientReturnsAsStandby)
+/* L:8 - QoS1 publish retried through the standby is not resent by the failed client */
+TEST_GROUP_C_WRAPPER(StandbyTests, FailoverRetryLeavesNoStoredCopy)
+/* L:9 - Standby reconnects on the reconnect task, not in the pair yield */
+TEST_GROUP_C_WRAPPER(StandbyTests, StandbyReconnectsOnReconnectTask)
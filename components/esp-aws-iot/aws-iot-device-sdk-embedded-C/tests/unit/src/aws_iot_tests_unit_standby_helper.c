@@ -0,0 +1,383 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_standby_helper.c
+ * @brief IoT Client Unit Testing - Hot-Standby Tests Helper
+ *
+ * Both clients of the pair share the mock TLS layer, so each test hands out
+ * one server packet at a time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _ENABLE_THREAD_SUPPORT_
+#include <pthread.h>
+#endif
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_standby.h"
+#include "aws_iot_mqtt_session_store_ram.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+/* Short enough for the tests where the standby waits for a SUBACK in vain */
+#define STANDBY_TEST_COMMAND_TIMEOUT_MS 200
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params primaryConnectParams;
+static IoT_Client_Connect_Params standbyConnectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client primaryClient;
+static AWS_IoT_Client standbyClient;
+static IoT_MQTT_Standby_Pair standbyPair;
+
+static char primaryClientId[] = "standbyPrimary";
+static char standbyClientId[] = "standbySecondary";
+static char subTopic[10] = "sdk/Test";
+static uint16_t subTopicLen = 8;
+
+static uint32_t handledCount;
+static AWS_IoT_Client *pHandledClient;
+
+static void iot_tests_unit_standby_handler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+										   IoT_Publish_Message_Params *pParams, void *pData) {
+	IOT_UNUSED(pTopicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pParams);
+	IOT_UNUSED(pData);
+
+	pHandledClient = pClient;
+	handledCount++;
+}
+
+static void setTLSRxBufferForPubackWithId(uint16_t packetId) {
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.len = 4;
+	RxIndex = 0;
+
+	RxBuffer.pBuffer[0] = (unsigned char) (0x40);
+	RxBuffer.pBuffer[1] = (unsigned char) (0x02);
+	RxBuffer.pBuffer[2] = (unsigned char) (packetId >> 8);
+	RxBuffer.pBuffer[3] = (unsigned char) (packetId & 0xFF);
+	RxBuffer.NoMsgFlag = false;
+}
+
+static IoT_Error_t connectClient(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pParams) {
+	setTLSRxBufferForConnack(pParams, 0, 0);
+	return aws_iot_mqtt_connect(pClient, pParams);
+}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+static void *reconnectWorkerTask(void *pArg) {
+	(void)aws_iot_mqtt_standby_reconnect_run(&standbyPair, *(uint32_t *) pArg);
+	return NULL;
+}
+#endif
+
+/* Subscribe the pair, the SUBACK only reaches the active client */
+static void subscribePair(void) {
+	IoT_Error_t rc;
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_standby_subscribe(&standbyPair, subTopic, subTopicLen, QOS0, iot_tests_unit_standby_handler,
+										NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+}
+
+TEST_GROUP_C_SETUP(StandbyTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = STANDBY_TEST_COMMAND_TIMEOUT_MS;
+	rc = aws_iot_mqtt_init(&primaryClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_init(&standbyClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&primaryConnectParams, primaryClientId, (uint16_t) strlen(primaryClientId));
+	ConnectMQTTParamsSetup(&standbyConnectParams, standbyClientId, (uint16_t) strlen(standbyClientId));
+	rc = connectClient(&primaryClient, &primaryConnectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = connectClient(&standbyClient, &standbyConnectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_standby_init(&standbyPair, &primaryClient, &standbyClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	testPubMsgParams.qos = QOS0;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = (void *) "hi";
+	testPubMsgParams.payloadLen = 2;
+
+	handledCount = 0;
+	pHandledClient = NULL;
+	ResetTLSBuffer();
+}
+
+TEST_GROUP_C_TEARDOWN(StandbyTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&primaryClient);
+	IOT_UNUSED(rc);
+	rc = aws_iot_mqtt_disconnect(&standbyClient);
+	IOT_UNUSED(rc);
+	aws_iot_mqtt_standby_destroy(&standbyPair);
+}
+
+/* L:1 - Init with invalid parameters */
+TEST_C(StandbyTests, InitInvalidParams) {
+	IoT_MQTT_Standby_Pair pair;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:1 - Init with invalid parameters \n");
+
+	rc = aws_iot_mqtt_standby_init(NULL, &primaryClient, &standbyClient);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_standby_init(&pair, &primaryClient, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_standby_init(&pair, &primaryClient, &primaryClient);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	/* The pair set up in the group setup turned auto-reconnect on */
+	CHECK_EQUAL_C_INT(true, aws_iot_is_autoreconnect_enabled(&primaryClient));
+	CHECK_EQUAL_C_INT(true, aws_iot_is_autoreconnect_enabled(&standbyClient));
+	CHECK_C(&primaryClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(0, aws_iot_mqtt_standby_get_failover_count(&standbyPair));
+
+	IOT_DEBUG("-->Success - L:1 - Init with invalid parameters \n");
+}
+
+/* L:2 - Standby that can't subscribe at once catches up in yield */
+TEST_C(StandbyTests, SubscribeCompletesOnStandby) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:2 - Standby that can't subscribe at once catches up in yield \n");
+
+	subscribePair();
+	CHECK_EQUAL_C_INT(0, strncmp(subTopic, primaryClient.clientData.messageHandlers[0].topicName, subTopicLen));
+	CHECK_C(NULL == standbyClient.clientData.messageHandlers[0].topicName);
+	/* The standby did send its SUBSCRIBE */
+	CHECK_EQUAL_C_INT(0x82, TxBuffer.pBuffer[0]);
+
+	/* Too short for the active client, the standby gets all of it */
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, strncmp(subTopic, standbyClient.clientData.messageHandlers[0].topicName, subTopicLen));
+
+	IOT_DEBUG("-->Success - L:2 - Standby that can't subscribe at once catches up in yield \n");
+}
+
+/* L:3 - Only messages arriving on the active client are delivered */
+TEST_C(StandbyTests, MessageDeliveredFromActiveOnly) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:3 - Only messages arriving on the active client are delivered \n");
+
+	subscribePair();
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS0, testPubMsgParams);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, testPubMsgParams, "hi");
+	rc = aws_iot_mqtt_yield(&standbyClient, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, handledCount);
+
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, testPubMsgParams, "hi");
+	rc = aws_iot_mqtt_yield(&primaryClient, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, handledCount);
+	CHECK_C(&primaryClient == pHandledClient);
+
+	IOT_DEBUG("-->Success - L:3 - Only messages arriving on the active client are delivered \n");
+}
+
+/* L:4 - Publish goes through the standby when the active client is down */
+TEST_C(StandbyTests, PublishFailsOverWhenActiveDown) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:4 - Publish goes through the standby when the active client is down \n");
+
+	rc = aws_iot_mqtt_standby_publish(&standbyPair, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&primaryClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+
+	rc = aws_iot_mqtt_disconnect(&primaryClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	TxBuffer.len = 0;
+	rc = aws_iot_mqtt_standby_publish(&standbyPair, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0x30, TxBuffer.pBuffer[0]);
+	CHECK_C(&standbyClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(1, aws_iot_mqtt_standby_get_failover_count(&standbyPair));
+
+	IOT_DEBUG("-->Success - L:4 - Publish goes through the standby when the active client is down \n");
+}
+
+/* L:5 - No failover to a standby that is down too */
+TEST_C(StandbyTests, NoFailoverToDisconnectedStandby) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:5 - No failover to a standby that is down too \n");
+
+	rc = aws_iot_mqtt_disconnect(&standbyClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_disconnect(&primaryClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_standby_publish(&standbyPair, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_C(&primaryClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(0, aws_iot_mqtt_standby_get_failover_count(&standbyPair));
+
+	IOT_DEBUG("-->Success - L:5 - No failover to a standby that is down too \n");
+}
+
+/* L:6 - Missed PINGRESP on the active client fails over in yield */
+TEST_C(StandbyTests, YieldFailsOverOnMissedPingresp) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:6 - Missed PINGRESP on the active client fails over in yield \n");
+
+	primaryClient.clientStatus.isPingOutstanding = true;
+	countdown_ms(&(primaryClient.pingRespTimer), 0);
+
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&standbyClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(1, aws_iot_mqtt_standby_get_failover_count(&standbyPair));
+	CHECK_EQUAL_C_INT(CLIENT_STATE_PENDING_RECONNECT, aws_iot_mqtt_get_client_state(&primaryClient));
+
+	IOT_DEBUG("-->Success - L:6 - Missed PINGRESP on the active client fails over in yield \n");
+}
+
+/* L:7 - Failed client reconnects in the background as the new standby */
+TEST_C(StandbyTests, FailedClientReturnsAsStandby) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:7 - Failed client reconnects in the background as the new standby \n");
+
+	primaryClient.clientStatus.isPingOutstanding = true;
+	countdown_ms(&(primaryClient.pingRespTimer), 0);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&standbyClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+
+	/* Reconnect attempt due, the server answers it */
+	countdown_ms(&(primaryClient.reconnectDelayTimer), 0);
+	setTLSRxBufferForConnack(&primaryConnectParams, 0, 0);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(true, aws_iot_mqtt_is_client_connected(&primaryClient));
+	CHECK_C(&standbyClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+
+	/* And can take over again */
+	rc = aws_iot_mqtt_disconnect(&standbyClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_standby_publish(&standbyPair, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&primaryClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(2, aws_iot_mqtt_standby_get_failover_count(&standbyPair));
+
+	IOT_DEBUG("-->Success - L:7 - Failed client reconnects in the background as the new standby \n");
+}
+
+/* L:8 - QoS1 publish retried through the standby is not resent by the failed client */
+TEST_C(StandbyTests, FailoverRetryLeavesNoStoredCopy) {
+	IoT_MQTT_Session_Store sessionStore;
+	IoT_MQTT_Session_Store_Ram sessionStoreRam;
+	unsigned char buf[64];
+	uint16_t packetId = 0;
+	size_t len = 0;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Standby Tests - L:8 - QoS1 publish retried through the standby is not resent by the failed client \n");
+
+	rc = aws_iot_mqtt_session_store_ram_init(&sessionStore, &sessionStoreRam);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_set_session_store(&primaryClient, &sessionStore);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Stored by the primary, then its connection breaks on the write */
+	testPubMsgParams.qos = QOS1;
+	TxBuffer.mockedError = NETWORK_SSL_WRITE_ERROR;
+	setTLSRxBufferForPubackWithId((uint16_t) (standbyClient.clientData.nextPacketId + 1));
+	rc = aws_iot_mqtt_standby_publish(&standbyPair, subTopic, subTopicLen, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(&standbyClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+	CHECK_EQUAL_C_INT(0x32, TxBuffer.pBuffer[0]);
+
+	rc = sessionStore.load(sessionStore.pContext, 0, &packetId, buf, sizeof(buf), &len);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, len);
+
+	rc = aws_iot_mqtt_set_session_store(&primaryClient, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	aws_iot_mqtt_session_store_ram_destroy(&sessionStoreRam);
+
+	IOT_DEBUG("-->Success - L:8 - QoS1 publish retried through the standby is not resent by the failed client \n");
+}
+
+/* L:9 - Standby reconnects on the reconnect task, not in the pair yield */
+TEST_C(StandbyTests, StandbyReconnectsOnReconnectTask) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t rc;
+	pthread_t worker;
+	uint32_t runMs = 1000;
+	Timer waitTimer;
+
+	IOT_DEBUG("-->Running Standby Tests - L:9 - Standby reconnects on the reconnect task, not in the pair yield \n");
+
+	CHECK_EQUAL_C_INT(0, pthread_create(&worker, NULL, reconnectWorkerTask, &runMs));
+	delay(20);
+
+	/* The standby misses a PINGRESP, the pair yield notices */
+	standbyClient.clientStatus.isPingOutstanding = true;
+	countdown_ms(&(standbyClient.pingRespTimer), 0);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 20);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(CLIENT_STATE_PENDING_RECONNECT, aws_iot_mqtt_get_client_state(&standbyClient));
+
+	/* Handed to the reconnect task, which waits for the attempt to be due */
+	countdown_ms(&(standbyClient.reconnectDelayTimer), 100);
+	rc = aws_iot_mqtt_standby_yield(&standbyPair, 20);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	delay(20);
+	CHECK_EQUAL_C_INT(true, standbyPair.isStandbyReconnecting);
+	CHECK_EQUAL_C_INT(false, aws_iot_mqtt_is_client_connected(&standbyClient));
+
+	/* The server answers the attempt without any further pair yield */
+	setTLSRxBufferForConnack(&standbyConnectParams, 0, 0);
+	init_timer(&waitTimer);
+	countdown_ms(&waitTimer, 500);
+	while(!aws_iot_mqtt_is_client_connected(&standbyClient) && !has_timer_expired(&waitTimer)) {
+		delay(5);
+	}
+	CHECK_EQUAL_C_INT(true, aws_iot_mqtt_is_client_connected(&standbyClient));
+	CHECK_C(&primaryClient == aws_iot_mqtt_standby_get_active(&standbyPair));
+
+	(void)pthread_join(worker, NULL);
+	CHECK_EQUAL_C_INT(0, standbyPair.reconnectWorkers);
+	CHECK_EQUAL_C_INT(false, standbyPair.isStandbyReconnecting);
+
+	IOT_DEBUG("-->Success - L:9 - Standby reconnects on the reconnect task, not in the pair yield \n");
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_stats.cpp
+ * @brief IoT Client Unit Testing - Client Statistics Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(StatsTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(StatsTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(StatsTests)
+};
+
+/* H:1 - Get stats with Null parameters */
+TEST_GROUP_C_WRAPPER(StatsTests, GetStatsNullParams)
+/* H:2 - Connect counted and timed */
+TEST_GROUP_C_WRAPPER(StatsTests, ConnectCountedAndTimed)
+/* H:3 - QoS1 publish PUBACK round trip recorded */
+TEST_GROUP_C_WRAPPER(StatsTests, PublishQoS1PubackRoundTrip)
+/* H:4 - Oversized incoming message counted as dropped */
+TEST_GROUP_C_WRAPPER(StatsTests, OversizedMessageDropped)
+/* H:5 - Yield time and sleep recorded, reset clears everything */
+TEST_GROUP_C_WRAPPER(StatsTests, YieldTimeAndReset)
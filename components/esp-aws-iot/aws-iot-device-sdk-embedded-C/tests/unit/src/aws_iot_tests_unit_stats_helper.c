@@ -0,0 +1,224 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_stats_helper.c
+ * @brief IoT Client Unit Testing - Client Statistics Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#define OVERSIZED_PAYLOAD_LEN (AWS_IOT_MQTT_RX_BUF_LEN + 100)
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static size_t connectPacketLen;
+
+static AWS_IoT_Client iotClient;
+
+static void setTLSRxBufferForPubackWithId(uint16_t packetId) {
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.len = 4;
+	RxIndex = 0;
+
+	RxBuffer.pBuffer[0] = (unsigned char) (0x40);
+	RxBuffer.pBuffer[1] = (unsigned char) (0x02);
+	RxBuffer.pBuffer[2] = (unsigned char) (packetId >> 8);
+	RxBuffer.pBuffer[3] = (unsigned char) (packetId & 0xFF);
+	RxBuffer.NoMsgFlag = false;
+}
+
+/* QoS0 PUBLISH on sdk/Test that doesn't fit the read buffer, returns the packet length */
+static size_t setTLSRxBufferForOversizedPublish(void) {
+	size_t remLen = 2 + 8 + OVERSIZED_PAYLOAD_LEN;
+	size_t cursor = 0;
+
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.pBuffer[cursor++] = 0x30;
+	RxBuffer.pBuffer[cursor++] = (unsigned char) (0x80 | (remLen & 0x7F));
+	RxBuffer.pBuffer[cursor++] = (unsigned char) (remLen >> 7);
+	RxBuffer.pBuffer[cursor++] = 0;
+	RxBuffer.pBuffer[cursor++] = 8;
+	memcpy(&(RxBuffer.pBuffer[cursor]), "sdk/Test", 8);
+	cursor += 8;
+	memset(&(RxBuffer.pBuffer[cursor]), 'x', OVERSIZED_PAYLOAD_LEN);
+	cursor += OVERSIZED_PAYLOAD_LEN;
+
+	RxBuffer.len = cursor;
+	RxIndex = 0;
+	RxBuffer.NoMsgFlag = false;
+
+	return cursor;
+}
+
+TEST_GROUP_C_SETUP(StatsTests) {
+	IoT_Error_t rc = SUCCESS;
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 200;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	connectPacketLen = TxBuffer.len;
+
+	testPubMsgParams.qos = QOS1;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = "stats message";
+	testPubMsgParams.payloadLen = strlen("stats message");
+
+	ResetTLSBuffer();
+}
+
+TEST_GROUP_C_TEARDOWN(StatsTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might have already caused a disconnect by this point.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+}
+
+/* H:1 - Get stats with Null parameters */
+TEST_C(StatsTests, GetStatsNullParams) {
+	IoT_Client_Stats stats;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Stats Tests - H:1 - Get stats with Null parameters \n");
+
+	rc = aws_iot_mqtt_get_stats(NULL, &stats);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_get_stats(&iotClient, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - H:1 - Get stats with Null parameters \n");
+}
+
+/* H:2 - Connect counted and timed */
+TEST_C(StatsTests, ConnectCountedAndTimed) {
+	IoT_Client_Stats stats;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Stats Tests - H:2 - Connect counted and timed \n");
+
+	rc = aws_iot_mqtt_get_stats(&iotClient, &stats);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(connectPacketLen, stats.bytesOut);
+	CHECK_EQUAL_C_INT(1, stats.packetsOut[CONNECT]);
+	CHECK_EQUAL_C_INT(4, stats.bytesIn);
+	CHECK_EQUAL_C_INT(1, stats.packetsIn[CONNACK]);
+	CHECK_EQUAL_C_INT(1, stats.handshake.count);
+	CHECK_EQUAL_C_INT(1, stats.connack.count);
+	CHECK_EQUAL_C_INT(0, stats.pubackRtt.count);
+
+	IOT_DEBUG("-->Success - H:2 - Connect counted and timed \n");
+}
+
+/* H:3 - QoS1 publish PUBACK round trip recorded */
+TEST_C(StatsTests, PublishQoS1PubackRoundTrip) {
+	IoT_Client_Stats stats;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Stats Tests - H:3 - QoS1 publish PUBACK round trip recorded \n");
+
+	aws_iot_mqtt_reset_stats(&iotClient);
+
+	setTLSRxBufferForPubackWithId((uint16_t) (iotClient.clientData.nextPacketId + 1));
+	/* The delay starts before the PUBLISH goes out, leave a margin for the 20ms below */
+	setTLSRxBufferDelay(0, 21000);
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_get_stats(&iotClient, &stats);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(TxBuffer.len, stats.bytesOut);
+	CHECK_EQUAL_C_INT(1, stats.packetsOut[PUBLISH]);
+	CHECK_EQUAL_C_INT(1, stats.packetsIn[PUBACK]);
+	CHECK_EQUAL_C_INT(1, stats.pubackRtt.count);
+	CHECK_C(20 <= stats.pubackRtt.maxMs);
+	CHECK_EQUAL_C_INT(stats.pubackRtt.maxMs, stats.pubackRtt.totalMs);
+	CHECK_EQUAL_C_INT(0, stats.pubackRtt.buckets[0]);
+
+	IOT_DEBUG("-->Success - H:3 - QoS1 publish PUBACK round trip recorded \n");
+}
+
+/* H:4 - Oversized incoming message counted as dropped */
+TEST_C(StatsTests, OversizedMessageDropped) {
+	IoT_Client_Stats stats;
+	size_t packetLen;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Stats Tests - H:4 - Oversized incoming message counted as dropped \n");
+
+	aws_iot_mqtt_reset_stats(&iotClient);
+
+	packetLen = setTLSRxBufferForOversizedPublish();
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(MQTT_RX_BUFFER_TOO_SHORT_ERROR, rc);
+
+	rc = aws_iot_mqtt_get_stats(&iotClient, &stats);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, stats.droppedOversized);
+	CHECK_EQUAL_C_INT(packetLen, stats.bytesIn);
+	CHECK_EQUAL_C_INT(0, stats.packetsIn[PUBLISH]);
+
+	IOT_DEBUG("-->Success - H:4 - Oversized incoming message counted as dropped \n");
+}
+
+/* H:5 - Yield time and sleep recorded, reset clears everything */
+TEST_C(StatsTests, YieldTimeAndReset) {
+	IoT_Client_Stats stats;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Stats Tests - H:5 - Yield time and sleep recorded, reset clears everything \n");
+
+	aws_iot_mqtt_reset_stats(&iotClient);
+
+	iotClient.networkStack.waitForReadable = iot_tls_wait_for_readable;
+	rc = aws_iot_mqtt_yield(&iotClient, 50);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_get_stats(&iotClient, &stats);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, stats.yieldCalls);
+	CHECK_C(50 <= stats.yieldMs);
+	CHECK_C(0 < stats.yieldSleepMs);
+
+	aws_iot_mqtt_reset_stats(&iotClient);
+	rc = aws_iot_mqtt_get_stats(&iotClient, &stats);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(0, stats.yieldCalls);
+	CHECK_EQUAL_C_INT(0, stats.yieldMs);
+	CHECK_EQUAL_C_INT(0, stats.handshake.count);
+	CHECK_EQUAL_C_INT(0, stats.packetsOut[CONNECT]);
+
+	IOT_DEBUG("-->Success - H:5 - Yield time and sleep recorded, reset clears everything \n");
+}
@@ -0,0 +1,36 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_trace.cpp
+ * @brief IoT Client Unit Testing - Binary Trace Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(TraceTests) {
+	TEST_GROUP_C_SETUP_WRAPPER(TraceTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(TraceTests)
+};
+
+/* I:1 - Dump into a buffer too short for the header */
+TEST_GROUP_C_WRAPPER(TraceTests, DumpBufferTooShort)
+/* I:2 - Recorded events dumped oldest first */
+TEST_GROUP_C_WRAPPER(TraceTests, EventsDumpedInOrder)
+/* I:3 - Ring keeps only the newest events */
+TEST_GROUP_C_WRAPPER(TraceTests, RingKeepsNewestEvents)
+/* I:4 - Connect and QoS1 publish traced */
+TEST_GROUP_C_WRAPPER(TraceTests, ConnectAndPublishTraced)
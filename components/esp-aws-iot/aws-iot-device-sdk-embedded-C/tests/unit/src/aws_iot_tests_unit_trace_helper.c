@@ -0,0 +1,208 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_trace_helper.c
+ * @brief IoT Client Unit Testing - Binary Trace Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_trace.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+
+static AWS_IoT_Client iotClient;
+
+static unsigned char dumpBuf[AWS_IOT_TRACE_DUMP_MAX_LEN];
+
+static uint32_t readU32(const unsigned char *pBuf) {
+	return (uint32_t) pBuf[0] | ((uint32_t) pBuf[1] << 8) | ((uint32_t) pBuf[2] << 16) | ((uint32_t) pBuf[3] << 24);
+}
+
+static uint16_t dumpedEventId(size_t index) {
+	const unsigned char *pRecord = &dumpBuf[AWS_IOT_TRACE_DUMP_HEADER_LEN + index * AWS_IOT_TRACE_DUMP_RECORD_LEN];
+	return (uint16_t) (pRecord[16] | (pRecord[17] << 8));
+}
+
+static int32_t dumpedArg(size_t index) {
+	return (int32_t) readU32(&dumpBuf[AWS_IOT_TRACE_DUMP_HEADER_LEN + index * AWS_IOT_TRACE_DUMP_RECORD_LEN + 12]);
+}
+
+static uint32_t dumpedClient(size_t index) {
+	return readU32(&dumpBuf[AWS_IOT_TRACE_DUMP_HEADER_LEN + index * AWS_IOT_TRACE_DUMP_RECORD_LEN + 8]);
+}
+
+static void setTLSRxBufferForPubackWithId(uint16_t packetId) {
+	RxBuffer.NoMsgFlag = true;
+	RxBuffer.len = 4;
+	RxIndex = 0;
+
+	RxBuffer.pBuffer[0] = (unsigned char) (0x40);
+	RxBuffer.pBuffer[1] = (unsigned char) (0x02);
+	RxBuffer.pBuffer[2] = (unsigned char) (packetId >> 8);
+	RxBuffer.pBuffer[3] = (unsigned char) (packetId & 0xFF);
+	RxBuffer.NoMsgFlag = false;
+}
+
+TEST_GROUP_C_SETUP(TraceTests) {
+	IoT_Error_t rc = SUCCESS;
+	ResetTLSBuffer();
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 200;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+
+	testPubMsgParams.qos = QOS1;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = "trace message";
+	testPubMsgParams.payloadLen = strlen("trace message");
+
+	aws_iot_trace_reset();
+	memset(dumpBuf, 0, sizeof(dumpBuf));
+}
+
+TEST_GROUP_C_TEARDOWN(TraceTests) {
+	/* Clean up. Not checking return code here because this is common to all tests.
+	 * A test might not have connected at all.
+	 */
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+}
+
+/* I:1 - Dump into a buffer too short for the header */
+TEST_C(TraceTests, DumpBufferTooShort) {
+	size_t len;
+
+	IOT_DEBUG("-->Running Trace Tests - I:1 - Dump into a buffer too short for the header \n");
+
+	len = aws_iot_trace_dump(NULL, sizeof(dumpBuf));
+	CHECK_EQUAL_C_INT(0, len);
+	len = aws_iot_trace_dump(dumpBuf, AWS_IOT_TRACE_DUMP_HEADER_LEN - 1);
+	CHECK_EQUAL_C_INT(0, len);
+
+	/* Header only, no events recorded yet */
+	len = aws_iot_trace_dump(dumpBuf, AWS_IOT_TRACE_DUMP_HEADER_LEN);
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_DUMP_HEADER_LEN, len);
+	CHECK_EQUAL_C_INT(0, memcmp(dumpBuf, "IOTT", 4));
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_DUMP_RECORD_LEN, dumpBuf[5]);
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_MAX_CORES, dumpBuf[6]);
+	CHECK_EQUAL_C_INT(0, readU32(&dumpBuf[8]));
+
+	IOT_DEBUG("-->Success - I:1 - Dump into a buffer too short for the header \n");
+}
+
+/* I:2 - Recorded events dumped oldest first */
+TEST_C(TraceTests, EventsDumpedInOrder) {
+	size_t len;
+
+	IOT_DEBUG("-->Running Trace Tests - I:2 - Recorded events dumped oldest first \n");
+
+	aws_iot_trace_record(IOT_TRACE_APP, &iotClient, 1);
+	aws_iot_trace_record(IOT_TRACE_APP + 1, NULL, -2);
+	aws_iot_trace_record(IOT_TRACE_APP + 2, &iotClient, 3);
+
+	len = aws_iot_trace_dump(dumpBuf, sizeof(dumpBuf));
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_DUMP_HEADER_LEN + 3 * AWS_IOT_TRACE_DUMP_RECORD_LEN, len);
+	CHECK_EQUAL_C_INT(3, readU32(&dumpBuf[8]));
+
+	CHECK_EQUAL_C_INT(IOT_TRACE_APP, dumpedEventId(0));
+	CHECK_EQUAL_C_INT(1, dumpedArg(0));
+	CHECK_EQUAL_C_INT((uint32_t) (uintptr_t) &iotClient, dumpedClient(0));
+	CHECK_EQUAL_C_INT(IOT_TRACE_APP + 1, dumpedEventId(1));
+	CHECK_EQUAL_C_INT(-2, dumpedArg(1));
+	CHECK_EQUAL_C_INT(0, dumpedClient(1));
+	CHECK_EQUAL_C_INT(IOT_TRACE_APP + 2, dumpedEventId(2));
+	CHECK_EQUAL_C_INT(3, dumpedArg(2));
+
+	/* Records that don't fit are left out */
+	len = aws_iot_trace_dump(dumpBuf, AWS_IOT_TRACE_DUMP_HEADER_LEN + 2 * AWS_IOT_TRACE_DUMP_RECORD_LEN + 1);
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_DUMP_HEADER_LEN + 2 * AWS_IOT_TRACE_DUMP_RECORD_LEN, len);
+	CHECK_EQUAL_C_INT(2, readU32(&dumpBuf[8]));
+
+	IOT_DEBUG("-->Success - I:2 - Recorded events dumped oldest first \n");
+}
+
+/* I:3 - Ring keeps only the newest events */
+TEST_C(TraceTests, RingKeepsNewestEvents) {
+	size_t len;
+	int32_t itr;
+
+	IOT_DEBUG("-->Running Trace Tests - I:3 - Ring keeps only the newest events \n");
+
+	for(itr = 0; itr < 3 * AWS_IOT_TRACE_RING_LEN; itr++) {
+		aws_iot_trace_record(IOT_TRACE_APP, &iotClient, itr);
+	}
+
+	len = aws_iot_trace_dump(dumpBuf, sizeof(dumpBuf));
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_DUMP_MAX_LEN, len);
+	CHECK_EQUAL_C_INT(AWS_IOT_TRACE_RING_LEN, readU32(&dumpBuf[8]));
+	CHECK_EQUAL_C_INT(2 * AWS_IOT_TRACE_RING_LEN, dumpedArg(0));
+	CHECK_EQUAL_C_INT(3 * AWS_IOT_TRACE_RING_LEN - 1, dumpedArg(AWS_IOT_TRACE_RING_LEN - 1));
+
+	IOT_DEBUG("-->Success - I:3 - Ring keeps only the newest events \n");
+}
+
+/* I:4 - Connect and QoS1 publish traced */
+TEST_C(TraceTests, ConnectAndPublishTraced) {
+	static const uint16_t expectedEvents[] = {
+			IOT_TRACE_CONNECT, IOT_TRACE_NETWORK_CONNECT, IOT_TRACE_SEND, IOT_TRACE_RECEIVE, IOT_TRACE_CONNACK,
+			IOT_TRACE_PUBLISH, IOT_TRACE_SEND, IOT_TRACE_RECEIVE, IOT_TRACE_PUBACK
+	};
+	uint16_t packetId;
+	size_t itr, count;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Trace Tests - I:4 - Connect and QoS1 publish traced \n");
+
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	packetId = (uint16_t) (iotClient.clientData.nextPacketId + 1);
+	setTLSRxBufferForPubackWithId(packetId);
+	rc = aws_iot_mqtt_publish(&iotClient, "sdk/Test", 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	(void)aws_iot_trace_dump(dumpBuf, sizeof(dumpBuf));
+	count = readU32(&dumpBuf[8]);
+	CHECK_EQUAL_C_INT(sizeof(expectedEvents) / sizeof(expectedEvents[0]), count);
+	for(itr = 0; itr < count; itr++) {
+		CHECK_EQUAL_C_INT(expectedEvents[itr], dumpedEventId(itr));
+		CHECK_EQUAL_C_INT((uint32_t) (uintptr_t) &iotClient, dumpedClient(itr));
+	}
+
+	CHECK_EQUAL_C_INT(SUCCESS, dumpedArg(1));
+	CHECK_EQUAL_C_INT(MQTT_CONNACK_CONNECTION_ACCEPTED, dumpedArg(4));
+	CHECK_EQUAL_C_INT((CONNACK << 24) | 4, dumpedArg(3));
+	CHECK_EQUAL_C_INT(packetId, dumpedArg(5));
+	CHECK_EQUAL_C_INT(TxBuffer.len, dumpedArg(6));
+	CHECK_EQUAL_C_INT((PUBACK << 24) | 4, dumpedArg(7));
+	CHECK_EQUAL_C_INT(packetId, dumpedArg(8));
+
+	IOT_DEBUG("-->Success - I:4 - Connect and QoS1 publish traced \n");
+}
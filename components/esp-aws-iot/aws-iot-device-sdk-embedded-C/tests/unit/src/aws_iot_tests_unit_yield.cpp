@@ -55,3 +55,20 @@ TEST_GROUP_C_WRAPPER(YieldTests, resubscribeSuccessfulReconnect)
 
 /* G:13 - Delayed Ping response. */
 TEST_GROUP_C_WRAPPER(YieldTests, delayedPingResponse)
+
+/* G:14 - Yield, several packets returned by a single network read */
+TEST_GROUP_C_WRAPPER(YieldTests, multiplePacketsInSingleRead)
+
+/* G:15 - Yield, idle network, sleeps until the keepalive deadline */
+TEST_GROUP_C_WRAPPER(YieldTests, idleYieldSleepsUntilKeepAlive)
+/* G:16 - Yield, sleeping on the network, wakes up for a delayed message */
+TEST_GROUP_C_WRAPPER(YieldTests, idleYieldWakesUpForMessage)
+
+/* G:17 - Yield, PUBACKs and PINGREQ of one cycle sent in a single write */
+TEST_GROUP_C_WRAPPER(YieldTests, acksAndPingCoalesced)
+
+/* G:18 - Yield, messages larger than the TLS records they arrive in */
+TEST_GROUP_C_WRAPPER(YieldTests, largeMessagesInSmallRecords)
+
+/* G:19 - Yield, PUBACK collected before a read error still sent */
+TEST_GROUP_C_WRAPPER(YieldTests, collectedAckSentOnError)
@@ -37,6 +37,7 @@ static char subTopic[10] = "sdk/Test";
 static uint16_t subTopicLen = 8;
 
 static bool dcHandlerInvoked = false;
+static uint32_t callbackInvokedCount = 0;
 
 static void iot_tests_unit_acr_subscribe_callback_handler(AWS_IoT_Client *pClient, char *topicName,
 														  uint16_t topicNameLen,
@@ -74,6 +75,34 @@ static void iot_tests_unit_yield_test_subscribe_callback_handler(AWS_IoT_Client
 	}
 }
 
+static void iot_tests_unit_yield_counting_callback_handler(AWS_IoT_Client *pClient, char *topicName,
+															uint16_t topicNameLen,
+															IoT_Publish_Message_Params *params, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	memcpy(CallbackMsgString, params->payload, params->payloadLen);
+	callbackInvokedCount++;
+}
+
+static char LargeMessage[400];
+static uint32_t largeMessageMatchCount = 0;
+
+static void iot_tests_unit_yield_large_message_callback_handler(AWS_IoT_Client *pClient, char *topicName,
+																uint16_t topicNameLen,
+																IoT_Publish_Message_Params *params, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	if(sizeof(LargeMessage) == params->payloadLen && 0 == memcmp(LargeMessage, params->payload, params->payloadLen)) {
+		largeMessageMatchCount++;
+	}
+}
+
 void iot_tests_unit_disconnect_handler(AWS_IoT_Client *pClient, void *disconParam) {
 	IOT_UNUSED(pClient);
 	IOT_UNUSED(disconParam);
@@ -491,3 +520,212 @@ TEST_C(YieldTests, delayedPingResponse)
 
 	IOT_DEBUG("-->Success - G:13 - Delayed Ping response. \n");
 }
+
+/* G:14 - Yield, several packets returned by a single network read */
+TEST_C(YieldTests, multiplePacketsInSingleRead) {
+	IoT_Error_t rc = FAILURE;
+	char expectedCallbackString[] = "0xA5A5A4";
+	IoT_Publish_Message_Params pubParams;
+	size_t packetLen;
+
+	IOT_DEBUG("-->Running Yield Tests - G:14 - Yield, several packets returned by a single network read \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS1,
+								iot_tests_unit_yield_counting_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Queue the same publish three times so one buffered read returns all of them */
+	pubParams.qos = QOS1;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS1, pubParams, expectedCallbackString);
+	packetLen = RxBuffer.len;
+	memcpy(RxBuffer.pBuffer + packetLen, RxBuffer.pBuffer, packetLen);
+	memcpy(RxBuffer.pBuffer + (2 * packetLen), RxBuffer.pBuffer, packetLen);
+	RxBuffer.len = 3 * packetLen;
+
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+	callbackInvokedCount = 0;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(3, callbackInvokedCount);
+	CHECK_EQUAL_C_STRING(expectedCallbackString, CallbackMsgString);
+	CHECK_EQUAL_C_INT(RxBuffer.len, RxIndex);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.rxRingFill);
+	CHECK_EQUAL_C_INT(1, isLastTLSTxMessagePuback());
+
+	IOT_DEBUG("-->Success - G:14 - Yield, several packets returned by a single network read \n");
+}
+
+/* G:15 - Yield, idle network, sleeps until the keepalive deadline */
+TEST_C(YieldTests, idleYieldSleepsUntilKeepAlive) {
+	IoT_Error_t rc = FAILURE;
+
+	IOT_DEBUG("-->Running Yield Tests - G:15 - Yield, idle network, sleeps until the keepalive deadline \n");
+
+	iotClient.networkStack.waitForReadable = iot_tls_wait_for_readable;
+	countdown_ms(&(iotClient.pingReqTimer), 100);
+	waitForReadableCallCount = 0;
+
+	rc = aws_iot_mqtt_yield(&iotClient, 300);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(true, isLastTLSTxMessagePingreq());
+
+	/* One sleep up to the PINGREQ, one for the rest of the yield */
+	CHECK_C(2 >= waitForReadableCallCount);
+
+	IOT_DEBUG("-->Success - G:15 - Yield, idle network, sleeps until the keepalive deadline \n");
+}
+
+/* G:16 - Yield, sleeping on the network, wakes up for a delayed message */
+TEST_C(YieldTests, idleYieldWakesUpForMessage) {
+	IoT_Error_t rc = FAILURE;
+	char expectedCallbackString[] = "0xA5A5A5";
+	IoT_Publish_Message_Params pubParams;
+
+	IOT_DEBUG("-->Running Yield Tests - G:16 - Yield, sleeping on the network, wakes up for a delayed message \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS1,
+								iot_tests_unit_acr_subscribe_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	memset(CallbackMsgString, 0, sizeof(CallbackMsgString));
+	pubParams.qos = QOS1;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS1, pubParams, expectedCallbackString);
+	setTLSRxBufferDelay(0, 100000);
+
+	iotClient.networkStack.waitForReadable = iot_tls_wait_for_readable;
+	waitForReadableCallCount = 0;
+
+	rc = aws_iot_mqtt_yield(&iotClient, 500);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING(expectedCallbackString, CallbackMsgString);
+	CHECK_EQUAL_C_INT(1, isLastTLSTxMessagePuback());
+	CHECK_C(2 >= waitForReadableCallCount);
+
+	IOT_DEBUG("-->Success - G:16 - Yield, sleeping on the network, wakes up for a delayed message \n");
+}
+
+/* G:17 - Yield, PUBACKs and PINGREQ of one cycle sent in a single write */
+TEST_C(YieldTests, acksAndPingCoalesced) {
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	IoT_Error_t rc = FAILURE;
+	char expectedCallbackString[] = "0xA5A5A6";
+	IoT_Publish_Message_Params pubParams;
+	size_t packetLen, offset;
+	uint32_t pubackCount = 0, pingreqCount = 0;
+
+	IOT_DEBUG("-->Running Yield Tests - G:17 - Yield, PUBACKs and PINGREQ of one cycle sent in a single write \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS1,
+								iot_tests_unit_yield_counting_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Three QoS1 messages in one read, and the keepalive due at the same time */
+	pubParams.qos = QOS1;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS1, pubParams, expectedCallbackString);
+	packetLen = RxBuffer.len;
+	memcpy(RxBuffer.pBuffer + packetLen, RxBuffer.pBuffer, packetLen);
+	memcpy(RxBuffer.pBuffer + (2 * packetLen), RxBuffer.pBuffer, packetLen);
+	RxBuffer.len = 3 * packetLen;
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+	countdown_ms(&(iotClient.pingReqTimer), 0);
+
+	callbackInvokedCount = 0;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(3, callbackInvokedCount);
+
+	/* The mock keeps only the last write, it must hold all four packets */
+	CHECK_EQUAL_C_INT(3 * 4 + 2, TxBuffer.len);
+	for(offset = 0; offset < TxBuffer.len; offset += 2 + TxBuffer.pBuffer[offset + 1]) {
+		if(0x40 == TxBuffer.pBuffer[offset]) {
+			pubackCount++;
+		} else if(0xC0 == TxBuffer.pBuffer[offset]) {
+			pingreqCount++;
+		}
+	}
+	CHECK_EQUAL_C_INT(3, pubackCount);
+	CHECK_EQUAL_C_INT(1, pingreqCount);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.coalesceLen);
+	CHECK_EQUAL_C_INT(false, iotClient.clientData.isWriteCorked);
+
+	IOT_DEBUG("-->Success - G:17 - Yield, PUBACKs and PINGREQ of one cycle sent in a single write \n");
+#endif
+}
+
+/* G:18 - Yield, messages larger than the TLS records they arrive in */
+TEST_C(YieldTests, largeMessagesInSmallRecords) {
+	IoT_Error_t rc = FAILURE;
+	IoT_Publish_Message_Params pubParams;
+	size_t packetLen, i;
+
+	IOT_DEBUG("-->Running Yield Tests - G:18 - Yield, messages larger than the TLS records they arrive in \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS1,
+								iot_tests_unit_yield_large_message_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	for(i = 0; i < sizeof(LargeMessage) - 1; i++) {
+		LargeMessage[i] = (char) ('A' + (i % 26));
+	}
+	LargeMessage[sizeof(LargeMessage) - 1] = 0;
+
+	/* Two messages back to back, the record boundaries fall in the middle of both */
+	pubParams.qos = QOS1;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS1, pubParams, LargeMessage);
+	packetLen = RxBuffer.len;
+	memcpy(RxBuffer.pBuffer + packetLen, RxBuffer.pBuffer, packetLen);
+	RxBuffer.len = 2 * packetLen;
+	RxRecordLen = 100;
+	CHECK_C(0 != packetLen % RxRecordLen);
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+
+	largeMessageMatchCount = 0;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(2, largeMessageMatchCount);
+	CHECK_EQUAL_C_INT(RxBuffer.len, RxIndex);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.rxRingFill);
+	CHECK_EQUAL_C_INT(1, isLastTLSTxMessagePuback());
+
+	IOT_DEBUG("-->Success - G:18 - Yield, messages larger than the TLS records they arrive in \n");
+}
+
+/* G:19 - Yield, PUBACK collected before a read error still sent */
+TEST_C(YieldTests, collectedAckSentOnError) {
+#ifdef ENABLE_IOT_WRITE_COALESCING
+	IoT_Error_t rc = FAILURE;
+	char expectedCallbackString[] = "0xA5A5A7";
+	IoT_Publish_Message_Params pubParams;
+	size_t packetLen;
+
+	IOT_DEBUG("-->Running Yield Tests - G:19 - Yield, PUBACK collected before a read error still sent \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS1,
+								iot_tests_unit_yield_counting_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* A QoS1 message followed by a packet whose remaining length never ends */
+	pubParams.qos = QOS1;
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS1, pubParams, expectedCallbackString);
+	packetLen = RxBuffer.len;
+	memset(RxBuffer.pBuffer + packetLen, 0xFF, 6);
+	RxBuffer.pBuffer[packetLen] = 0x30;
+	RxBuffer.len = packetLen + 6;
+	iotClient.networkStack.readAvailable = iot_tls_read_available;
+
+	callbackInvokedCount = 0;
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_C(SUCCESS != rc);
+	CHECK_EQUAL_C_INT(1, callbackInvokedCount);
+
+	CHECK_EQUAL_C_INT(1, isLastTLSTxMessagePuback());
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.coalesceLen);
+
+	IOT_DEBUG("-->Success - G:19 - Yield, PUBACK collected before a read error still sent \n");
+#endif
+}
@@ -1,10 +1,12 @@
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <network_interface.h>
 
 #include "network_interface.h"
 #include "aws_iot_tests_unit_mock_tls_params.h"
 
+static bool isWakeUpPending = false;
 
 void _iot_tls_set_connect_params(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
 								 char *pDevicePrivateKeyLocation, char *pDestinationURL,
@@ -26,6 +28,10 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
 
 	pNetwork->connect = iot_tls_connect;
 	pNetwork->read = iot_tls_read;
+	pNetwork->readAvailable = NULL; /* Tests opt in to buffered reads explicitly */
+	pNetwork->waitForReadable = NULL; /* Tests opt in to sleeping yields explicitly */
+	pNetwork->wakeUp = iot_tls_wake_up;
+	isWakeUpPending = false;
 	pNetwork->write = iot_tls_write;
 	pNetwork->disconnect = iot_tls_disconnect;
 	pNetwork->isConnected = iot_tls_is_connected;
@@ -212,6 +218,50 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 	return status;
 }
 
+IoT_Error_t iot_tls_read_available(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer, size_t *read_len) {
+	size_t available;
+
+	if(RxBuffer.mockedError != SUCCESS || RxBuffer.NoMsgFlag || RxBuffer.len <= RxIndex) {
+		return iot_tls_read(pNetwork, pMsg, len, pTimer, read_len);
+	}
+
+	available = RxBuffer.len - RxIndex;
+	if(available > len) {
+		available = len;
+	}
+	if(RxRecordLen > 0 && available > RxRecordLen) {
+		available = RxRecordLen;
+	}
+
+	return iot_tls_read(pNetwork, pMsg, available, pTimer, read_len);
+}
+
+IoT_Error_t iot_tls_wait_for_readable(Network *pNetwork, Timer *pTimer) {
+	IOT_UNUSED(pNetwork);
+
+	waitForReadableCallCount++;
+
+	do {
+		if(__atomic_exchange_n(&isWakeUpPending, false, __ATOMIC_ACQ_REL)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		if(RxBuffer.mockedError != SUCCESS ||
+		   (false == RxBuffer.NoMsgFlag && RxIndex < RxBuffer.len && isTimerExpired(RxBuffer.expiry_time))) {
+			return SUCCESS;
+		}
+		usleep(1000);
+	} while(!has_timer_expired(pTimer));
+
+	return NETWORK_SSL_NOTHING_TO_READ;
+}
+
+IoT_Error_t iot_tls_wake_up(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+
+	__atomic_store_n(&isWakeUpPending, true, __ATOMIC_RELEASE);
+	return SUCCESS;
+}
+
 IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
 	IOT_UNUSED(pNetwork);
 	return SUCCESS;
@@ -221,3 +271,20 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork) {
 	IOT_UNUSED(pNetwork);
 	return SUCCESS;
 }
+
+IoT_Error_t iot_tls_forget_session(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_free(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_get_record_buffer_len(Network *pNetwork, size_t *pInLen, size_t *pOutLen) {
+	IOT_UNUSED(pNetwork);
+	*pInLen = 0;
+	*pOutLen = 0;
+	return SUCCESS;
+}
@@ -39,6 +39,8 @@ TlsBuffer RxBuffer = {.pBuffer = RxBuf,.len = 512, .NoMsgFlag=1, .expiry_time =
 TlsBuffer TxBuffer = {.pBuffer = TxBuf,.len = 512, .NoMsgFlag=1, .expiry_time = {0, 0}, .BufMaxSize = TLSMaxBufferSize, .mockedError = SUCCESS};
 
 size_t RxIndex = 0;
+uint32_t waitForReadableCallCount = 0;
+size_t RxRecordLen = 0;
 
 char *invalidEndpointFilter;
 char *invalidRootCAPathFilter;
@@ -44,6 +44,8 @@ extern TlsBuffer RxBuffer;
 extern TlsBuffer TxBuffer;
 
 extern size_t RxIndex;
+extern uint32_t waitForReadableCallCount;
+extern size_t RxRecordLen; /* Most bytes one buffered read hands over, like a TLS record. 0 for no limit */
 extern unsigned char RxBuf[TLSMaxBufferSize];
 extern unsigned char TxBuf[TLSMaxBufferSize];
 extern char LastSubscribeMessage[TLSMaxBufferSize];
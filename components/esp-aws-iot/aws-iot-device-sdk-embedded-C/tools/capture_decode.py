@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+#  http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+
+"""Render a network capture from aws_iot_network_capture_start() as a timeline.
+
+Reads and writes are reassembled into MQTT packets per direction, so a packet
+split over several reads shows up once, at the time its last byte arrived:
+
+    capture_decode.py capture.bin
+    capture_decode.py --raw capture.bin
+"""
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct('<4sB3x')
+RECORD = struct.Struct('<BIH')
+MAGIC = b'IOTC'
+VERSION = 1
+
+# IoT_Capture_Record_Type in aws_iot_network_capture.h
+RECORD_TYPES = {
+    ord('C'): 'CONNECT',
+    ord('R'): 'READ',
+    ord('W'): 'WRITE',
+    ord('E'): 'READ_ERROR',
+    ord('D'): 'DISCONNECT',
+}
+
+PACKET_TYPES = {
+    1: 'CONNECT', 2: 'CONNACK', 3: 'PUBLISH', 4: 'PUBACK', 5: 'PUBREC', 6: 'PUBREL', 7: 'PUBCOMP',
+    8: 'SUBSCRIBE', 9: 'SUBACK', 10: 'UNSUBSCRIBE', 11: 'UNSUBACK', 12: 'PINGREQ', 13: 'PINGRESP',
+    14: 'DISCONNECT', 15: 'AUTH',
+}
+
+
+def parse(data):
+    if len(data) < HEADER.size:
+        raise ValueError('capture shorter than its header')
+    magic, version = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError('bad magic %r' % magic)
+    if version != VERSION:
+        raise ValueError('unsupported capture version %d' % version)
+
+    records = []
+    pos = HEADER.size
+    while pos + RECORD.size <= len(data):
+        record_type, time_ms, length = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        if pos + length > len(data):
+            print('capture_decode: last record cut off', file=sys.stderr)
+            break
+        records.append((time_ms, record_type, data[pos:pos + length]))
+        pos += length
+    return records
+
+
+def fixed_header(buf):
+    """Fixed header length and remaining length of the MQTT packet at the start of buf, None while incomplete."""
+    remaining = 0
+    for i in range(1, min(len(buf), 5)):
+        remaining |= (buf[i] & 0x7F) << (7 * (i - 1))
+        if not buf[i] & 0x80:
+            return i + 1, remaining
+    return None
+
+
+def packet_length(buf):
+    """Length of the MQTT packet at the start of buf, None while incomplete."""
+    header = fixed_header(buf)
+    if header is None or len(buf) < header[0] + header[1]:
+        return None
+    return header[0] + header[1]
+
+
+def describe_packet(packet):
+    packet_type = packet[0] >> 4
+    name = PACKET_TYPES.get(packet_type, 'type %d' % packet_type)
+    detail = '%d bytes' % len(packet)
+    if name == 'PUBLISH':
+        header_len = fixed_header(packet)[0]
+        topic_len = (packet[header_len] << 8) | packet[header_len + 1]
+        topic = packet[header_len + 2:header_len + 2 + topic_len].decode('utf-8', errors='replace')
+        detail += ' qos%d %s' % ((packet[0] >> 1) & 3, topic)
+    return name, detail
+
+
+def rc_of(payload):
+    return struct.unpack('<i', payload[:4])[0] if len(payload) >= 4 else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('capture', help='capture file')
+    parser.add_argument('--raw', action='store_true', help='print the records as recorded, no packet reassembly')
+    args = parser.parse_args()
+
+    try:
+        with open(args.capture, 'rb') as f:
+            records = parse(f.read())
+    except (OSError, ValueError) as e:
+        sys.exit('capture_decode: %s' % e)
+
+    totals = {'READ': 0, 'WRITE': 0}
+    pending = {'READ': b'', 'WRITE': b''}
+    print('%10s  %-3s %-12s %s' % ('t [ms]', 'dir', 'event', 'detail'))
+    for time_ms, record_type, payload in records:
+        name = RECORD_TYPES.get(record_type, 'RECORD_%d' % record_type)
+        if name in ('CONNECT', 'READ_ERROR'):
+            print('%10d  %-3s %-12s rc=%s' % (time_ms, '', name, rc_of(payload)))
+            # Bytes of a broken connection never complete a packet
+            pending = {'READ': b'', 'WRITE': b''}
+            continue
+        if name not in totals:
+            print('%10d  %-3s %s' % (time_ms, '', name))
+            continue
+
+        direction = '<-' if name == 'READ' else '->'
+        totals[name] += len(payload)
+        if args.raw:
+            print('%10d  %-3s %-12s %d bytes' % (time_ms, direction, name, len(payload)))
+            continue
+        buf = pending[name] + payload
+        while True:
+            length = packet_length(buf)
+            if length is None:
+                break
+            packet_name, detail = describe_packet(buf[:length])
+            print('%10d  %-3s %-12s %s' % (time_ms, direction, packet_name, detail))
+            buf = buf[length:]
+        pending[name] = buf
+
+    print('%d records, %d bytes read, %d bytes written' % (len(records), totals['READ'], totals['WRITE']))
+
+
+if __name__ == '__main__':
+    main()
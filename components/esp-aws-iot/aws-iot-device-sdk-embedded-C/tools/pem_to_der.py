@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+#  http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+
+"""Convert a PEM certificate, certificate chain or private key to DER.
+
+Meant as a build step, so credentials are embedded as DER and handed to
+aws_iot_mqtt_init() with their length instead of being base64 decoded on
+the device. The certificates of a chain are written back to back:
+
+    pem_to_der.py aws-root-ca.pem aws-root-ca.der
+
+A file that already is DER is copied. Encrypted private keys are refused,
+the TLS layer has no password to decrypt them with.
+"""
+
+import argparse
+import base64
+import binascii
+import re
+import sys
+
+PEM_BLOCK = re.compile(rb'-----BEGIN ([A-Z0-9 ]+)-----(.*?)-----END \1-----', re.DOTALL)
+ASN1_SEQUENCE = 0x30
+
+
+def pem_to_der(data):
+    blocks = PEM_BLOCK.findall(data)
+    if not blocks:
+        if data[:1] == bytes([ASN1_SEQUENCE]):
+            return data
+        raise ValueError('neither PEM nor DER')
+
+    keys = 0
+    der_blocks = []
+    for label, body in blocks:
+        label = label.decode('ascii')
+        if label == 'EC PARAMETERS':
+            # openssl ecparam -genkey puts the curve in front of the key, the key names it as well
+            continue
+        if 'ENCRYPTED' in label or b'Proc-Type: 4,ENCRYPTED' in body:
+            raise ValueError('encrypted private key')
+        if 'KEY' in label:
+            keys += 1
+        elif 'CERTIFICATE' not in label:
+            raise ValueError('unexpected PEM block %s' % label)
+        lines = [line.strip() for line in body.splitlines() if b':' not in line]
+        try:
+            der_blocks.append(base64.b64decode(b''.join(lines), validate=True))
+        except binascii.Error as e:
+            raise ValueError('%s: %s' % (label, e))
+
+    if keys and (keys > 1 or len(der_blocks) > 1):
+        raise ValueError('a private key must be alone in its file')
+    return b''.join(der_blocks)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('pem', help='PEM input')
+    parser.add_argument('der', help='DER output')
+    args = parser.parse_args()
+
+    try:
+        with open(args.pem, 'rb') as f:
+            der = pem_to_der(f.read())
+        with open(args.der, 'wb') as f:
+            f.write(der)
+    except (OSError, ValueError) as e:
+        sys.exit('pem_to_der: %s: %s' % (args.pem, e))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+#  http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+
+"""Render an aws_iot_trace_dump() buffer as a timeline.
+
+The input is either the raw dump or a text log in which the dump was printed
+as hex after an "IOTTRACE:" marker, possibly split over several lines:
+
+    trace_decode.py dump.bin
+    idf.py monitor | tee log.txt; trace_decode.py log.txt
+"""
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct('<4sBBBxII')
+RECORD = struct.Struct('<IIIiHBB')
+MAGIC = b'IOTT'
+VERSION = 1
+HEX_MARKER = 'IOTTRACE:'
+
+# IoT_Trace_Event_Id in aws_iot_trace.h
+EVENTS = {
+    1: 'CONNECT',
+    2: 'NETWORK_CONNECT',
+    3: 'CONNACK',
+    4: 'DISCONNECT',
+    5: 'RECONNECT',
+    6: 'SEND',
+    7: 'RECEIVE',
+    8: 'DROP',
+    9: 'PUBLISH',
+    10: 'PUBACK',
+    11: 'PINGREQ',
+    12: 'CONNECTION_LOST',
+}
+EVENT_APP = 0x8000
+
+PACKET_TYPES = {
+    1: 'CONNECT', 2: 'CONNACK', 3: 'PUBLISH', 4: 'PUBACK', 5: 'PUBREC', 6: 'PUBREL', 7: 'PUBCOMP',
+    8: 'SUBSCRIBE', 9: 'SUBACK', 10: 'UNSUBSCRIBE', 11: 'UNSUBACK', 12: 'PINGREQ', 13: 'PINGRESP',
+    14: 'DISCONNECT',
+}
+
+
+def describe(event_id, arg):
+    name = EVENTS.get(event_id)
+    if name is None:
+        if event_id >= EVENT_APP:
+            return 'APP+%d' % (event_id - EVENT_APP), 'arg=%d' % arg
+        return 'EVENT_%d' % event_id, 'arg=%d' % arg
+
+    if name in ('NETWORK_CONNECT', 'CONNACK', 'DISCONNECT', 'PINGREQ'):
+        detail = 'rc=%d' % arg
+    elif name == 'SEND':
+        detail = '%d bytes' % arg if arg >= 0 else 'rc=%d' % arg
+    elif name == 'RECEIVE':
+        packet_type = (arg >> 24) & 0xFF
+        detail = '%s %d bytes' % (PACKET_TYPES.get(packet_type, 'type %d' % packet_type), arg & 0xFFFFFF)
+    elif name == 'DROP':
+        detail = '%d bytes' % arg
+    elif name == 'PUBLISH':
+        detail = 'id=%d' % (arg & 0xFFFF) + (' dup' if arg & 0x10000 else '')
+    elif name == 'PUBACK':
+        detail = 'id=%d' % arg
+    elif name == 'RECONNECT':
+        detail = 'backoff %d ms' % arg
+    else:
+        detail = ''
+    return name, detail
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data.startswith(MAGIC):
+        return data
+
+    text = data.decode('utf-8', errors='replace')
+    hex_digits = []
+    for line in text.splitlines():
+        pos = line.find(HEX_MARKER)
+        if pos >= 0:
+            hex_digits.append(''.join(c for c in line[pos + len(HEX_MARKER):] if c in '0123456789abcdefABCDEF'))
+    if not hex_digits:
+        raise ValueError('%s is neither a trace dump nor a log with %s lines' % (path, HEX_MARKER))
+    return bytes.fromhex(''.join(hex_digits))
+
+
+def parse(data):
+    if len(data) < HEADER.size:
+        raise ValueError('dump shorter than its header')
+    magic, version, record_len, num_rings, count, dump_ts = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError('bad magic %r' % magic)
+    if version != VERSION or record_len != RECORD.size:
+        raise ValueError('unsupported dump version %d, record length %d' % (version, record_len))
+    if len(data) < HEADER.size + count * RECORD.size:
+        raise ValueError('dump truncated, %d records announced' % count)
+
+    events = []
+    for index in range(count):
+        seq, ts, client, arg, event_id, core, ring = RECORD.unpack_from(data, HEADER.size + index * RECORD.size)
+        # Age relative to the dump is immune to the 32 bit microsecond counter wrapping
+        age_us = (dump_ts - ts) & 0xFFFFFFFF
+        events.append((age_us, ring, seq, core, client, event_id, arg))
+    # Oldest first; within a ring the sequence breaks timestamp ties
+    events.sort(key=lambda e: (-e[0], e[1], e[2]))
+    return num_rings, events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('dump', help='binary dump or log file with %s hex lines' % HEX_MARKER)
+    parser.add_argument('--client', help='only show events of this client, as printed in the client column')
+    args = parser.parse_args()
+
+    try:
+        num_rings, events = parse(load(args.dump))
+        only_client = int(args.client, 16) if args.client else None
+    except (OSError, ValueError) as e:
+        sys.exit('trace_decode: %s' % e)
+
+    if not events:
+        print('no events in %d ring(s)' % num_rings)
+        return
+
+    start_age = events[0][0]
+    print('%12s %12s  %-4s %-10s %s' % ('t [ms]', 'age [ms]', 'core', 'client', 'event'))
+    for age_us, _, _, core, client, event_id, arg in events:
+        if only_client is not None and only_client != client:
+            continue
+        name, detail = describe(event_id, arg)
+        print(('%12.3f %12.3f  %-4d %08x   %-16s %s' % ((start_age - age_us) / 1000.0, age_us / 1000.0, core,
+                                                       client, name, detail)).rstrip())
+
+
+if __name__ == '__main__':
+    main()
@@ -39,8 +39,82 @@
 // MQTT PubSub
 #define AWS_IOT_MQTT_TX_BUF_LEN CONFIG_AWS_IOT_MQTT_TX_BUF_LEN ///< Any time a message is sent out through the MQTT layer. The message is copied into this buffer anytime a publish is done. This will also be used in the case of Thing Shadow
 #define AWS_IOT_MQTT_RX_BUF_LEN CONFIG_AWS_IOT_MQTT_RX_BUF_LEN ///< Any message that comes into the device should be less than this buffer size. If a received message is bigger than this buffer size the message will be dropped.
+#define AWS_IOT_MQTT_RX_RING_BUF_LEN CONFIG_AWS_IOT_MQTT_RX_RING_BUF_LEN ///< Decrypted bytes are buffered here ahead of packet framing, so one network read can deliver several MQTT packets
 #define AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS CONFIG_AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS ///< Maximum number of topic filters the MQTT client can handle at any given time. This should be increased appropriately when using Thing Shadow
 
+// Full-duplex client, publish from any task while another one yields
+#ifdef CONFIG_AWS_IOT_MQTT_FULL_DUPLEX
+#define ENABLE_IOT_FULL_DUPLEX
+#define AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH CONFIG_AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH ///< QoS1 publishes that can wait for their PUBACK at the same time
+#endif
+
+// Asynchronous publish queue drained by yield
+#ifdef CONFIG_AWS_IOT_MQTT_PUBLISH_QUEUE
+#define ENABLE_IOT_PUBLISH_QUEUE
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_LEN CONFIG_AWS_IOT_MQTT_PUBLISH_QUEUE_LEN ///< Messages that can be queued or wait for their PUBACK
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN CONFIG_AWS_IOT_MQTT_PUBLISH_QUEUE_SLOT_LEN ///< Bytes for topic name and payload in each queue slot
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED CONFIG_AWS_IOT_MQTT_PUBLISH_QUEUE_HIGH_RESERVED ///< Queue slots only high priority messages can take
+#define AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS CONFIG_AWS_IOT_MQTT_PUBLISH_QUEUE_POLL_MS ///< Longest idle sleep of yield before it looks for queued messages
+#endif
+
+// Received messages handed to worker tasks, aws_iot_mqtt_dispatch_run()
+#ifdef CONFIG_AWS_IOT_MQTT_DISPATCH_POOL
+#define ENABLE_IOT_DISPATCH_POOL
+#define AWS_IOT_MQTT_DISPATCH_SLOTS CONFIG_AWS_IOT_MQTT_DISPATCH_SLOTS ///< Received messages waiting for or in a worker
+#define AWS_IOT_MQTT_DISPATCH_SLOT_LEN CONFIG_AWS_IOT_MQTT_DISPATCH_SLOT_LEN ///< Bytes for topic name and payload in each dispatch slot
+#define AWS_IOT_MQTT_DISPATCH_QUEUE_LEN CONFIG_AWS_IOT_MQTT_DISPATCH_QUEUE_LEN ///< Messages one subscription can have waiting
+#define AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS CONFIG_AWS_IOT_MQTT_DISPATCH_BLOCK_MAX_MS ///< Longest wait of the reader for room in a blocking queue
+#endif
+
+// Small packets sent during yield leave in one network write
+#ifdef CONFIG_AWS_IOT_MQTT_WRITE_COALESCING
+#define ENABLE_IOT_WRITE_COALESCING
+#define AWS_IOT_MQTT_COALESCE_BUF_LEN CONFIG_AWS_IOT_MQTT_COALESCE_BUF_LEN ///< Bytes collected before they are written anyway
+#endif
+
+// MQTT 5 protocol support
+#ifdef CONFIG_AWS_IOT_MQTT5
+#define ENABLE_IOT_MQTT5
+#define AWS_IOT_MQTT5_TOPIC_ALIASES CONFIG_AWS_IOT_MQTT5_TOPIC_ALIASES ///< Topics bound to an alias per connection
+#define AWS_IOT_MQTT5_TOPIC_ALIAS_LEN CONFIG_AWS_IOT_MQTT5_TOPIC_ALIAS_LEN ///< Longest topic name that gets an alias
+#define AWS_IOT_MQTT5_RECEIVE_MAXIMUM CONFIG_AWS_IOT_MQTT5_RECEIVE_MAXIMUM ///< QoS1 messages the server may have unacknowledged towards the client
+#endif
+
+// Client statistics, aws_iot_mqtt_get_stats()
+#ifndef CONFIG_AWS_IOT_MQTT_STATS
+#define DISABLE_IOT_STATS
+#endif
+
+// Binary event trace, aws_iot_trace_dump()
+#ifdef CONFIG_AWS_IOT_TRACE_RING
+#define AWS_IOT_TRACE_RING_LEN CONFIG_AWS_IOT_TRACE_RING_LEN ///< Events kept per core, a power of two
+#else
+#define DISABLE_IOT_TRACE_RING
+#endif
+#ifdef CONFIG_FREERTOS_UNICORE
+#define AWS_IOT_TRACE_MAX_CORES 1 ///< One trace ring per core
+#else
+#define AWS_IOT_TRACE_MAX_CORES 2 ///< One trace ring per core
+#endif
+
+// Session store in NVS for unacknowledged QoS1 messages
+#define AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS CONFIG_AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS ///< QoS1 messages the NVS session store can hold
+
+// TLS session resumption on reconnect
+#ifdef CONFIG_AWS_IOT_TLS_SESSION_RESUMPTION
+#define AWS_IOT_TLS_SESSION_LIFETIME_SEC CONFIG_AWS_IOT_TLS_SESSION_LIFETIME ///< Longest time after the full handshake a session is offered again
+#else
+#define DISABLE_IOT_TLS_SESSION_RESUMPTION
+#endif
+
+// Record size asked for by IOT_TLS_PROFILE_LEAN
+#define AWS_IOT_TLS_MAX_FRAGMENT_LEN CONFIG_AWS_IOT_TLS_MAX_FRAGMENT_LEN ///< 512, 1024, 2048 or 4096
+
+// Non-blocking socket I/O
+#ifdef CONFIG_AWS_IOT_TLS_NON_BLOCKING
+#define IOT_SSL_SOCKET_NON_BLOCKING
+#endif
+
 // Thing Shadow specific configs
 #ifdef CONFIG_AWS_IOT_OVERRIDE_THING_SHADOW_RX_BUFFER
 #define SHADOW_MAX_SIZE_OF_RX_BUFFER CONFIG_AWS_IOT_SHADOW_MAX_SIZE_OF_RX_BUFFER ///< Maximum size of the SHADOW buffer to store the received Shadow message, including NULL terminating byte
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * Additions Copyright 2016 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_session_store_nvs.h
+ * @brief MQTT session store keeping unacknowledged messages in NVS flash
+ *
+ * Messages survive reboots. Every stored and every acknowledged QoS1 message
+ * costs a flash write, so keep the publish rate of QoS1 messages moderate.
+ */
+
+#ifndef AWS_IOTSDK_SESSION_STORE_NVS_H
+#define AWS_IOTSDK_SESSION_STORE_NVS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "nvs.h"
+
+#include "aws_iot_mqtt_client.h"
+
+#ifndef AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS
+#define AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS 16
+#endif
+
+/**
+ * @brief NVS Session Store
+ *
+ * Storage for aws_iot_session_store_nvs_init. Treat as opaque.
+ */
+typedef struct {
+    nvs_handle_t handle;
+    IoT_Mutex_t lock;
+    uint16_t count;
+    uint16_t ids[AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS];
+} IoT_Session_Store_Nvs;
+
+/**
+ * @brief Set up a session store keeping messages in NVS
+ *
+ * nvs_flash_init() must have been called before. Messages stored before a reboot
+ * are picked up again and sent on the next connect.
+ *
+ * @param pStore Session store to pass to aws_iot_mqtt_set_session_store
+ * @param pNvs Storage of the store, must outlive it
+ * @param pNamespace NVS namespace used only by this store
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_session_store_nvs_init(IoT_MQTT_Session_Store *pStore, IoT_Session_Store_Nvs *pNvs,
+                                           const char *pNamespace);
+
+/**
+ * @brief Close a session store set up by aws_iot_session_store_nvs_init
+ *
+ * Stored messages stay in flash.
+ *
+ * @param pNvs Storage of the store
+ */
+void aws_iot_session_store_nvs_deinit(IoT_Session_Store_Nvs *pNvs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOTSDK_SESSION_STORE_NVS_H */
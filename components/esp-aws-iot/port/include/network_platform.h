@@ -33,6 +33,8 @@
 #include "mbedtls/debug.h"
 #include "mbedtls/timing.h"
 
+#include "timer_interface.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,6 +55,14 @@ typedef struct _TLSDataParams {
     mbedtls_x509_crt clicert;
     mbedtls_pk_context pkey;
     mbedtls_net_context server_fd;
+    bool isConfigLoaded; ///< Credentials are parsed and conf is built, every connect shares them until iot_tls_free
+    mbedtls_ssl_session savedSession; ///< Session of the last full handshake, offered on the next connect
+    bool isSessionSaved; ///< savedSession holds a resumable session
+    bool isSessionResumed; ///< The last handshake resumed savedSession instead of doing a full one
+    const char *pSessionHost; ///< Endpoint savedSession was negotiated with, not copied
+    uint16_t sessionPort; ///< Port savedSession was negotiated on
+    Timer sessionExpiry; ///< savedSession is dropped instead of offered once this expires
+    int wakeFd; ///< UDP socket connected to itself, iot_tls_wake_up sends to it to end a select. -1 if it could not be opened
 }TLSDataParams;
 
 #define IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
@@ -36,6 +36,16 @@ struct _IoT_Mutex_t {
     SemaphoreHandle_t mutex;
 };
 
+/**
+ * @brief Semaphore Type
+ *
+ * definition of the Semaphore struct. Platform specific
+ *
+ */
+struct _IoT_Semaphore_t {
+    SemaphoreHandle_t sem;
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,8 +14,13 @@
  * permissions and limitations under the License.
  */
 #include <sys/param.h>
+#include <sys/select.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
 #include <timer_platform.h>
 #include <network_interface.h>
 
@@ -25,6 +30,9 @@
 #include "network_platform.h"
 
 #include "mbedtls/esp_debug.h"
+#include "mbedtls/asn1.h"
+#include "mbedtls/version.h"
+#include "mbedtls/ssl_internal.h"
 
 #ifdef CONFIG_AWS_IOT_USE_HARDWARE_SECURE_ELEMENT
 #include "mbedtls/atca_mbedtls_wrap.h"
@@ -32,14 +40,78 @@
 #include "tng_atcacert_client.h"
 #endif
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 #include "esp_log.h"
 #include "esp_vfs.h"
 
+#include "dns_cache.h"
+
 static const char *TAG = "aws_iot";
 
 /* This is the value used for ssl read timeout */
 #define IOT_SSL_READ_TIMEOUT 10
 
+/* Longest wait for room in the socket to send the close notify */
+#define IOT_SSL_CLOSE_NOTIFY_TIMEOUT 100
+
+/* Most endpoints of a list raced at the same time, one socket each */
+#define IOT_TLS_MAX_RACED_ENDPOINTS 4
+
+#ifndef AWS_IOT_TLS_MAX_FRAGMENT_LEN
+/* Longest record the lean profile asks the server for */
+#define AWS_IOT_TLS_MAX_FRAGMENT_LEN 2048
+#endif
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+#if AWS_IOT_TLS_MAX_FRAGMENT_LEN == 512
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_512
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 1024
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 2048
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif AWS_IOT_TLS_MAX_FRAGMENT_LEN == 4096
+#define IOT_TLS_MFL_CODE MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#else
+#error "AWS_IOT_TLS_MAX_FRAGMENT_LEN must be 512, 1024, 2048 or 4096"
+#endif
+#endif
+
+#ifdef CONFIG_MBEDTLS_SSL_ALPN
+/* Referenced by the shared config, so it must outlive every connect */
+static const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
+#endif
+
+#if (defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) || defined(MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED)) \
+    && ((defined(MBEDTLS_GCM_C) && defined(MBEDTLS_AES_C)) || defined(MBEDTLS_CHACHAPOLY_C)) \
+    && (defined(MBEDTLS_ECP_DP_CURVE25519_ENABLED) || defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED))
+#define IOT_TLS_FAST_HANDSHAKE_SUPPORTED
+
+/* Suites of the fast handshake profile, AES-128-GCM first for the builds with AES hardware.
+ * mbedtls leaves the ones it was built without out of the client hello. */
+static const int fastHandshakeCiphersuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+#ifdef MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+#endif
+    0
+};
+
+/* Curves of the fast handshake profile, a curve missing from the build must not be listed */
+static const mbedtls_ecp_group_id fastHandshakeCurves[] = {
+#if defined(MBEDTLS_ECP_DP_CURVE25519_ENABLED)
+    MBEDTLS_ECP_DP_CURVE25519,
+#endif
+#if defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED)
+    MBEDTLS_ECP_DP_SECP256R1,
+#endif
+    MBEDTLS_ECP_DP_NONE
+};
+#endif
+
 /*
  * This is a function to do further verification if needed on the cert received.
  *
@@ -76,49 +148,450 @@ static void _iot_tls_set_connect_params(Network *pNetwork, const char *pRootCALo
     pNetwork->tlsConnectParams.ServerVerificationFlag = ServerVerificationFlag;
 }
 
+/*
+ * Open the socket that wakes up iot_tls_wait_for_readable. lwIP select only
+ * watches sockets, so a datagram sent over the loopback interface to the socket
+ * itself does what a pipe does elsewhere. Without it the network is left without
+ * wakeUp, and the client falls back to polling.
+ */
+static void _iot_tls_open_wake_socket(Network *pNetwork) {
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int fd;
+
+    pNetwork->wakeUp = NULL;
+    pNetwork->tlsDataParams.wakeFd = -1;
+
+    fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        ESP_LOGW(TAG, "Unable to open the wake-up socket, errno %d", errno);
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (0 != bind(fd, (struct sockaddr *) &addr, sizeof(addr))
+        || 0 != getsockname(fd, (struct sockaddr *) &addr, &addrLen)
+        || 0 != connect(fd, (struct sockaddr *) &addr, addrLen)) {
+        ESP_LOGW(TAG, "Unable to set up the wake-up socket, errno %d", errno);
+        close(fd);
+        return;
+    }
+    /* A full receive queue already wakes the next wait, the send may be dropped */
+    (void) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    pNetwork->tlsDataParams.wakeFd = fd;
+    pNetwork->wakeUp = iot_tls_wake_up;
+}
+
 IoT_Error_t iot_tls_init(Network *pNetwork, const char *pRootCALocation, const char *pDeviceCertLocation,
                          const char *pDevicePrivateKeyLocation, const char *pDestinationURL,
                          uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
     _iot_tls_set_connect_params(pNetwork, pRootCALocation, pDeviceCertLocation, pDevicePrivateKeyLocation,
                                 pDestinationURL, destinationPort, timeout_ms, ServerVerificationFlag);
+    pNetwork->tlsConnectParams.pEndpoints = NULL;
+    pNetwork->tlsConnectParams.endpointCount = 0;
+    pNetwork->tlsConnectParams.preferredEndpoint = 0;
+    pNetwork->tlsConnectParams.endpointRaceDelay_ms = 0;
+    pNetwork->tlsConnectParams.rootCALen = 0;
+    pNetwork->tlsConnectParams.deviceCertLen = 0;
+    pNetwork->tlsConnectParams.devicePrivateKeyLen = 0;
+    pNetwork->tlsConnectParams.tlsProfile = IOT_TLS_PROFILE_DEFAULT;
 
     pNetwork->connect = iot_tls_connect;
     pNetwork->read = iot_tls_read;
+    pNetwork->readAvailable = iot_tls_read_available;
+    pNetwork->waitForReadable = iot_tls_wait_for_readable;
     pNetwork->write = iot_tls_write;
     pNetwork->disconnect = iot_tls_disconnect;
     pNetwork->isConnected = iot_tls_is_connected;
     pNetwork->destroy = iot_tls_destroy;
 
     pNetwork->tlsDataParams.flags = 0;
+    pNetwork->tlsDataParams.isConfigLoaded = false;
+    mbedtls_ssl_init(&(pNetwork->tlsDataParams.ssl));
+    mbedtls_ssl_session_init(&(pNetwork->tlsDataParams.savedSession));
+    pNetwork->tlsDataParams.isSessionSaved = false;
+    pNetwork->tlsDataParams.isSessionResumed = false;
+    pNetwork->tlsDataParams.pSessionHost = NULL;
+    pNetwork->tlsDataParams.sessionPort = 0;
+    init_timer(&(pNetwork->tlsDataParams.sessionExpiry));
+    _iot_tls_open_wake_socket(pNetwork);
 
     return SUCCESS;
 }
 
-IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
-    /* Use this to add implementation which can check for physical layer disconnect */
-    return NETWORK_PHYSICAL_LAYER_CONNECTED;
+static void _iot_tls_forget_session(TLSDataParams *tlsDataParams) {
+    if(tlsDataParams->isSessionSaved) {
+        mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+        tlsDataParams->isSessionSaved = false;
+    }
 }
 
-IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
-    int ret = SUCCESS;
-    TLSDataParams *tlsDataParams = NULL;
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+/*
+ * Offer the saved session to the handshake about to start, unless it expired
+ * or was negotiated with another endpoint.
+ */
+static void _iot_tls_offer_session(Network *pNetwork) {
+    TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+    int ret;
+
+    tlsDataParams->isSessionResumed = false;
+    if(!tlsDataParams->isSessionSaved) {
+        return;
+    }
+
+    if(has_timer_expired(&(tlsDataParams->sessionExpiry))
+       || tlsDataParams->sessionPort != pNetwork->tlsConnectParams.DestinationPort
+       || 0 != strcmp(tlsDataParams->pSessionHost, pNetwork->tlsConnectParams.pDestinationURL)) {
+        ESP_LOGD(TAG, "Saved TLS session expired or belongs to another endpoint, doing a full handshake");
+        _iot_tls_forget_session(tlsDataParams);
+        return;
+    }
+
+    if((ret = mbedtls_ssl_set_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) != 0) {
+        ESP_LOGW(TAG, "mbedtls_ssl_set_session returned -0x%x, doing a full handshake", -ret);
+        _iot_tls_forget_session(tlsDataParams);
+    }
+}
+
+/*
+ * Keep the session of a successful handshake for the next connect.
+ *
+ * A resumed session keeps the expiry of the full handshake it came from, so
+ * one master secret is not used for longer than the configured lifetime.
+ */
+static void _iot_tls_save_session(Network *pNetwork) {
+    TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+    uint32_t lifetime_sec = AWS_IOT_TLS_SESSION_LIFETIME_SEC;
+    int ret;
+
+    /* Resumption carries the master secret over, a full handshake derives a new one */
+    tlsDataParams->isSessionResumed = tlsDataParams->isSessionSaved
+        && 0 == memcmp(tlsDataParams->ssl.session->master, tlsDataParams->savedSession.master,
+                       sizeof(tlsDataParams->savedSession.master));
+
+    _iot_tls_forget_session(tlsDataParams);
+    if((ret = mbedtls_ssl_get_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) != 0) {
+        ESP_LOGW(TAG, "mbedtls_ssl_get_session returned -0x%x, next connect does a full handshake", -ret);
+        mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+        return;
+    }
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    if(NULL != tlsDataParams->savedSession.ticket && 0 < tlsDataParams->savedSession.ticket_lifetime
+       && tlsDataParams->savedSession.ticket_lifetime < lifetime_sec) {
+        lifetime_sec = tlsDataParams->savedSession.ticket_lifetime;
+    }
+    if(0 == tlsDataParams->savedSession.id_len && NULL == tlsDataParams->savedSession.ticket) {
+#else
+    if(0 == tlsDataParams->savedSession.id_len) {
+#endif
+        /* Server gave neither a session ID nor a ticket */
+        mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+        return;
+    }
+
+    if(!tlsDataParams->isSessionResumed || lifetime_sec * 1000 < left_ms(&(tlsDataParams->sessionExpiry))) {
+        countdown_sec(&(tlsDataParams->sessionExpiry), lifetime_sec);
+    }
+    tlsDataParams->pSessionHost = pNetwork->tlsConnectParams.pDestinationURL;
+    tlsDataParams->sessionPort = pNetwork->tlsConnectParams.DestinationPort;
+    tlsDataParams->isSessionSaved = true;
+}
+#endif
+
+/*
+ * Start a non-blocking TCP connect to one endpoint of the list.
+ *
+ * Returns the socket, or -1 with *pRet set to the mbedtls error.
+ */
+static int _iot_tls_start_endpoint(const TLSEndpoint *pEndpoint, int *pRet) {
+    struct addrinfo hints;
+    struct addrinfo *pAddrList = NULL;
+    struct addrinfo *pAddr;
     char portBuffer[6];
-    char info_buf[256];
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    snprintf(portBuffer, sizeof(portBuffer), "%d", pEndpoint->DestinationPort);
+    if(dns_cache_getaddrinfo(pEndpoint->pDestinationURL, portBuffer, &hints, &pAddrList) != 0 || NULL == pAddrList) {
+        ESP_LOGW(TAG, "Endpoint %s unknown", pEndpoint->pDestinationURL);
+        *pRet = MBEDTLS_ERR_NET_UNKNOWN_HOST;
+        return -1;
+    }
 
-    if(NULL == pNetwork) {
-        return NULL_VALUE_ERROR;
+    *pRet = MBEDTLS_ERR_NET_SOCKET_FAILED;
+    for(pAddr = pAddrList; NULL != pAddr; pAddr = pAddr->ai_next) {
+        fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+        if(fd < 0) {
+            continue;
+        }
+        if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == 0 &&
+           (connect(fd, pAddr->ai_addr, pAddr->ai_addrlen) == 0 || EINPROGRESS == errno)) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+        *pRet = MBEDTLS_ERR_NET_CONNECT_FAILED;
     }
+    freeaddrinfo(pAddrList);
 
-    if(NULL != params) {
-        _iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
-                                    params->pDevicePrivateKeyLocation, params->pDestinationURL,
-                                    params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+    ESP_LOGD(TAG, "Connecting to %s/%s...", pEndpoint->pDestinationURL, portBuffer);
+    return fd;
+}
+
+/* Rank of an endpoint in the race order, the time of its last connect or last of all if none */
+static uint32_t _iot_tls_endpoint_rank(const TLSEndpoint *pEndpoint) {
+    return (0 == pEndpoint->lastConnectMs) ? UINT32_MAX : pEndpoint->lastConnectMs;
+}
+
+/*
+ * Order in which the endpoints of a race start: the winner of the last race,
+ * then the others by the time their last connect took. Those that never
+ * connected come last, in the order of the list.
+ */
+static void _iot_tls_order_endpoints(const TLSConnectParams *pParams, uint8_t count, uint8_t *pOrder) {
+    uint8_t i, j;
+    uint8_t ordered = 1;
+
+    pOrder[0] = pParams->preferredEndpoint;
+    for(i = 0; i < count; i++) {
+        if(i == pParams->preferredEndpoint) {
+            continue;
+        }
+        for(j = ordered; 1 < j && _iot_tls_endpoint_rank(&(pParams->pEndpoints[pOrder[j - 1]]))
+                > _iot_tls_endpoint_rank(&(pParams->pEndpoints[i])); j--) {
+            pOrder[j] = pOrder[j - 1];
+        }
+        pOrder[j] = i;
+        ordered++;
     }
+}
 
-    tlsDataParams = &(pNetwork->tlsDataParams);
+/*
+ * Race the TCP connects of the endpoint list, the first one to complete wins.
+ *
+ * Endpoints start in the order of _iot_tls_order_endpoints, each one
+ * endpointRaceDelay_ms after the one before, or at once when an earlier one
+ * fails. All lookups go out to the DNS cache with the race, so a later
+ * endpoint only waits for what is left of its lookup once its head start is
+ * over.
+ * Only the winner gets a TLS handshake, two handshakes in parallel would need
+ * a second mbedtls context and double the peak heap. On success the winner is
+ * made the preferred endpoint and copied to pDestinationURL/DestinationPort
+ * so that SNI and ALPN apply to it.
+ */
+static int _iot_tls_race_endpoints(TLSConnectParams *pParams, mbedtls_net_context *pServerFd) {
+    int fds[IOT_TLS_MAX_RACED_ENDPOINTS];
+    uint8_t order[IOT_TLS_MAX_RACED_ENDPOINTS];
+    uint8_t count = MIN(pParams->endpointCount, IOT_TLS_MAX_RACED_ENDPOINTS);
+    uint8_t started = 0;
+    uint8_t i;
+    int winner = -1;
+    int ret = MBEDTLS_ERR_NET_CONNECT_FAILED;
+    int maxFd, soError;
+    socklen_t soErrorLen;
+    uint32_t waitMs;
+    fd_set writeFds;
+    struct timeval tv;
+    Timer raceTimer, nextTimer;
+
+    if(pParams->preferredEndpoint >= count) {
+        pParams->preferredEndpoint = 0;
+    }
+
+    init_timer(&raceTimer);
+    countdown_ms(&raceTimer, pParams->timeout_ms);
+    init_timer(&nextTimer);
+
+    _iot_tls_order_endpoints(pParams, count, order);
+    for(i = 1; i < count; i++) {
+        (void)dns_cache_prefetch(pParams->pEndpoints[order[i]].pDestinationURL);
+    }
+
+    while(winner < 0 && !has_timer_expired(&raceTimer)) {
+        if(started < count && has_timer_expired(&nextTimer)) {
+            fds[started] = _iot_tls_start_endpoint(&(pParams->pEndpoints[order[started]]), &ret);
+            started++;
+            if(fds[started - 1] >= 0) {
+                countdown_ms(&nextTimer, pParams->endpointRaceDelay_ms);
+            } else {
+                init_timer(&nextTimer);
+            }
+            continue;
+        }
+
+        FD_ZERO(&writeFds);
+        maxFd = -1;
+        for(i = 0; i < started; i++) {
+            if(fds[i] >= 0) {
+                FD_SET(fds[i], &writeFds);
+                maxFd = MAX(maxFd, fds[i]);
+            }
+        }
+        if(maxFd < 0) {
+            if(started == count) {
+                break;
+            }
+            continue;
+        }
+
+        waitMs = left_ms(&raceTimer);
+        if(started < count) {
+            waitMs = MIN(waitMs, left_ms(&nextTimer));
+        }
+        tv.tv_sec = waitMs / 1000;
+        tv.tv_usec = (waitMs % 1000) * 1000;
+        if(select(maxFd + 1, NULL, &writeFds, NULL, &tv) < 0) {
+            if(EINTR == errno) {
+                continue;
+            }
+            break;
+        }
+
+        for(i = 0; i < started && winner < 0; i++) {
+            if(fds[i] < 0 || !FD_ISSET(fds[i], &writeFds)) {
+                continue;
+            }
+            soError = 0;
+            soErrorLen = sizeof(soError);
+            if(getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &soError, &soErrorLen) == 0 && 0 == soError) {
+                winner = i;
+            } else {
+                close(fds[i]);
+                fds[i] = -1;
+                ret = MBEDTLS_ERR_NET_CONNECT_FAILED;
+                /* Don't keep the next endpoint waiting for a head start on a failed one */
+                init_timer(&nextTimer);
+            }
+        }
+    }
+
+    for(i = 0; i < started; i++) {
+        if(fds[i] >= 0 && i != winner) {
+            close(fds[i]);
+        }
+    }
+    if(winner < 0) {
+        return ret;
+    }
+
+    pServerFd->fd = fds[winner];
+    pParams->preferredEndpoint = order[winner];
+    pParams->pDestinationURL = pParams->pEndpoints[pParams->preferredEndpoint].pDestinationURL;
+    pParams->DestinationPort = pParams->pEndpoints[pParams->preferredEndpoint].DestinationPort;
+    ESP_LOGD(TAG, "Endpoint %s won the connect race", pParams->pDestinationURL);
+
+    return 0;
+}
+
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+/*
+ * Sleep in select until the socket is ready for what mbedtls asked for with
+ * want (MBEDTLS_ERR_SSL_WANT_READ or _WRITE), or the timer expires.
+ *
+ * Returns 0 once ready, MBEDTLS_ERR_SSL_TIMEOUT or MBEDTLS_ERR_NET_POLL_FAILED.
+ */
+static int _iot_tls_wait(TLSDataParams *tlsDataParams, int want, Timer *timer) {
+    int ret = mbedtls_net_poll(&(tlsDataParams->server_fd),
+                               (MBEDTLS_ERR_SSL_WANT_WRITE == want) ? MBEDTLS_NET_POLL_WRITE : MBEDTLS_NET_POLL_READ,
+                               left_ms(timer));
+    if(ret > 0) {
+        return 0;
+    }
+    return (0 == ret) ? MBEDTLS_ERR_SSL_TIMEOUT : ret;
+}
+#endif
+
+/*
+ * Parse a certificate from a file, from a NUL terminated PEM string or, with
+ * len set, from PEM or DER in memory.
+ *
+ * DER may hold several certificates back to back. It needs no base64 decoding
+ * and, where mbedTLS allows it, is referenced in place instead of copied to
+ * the heap, so it has to outlive the config.
+ */
+static int _iot_tls_parse_crt(mbedtls_x509_crt *pCrt, const char *pLocation, size_t len) {
+    const unsigned char *pDer = (const unsigned char *) pLocation;
+    unsigned char *p;
+    size_t crtLen;
+    int ret;
+
+    if(0 == len) {
+        if('/' == pLocation[0]) {
+            return mbedtls_x509_crt_parse_file(pCrt, pLocation);
+        }
+        return mbedtls_x509_crt_parse(pCrt, pDer, strlen(pLocation) + 1);
+    }
+
+    if((MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE) != pDer[0]) {
+        /* PEM, len includes the terminating NUL */
+        return mbedtls_x509_crt_parse(pCrt, pDer, len);
+    }
+
+    while(0 < len) {
+        p = (unsigned char *) pDer;
+        if((ret = mbedtls_asn1_get_tag(&p, pDer + len, &crtLen,
+                                       MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE)) != 0) {
+            return ret;
+        }
+        crtLen += (size_t) (p - pDer);
+#if MBEDTLS_VERSION_NUMBER >= 0x02110000
+        ret = mbedtls_x509_crt_parse_der_nocopy(pCrt, pDer, crtLen);
+#else
+        ret = mbedtls_x509_crt_parse_der(pCrt, pDer, crtLen);
+#endif
+        if(0 != ret) {
+            return ret;
+        }
+        pDer += crtLen;
+        len -= crtLen;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse a private key from a file, from a NUL terminated PEM string or, with
+ * len set, from PEM or DER in memory.
+ */
+static int _iot_tls_parse_key(mbedtls_pk_context *pKey, const char *pLocation, size_t len) {
+    if(0 == len) {
+        if('/' == pLocation[0]) {
+            return mbedtls_pk_parse_keyfile(pKey, pLocation, "");
+        }
+        len = strlen(pLocation) + 1;
+    }
+
+    return mbedtls_pk_parse_key(pKey, (const unsigned char *) pLocation, len, (const unsigned char *) "", 0);
+}
+
+static void _iot_tls_free_config(TLSDataParams *tlsDataParams) {
+    mbedtls_x509_crt_free(&(tlsDataParams->clicert));
+    mbedtls_x509_crt_free(&(tlsDataParams->cacert));
+    mbedtls_pk_free(&(tlsDataParams->pkey));
+    mbedtls_ssl_config_free(&(tlsDataParams->conf));
+    mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
+    mbedtls_entropy_free(&(tlsDataParams->entropy));
+    tlsDataParams->isConfigLoaded = false;
+}
+
+/*
+ * Seed the random number generator, parse the credentials and build the TLS
+ * config. Done by the first connect only, later connects and reconnects
+ * reference the result and set up nothing but a fresh ssl context.
+ */
+static IoT_Error_t _iot_tls_load_config(Network *pNetwork) {
+    int ret = SUCCESS;
+    TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
-    mbedtls_net_init(&(tlsDataParams->server_fd));
-    mbedtls_ssl_init(&(tlsDataParams->ssl));
     mbedtls_ssl_config_init(&(tlsDataParams->conf));
 
 #ifdef CONFIG_MBEDTLS_DEBUG
@@ -135,6 +608,7 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
     if((ret = mbedtls_ctr_drbg_seed(&(tlsDataParams->ctr_drbg), mbedtls_entropy_func, &(tlsDataParams->entropy),
                                     (const unsigned char *) TAG, strlen(TAG))) != 0) {
         ESP_LOGE(TAG, "failed! mbedtls_ctr_drbg_seed returned -0x%x", -ret);
+        _iot_tls_free_config(tlsDataParams);
         return NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
     }
 
@@ -144,17 +618,13 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
        very basic heuristic: if the cert starts with '/' then it's a
        path, if it's longer than this then it's raw cert data (PEM or DER,
        neither of which can start with a slash. */
-    if (pNetwork->tlsConnectParams.pRootCALocation[0] == '/') {
-        ESP_LOGD(TAG, "Loading CA root certificate from file ...");
-        ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->cacert), pNetwork->tlsConnectParams.pRootCALocation);
-    } else {
-        ESP_LOGD(TAG, "Loading embedded CA root certificate ...");
-        ret = mbedtls_x509_crt_parse(&(tlsDataParams->cacert), (const unsigned char *)pNetwork->tlsConnectParams.pRootCALocation,
-                                 strlen(pNetwork->tlsConnectParams.pRootCALocation)+1);
-    }
+    ESP_LOGD(TAG, "Loading CA root certificate ...");
+    ret = _iot_tls_parse_crt(&(tlsDataParams->cacert), pNetwork->tlsConnectParams.pRootCALocation,
+                             pNetwork->tlsConnectParams.rootCALen);
 
     if(ret < 0) {
         ESP_LOGE(TAG, "failed!  mbedtls_x509_crt_parse returned -0x%x while parsing root cert", -ret);
+        _iot_tls_free_config(tlsDataParams);
         return NETWORK_X509_ROOT_CRT_PARSE_ERROR;
     }
     ESP_LOGD(TAG, "ok (%d skipped)", ret);
@@ -172,18 +642,14 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
         }
     } else
 #endif
-    if (pNetwork->tlsConnectParams.pDeviceCertLocation[0] == '/') {
-        ESP_LOGD(TAG, "Loading client cert from file...");
-        ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->clicert),
-                                          pNetwork->tlsConnectParams.pDeviceCertLocation);
-    } else {
-        ESP_LOGD(TAG, "Loading embedded client certificate...");
-        ret = mbedtls_x509_crt_parse(&(tlsDataParams->clicert),
-                                     (const unsigned char *)pNetwork->tlsConnectParams.pDeviceCertLocation,
-                                     strlen(pNetwork->tlsConnectParams.pDeviceCertLocation)+1);
+    {
+        ESP_LOGD(TAG, "Loading client certificate...");
+        ret = _iot_tls_parse_crt(&(tlsDataParams->clicert), pNetwork->tlsConnectParams.pDeviceCertLocation,
+                                 pNetwork->tlsConnectParams.deviceCertLen);
     }
     if(ret != 0) {
         ESP_LOGE(TAG, "failed!  mbedtls_x509_crt_parse returned -0x%x while parsing device cert", -ret);
+        _iot_tls_free_config(tlsDataParams);
         return NETWORK_X509_DEVICE_CRT_PARSE_ERROR;
     }
 
@@ -203,29 +669,137 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
         }
     } else
 #endif
-    if (pNetwork->tlsConnectParams.pDevicePrivateKeyLocation[0] == '/') {
-        ESP_LOGD(TAG, "Loading client private key from file...");
-        ret = mbedtls_pk_parse_keyfile(&(tlsDataParams->pkey),
-                                       pNetwork->tlsConnectParams.pDevicePrivateKeyLocation,
-                                       "");
-    } else {
-        ESP_LOGD(TAG, "Loading embedded client private key...");
-        ret = mbedtls_pk_parse_key(&(tlsDataParams->pkey),
-                                   (const unsigned char *)pNetwork->tlsConnectParams.pDevicePrivateKeyLocation,
-                                   strlen(pNetwork->tlsConnectParams.pDevicePrivateKeyLocation)+1,
-                                   (const unsigned char *)"", 0);
+    {
+        ESP_LOGD(TAG, "Loading client private key...");
+        ret = _iot_tls_parse_key(&(tlsDataParams->pkey), pNetwork->tlsConnectParams.pDevicePrivateKeyLocation,
+                                 pNetwork->tlsConnectParams.devicePrivateKeyLen);
     }
     if(ret != 0) {
         ESP_LOGE(TAG, "failed!  mbedtls_pk_parse_key returned -0x%x while parsing private key", -ret);
+        _iot_tls_free_config(tlsDataParams);
         return NETWORK_PK_PRIVATE_KEY_PARSE_ERROR;
     }
 
     /* Done parsing certs */
     ESP_LOGD(TAG, "ok");
-    snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
-    ESP_LOGD(TAG, "Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
-    if((ret = mbedtls_net_connect(&(tlsDataParams->server_fd), pNetwork->tlsConnectParams.pDestinationURL,
-                                  portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
+
+    if((ret = mbedtls_ssl_config_defaults(&(tlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+        ESP_LOGE(TAG, "failed! mbedtls_ssl_config_defaults returned -0x%x", -ret);
+        _iot_tls_free_config(tlsDataParams);
+        return SSL_CONNECTION_ERROR;
+    }
+
+    mbedtls_ssl_conf_verify(&(tlsDataParams->conf), _iot_tls_verify_cert, NULL);
+    mbedtls_ssl_conf_rng(&(tlsDataParams->conf), mbedtls_ctr_drbg_random, &(tlsDataParams->ctr_drbg));
+
+    mbedtls_ssl_conf_ca_chain(&(tlsDataParams->conf), &(tlsDataParams->cacert), NULL);
+    ret = mbedtls_ssl_conf_own_cert(&(tlsDataParams->conf), &(tlsDataParams->clicert), &(tlsDataParams->pkey));
+    if(ret != 0) {
+        ESP_LOGE(TAG, "failed! mbedtls_ssl_conf_own_cert returned %d", ret);
+        _iot_tls_free_config(tlsDataParams);
+        return SSL_CONNECTION_ERROR;
+    }
+
+#if !defined(DISABLE_IOT_TLS_SESSION_RESUMPTION) && defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&(tlsDataParams->conf), MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    tlsDataParams->isConfigLoaded = true;
+
+    return SUCCESS;
+}
+
+IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
+    /* Use this to add implementation which can check for physical layer disconnect */
+    return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
+    int ret = SUCCESS;
+    TLSDataParams *tlsDataParams = NULL;
+    char portBuffer[6];
+    char info_buf[256];
+    size_t inLen, outLen;
+    Timer connectStopwatch;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+    TLSEndpoint endpoint;
+    TLSConnectParams singleEndpoint;
+    Timer handshakeTimer;
+#else
+    ip_addr_t hostAddr;
+    char hostBuffer[IPADDR_STRLEN_MAX];
+#endif
+
+    if(NULL == pNetwork) {
+        return NULL_VALUE_ERROR;
+    }
+
+    tlsDataParams = &(pNetwork->tlsDataParams);
+
+    if(NULL != params) {
+        if(tlsDataParams->isConfigLoaded
+           && (params->pRootCALocation != pNetwork->tlsConnectParams.pRootCALocation
+               || params->pDeviceCertLocation != pNetwork->tlsConnectParams.pDeviceCertLocation
+               || params->pDevicePrivateKeyLocation != pNetwork->tlsConnectParams.pDevicePrivateKeyLocation
+               || params->rootCALen != pNetwork->tlsConnectParams.rootCALen
+               || params->deviceCertLen != pNetwork->tlsConnectParams.deviceCertLen
+               || params->devicePrivateKeyLen != pNetwork->tlsConnectParams.devicePrivateKeyLen)) {
+            /* New credentials, parse them again and do not resume a session made with the old ones */
+            _iot_tls_free_config(tlsDataParams);
+            _iot_tls_forget_session(tlsDataParams);
+        }
+        if(params->tlsProfile != pNetwork->tlsConnectParams.tlsProfile) {
+            /* The saved session may use a suite the new profile does not offer */
+            _iot_tls_forget_session(tlsDataParams);
+        }
+        _iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
+                                    params->pDevicePrivateKeyLocation, params->pDestinationURL,
+                                    params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+        pNetwork->tlsConnectParams.rootCALen = params->rootCALen;
+        pNetwork->tlsConnectParams.deviceCertLen = params->deviceCertLen;
+        pNetwork->tlsConnectParams.devicePrivateKeyLen = params->devicePrivateKeyLen;
+        pNetwork->tlsConnectParams.tlsProfile = params->tlsProfile;
+    }
+
+    if(!tlsDataParams->isConfigLoaded) {
+        ret = _iot_tls_load_config(pNetwork);
+        if(SUCCESS != ret) {
+            return (IoT_Error_t) ret;
+        }
+    }
+
+    mbedtls_net_init(&(tlsDataParams->server_fd));
+    mbedtls_ssl_init(&(tlsDataParams->ssl));
+
+    init_timer(&connectStopwatch);
+    countdown_ms(&connectStopwatch, 0);
+    if(0 < pNetwork->tlsConnectParams.endpointCount) {
+        ret = _iot_tls_race_endpoints(&(pNetwork->tlsConnectParams), &(tlsDataParams->server_fd));
+    } else {
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        /* A race of one, so the TCP connect waits in select for no longer than timeout_ms */
+        endpoint.pDestinationURL = pNetwork->tlsConnectParams.pDestinationURL;
+        endpoint.DestinationPort = pNetwork->tlsConnectParams.DestinationPort;
+        endpoint.lastConnectMs = 0;
+        singleEndpoint = pNetwork->tlsConnectParams;
+        singleEndpoint.pEndpoints = &endpoint;
+        singleEndpoint.endpointCount = 1;
+        singleEndpoint.preferredEndpoint = 0;
+        ret = _iot_tls_race_endpoints(&singleEndpoint, &(tlsDataParams->server_fd));
+#else
+        snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
+        ESP_LOGD(TAG, "Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
+        /* Connect to the cached address, SNI and the certificate check still go by the host name */
+        if(ESP_OK != dns_cache_resolve(pNetwork->tlsConnectParams.pDestinationURL, &hostAddr)
+           || NULL == ipaddr_ntoa_r(&hostAddr, hostBuffer, sizeof(hostBuffer))) {
+            ret = MBEDTLS_ERR_NET_UNKNOWN_HOST;
+        } else {
+            ret = mbedtls_net_connect(&(tlsDataParams->server_fd), hostBuffer, portBuffer, MBEDTLS_NET_PROTO_TCP);
+        }
+#endif
+    }
+    if(ret != 0) {
         ESP_LOGE(TAG, "failed! mbedtls_net_connect returned -0x%x", -ret);
         switch(ret) {
             case MBEDTLS_ERR_NET_SOCKET_FAILED:
@@ -238,45 +812,67 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
         };
     }
 
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+    ret = mbedtls_net_set_nonblock(&(tlsDataParams->server_fd));
+#else
     ret = mbedtls_net_set_block(&(tlsDataParams->server_fd));
+#endif
     if(ret != 0) {
         ESP_LOGE(TAG, "failed! net_set_(non)block() returned -0x%x", -ret);
         return SSL_CONNECTION_ERROR;
     } ESP_LOGD(TAG, "ok");
 
+    /* The config is shared by every connect, set what depends on this one */
     ESP_LOGD(TAG, "Setting up the SSL/TLS structure...");
-    if((ret = mbedtls_ssl_config_defaults(&(tlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-                                          MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
-        ESP_LOGE(TAG, "failed! mbedtls_ssl_config_defaults returned -0x%x", -ret);
-        return SSL_CONNECTION_ERROR;
-    }
-
-    mbedtls_ssl_conf_verify(&(tlsDataParams->conf), _iot_tls_verify_cert, NULL);
-
     if(pNetwork->tlsConnectParams.ServerVerificationFlag == true) {
         mbedtls_ssl_conf_authmode(&(tlsDataParams->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
     } else {
         mbedtls_ssl_conf_authmode(&(tlsDataParams->conf), MBEDTLS_SSL_VERIFY_OPTIONAL);
     }
-    mbedtls_ssl_conf_rng(&(tlsDataParams->conf), mbedtls_ctr_drbg_random, &(tlsDataParams->ctr_drbg));
 
-    mbedtls_ssl_conf_ca_chain(&(tlsDataParams->conf), &(tlsDataParams->cacert), NULL);
-    ret = mbedtls_ssl_conf_own_cert(&(tlsDataParams->conf), &(tlsDataParams->clicert), &(tlsDataParams->pkey));
-    if(ret != 0) {
-        ESP_LOGE(TAG, "failed! mbedtls_ssl_conf_own_cert returned %d", ret);
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
+    mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+#endif
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    /* The lean profile asks for short records, a server may ignore it and keep sending full ones */
+    if((ret = mbedtls_ssl_conf_max_frag_len(&(tlsDataParams->conf),
+                                            (pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_LEAN) ?
+                                            IOT_TLS_MFL_CODE : MBEDTLS_SSL_MAX_FRAG_LEN_NONE)) != 0) {
+        ESP_LOGE(TAG, "failed! mbedtls_ssl_conf_max_frag_len returned -0x%x", -ret);
         return SSL_CONNECTION_ERROR;
     }
+#else
+    if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_LEAN) {
+        ESP_LOGW(TAG, "Lean TLS profile needs CONFIG_MBEDTLS_SSL_MAX_FRAGMENT_LENGTH, using full records");
+    }
+#endif
 
-    mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+#ifdef IOT_TLS_FAST_HANDSHAKE_SUPPORTED
+    /* Suites and curves of the last connect stay in the shared config, put the defaults back without the profile */
+    if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_FAST_HANDSHAKE) {
+        mbedtls_ssl_conf_ciphersuites(&(tlsDataParams->conf), fastHandshakeCiphersuites);
+        mbedtls_ssl_conf_curves(&(tlsDataParams->conf), fastHandshakeCurves);
+    } else {
+        mbedtls_ssl_conf_ciphersuites(&(tlsDataParams->conf), mbedtls_ssl_list_ciphersuites());
+        mbedtls_ssl_conf_curves(&(tlsDataParams->conf), mbedtls_ecp_grp_id_list());
+    }
+#else
+    if(pNetwork->tlsConnectParams.tlsProfile & IOT_TLS_PROFILE_FAST_HANDSHAKE) {
+        ESP_LOGW(TAG, "Fast handshake TLS profile needs ECDHE with AES-GCM or ChaCha20-Poly1305 and X25519 or P-256, using the defaults");
+    }
+#endif
 
 #ifdef CONFIG_MBEDTLS_SSL_ALPN
     /* Use the AWS IoT ALPN extension for MQTT, if port 443 is requested */
     if (pNetwork->tlsConnectParams.DestinationPort == 443) {
-        const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
         if ((ret = mbedtls_ssl_conf_alpn_protocols(&(tlsDataParams->conf), alpnProtocols)) != 0) {
             ESP_LOGE(TAG, "failed! mbedtls_ssl_conf_alpn_protocols returned -0x%x", -ret);
             return SSL_CONNECTION_ERROR;
         }
+    } else {
+        /* Left over from a connect to another endpoint of the list */
+        tlsDataParams->conf.alpn_list = NULL;
     }
 #endif
 
@@ -288,20 +884,46 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
         ESP_LOGE(TAG, "failed! mbedtls_ssl_set_hostname returned %d", ret);
         return SSL_CONNECTION_ERROR;
     }
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+    _iot_tls_offer_session(pNetwork);
+#endif
     ESP_LOGD(TAG, "SSL state connect : %d ", tlsDataParams->ssl.state);
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+    /* mbedtls never waits itself, every WANT_READ and WANT_WRITE is waited out in select against a timer */
+    mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, mbedtls_net_recv,
+                        NULL);
+    init_timer(&handshakeTimer);
+    countdown_ms(&handshakeTimer, pNetwork->tlsConnectParams.timeout_ms);
+#else
     mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, NULL,
                         mbedtls_net_recv_timeout);
+#endif
     ESP_LOGD(TAG, "ok");
 
     ESP_LOGD(TAG, "SSL state connect : %d ", tlsDataParams->ssl.state);
     ESP_LOGD(TAG, "Performing the SSL/TLS handshake...");
     while((ret = mbedtls_ssl_handshake(&(tlsDataParams->ssl))) != 0) {
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        if(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ret = _iot_tls_wait(tlsDataParams, ret, &handshakeTimer);
+            if(0 == ret) {
+                continue;
+            }
+        }
+#endif
         if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
             ESP_LOGE(TAG, "failed! mbedtls_ssl_handshake returned -0x%x", -ret);
             if(ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
                 ESP_LOGE(TAG, "    Unable to verify the server's certificate. ");
             }
-            return SSL_CONNECTION_ERROR;
+            /* The server may have refused the offered session, do not offer it again */
+            _iot_tls_forget_session(tlsDataParams);
+            if(0 < pNetwork->tlsConnectParams.endpointCount) {
+                /* Accepts TCP but not TLS, lead with the next endpoint on the next attempt */
+                pNetwork->tlsConnectParams.preferredEndpoint =
+                    (pNetwork->tlsConnectParams.preferredEndpoint + 1) % pNetwork->tlsConnectParams.endpointCount;
+            }
+            return (MBEDTLS_ERR_SSL_TIMEOUT == ret) ? NETWORK_SSL_CONNECT_TIMEOUT_ERROR : SSL_CONNECTION_ERROR;
         }
     }
 
@@ -312,6 +934,8 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
     } else {
         ESP_LOGD(TAG, "    [ Record expansion is unknown (compression) ]");
     }
+    iot_tls_get_record_buffer_len(pNetwork, &inLen, &outLen);
+    ESP_LOGD(TAG, "    [ Record buffers are %u bytes in, %u bytes out ]", (unsigned) inLen, (unsigned) outLen);
 
     ESP_LOGD(TAG, "Verifying peer X.509 certificate...");
 
@@ -338,37 +962,56 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
         }
     }
 
+    if(SUCCESS == ret && 0 < pNetwork->tlsConnectParams.endpointCount) {
+        pNetwork->tlsConnectParams.pEndpoints[pNetwork->tlsConnectParams.preferredEndpoint].lastConnectMs =
+            elapsed_ms(&connectStopwatch);
+    }
+
+    if(SUCCESS != ret) {
+        _iot_tls_forget_session(tlsDataParams);
+    }
+#ifndef DISABLE_IOT_TLS_SESSION_RESUMPTION
+    else {
+        _iot_tls_save_session(pNetwork);
+        ESP_LOGD(TAG, "Connected in %u ms with a %s handshake",
+                 (unsigned) elapsed_ms(&connectStopwatch),
+                 tlsDataParams->isSessionResumed ? "resumed" : "full");
+    }
+#endif
+
     return (IoT_Error_t) ret;
 }
 
 IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
-    size_t written_so_far;
+    size_t written_so_far = 0;
     bool isErrorFlag = false;
-    int frags, ret = 0;
+    int ret = 0;
     TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
-    for(written_so_far = 0, frags = 0;
-        written_so_far < len && !has_timer_expired(timer); written_so_far += ret, frags++) {
-        while(!has_timer_expired(timer) &&
-              (ret = mbedtls_ssl_write(&(tlsDataParams->ssl), pMsg + written_so_far, len - written_so_far)) <= 0) {
-            if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
-                ESP_LOGE(TAG, "failed! mbedtls_ssl_write returned -0x%x", -ret);
-                /* All other negative return values indicate connection needs to be reset.
-                * Will be caught in ping request so ignored here */
-                isErrorFlag = true;
-                break;
-            }
+    /* Only bytes mbedtls took count as written, a WANT_WRITE at the deadline leaves them at what got through */
+    while(!isErrorFlag && written_so_far < len && !has_timer_expired(timer)) {
+        ret = mbedtls_ssl_write(&(tlsDataParams->ssl), pMsg + written_so_far, len - written_so_far);
+        if(ret > 0) {
+            written_so_far += ret;
+        } else if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "failed! mbedtls_ssl_write returned -0x%x", -ret);
+            /* All other negative return values indicate connection needs to be reset.
+            * Will be caught in ping request so ignored here */
+            isErrorFlag = true;
         }
-        if(isErrorFlag) {
-            break;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        else if(MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(tlsDataParams, ret, timer)) {
+            ESP_LOGE(TAG, "failed! select returned errno %d", errno);
+            isErrorFlag = true;
         }
+#endif
     }
 
     *written_len = written_so_far;
 
     if(isErrorFlag) {
         return NETWORK_SSL_WRITE_ERROR;
-    } else if(has_timer_expired(timer) && written_so_far != len) {
+    } else if(written_so_far != len) {
         return NETWORK_SSL_WRITE_TIMEOUT_ERROR;
     }
 
@@ -378,15 +1021,22 @@ IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Ti
 IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
     TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
     mbedtls_ssl_context *ssl = &(tlsDataParams->ssl);
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
     mbedtls_ssl_config *ssl_conf = &(tlsDataParams->conf);
     uint32_t read_timeout;
+#endif
     size_t rxLen = 0;
     int ret;
 
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
     read_timeout = ssl_conf->read_timeout;
+#endif
 
     while (len > 0) {
 
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        ret = mbedtls_ssl_read(ssl, pMsg, len);
+#else
         /* Make sure we never block on read for longer than timer has left,
          but also that we don't block indefinitely (ie read_timeout > 0) */
         mbedtls_ssl_conf_read_timeout(ssl_conf, MAX(1, MIN(read_timeout, left_ms(timer))));
@@ -395,6 +1045,7 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 
         /* Restore the old timeout */
         mbedtls_ssl_conf_read_timeout(ssl_conf, read_timeout);
+#endif
 
         if (ret > 0) {
             rxLen += ret;
@@ -403,6 +1054,12 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
         } else if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT)) {
             return NETWORK_SSL_READ_ERROR;
         }
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        else if (MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(tlsDataParams, ret, timer)) {
+            ESP_LOGE(TAG, "failed! select returned errno %d", errno);
+            return NETWORK_SSL_READ_ERROR;
+        }
+#endif
 
         // Evaluate timeout after the read to make sure read is done at least once
         if (has_timer_expired(timer)) {
@@ -422,11 +1079,137 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
     }
 }
 
+IoT_Error_t iot_tls_read_available(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+    TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+    mbedtls_ssl_context *ssl = &(tlsDataParams->ssl);
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
+    mbedtls_ssl_config *ssl_conf = &(tlsDataParams->conf);
+    uint32_t read_timeout;
+#endif
+    size_t rxLen = 0;
+    int ret;
+
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+    /* Only wait before the first read, and for no longer than the timer has left */
+    if (mbedtls_ssl_get_bytes_avail(ssl) == 0 &&
+        MBEDTLS_ERR_NET_POLL_FAILED == _iot_tls_wait(tlsDataParams, MBEDTLS_ERR_SSL_WANT_READ, timer)) {
+        ESP_LOGE(TAG, "failed! select returned errno %d", errno);
+        *read_len = 0;
+        return NETWORK_SSL_READ_ERROR;
+    }
+#else
+    read_timeout = ssl_conf->read_timeout;
+
+    /* Only the first read may block, and for no longer than the timer has left */
+    mbedtls_ssl_conf_read_timeout(ssl_conf, MAX(1, MIN(read_timeout, left_ms(timer))));
+#endif
+
+    do {
+        ret = mbedtls_ssl_read(ssl, pMsg + rxLen, len - rxLen);
+        if (ret > 0) {
+            rxLen += ret;
+        } else if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT)) {
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
+            mbedtls_ssl_conf_read_timeout(ssl_conf, read_timeout);
+#endif
+            *read_len = rxLen;
+            return NETWORK_SSL_READ_ERROR;
+        } else {
+            break;
+        }
+        /* Keep going while decrypted data or further records are already waiting */
+    } while (rxLen < len && (mbedtls_ssl_get_bytes_avail(ssl) > 0 ||
+             mbedtls_net_poll(&(tlsDataParams->server_fd), MBEDTLS_NET_POLL_READ, 0) > 0));
+
+#ifndef IOT_SSL_SOCKET_NON_BLOCKING
+    /* Restore the old timeout */
+    mbedtls_ssl_conf_read_timeout(ssl_conf, read_timeout);
+#endif
+
+    *read_len = rxLen;
+    return (rxLen > 0) ? SUCCESS : NETWORK_SSL_NOTHING_TO_READ;
+}
+
+IoT_Error_t iot_tls_wait_for_readable(Network *pNetwork, Timer *timer) {
+    TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+    int fd = tlsDataParams->server_fd.fd;
+    int wakeFd = tlsDataParams->wakeFd;
+    unsigned char drain[16];
+    uint32_t wait_ms;
+    struct timeval tv;
+    fd_set read_fds;
+    int ret;
+
+    /* Decrypted data never shows up on the socket again */
+    if (mbedtls_ssl_get_bytes_avail(&(tlsDataParams->ssl)) > 0) {
+        return SUCCESS;
+    }
+
+    wait_ms = left_ms(timer);
+    if (fd < 0 && wakeFd < 0) {
+        /* Not connected, nothing can arrive before the timer expires */
+        vTaskDelay(wait_ms / portTICK_PERIOD_MS);
+        return NETWORK_SSL_NOTHING_TO_READ;
+    }
+
+    FD_ZERO(&read_fds);
+    if (fd >= 0) {
+        FD_SET(fd, &read_fds);
+    }
+    if (wakeFd >= 0) {
+        FD_SET(wakeFd, &read_fds);
+    }
+    tv.tv_sec = wait_ms / 1000;
+    tv.tv_usec = (wait_ms % 1000) * 1000;
+
+    /* lwIP select blocks the task on a semaphore, no ticks are spent while idle */
+    ret = select(MAX(fd, wakeFd) + 1, &read_fds, NULL, NULL, &tv);
+    if (ret > 0 && wakeFd >= 0 && FD_ISSET(wakeFd, &read_fds)) {
+        /* Every wake-up so far is answered by this one */
+        while (recv(wakeFd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+        }
+    }
+    if (ret > 0 && fd >= 0 && FD_ISSET(fd, &read_fds)) {
+        return SUCCESS;
+    } else if (ret >= 0 || errno == EINTR) {
+        return NETWORK_SSL_NOTHING_TO_READ;
+    }
+
+    ESP_LOGE(TAG, "failed! select returned errno %d", errno);
+    return NETWORK_SSL_READ_ERROR;
+}
+
+IoT_Error_t iot_tls_wake_up(Network *pNetwork) {
+    const unsigned char wake = 0;
+
+    if (pNetwork->tlsDataParams.wakeFd < 0) {
+        return NETWORK_SSL_WRITE_ERROR;
+    }
+    /* EAGAIN or ENOMEM means wake-ups are queued that nobody read yet, one more adds nothing */
+    if (send(pNetwork->tlsDataParams.wakeFd, &wake, 1, 0) < 0 && EAGAIN != errno && ENOMEM != errno) {
+        return NETWORK_SSL_WRITE_ERROR;
+    }
+
+    return SUCCESS;
+}
+
 IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
     mbedtls_ssl_context *ssl = &(pNetwork->tlsDataParams.ssl);
     int ret = 0;
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+    Timer timer;
+
+    init_timer(&timer);
+    countdown_ms(&timer, IOT_SSL_CLOSE_NOTIFY_TIMEOUT);
+#endif
     do {
         ret = mbedtls_ssl_close_notify(ssl);
+#ifdef IOT_SSL_SOCKET_NON_BLOCKING
+        /* A full send buffer must not hold up the disconnect for longer than IOT_SSL_CLOSE_NOTIFY_TIMEOUT */
+        if(ret == MBEDTLS_ERR_SSL_WANT_WRITE && 0 != _iot_tls_wait(&(pNetwork->tlsDataParams), ret, &timer)) {
+            break;
+        }
+#endif
     } while(ret == MBEDTLS_ERR_SSL_WANT_WRITE);
 
     /* All other negative return values indicate connection needs to be reset.
@@ -439,14 +1222,57 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork) {
     TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
     mbedtls_net_free(&(tlsDataParams->server_fd));
-
-    mbedtls_x509_crt_free(&(tlsDataParams->clicert));
-    mbedtls_x509_crt_free(&(tlsDataParams->cacert));
-    mbedtls_pk_free(&(tlsDataParams->pkey));
     mbedtls_ssl_free(&(tlsDataParams->ssl));
-    mbedtls_ssl_config_free(&(tlsDataParams->conf));
-    mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
-    mbedtls_entropy_free(&(tlsDataParams->entropy));
+
+    /* The credentials, the config and the saved session outlive the connection, the next connect reuses them */
+
+    return SUCCESS;
+}
+
+IoT_Error_t iot_tls_free(Network *pNetwork) {
+    if(NULL == pNetwork) {
+        return NULL_VALUE_ERROR;
+    }
+
+    if(pNetwork->tlsDataParams.isConfigLoaded) {
+        _iot_tls_free_config(&(pNetwork->tlsDataParams));
+    }
+    _iot_tls_forget_session(&(pNetwork->tlsDataParams));
+    if (pNetwork->tlsDataParams.wakeFd >= 0) {
+        close(pNetwork->tlsDataParams.wakeFd);
+        pNetwork->tlsDataParams.wakeFd = -1;
+    }
+    pNetwork->wakeUp = NULL;
+
+    return SUCCESS;
+}
+
+IoT_Error_t iot_tls_get_record_buffer_len(Network *pNetwork, size_t *pInLen, size_t *pOutLen) {
+    mbedtls_ssl_context *ssl;
+
+    if(NULL == pNetwork || NULL == pInLen || NULL == pOutLen) {
+        return NULL_VALUE_ERROR;
+    }
+
+    /* Freed and zeroed by destroy, with CONFIG_MBEDTLS_DYNAMIC_BUFFER also between records */
+    ssl = &(pNetwork->tlsDataParams.ssl);
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    *pInLen = (NULL != ssl->in_buf) ? ssl->in_buf_len : 0;
+    *pOutLen = (NULL != ssl->out_buf) ? ssl->out_buf_len : 0;
+#else
+    *pInLen = (NULL != ssl->in_buf) ? MBEDTLS_SSL_IN_BUFFER_LEN : 0;
+    *pOutLen = (NULL != ssl->out_buf) ? MBEDTLS_SSL_OUT_BUFFER_LEN : 0;
+#endif
+
+    return SUCCESS;
+}
+
+IoT_Error_t iot_tls_forget_session(Network *pNetwork) {
+    if(NULL == pNetwork) {
+        return NULL_VALUE_ERROR;
+    }
+
+    _iot_tls_forget_session(&(pNetwork->tlsDataParams));
 
     return SUCCESS;
 }
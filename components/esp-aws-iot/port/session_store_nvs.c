@@ -0,0 +1,215 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * Additions Copyright 2016 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "aws_iot_session_store_nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const char *TAG = "aws_session_nvs";
+
+/* Packet ids in store order, each packet lives under its own "p<id>" key */
+#define SESSION_STORE_NVS_IDS_KEY "ids"
+
+static void session_store_nvs_key(char *pKey, size_t keyLen, uint16_t packetId) {
+    snprintf(pKey, keyLen, "p%04x", packetId);
+}
+
+static int session_store_nvs_find(IoT_Session_Store_Nvs *pNvs, uint16_t packetId) {
+    int i;
+
+    for (i = 0; i < pNvs->count; i++) {
+        if (pNvs->ids[i] == packetId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Writes the id list and commits everything changed before it */
+static esp_err_t session_store_nvs_commit_ids(IoT_Session_Store_Nvs *pNvs) {
+    esp_err_t err;
+
+    if (0 == pNvs->count) {
+        err = nvs_erase_key(pNvs->handle, SESSION_STORE_NVS_IDS_KEY);
+        if (ESP_ERR_NVS_NOT_FOUND == err) {
+            err = ESP_OK;
+        }
+    } else {
+        err = nvs_set_blob(pNvs->handle, SESSION_STORE_NVS_IDS_KEY, pNvs->ids, pNvs->count * sizeof(uint16_t));
+    }
+    if (ESP_OK == err) {
+        err = nvs_commit(pNvs->handle);
+    }
+    return err;
+}
+
+/* Drops an entry from the id list, the packet key must already be erased */
+static void session_store_nvs_drop(IoT_Session_Store_Nvs *pNvs, int index) {
+    memmove(&pNvs->ids[index], &pNvs->ids[index + 1], (pNvs->count - index - 1) * sizeof(uint16_t));
+    pNvs->count--;
+}
+
+static IoT_Error_t session_store_nvs_save(void *pContext, uint16_t packetId, const unsigned char *pPacket,
+                                          size_t packetLen) {
+    IoT_Session_Store_Nvs *pNvs = (IoT_Session_Store_Nvs *) pContext;
+    char key[8];
+    esp_err_t err;
+    int index;
+
+    aws_iot_thread_mutex_lock(&pNvs->lock);
+
+    index = session_store_nvs_find(pNvs, packetId);
+    if (index < 0 && AWS_IOT_SESSION_STORE_NVS_MAX_PACKETS <= pNvs->count) {
+        aws_iot_thread_mutex_unlock(&pNvs->lock);
+        return MQTT_SESSION_STORE_FULL_ERROR;
+    }
+
+    /* Packet first: after a power loss the id list never names a missing packet */
+    session_store_nvs_key(key, sizeof(key), packetId);
+    err = nvs_set_blob(pNvs->handle, key, pPacket, packetLen);
+    if (ESP_OK == err && index < 0) {
+        pNvs->ids[pNvs->count++] = packetId;
+        err = session_store_nvs_commit_ids(pNvs);
+        if (ESP_OK != err) {
+            pNvs->count--;
+        }
+    } else if (ESP_OK == err) {
+        err = nvs_commit(pNvs->handle);
+    }
+
+    aws_iot_thread_mutex_unlock(&pNvs->lock);
+
+    if (ESP_OK != err) {
+        ESP_LOGE(TAG, "Failed to store packet %u: %s", packetId, esp_err_to_name(err));
+        return (ESP_ERR_NVS_NOT_ENOUGH_SPACE == err) ? MQTT_SESSION_STORE_FULL_ERROR : FAILURE;
+    }
+    return SUCCESS;
+}
+
+static void session_store_nvs_remove(void *pContext, uint16_t packetId) {
+    IoT_Session_Store_Nvs *pNvs = (IoT_Session_Store_Nvs *) pContext;
+    char key[8];
+    esp_err_t err;
+    int index;
+
+    aws_iot_thread_mutex_lock(&pNvs->lock);
+
+    index = session_store_nvs_find(pNvs, packetId);
+    if (index >= 0) {
+        session_store_nvs_key(key, sizeof(key), packetId);
+        (void) nvs_erase_key(pNvs->handle, key);
+        session_store_nvs_drop(pNvs, index);
+        err = session_store_nvs_commit_ids(pNvs);
+        if (ESP_OK != err) {
+            ESP_LOGW(TAG, "Failed to forget packet %u: %s", packetId, esp_err_to_name(err));
+        }
+    }
+
+    aws_iot_thread_mutex_unlock(&pNvs->lock);
+}
+
+static IoT_Error_t session_store_nvs_load(void *pContext, uint32_t index, uint16_t *pPacketId, unsigned char *pBuf,
+                                          size_t bufLen, size_t *pPacketLen) {
+    IoT_Session_Store_Nvs *pNvs = (IoT_Session_Store_Nvs *) pContext;
+    IoT_Error_t rc = SUCCESS;
+    char key[8];
+    size_t len;
+    esp_err_t err;
+
+    *pPacketLen = 0;
+
+    aws_iot_thread_mutex_lock(&pNvs->lock);
+
+    while (index < pNvs->count) {
+        session_store_nvs_key(key, sizeof(key), pNvs->ids[index]);
+        len = bufLen;
+        err = nvs_get_blob(pNvs->handle, key, pBuf, &len);
+        if (ESP_ERR_NVS_NOT_FOUND == err) {
+            /* Power was lost while removing it, it is gone already */
+            session_store_nvs_drop(pNvs, index);
+            (void) session_store_nvs_commit_ids(pNvs);
+            continue;
+        }
+        if (ESP_OK == err) {
+            *pPacketId = pNvs->ids[index];
+            *pPacketLen = len;
+        } else {
+            rc = (ESP_ERR_NVS_INVALID_LENGTH == err) ? MQTT_TX_BUFFER_TOO_SHORT_ERROR : FAILURE;
+        }
+        break;
+    }
+
+    aws_iot_thread_mutex_unlock(&pNvs->lock);
+
+    return rc;
+}
+
+IoT_Error_t aws_iot_session_store_nvs_init(IoT_MQTT_Session_Store *pStore, IoT_Session_Store_Nvs *pNvs,
+                                           const char *pNamespace) {
+    size_t len = sizeof(pNvs->ids);
+    esp_err_t err;
+    IoT_Error_t rc;
+
+    if (NULL == pStore || NULL == pNvs || NULL == pNamespace) {
+        return NULL_VALUE_ERROR;
+    }
+
+    err = nvs_open(pNamespace, NVS_READWRITE, &pNvs->handle);
+    if (ESP_OK != err) {
+        ESP_LOGE(TAG, "Failed to open NVS namespace %s: %s", pNamespace, esp_err_to_name(err));
+        return FAILURE;
+    }
+
+    err = nvs_get_blob(pNvs->handle, SESSION_STORE_NVS_IDS_KEY, pNvs->ids, &len);
+    if (ESP_OK == err) {
+        pNvs->count = (uint16_t) (len / sizeof(uint16_t));
+        ESP_LOGI(TAG, "%u unacknowledged messages from the previous session", pNvs->count);
+    } else {
+        pNvs->count = 0;
+    }
+
+    rc = aws_iot_thread_mutex_init(&pNvs->lock);
+    if (SUCCESS != rc) {
+        nvs_close(pNvs->handle);
+        return rc;
+    }
+
+    pStore->save = session_store_nvs_save;
+    pStore->remove = session_store_nvs_remove;
+    pStore->load = session_store_nvs_load;
+    pStore->pContext = pNvs;
+
+    return SUCCESS;
+}
+
+void aws_iot_session_store_nvs_deinit(IoT_Session_Store_Nvs *pNvs) {
+    if (NULL == pNvs) {
+        return;
+    }
+    aws_iot_thread_mutex_destroy(&pNvs->lock);
+    nvs_close(pNvs->handle);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -38,6 +38,18 @@ IoT_Error_t aws_iot_thread_mutex_init(IoT_Mutex_t *pMutex) {
     return pMutex->mutex ? SUCCESS : MUTEX_INIT_ERROR;
 }
 
+/**
+ * @brief Initialize the provided mutex as recursive
+ *
+ * Mutexes of this port are always recursive, see aws_iot_thread_mutex_init
+ *
+ * @param IoT_Mutex_t - pointer to the mutex to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_mutex_init_recursive(IoT_Mutex_t *pMutex) {
+    return aws_iot_thread_mutex_init(pMutex);
+}
+
 /**
  * @brief Lock the provided mutex
  *
@@ -98,6 +110,64 @@ IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *pMutex) {
     return SUCCESS;
 }
 
+/**
+ * @brief Initialize the provided semaphore
+ *
+ * Call this function to initialize the semaphore in the taken state
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_init(IoT_Semaphore_t *pSem) {
+
+    pSem->sem = xSemaphoreCreateBinary();
+    return pSem->sem ? SUCCESS : SEMAPHORE_INIT_ERROR;
+}
+
+/**
+ * @brief Signal the provided semaphore
+ *
+ * Call this function to wake up a task waiting on the semaphore
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be signalled
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_post(IoT_Semaphore_t *pSem) {
+    /* Giving an already given binary semaphore fails, the waiter is woken either way */
+    xSemaphoreGive(pSem->sem);
+    return SUCCESS;
+}
+
+/**
+ * @brief Wait on the provided semaphore
+ *
+ * Call this function to block until the semaphore is signalled or the timeout expires
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to wait on
+ * @param timeout_ms - maximum time to wait in milliseconds
+ * @return IoT_Error_t - SUCCESS if signalled, SEMAPHORE_WAIT_TIMEOUT_ERROR otherwise
+ */
+IoT_Error_t aws_iot_thread_semaphore_wait(IoT_Semaphore_t *pSem, uint32_t timeout_ms) {
+    if (xSemaphoreTake(pSem->sem, pdMS_TO_TICKS(timeout_ms))) {
+        return SUCCESS;
+    } else {
+        return SEMAPHORE_WAIT_TIMEOUT_ERROR;
+    }
+}
+
+/**
+ * @brief Destroy the provided semaphore
+ *
+ * Call this function to destroy the semaphore
+ *
+ * @param IoT_Semaphore_t - pointer to the semaphore to be destroyed
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_semaphore_destroy(IoT_Semaphore_t *pSem) {
+    vSemaphoreDelete(pSem->sem);
+    return SUCCESS;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,6 +65,16 @@ uint32_t left_ms(Timer *timer) {
     }
 }
 
+uint32_t elapsed_ms(Timer *timer) {
+    uint32_t now = xTaskGetTickCount();
+    uint32_t elapsed = now - timer->start_ticks;
+    if (elapsed > timer->timeout_ticks) {
+        return (elapsed - timer->timeout_ticks) * portTICK_PERIOD_MS;
+    } else {
+        return 0;
+    }
+}
+
 void countdown_sec(Timer *timer, uint32_t timeout) {
     if (timeout > UINT32_MAX / 1000) {
         ESP_LOGE(TAG, "timeout is out of range: %ds", timeout);
@@ -78,6 +88,11 @@ void init_timer(Timer *timer) {
     timer->last_polled_ticks = 0;
 }
 
+void delay(unsigned milliseconds) {
+    /* Rounded up, a sleep never ends before the time asked for */
+    vTaskDelay((milliseconds + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * Additions Copyright 2016 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file trace_platform.c
+ * @brief ESP32 timestamp and core id for the trace rings.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#ifndef DISABLE_IOT_TRACE_RING
+
+uint32_t aws_iot_trace_timestamp_us(void) {
+    return (uint32_t) esp_timer_get_time();
+}
+
+uint32_t aws_iot_trace_core_id(void) {
+    return (uint32_t) xPortGetCoreID();
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,7 +2,9 @@
  *
  * The code GET traffic data from TomTom API and publish it to AWS IoT core in every 60 seconds
  * on MQTT protocol.
- * The example is single threaded and uses statically allocated memory. It uses QOS0 for Publish messages.
+ * The example is single threaded and uses statically allocated memory. It uses QOS1 for Publish messages
+ * on a persistent session; messages not acknowledged yet are kept in NVS and sent again after a
+ * reconnect or a reboot.
  */
 #include <stdio.h>
 #include <string.h>
@@ -10,19 +12,33 @@
 #include "aws_iot_mqtt_client.h"
 #include "aws_iot_mqtt_client_interface.h"
 #include "aws_iot_config.h"
+#include "aws_iot_session_store_nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_http_client.h"
 #include "esp_tls.h" 
+#include "dns_cache.h"
+#include "traffic_session.h"
 
 extern const char *TAG;
-static const uint8_t aws_root_ca_pem_start[] asm("_binary_aws_root_ca_pem_start");
-static const uint8_t aws_root_ca_pem_end[] asm("_binary_aws_root_ca_pem_end");
-static const uint8_t certificate_pem_crt_start[] asm("_binary_certificate_pem_crt_start");
-static const uint8_t certificate_pem_crt_end[] asm("_binary_certificate_pem_crt_end");
-static const uint8_t private_pem_key_start[] asm("_binary_private_pem_key_start");
-static const uint8_t private_pem_key_end[] asm("_binary_private_pem_key_end");
+// DER converted from certs/ at build time, see main/CMakeLists.txt
+static const uint8_t aws_root_ca_der_start[] asm("_binary_aws_root_ca_der_start");
+static const uint8_t aws_root_ca_der_end[] asm("_binary_aws_root_ca_der_end");
+static const uint8_t certificate_der_start[] asm("_binary_certificate_der_start");
+static const uint8_t certificate_der_end[] asm("_binary_certificate_der_end");
+static const uint8_t private_key_der_start[] asm("_binary_private_key_der_start");
+static const uint8_t private_key_der_end[] asm("_binary_private_key_der_end");
 static const char *PUBTOPIC = "esp32/traffic/data";
+#ifdef ENABLE_IOT_MQTT5
+// Stored packets are in the encoding of the protocol, those of MQTT 3.1.1 builds are not resent
+static const char *SESSION_NAMESPACE = "aws_session5";
+#else
+static const char *SESSION_NAMESPACE = "aws_session";
+#endif
+static IoT_Session_Store_Nvs sessionStoreNvs;
+static IoT_MQTT_Session_Store sessionStore;
+static IoT_Publish_Template trafficTemplate;
+static traffic_session_t trafficSession;
 char payload[200];
 
 
@@ -133,19 +149,28 @@ void aws_connect_task(void *param)
    mqttInitParams.port = AWS_IOT_MQTT_PORT;
    
    //Refer to https://docs.espressif.com/projects/esp-jumpstart/en/latest/remotecontrol.html#embedding-files-in-the-firmware
-   mqttInitParams.pRootCALocation = (const char *)aws_root_ca_pem_start;
-   mqttInitParams.pDeviceCertLocation = (const char *)certificate_pem_crt_start;
-   mqttInitParams.pDevicePrivateKeyLocation = (const char *)private_pem_key_start;
+   mqttInitParams.pRootCALocation = (const char *)aws_root_ca_der_start;
+   mqttInitParams.rootCALen = aws_root_ca_der_end - aws_root_ca_der_start;
+   mqttInitParams.pDeviceCertLocation = (const char *)certificate_der_start;
+   mqttInitParams.deviceCertLen = certificate_der_end - certificate_der_start;
+   mqttInitParams.pDevicePrivateKeyLocation = (const char *)private_key_der_start;
+   mqttInitParams.devicePrivateKeyLen = private_key_der_end - private_key_der_start;
 
     mqttInitParams.mqttCommandTimeout_ms = 20000;
     mqttInitParams.tlsHandshakeTimeout_ms = 5000;
     mqttInitParams.isSSLHostnameVerify = true;
+    // Small records from the broker, with CONFIG_MBEDTLS_DYNAMIC_BUFFER the receive buffer only grows to their size
+    mqttInitParams.tlsProfile = IOT_TLS_PROFILE_LEAN;
     mqttInitParams.disconnectHandler = disconnectCallbackHandler;
     mqttInitParams.disconnectHandlerData = NULL;
 
     connectParams.keepAliveIntervalInSec = 61; //should be more than the vTaskDelay in while loop
-    connectParams.isCleanSession = true;
+    connectParams.isCleanSession = false; // Broker keeps subscriptions and undelivered messages across reconnects
+#ifdef ENABLE_IOT_MQTT5
+    connectParams.MQTTVersion = MQTT_5;
+#else
     connectParams.MQTTVersion = MQTT_3_1_1;
+#endif
     
     connectParams.pClientID = AWS_IOT_MQTT_CLIENT_ID;
     connectParams.clientIDLen = (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID);
@@ -162,6 +187,17 @@ void aws_connect_task(void *param)
         abort();
     }
 
+    rc = aws_iot_session_store_nvs_init(&sessionStore, &sessionStoreNvs, SESSION_NAMESPACE);
+    if(SUCCESS == rc)
+    {
+        rc = aws_iot_mqtt_set_session_store(&client, &sessionStore);
+    }
+    if(SUCCESS != rc)
+    {
+        ESP_LOGE(TAG, "Unable to set up the session store : %d ", rc);
+        abort();
+    }
+
     ESP_LOGI(TAG, "Connecting to AWS...");
     rc = aws_iot_mqtt_connect(&client, &connectParams);
     do
@@ -185,11 +221,12 @@ void aws_connect_task(void *param)
         abort();
     }
     
-    const int topic_len = strlen(PUBTOPIC);
-
-    IoT_Publish_Message_Params paramsQOS0;
-    paramsQOS0.qos = QOS0;
-    paramsQOS0.isRetained = 0;
+    // Topic and flags never change, encode them once for all publishes
+    rc = aws_iot_mqtt_publish_template_init(&trafficTemplate, PUBTOPIC, (uint16_t) strlen(PUBTOPIC), QOS1, 0);
+    if(SUCCESS != rc) {
+        ESP_LOGE(TAG, "Unable to set up the publish template - %d", rc);
+        abort();
+    }
     
 
     //*****************************************************************************************
@@ -202,7 +239,11 @@ void aws_connect_task(void *param)
         .event_handler = _http_event_handle,
         .user_data = local_response_buffer
     };
-    esp_http_client_handle_t httpClient = esp_http_client_init(&config);
+    // One connection kept between fetches, a new one only when the server has closed it
+    if (ESP_OK != traffic_session_init(&trafficSession, &config)) {
+        abort();
+    }
+    esp_http_client_handle_t httpClient = traffic_session_client(&trafficSession);
     //task loop
     while((NETWORK_ATTEMPTING_RECONNECT == rc || NETWORK_RECONNECTED == rc || SUCCESS == rc)) 
     {
@@ -212,18 +253,35 @@ void aws_connect_task(void *param)
             // If the client is attempting to reconnect we will skip the rest of the loop.
             continue;
         }
-        esp_err_t err = esp_http_client_perform(httpClient);
+        esp_err_t err = traffic_session_fetch(&trafficSession);
         if (err == ESP_OK)
         {        
                 ESP_LOGI(TAG, "Status = %d, content_length = %d",
                 esp_http_client_get_status_code(httpClient),
                 esp_http_client_get_content_length(httpClient));
-                paramsQOS0.payload = local_response_buffer;
-                paramsQOS0.payloadLen = strlen(local_response_buffer);
                 ESP_LOGI(TAG, " Sending JSON Response to AWS : %s", local_response_buffer);
-                rc = aws_iot_mqtt_publish(&client, PUBTOPIC, topic_len, &paramsQOS0);
+                rc = aws_iot_mqtt_publish_with_template(&client, &trafficTemplate, local_response_buffer,
+                                                        strlen(local_response_buffer), NULL);
+                if (MQTT_REQUEST_TIMEOUT_ERROR == rc)
+                {
+                    // Still in the session store, it goes out again on the next connect
+                    ESP_LOGW(TAG, "No PUBACK yet for the traffic data");
+                    rc = SUCCESS;
+                }
         }
        
+        dns_cache_stats_t dnsStats;
+        dns_cache_get_stats(&dnsStats);
+        ESP_LOGI(TAG, "DNS cache: %u hits, %u queries, %u fallbacks, %u failures",
+                 dnsStats.hits, dnsStats.queries, dnsStats.fallbacks, dnsStats.failures);
+        traffic_session_stats_t fetchStats;
+        traffic_session_get_stats(&trafficSession, &fetchStats);
+        ESP_LOGI(TAG, "Traffic fetch: %u new connections (avg %u ms), %u reused (avg %u ms), %u retries, %u failures",
+                 fetchStats.handshakes,
+                 fetchStats.handshakes ? (uint32_t) (fetchStats.handshake_us / fetchStats.handshakes / 1000) : 0,
+                 fetchStats.reuses,
+                 fetchStats.reuses ? (uint32_t) (fetchStats.reuse_us / fetchStats.reuses / 1000) : 0,
+                 fetchStats.retries, fetchStats.failures);
         ESP_LOGI(TAG, "Stack remaining for task '%s' is %d bytes", pcTaskGetTaskName(NULL), uxTaskGetStackHighWaterMark(NULL));
         vTaskDelay(60000 / portTICK_RATE_MS); // 60 second delay
     } //task loop ends
@@ -234,7 +292,7 @@ void aws_connect_task(void *param)
 
     ESP_LOGI(TAG, "Disconnecting with AWS");
     rc = aws_iot_mqtt_disconnect(&client);
-    esp_http_client_cleanup(httpClient);
+    traffic_session_cleanup(&trafficSession);
     if(SUCCESS != rc) {
         ESP_LOGE(TAG, "Disconnect error %d", rc);
     }
@@ -34,8 +34,10 @@
 // MQTT PubSub
 #ifndef DISABLE_IOT_JOBS
 #define AWS_IOT_MQTT_RX_BUF_LEN 512 ///< Also change in Menuconfig same value. Any message that comes into the device should be less than this buffer size. If a received message is bigger than this buffer size the message will be dropped.
+#define AWS_IOT_MQTT_RX_RING_BUF_LEN 1024 ///< Also change in Menuconfig same value. Receive ring in front of the RX buffer, must not be smaller than it
 #else
 #define AWS_IOT_MQTT_RX_BUF_LEN 2048///< Also change in Menuconfig same value.
+#define AWS_IOT_MQTT_RX_RING_BUF_LEN 4096 ///< Also change in Menuconfig same value.
 #endif
 #define AWS_IOT_MQTT_TX_BUF_LEN 2500 ///< Also change in Menuconfig same value.Any time a message is sent out through the MQTT layer. The message is copied into this buffer anytime a publish is done. This will also be used in the case of Thing Shadow
 #define AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS 5 ///< Maximum number of topic filters the MQTT client can handle at any given time. This should be increased appropriately when using Thing Shadow
@@ -0,0 +1,58 @@
+/*
+ * Persistent HTTPS connection to the traffic API
+ *
+ * One esp_http_client handle is kept connected between fetches. The server
+ * closes idle connections after a while it does not announce, so the session
+ * learns it: a kept connection that turns out to be closed is retried once on a
+ * new one, and later fetches after a pause at least that long open a new
+ * connection right away instead of finding out the hard way.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+typedef struct {
+    uint32_t requests;      // Fetches, retries not counted
+    uint32_t handshakes;    // Fetches that had to open a connection, TCP and TLS handshake included
+    uint32_t reuses;        // Fetches sent on a connection kept from the previous one
+    uint32_t retries;       // Kept connections found closed by the server, fetched again on a new one
+    uint32_t failures;      // Fetches without a response
+    uint64_t handshake_us;  // Total time of the fetches that had to open a connection
+    uint64_t reuse_us;      // Total time of the fetches sent on a kept connection
+} traffic_session_stats_t;
+
+// Storage for traffic_session_init, treat as opaque
+typedef struct {
+    esp_http_client_handle_t client;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    bool is_connected;
+    int64_t last_fetch_us;      // End of the previous fetch
+    int64_t closed_idle_us;     // Shortest pause after which the server had closed, 0 if not seen yet
+    uint32_t early_closes;      // Connections closed because of closed_idle_us since it was last checked
+    traffic_session_stats_t stats;
+} traffic_session_t;
+
+/*
+ * Set up the session, config is used as for esp_http_client_init. The event
+ * handler in config still gets every event with its own user_data.
+ */
+esp_err_t traffic_session_init(traffic_session_t *session, const esp_http_client_config_t *config);
+
+/*
+ * Fetch the configured URL, reusing the connection of the previous fetch when it
+ * is still open. The response is read through the event handler as with
+ * esp_http_client_perform. Only a write or connect error on a kept connection
+ * is retried, a slow response or another error is returned as it is.
+ */
+esp_err_t traffic_session_fetch(traffic_session_t *session);
+
+// Handle of the session, for esp_http_client_get_status_code and the like
+esp_http_client_handle_t traffic_session_client(traffic_session_t *session);
+
+void traffic_session_get_stats(traffic_session_t *session, traffic_session_stats_t *stats);
+
+void traffic_session_cleanup(traffic_session_t *session);
@@ -0,0 +1,121 @@
+/*
+ * Persistent HTTPS connection to the traffic API, see traffic_session.h
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "traffic_session.h"
+
+static const char *TAG = "traffic_session";
+
+// Every so many fetches after a long pause the kept connection is tried anyway, the server may keep it longer now
+#define TRAFFIC_SESSION_RECHECK 16
+
+static esp_err_t traffic_session_event(esp_http_client_event_t *evt)
+{
+    traffic_session_t *session = evt->user_data;
+
+    if (HTTP_EVENT_ON_CONNECTED == evt->event_id) {
+        session->is_connected = true;
+    } else if (HTTP_EVENT_DISCONNECTED == evt->event_id) {
+        session->is_connected = false;
+    }
+
+    if (NULL == session->event_handler) {
+        return ESP_OK;
+    }
+    // The client fills user_data again for every event
+    evt->user_data = session->user_data;
+    return session->event_handler(evt);
+}
+
+// Errors of a kept connection the server has closed, a timeout or EAGAIN says nothing about its idle limit
+static bool traffic_session_is_closed(esp_err_t err)
+{
+    return ESP_ERR_HTTP_WRITE_DATA == err || ESP_ERR_HTTP_CONNECT == err;
+}
+
+esp_err_t traffic_session_init(traffic_session_t *session, const esp_http_client_config_t *config)
+{
+    esp_http_client_config_t sessionConfig = *config;
+
+    memset(session, 0, sizeof(*session));
+    session->event_handler = config->event_handler;
+    session->user_data = config->user_data;
+
+    sessionConfig.event_handler = traffic_session_event;
+    sessionConfig.user_data = session;
+    session->client = esp_http_client_init(&sessionConfig);
+    if (NULL == session->client) {
+        ESP_LOGE(TAG, "Unable to set up the HTTP client");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t traffic_session_fetch(traffic_session_t *session)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t idle = start - session->last_fetch_us;
+    int64_t elapsed;
+    bool isReuse;
+    esp_err_t err;
+
+    if (session->is_connected && 0 != session->closed_idle_us && idle >= session->closed_idle_us) {
+        if (++session->early_closes < TRAFFIC_SESSION_RECHECK) {
+            // The server has closed it by now, writing into it would only cost a retry
+            esp_http_client_close(session->client);
+        } else {
+            session->early_closes = 0;
+        }
+    }
+
+    isReuse = session->is_connected;
+    session->stats.requests++;
+    err = esp_http_client_perform(session->client);
+    if (isReuse && traffic_session_is_closed(err)) {
+        ESP_LOGW(TAG, "Connection closed after %lld ms idle, connecting again", idle / 1000);
+        if (0 == session->closed_idle_us || idle < session->closed_idle_us) {
+            session->closed_idle_us = idle;
+        }
+        session->stats.retries++;
+        esp_http_client_close(session->client);
+        isReuse = false;
+        err = esp_http_client_perform(session->client);
+    } else if (ESP_OK == err && isReuse && 0 != session->closed_idle_us && idle >= session->closed_idle_us) {
+        // Kept open longer than last time, stop closing early
+        session->closed_idle_us = 0;
+    }
+
+    session->last_fetch_us = esp_timer_get_time();
+    elapsed = session->last_fetch_us - start;
+    if (ESP_OK != err) {
+        session->stats.failures++;
+    } else if (isReuse) {
+        session->stats.reuses++;
+        session->stats.reuse_us += elapsed;
+    } else {
+        session->stats.handshakes++;
+        session->stats.handshake_us += elapsed;
+    }
+    return err;
+}
+
+esp_http_client_handle_t traffic_session_client(traffic_session_t *session)
+{
+    return session->client;
+}
+
+void traffic_session_get_stats(traffic_session_t *session, traffic_session_stats_t *stats)
+{
+    *stats = session->stats;
+}
+
+void traffic_session_cleanup(traffic_session_t *session)
+{
+    if (NULL != session->client) {
+        esp_http_client_cleanup(session->client);
+        session->client = NULL;
+    }
+    session->is_connected = false;
+}